@@ -60,9 +60,12 @@
 #include <ctype.h>
 #include <iconv.h>
 #include <locale.h>
+#include <setjmp.h>
+#include <signal.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #ifndef __MVS__
 #include <sys/param.h>
 #endif
@@ -282,7 +285,7 @@ static int fileWasModifiedExternally(WindowInfo *window);
 static const char *errorString(void);
 static void addWrapNewlines(WindowInfo *window);
 static int cmpWinAgainstFile(WindowInfo *window, const char *fileName);
-static int min(int i1, int i2);
+static ssize_t min(ssize_t i1, ssize_t i2);
 static void modifiedWindowDestroyedCB(Widget w, XtPointer clientData,
     XtPointer callData);
 static void forceShowLineNumbers(WindowInfo *window);
@@ -675,6 +678,261 @@ size_t copyBytes(
 
 #define IO_BUFSIZE 2048
 
+/* Files at least this large are memory mapped instead of read through a
+   FileStream, if no conversion is needed (see mapFileContent) */
+#define MMAP_THRESHOLD 0x100000
+
+/* A memory mapped file is copied in pieces of this size, each unmapped once
+   it is copied, so the file isn't held in memory twice */
+#define MMAP_COPY_CHUNK 0x4000000
+
+/* Where copying a memory mapped file returns to if the file shrinks.  Set
+   only in the thread making the copy, and only while it does */
+static __thread sigjmp_buf *MapFaultEnv;
+
+/* Minimum unused space in the conversion buffer, before it is shrunk */
+#define SHRINK_THRESHOLD 0x10000
+
+/*
+ * Checks if a memory region is valid UTF-8 (or ASCII, if asciiOnly is set)
+ * that can be loaded into a text buffer without any conversion. This
+ * means it contains no ascii-nul characters and no byte sequences
+ * iconv would reject.
+ */
+static int isPlainText(const unsigned char *s, size_t len, int asciiOnly)
+{
+    const unsigned char *end = s + len;
+    
+    while(s < end) {
+        /* skip ascii text a word at a time */
+        while(s + sizeof(uint64_t) <= end) {
+            uint64_t w;
+            memcpy(&w, s, sizeof(uint64_t));
+            /* (w - 0x01..) & ~w & 0x80.. is non-zero, if w has a null byte */
+            if((w & UINT64_C(0x8080808080808080)) != 0 ||
+               ((w - UINT64_C(0x0101010101010101)) & ~w & UINT64_C(0x8080808080808080)) != 0)
+            {
+                break;
+            }
+            s += sizeof(uint64_t);
+        }
+        if(s >= end) {
+            break;
+        }
+        
+        unsigned char c = *s;
+        if(c == 0) {
+            return 0;
+        } else if(c < 0x80) {
+            s++;
+            continue;
+        } else if(asciiOnly) {
+            return 0;
+        }
+        
+        /* validate a multibyte sequence (Unicode Table 3-7) */
+        size_t n;
+        unsigned char lo = 0x80, hi = 0xBF;
+        if(c >= 0xC2 && c <= 0xDF) {
+            n = 1;
+        } else if(c >= 0xE0 && c <= 0xEF) {
+            n = 2;
+            if(c == 0xE0) lo = 0xA0;
+            else if(c == 0xED) hi = 0x9F;
+        } else if(c >= 0xF0 && c <= 0xF4) {
+            n = 3;
+            if(c == 0xF0) lo = 0x90;
+            else if(c == 0xF4) hi = 0x8F;
+        } else {
+            return 0;
+        }
+        if((size_t)(end - s) <= n) {
+            return 0;
+        }
+        if(s[1] < lo || s[1] > hi) {
+            return 0;
+        }
+        for(size_t i=2;i<=n;i++) {
+            if((s[i] & 0xC0) != 0x80) {
+                return 0;
+            }
+        }
+        s += n + 1;
+    }
+    return 1;
+}
+
+/*
+ * Returns 1 if the encoding name refers to UTF-8, 2 if it is plain ASCII
+ * and 0 otherwise
+ */
+static int isUtf8Encoding(const char *encoding)
+{
+    if(!strcasecmp(encoding, "UTF-8") || !strcasecmp(encoding, "UTF8")) {
+        return 1;
+    }
+    if(!strcasecmp(encoding, "ASCII") || !strcasecmp(encoding, "US-ASCII") ||
+       !strcasecmp(encoding, "ANSI_X3.4-1968"))
+    {
+        return 2;
+    }
+    return 0;
+}
+
+/*
+ * Estimates the size of a file with the given encoding and length after
+ * conversion to UTF-8. The estimate is an upper bound for the common
+ * encodings, so that the conversion buffer needs no reallocation.
+ * Unused memory is released with a final realloc.
+ */
+static size_t estimateUtf8Size(const char *encoding, size_t len)
+{
+    size_t est = len;
+    
+    if(!encoding) {
+        return len;
+    }
+    
+    if(!strncasecmp(encoding, "UTF-16", 6) || !strncasecmp(encoding, "UCS-2", 5)) {
+        /* 2 bytes per BMP character, at most 3 bytes in UTF-8 */
+        est = len + len / 2;
+    } else if(!strncasecmp(encoding, "UTF-32", 6) || !strncasecmp(encoding, "UCS-4", 5)) {
+        /* 4 bytes per character, never more in UTF-8 */
+        est = len;
+    } else if(isUtf8Encoding(encoding)) {
+        /* only invalid bytes grow, to a 3 byte replacement character */
+        est = len;
+    } else if(!strcasecmp(encoding, "GB18030") || !strncasecmp(encoding, "GBK", 3) ||
+              !strncasecmp(encoding, "GB2312", 6) || !strncasecmp(encoding, "BIG5", 4) ||
+              !strncasecmp(encoding, "EUC-", 4) || !strncasecmp(encoding, "SHIFT_JIS", 9) ||
+              !strncasecmp(encoding, "SJIS", 4) || !strncasecmp(encoding, "ISO-2022", 8) ||
+              !strncasecmp(encoding, "CP932", 5) || !strncasecmp(encoding, "CP936", 5) ||
+              !strncasecmp(encoding, "CP949", 5) || !strncasecmp(encoding, "CP950", 5))
+    {
+        /* 2 byte CJK characters become 3 bytes in UTF-8 */
+        est = len + len / 2;
+    } else {
+        /* single byte codepage: at most 3 UTF-8 bytes per character */
+        est = len * 3;
+    }
+    
+    /* on overflow fall back to the file size, the buffer is extended
+       if necessary */
+    if(est < len) {
+        est = len;
+    }
+    return est;
+}
+
+static void mapFaultHandler(int sig)
+{
+    /* A fault anywhere else (another thread, for example) is not caused by
+       the mapping: the default action is restored, and taken when the
+       faulting instruction is retried */
+    if(!MapFaultEnv) {
+        signal(SIGBUS, SIG_DFL);
+        return;
+    }
+    siglongjmp(*MapFaultEnv, 1);
+}
+
+/*
+ * Fast path of GetFileContent for large files, that can be used as they are.
+ * The file is mapped into memory and copied out of the mapping, then
+ * checked, without going through a FileStream. The copy is made into
+ * memory from BufAllocText, so the text buffer can take it over as it is.
+ *
+ * Touching a page of the mapping beyond the end of the file raises SIGBUS,
+ * which happens if the file is truncated while it is read (a log file being
+ * rotated, for example). The copy is made with a SIGBUS handler installed,
+ * and if it fires, the file is read the normal way instead.
+ *
+ * Returns 0 if the file was read, or 1 if the file needs the normal
+ * read/convert path.
+ */
+static int mapFileContent(FILE *fp, const char *encoding, FileContent *content)
+{
+    size_t len = content->statbuf.st_size;
+    int enc = isUtf8Encoding(encoding);
+    struct sigaction act, oldAct;
+    sigjmp_buf faultEnv;
+    char *volatile text = NULL;
+    
+    if(!enc || !S_ISREG(content->statbuf.st_mode) || len < MMAP_THRESHOLD) {
+        return 1;
+    }
+    
+    char *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    if(map == MAP_FAILED) {
+        return 1;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(map, len, MADV_SEQUENTIAL);
+#endif
+    
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = mapFaultHandler;
+    sigemptyset(&act.sa_mask);
+    sigaction(SIGBUS, &act, &oldAct);
+    if(sigsetjmp(faultEnv, 1) == 0) {
+        MapFaultEnv = &faultEnv;
+        text = BufAllocText(len);
+        for(size_t done=0;done<len;done+=MMAP_COPY_CHUNK) {
+            size_t n = len - done < MMAP_COPY_CHUNK ? len - done : MMAP_COPY_CHUNK;
+            memcpy(text + done, map + done, n);
+            munmap(map + done, n);
+        }
+        text[len] = '\0';
+    } else {
+        NEditFree(text);
+        text = NULL;
+    }
+    MapFaultEnv = NULL;
+    sigaction(SIGBUS, &oldAct, NULL);
+    munmap(map, len); /* what is left of it, after a fault */
+    if(!text) {
+        return 1;
+    }
+    
+    /* The file must not contain anything GetFileContent would convert:
+       invalid characters, ascii-nul or DOS/Mac line endings.
+       FormatOfFile only checks a small sample at the start of the file,
+       which is always within the text, because len >= MMAP_THRESHOLD. */
+    int fileFormat = UNIX_FILE_FORMAT;
+    if(GetPrefForceOSConversion()) {
+        fileFormat = FormatOfFile(text);
+    }
+    if(fileFormat != UNIX_FILE_FORMAT ||
+       !isPlainText((unsigned char*)text, len, enc == 2))
+    {
+        NEditFree(text);
+        return 1;
+    }
+    
+    size_t enclen = strlen(encoding);
+    if(enclen >= MAX_ENCODING_LENGTH) {
+        enclen = MAX_ENCODING_LENGTH-1;
+    }
+    memcpy(content->encoding, encoding, enclen);
+    content->encoding[enclen] = 0;
+    
+    content->content = text;
+    content->length = len;
+    content->fileFormat = fileFormat;
+    content->plain = 1;
+    return 0;
+}
+
+/*
+ * Releases the text of a FileContent, returned by GetFileContent
+ */
+void FreeFileContent(FileContent *content)
+{
+    NEditFree(content->content);
+    content->content = NULL;
+    content->plain = 0;
+}
+
 static int doOpen(WindowInfo *window, const char *name, const char *path,
      const char *encoding, const char *filter_name, int flags)
 {
@@ -718,7 +976,7 @@ static int doOpen(WindowInfo *window, const char *name, const char *path,
     memcpy(fullname+path_len, name, name_len+1);
     
     FileContent content;
-    if(GetFileContent(window->shell, fullname, encoding, filter_name, &content)) {
+    if(GetFileContent(window->shell, fullname, encoding, filter_name, TRUE, &content)) {
         if(content.err == ENOENT && flags & CREATE) {
             /* Give option to create (or to exit if this is the only window) */
             if (!(flags & SUPPRESS_CREATE_WARN)) {
@@ -848,7 +1106,14 @@ static int doOpen(WindowInfo *window, const char *name, const char *path,
     
     /* Display the file contents in the text widget */
     window->ignoreModify = True;
-    BufSetAll(window->buffer, content.content);
+    if(content.plain) {
+        /* plain text contains no nul characters, and was read into memory
+           the buffer can take over */
+        BufTakeAll(window->buffer, content.content, content.length);
+        content.content = NULL;
+    } else {
+        BufSetAll(window->buffer, content.content);
+    }
     window->ignoreModify = False;
     
     /* Check that the length that the buffer thinks it has is the same
@@ -879,7 +1144,7 @@ static int doOpen(WindowInfo *window, const char *name, const char *path,
     }
 
     /* Release the memory that holds fileString */
-    NEditFree(content.content);
+    FreeFileContent(&content);
 
     /* Set window title and file changed flag */
     if ((flags & PREF_READ_ONLY) != 0) {
@@ -905,7 +1170,17 @@ static int doOpen(WindowInfo *window, const char *name, const char *path,
     return TRUE;
 }   
 
-int GetFileContent(Widget shell, const char *path, const char *encoding, const char *filter_name, FileContent *content)
+/*
+ * Reads a file and converts it to UTF-8
+ *
+ * If allowMap is set, the content of large files that don't need any
+ * conversion is copied out of a memory mapping instead of being read
+ * through a FileStream. In this case, content->plain is set, and
+ * content->content contains no nul characters, and can be given to a
+ * text buffer with BufTakeAll.
+ * The content must be released with FreeFileContent.
+ */
+int GetFileContent(Widget shell, const char *path, const char *encoding, const char *filter_name, int allowMap, FileContent *content)
 {
     memset(content, 0, sizeof(FileContent));
     
@@ -1095,9 +1370,27 @@ int GetFileContent(Widget shell, const char *path, const char *encoding, const c
         filestream_reset(stream, 0);
     }
     
-    /* Allocate space for the whole contents of the file (unfortunately) */
-    size_t strAlloc = fileLen;
+    /* Plain UTF-8 files without filter and BOM can be used as they are */
+    if(allowMap && !filter_cmd && !hasBOM && encoding &&
+       !mapFileContent(fp, encoding, content))
+    {
+        if(filestream_close(stream) != 0) {
+            content->closeerror = 1;
+            content->err = errno;
+        }
+        return 0;
+    }
+    
+    /* Allocate space for the whole contents of the file (unfortunately).
+       The size of the converted text is estimated from the encoding, to
+       avoid growing the buffer while converting. If the estimate can't
+       be allocated, try again with the file size. */
+    size_t strAlloc = filter_cmd ? fileLen : estimateUtf8Size(encoding, fileLen);
     fileString = malloc(strAlloc + 1); /* +1 = space for null */
+    if (fileString == NULL && strAlloc != (size_t)fileLen) {
+        strAlloc = fileLen;
+        fileString = malloc(strAlloc + 1);
+    }
     if (fileString == NULL) {
         filestream_close(stream);
         content->allocerror = 1;
@@ -1205,13 +1498,18 @@ int GetFileContent(Widget shell, const char *path, const char *encoding, const c
                     // either strconv needs more space, or
                     // the unicode replacement character couldn't be stored
                     // -> extend buffer
-                    strAlloc += 512;
+                    // grow geometrically, to keep the number of copies
+                    // low, if the estimated size was too small
                     size_t outpos = outStr - fileString;
-                    fileString = realloc(fileString, strAlloc + 1);
-                    if(!fileString) {
+                    size_t newAlloc = strAlloc + (strAlloc > 1024 ? strAlloc / 2 : 512);
+                    char *newString = realloc(fileString, newAlloc + 1);
+                    if(!newString) {
+                        content->allocerror = 1;
                         err = 1;
                         break;
                     }
+                    fileString = newString;
+                    strAlloc = newAlloc;
                     outStr = fileString + outpos;
                     outleft = strAlloc - readLen;
                 }
@@ -1229,6 +1527,14 @@ int GetFileContent(Widget shell, const char *path, const char *encoding, const c
     }
     fileString[readLen] = 0;
     
+    /* Give back memory, if the size estimate was too generous */
+    if(strAlloc - readLen > SHRINK_THRESHOLD) {
+        char *newString = realloc(fileString, readLen + 1);
+        if(newString) {
+            fileString = newString;
+        }
+    }
+    
     if(ic) {
         iconv_close(ic);
     }
@@ -1239,7 +1545,7 @@ int GetFileContent(Widget shell, const char *path, const char *encoding, const c
     /* Detect and convert DOS and Macintosh format files */
     if (GetPrefForceOSConversion()) {
         content->fileFormat = FormatOfFile(fileString);
-        int rLen = readLen;
+        ssize_t rLen = readLen;
         if (content->fileFormat == DOS_FILE_FORMAT) {
             ConvertFromDosFileString(fileString, &rLen, NULL);
         } else if (content->fileFormat == MAC_FILE_FORMAT) {
@@ -1267,7 +1573,7 @@ int IncludeFile(WindowInfo *window, const char *name, const char *encoding, cons
     
     /* Open the file */
     FileContent content;
-    if(GetFileContent(window->shell, name, encoding, filter_name, &content)) {
+    if(GetFileContent(window->shell, name, encoding, filter_name, FALSE, &content)) {
         int filenameSet = window->filenameSet;
         if(content.isdir) {
             window->filenameSet = FALSE; /* Temp. prevent check for changes. */
@@ -1638,7 +1944,8 @@ static int doSave(WindowInfo *window, Boolean setEncAttr)
     char fullname[MAXPATHLEN];
     struct stat statbuf;
     FILE *fp;
-    int fileLen, result;
+    ssize_t fileLen;
+    int result;
     
     iconv_t ic = NULL;
     ConvertFunc strconv = copyBytes;
@@ -2169,7 +2476,7 @@ void PrintWindow(WindowInfo *window, int selectedOnly)
     textBuffer *buf = window->buffer;
     selection *sel = &buf->primary;
     char *fileString = NULL;
-    int fileLen;
+    ssize_t fileLen;
     
     /* get the contents of the text buffer from the text area widget.  Add
        wrapping newlines if necessary to make it match the displayed text */
@@ -2205,7 +2512,7 @@ void PrintWindow(WindowInfo *window, int selectedOnly)
 ** Print a string (length is required).  parent is the dialog parent, for
 ** error dialogs, and jobName is the print title.
 */
-void PrintString(const char *string, int length, Widget parent, const char *jobName)
+void PrintString(const char *string, ssize_t length, Widget parent, const char *jobName)
 {
     char tmpFileName[L_tmpnam];    /* L_tmpnam defined in stdio.h */
     FILE *fp;
@@ -2671,7 +2978,8 @@ static void addWrapCB(Widget w, XtPointer clientData, XtPointer callData)
 */
 static void addWrapNewlines(WindowInfo *window)
 {
-    int fileLen, i, insertPositions[MAX_PANES], topLines[MAX_PANES];
+    ssize_t fileLen;
+    int i, insertPositions[MAX_PANES], topLines[MAX_PANES];
     int horizOffset;
     Widget text;
     char *fileString;
@@ -2719,7 +3027,8 @@ static int cmpWinAgainstFile(WindowInfo *window, const char *fileName)
 {
     char    fileString[PREFERRED_CMPBUF_LEN + 2];
     struct  stat statbuf;
-    int     fileLen, restLen, nRead, bufPos, rv, offset, filePos;
+    ssize_t fileLen, restLen, nRead, bufPos, filePos;
+    int     rv, offset;
     char    pendingCR = 0;
     int	    fileFormat = window->fileFormat;
     char    message[MAXPATHLEN+50];
@@ -2825,7 +3134,7 @@ static void forceShowLineNumbers(WindowInfo *window)
     }
 }
 
-static int min(int i1, int i2)
+static ssize_t min(ssize_t i1, ssize_t i2)
 {
     return i1 <= i2 ? i1 : i2;
 }
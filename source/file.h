@@ -61,6 +61,7 @@ typedef struct FileContent {
     int       closeerror;
     int       skipped;
     int       err;
+    int       plain;
     EncError  *enc_errors;
     size_t    num_enc_errors;
     char      encoding[MAX_ENCODING_LENGTH];
@@ -79,7 +80,7 @@ int SaveWindowAs(WindowInfo *window, FileSelection *file);
 int CloseAllFilesAndWindows(void);
 int CloseFileAndWindow(WindowInfo *window, int preResponse);
 void PrintWindow(WindowInfo *window, int selectedOnly);
-void PrintString(const char *string, int length, Widget parent, const char *jobName);
+void PrintString(const char *string, ssize_t length, Widget parent, const char *jobName);
 int WriteBackupFile(WindowInfo *window);
 int IncludeFile(WindowInfo *window, const char *name, const char *encoding, const char *filter_name);
 int PromptForExistingFile(WindowInfo *window, char *prompt, FileSelection *file);
@@ -92,6 +93,7 @@ void CheckForChangesToFile(WindowInfo *window);
 
 const char * DetectEncoding(const char *buf, size_t len, const char *def);
 
-int GetFileContent(Widget shell, const char *path, const char *encoding, const char *filter_name, FileContent *content);
+int GetFileContent(Widget shell, const char *path, const char *encoding, const char *filter_name, int allowMap, FileContent *content);
+void FreeFileContent(FileContent *content);
 
 #endif /* NEDIT_FILE_H_INCLUDED */
@@ -921,7 +921,8 @@ static void searchHelpAgainCB(Widget w, XtPointer clientData,
 
 static void printCB(Widget w, XtPointer clientData, XtPointer callData)
 {
-    int topic, helpStringLen;
+    int topic;
+    ssize_t helpStringLen;
     char *helpString;
     
     if ((topic = findTopicFromShellWidget((Widget)clientData)) == -1)
@@ -983,13 +984,13 @@ static void followHyperlink(int topic, int charPosition, int newWindow)
     int    link_pos;
     int end        = charPosition;
     int begin      = charPosition;
-    char whatStyle = BufGetCharacter(textD->styleBuffer, end);
+    char whatStyle = StyleBufGetCharacter(textD->styleBuffer, end);
     
     /*--------------------------------------------------
     * Locate beginning and ending of current text style.
     *--------------------------------------------------*/
-    while (whatStyle == BufGetCharacter(textD->styleBuffer, ++end));
-    while (whatStyle == BufGetCharacter(textD->styleBuffer, begin-1))  begin--;
+    while (whatStyle == StyleBufGetCharacter(textD->styleBuffer, ++end));
+    while (whatStyle == StyleBufGetCharacter(textD->styleBuffer, begin-1))  begin--;
 
     link_text = BufGetRange (textD->buffer, begin, end);
     
@@ -1121,7 +1122,7 @@ static void helpHyperlinkAP(Widget w, XEvent *event, String *args,
     
     clickedPos = TextDXYToCharPos(textD, e->x, e->y);
     /* Beware of possible EBCDIC coding! Use the mapping table. */
-    if (BufGetCharacter(textD->styleBuffer, clickedPos) != 
+    if (StyleBufGetCharacter(textD->styleBuffer, clickedPos) != 
            (char)AlphabetToAsciiTable[(unsigned char)STL_NM_LINK])
     {
         if (*nArgs == 3)
@@ -1175,7 +1176,8 @@ void InstallHelpLinkActions(XtAppContext context)
 static void searchHelpText(Widget parent, int parentTopic,
         const char *searchFor, int allSections, int startPos, int startTopic)
 {    
-    int topic, beginMatch, endMatch;
+    int topic;
+    ssize_t beginMatch, endMatch;
     int found = False;
     char * helpText  = NULL;
     
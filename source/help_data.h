@@ -2305,6 +2305,11 @@ static char * htxt_macro_subrs [] = {
 "\01A\01B$font_name_italic\01A\n",
 "\01IContains the current italic text font name. ",
 "\n\n",
+"\01A\01B$highlight_cache_hits, $highlight_cache_misses\01A\n",
+"\01IThe number of times a window's syntax highlighting patterns were found ",
+"already compiled for another window, and shared with it, and the number of ",
+"times they had to be compiled. ",
+"\n\n",
 "\01A\01B$highlight_syntax\01A\n",
 "\01IWhether syntax highlighting is turned on. ",
 "\n\n",
@@ -2358,6 +2363,11 @@ static char * htxt_macro_subrs [] = {
 "\01A\01B$read_only\01A\n",
 "\01ITrue if the file is read only. ",
 "\n\n",
+"\01A\01B$regex_cache_hits, $regex_cache_misses\01A\n",
+"\01IThe number of times a regular expression used for searching or replacing ",
+"was found already compiled in XNEdit's cache of recently used expressions, ",
+"and the number of times one had to be compiled. ",
+"\n\n",
 "\01A\01B$selection_start, $selection_end\01A\n",
 "\01IBeginning and ending positions of the ",
 "primary selection in the current window, or ",
@@ -2454,6 +2464,20 @@ static char * htxt_macro_subrs [] = {
 "first button is number 1), or 0 if the user closed the dialog via the window ",
 "close box. ",
 "\n\n",
+"\01A\01Bexport_highlighting( filename [, format[, threads]] )\01A\n",
+"\01IWrites the text of the current window to the file \01Kfilename\01I, syntax ",
+"highlighted with the patterns of its language mode, whether or not syntax ",
+"highlighting is turned on in the window. \01Kformat\01I is \"html\" (the default) ",
+"for an HTML page, or \"ansi\" for text with ANSI color escape sequences, for ",
+"viewing in a terminal. Large files are split into chunks which are ",
+"highlighted in parallel by \01Kthreads\01I threads, by default one per processor. ",
+"Returns 1 on success, or 0 if the file could not be written or the ",
+"language mode has no highlight patterns, in which case the file is left ",
+"alone. highlight_profile(\"export\") returns the time the export took. To ",
+"export a file from the command line: ",
+"\n\n",
+"    xnedit -do 'export_highlighting(\"file.c.html\"); exit()' file.c\n",
+"\n\n",
 "\01A\01Bfilename_dialog( [title[, mode[, defaultPath[, filter[, defaultName]]]]] )\01A\n",
 "\01IPresents a file selection dialog with the given title to the user that ",
 "prompts for a new or existing file. ",
@@ -2496,6 +2520,25 @@ static char * htxt_macro_subrs [] = {
 "\01A\01Bgetenv( name )\01A\n",
 "\01IGets the value of an environment variable. ",
 "\n\n",
+"\01A\01Bhighlight_profile( [action[, sort_key]] )\01A\n",
+"\01IProfiles the syntax highlighting patterns, to find the ones which make ",
+"highlighting slow. With action \"on\", the searches made for each pattern are ",
+"counted from then on as text is highlighted, until \"off\". \"reset\" clears ",
+"the counts, and \"parse\" counts a complete parse of the text of the current ",
+"window with all of its patterns. \"report\" (the default) returns the counts ",
+"as text, one line per pattern: how many searches were made for it (for its ",
+"end and error expressions too), how many times it matched, how many start ",
+"positions the searches tried, and the time they took. \"Inner\" is the time ",
+"spent searching for the pattern's sub-patterns, all together. The report is ",
+"sorted by \01Ksort_key\01I, one of \"time\" (the default), \"inner\", \"attempts\", ",
+"\"matches\", \"bytes\", or \"name\". Counting takes time of its own, so profile ",
+"with the patterns under suspicion, not while editing. \"export\" returns the ",
+"timing of the last export_highlighting: the time taken and the rate in MB/s ",
+"as a whole and for parsing, and the rate of each thread while it was busy. ",
+"To profile from the command line: ",
+"\n\n",
+"    xnedit -do 'highlight_profile(\"parse\"); t_print(highlight_profile()); exit()' file.c\n",
+"\n\n",
 "\01A\01Bkill_calltip( [calltip_ID] )\01A\n",
 "\01IKills any calltip that is being displayed in the window in which the macro is ",
 "running.  If there is no displayed calltip this does nothing.  If a calltip ",
@@ -2528,6 +2571,19 @@ static char * htxt_macro_subrs [] = {
 "$read_status, and the contents of the file as a string in the subroutine ",
 "return value. On failure, returns the empty string \"\" and an 0 $read_status. ",
 "\n\n",
+"\01A\01Brender_stats( [action] )\01A\n",
+"\01IMeasures the drawing of the text pane with the keyboard focus, to find out ",
+"what makes scrolling or typing slow. \"report\" (the default) returns, as ",
+"text, how many lines have been drawn since the counts were last cleared, ",
+"how many of them were long lines and how often drawing a long line could ",
+"resume from a remembered position part way along it, the average number of ",
+"characters measured to draw a line, and the number of frames drawn (the ",
+"drawing done for one batch of input or expose events) with the average and ",
+"longest time spent drawing each. In continuous wrap mode it also tells how ",
+"many blocks of lines have been counted in the background, how many are left ",
+"to count, and the total and longest time spent counting at once. \"reset\" ",
+"clears the counts. ",
+"\n\n",
 "\01A\01Breplace_in_string( string, search_for, replace_with [, type, \"copy\"] )\01A\n",
 "\01IReplaces all occurrences of a search string in a string with a replacement ",
 "string. Arguments are 1: string to search in, 2: string to search for, 3: ",
@@ -34,6 +34,7 @@
 #include "highlight.h"
 #include "textBuf.h"
 #include "textDisp.h"
+#include "styleBuf.h"
 #include "text.h"
 #include "textP.h"
 #include "nedit.h"
@@ -44,6 +45,7 @@
 #include "../util/misc.h"
 #include "../util/DialogF.h"
 #include "../util/nedit_malloc.h"
+#include "../util/utils.h"
 
 #include <stdio.h>
 #include <limits.h>
@@ -56,6 +58,8 @@
 #endif
 
 #include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <Xm/Xm.h>
 #include <Xm/XmP.h>
@@ -75,6 +79,37 @@
    This distance is increased by a factor of two for each subsequent step. */
 #define REPARSE_CHUNK_SIZE 80
 
+/* Pass 1 parsing is done lazily: only this much of the buffer is parsed when
+   highlighting is turned on, and the rest in chunks of the same size by a
+   worker thread (see pass1Worker), or when the application is idle if the
+   thread can't be started (see pass1WorkProc) */
+#define PASS_1_CHUNK_SIZE 65536
+
+/* Interval (ms) at which results from the pass 1 worker thread are collected */
+#define PASS_1_POLL_INTERVAL 50
+
+/* Text which is displayed before the background parse has reached it is
+   parsed provisionally, starting at most PASS_1_VIEW_CONTEXT characters back
+   from the first unparsed character, and styling PASS_1_VIEW_SIZE characters
+   from there on.  The last PASS_1_MAX_VIEWS such regions are remembered.
+   Text less than PASS_1_CHUNK_SIZE beyond the background parse is parsed
+   properly instead */
+#define PASS_1_VIEW_SIZE 32768
+#define PASS_1_VIEW_CONTEXT 16384
+#define PASS_1_MAX_VIEWS 8
+
+/* Re-parsing after modifications made in a batch (BufBeginModifyBatch), or
+   in a burst of more than this many modifications without the application
+   becoming idle, is put off until the end of the batch or burst, and done
+   once for all of them (see flushPendingReparse) */
+#define REPARSE_BURST_SIZE 16
+
+/* ExportHighlighting splits text into about this many chunks per thread,
+   so that threads finishing early can take more, but no smaller than
+   EXPORT_MIN_CHUNK characters */
+#define EXPORT_CHUNKS_PER_THREAD 4
+#define EXPORT_MIN_CHUNK 65536
+
 /* Meanings of style buffer characters (styles). Don't use plain 'A' or 'B';
    it causes problems with EBCDIC coding (possibly negative offsets when 
    subtracting 'A'). */
@@ -97,6 +132,20 @@
 #define CAN_CROSS_LINE_BOUNDARIES(contextRequirements) \
     	(contextRequirements->nLines != 1 || contextRequirements->nChars != 0)
 
+/* Search counts for one highlight pattern of a language mode, collected
+   while profiling is on (see SetHighlightProfiling).  Kept for the life of
+   the program, so the counts survive the patterns being recompiled */
+typedef struct _patternProfile {
+    char *languageMode;
+    char *name;
+    unsigned long attempts;	/* searches for its start (and end) */
+    unsigned long matches;	/* times the pattern was actually started */
+    unsigned long long bytes;	/* start positions tried by the searches */
+    double time;		/* seconds spent in those searches */
+    double innerTime;		/* seconds searching for its sub-patterns */
+    struct _patternProfile *next;
+} patternProfile;
+
 /* "Compiled" version of pattern specification */
 typedef struct _highlightDataRec {
     regexp *startRE;
@@ -112,44 +161,232 @@ typedef struct _highlightDataRec {
     int nSubBranches; /* Number of top-level branches of subPatternRE */
     int userStyleIndex;
     struct _highlightDataRec **subPatterns;
+    patternProfile *profile;	/* counts for the profiler, or NULL */
 } highlightDataRec;
 
+/* A piece of the text exported by ExportHighlighting */
+typedef struct {
+    ssize_t start;		/* the chunk itself */
+    ssize_t end;
+    ssize_t parseStart;		/* text given to the thread for the pass, */
+    ssize_t parseEnd;		/*   with context on either side */
+    char *styles;		/* styles from parseStart on */
+    char *output;		/* formatted text of the chunk, without */
+    size_t outputLen;		/*   the markup starting its first style */
+    size_t outputAlloc;		/*   and ending its last */
+    const char *firstStyle;	/* markup of its first and last styles */
+    const char *lastStyle;
+} exportChunk;
+
 /* Context requirements for incremental reparsing of a pattern set */
 typedef struct {
     int nLines;
     int nChars;
 } reparseContext;
 
+/* Compiled patterns of a pattern set, shared by all of the windows which
+   are highlighted with it (see getCompiledPatterns).  Matching a regular
+   expression leaves the results in the compiled expression, which does no
+   harm while windows are parsed one at a time, but pass 1 worker threads
+   need a private copy (see copyCompiledPatterns) */
+typedef struct _compiledPatterns {
+    int refCount;
+    patternSet *patSet;		/* set compiled, NULL if not in the cache */
+    int *styleIndices;		/* userStyleIndex of each of its patterns */
+    highlightDataRec *pass1Patterns;
+    highlightDataRec *pass2Patterns;
+    char *parentStyles;
+    int nParentStyles;
+    struct _compiledPatterns *next;
+} compiledPatterns;
+
 /* Data structure attached to window to hold all syntax highlighting
    information (for both drawing and incremental reparsing) */
 typedef struct {
     highlightDataRec *pass1Patterns;
     highlightDataRec *pass2Patterns;
     char *parentStyles;
+    compiledPatterns *compiled;	/* holds the three above */
     reparseContext contextRequirements;
     styleTableEntry *styleTable;
     int nStyles;
-    textBuffer *styleBuffer;
+    styleBuffer *styleBuffer;
     patternSet *patternSetForWindow;
+    ssize_t pass1ParsedTo;	/* pass 1 parse is complete up to here */
+    XtWorkProcId pass1WorkProc;	/* background parse of the rest */
+    struct _pass1Job *pass1Job;	/* ... or the same in a worker thread */
+    XtIntervalId pass1Timer;	/* collects results from pass1Job */
+    unsigned long generation;	/* count of buffer modifications */
+    unsigned long pass1TimerGeneration; /* generation at last pass1Timer */
+    int nViews;			/* provisionally parsed regions beyond */
+    ssize_t viewStart[PASS_1_MAX_VIEWS];	/* pass1ParsedTo */
+    ssize_t viewEnd[PASS_1_MAX_VIEWS];
+    int modifyBatchDepth;	/* nesting of modification batches */
+    int nBurstMods;		/* modifications since the application was idle */
+    int nPending;		/* modified ranges waiting to be re-parsed, */
+    int pendingAlloc;		/*   in order and not overlapping */
+    ssize_t *pendingStart;
+    ssize_t *pendingEnd;
+    int redisplayPending;	/* styles were changed by re-parsing the above
+    				   and have not been redrawn */
+    XtWorkProcId reparseWorkProc; /* re-parses when the application is idle */
 } windowHighlightData;
 
+/* Styles parsed by a pass 1 worker thread, for buffer positions start
+   through end */
+typedef struct _pass1Result {
+    ssize_t start;
+    ssize_t end;
+    char *styles;
+    struct _pass1Result *next;
+} pass1Result;
+
+/* Work shared by the threads of ExportHighlighting.  Threads take chunks in
+   turn, and each has its own copy of the compiled patterns */
+typedef struct {
+    pthread_mutex_t lock;	/* protects nextChunk */
+    const char *text;
+    exportChunk *chunks;
+    int nChunks;
+    int nextChunk;
+    int pass;			/* 1: provisional pass 1 parse of each chunk,
+    				   2: pass 2 parse and formatting */
+    const char *delimiters;
+    int format;
+    char **styleStart;		/* markup starting and ending each style, */
+    const char *styleEnd;	/*   NULL for plain text */
+    int nStyles;
+} exportWork;
+
+typedef struct {
+    exportWork *work;
+    compiledPatterns *compiled;
+    pthread_t thread;
+    double busyTime;		/* seconds spent parsing and formatting */
+} exportThread;
+
+/* Timing of the last ExportHighlighting, for ExportHighlightingReport */
+typedef struct {
+    ssize_t bytes;
+    int nThreads;
+    int nChunks;
+    double time;		/* whole export, including writing */
+    double parseTime;		/* parsing and formatting (both passes) */
+    double busyTime;		/*   and the part of it spent in the threads */
+} exportTiming;
+
+/* Pass 1 parse of a snapshot of the buffer in a worker thread.  The thread
+   has its own copy of the compiled patterns (matching a regular expression
+   changes it) and of the style buffer.  Results are only used if the buffer
+   has not been modified since the snapshot was taken ("generation") */
+typedef struct _pass1Job {
+    pthread_t thread;
+    pthread_mutex_t lock;	/* protects cancel, finished and results */
+    windowHighlightData *highlightData;
+    textBuffer *text;
+    char *snapshot;		/* text and styles, copied into the above */
+    char *snapshotStyles;	/* by the thread */
+    ssize_t length;
+    char *delimiters;
+    unsigned long generation;
+    int cancel;
+    int finished;
+    pass1Result *results;
+    pass1Result *lastResult;
+} pass1Job;
+
 static windowHighlightData *createHighlightData(WindowInfo *window,
 	patternSet *patSet);
 static void freeHighlightData(windowHighlightData *hd);
 static patternSet *findPatternsForWindow(WindowInfo *window, int warn);
+static compiledPatterns *getCompiledPatterns(WindowInfo *window,
+    	patternSet *patSet, highlightPattern *pass1PatternSrc,
+    	int nPass1Patterns, highlightPattern *pass2PatternSrc,
+    	int nPass2Patterns);
+static compiledPatterns *compilePatternSet(WindowInfo *window,
+    	highlightPattern *pass1PatternSrc, int nPass1Patterns,
+    	highlightPattern *pass2PatternSrc, int nPass2Patterns);
+static compiledPatterns *copyCompiledPatterns(compiledPatterns *compiled);
+static void releaseCompiledPatterns(compiledPatterns *compiled);
+static void setCompiledPatterns(windowHighlightData *hd,
+    	compiledPatterns *compiled);
+static highlightDataRec *copyPatterns(highlightDataRec *patterns);
+static regexp *copyRE(regexp *re, int *ok);
 static highlightDataRec *compilePatterns(ColorProfile *colorProfile, Widget dialogParent,
     	highlightPattern *patternSrc, int nPatterns);
+static void setPatternProfiles(highlightDataRec *patterns,
+    	highlightPattern *patternSrc, int nPatterns, const char *languageMode);
+static patternProfile *getPatternProfile(const char *languageMode,
+    	const char *name);
+static void profileSearch(highlightDataRec *pattern, double elapsed,
+        int matched, const char *string, const char *end, char prevChar,
+        char succChar, const char *delimiters, const char *lookBehindTo,
+        const char *match_till);
+static void profileRE(patternProfile *profile, regexp *re,
+        const char *string, const char *end, char prevChar, char succChar,
+        const char *delimiters, const char *lookBehindTo,
+        const char *match_till);
+static void addToProfile(patternProfile *profile, unsigned long attempts,
+        unsigned long matches, unsigned long long bytes, double time,
+        double innerTime);
+static double profileClock(void);
+static int compareProfiles(const void *p1, const void *p2);
 static void freePatterns(highlightDataRec *patterns);
-static void handleUnparsedRegion(const WindowInfo* win, textBuffer* styleBuf,
-        int pos);
-static void handleUnparsedRegionCB(const textDisp* textD, int pos,
+static void handleUnparsedRegion(const WindowInfo* win, styleBuffer *styleBuf,
+        ssize_t pos);
+static void handleUnparsedRegionCB(const textDisp* textD, ssize_t pos,
         const void* cbArg);
 static void incrementalReparse(windowHighlightData *highlightData,
-    	textBuffer *buf, int pos, int nInserted, const char *delimiters);
-static int parseBufferRange(highlightDataRec *pass1Patterns,
-    	highlightDataRec *pass2Patterns, textBuffer *buf, textBuffer *styleBuf,
-        reparseContext *contextRequirements, int beginParse, int endParse,
+    	textBuffer *buf, ssize_t pos, ssize_t nInserted,
+        const char *delimiters, ssize_t parseLimit);
+static ssize_t updatePass1Extent(windowHighlightData *highlightData,
+        ssize_t pos, ssize_t nInserted, ssize_t nDeleted);
+static ssize_t parseLimitOfRange(windowHighlightData *highlightData,
+        ssize_t start, ssize_t end);
+static void addPendingReparse(windowHighlightData *highlightData,
+        ssize_t pos, ssize_t nInserted, ssize_t nDeleted, int add);
+static int inPendingReparse(windowHighlightData *highlightData, ssize_t pos);
+static void flushPendingReparse(const WindowInfo *window);
+static Boolean reparseWorkProc(XtPointer clientData);
+static void extendPass1Parse(windowHighlightData *highlightData,
+        textBuffer *buf, ssize_t endParse, const char *delimiters);
+static ssize_t parsePass1Range(windowHighlightData *highlightData,
+        highlightDataRec *pattern, textBuffer *buf, ssize_t beginParse,
+        ssize_t endParse, const char *delimiters);
+static void parseViewProvisionally(const WindowInfo *window, ssize_t pos);
+static int inProvisionalView(windowHighlightData *highlightData,
+        ssize_t pos);
+static void dropParsedViews(windowHighlightData *highlightData);
+static Boolean pass1WorkProc(XtPointer clientData);
+static void startBackgroundParse(WindowInfo *window);
+static void stopBackgroundParse(windowHighlightData *highlightData);
+static pass1Job *startPass1Job(WindowInfo *window);
+static void *pass1Worker(void *arg);
+static void pass1TimerProc(XtPointer clientData, XtIntervalId *id);
+static void freePass1Job(pass1Job *job);
+static void mergePass1Styles(windowHighlightData *highlightData,
+        char *styleString, ssize_t startPos, ssize_t endPos);
+static void redisplayStyleChanges(WindowInfo *window);
+static void runExportPass(exportWork *work, int pass, exportThread *threads,
+        int nThreads);
+static void *exportWorker(void *arg);
+static void exportChunkPass1(exportWork *work, compiledPatterns *compiled,
+        exportChunk *chunk);
+static void exportChunkPass2(exportWork *work, compiledPatterns *compiled,
+        exportChunk *chunk);
+static void stitchExportChunks(windowHighlightData *highlightData,
+        textBuffer *buf, exportChunk *chunks, int nChunks,
         const char *delimiters);
+static char *exportStyleMarkup(styleTableEntry *entry, int format);
+static void formatExportChunk(exportWork *work, exportChunk *chunk,
+        const char *text, const char *styles);
+static void appendExportOutput(exportChunk *chunk, const char *text,
+        size_t length);
+static void writeEscapedHTML(FILE *fp, const char *text);
+static ssize_t parseBufferRange(highlightDataRec *pass1Patterns,
+    	highlightDataRec *pass2Patterns, textBuffer *buf, styleBuffer *styleBuf,
+        reparseContext *contextRequirements, ssize_t beginParse,
+        ssize_t endParse, const char *delimiters);
 static int parseString(highlightDataRec *pattern, const char **string,
     	char **styleString, int length, char *prevChar, int anchored,
     	const char *delimiters, const char* lookBehindTo, const char* match_till);
@@ -158,21 +395,21 @@ static void passTwoParseString(highlightDataRec *pattern, char *string,
         const char* lookBehindTo, const char* match_till);
 static void fillStyleString(const char **stringPtr, char **stylePtr,
         const char *toPtr, char style, char *prevChar);
-static void modifyStyleBuf(textBuffer *styleBuf, char *styleString,
-    	int startPos, int endPos, int firstPass2Style);
-static int lastModified(textBuffer *styleBuf);
-static int max(int i1, int i2);
-static int min(int i1, int i2);
-static char getPrevChar(textBuffer *buf, int pos);
+static void modifyStyleBuf(styleBuffer *styleBuf, char *styleString,
+    	ssize_t startPos, ssize_t endPos, int firstPass2Style);
+static ssize_t lastModified(styleBuffer *styleBuf);
+static ssize_t max(ssize_t i1, ssize_t i2);
+static ssize_t min(ssize_t i1, ssize_t i2);
+static char getPrevChar(textBuffer *buf, ssize_t pos);
 static regexp *compileREAndWarn(Widget parent, const char *re);
 static int parentStyleOf(const char *parentStyles, int style);
 static int isParentStyle(const char *parentStyles, int style1, int style2);
 static int findSafeParseRestartPos(textBuffer *buf,
-    	windowHighlightData *highlightData, int *pos);
-static int backwardOneContext(textBuffer *buf, reparseContext *context,
-    	int fromPos);
-static int forwardOneContext(textBuffer *buf, reparseContext *context,
-    	int fromPos);
+    	windowHighlightData *highlightData, ssize_t *pos);
+static ssize_t backwardOneContext(textBuffer *buf, reparseContext *context,
+    	ssize_t fromPos);
+static ssize_t forwardOneContext(textBuffer *buf, reparseContext *context,
+    	ssize_t fromPos);
 static void recolorSubexpr(regexp *re, int subexpr, int style,
         const char *string, char *styleString);
 static int indexOfNamedPattern(highlightPattern *patList, int nPats,
@@ -184,6 +421,22 @@ static void updateWindowHeight(WindowInfo *window, int oldFontHeight);
 static int getFontHeight(WindowInfo *window);
 static styleTableEntry *styleTableEntryOfCode(WindowInfo *window, int hCode);
 
+/* Compiled pattern sets in use (see getCompiledPatterns), and how often one
+   was found there and how often one had to be compiled */
+static compiledPatterns *CompiledPatternCache = NULL;
+static unsigned long CompiledPatternHits = 0;
+static unsigned long CompiledPatternMisses = 0;
+
+/* Highlight profiler (see SetHighlightProfiling).  Counts are added by
+   pass 1 worker threads as well, under ProfileLock */
+static int HighlightProfiling = False;
+static patternProfile *PatternProfiles = NULL;
+static pthread_mutex_t ProfileLock = PTHREAD_MUTEX_INITIALIZER;
+static int ProfileSortKey;
+
+/* Timing of the last export */
+static exportTiming LastExport = {0, 0, 0, 0.0, 0.0, 0.0};
+
 /*
 ** Buffer modification callback for triggering re-parsing of modified
 ** text and keeping the style buffer synchronized with the text buffer.
@@ -204,12 +457,13 @@ static styleTableEntry *styleTableEntryOfCode(WindowInfo *window, int hCode);
 ** Note: This routine must be kept efficient.  It is called for every
 ** character typed.
 */
-void SyntaxHighlightModifyCB(int pos, int nInserted, int nDeleted,
-    	int nRestyled, const char *deletedText, void *cbArg) 
+void SyntaxHighlightModifyCB(ssize_t pos, ssize_t nInserted, ssize_t nDeleted,
+    	ssize_t nRestyled, const char *deletedText, void *cbArg) 
 {    
     WindowInfo *window = (WindowInfo *)cbArg;
     windowHighlightData 
     	    *highlightData = (windowHighlightData *)window->highlightData;
+    ssize_t parseLimit;
     
     if(window->ansiColors) {
         BufParseEscSeq(window->buffer, pos, nInserted, nDeleted);
@@ -218,41 +472,79 @@ void SyntaxHighlightModifyCB(int pos, int nInserted, int nDeleted,
     if (highlightData == NULL)
     	return;
     	
+    /* Results of parsing the buffer as it was before are now of no use */
+    if (nInserted != 0 || nDeleted != 0)
+    	highlightData->generation++;
+    
     /* Restyling-only modifications (usually a primary or secondary  selection)
        don't require any processing, but clear out the style buffer selection
        so the widget doesn't think it has to keep redrawing the old area */
     if (nInserted == 0 && nDeleted == 0) {
-    	BufUnselect(highlightData->styleBuffer);
+    	StyleBufUnselect(highlightData->styleBuffer);
     	return;
     }
     
     /* First and foremost, the style buffer must track the text buffer
        accurately and correctly */
-    if (nInserted > 0) {
-        char *insStyle;
-        int i;
-
-    	insStyle = (char*)NEditMalloc(nInserted + 1);
-    	for (i=0; i<nInserted; i++)
-    	    insStyle[i] = UNFINISHED_STYLE;
-    	insStyle[i] = '\0';
-    	BufReplace(highlightData->styleBuffer, pos, pos+nDeleted, insStyle);
-    	NEditFree(insStyle);
-    } else {
-    	BufRemove(highlightData->styleBuffer, pos, pos+nDeleted);
-    }
+    StyleBufFill(highlightData->styleBuffer, pos, pos+nDeleted,
+    	    UNFINISHED_STYLE, nInserted);
 
     /* Mark the changed region in the style buffer as requiring redraw.  This
        is not necessary for getting it redrawn, it will be redrawn anyhow by
        the text display callback, but it clears the previous selection and
        saves the modifyStyleBuf routine from unnecessary work in tracking
        changes that are already scheduled for redraw */
-    BufSelect(highlightData->styleBuffer, pos, pos+nInserted);
+    StyleBufSelect(highlightData->styleBuffer, pos, pos+nInserted);
     
-    /* Re-parse around the changed region */
-    if (highlightData->pass1Patterns)
-    	incrementalReparse(highlightData, window->buffer, pos, nInserted,
-    	    	GetWindowDelimiters(window));
+    /* Re-parse around the changed region, unless it is in text which has
+       not been parsed yet.  In a batch of modifications, or a long burst of
+       them, just note the region, to be re-parsed with the others at the
+       end of the batch or when the application is next idle */
+    if (highlightData->pass1Patterns) {
+    	parseLimit = updatePass1Extent(highlightData, pos, nInserted,
+    	    	nDeleted);
+    	if (highlightData->reparseWorkProc == 0)
+    	    highlightData->reparseWorkProc = XtAppAddWorkProc(
+    	    	    XtWidgetToApplicationContext(window->shell),
+    	    	    reparseWorkProc, window);
+    	if (highlightData->modifyBatchDepth > 0 ||
+    	    	highlightData->nPending > 0 ||
+    	    	++highlightData->nBurstMods > REPARSE_BURST_SIZE)
+    	    addPendingReparse(highlightData, pos, nInserted, nDeleted,
+    	    	    parseLimit >= 0);
+    	else if (parseLimit >= 0)
+    	    incrementalReparse(highlightData, window->buffer, pos, nInserted,
+    	    	    GetWindowDelimiters(window), parseLimit);
+    }
+}
+
+/*
+** Buffer callbacks for the start and end of a batch of modifications
+** (BufBeginModifyBatch).  Re-parsing the modified text is put off until the
+** end of the batch, and then done for all of it at once.
+*/
+void SyntaxHighlightBeginModifyCB(void *cbArg)
+{
+    WindowInfo *window = (WindowInfo *)cbArg;
+    windowHighlightData 
+    	    *highlightData = (windowHighlightData *)window->highlightData;
+    
+    if (highlightData != NULL)
+    	highlightData->modifyBatchDepth++;
+}
+
+void SyntaxHighlightEndModifyCB(void *cbArg)
+{
+    WindowInfo *window = (WindowInfo *)cbArg;
+    windowHighlightData 
+    	    *highlightData = (windowHighlightData *)window->highlightData;
+    
+    if (highlightData == NULL || highlightData->modifyBatchDepth == 0 ||
+    	    --highlightData->modifyBatchDepth > 0)
+    	return;
+    flushPendingReparse(window);
+    if (highlightData->redisplayPending)
+    	redisplayStyleChanges(window);
 }
 
 /*
@@ -263,9 +555,6 @@ void StartHighlighting(WindowInfo *window, int warn)
 {
     patternSet *patterns;
     windowHighlightData *highlightData;
-    char *stylePtr, *styleString;
-    const char  *stringPtr, *bufString;
-    char prevChar = '\0';
     int i, oldFontHeight;
     
     /* Find the pattern set matching the window's current
@@ -283,24 +572,25 @@ void StartHighlighting(WindowInfo *window, int warn)
     BeginWait(window->shell);
     XmUpdateDisplay(window->shell);
     
-    /* Parse the buffer with pass 1 patterns.  If there are none, initialize
-       the style buffer to all UNFINISHED_STYLE to trigger parsing later */
-    stylePtr = styleString = (char*)NEditMalloc(window->buffer->length + 1);
-    if (highlightData->pass1Patterns == NULL) {
-    	for (i=0; i<window->buffer->length; i++)
-    	    *stylePtr++ = UNFINISHED_STYLE;
-    } else {
-	stringPtr = bufString = BufAsString(window->buffer);
-	parseString(highlightData->pass1Patterns, &stringPtr, &stylePtr,
-    		window->buffer->length, &prevChar, False,
-    		GetWindowDelimiters(window), bufString, NULL);
+    /* Initialize the style buffer to all UNFINISHED_STYLE to trigger
+       parsing later */
+    StyleBufFill(highlightData->styleBuffer, 0,
+    	    highlightData->styleBuffer->length, UNFINISHED_STYLE,
+	    window->buffer->length);
+
+    /* Parse the start of the buffer with pass 1 patterns, and leave the rest
+       to be parsed when the application is idle, or when it is displayed */
+    if (highlightData->pass1Patterns == NULL)
+    	highlightData->pass1ParsedTo = window->buffer->length;
+    else {
+    	extendPass1Parse(highlightData, window->buffer, PASS_1_CHUNK_SIZE,
+    	    	GetWindowDelimiters(window));
+    	StyleBufUnselect(highlightData->styleBuffer);
     }
-    *stylePtr = '\0';
-    BufSetAll(highlightData->styleBuffer, styleString);
-    NEditFree(styleString);
 
     /* install highlight pattern data in the window data structure */
     window->highlightData = highlightData;
+    startBackgroundParse(window);
     	
     /* Get the height of the current font in the window, to be used after
        highlighting is turned on to resize the window to make room for
@@ -415,12 +705,13 @@ void UpdateHighlightStyles(WindowInfo *window, Boolean redisplay)
     windowHighlightData *highlightData;
     windowHighlightData *oldHighlightData =
     	    (windowHighlightData *)window->highlightData;
-    textBuffer *styleBuffer;
+    styleBuffer *styleBuf;
     int i;
     
     /* Do nothing if window not highlighted */
     if (window->highlightData == NULL)
     	return;
+    flushPendingReparse(window);
 
     /* Find the pattern set for the window's current language mode */
     patterns = findPatternsForWindow(window, False);
@@ -440,12 +731,22 @@ void UpdateHighlightStyles(WindowInfo *window, Boolean redisplay)
        preserve all of the effort that went in to parsing the buffer
        by swapping it with the empty one in highlightData (which is then
        freed in freeHighlightData) */
-    styleBuffer = oldHighlightData->styleBuffer;
+    styleBuf = oldHighlightData->styleBuffer;
     oldHighlightData->styleBuffer = highlightData->styleBuffer;
+    highlightData->pass1ParsedTo = oldHighlightData->pass1ParsedTo;
+    highlightData->generation = oldHighlightData->generation;
+    highlightData->nViews = oldHighlightData->nViews;
+    memcpy(highlightData->viewStart, oldHighlightData->viewStart,
+    	    sizeof(highlightData->viewStart));
+    memcpy(highlightData->viewEnd, oldHighlightData->viewEnd,
+    	    sizeof(highlightData->viewEnd));
     freeHighlightData(oldHighlightData);
-    highlightData->styleBuffer = styleBuffer;
+    highlightData->styleBuffer = styleBuf;
     window->highlightData = highlightData;
     
+    /* The new patterns continue any parsing in the background */
+    startBackgroundParse(window);
+    
     /* Attach new highlight information to text widgets in each pane
        (and redraw) */
     ((TextWidget)window->textArea)->text.textD->disableRedisplay = !redisplay;
@@ -499,14 +800,15 @@ void* GetHighlightInfo(WindowInfo *window, int pos)
 	(windowHighlightData *)window->highlightData; 
     if (!highlightData)
 	return NULL;
+    flushPendingReparse(window);
     
     /* Be careful with signed/unsigned conversions. NO conversion here! */
-    style = (int)BufGetCharacter(highlightData->styleBuffer, pos);
+    style = (int)StyleBufGetCharacter(highlightData->styleBuffer, pos);
     
     /* Beware of unparsed regions. */
     if (style == UNFINISHED_STYLE) {
 	handleUnparsedRegion(window, highlightData->styleBuffer, pos);
-	style = (int)BufGetCharacter(highlightData->styleBuffer, pos);
+	style = (int)StyleBufGetCharacter(highlightData->styleBuffer, pos);
     }
 	    
     if (highlightData->pass1Patterns) {
@@ -534,13 +836,14 @@ static void freeHighlightData(windowHighlightData *hd)
 {
     if (hd == NULL)
     	return;
-    if (hd->pass1Patterns != NULL)
-    	freePatterns(hd->pass1Patterns);
-    if (hd->pass2Patterns != NULL)
-    	freePatterns(hd->pass2Patterns);
-    NEditFree(hd->parentStyles);
-    BufFree(hd->styleBuffer);
+    stopBackgroundParse(hd);
+    if (hd->reparseWorkProc != 0)
+    	XtRemoveWorkProc(hd->reparseWorkProc);
+    releaseCompiledPatterns(hd->compiled);
+    StyleBufFree(hd->styleBuffer);
     NEditFree(hd->styleTable);
+    NEditFree(hd->pendingStart);
+    NEditFree(hd->pendingEnd);
     NEditFree(hd);
 }
 
@@ -603,11 +906,10 @@ static windowHighlightData *createHighlightData(WindowInfo *window,
     int contextChars = patSet->charContext;
     int i, nPass1Patterns, nPass2Patterns;
     int noPass1, noPass2;
-    char *parentStyles, *parentStylesPtr, *parentName;
     highlightPattern *pass1PatternSrc, *pass2PatternSrc, *p1Ptr, *p2Ptr;
     styleTableEntry *styleTable, *styleTablePtr;
-    textBuffer *styleBuf;
-    highlightDataRec *pass1Pats, *pass2Pats;
+    styleBuffer *styleBuf;
+    compiledPatterns *compiled;
     windowHighlightData *highlightData;
     ColorProfile *colorprofile = window->colorProfile;
     
@@ -714,59 +1016,17 @@ static windowHighlightData *createHighlightData(WindowInfo *window,
     if (nPass2Patterns == 1)
     	nPass2Patterns = 0;
 
-    /* Compile patterns */
-    if (nPass1Patterns == 0)
-    	pass1Pats = NULL;
-    else {
-	pass1Pats = compilePatterns(window->colorProfile, window->shell, pass1PatternSrc,
-    		nPass1Patterns);
-	if (pass1Pats == NULL)
-    	    return NULL;
-    }
-    if (nPass2Patterns == 0)
-    	pass2Pats = NULL;
-    else {
-	pass2Pats = compilePatterns(window->colorProfile, window->shell, pass2PatternSrc,
-    		nPass2Patterns);  
-	if (pass2Pats == NULL)
-    	    return NULL;
+    /* Compile the patterns, or share them with other windows highlighted
+       with the same pattern set */
+    compiled = getCompiledPatterns(window, patSet, pass1PatternSrc,
+    	    nPass1Patterns, pass2PatternSrc, nPass2Patterns);
+    if (compiled == NULL) {
+    	NEditFree(pass1PatternSrc);
+    	NEditFree(pass2PatternSrc);
+    	return NULL;
     }
-    
-    /* Set pattern styles.  If there are pass 2 patterns, pass 1 pattern
-       0 should have a default style of UNFINISHED_STYLE.  With no pass 2
-       patterns, unstyled areas of pass 1 patterns should be PLAIN_STYLE
-       to avoid triggering re-parsing every time they are encountered */
     noPass1 = nPass1Patterns == 0;
     noPass2 = nPass2Patterns == 0;
-    if (noPass2)
-    	pass1Pats[0].style = PLAIN_STYLE;
-    else if (noPass1)
-    	pass2Pats[0].style = PLAIN_STYLE;
-    else {
-	pass1Pats[0].style = UNFINISHED_STYLE;
-	pass2Pats[0].style = PLAIN_STYLE;
-    }
-    for (i=1; i<nPass1Patterns; i++)
-       	pass1Pats[i].style = PLAIN_STYLE + i;
-    for (i=1; i<nPass2Patterns; i++)
-       	pass2Pats[i].style = PLAIN_STYLE + (noPass1 ? 0 : nPass1Patterns-1) + i;
-    
-    /* Create table for finding parent styles */
-    parentStylesPtr = parentStyles = (char*)NEditMalloc(nPass1Patterns+nPass2Patterns+2);
-    *parentStylesPtr++ = '\0';
-    *parentStylesPtr++ = '\0';
-    for (i=1; i<nPass1Patterns; i++) {
-	parentName = pass1PatternSrc[i].subPatternOf;
-	*parentStylesPtr++ = parentName == NULL ? PLAIN_STYLE :
-		pass1Pats[indexOfNamedPattern(pass1PatternSrc,
-		nPass1Patterns, parentName)].style;
-    }
-    for (i=1; i<nPass2Patterns; i++) {
-	parentName = pass2PatternSrc[i].subPatternOf;
-	*parentStylesPtr++ = parentName == NULL ? PLAIN_STYLE :
-		pass2Pats[indexOfNamedPattern(pass2PatternSrc,
-		nPass2Patterns, parentName)].style;
-    }
     
     /* Set up table for mapping colors and fonts to syntax */
     styleTablePtr = styleTable = (styleTableEntry *)NEditMalloc(
@@ -830,546 +1090,2325 @@ static windowHighlightData *createHighlightData(WindowInfo *window,
     NEditFree(pass2PatternSrc);
     
     /* Create the style buffer */
-    styleBuf = BufCreate();
+    styleBuf = StyleBufCreate();
     
     /* Collect all of the highlighting information in a single structure */
     highlightData =(windowHighlightData *)NEditMalloc(sizeof(windowHighlightData));
-    highlightData->pass1Patterns = pass1Pats;
-    highlightData->pass2Patterns = pass2Pats;
-    highlightData->parentStyles = parentStyles;
+    setCompiledPatterns(highlightData, compiled);
     highlightData->styleTable = styleTable;
     highlightData->nStyles = styleTablePtr - styleTable;
     highlightData->styleBuffer = styleBuf;
     highlightData->contextRequirements.nLines = contextLines;
     highlightData->contextRequirements.nChars = contextChars;
     highlightData->patternSetForWindow = patSet;
+    highlightData->pass1ParsedTo = 0;
+    highlightData->pass1WorkProc = 0;
+    highlightData->pass1Job = NULL;
+    highlightData->pass1Timer = 0;
+    highlightData->generation = 0;
+    highlightData->pass1TimerGeneration = 0;
+    highlightData->nViews = 0;
+    highlightData->modifyBatchDepth = 0;
+    highlightData->nBurstMods = 0;
+    highlightData->nPending = 0;
+    highlightData->pendingAlloc = 0;
+    highlightData->pendingStart = NULL;
+    highlightData->pendingEnd = NULL;
+    highlightData->redisplayPending = False;
+    highlightData->reparseWorkProc = 0;
     
     return highlightData;
 }
 
 /*
-** Transform pattern sources into the compiled highlight information
-** actually used by the code.  Output is a tree of highlightDataRec structures
-** containing compiled regular expressions and style information.
+** Find the compiled form of the pattern set "patSet" (sorted into pass 1 and
+** pass 2 patterns by createHighlightData) in the cache of compiled pattern
+** sets, or compile it and add it to the cache.  The pattern numbers of the
+** styles in the window's color profile are compiled in too, so a set
+** compiled for another profile is only shared if those are the same.
+** Release with releaseCompiledPatterns.  Returns NULL if the patterns don't
+** compile, after telling the user.
 */
-static highlightDataRec *compilePatterns(ColorProfile *colorProfile, Widget dialogParent,
-    	highlightPattern *patternSrc, int nPatterns)
+static compiledPatterns *getCompiledPatterns(WindowInfo *window,
+    	patternSet *patSet, highlightPattern *pass1PatternSrc,
+    	int nPass1Patterns, highlightPattern *pass2PatternSrc,
+    	int nPass2Patterns)
 {
-    int i, nSubExprs, patternNum, length, subPatIndex, subExprNum, charsRead;
-    int parentIndex;
-    char *ptr, *bigPattern, *compileMsg;
-    highlightDataRec *compiledPats;
+    compiledPatterns *compiled;
+    int i, *styleIndices, nStyleIndices = patSet->nPatterns + 1;
     
-    /* Allocate memory for the compiled patterns.  The list is terminated
-       by a record with style == 0. */
-    compiledPats = (highlightDataRec *)NEditMalloc(sizeof(highlightDataRec) *
-    	    (nPatterns + 1));
-    compiledPats[nPatterns].style = 0;
+    styleIndices = (int *)NEditMalloc(sizeof(int) * nStyleIndices);
+    for (i=0; i<patSet->nPatterns; i++)
+    	styleIndices[i] = IndexOfNamedStyle(window->colorProfile,
+    	    	patSet->patterns[i].style);
+    styleIndices[i] = IndexOfNamedStyle(window->colorProfile, "Plain");
     
-    /* Build the tree of parse expressions */
-    for (i=0; i<nPatterns; i++) {
-    	compiledPats[i].nSubPatterns = 0;
-    	compiledPats[i].nSubBranches = 0;
-    }
-    for (i=1; i<nPatterns; i++)
-    	if (patternSrc[i].subPatternOf == NULL)
-    	    compiledPats[0].nSubPatterns++;
-    	else
-    	    compiledPats[indexOfNamedPattern(patternSrc, nPatterns,
-    	    	    patternSrc[i].subPatternOf)].nSubPatterns++;
-    for (i=0; i<nPatterns; i++)
-    	compiledPats[i].subPatterns = compiledPats[i].nSubPatterns == 0 ?
-    	    	NULL : (highlightDataRec **)NEditMalloc(
-    	    	    sizeof(highlightDataRec *) * compiledPats[i].nSubPatterns);
-    for (i=0; i<nPatterns; i++)
-    	compiledPats[i].nSubPatterns = 0;
-    for (i=1; i<nPatterns; i++) {
-    	if (patternSrc[i].subPatternOf == NULL) {
-    	    compiledPats[0].subPatterns[compiledPats[0].nSubPatterns++] =
-    	    		&compiledPats[i];
-    	} else {
-    	    parentIndex = indexOfNamedPattern(patternSrc,
-    	    	    nPatterns, patternSrc[i].subPatternOf);
-    	    compiledPats[parentIndex].subPatterns[compiledPats[parentIndex].
-    	    	    nSubPatterns++] = &compiledPats[i];
+    for (compiled=CompiledPatternCache; compiled!=NULL;
+    	    compiled=compiled->next) {
+    	if (compiled->patSet == patSet && !memcmp(compiled->styleIndices,
+    	    	styleIndices, sizeof(int) * nStyleIndices)) {
+    	    NEditFree(styleIndices);
+    	    compiled->refCount++;
+    	    CompiledPatternHits++;
+    	    return compiled;
     	}
     }
     
-    /* Process color-only sub patterns (no regular expressions to match,
-       just colors and fonts for sub-expressions of the parent pattern */
-    for (i=0; i<nPatterns; i++) {
-        compiledPats[i].colorOnly = patternSrc[i].flags & COLOR_ONLY;
-        compiledPats[i].userStyleIndex = IndexOfNamedStyle(colorProfile, patternSrc[i].style);
-        if (compiledPats[i].colorOnly && compiledPats[i].nSubPatterns != 0)
-        {
-            DialogF(DF_WARN, dialogParent, 1, "Color-only Pattern",
-                    "Color-only pattern \"%s\" may not have subpatterns", 
-                    "OK", patternSrc[i].name);
-            return NULL;
-        }
-        nSubExprs = 0;
-        if (patternSrc[i].startRE != NULL) {
-            ptr = patternSrc[i].startRE;
-            while(TRUE) {
-		if (*ptr == '&') {
-		    compiledPats[i].startSubexprs[nSubExprs++] = 0;
-		    ptr++;
-		} else if (sscanf(ptr, "\\%d%n", &subExprNum, &charsRead)==1) {
-        	    compiledPats[i].startSubexprs[nSubExprs++] = subExprNum;
-        	    ptr += charsRead;
-		} else
-		    break;
-            }
-        }
-        compiledPats[i].startSubexprs[nSubExprs] = -1;
-        nSubExprs = 0;
-        if (patternSrc[i].endRE != NULL) {
-            ptr = patternSrc[i].endRE;
-            while(TRUE) {
-		if (*ptr == '&') {
-		    compiledPats[i].endSubexprs[nSubExprs++] = 0;
-		    ptr++;
-		} else if (sscanf(ptr, "\\%d%n", &subExprNum, &charsRead)==1) {
-        	    compiledPats[i].endSubexprs[nSubExprs++] = subExprNum;
-        	    ptr += charsRead;
-		} else
-		    break;
-            }
-        }
-        compiledPats[i].endSubexprs[nSubExprs] = -1;
+    compiled = compilePatternSet(window, pass1PatternSrc, nPass1Patterns,
+    	    pass2PatternSrc, nPass2Patterns);
+    if (compiled == NULL) {
+    	NEditFree(styleIndices);
+    	return NULL;
     }
+    CompiledPatternMisses++;
+    if (compiled->pass1Patterns != NULL)
+    	setPatternProfiles(compiled->pass1Patterns, pass1PatternSrc,
+    	    	nPass1Patterns, patSet->languageMode);
+    if (compiled->pass2Patterns != NULL)
+    	setPatternProfiles(compiled->pass2Patterns, pass2PatternSrc,
+    	    	nPass2Patterns, patSet->languageMode);
+    compiled->patSet = patSet;
+    compiled->styleIndices = styleIndices;
+    compiled->next = CompiledPatternCache;
+    CompiledPatternCache = compiled;
+    return compiled;
+}
 
-    /* Compile regular expressions for all highlight patterns */
-    for (i=0; i<nPatterns; i++) {
-	if (patternSrc[i].startRE == NULL || compiledPats[i].colorOnly)
-	    compiledPats[i].startRE = NULL;
-	else {
-	    if ((compiledPats[i].startRE = compileREAndWarn(dialogParent,
-	    	    patternSrc[i].startRE)) == NULL)
-   		return NULL;
-    	}
-    	if (patternSrc[i].endRE == NULL || compiledPats[i].colorOnly)
-    	    compiledPats[i].endRE = NULL;
-    	else {
-    	    if ((compiledPats[i].endRE = compileREAndWarn(dialogParent,
-    	    	    patternSrc[i].endRE)) == NULL)
- 		return NULL;
-    	}
-    	if (patternSrc[i].errorRE == NULL)
-    	    compiledPats[i].errorRE = NULL;
-    	else {
-    	    if ((compiledPats[i].errorRE = compileREAndWarn(dialogParent,
-    	    	    patternSrc[i].errorRE)) == NULL)
- 		return NULL;
-    	}
-    }
+/*
+** Compile pass 1 and pass 2 patterns, and set up their styles and the table
+** of parent styles.  The result is not in the cache, and has a reference
+** count of 1.
+*/
+static compiledPatterns *compilePatternSet(WindowInfo *window,
+    	highlightPattern *pass1PatternSrc, int nPass1Patterns,
+    	highlightPattern *pass2PatternSrc, int nPass2Patterns)
+{
+    int i, noPass1, noPass2;
+    char *parentStyles, *parentStylesPtr, *parentName;
+    highlightDataRec *pass1Pats, *pass2Pats;
+    compiledPatterns *compiled;
     
-    /* Construct and compile the great hairy pattern to match the OR of the
-       end pattern, the error pattern, and all of the start patterns of the
-       sub-patterns */
-    for (patternNum=0; patternNum<nPatterns; patternNum++) {
-	if (patternSrc[patternNum].endRE == NULL &&
-	    	patternSrc[patternNum].errorRE == NULL &&
-	    	compiledPats[patternNum].nSubPatterns == 0) {
-	    compiledPats[patternNum].subPatternRE = NULL;
-	    continue;
-	}
-	length = (compiledPats[patternNum].colorOnly ||
-	    	patternSrc[patternNum].endRE == NULL) ? 0 :
-	    	strlen(patternSrc[patternNum].endRE) + 5;
-	length += (compiledPats[patternNum].colorOnly ||
-                   patternSrc[patternNum].errorRE == NULL) ? 0 :
-	    	strlen(patternSrc[patternNum].errorRE) + 5;
-	for (i=0; i<compiledPats[patternNum].nSubPatterns; i++) {
-    	    subPatIndex = compiledPats[patternNum].subPatterns[i]-compiledPats;
-    	    length += compiledPats[subPatIndex].colorOnly ? 0 :
-    	    	    strlen(patternSrc[subPatIndex].startRE) + 5;
-	}
-	if (length == 0) {
-	    compiledPats[patternNum].subPatternRE = NULL;
-	    continue;
+    /* Compile patterns */
+    if (nPass1Patterns == 0)
+    	pass1Pats = NULL;
+    else {
+	pass1Pats = compilePatterns(window->colorProfile, window->shell, pass1PatternSrc,
+    		nPass1Patterns);
+	if (pass1Pats == NULL)
+    	    return NULL;
+    }
+    if (nPass2Patterns == 0)
+    	pass2Pats = NULL;
+    else {
+	pass2Pats = compilePatterns(window->colorProfile, window->shell, pass2PatternSrc,
+    		nPass2Patterns);  
+	if (pass2Pats == NULL) {
+	    if (pass1Pats != NULL)
+	    	freePatterns(pass1Pats);
+    	    return NULL;
 	}
-	bigPattern = (char*)NEditMalloc(length+1);
-	ptr=bigPattern;
-	if (patternSrc[patternNum].endRE != NULL) {
-	    *ptr++ = '('; *ptr++ = '?'; *ptr++ = ':';
-    	    strcpy(ptr, patternSrc[patternNum].endRE);
-    	    ptr += strlen(patternSrc[patternNum].endRE);
-    	    *ptr++ = ')';
-    	    *ptr++ = '|';
-	    compiledPats[patternNum].nSubBranches++;
-	}
-	if (patternSrc[patternNum].errorRE != NULL) {
-	    *ptr++ = '('; *ptr++ = '?'; *ptr++ = ':';
-    	    strcpy(ptr, patternSrc[patternNum].errorRE);
-    	    ptr += strlen(patternSrc[patternNum].errorRE);
-    	    *ptr++ = ')';
-    	    *ptr++ = '|';
-	    compiledPats[patternNum].nSubBranches++;
-	}
-	for (i=0; i<compiledPats[patternNum].nSubPatterns; i++) {
-    	    subPatIndex = compiledPats[patternNum].subPatterns[i]-compiledPats;
-    	    if (compiledPats[subPatIndex].colorOnly)
-    	    	continue;
-	    *ptr++ = '('; *ptr++ = '?'; *ptr++ = ':';
-    	    strcpy(ptr, patternSrc[subPatIndex].startRE);
-    	    ptr += strlen(patternSrc[subPatIndex].startRE);
-    	    *ptr++ = ')';
-    	    *ptr++ = '|';
-	    compiledPats[patternNum].nSubBranches++;
-	}
-	*(ptr-1) = '\0';
-	compiledPats[patternNum].subPatternRE = CompileRE(bigPattern,
-	    	&compileMsg, REDFLT_STANDARD);
-	if (compiledPats[patternNum].subPatternRE == NULL) {
-    	    fprintf(stderr, "Error compiling syntax highlight patterns:\n%s",
-    	    	    compileMsg);
-    	    return NULL;
-	}
-	NEditFree(bigPattern);
     }
     
-    /* Copy remaining parameters from pattern template to compiled tree */
+    /* Set pattern styles.  If there are pass 2 patterns, pass 1 pattern
+       0 should have a default style of UNFINISHED_STYLE.  With no pass 2
+       patterns, unstyled areas of pass 1 patterns should be PLAIN_STYLE
+       to avoid triggering re-parsing every time they are encountered */
+    noPass1 = nPass1Patterns == 0;
+    noPass2 = nPass2Patterns == 0;
+    if (noPass2)
+    	pass1Pats[0].style = PLAIN_STYLE;
+    else if (noPass1)
+    	pass2Pats[0].style = PLAIN_STYLE;
+    else {
+	pass1Pats[0].style = UNFINISHED_STYLE;
+	pass2Pats[0].style = PLAIN_STYLE;
+    }
+    for (i=1; i<nPass1Patterns; i++)
+       	pass1Pats[i].style = PLAIN_STYLE + i;
+    for (i=1; i<nPass2Patterns; i++)
+       	pass2Pats[i].style = PLAIN_STYLE + (noPass1 ? 0 : nPass1Patterns-1) + i;
+    
+    /* Create table for finding parent styles */
+    parentStylesPtr = parentStyles = (char*)NEditMalloc(nPass1Patterns+nPass2Patterns+2);
+    *parentStylesPtr++ = '\0';
+    *parentStylesPtr++ = '\0';
+    for (i=1; i<nPass1Patterns; i++) {
+	parentName = pass1PatternSrc[i].subPatternOf;
+	*parentStylesPtr++ = parentName == NULL ? PLAIN_STYLE :
+		pass1Pats[indexOfNamedPattern(pass1PatternSrc,
+		nPass1Patterns, parentName)].style;
+    }
+    for (i=1; i<nPass2Patterns; i++) {
+	parentName = pass2PatternSrc[i].subPatternOf;
+	*parentStylesPtr++ = parentName == NULL ? PLAIN_STYLE :
+		pass2Pats[indexOfNamedPattern(pass2PatternSrc,
+		nPass2Patterns, parentName)].style;
+    }
+    
+    compiled = NEditNew(compiledPatterns);
+    compiled->refCount = 1;
+    compiled->patSet = NULL;
+    compiled->styleIndices = NULL;
+    compiled->pass1Patterns = pass1Pats;
+    compiled->pass2Patterns = pass2Pats;
+    compiled->parentStyles = parentStyles;
+    compiled->nParentStyles = nPass1Patterns+nPass2Patterns+2;
+    compiled->next = NULL;
+    return compiled;
+}
+
+/*
+** Make a private copy of compiled patterns, for matching in another thread.
+** The copy is not in the cache, and has a reference count of 1.  Returns NULL
+** if there's not enough memory.
+*/
+static compiledPatterns *copyCompiledPatterns(compiledPatterns *compiled)
+{
+    compiledPatterns *copy;
+    
+    copy = NEditNew(compiledPatterns);
+    copy->refCount = 1;
+    copy->patSet = NULL;
+    copy->styleIndices = NULL;
+    copy->pass1Patterns = copyPatterns(compiled->pass1Patterns);
+    copy->pass2Patterns = copyPatterns(compiled->pass2Patterns);
+    copy->parentStyles = (char *)NEditMalloc(compiled->nParentStyles);
+    memcpy(copy->parentStyles, compiled->parentStyles,
+    	    compiled->nParentStyles);
+    copy->nParentStyles = compiled->nParentStyles;
+    copy->next = NULL;
+    if ((compiled->pass1Patterns != NULL && copy->pass1Patterns == NULL) ||
+    	    (compiled->pass2Patterns != NULL && copy->pass2Patterns == NULL)) {
+    	releaseCompiledPatterns(copy);
+    	return NULL;
+    }
+    return copy;
+}
+
+/*
+** Give up a reference to compiled patterns, freeing them (and removing them
+** from the cache) if it was the last one
+*/
+static void releaseCompiledPatterns(compiledPatterns *compiled)
+{
+    compiledPatterns **ptr;
+    
+    if (compiled == NULL || --compiled->refCount > 0)
+    	return;
+    for (ptr=&CompiledPatternCache; *ptr!=NULL; ptr=&(*ptr)->next) {
+    	if (*ptr == compiled) {
+    	    *ptr = compiled->next;
+    	    break;
+    	}
+    }
+    if (compiled->pass1Patterns != NULL)
+    	freePatterns(compiled->pass1Patterns);
+    if (compiled->pass2Patterns != NULL)
+    	freePatterns(compiled->pass2Patterns);
+    NEditFree(compiled->parentStyles);
+    NEditFree(compiled->styleIndices);
+    NEditFree(compiled);
+}
+
+/*
+** Make "hd" use "compiled" patterns, taking over the caller's reference
+*/
+static void setCompiledPatterns(windowHighlightData *hd,
+    	compiledPatterns *compiled)
+{
+    hd->compiled = compiled;
+    hd->pass1Patterns = compiled->pass1Patterns;
+    hd->pass2Patterns = compiled->pass2Patterns;
+    hd->parentStyles = compiled->parentStyles;
+}
+
+/*
+** Stop sharing the compiled form of "patSet", which is about to be freed,
+** so that a pattern set allocated in its place isn't taken for it.  Windows
+** still highlighted with it keep their compiled patterns until they are
+** updated.
+*/
+void ForgetCompiledPatterns(patternSet *patSet)
+{
+    compiledPatterns *compiled;
+    
+    for (compiled=CompiledPatternCache; compiled!=NULL;
+    	    compiled=compiled->next)
+    	if (compiled->patSet == patSet)
+    	    compiled->patSet = NULL;
+}
+
+/*
+** Return how many times compiled highlight patterns were shared with another
+** window, and how many times they had to be compiled
+*/
+void GetHighlightCacheStats(unsigned long *hits, unsigned long *misses)
+{
+    *hits = CompiledPatternHits;
+    *misses = CompiledPatternMisses;
+}
+
+/*
+** Turn the highlight profiler on or off.  While it is on, parseString counts
+** the searches made for each highlight pattern, the start positions they
+** tried, how long they took, and how often the pattern matched.  The counts
+** are kept per language mode and pattern name, and are read with
+** HighlightProfileReport.
+*/
+void SetHighlightProfiling(int enable)
+{
+    HighlightProfiling = enable;
+}
+
+/*
+** Clear the counts of the highlight profiler
+*/
+void ResetHighlightProfile(void)
+{
+    patternProfile *profile;
+    
+    pthread_mutex_lock(&ProfileLock);
+    for (profile=PatternProfiles; profile!=NULL; profile=profile->next) {
+    	profile->attempts = profile->matches = 0;
+    	profile->bytes = 0;
+    	profile->time = profile->innerTime = 0.0;
+    }
+    pthread_mutex_unlock(&ProfileLock);
+}
+
+/*
+** Parse all of the text of "window" with its highlight patterns, pass 1
+** then pass 2, as if it had just been loaded, counting the searches in the
+** highlight profiler whether or not it is turned on.  The window's styles
+** are left alone.  Returns False if the window is not highlighted.
+*/
+int ProfileWindowHighlighting(WindowInfo *window)
+{
+    windowHighlightData *hd = (windowHighlightData *)window->highlightData;
+    char *string, *styleString, *stylePtr, prevChar;
+    const char *stringPtr, *delimiters;
+    ssize_t length;
+    int wasProfiling = HighlightProfiling;
+    
+    if (hd == NULL)
+    	return False;
+    delimiters = GetWindowDelimiters(window);
+    length = window->buffer->length;
+    string = BufGetAll(window->buffer);
+    styleString = (char*)NEditMalloc(length + 1);
+    memset(styleString, UNFINISHED_STYLE, length);
+    styleString[length] = '\0';
+    
+    HighlightProfiling = True;
+    if (hd->pass1Patterns != NULL) {
+    	prevChar = '\0';
+    	stringPtr = string;
+    	stylePtr = styleString;
+    	parseString(hd->pass1Patterns, &stringPtr, &stylePtr, length,
+    	    	&prevChar, False, delimiters, string, NULL);
+    }
+    if (hd->pass2Patterns != NULL) {
+    	prevChar = '\0';
+    	passTwoParseString(hd->pass2Patterns, string, styleString, length,
+    	    	&prevChar, delimiters, string, NULL);
+    }
+    HighlightProfiling = wasProfiling;
+    
+    NEditFree(styleString);
+    NEditFree(string);
+    return True;
+}
+
+/*
+** Return the counts of the highlight profiler as text, one line per pattern
+** that was searched for, sorted by "sortBy": "time" (the default when NULL),
+** "inner", "attempts", "matches", "bytes", or "name".  Numbers are sorted
+** largest first, names by language mode and then pattern.  Returns NULL if
+** "sortBy" is not one of these.  The caller must free the result.
+*/
+char *HighlightProfileReport(const char *sortBy)
+{
+    static const char *sortKeys[] = {"time", "inner", "attempts", "matches",
+    	    "bytes", "name", NULL};
+    patternProfile *profile, **sorted;
+    char *report, *outPtr;
+    int i, nProfiles = 0, key, modeWidth = 8, nameWidth = 7, lineLen;
+    
+    for (key=0; sortKeys[key]!=NULL; key++)
+    	if (!strcmp(sortBy == NULL ? "time" : sortBy, sortKeys[key]))
+    	    break;
+    if (sortKeys[key] == NULL)
+    	return NULL;
+    
+    /* Take a copy of the counts, so worker threads can go on adding to them
+       while they are being formatted */
+    pthread_mutex_lock(&ProfileLock);
+    for (profile=PatternProfiles; profile!=NULL; profile=profile->next)
+    	nProfiles++;
+    sorted = (patternProfile **)NEditMalloc(sizeof(patternProfile *) *
+    	    (nProfiles + 1));
+    nProfiles = 0;
+    for (profile=PatternProfiles; profile!=NULL; profile=profile->next) {
+    	if (profile->attempts == 0 && profile->innerTime == 0.0)
+    	    continue;
+    	sorted[nProfiles] = NEditNew(patternProfile);
+    	*sorted[nProfiles++] = *profile;
+    }
+    pthread_mutex_unlock(&ProfileLock);
+    
+    ProfileSortKey = key;
+    qsort(sorted, nProfiles, sizeof(patternProfile *), compareProfiles);
+    
+    for (i=0; i<nProfiles; i++) {
+    	modeWidth = max(modeWidth, strlen(sorted[i]->languageMode));
+    	nameWidth = max(nameWidth, *sorted[i]->name == '\0' ?
+    	    	strlen("(top level)") : strlen(sorted[i]->name));
+    }
+    lineLen = modeWidth + nameWidth + 128;
+    report = outPtr = (char*)NEditMalloc(lineLen * (nProfiles + 1) + 1);
+    outPtr += sprintf(outPtr, "%-*s  %-*s %12s %12s %16s %12s %12s\n",
+    	    modeWidth, "Language", nameWidth, "Pattern", "Attempts",
+    	    "Matches", "Bytes", "Time (ms)", "Inner (ms)");
+    for (i=0; i<nProfiles; i++) {
+    	profile = sorted[i];
+    	outPtr += sprintf(outPtr, "%-*s  %-*s %12lu %12lu %16llu %12.3f "
+    	    	"%12.3f\n", modeWidth, profile->languageMode, nameWidth,
+    	    	*profile->name == '\0' ? "(top level)" : profile->name,
+    	    	profile->attempts, profile->matches, profile->bytes,
+    	    	profile->time * 1000.0, profile->innerTime * 1000.0);
+    	NEditFree(profile);
+    }
+    NEditFree(sorted);
+    return report;
+}
+
+/*
+** qsort comparison function for HighlightProfileReport
+*/
+static int compareProfiles(const void *p1, const void *p2)
+{
+    const patternProfile *a = *(patternProfile **)p1;
+    const patternProfile *b = *(patternProfile **)p2;
+    int result;
+    
+    switch (ProfileSortKey) {
+    	case 1:
+    	    return a->innerTime < b->innerTime ? 1 :
+    	    	    (a->innerTime > b->innerTime ? -1 : 0);
+    	case 2:
+    	    return a->attempts < b->attempts ? 1 :
+    	    	    (a->attempts > b->attempts ? -1 : 0);
+    	case 3:
+    	    return a->matches < b->matches ? 1 :
+    	    	    (a->matches > b->matches ? -1 : 0);
+    	case 4:
+    	    return a->bytes < b->bytes ? 1 : (a->bytes > b->bytes ? -1 : 0);
+    	case 5:
+    	    result = strcmp(a->languageMode, b->languageMode);
+    	    return result != 0 ? result : strcmp(a->name, b->name);
+    	default:
+    	    return a->time < b->time ? 1 : (a->time > b->time ? -1 : 0);
+    }
+}
+
+/*
+** Point each of a newly compiled set of patterns at the profiler counts for
+** its name in "languageMode", so that the counts go on accumulating when
+** the patterns are recompiled.  Pattern 0, the top level, has no name.
+*/
+static void setPatternProfiles(highlightDataRec *patterns,
+    	highlightPattern *patternSrc, int nPatterns, const char *languageMode)
+{
+    int i;
+    
     for (i=0; i<nPatterns; i++)
-        compiledPats[i].flags = patternSrc[i].flags;
-        
-    return compiledPats;
+    	patterns[i].profile = getPatternProfile(languageMode,
+    	    	patternSrc[i].name == NULL ? "" : patternSrc[i].name);
 }
 
 /*
-** Free a pattern list and all of its allocated components
+** Find the profiler counts for pattern "name" of "languageMode", creating
+** them if they don't exist yet
 */
-static void freePatterns(highlightDataRec *patterns)
+static patternProfile *getPatternProfile(const char *languageMode,
+    	const char *name)
+{
+    patternProfile *profile;
+    
+    for (profile=PatternProfiles; profile!=NULL; profile=profile->next)
+    	if (!strcmp(profile->languageMode, languageMode) &&
+    	    	!strcmp(profile->name, name))
+    	    return profile;
+    profile = NEditNew(patternProfile);
+    profile->languageMode = NEditStrdup(languageMode);
+    profile->name = NEditStrdup(name);
+    profile->attempts = profile->matches = 0;
+    profile->bytes = 0;
+    profile->time = profile->innerTime = 0.0;
+    pthread_mutex_lock(&ProfileLock);
+    profile->next = PatternProfiles;
+    PatternProfiles = profile;
+    pthread_mutex_unlock(&ProfileLock);
+    return profile;
+}
+
+/*
+** Count a search that parseString made in "pattern", for its end, error,
+** and sub-pattern start expressions all at once, which took "elapsed"
+** seconds.  That search combines all of the expressions into one, so to
+** find what each costs, each is searched for again on its own, over the
+** same start positions: from "string" up to where the combined search
+** matched, or to "end" if it didn't.  Searches for the end and error
+** expressions are counted for "pattern" itself.
+*/
+static void profileSearch(highlightDataRec *pattern, double elapsed,
+        int matched, const char *string, const char *end, char prevChar,
+        char succChar, const char *delimiters, const char *lookBehindTo,
+        const char *match_till)
 {
+    highlightDataRec *subPat;
     int i;
     
-    for (i=0; patterns[i].style!=0; i++) {
-    	if (patterns[i].startRE != NULL)
-    	    free((char *)patterns[i].startRE);
-    	if (patterns[i].endRE != NULL)
-    	    free((char *)patterns[i].endRE);
-    	if (patterns[i].errorRE != NULL)
-    	    free((char *)patterns[i].errorRE);
-    	if (patterns[i].subPatternRE != NULL)
-    	    free((char *)patterns[i].subPatternRE);
+    if (matched)
+    	end = pattern->subPatternRE->startp[0] + 1;
+    addToProfile(pattern->profile, 0, 0, 0, 0.0, elapsed);
+    if (pattern->endRE != NULL)
+    	profileRE(pattern->profile, pattern->endRE, string, end, prevChar,
+    	    	succChar, delimiters, lookBehindTo, match_till);
+    if (pattern->errorRE != NULL)
+    	profileRE(pattern->profile, pattern->errorRE, string, end, prevChar,
+    	    	succChar, delimiters, lookBehindTo, match_till);
+    for (i=0; i<pattern->nSubPatterns; i++) {
+    	subPat = pattern->subPatterns[i];
+    	if (!subPat->colorOnly)
+    	    profileRE(subPat->profile, subPat->startRE, string, end,
+    	    	    prevChar, succChar, delimiters, lookBehindTo, match_till);
     }
+}
 
-    for (i=0; patterns[i].style!=0; i++) {
-        NEditFree(patterns[i].subPatterns);
+/*
+** Search for "re" at the start positions from "string" up to "end", and
+** add the search to "profile"
+*/
+static void profileRE(patternProfile *profile, regexp *re,
+        const char *string, const char *end, char prevChar, char succChar,
+        const char *delimiters, const char *lookBehindTo,
+        const char *match_till)
+{
+    double startTime, elapsed;
+    int matched;
+    
+    startTime = profileClock();
+    matched = ExecRE(re, string, end, False, prevChar, succChar, delimiters,
+    	    lookBehindTo, match_till);
+    elapsed = profileClock() - startTime;
+    addToProfile(profile, 1, 0, (matched ? re->startp[0] + 1 : end) - string,
+    	    elapsed, 0.0);
+}
+
+static void addToProfile(patternProfile *profile, unsigned long attempts,
+        unsigned long matches, unsigned long long bytes, double time,
+        double innerTime)
+{
+    if (profile == NULL)
+    	return;
+    pthread_mutex_lock(&ProfileLock);
+    profile->attempts += attempts;
+    profile->matches += matches;
+    profile->bytes += bytes;
+    profile->time += time;
+    profile->innerTime += innerTime;
+    pthread_mutex_unlock(&ProfileLock);
+}
+
+static double profileClock(void)
+{
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/*
+** Transform pattern sources into the compiled highlight information
+** actually used by the code.  Output is a tree of highlightDataRec structures
+** containing compiled regular expressions and style information.
+*/
+static highlightDataRec *compilePatterns(ColorProfile *colorProfile, Widget dialogParent,
+    	highlightPattern *patternSrc, int nPatterns)
+{
+    int i, nSubExprs, patternNum, length, subPatIndex, subExprNum, charsRead;
+    int parentIndex;
+    char *ptr, *bigPattern, *compileMsg;
+    highlightDataRec *compiledPats;
+    
+    /* Allocate memory for the compiled patterns.  The list is terminated
+       by a record with style == 0. */
+    compiledPats = (highlightDataRec *)NEditMalloc(sizeof(highlightDataRec) *
+    	    (nPatterns + 1));
+    compiledPats[nPatterns].style = 0;
+    
+    /* Build the tree of parse expressions */
+    for (i=0; i<nPatterns; i++) {
+    	compiledPats[i].nSubPatterns = 0;
+    	compiledPats[i].nSubBranches = 0;
+    	compiledPats[i].profile = NULL;
+    }
+    for (i=1; i<nPatterns; i++)
+    	if (patternSrc[i].subPatternOf == NULL)
+    	    compiledPats[0].nSubPatterns++;
+    	else
+    	    compiledPats[indexOfNamedPattern(patternSrc, nPatterns,
+    	    	    patternSrc[i].subPatternOf)].nSubPatterns++;
+    for (i=0; i<nPatterns; i++)
+    	compiledPats[i].subPatterns = compiledPats[i].nSubPatterns == 0 ?
+    	    	NULL : (highlightDataRec **)NEditMalloc(
+    	    	    sizeof(highlightDataRec *) * compiledPats[i].nSubPatterns);
+    for (i=0; i<nPatterns; i++)
+    	compiledPats[i].nSubPatterns = 0;
+    for (i=1; i<nPatterns; i++) {
+    	if (patternSrc[i].subPatternOf == NULL) {
+    	    compiledPats[0].subPatterns[compiledPats[0].nSubPatterns++] =
+    	    		&compiledPats[i];
+    	} else {
+    	    parentIndex = indexOfNamedPattern(patternSrc,
+    	    	    nPatterns, patternSrc[i].subPatternOf);
+    	    compiledPats[parentIndex].subPatterns[compiledPats[parentIndex].
+    	    	    nSubPatterns++] = &compiledPats[i];
+    	}
+    }
+    
+    /* Process color-only sub patterns (no regular expressions to match,
+       just colors and fonts for sub-expressions of the parent pattern */
+    for (i=0; i<nPatterns; i++) {
+        compiledPats[i].colorOnly = patternSrc[i].flags & COLOR_ONLY;
+        compiledPats[i].userStyleIndex = IndexOfNamedStyle(colorProfile, patternSrc[i].style);
+        if (compiledPats[i].colorOnly && compiledPats[i].nSubPatterns != 0)
+        {
+            DialogF(DF_WARN, dialogParent, 1, "Color-only Pattern",
+                    "Color-only pattern \"%s\" may not have subpatterns", 
+                    "OK", patternSrc[i].name);
+            return NULL;
+        }
+        nSubExprs = 0;
+        if (patternSrc[i].startRE != NULL) {
+            ptr = patternSrc[i].startRE;
+            while(TRUE) {
+		if (*ptr == '&') {
+		    compiledPats[i].startSubexprs[nSubExprs++] = 0;
+		    ptr++;
+		} else if (sscanf(ptr, "\\%d%n", &subExprNum, &charsRead)==1) {
+        	    compiledPats[i].startSubexprs[nSubExprs++] = subExprNum;
+        	    ptr += charsRead;
+		} else
+		    break;
+            }
+        }
+        compiledPats[i].startSubexprs[nSubExprs] = -1;
+        nSubExprs = 0;
+        if (patternSrc[i].endRE != NULL) {
+            ptr = patternSrc[i].endRE;
+            while(TRUE) {
+		if (*ptr == '&') {
+		    compiledPats[i].endSubexprs[nSubExprs++] = 0;
+		    ptr++;
+		} else if (sscanf(ptr, "\\%d%n", &subExprNum, &charsRead)==1) {
+        	    compiledPats[i].endSubexprs[nSubExprs++] = subExprNum;
+        	    ptr += charsRead;
+		} else
+		    break;
+            }
+        }
+        compiledPats[i].endSubexprs[nSubExprs] = -1;
+    }
+
+    /* Compile regular expressions for all highlight patterns */
+    for (i=0; i<nPatterns; i++) {
+	if (patternSrc[i].startRE == NULL || compiledPats[i].colorOnly)
+	    compiledPats[i].startRE = NULL;
+	else {
+	    if ((compiledPats[i].startRE = compileREAndWarn(dialogParent,
+	    	    patternSrc[i].startRE)) == NULL)
+   		return NULL;
+    	}
+    	if (patternSrc[i].endRE == NULL || compiledPats[i].colorOnly)
+    	    compiledPats[i].endRE = NULL;
+    	else {
+    	    if ((compiledPats[i].endRE = compileREAndWarn(dialogParent,
+    	    	    patternSrc[i].endRE)) == NULL)
+ 		return NULL;
+    	}
+    	if (patternSrc[i].errorRE == NULL)
+    	    compiledPats[i].errorRE = NULL;
+    	else {
+    	    if ((compiledPats[i].errorRE = compileREAndWarn(dialogParent,
+    	    	    patternSrc[i].errorRE)) == NULL)
+ 		return NULL;
+    	}
+    }
+    
+    /* Construct and compile the great hairy pattern to match the OR of the
+       end pattern, the error pattern, and all of the start patterns of the
+       sub-patterns */
+    for (patternNum=0; patternNum<nPatterns; patternNum++) {
+	if (patternSrc[patternNum].endRE == NULL &&
+	    	patternSrc[patternNum].errorRE == NULL &&
+	    	compiledPats[patternNum].nSubPatterns == 0) {
+	    compiledPats[patternNum].subPatternRE = NULL;
+	    continue;
+	}
+	length = (compiledPats[patternNum].colorOnly ||
+	    	patternSrc[patternNum].endRE == NULL) ? 0 :
+	    	strlen(patternSrc[patternNum].endRE) + 5;
+	length += (compiledPats[patternNum].colorOnly ||
+                   patternSrc[patternNum].errorRE == NULL) ? 0 :
+	    	strlen(patternSrc[patternNum].errorRE) + 5;
+	for (i=0; i<compiledPats[patternNum].nSubPatterns; i++) {
+    	    subPatIndex = compiledPats[patternNum].subPatterns[i]-compiledPats;
+    	    length += compiledPats[subPatIndex].colorOnly ? 0 :
+    	    	    strlen(patternSrc[subPatIndex].startRE) + 5;
+	}
+	if (length == 0) {
+	    compiledPats[patternNum].subPatternRE = NULL;
+	    continue;
+	}
+	bigPattern = (char*)NEditMalloc(length+1);
+	ptr=bigPattern;
+	if (patternSrc[patternNum].endRE != NULL) {
+	    *ptr++ = '('; *ptr++ = '?'; *ptr++ = ':';
+    	    strcpy(ptr, patternSrc[patternNum].endRE);
+    	    ptr += strlen(patternSrc[patternNum].endRE);
+    	    *ptr++ = ')';
+    	    *ptr++ = '|';
+	    compiledPats[patternNum].nSubBranches++;
+	}
+	if (patternSrc[patternNum].errorRE != NULL) {
+	    *ptr++ = '('; *ptr++ = '?'; *ptr++ = ':';
+    	    strcpy(ptr, patternSrc[patternNum].errorRE);
+    	    ptr += strlen(patternSrc[patternNum].errorRE);
+    	    *ptr++ = ')';
+    	    *ptr++ = '|';
+	    compiledPats[patternNum].nSubBranches++;
+	}
+	for (i=0; i<compiledPats[patternNum].nSubPatterns; i++) {
+    	    subPatIndex = compiledPats[patternNum].subPatterns[i]-compiledPats;
+    	    if (compiledPats[subPatIndex].colorOnly)
+    	    	continue;
+	    *ptr++ = '('; *ptr++ = '?'; *ptr++ = ':';
+    	    strcpy(ptr, patternSrc[subPatIndex].startRE);
+    	    ptr += strlen(patternSrc[subPatIndex].startRE);
+    	    *ptr++ = ')';
+    	    *ptr++ = '|';
+	    compiledPats[patternNum].nSubBranches++;
+	}
+	*(ptr-1) = '\0';
+	compiledPats[patternNum].subPatternRE = CompileRE(bigPattern,
+	    	&compileMsg, REDFLT_STANDARD);
+	if (compiledPats[patternNum].subPatternRE == NULL) {
+    	    fprintf(stderr, "Error compiling syntax highlight patterns:\n%s",
+    	    	    compileMsg);
+    	    return NULL;
+	}
+	NEditFree(bigPattern);
+    }
+    
+    /* Copy remaining parameters from pattern template to compiled tree */
+    for (i=0; i<nPatterns; i++)
+        compiledPats[i].flags = patternSrc[i].flags;
+        
+    return compiledPats;
+}
+
+/*
+** Free a pattern list and all of its allocated components
+*/
+static void freePatterns(highlightDataRec *patterns)
+{
+    int i;
+    
+    for (i=0; patterns[i].style!=0; i++) {
+    	if (patterns[i].startRE != NULL)
+    	    free((char *)patterns[i].startRE);
+    	if (patterns[i].endRE != NULL)
+    	    free((char *)patterns[i].endRE);
+    	if (patterns[i].errorRE != NULL)
+    	    free((char *)patterns[i].errorRE);
+    	if (patterns[i].subPatternRE != NULL)
+    	    free((char *)patterns[i].subPatternRE);
+    }
+
+    for (i=0; patterns[i].style!=0; i++) {
+        NEditFree(patterns[i].subPatterns);
+    }
+
+    NEditFree(patterns);
+}
+
+/*
+** Copy a pattern list, with copies of its compiled regular expressions.
+** Returns NULL if there's not enough memory.
+*/
+static highlightDataRec *copyPatterns(highlightDataRec *patterns)
+{
+    highlightDataRec *copy;
+    int i, j, nPatterns, ok = True;
+    
+    if (patterns == NULL)
+    	return NULL;
+    for (nPatterns=0; patterns[nPatterns].style!=0; nPatterns++);
+    copy = (highlightDataRec *)NEditMalloc(sizeof(highlightDataRec) *
+    	    (nPatterns + 1));
+    memcpy(copy, patterns, sizeof(highlightDataRec) * (nPatterns + 1));
+    for (i=0; i<nPatterns; i++) {
+    	copy[i].startRE = copyRE(patterns[i].startRE, &ok);
+    	copy[i].endRE = copyRE(patterns[i].endRE, &ok);
+    	copy[i].errorRE = copyRE(patterns[i].errorRE, &ok);
+    	copy[i].subPatternRE = copyRE(patterns[i].subPatternRE, &ok);
+    	if (patterns[i].subPatterns != NULL) {
+    	    copy[i].subPatterns = (highlightDataRec **)NEditMalloc(
+    	    	    sizeof(highlightDataRec *) * patterns[i].nSubPatterns);
+    	    for (j=0; j<patterns[i].nSubPatterns; j++)
+    	    	copy[i].subPatterns[j] =
+    	    	    	copy + (patterns[i].subPatterns[j] - patterns);
+    	}
+    }
+    if (!ok) {
+    	freePatterns(copy);
+    	return NULL;
+    }
+    return copy;
+}
+
+static regexp *copyRE(regexp *re, int *ok)
+{
+    regexp *copy;
+    
+    if (re == NULL)
+    	return NULL;
+    if ((copy = CopyRE(re)) == NULL)
+    	*ok = False;
+    return copy;
+}
+
+/*
+** Find the highlightPattern structure with a given name in the window.
+*/
+highlightPattern *FindPatternOfWindow(WindowInfo *window, char *name)
+{
+    windowHighlightData *hData = (windowHighlightData *)window->highlightData;
+    patternSet *set;
+    int i;
+
+    if (hData && (set = hData->patternSetForWindow)) {
+      for (i = 0; i < set->nPatterns; i++)
+          if (strcmp(set->patterns[i].name, name) == 0)
+              return &set->patterns[i];
+    }
+    return NULL;
+}
+
+/*
+** Picks up the entry in the style buffer for the position (if any). Rather
+** like styleOfPos() in textDisp.c. Returns the style code or zero.
+*/
+int HighlightCodeOfPos(WindowInfo *window, int pos)
+{
+    windowHighlightData *highlightData =
+          (windowHighlightData *)window->highlightData;
+    styleBuffer *styleBuf =
+          highlightData ? highlightData->styleBuffer : NULL;
+    int hCode = 0;
+    
+    if (styleBuf != NULL) {
+      flushPendingReparse(window);
+      hCode = (unsigned char)StyleBufGetCharacter(styleBuf, pos);
+      if (hCode == UNFINISHED_STYLE) {
+          /* encountered "unfinished" style, trigger parsing */
+          handleUnparsedRegion(window, highlightData->styleBuffer, pos);
+          hCode = (unsigned char)StyleBufGetCharacter(styleBuf, pos);
+      }
+    }
+    return hCode;
+}
+
+/*
+** Returns the length over which a particular highlight code applies, starting
+** at pos. If the initial code value *checkCode is zero, the highlight code of
+** pos is used.
+*/
+/* YOO: This is called form only one other function, which uses a constant
+    for checkCode and never evaluates it after the call. */
+int HighlightLengthOfCodeFromPos(WindowInfo *window, int pos, int *checkCode)
+{
+    windowHighlightData *highlightData =
+          (windowHighlightData *)window->highlightData;
+    styleBuffer *styleBuf =
+          highlightData ? highlightData->styleBuffer : NULL;
+    int hCode;
+    int oldPos = pos;
+    
+    if (styleBuf != NULL) {
+      flushPendingReparse(window);
+      hCode = (unsigned char)StyleBufGetCharacter(styleBuf, pos);
+      if (!hCode)
+          return 0;
+      if (hCode == UNFINISHED_STYLE) {
+          /* encountered "unfinished" style, trigger parsing */
+          handleUnparsedRegion(window, highlightData->styleBuffer, pos);
+          hCode = (unsigned char)StyleBufGetCharacter(styleBuf, pos);
+      }
+      if (*checkCode == 0)
+          *checkCode = hCode;
+      while (hCode == *checkCode || hCode == UNFINISHED_STYLE) {
+          if (hCode == UNFINISHED_STYLE) {
+              /* encountered "unfinished" style, trigger parsing, then loop */
+              handleUnparsedRegion(window, highlightData->styleBuffer, pos);
+              hCode = (unsigned char)StyleBufGetCharacter(styleBuf, pos);
+          }
+          else {
+              /* advance the position and get the new code */
+              hCode = (unsigned char)StyleBufGetCharacter(styleBuf, ++pos);
+          }
+      }
+    }
+    return pos - oldPos;
+}
+
+/*
+** Returns the length over which a particular style applies, starting at pos. 
+** If the initial code value *checkCode is zero, the highlight code of pos 
+** is used.
+*/
+int StyleLengthOfCodeFromPos(WindowInfo *window, int pos, 
+                             const char **checkStyleName)
+{
+    windowHighlightData *highlightData =
+          (windowHighlightData *)window->highlightData;
+    styleBuffer *styleBuf =
+          highlightData ? highlightData->styleBuffer : NULL;
+    int hCode;
+    int oldPos = pos;
+    styleTableEntry *entry;
+    
+    if (styleBuf != NULL) {
+      flushPendingReparse(window);
+      hCode = (unsigned char)StyleBufGetCharacter(styleBuf, pos);
+      if (!hCode)
+          return 0;
+      if (hCode == UNFINISHED_STYLE) {
+          /* encountered "unfinished" style, trigger parsing */
+          handleUnparsedRegion(window, highlightData->styleBuffer, pos);
+          hCode = (unsigned char)StyleBufGetCharacter(styleBuf, pos);
+      }
+      entry = styleTableEntryOfCode(window, hCode);
+      if (entry == NULL) 
+          return 0;
+      if ((*checkStyleName) == NULL)
+          (*checkStyleName) = entry->styleName;
+      while (hCode == UNFINISHED_STYLE ||
+             ((entry = styleTableEntryOfCode(window, hCode)) &&
+                strcmp(entry->styleName, (*checkStyleName)) == 0)) {
+          if (hCode == UNFINISHED_STYLE) {
+              /* encountered "unfinished" style, trigger parsing, then loop */
+              handleUnparsedRegion(window, highlightData->styleBuffer, pos);
+              hCode = (unsigned char)StyleBufGetCharacter(styleBuf, pos);
+          }
+          else {
+              /* advance the position and get the new code */
+              hCode = (unsigned char)StyleBufGetCharacter(styleBuf, ++pos);
+          }
+      }
+    }
+    return pos - oldPos;
+}
+
+/*
+** Returns a pointer to the entry in the style table for the entry of code
+** hCode (if any).
+*/
+static styleTableEntry *styleTableEntryOfCode(WindowInfo *window, int hCode)
+{
+    windowHighlightData *highlightData =
+          (windowHighlightData *)window->highlightData;
+
+    hCode -= UNFINISHED_STYLE;       /* get the correct index value */
+    if (!highlightData || hCode < 0 || hCode >= highlightData->nStyles)
+      return NULL;
+    return &highlightData->styleTable[hCode];
+}
+
+/*
+** Functions to return style information from the highlighting style table.
+*/
+
+char *HighlightNameOfCode(WindowInfo *window, int hCode)
+{
+    styleTableEntry *entry = styleTableEntryOfCode(window, hCode);
+    return entry ? entry->highlightName : "";
+}
+
+char *HighlightStyleOfCode(WindowInfo *window, int hCode)
+{
+    styleTableEntry *entry = styleTableEntryOfCode(window, hCode);
+    return entry ? entry->styleName : "";
+}
+
+
+XftColor HighlightColorValueOfCode(WindowInfo *window, int hCode,
+      int *r, int *g, int *b)
+{
+    styleTableEntry *entry = styleTableEntryOfCode(window, hCode);
+    if (entry) {
+        *r = entry->color.color.red;
+        *g = entry->color.color.green;
+        *b = entry->color.color.blue;
+        return entry->color;
+    }
+    else
+    {
+        /* pick up foreground color of the (first) text widget of the window */
+        XftColor color = TextGetFGColor(window->textArea);
+        *r = color.color.red;
+        *g = color.color.green;
+        *b = color.color.blue;
+        return color;
+    }
+}
+
+XftColor GetHighlightBGColorOfCode(WindowInfo *window, int hCode,
+      int *r, int *g, int *b)
+{
+    styleTableEntry *entry = styleTableEntryOfCode(window, hCode);
+    if (entry && entry->bgColorName) {
+        *r = entry->bgColor.color.red;
+        *g = entry->bgColor.color.green;
+        *b = entry->bgColor.color.blue;
+        return entry->bgColor;
+    }
+    else
+    {
+        /* pick up background color of the (first) text widget of the window */
+        XftColor color = TextGetBGColor(window->textArea);
+        *r = color.color.red;
+        *g = color.color.green;
+        *b = color.color.blue;
+        return color;
+    }
+}
+
+/*
+** Callback to parse an "unfinished" region of the buffer.  "unfinished" means
+** that the buffer has been parsed with pass 1 patterns, but this section has
+** not yet been exposed, and thus never had pass 2 patterns applied.  This
+** callback is invoked when the text widget's display routines encounter one
+** of these unfinished regions.  "pos" is the first position encountered which
+** needs re-parsing.  This routine applies pass 2 patterns to a chunk of
+** the buffer of size PASS_2_REPARSE_CHUNK_SIZE beyond pos.
+**
+** Unfinished regions may also be text which the background pass 1 parse has
+** not reached yet.  That is parsed with pass 1 patterns first, properly if it
+** is close to where the background parse has got to, otherwise provisionally
+** (see parseViewProvisionally).
+*/
+static void handleUnparsedRegion(const WindowInfo* window, styleBuffer *styleBuf,
+        ssize_t pos)
+{
+    textBuffer *buf = window->buffer;
+    ssize_t beginParse, endParse, beginSafety, endSafety, p;
+    windowHighlightData *highlightData =
+            (windowHighlightData *)window->highlightData;
+
+    reparseContext *context = &highlightData->contextRequirements;
+    highlightDataRec *pass2Patterns = highlightData->pass2Patterns;
+    char *string, *styleString, *stylePtr, c, prevChar;
+    const char *stringPtr;
+
+    /* Modified text waiting to be re-parsed may be styled by doing that */
+    flushPendingReparse(window);
+    if (StyleBufGetCharacter(styleBuf, pos) != UNFINISHED_STYLE)
+    	return;
+    
+    /* If pass 1 parsing hasn't got this far, do that first */
+    if (pos >= highlightData->pass1ParsedTo &&
+    	    !inProvisionalView(highlightData, pos)) {
+    	if (pos < highlightData->pass1ParsedTo + PASS_1_CHUNK_SIZE)
+    	    extendPass1Parse(highlightData, buf, pos + PASS_1_VIEW_SIZE,
+    	    	    GetWindowDelimiters(window));
+    	else
+    	    parseViewProvisionally(window, pos);
+    	if (StyleBufGetCharacter(styleBuf, pos) != UNFINISHED_STYLE)
+    	    return;
+    }
+      
+    /* If there are no pass 2 patterns to process, do nothing (but this
+       should never be triggered) */
+    if (pass2Patterns == NULL)
+    	return;
+    
+    int firstPass2Style = (unsigned char)pass2Patterns[1].style;
+    
+    /* Find the point at which to begin parsing to ensure that the character at
+       pos is parsed correctly (beginSafety), at most one context distance back
+       from pos, unless there is a pass 1 section from which to start */
+    beginParse = pos;
+    beginSafety = backwardOneContext(buf, context, beginParse);
+    for (p=beginParse; p>=beginSafety; p--) {
+    	c = StyleBufGetCharacter(styleBuf, p);
+    	if (c != UNFINISHED_STYLE && c != PLAIN_STYLE &&
+		(unsigned char)c < firstPass2Style) {
+    	    beginSafety = p + 1;
+    	    break;
+    	}
+    }
+    
+    /* Decide where to stop (endParse), and the extra distance (endSafety)
+       necessary to ensure that the changes at endParse are correct.  Stop at
+       the end of the unfinished region, or a max. of PASS_2_REPARSE_CHUNK_SIZE
+       characters forward from the requested position */
+    endParse = min(buf->length, pos + PASS_2_REPARSE_CHUNK_SIZE);
+    endSafety = forwardOneContext(buf, context, endParse);
+    for (p=pos; p<endSafety; p++) {
+    	c = StyleBufGetCharacter(styleBuf, p);
+    	if (c != UNFINISHED_STYLE && c != PLAIN_STYLE &&
+		(unsigned char)c < firstPass2Style) {
+    	    endParse = min(endParse, p);
+    	    endSafety = p;
+    	    break;
+    	} else if (c != UNFINISHED_STYLE && p < endParse) {
+    	    endParse = p;
+    	    if ((unsigned char)c < firstPass2Style)
+    	    	endSafety = p;
+    	    else
+    	    	endSafety = forwardOneContext(buf, context, endParse);
+    	    break;
+    	}
+    }
+    
+    /* Copy the buffer range into a string */
+    /* printf("callback pass2 parsing from %d thru %d w/ safety from %d thru %d\n",
+    	    beginParse, endParse, beginSafety, endSafety); */
+    stringPtr = string = BufGetRange(buf, beginSafety, endSafety);
+    styleString = stylePtr = StyleBufGetRange(styleBuf, beginSafety, endSafety);
+    
+    /* Parse it with pass 2 patterns */
+    prevChar = getPrevChar(buf, beginSafety);
+    parseString(pass2Patterns, &stringPtr, &stylePtr, endParse - beginSafety,
+    	    &prevChar, False, GetWindowDelimiters(window), string, NULL);
+
+    /* Update the style buffer the new style information, but only between
+       beginParse and endParse.  Skip the safety region */
+    styleString[endParse-beginSafety] = '\0';
+    StyleBufReplace(styleBuf, beginParse, endParse,
+    	    &styleString[beginParse-beginSafety]);
+    NEditFree(styleString);
+    NEditFree(string);    
+}
+
+/*
+** Callback wrapper around the above function.  Modified text waiting to be
+** re-parsed (see addPendingReparse) is left unstyled for now, and is redrawn
+** once it has been.
+*/
+static void handleUnparsedRegionCB(const textDisp* textD, ssize_t pos,
+        const void* cbArg)
+{
+    const WindowInfo *window = (const WindowInfo *)cbArg;
+    
+    if (inPendingReparse((windowHighlightData *)window->highlightData, pos))
+    	return;
+    handleUnparsedRegion(window, textD->styleBuffer, pos);
+}
+
+/*
+** Keep the extent of the pass 1 parse, and of the provisionally parsed
+** regions beyond it, up to date with a modification to the buffer.  Returns
+** the position beyond which re-parsing the modification must not extend, or
+** -1 if the modification is in text which hasn't been parsed yet, and will
+** be parsed when it is displayed or reached by the background parse.
+*/
+static ssize_t updatePass1Extent(windowHighlightData *highlightData,
+        ssize_t pos, ssize_t nInserted, ssize_t nDeleted)
+{
+    ssize_t parseLimit = -1;
+    ssize_t *start, *end;
+    int i;
+    
+    for (i=0; i<highlightData->nViews; i++) {
+    	start = &highlightData->viewStart[i];
+    	end = &highlightData->viewEnd[i];
+    	if (pos + nDeleted <= *start) {
+    	    *start += nInserted - nDeleted;
+    	    *end += nInserted - nDeleted;
+    	} else if (pos < *end) {
+    	    *start = min(*start, pos);
+    	    *end = pos + nDeleted >= *end ? pos + nInserted :
+    	    	    *end + nInserted - nDeleted;
+    	    parseLimit = max(parseLimit, *end);
+    	}
+    }
+    
+    if (pos <= highlightData->pass1ParsedTo) {
+    	if (pos + nDeleted >= highlightData->pass1ParsedTo)
+    	    highlightData->pass1ParsedTo = pos + nInserted;
+    	else
+    	    highlightData->pass1ParsedTo += nInserted - nDeleted;
+    	parseLimit = max(parseLimit, highlightData->pass1ParsedTo);
+    }
+    dropParsedViews(highlightData);
+    return parseLimit;
+}
+
+/*
+** Find the position beyond which re-parsing modified text from "start" to
+** "end" must not extend (as updatePass1Extent does for a single
+** modification), or -1 if the text has not been parsed yet.
+*/
+static ssize_t parseLimitOfRange(windowHighlightData *highlightData,
+        ssize_t start, ssize_t end)
+{
+    ssize_t parseLimit = -1;
+    int i;
+    
+    for (i=0; i<highlightData->nViews; i++)
+    	if (start <= highlightData->viewEnd[i] &&
+    	    	end >= highlightData->viewStart[i])
+    	    parseLimit = max(parseLimit, highlightData->viewEnd[i]);
+    if (start <= highlightData->pass1ParsedTo)
+    	parseLimit = max(parseLimit, highlightData->pass1ParsedTo);
+    return parseLimit;
+}
+
+/*
+** Note a modification to the buffer, to be re-parsed later along with the
+** others noted (see flushPendingReparse), and move the ranges already
+** noted to follow the modification.  Ranges which touch are merged.  If
+** "add" is False, the modified text has not been parsed yet, and only needs
+** re-parsing if it joins a range already noted.
+*/
+static void addPendingReparse(windowHighlightData *highlightData,
+        ssize_t pos, ssize_t nInserted, ssize_t nDeleted, int add)
+{
+    ssize_t *start, *end, newStart = pos, newEnd = pos + nInserted;
+    ssize_t delta = nInserted - nDeleted;
+    int first, last, mid, i, n = highlightData->nPending;
+    
+    /* Find the ranges touching the deleted text (first through last-1).
+       Modifications in a batch usually come in order, so look at the last
+       range before searching */
+    start = highlightData->pendingStart;
+    end = highlightData->pendingEnd;
+    if (n == 0 || end[n-1] < pos)
+    	first = n;
+    else {
+    	for (first=0, last=n-1; first<last; ) {
+    	    mid = (first + last) / 2;
+    	    if (end[mid] < pos)
+    	    	first = mid + 1;
+    	    else
+    	    	last = mid;
+    	}
+    }
+    for (last=first; last<n && start[last]<=pos+nDeleted; last++)
+    	;
+    
+    if (first < last) {
+    	newStart = min(start[first], pos);
+    	if (end[last-1] > pos + nDeleted)
+    	    newEnd = end[last-1] + delta;
+    } else if (!add) {
+    	for (i=first; i<n; i++) {
+    	    start[i] += delta;
+    	    end[i] += delta;
+    	}
+    	return;
+    }
+    
+    /* Replace them with a single range, moving those beyond */
+    if (n + 1 - (last - first) > highlightData->pendingAlloc) {
+    	highlightData->pendingAlloc = max(64, 2 * highlightData->pendingAlloc);
+    	start = highlightData->pendingStart = (ssize_t *)NEditRealloc(start,
+    	    	sizeof(ssize_t) * highlightData->pendingAlloc);
+    	end = highlightData->pendingEnd = (ssize_t *)NEditRealloc(end,
+    	    	sizeof(ssize_t) * highlightData->pendingAlloc);
+    }
+    memmove(&start[first+1], &start[last], sizeof(ssize_t) * (n - last));
+    memmove(&end[first+1], &end[last], sizeof(ssize_t) * (n - last));
+    n += 1 - (last - first);
+    start[first] = newStart;
+    end[first] = newEnd;
+    for (i=first+1; i<n; i++) {
+    	start[i] += delta;
+    	end[i] += delta;
+    }
+    highlightData->nPending = n;
+}
+
+/*
+** Return True if "pos" is in modified text waiting to be re-parsed
+*/
+static int inPendingReparse(windowHighlightData *highlightData, ssize_t pos)
+{
+    int first, last, mid;
+    
+    if (highlightData == NULL || highlightData->nPending == 0)
+    	return False;
+    for (first=0, last=highlightData->nPending-1; first<last; ) {
+    	mid = (first + last) / 2;
+    	if (highlightData->pendingEnd[mid] <= pos)
+    	    first = mid + 1;
+    	else
+    	    last = mid;
+    }
+    return pos >= highlightData->pendingStart[first] &&
+    	    pos < highlightData->pendingEnd[first];
+}
+
+/*
+** Re-parse the modified text noted by addPendingReparse, in order.  Ranges
+** less than one context distance apart are re-parsed together, and changes
+** which carry on beyond a range are followed only as far as the next, which
+** takes over from there.  The styles changed are marked by selecting them
+** in the style buffer, for redisplayStyleChanges.
+*/
+static void flushPendingReparse(const WindowInfo *window)
+{
+    windowHighlightData *highlightData =
+            (windowHighlightData *)window->highlightData;
+    textBuffer *buf = window->buffer;
+    styleBuffer *styleBuf;
+    selection *sel;
+    reparseContext *context;
+    const char *delimiters;
+    ssize_t start, end, parseLimit, selStart, selEnd;
+    int i, j, selected;
+    
+    if (highlightData == NULL || highlightData->nPending == 0)
+    	return;
+    styleBuf = highlightData->styleBuffer;
+    sel = &styleBuf->primary;
+    context = &highlightData->contextRequirements;
+    delimiters = GetWindowDelimiters(window);
+    
+    /* Re-parsing stops when styles stop changing beyond the modification
+       (see lastModified), so start with nothing marked, and add back what
+       was marked before at the end */
+    selected = sel->selected;
+    selStart = sel->start;
+    selEnd = sel->end;
+    StyleBufUnselect(styleBuf);
+    
+    for (i=0; i<highlightData->nPending; i=j) {
+    	start = highlightData->pendingStart[i];
+    	end = highlightData->pendingEnd[i];
+    	for (j=i+1; j<highlightData->nPending &&
+    	    	highlightData->pendingStart[j] <=
+    	    	forwardOneContext(buf, context, end); j++)
+    	    end = highlightData->pendingEnd[j];
+    	parseLimit = parseLimitOfRange(highlightData, start, end);
+    	if (parseLimit < 0)
+    	    continue;
+    	if (j < highlightData->nPending)
+    	    parseLimit = min(parseLimit, highlightData->pendingStart[j]);
+    	if (sel->selected)
+    	    StyleBufSelect(styleBuf, min(sel->start, start),
+    	    	    max(sel->end, end));
+    	else
+    	    StyleBufSelect(styleBuf, start, end);
+    	incrementalReparse(highlightData, buf, start, end - start,
+    	    	delimiters, parseLimit);
+    }
+    highlightData->nPending = 0;
+    
+    if (selected) {
+    	if (sel->selected)
+    	    StyleBufSelect(styleBuf, min(sel->start, selStart),
+    	    	    max(sel->end, selEnd));
+    	else
+    	    StyleBufSelect(styleBuf, selStart, selEnd);
+    }
+    highlightData->redisplayPending = True;
+}
+
+/*
+** Xt work procedure run when the application becomes idle after the buffer
+** has been modified.  Ends the burst of modifications, re-parses any still
+** waiting, and redraws the styles that changed.
+*/
+static Boolean reparseWorkProc(XtPointer clientData)
+{
+    WindowInfo *window = (WindowInfo *)clientData;
+    windowHighlightData *highlightData =
+            (windowHighlightData *)window->highlightData;
+    
+    highlightData->reparseWorkProc = 0;
+    highlightData->nBurstMods = 0;
+    flushPendingReparse(window);
+    if (highlightData->redisplayPending)
+    	redisplayStyleChanges(window);
+    return True;
+}
+
+/*
+** Continue the pass 1 parse of buffer "buf", from where it has got to
+** (highlightData->pass1ParsedTo) through "endParse".  Changed styles are
+** marked in the style buffer in the same way as by incremental reparsing.
+*/
+static void extendPass1Parse(windowHighlightData *highlightData,
+        textBuffer *buf, ssize_t endParse, const char *delimiters)
+{
+    ssize_t beginParse, endAt;
+    int parseInStyle;
+    highlightDataRec *startPattern;
+    
+    endParse = min(buf->length, endParse);
+    if (endParse <= highlightData->pass1ParsedTo)
+    	return;
+    
+    /* Restart from a safe position at or before the end of the parsed text,
+       and if parsing ends early in a sub-pattern, carry on one level up in
+       the pattern hierarchy (as in incrementalReparse) */
+    beginParse = highlightData->pass1ParsedTo;
+    parseInStyle = findSafeParseRestartPos(buf, highlightData, &beginParse);
+    for (;;) {
+    	startPattern = patternOfStyle(highlightData->pass1Patterns,
+    	    	parseInStyle);
+    	if (!startPattern)
+    	    startPattern = highlightData->pass1Patterns;
+    	endAt = parsePass1Range(highlightData, startPattern, buf, beginParse,
+    	    	endParse, delimiters);
+    	if (endAt >= endParse || startPattern == highlightData->pass1Patterns)
+    	    break;
+    	beginParse = endAt;
+    	parseInStyle = parentStyleOf(highlightData->parentStyles,
+    	    	parseInStyle);
+    }
+    highlightData->pass1ParsedTo = endParse;
+    dropParsedViews(highlightData);
+}
+
+/*
+** Parse text in buffer "buf" between positions "beginParse" and "endParse"
+** with pass 1 patterns only, starting with "pattern", and merge the result
+** into the style buffer (see mergePass1Styles).  Returns the buffer position
+** at which parsing finished.
+*/
+static ssize_t parsePass1Range(windowHighlightData *highlightData,
+        highlightDataRec *pattern, textBuffer *buf, ssize_t beginParse,
+        ssize_t endParse, const char *delimiters)
+{
+    styleBuffer *styleBuf = highlightData->styleBuffer;
+    reparseContext *context = &highlightData->contextRequirements;
+    char *string, *styleString, *stylePtr, prevChar;
+    const char *stringPtr;
+    ssize_t beginSafety, endSafety;
+    
+    /* Give look-behind patterns one context distance before beginParse, and
+       let matches run one context distance beyond endParse */
+    beginSafety = backwardOneContext(buf, context, beginParse);
+    endSafety = forwardOneContext(buf, context, endParse);
+    string = BufGetRange(buf, beginSafety, endSafety);
+    styleString = StyleBufGetRange(styleBuf, beginSafety, endSafety);
+    
+    prevChar = getPrevChar(buf, beginParse);
+    stringPtr = &string[beginParse-beginSafety];
+    stylePtr = &styleString[beginParse-beginSafety];
+    parseString(pattern, &stringPtr, &stylePtr, endParse-beginParse,
+    	    &prevChar, False, delimiters, string, NULL);
+    endParse = min(endParse, stringPtr-string + beginSafety);
+    
+    mergePass1Styles(highlightData, &styleString[beginParse-beginSafety],
+    	    beginParse, endParse);
+    NEditFree(styleString);
+    NEditFree(string);
+    return endParse;
+}
+
+/*
+** Style text at "pos", which is displayed before the background pass 1 parse
+** has reached it, by parsing from a little before it with the top level
+** pass 1 patterns.  This is right unless the text is within a pattern
+** which starts further back, and is corrected when the background parse
+** gets there.
+*/
+static void parseViewProvisionally(const WindowInfo *window, ssize_t pos)
+{
+    windowHighlightData *highlightData =
+            (windowHighlightData *)window->highlightData;
+    textBuffer *buf = window->buffer;
+    styleBuffer *styleBuf = highlightData->styleBuffer;
+    char *string, *styleString, *stylePtr, prevChar;
+    const char *stringPtr;
+    ssize_t beginParse, endParse, endSafety;
+    
+    beginParse = max(highlightData->pass1ParsedTo,
+    	    BufStartOfLine(buf, max(0, pos - PASS_1_VIEW_CONTEXT)));
+    endParse = min(buf->length, pos + PASS_1_VIEW_SIZE);
+    endSafety = forwardOneContext(buf, &highlightData->contextRequirements,
+    	    endParse);
+    string = BufGetRange(buf, beginParse, endSafety);
+    styleString = StyleBufGetRange(styleBuf, beginParse, endSafety);
+    
+    prevChar = getPrevChar(buf, beginParse);
+    stringPtr = string;
+    stylePtr = styleString;
+    parseString(highlightData->pass1Patterns, &stringPtr, &stylePtr,
+    	    endParse-beginParse, &prevChar, False,
+    	    GetWindowDelimiters(window), string, NULL);
+    
+    /* Only the text from pos on is styled, the rest was just context */
+    styleString[endParse-beginParse] = '\0';
+    StyleBufReplace(styleBuf, pos, endParse, &styleString[pos-beginParse]);
+    NEditFree(styleString);
+    NEditFree(string);
+    
+    /* Remember the region, forgetting the oldest if there are too many */
+    if (highlightData->nViews == PASS_1_MAX_VIEWS) {
+    	memmove(highlightData->viewStart, &highlightData->viewStart[1],
+    	    	sizeof(ssize_t) * (PASS_1_MAX_VIEWS-1));
+    	memmove(highlightData->viewEnd, &highlightData->viewEnd[1],
+    	    	sizeof(ssize_t) * (PASS_1_MAX_VIEWS-1));
+    	highlightData->nViews--;
+    }
+    highlightData->viewStart[highlightData->nViews] = pos;
+    highlightData->viewEnd[highlightData->nViews++] = endParse;
+}
+
+/*
+** Returns True if "pos" is in a provisionally parsed region
+*/
+static int inProvisionalView(windowHighlightData *highlightData,
+        ssize_t pos)
+{
+    int i;
+    
+    for (i=0; i<highlightData->nViews; i++)
+    	if (pos >= highlightData->viewStart[i] &&
+    	    	pos < highlightData->viewEnd[i])
+    	    return True;
+    return False;
+}
+
+/*
+** Forget provisionally parsed regions which the pass 1 parse has passed, or
+** which have been deleted
+*/
+static void dropParsedViews(windowHighlightData *highlightData)
+{
+    int i, n = 0;
+    
+    for (i=0; i<highlightData->nViews; i++) {
+    	if (highlightData->viewEnd[i] > highlightData->pass1ParsedTo &&
+    	    	highlightData->viewEnd[i] > highlightData->viewStart[i]) {
+    	    highlightData->viewStart[n] = highlightData->viewStart[i];
+    	    highlightData->viewEnd[n++] = highlightData->viewEnd[i];
+    	}
+    }
+    highlightData->nViews = n;
+}
+
+/*
+** Merge pass 1 styles "styleString" for buffer positions "startPos" through
+** "endPos" into the style buffer, marking changes for redisplay (see
+** modifyStyleBuf).  Where pass 1 finds nothing, styles from pass 2 parsing
+** already in the style buffer are kept, so that text which has been displayed
+** is not marked as changed.
+*/
+static void mergePass1Styles(windowHighlightData *highlightData,
+        char *styleString, ssize_t startPos, ssize_t endPos)
+{
+    styleBuffer *styleBuf = highlightData->styleBuffer;
+    char *oldStyles, *c;
+    ssize_t i;
+    int firstPass2Style = highlightData->pass2Patterns == NULL ? INT_MAX :
+	    (unsigned char)highlightData->pass2Patterns[1].style;
+    
+    oldStyles = StyleBufGetRange(styleBuf, startPos, endPos);
+    for (c=styleString, i=0; i<endPos-startPos; c++, i++) {
+    	if (*c == UNFINISHED_STYLE && (oldStyles[i] == PLAIN_STYLE ||
+    	    	(unsigned char)oldStyles[i] >= firstPass2Style))
+    	    *c = oldStyles[i];
+    }
+    styleString[endPos-startPos] = '\0';
+    modifyStyleBuf(styleBuf, styleString, startPos, endPos, firstPass2Style);
+    NEditFree(oldStyles);
+}
+
+/*
+** Start parsing the rest of the buffer with pass 1 patterns in the
+** background, in a worker thread if possible, otherwise when the application
+** is idle
+*/
+static void startBackgroundParse(WindowInfo *window)
+{
+    windowHighlightData *highlightData =
+            (windowHighlightData *)window->highlightData;
+    XtAppContext context = XtWidgetToApplicationContext(window->shell);
+    
+    if (highlightData->pass1ParsedTo >= window->buffer->length)
+    	return;
+    highlightData->pass1Job = startPass1Job(window);
+    if (highlightData->pass1Job != NULL) {
+    	highlightData->pass1TimerGeneration = highlightData->generation;
+    	highlightData->pass1Timer = XtAppAddTimeOut(context,
+    	    	PASS_1_POLL_INTERVAL, pass1TimerProc, window);
+    } else
+    	highlightData->pass1WorkProc = XtAppAddWorkProc(context,
+    	    	pass1WorkProc, window);
+}
+
+/*
+** Stop any background parsing, discarding results not yet collected
+*/
+static void stopBackgroundParse(windowHighlightData *highlightData)
+{
+    pass1Job *job = highlightData->pass1Job;
+    
+    if (highlightData->pass1WorkProc != 0)
+    	XtRemoveWorkProc(highlightData->pass1WorkProc);
+    if (highlightData->pass1Timer != 0)
+    	XtRemoveTimeOut(highlightData->pass1Timer);
+    if (job != NULL) {
+    	pthread_mutex_lock(&job->lock);
+    	job->cancel = True;
+    	pthread_mutex_unlock(&job->lock);
+    	pthread_join(job->thread, NULL);
+    	freePass1Job(job);
+    }
+    highlightData->pass1WorkProc = 0;
+    highlightData->pass1Timer = 0;
+    highlightData->pass1Job = NULL;
+}
+
+/*
+** Start a worker thread parsing a snapshot of the window's buffer with pass
+** 1 patterns, from where the parse has got to.  Returns NULL if it can't be
+** started.
+*/
+static pass1Job *startPass1Job(WindowInfo *window)
+{
+    windowHighlightData *highlightData =
+            (windowHighlightData *)window->highlightData;
+    windowHighlightData *jobHighlightData;
+    compiledPatterns *compiled;
+    pass1Job *job;
+    
+    jobHighlightData = createHighlightData(window,
+    	    highlightData->patternSetForWindow);
+    if (jobHighlightData == NULL)
+    	return NULL;
+    jobHighlightData->pass1ParsedTo = highlightData->pass1ParsedTo;
+    
+    /* The thread matches with its own copy of the compiled patterns */
+    compiled = copyCompiledPatterns(jobHighlightData->compiled);
+    if (compiled == NULL) {
+    	freeHighlightData(jobHighlightData);
+    	return NULL;
+    }
+    releaseCompiledPatterns(jobHighlightData->compiled);
+    setCompiledPatterns(jobHighlightData, compiled);
+    
+    job = NEditNew(pass1Job);
+    pthread_mutex_init(&job->lock, NULL);
+    job->highlightData = jobHighlightData;
+    job->text = BufCreate();
+    job->snapshot = BufGetAll(window->buffer);
+    job->snapshotStyles = StyleBufGetAll(highlightData->styleBuffer);
+    job->length = window->buffer->length;
+    job->delimiters = NEditStrdup(GetWindowDelimiters(window));
+    job->generation = highlightData->generation;
+    job->cancel = False;
+    job->finished = False;
+    job->results = job->lastResult = NULL;
+    if (pthread_create(&job->thread, NULL, pass1Worker, job) != 0) {
+    	freePass1Job(job);
+    	return NULL;
+    }
+    return job;
+}
+
+/*
+** Pass 1 worker thread.  Parses the snapshot a chunk of PASS_1_CHUNK_SIZE
+** characters at a time, in the same way as extendPass1Parse on the buffer
+** itself, and queues the resulting styles for pass1TimerProc.
+*/
+static void *pass1Worker(void *arg)
+{
+    pass1Job *job = (pass1Job *)arg;
+    windowHighlightData *highlightData = job->highlightData;
+    selection *sel = &highlightData->styleBuffer->primary;
+    pass1Result *result;
+    ssize_t start;
+    int cancel = False;
+    
+    BufSetAllLen(job->text, job->snapshot, job->length);
+    StyleBufSetAllLen(highlightData->styleBuffer, job->snapshotStyles,
+    	    job->length);
+    NEditFree(job->snapshot);
+    NEditFree(job->snapshotStyles);
+    job->snapshot = job->snapshotStyles = NULL;
+    
+    while (!cancel && highlightData->pass1ParsedTo < job->length) {
+    	start = highlightData->pass1ParsedTo;
+    	extendPass1Parse(highlightData, job->text,
+    	    	start + PASS_1_CHUNK_SIZE, job->delimiters);
+    	
+    	/* Styles can change a little before where the parse restarted */
+    	if (sel->selected)
+    	    start = min(start, sel->start);
+    	StyleBufUnselect(highlightData->styleBuffer);
+    	
+    	result = NEditNew(pass1Result);
+    	result->start = start;
+    	result->end = highlightData->pass1ParsedTo;
+    	result->styles = StyleBufGetRange(highlightData->styleBuffer, start,
+    	    	result->end);
+    	result->next = NULL;
+    	
+    	pthread_mutex_lock(&job->lock);
+    	if (job->lastResult == NULL)
+    	    job->results = result;
+    	else
+    	    job->lastResult->next = result;
+    	job->lastResult = result;
+    	cancel = job->cancel;
+    	pthread_mutex_unlock(&job->lock);
+    }
+    
+    pthread_mutex_lock(&job->lock);
+    job->finished = True;
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+/*
+** Xt timer procedure collecting the results of the pass 1 worker thread.  If
+** the buffer has been modified since the thread started, its results are
+** discarded, and a new thread is started once modifications stop for an
+** interval.
+*/
+static void pass1TimerProc(XtPointer clientData, XtIntervalId *id)
+{
+    WindowInfo *window = (WindowInfo *)clientData;
+    windowHighlightData *highlightData =
+            (windowHighlightData *)window->highlightData;
+    pass1Job *job = highlightData->pass1Job;
+    pass1Result *results, *result, *next;
+    int finished = False;
+    
+    highlightData->pass1Timer = 0;
+    flushPendingReparse(window);
+    
+    if (job != NULL) {
+    	pthread_mutex_lock(&job->lock);
+    	results = job->results;
+    	job->results = job->lastResult = NULL;
+    	finished = job->finished;
+    	if (job->generation != highlightData->generation)
+    	    job->cancel = True;
+    	pthread_mutex_unlock(&job->lock);
+    	
+    	for (result=results; result!=NULL; result=next) {
+    	    next = result->next;
+    	    if (job->generation == highlightData->generation &&
+    	    	    result->start <= highlightData->pass1ParsedTo &&
+    	    	    result->end > highlightData->pass1ParsedTo) {
+    	    	mergePass1Styles(highlightData, result->styles, result->start,
+    	    	    	result->end);
+    	    	highlightData->pass1ParsedTo = result->end;
+    	    	dropParsedViews(highlightData);
+    	    }
+    	    NEditFree(result->styles);
+    	    NEditFree(result);
+    	}
+    	redisplayStyleChanges(window);
+    	
+    	if (finished) {
+    	    pthread_join(job->thread, NULL);
+    	    freePass1Job(job);
+    	    highlightData->pass1Job = NULL;
+    	}
+    }
+    
+    if (highlightData->pass1ParsedTo >= window->buffer->length &&
+    	    highlightData->pass1Job == NULL)
+    	return;
+    if (highlightData->pass1Job == NULL &&
+    	    highlightData->generation == highlightData->pass1TimerGeneration)
+    	highlightData->pass1Job = startPass1Job(window);
+    highlightData->pass1TimerGeneration = highlightData->generation;
+    highlightData->pass1Timer = XtAppAddTimeOut(
+    	    XtWidgetToApplicationContext(window->shell),
+    	    PASS_1_POLL_INTERVAL, pass1TimerProc, window);
+}
+
+/*
+** Free a pass 1 job whose thread has finished, and any uncollected results
+*/
+static void freePass1Job(pass1Job *job)
+{
+    pass1Result *result, *next;
+    
+    for (result=job->results; result!=NULL; result=next) {
+    	next = result->next;
+    	NEditFree(result->styles);
+    	NEditFree(result);
+    }
+    freeHighlightData(job->highlightData);
+    BufFree(job->text);
+    NEditFree(job->snapshot);
+    NEditFree(job->snapshotStyles);
+    NEditFree(job->delimiters);
+    pthread_mutex_destroy(&job->lock);
+    NEditFree(job);
+}
+
+/*
+** Xt work procedure for parsing the buffer with pass 1 patterns in the
+** background, a chunk of PASS_1_CHUNK_SIZE characters at a time, when a
+** worker thread can't be used.  Returns True (done, remove the work
+** procedure) when the whole buffer is parsed.
+*/
+static Boolean pass1WorkProc(XtPointer clientData)
+{
+    WindowInfo *window = (WindowInfo *)clientData;
+    windowHighlightData *highlightData =
+            (windowHighlightData *)window->highlightData;
+    
+    flushPendingReparse(window);
+    extendPass1Parse(highlightData, window->buffer,
+    	    highlightData->pass1ParsedTo + PASS_1_CHUNK_SIZE,
+    	    GetWindowDelimiters(window));
+    redisplayStyleChanges(window);
+    if (highlightData->pass1ParsedTo < window->buffer->length)
+    	return False;
+    highlightData->pass1WorkProc = 0;
+    return True;
+}
+
+/*
+** Write the text of "window" to the file "fileName" with syntax
+** highlighting, as HTML or as text with ANSI color escape sequences
+** ("format"), using the highlight patterns of its language mode whether or
+** not highlighting is turned on.
+** The styles of the window are not used or changed.
+**
+** The text is split into chunks at line starts, and the chunks are parsed by
+** "nThreads" threads (one per processor if 0).  A thread can't know the
+** pattern in which its chunk begins, so it parses with the top level pass 1
+** patterns, as parseViewProvisionally does.  The chunks are then joined up
+** in order by re-parsing from a safe restart position before the start of
+** each until the styles agree with the provisional ones for one context
+** distance, which in most text is the first context distance.  Pass 2
+** parsing, which never reaches beyond one context distance, and formatting
+** are done by the threads again.  The file is not opened until the text
+** is parsed, so if the language mode has no patterns it is left alone.
+**
+** Returns False if the window's language mode has no highlight patterns, or
+** the file could not be written.  The time taken is recorded for
+** ExportHighlightingReport.
+*/
+int ExportHighlighting(WindowInfo *window, const char *fileName, int format,
+        int nThreads)
+{
+    windowHighlightData *highlightData;
+    patternSet *patSet;
+    textBuffer *buf = window->buffer;
+    reparseContext *context;
+    exportWork work;
+    exportThread *threads;
+    exportChunk *chunk;
+    char *text, *styles;
+    const char *markup;
+    ssize_t length = buf->length, pos;
+    int i, nChunks, written;
+    double startTime, parseStart;
+    FILE *fp;
+    
+    startTime = profileClock();
+    patSet = findPatternsForWindow(window, False);
+    if (patSet == NULL)
+    	return False;
+    highlightData = createHighlightData(window, patSet);
+    if (highlightData == NULL)
+    	return False;
+    context = &highlightData->contextRequirements;
+    
+    /* Split the text into chunks, each starting at the start of a line */
+    if (nThreads <= 0)
+    	nThreads = GetNumProcessors();
+    nChunks = max(1, min(nThreads * EXPORT_CHUNKS_PER_THREAD,
+    	    length / EXPORT_MIN_CHUNK));
+    work.chunks = (exportChunk *)NEditMalloc(sizeof(exportChunk) * nChunks);
+    for (i=0, pos=0; pos<length || i==0; i++) {
+    	chunk = &work.chunks[i];
+    	chunk->start = pos;
+    	if (i == nChunks-1)
+    	    pos = length;
+    	else {
+    	    pos = BufStartOfLine(buf, length / nChunks * (i+1));
+    	    if (pos <= chunk->start)
+    	    	pos = min(length, BufEndOfLine(buf, chunk->start) + 1);
+    	}
+    	chunk->end = pos;
+    	chunk->styles = chunk->output = NULL;
+    	chunk->outputLen = chunk->outputAlloc = 0;
+    	chunk->firstStyle = chunk->lastStyle = NULL;
+    }
+    nChunks = i;
+    
+    /* Give each thread its own copy of the compiled patterns.  If copying
+       fails, carry on with fewer threads */
+    nThreads = max(1, min(nThreads, nChunks));
+    threads = (exportThread *)NEditMalloc(sizeof(exportThread) * nThreads);
+    for (i=0; i<nThreads; i++) {
+    	threads[i].work = &work;
+    	threads[i].compiled = copyCompiledPatterns(highlightData->compiled);
+    	if (threads[i].compiled == NULL)
+    	    break;
+    }
+    if (i == 0) {
+    	threads[0].compiled = highlightData->compiled;
+    	highlightData->compiled->refCount++;
+    	i = 1;
+    }
+    nThreads = i;
+    
+    text = BufGetAll(buf);
+    pthread_mutex_init(&work.lock, NULL);
+    work.text = text;
+    work.nChunks = nChunks;
+    work.delimiters = GetWindowDelimiters(window);
+    work.format = format;
+    work.nStyles = highlightData->nStyles;
+    work.styleStart = (char **)NEditMalloc(sizeof(char *) * work.nStyles);
+    for (i=0; i<work.nStyles; i++)
+    	work.styleStart[i] = i < 2 ? NULL :
+    	    	exportStyleMarkup(&highlightData->styleTable[i], format);
+    work.styleEnd = format == EXPORT_HTML ? "</span>" : "\033[0m";
+    for (i=0; i<nThreads; i++)
+    	threads[i].busyTime = 0.0;
+    parseStart = profileClock();
+    
+    /* Parse the chunks provisionally with pass 1 patterns, and join them up
+       into the style buffer */
+    if (highlightData->pass1Patterns != NULL) {
+    	for (i=0; i<nChunks; i++) {
+    	    chunk = &work.chunks[i];
+    	    chunk->parseStart = chunk->start;
+    	    chunk->parseEnd = forwardOneContext(buf, context, chunk->end);
+    	}
+    	runExportPass(&work, 1, threads, nThreads);
+    	styles = (char *)NEditMalloc(length + 1);
+    	for (i=0; i<nChunks; i++) {
+    	    chunk = &work.chunks[i];
+    	    memcpy(&styles[chunk->start], chunk->styles,
+    	    	    chunk->end - chunk->start);
+    	    NEditFree(chunk->styles);
+    	    chunk->styles = NULL;
+    	}
+    	StyleBufSetAllLen(highlightData->styleBuffer, styles, length);
+    	NEditFree(styles);
+    	stitchExportChunks(highlightData, buf, work.chunks, nChunks,
+    	    	work.delimiters);
+    } else
+    	StyleBufFill(highlightData->styleBuffer, 0, 0, UNFINISHED_STYLE,
+    	    	length);
+    
+    /* Parse the chunks with pass 2 patterns, with the safety regions of
+       parseBufferRange on either side, and format them */
+    for (i=0; i<nChunks; i++) {
+    	chunk = &work.chunks[i];
+    	if (highlightData->pass2Patterns == NULL) {
+    	    chunk->parseStart = chunk->start;
+    	    chunk->parseEnd = chunk->end;
+    	} else {
+    	    chunk->parseStart = backwardOneContext(buf, context, chunk->start);
+    	    chunk->parseEnd = forwardOneContext(buf, context, chunk->end);
+    	}
+    	chunk->styles = StyleBufGetRange(highlightData->styleBuffer,
+    	    	chunk->parseStart, chunk->parseEnd);
+    }
+    runExportPass(&work, 2, threads, nThreads);
+    LastExport.parseTime = profileClock() - parseStart;
+    
+    fp = fopen(fileName, "w");
+    if (fp != NULL && format == EXPORT_HTML) {
+    	fprintf(fp, "<!DOCTYPE html>\n<html>\n<head>\n"
+    	    	"<meta charset=\"UTF-8\">\n<title>");
+    	writeEscapedHTML(fp, window->filename);
+    	fprintf(fp, "</title>\n</head>\n<body style=\"color:#%02x%02x%02x;"
+    	    	"background-color:#%02x%02x%02x\">\n<pre>",
+    	    	window->colorProfile->textFgColor.color.red >> 8,
+    	    	window->colorProfile->textFgColor.color.green >> 8,
+    	    	window->colorProfile->textFgColor.color.blue >> 8,
+    	    	window->colorProfile->textBgColor.color.red >> 8,
+    	    	window->colorProfile->textBgColor.color.green >> 8,
+    	    	window->colorProfile->textBgColor.color.blue >> 8);
+    }
+    markup = NULL;
+    for (i=0; i<nChunks; i++) {
+    	chunk = &work.chunks[i];
+    	if (fp == NULL) {
+    	    NEditFree(chunk->output);
+    	    NEditFree(chunk->styles);
+    	    continue;
+    	}
+    	if (chunk->firstStyle != markup) {
+    	    if (markup != NULL)
+    	    	fputs(work.styleEnd, fp);
+    	    if (chunk->firstStyle != NULL)
+    	    	fputs(chunk->firstStyle, fp);
+    	}
+    	fwrite(chunk->output, 1, chunk->outputLen, fp);
+    	markup = chunk->lastStyle;
+    	NEditFree(chunk->output);
+    	NEditFree(chunk->styles);
+    }
+    if (fp != NULL) {
+    	if (markup != NULL)
+    	    fputs(work.styleEnd, fp);
+    	if (format == EXPORT_HTML)
+    	    fprintf(fp, "</pre>\n</body>\n</html>\n");
+    	written = !ferror(fp);
+    	if (fclose(fp) != 0)
+    	    written = False;
+    } else
+    	written = False;
+    
+    LastExport.bytes = length;
+    LastExport.nThreads = nThreads;
+    LastExport.nChunks = nChunks;
+    LastExport.busyTime = 0.0;
+    for (i=0; i<nThreads; i++) {
+    	LastExport.busyTime += threads[i].busyTime;
+    	releaseCompiledPatterns(threads[i].compiled);
+    }
+    for (i=0; i<work.nStyles; i++)
+    	NEditFree(work.styleStart[i]);
+    NEditFree(work.styleStart);
+    pthread_mutex_destroy(&work.lock);
+    NEditFree(threads);
+    NEditFree(work.chunks);
+    NEditFree(text);
+    freeHighlightData(highlightData);
+    LastExport.time = profileClock() - startTime;
+    return written;
+}
+
+/*
+** Return the timing of the last ExportHighlighting as text, in an allocated
+** string: the size of the text and the number of threads, the time taken
+** as a whole and for parsing, and the rate each thread parsed at while it
+** was busy, which is what is gained from each added processor.
+*/
+char *ExportHighlightingReport(void)
+{
+    exportTiming *t = &LastExport;
+    char *report = (char *)NEditMalloc(400);
+    double mb = t->bytes / (1024.0 * 1024.0);
+    
+    if (t->nThreads == 0) {
+    	strcpy(report, "no export\n");
+    	return report;
     }
-
-    NEditFree(patterns);
+    sprintf(report, "%ld bytes, %d threads, %d chunks\n"
+    	    "total %.3f s, %.1f MB/s\n"
+    	    "parse %.3f s, %.1f MB/s\n"
+    	    "per thread %.1f MB/s\n",
+    	    (long)t->bytes, t->nThreads, t->nChunks,
+    	    t->time, t->time > 0.0 ? mb / t->time : 0.0,
+    	    t->parseTime, t->parseTime > 0.0 ? mb / t->parseTime : 0.0,
+    	    t->busyTime > 0.0 ? mb / t->busyTime : 0.0);
+    return report;
 }
 
 /*
-** Find the highlightPattern structure with a given name in the window.
+** Run pass "pass" of ExportHighlighting over all of the chunks of "work",
+** in "nThreads" threads.  If threads can't be started, the work is done in
+** this one.
 */
-highlightPattern *FindPatternOfWindow(WindowInfo *window, char *name)
+static void runExportPass(exportWork *work, int pass, exportThread *threads,
+        int nThreads)
 {
-    windowHighlightData *hData = (windowHighlightData *)window->highlightData;
-    patternSet *set;
-    int i;
-
-    if (hData && (set = hData->patternSetForWindow)) {
-      for (i = 0; i < set->nPatterns; i++)
-          if (strcmp(set->patterns[i].name, name) == 0)
-              return &set->patterns[i];
-    }
-    return NULL;
+    int i, nStarted;
+    
+    work->pass = pass;
+    work->nextChunk = 0;
+    for (nStarted=1; nStarted<nThreads; nStarted++)
+    	if (pthread_create(&threads[nStarted].thread, NULL, exportWorker,
+    	    	&threads[nStarted]) != 0)
+    	    break;
+    exportWorker(&threads[0]);
+    for (i=1; i<nStarted; i++)
+    	pthread_join(threads[i].thread, NULL);
 }
 
 /*
-** Picks up the entry in the style buffer for the position (if any). Rather
-** like styleOfPos() in textDisp.c. Returns the style code or zero.
+** Thread procedure for ExportHighlighting, takes chunks from the shared
+** work until there are none left
 */
-int HighlightCodeOfPos(WindowInfo *window, int pos)
+static void *exportWorker(void *arg)
 {
-    windowHighlightData *highlightData =
-          (windowHighlightData *)window->highlightData;
-    textBuffer *styleBuf =
-          highlightData ? highlightData->styleBuffer : NULL;
-    int hCode = 0;
+    exportThread *thread = (exportThread *)arg;
+    exportWork *work = thread->work;
+    int chunkIndex;
+    double start;
     
-    if (styleBuf != NULL) {
-      hCode = (unsigned char)BufGetCharacter(styleBuf, pos);
-      if (hCode == UNFINISHED_STYLE) {
-          /* encountered "unfinished" style, trigger parsing */
-          handleUnparsedRegion(window, highlightData->styleBuffer, pos);
-          hCode = (unsigned char)BufGetCharacter(styleBuf, pos);
-      }
+    for (;;) {
+    	pthread_mutex_lock(&work->lock);
+    	chunkIndex = work->nextChunk++;
+    	pthread_mutex_unlock(&work->lock);
+    	if (chunkIndex >= work->nChunks)
+    	    break;
+    	start = profileClock();
+    	if (work->pass == 1)
+    	    exportChunkPass1(work, thread->compiled,
+    	    	    &work->chunks[chunkIndex]);
+    	else
+    	    exportChunkPass2(work, thread->compiled,
+    	    	    &work->chunks[chunkIndex]);
+    	thread->busyTime += profileClock() - start;
     }
-    return hCode;
+    return NULL;
 }
 
 /*
-** Returns the length over which a particular highlight code applies, starting
-** at pos. If the initial code value *checkCode is zero, the highlight code of
-** pos is used.
+** Parse "chunk" provisionally with the top level pass 1 patterns.  Matches
+** may run on to the end of the context beyond the chunk.
 */
-/* YOO: This is called form only one other function, which uses a constant
-    for checkCode and never evaluates it after the call. */
-int HighlightLengthOfCodeFromPos(WindowInfo *window, int pos, int *checkCode)
+static void exportChunkPass1(exportWork *work, compiledPatterns *compiled,
+        exportChunk *chunk)
 {
-    windowHighlightData *highlightData =
-          (windowHighlightData *)window->highlightData;
-    textBuffer *styleBuf =
-          highlightData ? highlightData->styleBuffer : NULL;
-    int hCode;
-    int oldPos = pos;
+    const char *stringPtr = &work->text[chunk->start];
+    char *stylePtr, prevChar;
     
-    if (styleBuf != NULL) {
-      hCode = (unsigned char)BufGetCharacter(styleBuf, pos);
-      if (!hCode)
-          return 0;
-      if (hCode == UNFINISHED_STYLE) {
-          /* encountered "unfinished" style, trigger parsing */
-          handleUnparsedRegion(window, highlightData->styleBuffer, pos);
-          hCode = (unsigned char)BufGetCharacter(styleBuf, pos);
-      }
-      if (*checkCode == 0)
-          *checkCode = hCode;
-      while (hCode == *checkCode || hCode == UNFINISHED_STYLE) {
-          if (hCode == UNFINISHED_STYLE) {
-              /* encountered "unfinished" style, trigger parsing, then loop */
-              handleUnparsedRegion(window, highlightData->styleBuffer, pos);
-              hCode = (unsigned char)BufGetCharacter(styleBuf, pos);
-          }
-          else {
-              /* advance the position and get the new code */
-              hCode = (unsigned char)BufGetCharacter(styleBuf, ++pos);
-          }
-      }
-    }
-    return pos - oldPos;
+    chunk->styles = (char *)NEditMalloc(chunk->parseEnd - chunk->start + 1);
+    stylePtr = chunk->styles;
+    prevChar = chunk->start == 0 ? '\0' : work->text[chunk->start-1];
+    parseString(compiled->pass1Patterns, &stringPtr, &stylePtr,
+    	    chunk->end - chunk->start, &prevChar, False, work->delimiters,
+    	    work->text, &work->text[chunk->parseEnd]);
 }
 
 /*
-** Returns the length over which a particular style applies, starting at pos. 
-** If the initial code value *checkCode is zero, the highlight code of pos 
-** is used.
+** Parse "chunk" with pass 2 patterns, starting from the styles left by
+** pass 1, and format the result.  Pass 2 parsing puts temporary string
+** terminators in the text, so it works on a copy.
 */
-int StyleLengthOfCodeFromPos(WindowInfo *window, int pos, 
-                             const char **checkStyleName)
+static void exportChunkPass2(exportWork *work, compiledPatterns *compiled,
+        exportChunk *chunk)
 {
-    windowHighlightData *highlightData =
-          (windowHighlightData *)window->highlightData;
-    textBuffer *styleBuf =
-          highlightData ? highlightData->styleBuffer : NULL;
-    int hCode;
-    int oldPos = pos;
-    styleTableEntry *entry;
+    ssize_t length = chunk->parseEnd - chunk->parseStart;
+    char *string, prevChar;
     
-    if (styleBuf != NULL) {
-      hCode = (unsigned char)BufGetCharacter(styleBuf, pos);
-      if (!hCode)
-          return 0;
-      if (hCode == UNFINISHED_STYLE) {
-          /* encountered "unfinished" style, trigger parsing */
-          handleUnparsedRegion(window, highlightData->styleBuffer, pos);
-          hCode = (unsigned char)BufGetCharacter(styleBuf, pos);
-      }
-      entry = styleTableEntryOfCode(window, hCode);
-      if (entry == NULL) 
-          return 0;
-      if ((*checkStyleName) == NULL)
-          (*checkStyleName) = entry->styleName;
-      while (hCode == UNFINISHED_STYLE ||
-             ((entry = styleTableEntryOfCode(window, hCode)) &&
-                strcmp(entry->styleName, (*checkStyleName)) == 0)) {
-          if (hCode == UNFINISHED_STYLE) {
-              /* encountered "unfinished" style, trigger parsing, then loop */
-              handleUnparsedRegion(window, highlightData->styleBuffer, pos);
-              hCode = (unsigned char)BufGetCharacter(styleBuf, pos);
-          }
-          else {
-              /* advance the position and get the new code */
-              hCode = (unsigned char)BufGetCharacter(styleBuf, ++pos);
-          }
-      }
+    string = (char *)NEditMalloc(length + 1);
+    memcpy(string, &work->text[chunk->parseStart], length);
+    string[length] = '\0';
+    if (compiled->pass2Patterns != NULL) {
+    	prevChar = chunk->parseStart == 0 ? '\0' :
+    	    	work->text[chunk->parseStart-1];
+    	passTwoParseString(compiled->pass2Patterns, string, chunk->styles,
+    	    	chunk->end - chunk->parseStart, &prevChar, work->delimiters,
+    	    	string, NULL);
     }
-    return pos - oldPos;
+    formatExportChunk(work, chunk, &string[chunk->start - chunk->parseStart],
+    	    &chunk->styles[chunk->start - chunk->parseStart]);
+    NEditFree(string);
 }
 
 /*
-** Returns a pointer to the entry in the style table for the entry of code
-** hCode (if any).
+** Correct the provisional pass 1 styles of the chunks after the first, now
+** in the style buffer of "highlightData".  Going through the chunks in
+** order, so that the styles before each are right, re-parse from the start
+** of each, in steps growing by powers of two (see incrementalReparse), until
+** no style has changed for one context distance.  From there on, the
+** provisional parse started out in the same state as the real one.
 */
-static styleTableEntry *styleTableEntryOfCode(WindowInfo *window, int hCode)
+static void stitchExportChunks(windowHighlightData *highlightData,
+        textBuffer *buf, exportChunk *chunks, int nChunks,
+        const char *delimiters)
 {
-    windowHighlightData *highlightData =
-          (windowHighlightData *)window->highlightData;
-
-    hCode -= UNFINISHED_STYLE;       /* get the correct index value */
-    if (!highlightData || hCode < 0 || hCode >= highlightData->nStyles)
-      return NULL;
-    return &highlightData->styleTable[hCode];
+    selection *sel = &highlightData->styleBuffer->primary;
+    reparseContext *context = &highlightData->contextRequirements;
+    int i, nPasses;
+    
+    highlightData->pass1ParsedTo = chunks[0].end;
+    for (i=1; i<nChunks; i++) {
+    	
+    	/* If re-parsing the last chunk went on into this one, it's done */
+    	if (chunks[i].start < highlightData->pass1ParsedTo)
+    	    continue;
+    	highlightData->pass1ParsedTo = chunks[i].start;
+    	StyleBufUnselect(highlightData->styleBuffer);
+    	for (nPasses=0; highlightData->pass1ParsedTo < buf->length;
+    	    	nPasses++) {
+    	    extendPass1Parse(highlightData, buf,
+    	    	    forwardOneContext(buf, context,
+    	    	    highlightData->pass1ParsedTo) +
+    	    	    (REPARSE_CHUNK_SIZE << nPasses), delimiters);
+    	    if (!sel->selected || forwardOneContext(buf, context, sel->end) <=
+    	    	    highlightData->pass1ParsedTo)
+    	    	break;
+    	}
+    }
+    StyleBufUnselect(highlightData->styleBuffer);
 }
 
 /*
-** Functions to return style information from the highlighting style table.
+** Return the markup starting text in the style of "entry", in an allocated
+** string
 */
-
-char *HighlightNameOfCode(WindowInfo *window, int hCode)
+static char *exportStyleMarkup(styleTableEntry *entry, int format)
 {
-    styleTableEntry *entry = styleTableEntryOfCode(window, hCode);
-    return entry ? entry->highlightName : "";
+    char markup[160], *ptr = markup;
+    
+    if (format == EXPORT_HTML) {
+    	ptr += sprintf(ptr, "<span style=\"color:#%02x%02x%02x",
+    	    	entry->color.color.red >> 8, entry->color.color.green >> 8,
+    	    	entry->color.color.blue >> 8);
+    	if (entry->bgColorName != NULL)
+    	    ptr += sprintf(ptr, ";background-color:#%02x%02x%02x",
+    	    	    entry->bgColor.color.red >> 8,
+    	    	    entry->bgColor.color.green >> 8,
+    	    	    entry->bgColor.color.blue >> 8);
+    	if (entry->isBold)
+    	    ptr += sprintf(ptr, ";font-weight:bold");
+    	if (entry->isItalic)
+    	    ptr += sprintf(ptr, ";font-style:italic");
+    	sprintf(ptr, "\">");
+    } else {
+    	ptr += sprintf(ptr, "\033[0;38;2;%d;%d;%d",
+    	    	entry->color.color.red >> 8, entry->color.color.green >> 8,
+    	    	entry->color.color.blue >> 8);
+    	if (entry->bgColorName != NULL)
+    	    ptr += sprintf(ptr, ";48;2;%d;%d;%d",
+    	    	    entry->bgColor.color.red >> 8,
+    	    	    entry->bgColor.color.green >> 8,
+    	    	    entry->bgColor.color.blue >> 8);
+    	if (entry->isBold)
+    	    ptr += sprintf(ptr, ";1");
+    	if (entry->isItalic)
+    	    ptr += sprintf(ptr, ";3");
+    	sprintf(ptr, "m");
+    }
+    return NEditStrdup(markup);
 }
 
-char *HighlightStyleOfCode(WindowInfo *window, int hCode)
+/*
+** Format the text of "chunk", "text", in "styles" as chunk->output.  The
+** markup starting the first style and ending the last is left to
+** ExportHighlighting, which leaves it out where a style runs on from one
+** chunk into the next.
+*/
+static void formatExportChunk(exportWork *work, exportChunk *chunk,
+        const char *text, const char *styles)
 {
-    styleTableEntry *entry = styleTableEntryOfCode(window, hCode);
-    return entry ? entry->styleName : "";
+    ssize_t i, runStart, length = chunk->end - chunk->start;
+    const char *markup, *escape;
+    int style;
+    
+    for (i=0; i<length; ) {
+    	
+    	/* Find the run of text in the same style, and start its markup */
+    	runStart = i;
+    	for (style=styles[i]; i<length && styles[i]==style; i++);
+    	style -= ASCII_A;
+    	markup = style >= 0 && style < work->nStyles ?
+    	    	work->styleStart[style] : NULL;
+    	if (runStart == 0)
+    	    chunk->firstStyle = markup;
+    	else if (markup != NULL)
+    	    appendExportOutput(chunk, markup, strlen(markup));
+    	
+    	/* Copy the run, escaping characters which are special in HTML */
+    	if (work->format != EXPORT_HTML)
+    	    appendExportOutput(chunk, &text[runStart], i - runStart);
+    	else {
+    	    for ( ; runStart < i; runStart++) {
+    	    	escape = text[runStart] == '&' ? "&amp;" :
+    	    	    	text[runStart] == '<' ? "&lt;" :
+    	    	    	text[runStart] == '>' ? "&gt;" : NULL;
+    	    	if (escape != NULL)
+    	    	    appendExportOutput(chunk, escape, strlen(escape));
+    	    	else
+    	    	    appendExportOutput(chunk, &text[runStart], 1);
+    	    }
+    	}
+    	if (i == length)
+    	    chunk->lastStyle = markup;
+    	else if (markup != NULL)
+    	    appendExportOutput(chunk, work->styleEnd, strlen(work->styleEnd));
+    }
 }
 
-
-XftColor HighlightColorValueOfCode(WindowInfo *window, int hCode,
-      int *r, int *g, int *b)
+static void appendExportOutput(exportChunk *chunk, const char *text,
+        size_t length)
 {
-    styleTableEntry *entry = styleTableEntryOfCode(window, hCode);
-    if (entry) {
-        *r = entry->color.color.red;
-        *g = entry->color.color.green;
-        *b = entry->color.color.blue;
-        return entry->color;
-    }
-    else
-    {
-        /* pick up foreground color of the (first) text widget of the window */
-        XftColor color = TextGetFGColor(window->textArea);
-        *r = color.color.red;
-        *g = color.color.green;
-        *b = color.color.blue;
-        return color;
+    if (chunk->outputLen + length > chunk->outputAlloc) {
+    	chunk->outputAlloc = max(chunk->outputAlloc * 2,
+    	    	chunk->outputLen + length + 4096);
+    	chunk->output = (char *)NEditRealloc(chunk->output,
+    	    	chunk->outputAlloc);
     }
+    memcpy(&chunk->output[chunk->outputLen], text, length);
+    chunk->outputLen += length;
 }
 
-XftColor GetHighlightBGColorOfCode(WindowInfo *window, int hCode,
-      int *r, int *g, int *b)
+static void writeEscapedHTML(FILE *fp, const char *text)
 {
-    styleTableEntry *entry = styleTableEntryOfCode(window, hCode);
-    if (entry && entry->bgColorName) {
-        *r = entry->bgColor.color.red;
-        *g = entry->bgColor.color.green;
-        *b = entry->bgColor.color.blue;
-        return entry->bgColor;
-    }
-    else
-    {
-        /* pick up background color of the (first) text widget of the window */
-        XftColor color = TextGetBGColor(window->textArea);
-        *r = color.color.red;
-        *g = color.color.green;
-        *b = color.color.blue;
-        return color;
+    for ( ; *text != '\0'; text++) {
+    	if (*text == '&')
+    	    fputs("&amp;", fp);
+    	else if (*text == '<')
+    	    fputs("&lt;", fp);
+    	else if (*text == '>')
+    	    fputs("&gt;", fp);
+    	else
+    	    fputc(*text, fp);
     }
 }
 
 /*
-** Callback to parse an "unfinished" region of the buffer.  "unfinished" means
-** that the buffer has been parsed with pass 1 patterns, but this section has
-** not yet been exposed, and thus never had pass 2 patterns applied.  This
-** callback is invoked when the text widget's display routines encounter one
-** of these unfinished regions.  "pos" is the first position encountered which
-** needs re-parsing.  This routine applies pass 2 patterns to a chunk of
-** the buffer of size PASS_2_REPARSE_CHUNK_SIZE beyond pos.
+** Redraw the text whose style has been changed outside of a buffer
+** modification (marked by selecting it in the style buffer), in all panes
 */
-static void handleUnparsedRegion(const WindowInfo* window, textBuffer* styleBuf,
-        int pos)
+static void redisplayStyleChanges(WindowInfo *window)
 {
-    textBuffer *buf = window->buffer;
-    int beginParse, endParse, beginSafety, endSafety, p;
     windowHighlightData *highlightData =
             (windowHighlightData *)window->highlightData;
-
-    reparseContext *context = &highlightData->contextRequirements;
-    highlightDataRec *pass2Patterns = highlightData->pass2Patterns;
-    char *string, *styleString, *stylePtr, c, prevChar;
-    const char *stringPtr;
-      
-    /* If there are no pass 2 patterns to process, do nothing (but this
-       should never be triggered) */
-    if (pass2Patterns == NULL)
-    	return;
-    
-    int firstPass2Style = (unsigned char)pass2Patterns[1].style;
-    
-    /* Find the point at which to begin parsing to ensure that the character at
-       pos is parsed correctly (beginSafety), at most one context distance back
-       from pos, unless there is a pass 1 section from which to start */
-    beginParse = pos;
-    beginSafety = backwardOneContext(buf, context, beginParse);
-    for (p=beginParse; p>=beginSafety; p--) {
-    	c = BufGetCharacter(styleBuf, p);
-    	if (c != UNFINISHED_STYLE && c != PLAIN_STYLE &&
-		(unsigned char)c < firstPass2Style) {
-    	    beginSafety = p + 1;
-    	    break;
-    	}
-    }
-    
-    /* Decide where to stop (endParse), and the extra distance (endSafety)
-       necessary to ensure that the changes at endParse are correct.  Stop at
-       the end of the unfinished region, or a max. of PASS_2_REPARSE_CHUNK_SIZE
-       characters forward from the requested position */
-    endParse = min(buf->length, pos + PASS_2_REPARSE_CHUNK_SIZE);
-    endSafety = forwardOneContext(buf, context, endParse);
-    for (p=pos; p<endSafety; p++) {
-    	c = BufGetCharacter(styleBuf, p);
-    	if (c != UNFINISHED_STYLE && c != PLAIN_STYLE &&
-		(unsigned char)c < firstPass2Style) {
-    	    endParse = min(endParse, p);
-    	    endSafety = p;
-    	    break;
-    	} else if (c != UNFINISHED_STYLE && p < endParse) {
-    	    endParse = p;
-    	    if ((unsigned char)c < firstPass2Style)
-    	    	endSafety = p;
-    	    else
-    	    	endSafety = forwardOneContext(buf, context, endParse);
-    	    break;
-    	}
-    }
-    
-    /* Copy the buffer range into a string */
-    /* printf("callback pass2 parsing from %d thru %d w/ safety from %d thru %d\n",
-    	    beginParse, endParse, beginSafety, endSafety); */
-    stringPtr = string = BufGetRange(buf, beginSafety, endSafety);
-    styleString = stylePtr = BufGetRange(styleBuf, beginSafety, endSafety);
+    selection *sel = &highlightData->styleBuffer->primary;
+    ssize_t start, end;
+    int i;
     
-    /* Parse it with pass 2 patterns */
-    prevChar = getPrevChar(buf, beginSafety);
-    parseString(pass2Patterns, &stringPtr, &stylePtr, endParse - beginSafety,
-    	    &prevChar, False, GetWindowDelimiters(window), string, NULL);
-
-    /* Update the style buffer the new style information, but only between
-       beginParse and endParse.  Skip the safety region */
-    styleString[endParse-beginSafety] = '\0';
-    BufReplace(styleBuf, beginParse, endParse,
-    	    &styleString[beginParse-beginSafety]);
-    NEditFree(styleString);
-    NEditFree(string);    
-}
-
-/*
-** Callback wrapper around the above function.
-*/
-static void handleUnparsedRegionCB(const textDisp* textD, int pos,
-        const void* cbArg)
-{
-    handleUnparsedRegion((WindowInfo*) cbArg, textD->styleBuffer, pos);
+    highlightData->redisplayPending = False;
+    if (!sel->selected)
+    	return;
+    start = sel->start;
+    end = sel->end;
+    StyleBufUnselect(highlightData->styleBuffer);
+    if (!XtIsRealized(window->textArea))
+    	return;
+    TextDRedisplayRange(((TextWidget)window->textArea)->text.textD,
+    	    start, end);
+    for (i=0; i<window->nPanes; i++)
+    	TextDRedisplayRange(((TextWidget)window->textPanes[i])->text.textD,
+    	    	start, end);
 }
 
 /*
 ** Re-parse the smallest region possible around a modification to buffer "buf"
 ** to gurantee that the promised context lines and characters have
 ** been presented to the patterns.  Changes the style buffer in "highlightData"
-** with the parsing result.
+** with the parsing result.  Parsing does not extend beyond "parseLimit",
+** where the text that has been parsed ends.
 */
 static void incrementalReparse(windowHighlightData *highlightData,
-    	textBuffer *buf, int pos, int nInserted, const char *delimiters)
+    	textBuffer *buf, ssize_t pos, ssize_t nInserted,
+        const char *delimiters, ssize_t parseLimit)
 {
-    int beginParse, endParse, endAt, lastMod, parseInStyle, nPasses;
-    textBuffer *styleBuf = highlightData->styleBuffer;
+    ssize_t beginParse, endParse, endAt, lastMod;
+    int parseInStyle, nPasses;
+    styleBuffer *styleBuf = highlightData->styleBuffer;
     highlightDataRec *pass1Patterns = highlightData->pass1Patterns;
     highlightDataRec *pass2Patterns = highlightData->pass2Patterns;
     highlightDataRec *startPattern;
@@ -1386,7 +3425,7 @@ static void incrementalReparse(windowHighlightData *highlightData,
        parsing, unless styles are getting changed beyond the last
        modification */
     lastMod = pos + nInserted;
-    endParse = forwardOneContext(buf, context, lastMod);
+    endParse = min(parseLimit, forwardOneContext(buf, context, lastMod));
     
     /*
     ** Parse the buffer from beginParse, until styles compare
@@ -1417,8 +3456,8 @@ static void incrementalReparse(windowHighlightData *highlightData,
 	   hierarchy and start again from where the previous parse left off. */
 	if (endAt < endParse) {
 	    beginParse = endAt;
-	    endParse = forwardOneContext(buf, context,
-	    	    max(endAt, max(lastModified(styleBuf), lastMod)));
+	    endParse = min(parseLimit, forwardOneContext(buf, context,
+	    	    max(endAt, max(lastModified(styleBuf), lastMod))));
 	    if (IS_PLAIN(parseInStyle)) {
 		fprintf(stderr,
 			"XNEdit internal error: incr. reparse fell short\n");
@@ -1426,8 +3465,9 @@ static void incrementalReparse(windowHighlightData *highlightData,
 	    }
 	    parseInStyle = parentStyleOf(parentStyles, parseInStyle);
 	    
-	/* One context distance beyond last style changed means we're done */
-	} else if (lastModified(styleBuf) <= lastMod) {
+	/* One context distance beyond last style changed means we're done,
+	   and so does reaching the end of the parsed text */
+	} else if (lastModified(styleBuf) <= lastMod || endParse >= parseLimit) {
 	    return;
 	    
 	/* Styles are changing beyond the modification, continue extending
@@ -1435,7 +3475,7 @@ static void incrementalReparse(windowHighlightData *highlightData,
 	   reparse until nothing changes */
 	} else {
 	    lastMod = lastModified(styleBuf);
-    	    endParse = min(buf->length, forwardOneContext(buf, context, lastMod)
+    	    endParse = min(parseLimit, forwardOneContext(buf, context, lastMod)
     	    	    + (REPARSE_CHUNK_SIZE << nPasses));
 	}
     }	
@@ -1456,15 +3496,16 @@ static void incrementalReparse(windowHighlightData *highlightData,
 ** finished (this will normally be endParse, unless the pass1Patterns is a
 ** pattern which does end and the end is reached).
 */
-static int parseBufferRange(highlightDataRec *pass1Patterns,
-    	highlightDataRec *pass2Patterns, textBuffer *buf, textBuffer *styleBuf,
-        reparseContext *contextRequirements, int beginParse, int endParse,
-        const char *delimiters)
+static ssize_t parseBufferRange(highlightDataRec *pass1Patterns,
+    	highlightDataRec *pass2Patterns, textBuffer *buf, styleBuffer *styleBuf,
+        reparseContext *contextRequirements, ssize_t beginParse,
+        ssize_t endParse, const char *delimiters)
 {
     char *string, *styleString, *stylePtr, *temp, prevChar;
     const char *stringPtr;
-    int endSafety, endPass2Safety, startPass2Safety, tempLen;
-    int modStart, modEnd, beginSafety, beginStyle, p, style;
+    ssize_t endSafety, endPass2Safety, startPass2Safety, tempLen;
+    ssize_t modStart, modEnd, beginSafety, p;
+    int beginStyle, style;
     int firstPass2Style = pass2Patterns == NULL ? INT_MAX :
 	    (unsigned char)pass2Patterns[1].style;
     
@@ -1473,7 +3514,7 @@ static int parseBufferRange(highlightDataRec *pass1Patterns,
     if (CAN_CROSS_LINE_BOUNDARIES(contextRequirements)) {
     	beginSafety = backwardOneContext(buf, contextRequirements, beginParse);
      	for (p=beginParse; p>=beginSafety; p--) {
-    	    style = BufGetCharacter(styleBuf, p-1);
+    	    style = StyleBufGetCharacter(styleBuf, p-1);
     	    if (!EQUIVALENT_STYLE(style, beginStyle, firstPass2Style)) {
     	    	beginSafety = p;
     	    	break;
@@ -1481,7 +3522,7 @@ static int parseBufferRange(highlightDataRec *pass1Patterns,
     	}
     } else {
     	for (beginSafety=max(0,beginParse-1); beginSafety>0; beginSafety--) {
-    	    style = BufGetCharacter(styleBuf, beginSafety);
+    	    style = StyleBufGetCharacter(styleBuf, beginSafety);
     	    if (!EQUIVALENT_STYLE(style, beginStyle, firstPass2Style) ||
     	    	    BufGetCharacter(buf, beginSafety) == '\n') {
     	    	beginSafety++;
@@ -1504,7 +3545,7 @@ static int parseBufferRange(highlightDataRec *pass1Patterns,
     
     /* copy the buffer range into a string */
     string = BufGetRange(buf, beginSafety, endSafety);
-    styleString = BufGetRange(styleBuf, beginSafety, endSafety);
+    styleString = StyleBufGetRange(styleBuf, beginSafety, endSafety);
     
     /* Parse it with pass 1 patterns */
     /* printf("parsing from %d thru %d\n", beginSafety, endSafety); */
@@ -1635,16 +3676,29 @@ static int parseString(highlightDataRec *pattern, const char **string,
     char savedPrevChar;
     char succChar = match_till ? (*match_till) : '\0';
     highlightDataRec *subPat = NULL, *subSubPat;
+    const char *searchEnd;
+    double searchStart = 0.0;
+    int matched;
     
     if (length <= 0)
     	return False;
 
     stringPtr = *string;
     stylePtr = *styleString;
+    searchEnd = anchored ? *string+1 : *string+length+1;
     
-    while (ExecRE(pattern->subPatternRE, stringPtr, anchored ? *string+1 :
-	    *string+length+1, False, *prevChar, succChar, delimiters,
-            lookBehindTo, match_till)) {
+    for (;;) {
+	if (HighlightProfiling)
+	    searchStart = profileClock();
+	matched = ExecRE(pattern->subPatternRE, stringPtr, searchEnd, False,
+		*prevChar, succChar, delimiters, lookBehindTo, match_till);
+	if (HighlightProfiling)
+	    profileSearch(pattern, profileClock() - searchStart, matched,
+		    stringPtr, searchEnd, *prevChar, succChar, delimiters,
+		    lookBehindTo, match_till);
+	if (!matched)
+	    break;
+
 	/* Beware of the case where only one real branch exists, but that 
 	   branch has sub-branches itself. In that case the top_branch refers 
 	   to the matching sub-branch and must be ignored. */
@@ -1718,6 +3772,8 @@ static int parseString(highlightDataRec *pattern, const char **string,
     	    fprintf(stderr, "Internal error, failed to match in parseString\n");
     	    return False;
     	}
+    	if (HighlightProfiling)
+    	    addToProfile(subPat->profile, 0, 1, 0, 0.0, 0.0);
     	
     	/* the sub-pattern is a simple match, just color it */
     	if (subPat->subPatternRE == NULL) {
@@ -1872,11 +3928,11 @@ static void fillStyleString(const char **stringPtr, char **stylePtr,
 ** for distinguishing pass 2 styles which compare as equal to the unfinished
 ** style in the original buffer, from pass1 styles which signal a change.
 */
-static void modifyStyleBuf(textBuffer *styleBuf, char *styleString,
-    	int startPos, int endPos, int firstPass2Style)
+static void modifyStyleBuf(styleBuffer *styleBuf, char *styleString,
+    	ssize_t startPos, ssize_t endPos, int firstPass2Style)
 {
     char *c, bufChar;
-    int pos, modStart, modEnd, minPos = INT_MAX, maxPos = 0;
+    ssize_t pos, modStart, modEnd, minPos = SSIZE_MAX, maxPos = 0;
     selection *sel = &styleBuf->primary;
     
     /* Skip the range already marked for redraw */
@@ -1891,7 +3947,7 @@ static void modifyStyleBuf(textBuffer *styleBuf, char *styleString,
        the modifications.  Unfinished styles in the original match any
        pass 2 style */
     for (c=styleString, pos=startPos; pos<modStart && pos<endPos; c++, pos++) {
-    	bufChar = BufGetCharacter(styleBuf, pos);
+    	bufChar = StyleBufGetCharacter(styleBuf, pos);
     	if (*c != bufChar && !(bufChar == UNFINISHED_STYLE &&
     	    	(*c == PLAIN_STYLE || (unsigned char)*c >= firstPass2Style))) {
     	    if (pos < minPos) minPos = pos;
@@ -1900,7 +3956,7 @@ static void modifyStyleBuf(textBuffer *styleBuf, char *styleString,
     }
     for (c=&styleString[max(0, modEnd-startPos)], pos=max(modEnd, startPos);
     	    pos<endPos; c++, pos++) {
-    	bufChar = BufGetCharacter(styleBuf, pos);
+    	bufChar = StyleBufGetCharacter(styleBuf, pos);
     	if (*c != bufChar && !(bufChar == UNFINISHED_STYLE &&
     	    	(*c == PLAIN_STYLE || (unsigned char)*c >= firstPass2Style))) {
     	    if (pos < minPos) minPos = pos;
@@ -1909,12 +3965,12 @@ static void modifyStyleBuf(textBuffer *styleBuf, char *styleString,
     }
     
     /* Make the modification */
-    BufReplace(styleBuf, startPos, endPos, styleString);
+    StyleBufReplace(styleBuf, startPos, endPos, styleString);
     
     /* Mark or extend the range that needs to be redrawn.  Even if no
        change was made, it's important to re-establish the selection,
        because it can get damaged by the BufReplace above */
-    BufSelect(styleBuf, min(modStart, minPos), max(modEnd, maxPos));
+    StyleBufSelect(styleBuf, min(modStart, minPos), max(modEnd, maxPos));
 }
 
 /*
@@ -1922,7 +3978,7 @@ static void modifyStyleBuf(textBuffer *styleBuf, char *styleString,
 ** by the convention used for conveying modification information to the
 ** text widget, which is selecting the text)
 */
-static int lastModified(textBuffer *styleBuf)
+static ssize_t lastModified(styleBuffer *styleBuf)
 {
     if (styleBuf->primary.selected)
     	return max(0, styleBuf->primary.end);
@@ -2117,7 +4173,7 @@ XftColor AllocXftColor(Widget w, const char *colorName)
 /*
 ** Get the character before position "pos" in buffer "buf"
 */
-static char getPrevChar(textBuffer *buf, int pos)
+static char getPrevChar(textBuffer *buf, ssize_t pos)
 {
     return pos == 0 ? '\0' : BufGetCharacter(buf, pos-1);
 }
@@ -2195,9 +4251,10 @@ static int patternIsParsable(highlightDataRec *pattern)
 ** and, if it does, is unlikely to result in incorrect highlighting.
 */
 static int findSafeParseRestartPos(textBuffer *buf,
-    	windowHighlightData *highlightData, int *pos)
+    	windowHighlightData *highlightData, ssize_t *pos)
 {
-    int style, startStyle, runningStyle, checkBackTo, safeParseStart, i;
+    int style, startStyle, runningStyle;
+    ssize_t checkBackTo, safeParseStart, i;
     char *parentStyles = highlightData->parentStyles;
     highlightDataRec *pass1Patterns = highlightData->pass1Patterns;
     reparseContext *context = &highlightData->contextRequirements;
@@ -2209,7 +4266,7 @@ static int findSafeParseRestartPos(textBuffer *buf,
        the buffer, this is a safe place to begin parsing, and we're done */
     if (*pos == 0)
     	return PLAIN_STYLE;
-    startStyle = BufGetCharacter(highlightData->styleBuffer, *pos);
+    startStyle = StyleBufGetCharacter(highlightData->styleBuffer, *pos);
     if (IS_PLAIN(startStyle))
     	return PLAIN_STYLE;
     
@@ -2245,7 +4302,7 @@ static int findSafeParseRestartPos(textBuffer *buf,
     	
     	/* If the style is preceded by a parent style, it's safe to parse
 	   with the parent style, provided that the parent is parsable. */
-    	style = BufGetCharacter(highlightData->styleBuffer, i);
+    	style = StyleBufGetCharacter(highlightData->styleBuffer, i);
 	if (isParentStyle(parentStyles, style, runningStyle)) {
 	    if (patternIsParsable(patternOfStyle(pass1Patterns, style))) {
 		*pos = i + 1;
@@ -2333,8 +4390,8 @@ static int findSafeParseRestartPos(textBuffer *buf,
 ** only one extra character, but I'm not sure, and my brain hurts from
 ** thinking about it).
 */
-static int backwardOneContext(textBuffer *buf, reparseContext *context,
-    	int fromPos)
+static ssize_t backwardOneContext(textBuffer *buf, reparseContext *context,
+    	ssize_t fromPos)
 {
     if (context->nLines == 0)
     	return max(0, fromPos - context->nChars);
@@ -2354,8 +4411,8 @@ static int backwardOneContext(textBuffer *buf, reparseContext *context,
 ** next line, rather than the newline character at the end (see notes in
 ** backwardOneContext).
 */
-static int forwardOneContext(textBuffer *buf, reparseContext *context,
-    	int fromPos)
+static ssize_t forwardOneContext(textBuffer *buf, reparseContext *context,
+    	ssize_t fromPos)
 {
     if (context->nLines == 0)
     	return min(buf->length, fromPos + context->nChars);
@@ -2397,12 +4454,12 @@ static highlightDataRec *patternOfStyle(highlightDataRec *patterns, int style)
     return NULL;
 }
 
-static int max(int i1, int i2)
+static ssize_t max(ssize_t i1, ssize_t i2)
 {
     return i1 >= i2 ? i1 : i2;
 }
 
-static int min(int i1, int i2)
+static ssize_t min(ssize_t i1, ssize_t i2)
 {
     return i1 <= i2 ? i1 : i2;
 }
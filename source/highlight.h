@@ -29,6 +29,7 @@
 
 #include "nedit.h"
 
+#include <stdio.h>
 #include <X11/Intrinsic.h>
 
 /* Pattern flags for modifying pattern matching behavior */
@@ -40,6 +41,9 @@
    with EBCDIC coding (possibly negative offsets when subtracting 'A'). */
 #define ASCII_A ((char)65)
 
+/* Output formats of ExportHighlighting */
+enum exportFormats {EXPORT_HTML, EXPORT_ANSI};
+
 /* Pattern specification structure */
 typedef struct {
     char *name;
@@ -60,8 +64,10 @@ typedef struct {
     highlightPattern *patterns;
 } patternSet;
 
-void SyntaxHighlightModifyCB(int pos, int nInserted, int nDeleted,
-    	int nRestyled, const char *deletedText, void *cbArg);
+void SyntaxHighlightModifyCB(ssize_t pos, ssize_t nInserted, ssize_t nDeleted,
+    	ssize_t nRestyled, const char *deletedText, void *cbArg);
+void SyntaxHighlightBeginModifyCB(void *cbArg);
+void SyntaxHighlightEndModifyCB(void *cbArg);
 void StartHighlighting(WindowInfo *window, int warn);
 void StopHighlighting(WindowInfo *window);
 void AttachHighlightToWidget(Widget widget, WindowInfo *window);
@@ -69,6 +75,15 @@ void FreeHighlightingData(WindowInfo *window);
 void RemoveWidgetHighlight(Widget widget);
 void UpdateHighlightStyles(WindowInfo *window, Boolean redisplay);
 int TestHighlightPatterns(patternSet *patSet);
+void ForgetCompiledPatterns(patternSet *patSet);
+void GetHighlightCacheStats(unsigned long *hits, unsigned long *misses);
+void SetHighlightProfiling(int enable);
+void ResetHighlightProfile(void);
+int ProfileWindowHighlighting(WindowInfo *window);
+char *HighlightProfileReport(const char *sortBy);
+int ExportHighlighting(WindowInfo *window, const char *fileName, int format,
+        int nThreads);
+char *ExportHighlightingReport(void);
 Pixel AllocateColor(Widget w, const char *colorName);
 void SetParseColorError(int value);
 XftColor ParseXftColor(Display *display, Colormap colormap, Pixel foreground, int depth, const char *colorName);
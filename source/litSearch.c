@@ -0,0 +1,357 @@
+/*******************************************************************************
+*                                                                              *
+* litSearch.c -- Nirvana Editor Literal String Search                          *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* software; if not, write to the Free Software Foundation, Inc., 59 Temple     *
+* Place, Suite 330, Boston, MA  02111-1307 USA                                 *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Search engine for literal (non-regular expression) search strings.  A
+** search string is compiled once into a pattern holding what is needed to
+** search in either direction, so that searching backward is as fast as
+** searching forward: the bytes which can begin and end a match, for finding
+** candidate matches with the vector scanning kernels of textScan.c, and the
+** Horspool skip tables used instead where there are no vector kernels.
+**
+** For case insensitive searches, each byte of the search string may match
+** either the corresponding byte of its upper case or its lower case form,
+** which is what the skip tables and candidate scans go by.  This works for
+** any character whose two forms are encoded in the same number of bytes,
+** which covers ASCII and nearly all of UTF-8.  A multi-byte character must
+** still match one form or the other as a whole, since mixing the bytes of
+** the two can make a different character (the first byte of "Р" and the
+** second of "р" are "Ѐ"), so candidates are checked character by character
+** where the string has such characters.  For the few characters where the
+** forms differ in length (for example German sharp s), the pattern is
+** matched character by character throughout, and skipping is limited to
+** finding the possible first bytes of a match.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include "litSearch.h"
+#include "search.h"
+#include "../util/nedit_malloc.h"
+
+#include <string.h>
+#include <ctype.h>
+
+#ifdef HAVE_DEBUG_H
+#include "../debug.h"
+#endif
+
+static void caseForms(const char *c, int caseSense, char *upper, int *upLen,
+        char *lower, int *lowLen, int *charLen);
+static int matchesAt(const litPattern *pat, const unsigned char *s,
+        int from, int to);
+static int matchChars(const litPattern *pat, const char *s, const char *end);
+static const char *findFixedForward(const litPattern *pat, const char *text,
+        size_t length);
+static const char *findFixedBackward(const litPattern *pat, const char *text,
+        size_t lastStart, size_t length);
+
+/*
+** Compile the null-terminated search string "string" for searching with
+** LitFindForward and LitFindBackward.  The pattern must be freed with LitFree.
+*/
+litPattern *LitCompile(const char *string, int caseSense)
+{
+    litPattern *pat;
+    litChar *ch;
+    const char *c;
+    char firstBytes[3];
+    int i, m, upLen, lowLen, charLen;
+
+    pat = NEditNew(litPattern);
+    m = pat->length = strlen(string);
+    pat->caseSense = caseSense;
+    pat->variable = False;
+    pat->wholeChars = False;
+    pat->upper = (unsigned char *)NEditMalloc(m + 1);
+    pat->lower = (unsigned char *)NEditMalloc(m + 1);
+    pat->chars = (litChar *)NEditMalloc(sizeof(litChar) * (m + 1));
+    pat->nChars = 0;
+    pat->minMatch = pat->maxMatch = 0;
+
+    /* Find the case forms of each character of the string */
+    for (c=string, i=0; *c != '\0'; c += charLen, i += charLen) {
+        ch = &pat->chars[pat->nChars++];
+        caseForms(c, caseSense, ch->seq[0], &upLen, ch->seq[1], &lowLen,
+                &charLen);
+        ch->len[0] = upLen;
+        ch->len[1] = lowLen;
+        if (upLen != charLen || lowLen != charLen)
+            pat->variable = True;
+        else {
+            if (charLen > 1 && memcmp(ch->seq[0], ch->seq[1], charLen) != 0)
+                pat->wholeChars = True;
+            memcpy(&pat->upper[i], ch->seq[0], charLen);
+            memcpy(&pat->lower[i], ch->seq[1], charLen);
+        }
+        pat->minMatch += upLen < lowLen ? upLen : lowLen;
+        pat->maxMatch += upLen > lowLen ? upLen : lowLen;
+    }
+
+    if (pat->variable) {
+        NEditFree(pat->upper);
+        NEditFree(pat->lower);
+        pat->upper = pat->lower = NULL;
+        firstBytes[0] = pat->chars[0].seq[0][0];
+        firstBytes[1] = pat->chars[0].seq[1][0];
+        firstBytes[2] = '\0';
+        ScanInitCharSet(&pat->first, firstBytes);
+        return pat;
+    }
+    if (!pat->wholeChars) {
+        NEditFree(pat->chars);
+        pat->chars = NULL;
+        pat->nChars = 0;
+    }
+    firstBytes[0] = pat->upper[0];
+    firstBytes[1] = pat->lower[0];
+    firstBytes[2] = '\0';
+    ScanInitCharSet(&pat->first, firstBytes);
+    firstBytes[0] = pat->upper[m-1];
+    firstBytes[1] = pat->lower[m-1];
+    ScanInitCharSet(&pat->last, firstBytes);
+
+    /* Where the scanning kernels compare many bytes at a time, candidate
+       matches are found by looking for the first and last bytes of the
+       string together, which is faster than skipping through the text one
+       window at a time.  Otherwise, use Horspool skip tables.  Searching
+       forward, the window moves until its last byte lines up with the
+       rightmost other occurrence of that byte in the string, and searching
+       backward, until its first byte lines up with the leftmost other
+       occurrence */
+    pat->horspool = !ScanIsVectorized();
+    for (i=0; i<256; i++)
+        pat->fwdShift[i] = pat->bwdShift[i] = m;
+    for (i=0; i<m-1; i++)
+        pat->fwdShift[pat->upper[i]] = pat->fwdShift[pat->lower[i]] = m-1-i;
+    for (i=m-1; i>0; i--)
+        pat->bwdShift[pat->upper[i]] = pat->bwdShift[pat->lower[i]] = i;
+    return pat;
+}
+
+void LitFree(litPattern *pat)
+{
+    if (pat == NULL)
+        return;
+    NEditFree(pat->upper);
+    NEditFree(pat->lower);
+    NEditFree(pat->chars);
+    NEditFree(pat);
+}
+
+/*
+** Find the first match for "pat" lying entirely within "length" bytes of
+** "text".  Returns a pointer to the start of the match and its length in
+** "matchLen", or NULL if there is no match.
+*/
+const char *LitFindForward(const litPattern *pat, const char *text,
+        size_t length, int *matchLen)
+{
+    const char *p, *end = text + length;
+    int len;
+
+    if (pat->length == 0)
+        return NULL;
+    if (!pat->variable) {
+        *matchLen = pat->length;
+        return findFixedForward(pat, text, length);
+    }
+    for (p = text; p < end; p++) {
+        if ((p = ScanFindCharSet(p, end - p, &pat->first)) == NULL)
+            return NULL;
+        if ((len = matchChars(pat, p, end)) >= 0) {
+            *matchLen = len;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/*
+** Find the last match for "pat" which starts no later than "lastStart" bytes
+** into "text", and lies entirely within "length" bytes of "text".
+*/
+const char *LitFindBackward(const litPattern *pat, const char *text,
+        size_t lastStart, size_t length, int *matchLen)
+{
+    const char *p, *end = text + length;
+    size_t n;
+    int len;
+
+    if (pat->length == 0)
+        return NULL;
+    if (!pat->variable) {
+        *matchLen = pat->length;
+        return findFixedBackward(pat, text, lastStart, length);
+    }
+    for (n = lastStart < length ? lastStart + 1 : length; n > 0;
+            n = p - text) {
+        if ((p = ScanFindCharSetBackward(text, n, &pat->first)) == NULL)
+            return NULL;
+        if ((len = matchChars(pat, p, end)) >= 0) {
+            *matchLen = len;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static const char *findFixedForward(const litPattern *pat, const char *text,
+        size_t length)
+{
+    const unsigned char *s = (const unsigned char *)text, *last;
+    unsigned char c, up, low;
+    int m = pat->length;
+
+    if (length < (size_t)m)
+        return NULL;
+    if (m == 1)
+        return ScanFindCharSet(text, length, &pat->first);
+    if (!pat->horspool) {
+        for (;; s++) {
+            s = (const unsigned char *)ScanFindCharSetPair((const char *)s,
+                    text + length - (const char *)s, &pat->first, &pat->last,
+                    m - 1);
+            if (s == NULL || matchesAt(pat, s, 1, m-1))
+                return (const char *)s;
+        }
+    }
+    last = s + length - m;
+    up = pat->upper[m-1];
+    low = pat->lower[m-1];
+    while (s <= last) {
+        c = s[m-1];
+        if ((c == up || c == low) && matchesAt(pat, s, 0, m-1))
+            return (const char *)s;
+        s += pat->fwdShift[c];
+    }
+    return NULL;
+}
+
+static const char *findFixedBackward(const litPattern *pat, const char *text,
+        size_t lastStart, size_t length)
+{
+    const unsigned char *t = (const unsigned char *)text, *s;
+    unsigned char c, up, low;
+    int m = pat->length, shift;
+
+    if (length < (size_t)m)
+        return NULL;
+    if (lastStart > length - m)
+        lastStart = length - m;
+    if (m == 1)
+        return ScanFindCharSetBackward(text, lastStart + 1, &pat->first);
+    if (!pat->horspool) {
+        for (length = lastStart + m; ; length = s - t + m - 1) {
+            s = (const unsigned char *)ScanFindCharSetPairBackward(text,
+                    length, &pat->first, &pat->last, m - 1);
+            if (s == NULL || matchesAt(pat, s, 1, m-1))
+                return (const char *)s;
+        }
+    }
+    s = t + lastStart;
+    up = pat->upper[0];
+    low = pat->lower[0];
+    for (;;) {
+        c = *s;
+        if ((c == up || c == low) && matchesAt(pat, s, 1, m))
+            return (const char *)s;
+        shift = pat->bwdShift[c];
+        if (s - t < shift)
+            return NULL;
+        s -= shift;
+    }
+}
+
+/*
+** Compare bytes "from" through "to"-1 of a fixed length pattern with "s".
+** With wholeChars, all of the pattern is compared, a character at a time.
+*/
+static int matchesAt(const litPattern *pat, const unsigned char *s,
+        int from, int to)
+{
+    int i;
+
+    if (pat->caseSense)
+        return memcmp(s + from, pat->upper + from, to - from) == 0;
+    if (pat->wholeChars)
+        return matchChars(pat, (const char *)s,
+                (const char *)s + pat->length) >= 0;
+    for (i=from; i<to; i++)
+        if (s[i] != pat->upper[i] && s[i] != pat->lower[i])
+            return False;
+    return True;
+}
+
+/*
+** Match a pattern character by character at "s".  Returns
+** the length of the match, or -1 if it does not match.  One form is tried
+** before the other without backtracking, which is enough because no valid
+** UTF-8 sequence is a prefix of another.
+*/
+static int matchChars(const litPattern *pat, const char *s, const char *end)
+{
+    const litChar *ch;
+    const char *p = s;
+    int i;
+
+    for (i=0; i<pat->nChars; i++) {
+        ch = &pat->chars[i];
+        if (ch->len[0] <= end - p && !memcmp(p, ch->seq[0], ch->len[0]))
+            p += ch->len[0];
+        else if (ch->len[1] <= end - p && !memcmp(p, ch->seq[1], ch->len[1]))
+            p += ch->len[1];
+        else
+            return -1;
+    }
+    return p - s;
+}
+
+/*
+** Get the upper and lower case forms of the character at "c", in the same
+** way as UpCaseString and DownCaseString
+*/
+static void caseForms(const char *c, int caseSense, char *upper, int *upLen,
+        char *lower, int *lowLen, int *charLen)
+{
+    int len;
+
+    if (caseSense || (unsigned char)*c < 0x80) {
+        upper[0] = caseSense ? *c : toupper((unsigned char)*c);
+        lower[0] = caseSense ? *c : tolower((unsigned char)*c);
+        *upLen = *lowLen = *charLen = 1;
+        return;
+    }
+    ChangeCase(c, upper, True, charLen, upLen);
+    ChangeCase(c, lower, False, &len, lowLen);
+
+    /* Sequences which are not valid UTF-8 come back as a null byte */
+    if (memchr(upper, '\0', *upLen) != NULL) {
+        memcpy(upper, c, *charLen);
+        *upLen = *charLen;
+    }
+    if (memchr(lower, '\0', *lowLen) != NULL) {
+        memcpy(lower, c, *charLen);
+        *lowLen = *charLen;
+    }
+}
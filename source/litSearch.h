@@ -0,0 +1,67 @@
+/*******************************************************************************
+*                                                                              *
+* litSearch.h -- Nirvana Editor Literal String Search Header File              *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* software; if not, write to the Free Software Foundation, Inc., 59 Temple     *
+* Place, Suite 330, Boston, MA  02111-1307 USA                                 *
+*                                                                              *
+*******************************************************************************/
+
+#ifndef NEDIT_LITSEARCH_H_INCLUDED
+#define NEDIT_LITSEARCH_H_INCLUDED
+
+#include "textScan.h"
+
+#include <stddef.h>
+
+/* One character of a case insensitive pattern whose upper and lower case
+   forms are encoded with different numbers of bytes */
+typedef struct {
+    unsigned char len[2];	    /* lengths of the two forms */
+    char seq[2][8];		    /* upper and lower case UTF-8 sequences */
+} litChar;
+
+/* A search string compiled for LitFindForward and LitFindBackward */
+typedef struct {
+    int length;                     /* length of the search string */
+    int minMatch, maxMatch;         /* shortest and longest possible match */
+    int caseSense;
+    int variable;                   /* matches are found character by
+                                       character (see litChar), rather than
+                                       byte by byte */
+    unsigned char *upper, *lower;   /* the two bytes which can match each
+                                       position of the search string */
+    int wholeChars;                 /* the upper and lower case forms of
+                                       a multi-byte character differ, and
+                                       must not be mixed within it */
+    int nChars;                     /* variable or wholeChars: characters
+                                       of the string */
+    litChar *chars;
+    scanCharSet first;              /* bytes which can start a match */
+    scanCharSet last;               /* bytes which can end a match */
+    int horspool;                   /* find candidates using the skip tables
+                                       rather than ScanFindCharSetPair */
+    int fwdShift[256];              /* Horspool skip distances, indexed by */
+    int bwdShift[256];              /* the last/first byte under the window */
+} litPattern;
+
+litPattern *LitCompile(const char *string, int caseSense);
+void LitFree(litPattern *pat);
+const char *LitFindForward(const litPattern *pat, const char *text,
+        size_t length, int *matchLen);
+const char *LitFindBackward(const litPattern *pat, const char *text,
+        size_t lastStart, size_t length, int *matchLen);
+
+#endif /* NEDIT_LITSEARCH_H_INCLUDED */
@@ -358,6 +358,14 @@ static int rangesetListMV(WindowInfo *window, DataValue *argList,
 	int nArgs, DataValue *result, char **errMsg);
 static int versionMV(WindowInfo* window, DataValue* argList, int nArgs,
         DataValue* result, char** errMsg);
+static int regexCacheHitsMV(WindowInfo* window, DataValue* argList, int nArgs,
+        DataValue* result, char** errMsg);
+static int regexCacheMissesMV(WindowInfo* window, DataValue* argList,
+        int nArgs, DataValue* result, char** errMsg);
+static int highlightCacheHitsMV(WindowInfo* window, DataValue* argList,
+        int nArgs, DataValue* result, char** errMsg);
+static int highlightCacheMissesMV(WindowInfo* window, DataValue* argList,
+        int nArgs, DataValue* result, char** errMsg);
 static int rangesetCreateMS(WindowInfo *window, DataValue *argList, int nArgs,
       DataValue *result, char **errMsg);
 static int rangesetDestroyMS(WindowInfo *window, DataValue *argList, int nArgs,
@@ -400,6 +408,12 @@ static int getStyleAtPosMS(WindowInfo *window, DataValue *argList, int nArgs,
         DataValue *result, char **errMsg);
 static int filenameDialogMS(WindowInfo* window, DataValue* argList, int nArgs,
         DataValue* result, char** errMsg);
+static int highlightProfileMS(WindowInfo *window, DataValue *argList,
+        int nArgs, DataValue *result, char **errMsg);
+static int exportHighlightingMS(WindowInfo *window, DataValue *argList,
+        int nArgs, DataValue *result, char **errMsg);
+static int renderStatsMS(WindowInfo *window, DataValue *argList,
+        int nArgs, DataValue *result, char **errMsg);
 
 /* Built-in subroutines and variables for the macro language */
 static BuiltInSubr MacroSubrs[] = {lengthMS, getRangeMS, tPrintMS,
@@ -418,7 +432,8 @@ static BuiltInSubr MacroSubrs[] = {lengthMS, getRangeMS, tPrintMS,
         rangesetSetColorMS, rangesetSetNameMS, rangesetSetModeMS,
         rangesetGetByNameMS,
         getPatternByNameMS, getPatternAtPosMS,
-        getStyleByNameMS, getStyleAtPosMS, filenameDialogMS
+        getStyleByNameMS, getStyleAtPosMS, filenameDialogMS,
+        highlightProfileMS, exportHighlightingMS, renderStatsMS
     };
 #define N_MACRO_SUBRS (sizeof MacroSubrs/sizeof *MacroSubrs)
 static const char *MacroSubrNames[N_MACRO_SUBRS] = {"length", "get_range", "t_print",
@@ -437,7 +452,8 @@ static const char *MacroSubrNames[N_MACRO_SUBRS] = {"length", "get_range", "t_pr
         "rangeset_set_color", "rangeset_set_name", "rangeset_set_mode",
         "rangeset_get_by_name",
         "get_pattern_by_name", "get_pattern_at_pos",
-        "get_style_by_name", "get_style_at_pos", "filename_dialog"
+        "get_style_by_name", "get_style_at_pos", "filename_dialog",
+        "highlight_profile", "export_highlighting", "render_stats"
     };
 static BuiltInSubr SpecialVars[] = {cursorMV, lineMV, columnMV,
         fileNameMV, filePathMV, lengthMV, selectionStartMV, selectionEndMV,
@@ -453,7 +469,8 @@ static BuiltInSubr SpecialVars[] = {cursorMV, lineMV, columnMV,
         displayWidthMV, activePaneMV, nPanesMV, emptyArrayMV,
         serverNameMV, calltipIDMV,
 /* DISABLED for 5.4        backlightStringMV, */
-	rangesetListMV, versionMV
+	rangesetListMV, versionMV, regexCacheHitsMV, regexCacheMissesMV,
+	highlightCacheHitsMV, highlightCacheMissesMV
     };
 #define N_SPECIAL_VARS (sizeof SpecialVars/sizeof *SpecialVars)
 static const char *SpecialVarNames[N_SPECIAL_VARS] = {"$cursor", "$line", "$column",
@@ -471,7 +488,9 @@ static const char *SpecialVarNames[N_SPECIAL_VARS] = {"$cursor", "$line", "$colu
         "$display_width", "$active_pane", "$n_panes", "$empty_array",
         "$server_name", "$calltip_ID",
 /* DISABLED for 5.4       "$backlight_string", */
-        "$rangeset_list", "$VERSION"
+        "$rangeset_list", "$VERSION", "$regex_cache_hits",
+        "$regex_cache_misses", "$highlight_cache_hits",
+        "$highlight_cache_misses"
     };
 
 /* Global symbols for returning values from built-in functions */
@@ -2499,7 +2518,8 @@ static int searchMS(WindowInfo *window, DataValue *argList, int nArgs,
 static int searchStringMS(WindowInfo *window, DataValue *argList, int nArgs,
     	DataValue *result, char **errMsg)
 {
-    int beginPos, wrap, direction, found = False, foundStart, foundEnd, type;
+    int beginPos, wrap, direction, found = False, type;
+    ssize_t foundStart, foundEnd;
     int skipSearch = False, len;
     char stringStorage[2][TYPE_INT_STR_SIZE(int)], *string, *searchStr;
     
@@ -2568,8 +2588,8 @@ static int replaceInStringMS(WindowInfo *window, DataValue *argList, int nArgs,
 {
     char stringStorage[3][TYPE_INT_STR_SIZE(int)], *string, *searchStr, *replaceStr;
     char *argStr, *replacedStr;
-    int searchType = SEARCH_LITERAL, copyStart, copyEnd;
-    int replacedLen, replaceEnd, force=False, i;
+    int searchType = SEARCH_LITERAL, force=False, i;
+    ssize_t copyStart, copyEnd, replacedLen, replaceEnd;
     
     /* Validate arguments and convert to proper types */
     if (nArgs < 3 || nArgs > 5)
@@ -3885,7 +3905,8 @@ static int splitMS(WindowInfo *window, DataValue *argList, int nArgs,
 {
     char stringStorage[3][TYPE_INT_STR_SIZE(int)];
     char *sourceStr, *splitStr, *typeSplitStr;
-    int searchType, beginPos, foundStart, foundEnd, strLength, lastEnd;
+    int searchType, beginPos, strLength, lastEnd;
+    ssize_t foundStart, foundEnd;
     int found, elementEnd, indexNum;
     char indexStr[TYPE_INT_STR_SIZE(int)], *allocIndexStr;
     DataValue element;
@@ -4587,6 +4608,59 @@ static int versionMV(WindowInfo* window, DataValue* argList, int nArgs,
     return True;
 }
 
+/*
+** Return how many times a regular expression used for searching was found
+** already compiled, and how many times it had to be compiled.
+*/
+static int regexCacheHitsMV(WindowInfo* window, DataValue* argList, int nArgs,
+        DataValue* result, char** errMsg)
+{
+    unsigned long hits, misses;
+
+    GetRegexCacheStats(&hits, &misses);
+    result->tag = INT_TAG;
+    result->val.n = (int)hits;
+    return True;
+}
+
+static int regexCacheMissesMV(WindowInfo* window, DataValue* argList,
+        int nArgs, DataValue* result, char** errMsg)
+{
+    unsigned long hits, misses;
+
+    GetRegexCacheStats(&hits, &misses);
+    result->tag = INT_TAG;
+    result->val.n = (int)misses;
+    return True;
+}
+
+/*
+** Return how many times a window's syntax highlighting patterns were found
+** already compiled for another window, and how many times they had to be
+** compiled.
+*/
+static int highlightCacheHitsMV(WindowInfo* window, DataValue* argList,
+        int nArgs, DataValue* result, char** errMsg)
+{
+    unsigned long hits, misses;
+
+    GetHighlightCacheStats(&hits, &misses);
+    result->tag = INT_TAG;
+    result->val.n = (int)hits;
+    return True;
+}
+
+static int highlightCacheMissesMV(WindowInfo* window, DataValue* argList,
+        int nArgs, DataValue* result, char** errMsg)
+{
+    unsigned long hits, misses;
+
+    GetHighlightCacheStats(&hits, &misses);
+    result->tag = INT_TAG;
+    result->val.n = (int)misses;
+    return True;
+}
+
 /*
 ** Built-in macro subroutine to create a new rangeset or rangesets.  
 ** If called with one argument: $1 is the number of rangesets required and 
@@ -4810,11 +4884,12 @@ static int rangesetAddMS(WindowInfo *window, DataValue *argList, int nArgs,
 
     if (nArgs == 1) {
         /* pick up current selection in this window */
-        if (!BufGetSelectionPos(buffer, &start, &end,
+        ssize_t selStart, selEnd;
+        if (!BufGetSelectionPos(buffer, &selStart, &selEnd,
               &isRect, &rectStart, &rectEnd) || isRect) {
             M_FAILURE("Selection missing or rectangular in call to %s");
         }
-        if (!RangesetAddBetween(targetRangeset, start, end)) {
+        if (!RangesetAddBetween(targetRangeset, selStart, selEnd)) {
             M_FAILURE("Failure to add selection in %s");
         }
     }
@@ -4907,11 +4982,12 @@ static int rangesetSubtractMS(WindowInfo *window, DataValue *argList, int nArgs,
 
     if (nArgs == 1) {
       /* remove current selection in this window */
-        if (!BufGetSelectionPos(buffer, &start, &end, &isRect, &rectStart, &rectEnd) 
+        ssize_t selStart, selEnd;
+        if (!BufGetSelectionPos(buffer, &selStart, &selEnd, &isRect, &rectStart, &rectEnd) 
                 || isRect) {
             M_FAILURE("Selection missing or rectangular in call to %s");
         }
-        RangesetRemoveBetween(targetRangeset, start, end);
+        RangesetRemoveBetween(targetRangeset, selStart, selEnd);
     }
     
     if (nArgs == 2) {
@@ -5069,7 +5145,8 @@ static int rangesetRangeMS(WindowInfo *window, DataValue *argList, int nArgs,
     textBuffer *buffer = window->buffer;
     RangesetTable *rangesetTable = buffer->rangesetTable;
     Rangeset *rangeset;
-    int start, end, dummy, rangeIndex, ok;
+    ssize_t start, end, dummy;
+    int rangeIndex, ok;
     DataValue element;
     int label = 0;
 
@@ -5530,6 +5607,142 @@ static int getStyleAtPosMS(WindowInfo *window, DataValue *argList, int nArgs,
         HighlightStyleOfCode(window, patCode), False, True, patCode, bufferPos);
 }
 
+/*
+** Built-in macro subroutine for profiling syntax highlighting patterns:
+**      highlight_profile("on"), highlight_profile("off")
+**          start or stop counting the searches made for each pattern as
+**          text is highlighted
+**      highlight_profile("reset")
+**          clear the counts
+**      highlight_profile("parse")
+**          count a parse of all of the text of the window
+**      highlight_profile(["report" [, sort_key]])
+**          return the counts as text, sorted by "time" (the default),
+**          "inner", "attempts", "matches", "bytes", or "name"
+**      highlight_profile("export")
+**          return the timing of the last export_highlighting as text
+*/
+static int highlightProfileMS(WindowInfo *window, DataValue *argList,
+        int nArgs, DataValue *result, char **errMsg)
+{
+    char stringStorage[2][TYPE_INT_STR_SIZE(int)];
+    char *action = "report", *sortBy = "time", *report;
+
+    if (nArgs > 2)
+        return wrongNArgsErr(errMsg);
+    if (nArgs > 0 && !readStringArg(argList[0], &action, stringStorage[0],
+            errMsg))
+        return False;
+    if (nArgs > 1 && !readStringArg(argList[1], &sortBy, stringStorage[1],
+            errMsg))
+        return False;
+
+    result->tag = STRING_TAG;
+    if (!strcmp(action, "report")) {
+        if ((report = HighlightProfileReport(sortBy)) == NULL)
+            M_FAILURE("Unknown sort key in %s");
+        AllocNStringCpy(&result->val.str, report);
+        NEditFree(report);
+        M_STR_ALLOC_ASSERT((*result));
+        return True;
+    }
+    if (nArgs > 1)
+        return wrongNArgsErr(errMsg);
+    if (!strcmp(action, "export")) {
+        report = ExportHighlightingReport();
+        AllocNStringCpy(&result->val.str, report);
+        NEditFree(report);
+        M_STR_ALLOC_ASSERT((*result));
+        return True;
+    }
+    if (!strcmp(action, "on"))
+        SetHighlightProfiling(True);
+    else if (!strcmp(action, "off"))
+        SetHighlightProfiling(False);
+    else if (!strcmp(action, "reset"))
+        ResetHighlightProfile();
+    else if (!strcmp(action, "parse")) {
+        if (!ProfileWindowHighlighting(window))
+            M_FAILURE("Syntax highlighting is not on in the window for %s");
+    } else
+        M_FAILURE("Unknown action in %s");
+    result->val.str.rep = PERM_ALLOC_STR("");
+    result->val.str.len = 0;
+    return True;
+}
+
+/*
+** Built-in macro subroutine for writing the text of the window, syntax
+** highlighted with the patterns of its language mode, to the file named in
+** $1.  Optional $2 is the format, "html" (the default) or "ansi" for text
+** with ANSI color escape sequences, and $3 the number of threads to use (by
+** default, one per processor).  Returns 1 on successful write, or 0 if
+** unsuccessful or there are no highlight patterns for the language mode.
+*/
+static int exportHighlightingMS(WindowInfo *window, DataValue *argList,
+        int nArgs, DataValue *result, char **errMsg)
+{
+    char stringStorage[2][TYPE_INT_STR_SIZE(int)], *name, *formatName = "html";
+    int format, nThreads = 0;
+
+    if (nArgs < 1 || nArgs > 3)
+        return wrongNArgsErr(errMsg);
+    if (!readStringArg(argList[0], &name, stringStorage[0], errMsg))
+        return False;
+    if (nArgs > 1 && !readStringArg(argList[1], &formatName,
+            stringStorage[1], errMsg))
+        return False;
+    if (nArgs > 2 && !readIntArg(argList[2], &nThreads, errMsg))
+        return False;
+    if (!strcmp(formatName, "html"))
+        format = EXPORT_HTML;
+    else if (!strcmp(formatName, "ansi"))
+        format = EXPORT_ANSI;
+    else
+        M_FAILURE("Unknown format in %s");
+
+    result->tag = INT_TAG;
+    result->val.n = ExportHighlighting(window, name, format, nThreads);
+    return True;
+}
+
+/*
+** Built-in macro subroutine for measuring the drawing of the text pane with
+** the keyboard focus:
+**      render_stats(["report"])
+**          return the counts of lines drawn, characters measured and time
+**          spent drawing since the last reset, as text
+**      render_stats("reset")
+**          clear the counts
+*/
+static int renderStatsMS(WindowInfo *window, DataValue *argList,
+        int nArgs, DataValue *result, char **errMsg)
+{
+    char stringStorage[TYPE_INT_STR_SIZE(int)], *action = "report", *report;
+
+    if (nArgs > 1)
+        return wrongNArgsErr(errMsg);
+    if (nArgs > 0 && !readStringArg(argList[0], &action, stringStorage,
+            errMsg))
+        return False;
+
+    result->tag = STRING_TAG;
+    if (!strcmp(action, "report")) {
+        report = TextGetRenderStats(window->lastFocus);
+        AllocNStringCpy(&result->val.str, report);
+        NEditFree(report);
+        M_STR_ALLOC_ASSERT((*result));
+        return True;
+    }
+    if (!strcmp(action, "reset"))
+        TextResetRenderStats(window->lastFocus);
+    else
+        M_FAILURE("Unknown action in %s");
+    result->val.str.rep = PERM_ALLOC_STR("");
+    result->val.str.len = 0;
+    return True;
+}
+
 /*
 ** Sets up an array containing information about a pattern given its name or
 ** a buffer position (bufferPos >= 0).
@@ -4032,7 +4032,8 @@ static void beginningOfSelectionAP(Widget w, XEvent *event, String *args,
 	Cardinal *nArgs)
 {
     textBuffer *buf = TextGetBuffer(w);
-    int start, end, isRect, rectStart, rectEnd;
+    ssize_t start, end;
+    int isRect, rectStart, rectEnd;
     
     if (!BufGetSelectionPos(buf, &start, &end, &isRect, &rectStart, &rectEnd))
     	return;
@@ -4047,7 +4048,8 @@ static void endOfSelectionAP(Widget w, XEvent *event, String *args,
 	Cardinal *nArgs)
 {
     textBuffer *buf = TextGetBuffer(w);
-    int start, end, isRect, rectStart, rectEnd;
+    ssize_t start, end;
+    int isRect, rectStart, rectEnd;
     
     if (!BufGetSelectionPos(buf, &start, &end, &isRect, &rectStart, &rectEnd))
     	return;
@@ -155,17 +155,32 @@ enum truncSubstitution {TRUNCSUBST_SILENT, TRUNCSUBST_FAIL, TRUNCSUBST_WARN, TRU
 #define DISABLE_COLORPROFILES
 #endif
 
+/* One of the edits of an undo record of edits made at once (see
+   BufApplyEdits), with the positions they would have had if made one at
+   a time */
+typedef struct {
+    ssize_t	startPos;
+    ssize_t	endPos;
+    char	*oldText;
+} UndoEdit;
+
 /* Record on undo list */
 typedef struct _UndoInfo {
     struct _UndoInfo *next;		/* pointer to the next undo record */
     int		type;
-    int		startPos;
-    int		endPos;
-    int 	oldLen;
+    ssize_t	startPos;
+    ssize_t	endPos;
+    ssize_t	oldLen;
     char	*oldText;
-    short       numOp;                  /* Number of undo records
+    int		nEdits;			/* number of edits in "edits", for
+    					   a record of edits made at once,
+    					   otherwise 0 */
+    UndoEdit	*edits;
+    int         numOp;                  /* Number of undo records
                                            for this operation.
                                            */
+    char        singleCursor;           /* batch operation is undone with
+                                           one cursor, not one per record */
     char	inUndo;			/* flag to indicate undo command on
     					   this record in progress.  Redirects
     					   SaveUndoInfo to save the next mod-
@@ -179,7 +194,7 @@ typedef struct _UndoInfo {
 /* Element in bookmark table */
 typedef struct {
     char label;
-    int cursorPos;
+    ssize_t cursorPos;
     selection sel;
 } Bookmark;
 
@@ -500,6 +515,9 @@ typedef struct _WindowInfo {
     UndoInfo	*redo;			/* info for redoing last undone op */
     UndoInfo    *undo_batch_begin;      /* last undo item at batch-begin */
     int         undo_batch_count;       /* undo items per batch */
+    int         undo_batch_open;        /* a modification batch is in
+                                           progress */
+    int         undo_batch_single_cursor; /* see UndoInfo singleCursor */
     int         undo_op_batch_size;     /* batch size of undo operation */
     textBuffer	*buffer;		/* holds the text being edited */
     int		nPanes;			/* number of additional text editing
@@ -508,7 +526,7 @@ typedef struct _WindowInfo {
     					   since last backup file generated */
     int		autoSaveOpCount;	/* count of editing operations "" */
     int		undoOpCount;		/* count of stored undo operations */
-    int		undoMemUsed;		/* amount of memory (in bytes)
+    ssize_t	undoMemUsed;		/* amount of memory (in bytes)
     					   dedicated to the undo list */
     char	fontName[MAX_FONT_LEN];	/* names of the text fonts in use */
     char	italicFontName[MAX_FONT_LEN];
@@ -573,8 +591,8 @@ typedef struct _WindowInfo {
     Boolean	windowMenuValid;	/* is window menu up to date? */
     int		rHistIndex, fHistIndex;	/* history placeholders for */
     int     	iSearchHistIndex;	/*   find and replace dialogs */
-    int     	iSearchStartPos;    	/* start pos. of current incr. search */
-    int       	iSearchLastBeginPos;    /* beg. pos. last match of current i.s.*/
+    ssize_t    	iSearchStartPos;    	/* start pos. of current incr. search */
+    ssize_t    	iSearchLastBeginPos;    /* beg. pos. last match of current i.s.*/
     int     	nMarks;     	    	/* number of active bookmarks */
     XtIntervalId markTimeoutID;	    	/* backup timer for mark event handler*/
     Bookmark	markTable[MAX_MARKS];	/* marked locations in window */
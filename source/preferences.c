@@ -5076,7 +5076,8 @@ static void reapplyLanguageMode(WindowInfo *window, int mode, int forceDefaults)
 static int matchLanguageMode(WindowInfo *window)
 {
     char *ext, *first200;
-    int i, j, fileNameLen, extLen, beginPos, endPos, start;
+    int i, j, fileNameLen, extLen, start;
+    ssize_t beginPos, endPos;
     const char *versionExtendedPath;
 
     /*... look for an explicit mode statement first */
@@ -6145,7 +6146,7 @@ static void migrateColorResources(XrmDatabase prefDB, XrmDatabase appDB)
 */
 static void spliceString(char **intoString, const char *insertString, const char *atExpr)
 {
-    int beginPos, endPos;
+    ssize_t beginPos, endPos;
     int intoLen = strlen(*intoString);
     int insertLen = strlen(insertString);
     char *newString = (char*)NEditMalloc(intoLen + insertLen + 2);
@@ -6174,7 +6175,7 @@ static void spliceString(char **intoString, const char *insertString, const char
 */
 static int regexFind(const char *inString, const char *expr)
 {
-    int beginPos, endPos;
+    ssize_t beginPos, endPos;
     return SearchString(inString, expr, SEARCH_FORWARD, SEARCH_REGEX, False,
 	    0, &beginPos, &endPos, NULL, NULL, NULL);
 }
@@ -6185,7 +6186,7 @@ static int regexFind(const char *inString, const char *expr)
 */
 static int caseFind(const char *inString, const char *expr)
 {
-    int beginPos, endPos;
+    ssize_t beginPos, endPos;
     return SearchString(inString, expr, SEARCH_FORWARD, SEARCH_CASE_SENSE,
             False, 0, &beginPos, &endPos, NULL, NULL, NULL);
 }
@@ -6197,7 +6198,8 @@ static int stringReplace(char **inString, const char *expr,
                          const char *replaceWith, int searchType,
 			 int replaceLen)
 {
-    int beginPos, endPos, newLen;
+    ssize_t beginPos, endPos;
+    int newLen;
     char *newString;
     int inLen = strlen(*inString);
     if (0 >= replaceLen) replaceLen = strlen(replaceWith);
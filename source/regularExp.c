@@ -88,6 +88,7 @@
 
 #include <ctype.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -409,9 +410,9 @@
 
 /* Utility definitions. */
 
-#define REG_FAIL(m)      {*Error_Ptr = (m); return (NULL);}
+#define REG_FAIL(m)      {*cs->error_ptr = (m); return (NULL);}
 #define IS_QUANTIFIER(c) ((c) == '*' || (c) == '+' || \
-                          (c) == '?' || (c) == Brace_Char)
+                          (c) == '?' || (c) == cs->brace_char)
 #define SET_BIT(i,n)     ((i) |= (1 << ((n) - 1)))
 #define TEST_BIT(i,n)    ((i) &  (1 << ((n) - 1)))
 #define U_CHAR_AT(p)     ((unsigned int) *(unsigned char *)(p))
@@ -457,28 +458,46 @@
 #define MAX_COMPILED_SIZE  32767UL  /* Largest size a compiled regex can be.
                                        Probably could be 65535UL. */
 
-/* Global work variables for `CompileRE'. */
+/* The states of the automaton `nfa_search' uses to match a program without
+   back tracking are numbered in a table after the program, two bytes for
+   each of its nodes (see `build_nfa'). */
+
+#define NFA_MAX_STATES     10000
+#define NFA_NO_STATE       0xFFFF
+#define NFA_STATE(t,off)   ((((t) [2 * (off)]) << 8) + (t) [2 * (off) + 1])
+
+/* Work variables for `CompileRE'.  These are kept in a structure passed down
+   to the routines doing the compiling, rather than in globals, so that
+   different threads can compile regular expressions at the same time (see
+   `CompileREContext'). */
+
+typedef struct {
+   unsigned char *reg_parse;       /* Input scan ptr (scans user's regex) */
+   int            total_paren;     /* Parentheses, (),  counter. */
+   int            num_braces;      /* Number of general {m,n} constructs.
+                                      {m,n} quantifiers of SIMPLE atoms are
+                                      not included in this count. */
+   int            closed_parens;   /* Bit flags indicating () closure. */
+   int            paren_has_width; /* Bit flags indicating ()'s that are
+                                      known to not match the empty string */
+   unsigned char *code_emit_ptr;   /* When code_emit_ptr is set to
+                                      &Compute_Size no code is emitted.
+                                      Instead, the size of code that WOULD
+                                      have been generated is accumulated in
+                                      reg_size.  Otherwise, code_emit_ptr
+                                      points to where compiled regex code is
+                                      to be written. */
+   unsigned long  reg_size;        /* Size of compiled regex code. */
+   char         **error_ptr;       /* Place to store error messages so
+                                      they can be returned by `CompileRE' */
+   char           error_text [128];/* Sting to build error messages in. */
+   int            is_case_insensitive;
+   int            match_newline;
+   unsigned char  brace_char;
+   unsigned char *meta_char;
+} compile_state;
 
-static unsigned char *Reg_Parse;       /* Input scan ptr (scans user's regex) */
-static int            Total_Paren;     /* Parentheses, (),  counter. */
-static int            Num_Braces;      /* Number of general {m,n} constructs.
-                                          {m,n} quantifiers of SIMPLE atoms are
-                                          not included in this count. */
-static int            Closed_Parens;   /* Bit flags indicating () closure. */
-static int            Paren_Has_Width; /* Bit flags indicating ()'s that are
-                                          known to not match the empty string */
 static unsigned char  Compute_Size;    /* Address of this used as flag. */
-static unsigned char *Code_Emit_Ptr;   /* When Code_Emit_Ptr is set to
-                                          &Compute_Size no code is emitted.
-                                          Instead, the size of code that WOULD
-                                          have been generated is accumulated in
-                                          Reg_Size.  Otherwise, Code_Emit_Ptr
-                                          points to where compiled regex code is
-                                          to be written. */
-static unsigned long  Reg_Size;        /* Size of compiled regex code. */
-static char         **Error_Ptr;       /* Place to store error messages so
-                                          they can be returned by `CompileRE' */
-static char           Error_Text [128];/* Sting to build error messages in. */
 
 static unsigned char  White_Space [WHITE_SPACE_SIZE]; /* Arrays used by       */
 static unsigned char  Word_Char   [ALNUM_CHAR_SIZE];  /* functions            */
@@ -488,46 +507,64 @@ static unsigned char  Letter_Char [ALNUM_CHAR_SIZE];  /* init_ansi_classes () */
 
 static unsigned char  ASCII_Digits [] = "0123456789"; /* Same for all */
                                                       /* locales.     */
-static int            Is_Case_Insensitive;
-static int            Match_Newline;
 
 static int            Enable_Counting_Quantifier = 1;
-static unsigned char  Brace_Char;
 static unsigned char  Default_Meta_Char [] = "{.*+?[(|)^<>$";
-static unsigned char *Meta_Char;
 
 typedef struct { long lower; long upper; } len_range;
 
 /* Forward declarations for functions used by `CompileRE'. */
 
-static unsigned char * alternative     (int *flag_param, len_range *range_param);
-static unsigned char * back_ref        (unsigned char *c, int *flag_param,
-                                        int emit);
-static unsigned char * chunk           (int paren, int *flag_param, len_range *range_param);
-static void            emit_byte       (unsigned char c);
-static void            emit_class_byte (unsigned char c);
-static unsigned char * emit_node       (int op_code);
-static unsigned char * emit_special    (unsigned char op_code,
+static unsigned char * alternative     (compile_state *cs, int *flag_param,
+                                        len_range *range_param);
+static unsigned char * back_ref        (compile_state *cs, unsigned char *c,
+                                        int *flag_param, int emit);
+static unsigned char * chunk           (compile_state *cs, int paren,
+                                        int *flag_param,
+                                        len_range *range_param);
+static void            emit_byte       (compile_state *cs, unsigned char c);
+static void            emit_class_byte (compile_state *cs, unsigned char c);
+static unsigned char * emit_node       (compile_state *cs, int op_code);
+static unsigned char * emit_special    (compile_state *cs,
+                                        unsigned char op_code,
                                         unsigned long test_val,
                                         int index);
 static unsigned char   literal_escape  (unsigned char c);
-static unsigned char   numeric_escape  (unsigned char c, unsigned char **parse);
-static unsigned char * atom            (int *flag_param, len_range *range_param);
+static unsigned char   numeric_escape  (char *error_text, unsigned char c,
+                                        unsigned char **parse);
+static unsigned char * atom            (compile_state *cs, int *flag_param,
+                                        len_range *range_param);
 static void            reg_error       (char *str);
-static unsigned char * insert          (unsigned char op, unsigned char *opnd,
-                                        long min, long max, int index);
+static unsigned char * insert          (compile_state *cs, unsigned char op,
+                                        unsigned char *opnd, long min,
+                                        long max, int index);
 static unsigned char * next_ptr        (unsigned char *ptr);
 static void            offset_tail     (unsigned char *ptr, int offset,
                                         unsigned char *val);
 static void            branch_tail     (unsigned char *ptr, int offset,
                                         unsigned char *val);
-static unsigned char * piece           (int *flag_param, len_range *range_param);
+static unsigned char * piece           (compile_state *cs, int *flag_param,
+                                        len_range *range_param);
 static void            tail            (unsigned char *search_from,
                                         unsigned char *point_t);
-static unsigned char * shortcut_escape (unsigned char c, int *flag_param,
-                                        int emit);
+static unsigned char * shortcut_escape (compile_state *cs, unsigned char c,
+                                        int *flag_param, int emit);
+static regexp *        compile_regex   (compile_state *cs, const char *exp,
+                                        char **errorText, int defaultFlags);
+static void            find_literal    (regexp *prog);
+static int             simple_width    (unsigned char *node,
+                                        unsigned long *lo, unsigned long *hi);
+static void            find_first_chars(regexp *prog);
+static int             first_chars     (unsigned char *node,
+                                        unsigned char *member, int *budget);
+static int             first_char      (unsigned char *node,
+                                        unsigned char *member);
+static regexp *        build_nfa       (regexp *prog,
+                                        unsigned long reg_size);
+static int             nfa_substates   (unsigned char *node);
 
 static int             init_ansi_classes  (void);
+static void            make_ansi_classes  (void);
 
 /*----------------------------------------------------------------------*
  * CompileRE
@@ -546,23 +583,38 @@ static int             init_ansi_classes  (void);
 
 regexp * CompileRE (const char *exp, char **errorText, int defaultFlags) {
 
+   static compile_state state; /* Holds error messages after returning. */
+
+   return (compile_regex (&state, exp, errorText, defaultFlags));
+}
+
+/*----------------------------------------------------------------------*
+ * compile_regex
+ *
+ * Does the work of `CompileRE' and `CompileREContext', using `cs' for
+ * its work variables.
+ *----------------------------------------------------------------------*/
+
+static regexp * compile_regex (compile_state *cs, const char *exp,
+                               char **errorText, int defaultFlags) {
+
    register                regexp *comp_regex = NULL;
    register unsigned char *scan;
                      int   flags_local, pass;
 	 	     len_range range_local;
 
    if (Enable_Counting_Quantifier) {
-      Brace_Char  = '{';
-      Meta_Char   = &Default_Meta_Char [0];
+      cs->brace_char  = '{';
+      cs->meta_char   = &Default_Meta_Char [0];
    } else {
-      Brace_Char  = '*';                    /* Bypass the '{' in */
-      Meta_Char   = &Default_Meta_Char [1]; /* Default_Meta_Char */
+      cs->brace_char  = '*';                /* Bypass the '{' in */
+      cs->meta_char   = &Default_Meta_Char [1]; /* Default_Meta_Char */
    }
 
    /* Set up errorText to receive failure reports. */
 
-    Error_Ptr = errorText;
-   *Error_Ptr = "";
+    cs->error_ptr = errorText;
+   *cs->error_ptr = "";
 
    if (exp == NULL) REG_FAIL ("NULL argument, `CompileRE\'");
 
@@ -570,8 +622,8 @@ regexp * CompileRE (const char *exp, char **errorText, int defaultFlags) {
 
    if (!init_ansi_classes ()) REG_FAIL ("internal error #1, `CompileRE\'");
 
-   Code_Emit_Ptr = &Compute_Size;
-   Reg_Size      = 0UL;
+   cs->code_emit_ptr = &Compute_Size;
+   cs->reg_size      = 0UL;
 
    /* We can't allocate space until we know how big the compiled form will be,
       but we can't compile it (and thus know how big it is) until we've got a
@@ -590,48 +642,51 @@ regexp * CompileRE (const char *exp, char **errorText, int defaultFlags) {
 
       /*  Schwarzenberg:
        *  If defaultFlags = 0 use standard defaults:
-       *    Is_Case_Insensitive: Case sensitive is the default
-       *    Match_Newline:       Newlines are NOT matched by default 
+       *    cs->is_case_insensitive: Case sensitive is the default
+       *    cs->match_newline:       Newlines are NOT matched by default 
        *                         in character classes  
        */
-      Is_Case_Insensitive = ((defaultFlags & REDFLT_CASE_INSENSITIVE) ? 1 : 0);
-      Match_Newline = 0;  /* ((defaultFlags & REDFLT_MATCH_NEWLINE)   ? 1 : 0); 
+      cs->is_case_insensitive = ((defaultFlags & REDFLT_CASE_INSENSITIVE) ? 1 : 0);
+      cs->match_newline = 0;  /* ((defaultFlags & REDFLT_MATCH_NEWLINE)   ? 1 : 0); 
                              Currently not used. Uncomment if needed. */
 
-      Reg_Parse       = (unsigned char *) exp;
-      Total_Paren     = 1;
-      Num_Braces      = 0;
-      Closed_Parens   = 0;
-      Paren_Has_Width = 0;
+      cs->reg_parse       = (unsigned char *) exp;
+      cs->total_paren     = 1;
+      cs->num_braces      = 0;
+      cs->closed_parens   = 0;
+      cs->paren_has_width = 0;
 
-      emit_byte (MAGIC);
-      emit_byte ('%');  /* Placeholder for num of capturing parentheses.    */
-      emit_byte ('%');  /* Placeholder for num of general {m,n} constructs. */
+      emit_byte (cs, MAGIC);
+      emit_byte (cs, '%'); /* Placeholder for num of capturing parentheses.    */
+      emit_byte (cs, '%'); /* Placeholder for num of general {m,n} constructs. */
 
-      if (chunk (NO_PAREN, &flags_local, &range_local) == NULL) 
+      if (chunk (cs, NO_PAREN, &flags_local, &range_local) == NULL) 
 	  return (NULL); /* Something went wrong */
       if (pass == 1) {
-         if (Reg_Size >= MAX_COMPILED_SIZE) {
+         if (cs->reg_size >= MAX_COMPILED_SIZE) {
             /* Too big for NEXT pointers NEXT_PTR_SIZE bytes long to span.
                This is a real issue since the first BRANCH node usually points
                to the end of the compiled regex code. */
 
-            sprintf  (Error_Text, "regexp > %lu bytes", MAX_COMPILED_SIZE);
-            REG_FAIL (Error_Text);
+            sprintf  (cs->error_text, "regexp > %lu bytes", MAX_COMPILED_SIZE);
+            REG_FAIL (cs->error_text);
          }
 
-         /* Allocate memory. */
+         /* Allocate memory.  Room for the table numbering the states of
+            the nodes is added by `build_nfa', if the program has them. */
 
-         comp_regex = (regexp *) malloc (sizeof (regexp) + Reg_Size);
+         comp_regex = (regexp *) malloc (sizeof (regexp) + cs->reg_size);
 
          if (comp_regex == NULL) REG_FAIL ("out of memory in `CompileRE\'");
 
-         Code_Emit_Ptr = (unsigned char *) comp_regex->program;
+         comp_regex->size = (long) (sizeof (regexp) + cs->reg_size);
+
+         cs->code_emit_ptr = (unsigned char *) comp_regex->program;
       }
    }
 
-   comp_regex->program [1] = (unsigned char) Total_Paren - 1;
-   comp_regex->program [2] = (unsigned char) Num_Braces;
+   comp_regex->program [1] = (unsigned char) cs->total_paren - 1;
+   comp_regex->program [2] = (unsigned char) cs->num_braces;
 
    /*----------------------------------------*
     * Dig out information for optimizations. *
@@ -666,7 +721,460 @@ regexp * CompileRE (const char *exp, char **errorText, int defaultFlags) {
       }
    }
 
-   return (comp_regex);
+   find_literal (comp_regex);
+   find_first_chars (comp_regex);
+
+   return (build_nfa (comp_regex, cs->reg_size));
+}
+
+/*----------------------------------------------------------------------*
+ * find_literal
+ *
+ * Find the longest literal string which every match must contain, and
+ * its least and greatest distance from the start of the match, so that
+ * `ExecRE' only needs to try matching a little before each place it is
+ * found (see `prefiltered_search').  Only the nodes which every match
+ * passes through once are looked at, stopping at the first one whose
+ * width can't be worked out simply (loops, look-around, back references).
+ *----------------------------------------------------------------------*/
+
+static void find_literal (regexp *prog) {
+
+   unsigned char *scan, *next, *operand;
+   unsigned long  min = 0, max = 0, lo, hi, reps_lo, reps_hi;
+   int            unbounded = 0;
+   size_t         len;
+
+   prog->literal     = 0;
+   prog->literal_len = 0;
+
+   scan = (unsigned char *) (prog->program + REGEX_START_OFFSET);
+
+   while (scan != NULL) {
+      switch (GET_OP_CODE (scan)) {
+         case EXACTLY:
+            len = strlen ((char *) OPERAND (scan));
+
+            if (len > (size_t) prog->literal_len) {
+               prog->literal     = OPERAND (scan) - (unsigned char *) prog->program;
+               prog->literal_len = len;
+               prog->literal_min = min;
+               prog->literal_max = unbounded ? -1 : (long) max;
+            }
+
+            min += len;
+            max += len;
+            break;
+
+         case BRANCH:
+            /* A single alternative is just part of the sequence.  Of
+               several, (or a loop, which is built from branches), only
+               the width is uncertain. */
+
+            next = next_ptr (scan);
+
+            if (next == NULL || GET_OP_CODE (next) != BRANCH) {
+               scan = OPERAND (scan);
+               continue;
+            }
+
+            while (next != NULL && GET_OP_CODE (next) == BRANCH) {
+               next = next_ptr (next);
+            }
+
+            unbounded = 1;
+            scan      = next;
+            continue;
+
+         case STAR:     case LAZY_STAR:
+         case QUESTION: case LAZY_QUESTION:
+         case PLUS:     case LAZY_PLUS:
+         case BRACE:    case LAZY_BRACE:
+            if (GET_OP_CODE (scan) == BRACE || GET_OP_CODE (scan) == LAZY_BRACE) {
+               reps_lo = GET_OFFSET (scan + NEXT_PTR_SIZE);
+               reps_hi = GET_OFFSET (scan + (2 * NEXT_PTR_SIZE));
+               operand = OPERAND (scan + (2 * NEXT_PTR_SIZE));
+            } else {
+               reps_lo = (GET_OP_CODE (scan) >= PLUS) ? 1 : 0;
+               reps_hi = (GET_OP_CODE (scan) >= QUESTION &&
+                          GET_OP_CODE (scan) <= LAZY_QUESTION) ? 1 : REG_INFINITY;
+               operand = OPERAND (scan);
+            }
+
+            if (!simple_width (operand, &lo, &hi)) return;
+
+            min += reps_lo * lo;
+
+            if (reps_hi == REG_INFINITY) {
+               unbounded = 1;
+            } else {
+               max += reps_hi * hi;
+            }
+            break;
+
+         case BOL: case EOL: case BOWORD: case EOWORD: case NOT_BOUNDARY:
+         case NOTHING:
+            break;
+
+         default:
+            if (GET_OP_CODE (scan) >= OPEN && GET_OP_CODE (scan) < LAST_PAREN) {
+               break;
+            } else if (simple_width (scan, &lo, &hi)) {
+               min += lo;
+               max += hi;
+               break;
+            }
+
+            return; /* END, or a node this can't see past. */
+      }
+
+      scan = next_ptr (scan);
+   }
+}
+
+/*----------------------------------------------------------------------*
+ * simple_width
+ *
+ * Find the least and greatest number of bytes matched by a node which
+ * matches a single character.  Returns 0 for any other kind of node.
+ *----------------------------------------------------------------------*/
+
+static int simple_width (unsigned char *node, unsigned long *lo,
+                         unsigned long *hi) {
+
+   switch (GET_OP_CODE (node)) {
+      case ANY: case EVERY: /* One UTF-8 character. */
+         *lo = 1; *hi = 4;
+         return (1);
+
+      case EXACTLY: case SIMILAR:
+         *lo = *hi = strlen ((char *) OPERAND (node));
+         return (1);
+
+      case ANY_OF:    case ANY_BUT:
+      case DIGIT:     case NOT_DIGIT:
+      case LETTER:    case NOT_LETTER:
+      case SPACE:     case SPACE_NL:
+      case NOT_SPACE: case NOT_SPACE_NL:
+      case WORD_CHAR: case NOT_WORD_CHAR:
+      case IS_DELIM:  case NOT_DELIM:
+         *lo = *hi = 1;
+         return (1);
+
+      default:
+         return (0);
+   }
+}
+
+/*----------------------------------------------------------------------*
+ * find_first_chars
+ *
+ * Find the set of characters which a match can start with, if it is
+ * known, so that `ExecRE' can skip over the others (see
+ * `prefiltered_search').  Sets use_first_chars if it can be found, which
+ * also means that the regex can't match an empty string.
+ *----------------------------------------------------------------------*/
+
+static void find_first_chars (regexp *prog) {
+
+   unsigned char member [UCHAR_MAX + 1];
+   char          chars  [UCHAR_MAX + 1];
+   int           i, n = 0, budget = 1000;
+
+   memset (member, 0, sizeof (member));
+
+   prog->use_first_chars = first_chars (
+      (unsigned char *) (prog->program + REGEX_START_OFFSET), member, &budget);
+
+   if (!prog->use_first_chars) return;
+
+   for (i = 1; i <= UCHAR_MAX; i++) {
+      if (member [i]) chars [n++] = (char) i;
+   }
+
+   chars [n] = '\0';
+
+   ScanInitCharSet (&prog->first_chars, chars);
+}
+
+/*----------------------------------------------------------------------*
+ * first_chars
+ *
+ * Add the characters which can start a match of the program from `node'
+ * to `member'.  Returns 0 if it could match an empty string, or if the
+ * set can't be worked out (or if `budget' nodes have been looked at).
+ *----------------------------------------------------------------------*/
+
+static int first_chars (unsigned char *node, unsigned char *member,
+                        int *budget) {
+
+   unsigned char *operand;
+   unsigned long  reps_lo;
+
+   while (node != NULL && (*budget)-- > 0) {
+      switch (GET_OP_CODE (node)) {
+         case BRANCH:
+            for (; node != NULL && GET_OP_CODE (node) == BRANCH;
+                   node = next_ptr (node)) {
+
+               if (!first_chars (OPERAND (node), member, budget)) return (0);
+            }
+
+            return (1);
+
+         case STAR:     case LAZY_STAR:
+         case QUESTION: case LAZY_QUESTION:
+         case PLUS:     case LAZY_PLUS:
+         case BRACE:    case LAZY_BRACE:
+            if (GET_OP_CODE (node) == BRACE || GET_OP_CODE (node) == LAZY_BRACE) {
+               reps_lo = GET_OFFSET (node + NEXT_PTR_SIZE);
+               operand = OPERAND (node + (2 * NEXT_PTR_SIZE));
+            } else {
+               reps_lo = (GET_OP_CODE (node) >= PLUS) ? 1 : 0;
+               operand = OPERAND (node);
+            }
+
+            if (!first_char (operand, member)) return (0);
+
+            if (reps_lo > 0) return (1);
+            break;
+
+         case BOL: case EOL: case BOWORD: case EOWORD: case NOT_BOUNDARY:
+         case NOTHING:
+            break;
+
+         default:
+            if (GET_OP_CODE (node) >= OPEN && GET_OP_CODE (node) < LAST_PAREN) {
+               break;
+            }
+
+            return (first_char (node, member));
+      }
+
+      node = next_ptr (node);
+   }
+
+   return (0);
+}
+
+/*----------------------------------------------------------------------*
+ * first_char
+ *
+ * Add the characters which can start a match of a node matching
+ * characters to `member', in the same way `match' tests them.  Returns 0
+ * for other kinds of node, and for ones matching most characters.
+ *----------------------------------------------------------------------*/
+
+static int first_char (unsigned char *node, unsigned char *member) {
+
+   unsigned char *c;
+   int            i;
+
+   switch (GET_OP_CODE (node)) {
+      case EXACTLY:
+         member [*OPERAND (node)] = 1;
+         return (1);
+
+      case SIMILAR:
+         for (i = 1; i <= UCHAR_MAX; i++) {
+            if (tolower (i) == *OPERAND (node)) member [i] = 1;
+         }
+         return (1);
+
+      case ANY_OF:
+         for (c = OPERAND (node); *c != '\0'; c++) member [*c] = 1;
+         return (1);
+
+      case DIGIT: case LETTER: case SPACE: case SPACE_NL: case WORD_CHAR:
+         for (i = 1; i <= UCHAR_MAX; i++) {
+            switch (GET_OP_CODE (node)) {
+               case DIGIT:     member [i] |= isdigit (i) != 0;  break;
+               case LETTER:    member [i] |= isalpha (i) != 0;  break;
+               case SPACE:     member [i] |= isspace (i) && i != '\n'; break;
+               case SPACE_NL:  member [i] |= isspace (i) != 0;  break;
+               case WORD_CHAR: member [i] |= isalnum (i) || i == '_'; break;
+            }
+         }
+         return (1);
+
+      default:
+         return (0);
+   }
+}
+
+/*----------------------------------------------------------------------*
+ * build_nfa
+ *
+ * Number the states of the automaton `nfa_search' simulates to match
+ * the program without back tracking, if it can.  Every node reachable
+ * from the start is a state, as is each further byte of a string
+ * matched by EXACTLY or SIMILAR, each further byte of a UTF-8 character
+ * matched by ANY or EVERY, and each count of a simple loop that makes a
+ * difference to what it can match next.  Back references, look-around
+ * and general {m,n} counters need the back tracking matcher, as do
+ * programs with more than NFA_MAX_STATES states.
+ *
+ * Also finds the BRANCH whose choice `match' reports in top_branch: the
+ * first one with a choice that the top level of `match' comes to
+ * without recursing.
+ *
+ * The table is only added to the program (which may move it) if the
+ * automaton can match it.  Returns the program.
+ *----------------------------------------------------------------------*/
+
+static regexp * build_nfa (regexp *prog, unsigned long reg_size) {
+
+   unsigned char  *program = (unsigned char *) prog->program;
+   unsigned char  *table;
+   unsigned char **stack;
+   unsigned char  *node, *next;
+   regexp         *grown;
+   unsigned long   i;
+   long            states = 0;
+   int             depth  = 0, n;
+
+   prog->nfa_states     = 0;
+   prog->nfa_table      = (int) reg_size;
+   prog->nfa_top_branch = 0;
+
+   /* Each node pushes at most two more, and is only numbered once. */
+
+   table = (unsigned char *) malloc (2 * reg_size);
+   stack = (unsigned char **) malloc (sizeof (unsigned char *) * (reg_size + 2));
+
+   if (table == NULL || stack == NULL) {
+      free (table);
+      free (stack);
+      return (prog);
+   }
+
+   memset (table, 0xFF, 2 * reg_size); /* i.e. NFA_NO_STATE */
+
+   stack [depth++] = program + REGEX_START_OFFSET;
+
+   while (depth > 0) {
+      node = stack [--depth];
+
+      if (NFA_STATE (table, node - program) != NFA_NO_STATE) continue;
+
+      n = nfa_substates (node);
+
+      if (n == 0 || states + n > NFA_MAX_STATES) {
+         free (table);
+         free (stack);
+         return (prog);
+      }
+
+      table [2 * (node - program)]     = (unsigned char) (states >> 8);
+      table [2 * (node - program) + 1] = (unsigned char) (states & 0377);
+      states += n;
+
+      if (GET_OP_CODE (node) == END) continue;
+
+      if ((next = next_ptr (node)) != NULL) stack [depth++] = next;
+
+      if (GET_OP_CODE (node) == BRANCH) stack [depth++] = OPERAND (node);
+   }
+
+   free (stack);
+
+   grown = (regexp *) realloc (prog, (size_t) prog->size + 2 * reg_size);
+
+   if (grown == NULL) {
+      free (table);
+      return (prog);
+   }
+
+   prog    = grown;
+   program = (unsigned char *) prog->program;
+   memcpy (program + reg_size, table, 2 * reg_size);
+   free (table);
+
+   prog->size      += (long) (2 * reg_size);
+   prog->nfa_states = (int) states;
+
+   for (node = program + REGEX_START_OFFSET, i = 0;
+        node != NULL && i < reg_size; i++) {
+
+      if (GET_OP_CODE (node) == BRANCH) {
+         next = next_ptr (node);
+
+         if (next != NULL && GET_OP_CODE (next) == BRANCH) {
+            prog->nfa_top_branch = (int) (node - program);
+            break;
+         }
+
+         node = OPERAND (node);
+      } else if (GET_OP_CODE (node) == END || GET_OP_CODE (node) >= OPEN ||
+                 (STAR <= GET_OP_CODE (node) &&
+                          GET_OP_CODE (node) <= LAZY_BRACE)) {
+         break; /* `match' recurses for these. */
+      } else {
+         node = next_ptr (node);
+      }
+   }
+
+   return (prog);
+}
+
+/*----------------------------------------------------------------------*
+ * nfa_substates
+ *
+ * The number of states `build_nfa' needs for a node, or 0 if the node
+ * needs back tracking.
+ *----------------------------------------------------------------------*/
+
+static int nfa_substates (unsigned char *node) {
+
+   unsigned long min, max;
+
+   switch (GET_OP_CODE (node)) {
+      case EXACTLY: case SIMILAR:
+         return ((int) strlen ((char *) OPERAND (node)));
+
+      case ANY: case EVERY: /* Up to three more bytes of a character. */
+         return (4);
+
+      case STAR:     case LAZY_STAR:
+         return (1);
+
+      case QUESTION: case LAZY_QUESTION:
+      case PLUS:     case LAZY_PLUS:
+         return (2);
+
+      case BRACE:    case LAZY_BRACE:
+         /* Counts beyond the minimum are all alike when there is no
+            maximum. */
+
+         min = (unsigned long) GET_OFFSET (node + NEXT_PTR_SIZE);
+         max = (unsigned long) GET_OFFSET (node + (2 * NEXT_PTR_SIZE));
+
+         if (max == REG_INFINITY) max = min;
+
+         return (max < NFA_MAX_STATES ? (int) max + 1 : 0);
+
+      case ANY_OF:    case ANY_BUT:
+      case DIGIT:     case NOT_DIGIT:
+      case LETTER:    case NOT_LETTER:
+      case SPACE:     case SPACE_NL:
+      case NOT_SPACE: case NOT_SPACE_NL:
+      case WORD_CHAR: case NOT_WORD_CHAR:
+      case IS_DELIM:  case NOT_DELIM:
+      case BOL: case EOL: case BOWORD: case EOWORD: case NOT_BOUNDARY:
+      case NOTHING:   case BRANCH:   case BACK:   case END:
+         return (1);
+
+      default:
+         if ((GET_OP_CODE (node) > OPEN  &&
+              GET_OP_CODE (node) < OPEN + NSUBEXP) ||
+             (GET_OP_CODE (node) > CLOSE &&
+              GET_OP_CODE (node) < CLOSE + NSUBEXP)) {
+
+            return (1);
+         }
+
+         return (0); /* Back references, look-around and counters. */
+   }
 }
 
 /*----------------------------------------------------------------------*
@@ -681,7 +1189,7 @@ regexp * CompileRE (const char *exp, char **errorText, int defaultFlags) {
  * branches to what follows makes it hard to avoid.                     *
  *----------------------------------------------------------------------*/
 
-static unsigned char * chunk (int paren, int *flag_param, 
+static unsigned char * chunk (compile_state *cs, int paren, int *flag_param,
                               len_range *range_param) {
 
    register unsigned char *ret_val = NULL;
@@ -689,8 +1197,8 @@ static unsigned char * chunk (int paren, int *flag_param,
    register unsigned char *ender = NULL;
    register          int   this_paren = 0;
                      int   flags_local, first = 1, zero_width, i;
-                     int   old_sensitive = Is_Case_Insensitive;
-                     int   old_newline   = Match_Newline;
+                     int   old_sensitive = cs->is_case_insensitive;
+                     int   old_newline   = cs->match_newline;
 		     len_range range_local;
 		     int   look_only = 0;
             unsigned char *emit_look_behind_bounds = NULL;
@@ -703,37 +1211,37 @@ static unsigned char * chunk (int paren, int *flag_param,
    /* Make an OPEN node, if parenthesized. */
 
    if (paren == PAREN) {
-      if (Total_Paren >= NSUBEXP) {
-         sprintf (Error_Text, "number of ()'s > %d", (int) NSUBEXP);
-         REG_FAIL (Error_Text);
+      if (cs->total_paren >= NSUBEXP) {
+         sprintf (cs->error_text, "number of ()'s > %d", (int) NSUBEXP);
+         REG_FAIL (cs->error_text);
       }
 
-      this_paren = Total_Paren; Total_Paren++;
-      ret_val    = emit_node (OPEN + this_paren);
+      this_paren = cs->total_paren; cs->total_paren++;
+      ret_val    = emit_node (cs, OPEN + this_paren);
    } else if (paren == POS_AHEAD_OPEN || paren == NEG_AHEAD_OPEN) {
       *flag_param = WORST;  /* Look ahead is zero width. */
       look_only   = 1;
-      ret_val     = emit_node (paren);
+      ret_val     = emit_node (cs, paren);
    } else if (paren == POS_BEHIND_OPEN || paren == NEG_BEHIND_OPEN) {
       *flag_param = WORST;  /* Look behind is zero width. */
       look_only   = 1;
       /* We'll overwrite the zero length later on, so we save the ptr */
-      ret_val 	  = emit_special (paren, 0, 0);
+      ret_val 	  = emit_special (cs, paren, 0, 0);
       emit_look_behind_bounds = ret_val + NODE_SIZE;
    } else if (paren == INSENSITIVE) {
-      Is_Case_Insensitive = 1;
+      cs->is_case_insensitive = 1;
    } else if (paren == SENSITIVE) {
-      Is_Case_Insensitive = 0;
+      cs->is_case_insensitive = 0;
    } else if (paren == NEWLINE) {
-      Match_Newline = 1;
+      cs->match_newline = 1;
    } else if (paren == NO_NEWLINE) {
-      Match_Newline = 0;
+      cs->match_newline = 0;
    }
 
    /* Pick up the branches, linking them together. */
 
    do {
-      this_branch = alternative (&flags_local, &range_local);
+      this_branch = alternative (cs, &flags_local, &range_local);
 
       if (this_branch == NULL) return (NULL);
 
@@ -762,27 +1270,27 @@ static unsigned char * chunk (int paren, int *flag_param,
 
       /* Are there more alternatives to process? */
 
-      if (*Reg_Parse != '|') break;
+      if (*cs->reg_parse != '|') break;
 
-      Reg_Parse++;
+      cs->reg_parse++;
    } while (1);
 
    /* Make a closing node, and hook it on the end. */
 
    if (paren == PAREN) {
-      ender = emit_node (CLOSE + this_paren);
+      ender = emit_node (cs, CLOSE + this_paren);
 
    } else if (paren == NO_PAREN) {
-      ender = emit_node (END);
+      ender = emit_node (cs, END);
 
    } else if (paren == POS_AHEAD_OPEN || paren == NEG_AHEAD_OPEN) {
-      ender = emit_node (LOOK_AHEAD_CLOSE);
+      ender = emit_node (cs, LOOK_AHEAD_CLOSE);
 
    } else if (paren == POS_BEHIND_OPEN || paren == NEG_BEHIND_OPEN) {
-      ender = emit_node (LOOK_BEHIND_CLOSE);
+      ender = emit_node (cs, LOOK_BEHIND_CLOSE);
 
    } else {
-      ender = emit_node (NOTHING);
+      ender = emit_node (cs, NOTHING);
    }
 
    tail (ret_val, ender);
@@ -796,10 +1304,10 @@ static unsigned char * chunk (int paren, int *flag_param,
 
    /* Check for proper termination. */
 
-   if (paren != NO_PAREN && *Reg_Parse++ != ')') {
+   if (paren != NO_PAREN && *cs->reg_parse++ != ')') {
       REG_FAIL ("missing right parenthesis \')\'");
-   } else if (paren == NO_PAREN && *Reg_Parse != '\0') {
-      if (*Reg_Parse == ')') {
+   } else if (paren == NO_PAREN && *cs->reg_parse != '\0') {
+      if (*cs->reg_parse == ')') {
          REG_FAIL ("missing left parenthesis \'(\'");
       } else {
          REG_FAIL ("junk on end");  /* "Can't happen" - NOTREACHED */
@@ -815,7 +1323,7 @@ static unsigned char * chunk (int paren, int *flag_param,
        if (range_param->upper > 65535L) {
 	   REG_FAIL ("max. look-behind size is too large (>65535)")
        } 
-       if (Code_Emit_Ptr != &Compute_Size) {
+       if (cs->code_emit_ptr != &Compute_Size) {
           *emit_look_behind_bounds++ = PUT_OFFSET_L (range_param->lower);
           *emit_look_behind_bounds++ = PUT_OFFSET_R (range_param->lower);
           *emit_look_behind_bounds++ = PUT_OFFSET_L (range_param->upper);
@@ -831,32 +1339,32 @@ static unsigned char * chunk (int paren, int *flag_param,
 
    zero_width = 0;
 
-   /* Set a bit in Closed_Parens to let future calls to function `back_ref'
+   /* Set a bit in cs->closed_parens to let future calls to function `back_ref'
       know that we have closed this set of parentheses. */
 
-   if (paren == PAREN && this_paren <= (int)sizeof (Closed_Parens) * CHAR_BIT) {
-      SET_BIT (Closed_Parens, this_paren);
+   if (paren == PAREN && this_paren <= (int)sizeof (cs->closed_parens) * CHAR_BIT) {
+      SET_BIT (cs->closed_parens, this_paren);
 
       /* Determine if a parenthesized expression is modified by a quantifier
          that can have zero width. */
 
-      if (*(Reg_Parse) == '?' || *(Reg_Parse) == '*') {
+      if (*(cs->reg_parse) == '?' || *(cs->reg_parse) == '*') {
          zero_width++;
-      } else if (*(Reg_Parse) == '{' && Brace_Char == '{') {
-         if (*(Reg_Parse + 1) == ',' || *(Reg_Parse + 1) == '}') {
+      } else if (*(cs->reg_parse) == '{' && cs->brace_char == '{') {
+         if (*(cs->reg_parse + 1) == ',' || *(cs->reg_parse + 1) == '}') {
             zero_width++;
-         } else if (*(Reg_Parse + 1) == '0') {
+         } else if (*(cs->reg_parse + 1) == '0') {
             i = 2;
 
-            while (*(Reg_Parse + i) == '0') i++;
+            while (*(cs->reg_parse + i) == '0') i++;
 
-            if (*(Reg_Parse + i) == ',') zero_width++;
+            if (*(cs->reg_parse + i) == ',') zero_width++;
          }
       }
    }
 
    /* If this set of parentheses is known to never match the empty string, set
-      a bit in Paren_Has_Width to let future calls to function back_ref know
+      a bit in cs->paren_has_width to let future calls to function back_ref know
       that this set of parentheses has non-zero width.  This will allow star
       (*) or question (?) quantifiers to be aplied to a back-reference that
       refers to this set of parentheses. */
@@ -864,13 +1372,13 @@ static unsigned char * chunk (int paren, int *flag_param,
    if ((*flag_param & HAS_WIDTH)  &&
         paren == PAREN            &&
         !zero_width               &&
-        this_paren <= (int)(sizeof (Paren_Has_Width) * CHAR_BIT)) {
+        this_paren <= (int)(sizeof (cs->paren_has_width) * CHAR_BIT)) {
 
-      SET_BIT (Paren_Has_Width, this_paren);
+      SET_BIT (cs->paren_has_width, this_paren);
    }
 
-   Is_Case_Insensitive = old_sensitive;
-   Match_Newline       = old_newline;
+   cs->is_case_insensitive = old_sensitive;
+   cs->match_newline       = old_newline;
 
    return (ret_val);
 }
@@ -882,7 +1390,8 @@ static unsigned char * chunk (int paren, int *flag_param,
  * pointers of each regex atom together sequentialy.
  *----------------------------------------------------------------------*/
 
-static unsigned char * alternative (int *flag_param, len_range *range_param) {
+static unsigned char * alternative (compile_state *cs, int *flag_param,
+                                    len_range *range_param) {
 
    register unsigned char *ret_val;
    register unsigned char *chain;
@@ -894,14 +1403,14 @@ static unsigned char * alternative (int *flag_param, len_range *range_param) {
    range_param->lower = 0; /* Idem */
    range_param->upper = 0;
 
-   ret_val = emit_node (BRANCH);
+   ret_val = emit_node (cs, BRANCH);
    chain   = NULL;
 
    /* Loop until we hit the start of the next alternative, the end of this set
       of alternatives (end of parentheses), or the end of the regex. */
 
-   while (*Reg_Parse != '|' && *Reg_Parse != ')' && *Reg_Parse != '\0') {
-      latest = piece (&flags_local, &range_local);
+   while (*cs->reg_parse != '|' && *cs->reg_parse != ')' && *cs->reg_parse != '\0') {
+      latest = piece (cs, &flags_local, &range_local);
 
       if (latest == NULL) return (NULL); /* Something went wrong. */
 
@@ -923,7 +1432,7 @@ static unsigned char * alternative (int *flag_param, len_range *range_param) {
    }
 
    if (chain == NULL) {  /* Loop ran zero times. */
-      (void) emit_node (NOTHING);
+      (void) emit_node (cs, NOTHING);
    }
 
    return (ret_val);
@@ -939,7 +1448,8 @@ static unsigned char * alternative (int *flag_param, len_range *range_param) {
  * dispensed with entirely, but the endmarker role is not redundant.
  *----------------------------------------------------------------------*/
 
-static unsigned char * piece (int *flag_param, len_range *range_param) {
+static unsigned char * piece (compile_state *cs, int *flag_param,
+                              len_range *range_param) {
 
    register unsigned char *ret_val;
    register unsigned char *next;
@@ -950,11 +1460,11 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
             int            digit_present [2] = {0,0};
 	    len_range      range_local;
 
-   ret_val = atom (&flags_local, &range_local);
+   ret_val = atom (cs, &flags_local, &range_local);
 
    if (ret_val == NULL) return (NULL);  /* Something went wrong. */
 
-   op_code = *Reg_Parse;
+   op_code = *cs->reg_parse;
 
    if (!IS_QUANTIFIER (op_code)) {
       *flag_param = flags_local;
@@ -962,7 +1472,7 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
       return (ret_val);
    } else if (op_code == '{') { /* {n,m} quantifier present */
       brace_present++;
-      Reg_Parse++;
+      cs->reg_parse++;
 
       /* This code will allow specifying a counting range in any of the
          following forms:
@@ -983,33 +1493,33 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
             value for max and min of 65,535 is due to using 2 bytes to store
             each value in the compiled regex code. */
 
-         while (isdigit (*Reg_Parse)) {
+         while (isdigit (*cs->reg_parse)) {
             /* (6553 * 10 + 6) > 65535 (16 bit max) */
 
-            if ((min_max [i] == 6553UL && (*Reg_Parse - '0') <= 5) ||
+            if ((min_max [i] == 6553UL && (*cs->reg_parse - '0') <= 5) ||
                 (min_max [i] <= 6552UL)) {
 
                min_max [i] = (min_max [i] * 10UL) +
-                             (unsigned long) (*Reg_Parse - '0');
-               Reg_Parse++;
+                             (unsigned long) (*cs->reg_parse - '0');
+               cs->reg_parse++;
 
                digit_present [i]++;
             } else {
                if (i == 0) {
-                  sprintf (Error_Text, "min operand of {%lu%c,???} > 65535",
-                           min_max [0], *Reg_Parse);
+                  sprintf (cs->error_text, "min operand of {%lu%c,???} > 65535",
+                           min_max [0], *cs->reg_parse);
                } else {
-                  sprintf (Error_Text, "max operand of {%lu,%lu%c} > 65535",
-                           min_max [0], min_max [1], *Reg_Parse);
+                  sprintf (cs->error_text, "max operand of {%lu,%lu%c} > 65535",
+                           min_max [0], min_max [1], *cs->reg_parse);
                }
 
-               REG_FAIL (Error_Text);
+               REG_FAIL (cs->error_text);
             }
          }
 
-         if (!comma_present && *Reg_Parse == ',') {
+         if (!comma_present && *cs->reg_parse == ',') {
             comma_present++;
-            Reg_Parse++;
+            cs->reg_parse++;
          }
       }
 
@@ -1027,8 +1537,8 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
          REG_FAIL ("{0,0} is an invalid range");
       } else if (digit_present [1] && (min_max [1] == REG_ZERO)) {
          if (digit_present [0]) {
-            sprintf (Error_Text, "{%lu,0} is an invalid range", min_max [0]);
-            REG_FAIL (Error_Text);
+            sprintf (cs->error_text, "{%lu,0} is an invalid range", min_max [0]);
+            REG_FAIL (cs->error_text);
          } else {
             REG_FAIL ("{,0} is an invalid range");
          }
@@ -1036,25 +1546,25 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
 
       if (!comma_present) min_max [1] = min_max [0]; /* {x} means {x,x} */
 
-      if (*Reg_Parse != '}') {
+      if (*cs->reg_parse != '}') {
          REG_FAIL ("{m,n} specification missing right \'}\'");
 
       } else if (min_max [1] != REG_INFINITY && min_max [0] > min_max [1]) {
          /* Disallow a backward range. */
 
-         sprintf (Error_Text, "{%lu,%lu} is an invalid range",
+         sprintf (cs->error_text, "{%lu,%lu} is an invalid range",
                   min_max [0], min_max [1]);
-         REG_FAIL (Error_Text);
+         REG_FAIL (cs->error_text);
       }
    }
 
-   Reg_Parse++;
+   cs->reg_parse++;
 
    /* Check for a minimal matching (non-greedy or "lazy") specification. */
 
-   if (*Reg_Parse == '?') {
+   if (*cs->reg_parse == '?') {
       lazy = 1;
-      Reg_Parse++;
+      cs->reg_parse++;
    }
 
    /* Avoid overhead of counting if possible */
@@ -1073,9 +1583,9 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
          *flag_param = flags_local;
 	 *range_param = range_local;
          return (ret_val);
-      } else if (Num_Braces > (int)UCHAR_MAX) {
-         sprintf (Error_Text, "number of {m,n} constructs > %d", UCHAR_MAX);
-         REG_FAIL (Error_Text);
+      } else if (cs->num_braces > (int)UCHAR_MAX) {
+         sprintf (cs->error_text, "number of {m,n} constructs > %d", UCHAR_MAX);
+         REG_FAIL (cs->error_text);
       }
    }
 
@@ -1087,13 +1597,13 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
 
    if (!(flags_local & HAS_WIDTH)) {
       if (brace_present) {
-         sprintf (Error_Text, "{%lu,%lu} operand could be empty",
+         sprintf (cs->error_text, "{%lu,%lu} operand could be empty",
                   min_max [0], min_max [1]);
       } else {
-         sprintf (Error_Text, "%c operand could be empty", op_code);
+         sprintf (cs->error_text, "%c operand could be empty", op_code);
       }
 
-      REG_FAIL (Error_Text);
+      REG_FAIL (cs->error_text);
    }
 
    *flag_param = (min_max [0] > REG_ZERO) ? (WORST | HAS_WIDTH) : WORST;
@@ -1122,16 +1632,16 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
     *---------------------------------------------------------------------*/
 
    if (op_code == '*' && (flags_local & SIMPLE)) {
-      insert ((lazy ? LAZY_STAR : STAR), ret_val, 0UL, 0UL, 0);
+      insert (cs, (lazy ? LAZY_STAR : STAR), ret_val, 0UL, 0UL, 0);
 
    } else if (op_code == '+' && (flags_local & SIMPLE)) {
-      insert (lazy ? LAZY_PLUS : PLUS, ret_val, 0UL, 0UL, 0);
+      insert (cs, lazy ? LAZY_PLUS : PLUS, ret_val, 0UL, 0UL, 0);
 
    } else if (op_code == '?' && (flags_local & SIMPLE)) {
-      insert (lazy ? LAZY_QUESTION : QUESTION, ret_val, 0UL, 0UL, 0);
+      insert (cs, lazy ? LAZY_QUESTION : QUESTION, ret_val, 0UL, 0UL, 0);
 
    } else if (op_code == '{' && (flags_local & SIMPLE)) {
-      insert (lazy ? LAZY_BRACE : BRACE, ret_val, min_max [0], min_max [1], 0);
+      insert (cs, lazy ? LAZY_BRACE : BRACE, ret_val, min_max [0], min_max [1], 0);
 
    } else if ((op_code == '*' || op_code == '+') && lazy) {
       /*  Node structure for (x)*?    Node structure for (x)+? construct.
@@ -1148,20 +1658,20 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
        *
        */
 
-      tail (ret_val, emit_node (BACK));                 /* 1 */
-      (void) insert (BRANCH,  ret_val, 0UL, 0UL, 0);    /* 2,4 */
-      (void) insert (NOTHING, ret_val, 0UL, 0UL, 0);    /* 3 */
+      tail (ret_val, emit_node (cs, BACK));             /* 1 */
+      (void) insert (cs, BRANCH,  ret_val, 0UL, 0UL, 0); /* 2,4 */
+      (void) insert (cs, NOTHING, ret_val, 0UL, 0UL, 0); /* 3 */
 
-      next = emit_node (NOTHING);                       /* 2,3 */
+      next = emit_node (cs, NOTHING);                   /* 2,3 */
 
       offset_tail (ret_val, NODE_SIZE, next);           /* 2 */
       tail        (ret_val, next);                      /* 3 */
-      insert      (BRANCH, ret_val, 0UL, 0UL, 0);       /* 4,5 */
+      insert (cs, BRANCH, ret_val, 0UL, 0UL, 0);   /* 4,5 */
       tail        (ret_val, ret_val + (2 * NODE_SIZE)); /* 4 */
       offset_tail (ret_val, 3 * NODE_SIZE, ret_val);    /* 5 */
 
       if (op_code == '+') {
-         insert (NOTHING, ret_val, 0UL, 0UL, 0);        /* 6 */
+         insert (cs, NOTHING, ret_val, 0UL, 0UL, 0);    /* 6 */
          tail   (ret_val, ret_val + (4 * NODE_SIZE));   /* 6 */
       }
    } else if (op_code == '*') {
@@ -1173,11 +1683,11 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
        *       \__3_______|  4
        */
 
-      insert  (BRANCH, ret_val, 0UL, 0UL, 0);             /* 1,3 */
-      offset_tail (ret_val, NODE_SIZE, emit_node (BACK)); /* 2 */
+      insert (cs, BRANCH, ret_val, 0UL, 0UL, 0);      /* 1,3 */
+      offset_tail (ret_val, NODE_SIZE, emit_node (cs, BACK)); /* 2 */
       offset_tail (ret_val, NODE_SIZE, ret_val);          /* 1 */
-      tail    (ret_val, emit_node (BRANCH));              /* 3 */
-      tail    (ret_val, emit_node (NOTHING));             /* 4 */
+      tail    (ret_val, emit_node (cs, BRANCH));          /* 3 */
+      tail    (ret_val, emit_node (cs, NOTHING));         /* 4 */
    } else if (op_code == '+') {
       /* Node structure for (x)+ construct.
        *
@@ -1188,12 +1698,12 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
        *          1     3    4
        */
 
-      next = emit_node (BRANCH);            /* 1 */
+      next = emit_node (cs, BRANCH);        /* 1 */
 
       tail (ret_val, next);                 /* 1 */
-      tail (emit_node (BACK), ret_val);     /* 2 */
-      tail (next, emit_node (BRANCH));      /* 3 */
-      tail (ret_val, emit_node (NOTHING));  /* 4 */
+      tail (emit_node (cs, BACK), ret_val); /* 2 */
+      tail (next, emit_node (cs, BRANCH));  /* 3 */
+      tail (ret_val, emit_node (cs, NOTHING)); /* 4 */
    } else if (op_code == '?' && lazy) {
       /* Node structure for (x)?? construct.
        *       _4__        1_
@@ -1203,15 +1713,15 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
        *          \_____3____|
        */
 
-      (void) insert  (BRANCH,  ret_val, 0UL, 0UL, 0);      /* 2,4 */
-      (void) insert  (NOTHING, ret_val, 0UL, 0UL, 0);      /* 3 */
+      (void) insert (cs, BRANCH,  ret_val, 0UL, 0UL, 0); /* 2,4 */
+      (void) insert (cs, NOTHING, ret_val, 0UL, 0UL, 0); /* 3 */
 
-      next = emit_node (NOTHING);                          /* 1,2,3 */
+      next = emit_node (cs, NOTHING);                      /* 1,2,3 */
 
       offset_tail (ret_val, 2 * NODE_SIZE, next);          /* 1 */
       offset_tail (ret_val,     NODE_SIZE, next);          /* 2 */
       tail        (ret_val, next);                         /* 3 */
-      insert      (BRANCH,  ret_val, 0UL, 0UL, 0);         /* 4 */
+      insert (cs, BRANCH,  ret_val, 0UL, 0UL, 0);     /* 4 */
       tail        (ret_val, (ret_val + (2 * NODE_SIZE)));  /* 4 */
 
    } else if (op_code == '?') {
@@ -1222,10 +1732,10 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
        *             \__3_|
        */
 
-      insert (BRANCH, ret_val, 0UL, 0UL, 0);   /* 1 */
-      tail   (ret_val, emit_node (BRANCH));    /* 1 */
+      insert (cs, BRANCH, ret_val, 0UL, 0UL, 0); /* 1 */
+      tail   (ret_val, emit_node (cs, BRANCH)); /* 1 */
 
-      next = emit_node (NOTHING);              /* 2,3 */
+      next = emit_node (cs, NOTHING);          /* 2,3 */
 
       tail        (ret_val, next);             /* 2 */
       offset_tail (ret_val, NODE_SIZE, next);  /* 3 */
@@ -1241,16 +1751,16 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
        *     5              4
        */
 
-      tail (ret_val, emit_special (INC_COUNT, 0UL, Num_Braces));         /* 1 */
-      tail (ret_val, emit_special (TEST_COUNT, min_max [0], Num_Braces));/* 2 */
-      tail (emit_node (BACK), ret_val);                                  /* 3 */
-      tail (ret_val, emit_node (NOTHING));                               /* 4 */
+      tail (ret_val, emit_special (cs, INC_COUNT, 0UL, cs->num_braces)); /* 1 */
+      tail (ret_val, emit_special (cs, TEST_COUNT, min_max [0], cs->num_braces));/* 2 */
+      tail (emit_node (cs, BACK), ret_val);                              /* 3 */
+      tail (ret_val, emit_node (cs, NOTHING));                           /* 4 */
 
-      next = insert (INIT_COUNT, ret_val, 0UL, 0UL, Num_Braces);         /* 5 */
+      next = insert (cs, INIT_COUNT, ret_val, 0UL, 0UL, cs->num_braces); /* 5 */
 
       tail (ret_val, next);                                              /* 5 */
 
-      Num_Braces++;
+      cs->num_braces++;
    } else if (op_code == '{' && lazy) {
       if (min_max [0] == REG_ZERO && min_max [1] != REG_INFINITY) {
          /* Node structure for (x){0,n}? or {,n}? construct.
@@ -1263,24 +1773,24 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
           *            \______5____________|
           */
 
-         tail (ret_val, emit_special (INC_COUNT, 0UL, Num_Braces)); /* 1 */
+         tail (ret_val, emit_special (cs, INC_COUNT, 0UL, cs->num_braces)); /* 1 */
 
-         next = emit_special (TEST_COUNT, min_max [0], Num_Braces); /* 2,7 */
+         next = emit_special (cs, TEST_COUNT, min_max [0], cs->num_braces); /* 2,7 */
 
          tail (ret_val, next);                                      /* 2 */
-         (void) insert (BRANCH,  ret_val, 0UL, 0UL, Num_Braces);    /* 4,6 */
-         (void) insert (NOTHING, ret_val, 0UL, 0UL, Num_Braces);    /* 5 */
-         (void) insert (BRANCH,  ret_val, 0UL, 0UL, Num_Braces);    /* 3,4,8 */
-         tail (emit_node (BACK), ret_val);                          /* 3 */
+         (void) insert (cs, BRANCH,  ret_val, 0UL, 0UL, cs->num_braces); /* 4,6 */
+         (void) insert (cs, NOTHING, ret_val, 0UL, 0UL, cs->num_braces); /* 5 */
+         (void) insert (cs, BRANCH,  ret_val, 0UL, 0UL, cs->num_braces); /* 3,4,8 */
+         tail (emit_node (cs, BACK), ret_val);                      /* 3 */
          tail (ret_val, ret_val + (2 * NODE_SIZE));                 /* 4 */
 
-         next = emit_node (NOTHING);                                /* 5,6,7 */
+         next = emit_node (cs, NOTHING);                            /* 5,6,7 */
 
          offset_tail (ret_val, NODE_SIZE, next);                    /* 5 */
          offset_tail (ret_val, 2 * NODE_SIZE, next);                /* 6 */
          offset_tail (ret_val, 3 * NODE_SIZE, next);                /* 7 */
 
-         next = insert (INIT_COUNT, ret_val, 0UL, 0UL, Num_Braces); /* 8 */
+         next = insert (cs, INIT_COUNT, ret_val, 0UL, 0UL, cs->num_braces); /* 8 */
 
          tail (ret_val, next);                                      /* 8 */
 
@@ -1296,24 +1806,24 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
           *            \_______6______________|
           */
 
-         tail (ret_val, emit_special (INC_COUNT, 0UL, Num_Braces)); /* 1 */
+         tail (ret_val, emit_special (cs, INC_COUNT, 0UL, cs->num_braces)); /* 1 */
 
-         next = emit_special (TEST_COUNT, min_max [0], Num_Braces); /* 2,4 */
+         next = emit_special (cs, TEST_COUNT, min_max [0], cs->num_braces); /* 2,4 */
 
          tail (ret_val, next);                                      /* 2 */
-         tail (emit_node (BACK), ret_val);                          /* 3 */
-         tail (ret_val, emit_node (BACK));                          /* 4 */
-         (void) insert (BRANCH, ret_val, 0UL, 0UL, 0);              /* 5,7 */
-         (void) insert (NOTHING, ret_val, 0UL, 0UL, 0);             /* 6 */
+         tail (emit_node (cs, BACK), ret_val);                      /* 3 */
+         tail (ret_val, emit_node (cs, BACK));                      /* 4 */
+         (void) insert (cs, BRANCH, ret_val, 0UL, 0UL, 0);          /* 5,7 */
+         (void) insert (cs, NOTHING, ret_val, 0UL, 0UL, 0);         /* 6 */
 
-         next = emit_node (NOTHING);                                /* 5,6 */
+         next = emit_node (cs, NOTHING);                            /* 5,6 */
 
          offset_tail (ret_val, NODE_SIZE, next);                    /* 5 */
          tail (ret_val, next);                                      /* 6 */
-         (void) insert (BRANCH,  ret_val, 0UL, 0UL, 0);             /* 7,8 */
+         (void) insert (cs, BRANCH,  ret_val, 0UL, 0UL, 0);         /* 7,8 */
          tail (ret_val, ret_val + (2 * NODE_SIZE));                 /* 7 */
          offset_tail (ret_val, 3 * NODE_SIZE, ret_val);             /* 8 */
-         (void) insert (INIT_COUNT, ret_val, 0UL, 0UL, Num_Braces); /* 9 */
+         (void) insert (cs, INIT_COUNT, ret_val, 0UL, 0UL, cs->num_braces); /* 9 */
          tail (ret_val, ret_val + INDEX_SIZE + (4 * NODE_SIZE));    /* 9 */
 
       } else {
@@ -1329,32 +1839,32 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
           *             \_______5_________________|
           */
 
-         tail (ret_val, emit_special (INC_COUNT, 0UL, Num_Braces)); /* 1 */
+         tail (ret_val, emit_special (cs, INC_COUNT, 0UL, cs->num_braces)); /* 1 */
 
-         next = emit_special (TEST_COUNT, min_max [1], Num_Braces); /* 2,7 */
+         next = emit_special (cs, TEST_COUNT, min_max [1], cs->num_braces); /* 2,7 */
 
          tail (ret_val, next);                                      /* 2 */
 
-         next = emit_special (TEST_COUNT, min_max [0], Num_Braces); /* 4 */
+         next = emit_special (cs, TEST_COUNT, min_max [0], cs->num_braces); /* 4 */
 
-         tail (emit_node (BACK), ret_val);                          /* 3 */
-         tail (next, emit_node (BACK));                             /* 4 */
-         (void) insert (BRANCH, ret_val, 0UL, 0UL, 0);              /* 6,8 */
-         (void) insert (NOTHING, ret_val, 0UL, 0UL, 0);             /* 5 */
-         (void) insert (BRANCH,  ret_val, 0UL, 0UL, 0);             /* 8,9 */
+         tail (emit_node (cs, BACK), ret_val);                      /* 3 */
+         tail (next, emit_node (cs, BACK));                         /* 4 */
+         (void) insert (cs, BRANCH, ret_val, 0UL, 0UL, 0);          /* 6,8 */
+         (void) insert (cs, NOTHING, ret_val, 0UL, 0UL, 0);         /* 5 */
+         (void) insert (cs, BRANCH,  ret_val, 0UL, 0UL, 0);         /* 8,9 */
 
-         next = emit_node (NOTHING);                                /* 5,6,7 */
+         next = emit_node (cs, NOTHING);                            /* 5,6,7 */
 
          offset_tail (ret_val, NODE_SIZE, next);                    /* 5 */
          offset_tail (ret_val, 2 * NODE_SIZE, next);                /* 6 */
          offset_tail (ret_val, 3 * NODE_SIZE, next);                /* 7 */
          tail (ret_val, ret_val + (2 * NODE_SIZE));                 /* 8 */
          offset_tail (next, -NODE_SIZE, ret_val);                   /* 9 */
-         insert (INIT_COUNT, ret_val, 0UL, 0UL, Num_Braces);        /* 10 */
+         insert (cs, INIT_COUNT, ret_val, 0UL, 0UL, cs->num_braces); /* 10 */
          tail (ret_val, ret_val + INDEX_SIZE + (4 * NODE_SIZE));    /* 10 */
       }
 
-      Num_Braces++;
+      cs->num_braces++;
    } else if (op_code == '{') {
       if (min_max [0] == REG_ZERO && min_max [1] != REG_INFINITY) {
          /* Node structure for (x){0,n} or (x){,n} construct.
@@ -1367,21 +1877,21 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
           *    7   \________4________|
           */
 
-         tail (ret_val, emit_special (INC_COUNT, 0UL, Num_Braces)); /* 1 */
+         tail (ret_val, emit_special (cs, INC_COUNT, 0UL, cs->num_braces)); /* 1 */
 
-         next = emit_special (TEST_COUNT, min_max [1], Num_Braces); /* 2,6 */
+         next = emit_special (cs, TEST_COUNT, min_max [1], cs->num_braces); /* 2,6 */
 
          tail (ret_val, next);                                      /* 2 */
-         (void) insert (BRANCH, ret_val, 0UL, 0UL, 0);              /* 3,4,7 */
-         tail (emit_node (BACK), ret_val);                          /* 3 */
+         (void) insert (cs, BRANCH, ret_val, 0UL, 0UL, 0);          /* 3,4,7 */
+         tail (emit_node (cs, BACK), ret_val);                      /* 3 */
 
-         next = emit_node (BRANCH);                                 /* 4,5 */
+         next = emit_node (cs, BRANCH);                             /* 4,5 */
 
          tail (ret_val, next);                                      /* 4 */
-         tail (next, emit_node (NOTHING));                          /* 5,6 */
+         tail (next, emit_node (cs, NOTHING));                      /* 5,6 */
          offset_tail (ret_val, NODE_SIZE, next);                    /* 6 */
 
-         next = insert (INIT_COUNT, ret_val, 0UL, 0UL, Num_Braces); /* 7 */
+         next = insert (cs, INIT_COUNT, ret_val, 0UL, 0UL, cs->num_braces); /* 7 */
 
          tail (ret_val, next);                                      /* 7 */
 
@@ -1396,22 +1906,22 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
           *        \__________6__________|
           */
 
-         tail (ret_val, emit_special (INC_COUNT, 0UL, Num_Braces)); /* 1 */
+         tail (ret_val, emit_special (cs, INC_COUNT, 0UL, cs->num_braces)); /* 1 */
 
-         next = emit_special (TEST_COUNT, min_max [0], Num_Braces); /* 2 */
+         next = emit_special (cs, TEST_COUNT, min_max [0], cs->num_braces); /* 2 */
 
          tail (ret_val, next);                                      /* 2 */
-         tail (emit_node (BACK), ret_val);                          /* 3 */
-         (void) insert (BRANCH, ret_val, 0UL, 0UL, 0);              /* 4,6 */
+         tail (emit_node (cs, BACK), ret_val);                      /* 3 */
+         (void) insert (cs, BRANCH, ret_val, 0UL, 0UL, 0);          /* 4,6 */
 
-         next = emit_node (BACK);                                   /* 4 */
+         next = emit_node (cs, BACK);                               /* 4 */
 
          tail        (next, ret_val);                               /* 4 */
          offset_tail (ret_val, NODE_SIZE, next);                    /* 5 */
-         tail        (ret_val, emit_node (BRANCH));                 /* 6 */
-         tail        (ret_val, emit_node (NOTHING));                /* 7 */
+         tail        (ret_val, emit_node (cs, BRANCH));             /* 6 */
+         tail        (ret_val, emit_node (cs, NOTHING));            /* 7 */
 
-         insert (INIT_COUNT, ret_val, 0UL, 0UL, Num_Braces);        /* 8 */
+         insert (cs, INIT_COUNT, ret_val, 0UL, 0UL, cs->num_braces); /* 8 */
 
          tail (ret_val, ret_val + INDEX_SIZE + (2 * NODE_SIZE));    /* 8 */
 
@@ -1427,33 +1937,33 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
           *         \_________5_____________|
           */
 
-         tail (ret_val, emit_special (INC_COUNT, 0UL, Num_Braces)); /* 1 */
+         tail (ret_val, emit_special (cs, INC_COUNT, 0UL, cs->num_braces)); /* 1 */
 
-         next = emit_special (TEST_COUNT, min_max [1], Num_Braces); /* 2,4 */
+         next = emit_special (cs, TEST_COUNT, min_max [1], cs->num_braces); /* 2,4 */
 
          tail (ret_val, next);                                      /* 2 */
 
-         next = emit_special (TEST_COUNT, min_max [0], Num_Braces); /* 4 */
+         next = emit_special (cs, TEST_COUNT, min_max [0], cs->num_braces); /* 4 */
 
-         tail (emit_node (BACK), ret_val);                          /* 3 */
-         tail (next, emit_node (BACK));                             /* 4 */
-         (void) insert (BRANCH, ret_val, 0UL, 0UL, 0);              /* 5,6 */
+         tail (emit_node (cs, BACK), ret_val);                      /* 3 */
+         tail (next, emit_node (cs, BACK));                         /* 4 */
+         (void) insert (cs, BRANCH, ret_val, 0UL, 0UL, 0);          /* 5,6 */
 
-         next = emit_node (BRANCH);                                 /* 5,8 */
+         next = emit_node (cs, BRANCH);                             /* 5,8 */
 
          tail        (ret_val, next);                               /* 5 */
          offset_tail (next, -NODE_SIZE, ret_val);                   /* 6 */
 
-         next = emit_node (NOTHING);                                /* 7,8 */
+         next = emit_node (cs, NOTHING);                            /* 7,8 */
 
          offset_tail (ret_val, NODE_SIZE, next);                    /* 7 */
 
          offset_tail (next, -NODE_SIZE, next);                      /* 8 */
-         (void) insert (INIT_COUNT, ret_val, 0UL, 0UL, Num_Braces); /* 9 */
+         (void) insert (cs, INIT_COUNT, ret_val, 0UL, 0UL, cs->num_braces); /* 9 */
          tail (ret_val, ret_val + INDEX_SIZE + (2 * NODE_SIZE));    /* 9 */
       }
 
-      Num_Braces++;
+      cs->num_braces++;
    } else {
       /* We get here if the IS_QUANTIFIER macro is not coordinated properly
          with this function. */
@@ -1461,14 +1971,14 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
       REG_FAIL ("internal error #2, `piece\'");
    }
 
-   if (IS_QUANTIFIER (*Reg_Parse)) {
+   if (IS_QUANTIFIER (*cs->reg_parse)) {
       if (op_code == '{') {
-         sprintf (Error_Text, "nested quantifiers, {m,n}%c", *Reg_Parse);
+         sprintf (cs->error_text, "nested quantifiers, {m,n}%c", *cs->reg_parse);
       } else {
-         sprintf (Error_Text, "nested quantifiers, %c%c", op_code, *Reg_Parse);
+         sprintf (cs->error_text, "nested quantifiers, %c%c", op_code, *cs->reg_parse);
       }
 
-      REG_FAIL (Error_Text);
+      REG_FAIL (cs->error_text);
    }
 
    return (ret_val);
@@ -1484,7 +1994,8 @@ static unsigned char * piece (int *flag_param, len_range *range_param) {
  * is smaller to store and faster to run.
  *----------------------------------------------------------------------*/
 
-static unsigned char * atom (int *flag_param, len_range *range_param) {
+static unsigned char * atom (compile_state *cs, int *flag_param,
+                             len_range *range_param) {
 
    register unsigned char *ret_val;
             unsigned char  test;
@@ -1501,53 +2012,53 @@ static unsigned char * atom (int *flag_param, len_range *range_param) {
       string)... period.  Handles multiple sequential comments,
       e.g. `(?# one)(?# two)...'  */
 
-   while (*Reg_Parse      == '(' &&
-         *(Reg_Parse + 1) == '?' &&
-         *(Reg_Parse + 2) == '#') {
+   while (*cs->reg_parse      == '(' &&
+         *(cs->reg_parse + 1) == '?' &&
+         *(cs->reg_parse + 2) == '#') {
 
-      Reg_Parse += 3;
+      cs->reg_parse += 3;
 
-      while (*Reg_Parse != ')' && *Reg_Parse != '\0') {
-         Reg_Parse++;
+      while (*cs->reg_parse != ')' && *cs->reg_parse != '\0') {
+         cs->reg_parse++;
       }
 
-      if (*Reg_Parse == ')') {
-         Reg_Parse++;
+      if (*cs->reg_parse == ')') {
+         cs->reg_parse++;
       }
 
-      if (*Reg_Parse == ')' || *Reg_Parse == '|' || *Reg_Parse == '\0') {
+      if (*cs->reg_parse == ')' || *cs->reg_parse == '|' || *cs->reg_parse == '\0') {
          /* Hit end of regex string or end of parenthesized regex; have to
           return "something" (i.e. a NOTHING node) to avoid generating an
           error. */
 
-         ret_val = emit_node (NOTHING);
+         ret_val = emit_node (cs, NOTHING);
 
          return (ret_val);
       }
    }
 
-   switch (*Reg_Parse++) {
+   switch (*cs->reg_parse++) {
       case '^':
-         ret_val = emit_node (BOL);
+         ret_val = emit_node (cs, BOL);
          break;
 
       case '$':
-         ret_val = emit_node (EOL);
+         ret_val = emit_node (cs, EOL);
          break;
 
       case '<':
-         ret_val = emit_node (BOWORD);
+         ret_val = emit_node (cs, BOWORD);
          break;
 
       case '>':
-         ret_val = emit_node (EOWORD);
+         ret_val = emit_node (cs, EOWORD);
          break;
 
       case '.':
-         if (Match_Newline) {
-            ret_val = emit_node (EVERY);
+         if (cs->match_newline) {
+            ret_val = emit_node (cs, EVERY);
          } else {
-            ret_val = emit_node (ANY);
+            ret_val = emit_node (cs, ANY);
          }
 
          *flag_param |= (HAS_WIDTH | SIMPLE); 
@@ -1556,56 +2067,56 @@ static unsigned char * atom (int *flag_param, len_range *range_param) {
 	 break;
 
       case '(':
-         if (*Reg_Parse == '?') {  /* Special parenthetical expression */
-            Reg_Parse++;
+         if (*cs->reg_parse == '?') { /* Special parenthetical expression */
+            cs->reg_parse++;
 	    range_local.lower = 0; /* Make sure it is always used */
 	    range_local.upper = 0;
 
-            if (*Reg_Parse == ':') {
-               Reg_Parse++;
-               ret_val = chunk (NO_CAPTURE, &flags_local, &range_local);
-            } else if (*Reg_Parse == '=') {
-               Reg_Parse++;
-               ret_val = chunk (POS_AHEAD_OPEN, &flags_local, &range_local);
-            } else if (*Reg_Parse == '!') {
-               Reg_Parse++;
-               ret_val = chunk (NEG_AHEAD_OPEN, &flags_local, &range_local);
-            } else if (*Reg_Parse == 'i') {
-               Reg_Parse++;
-               ret_val = chunk (INSENSITIVE, &flags_local, &range_local);
-            } else if (*Reg_Parse == 'I') {
-               Reg_Parse++;
-               ret_val = chunk (SENSITIVE, &flags_local, &range_local);
-            } else if (*Reg_Parse == 'n') {
-               Reg_Parse++;
-               ret_val = chunk (NEWLINE, &flags_local, &range_local);
-            } else if (*Reg_Parse == 'N') {
-               Reg_Parse++;
-               ret_val = chunk (NO_NEWLINE, &flags_local, &range_local);
-            } else if (*Reg_Parse == '<') {
-               Reg_Parse++;
-	       if (*Reg_Parse == '=') {
-	          Reg_Parse++;
-                  ret_val = chunk (POS_BEHIND_OPEN, &flags_local, &range_local);
-	       } else if (*Reg_Parse == '!') {
-	          Reg_Parse++;
-                  ret_val = chunk (NEG_BEHIND_OPEN, &flags_local, &range_local);
+            if (*cs->reg_parse == ':') {
+               cs->reg_parse++;
+               ret_val = chunk (cs, NO_CAPTURE, &flags_local, &range_local);
+            } else if (*cs->reg_parse == '=') {
+               cs->reg_parse++;
+               ret_val = chunk (cs, POS_AHEAD_OPEN, &flags_local, &range_local);
+            } else if (*cs->reg_parse == '!') {
+               cs->reg_parse++;
+               ret_val = chunk (cs, NEG_AHEAD_OPEN, &flags_local, &range_local);
+            } else if (*cs->reg_parse == 'i') {
+               cs->reg_parse++;
+               ret_val = chunk (cs, INSENSITIVE, &flags_local, &range_local);
+            } else if (*cs->reg_parse == 'I') {
+               cs->reg_parse++;
+               ret_val = chunk (cs, SENSITIVE, &flags_local, &range_local);
+            } else if (*cs->reg_parse == 'n') {
+               cs->reg_parse++;
+               ret_val = chunk (cs, NEWLINE, &flags_local, &range_local);
+            } else if (*cs->reg_parse == 'N') {
+               cs->reg_parse++;
+               ret_val = chunk (cs, NO_NEWLINE, &flags_local, &range_local);
+            } else if (*cs->reg_parse == '<') {
+               cs->reg_parse++;
+	       if (*cs->reg_parse == '=') {
+	          cs->reg_parse++;
+                  ret_val = chunk (cs, POS_BEHIND_OPEN, &flags_local, &range_local);
+	       } else if (*cs->reg_parse == '!') {
+	          cs->reg_parse++;
+                  ret_val = chunk (cs, NEG_BEHIND_OPEN, &flags_local, &range_local);
 	       } else {
-                  sprintf (Error_Text,
+                  sprintf (cs->error_text,
                            "invalid look-behind syntax, \"(?<%c...)\"",
-                           *Reg_Parse);
+                           *cs->reg_parse);
 
-                  REG_FAIL (Error_Text);
+                  REG_FAIL (cs->error_text);
 	       }
             } else {
-               sprintf (Error_Text,
+               sprintf (cs->error_text,
                         "invalid grouping syntax, \"(?%c...)\"",
-                        *Reg_Parse);
+                        *cs->reg_parse);
 
-               REG_FAIL (Error_Text);
+               REG_FAIL (cs->error_text);
             }
          } else { /* Normal capturing parentheses */
-            ret_val = chunk (PAREN, &flags_local, &range_local);
+            ret_val = chunk (cs, PAREN, &flags_local, &range_local);
          }
 
          if (ret_val == NULL) return (NULL);  /* Something went wrong. */
@@ -1625,16 +2136,16 @@ static unsigned char * atom (int *flag_param, len_range *range_param) {
       case '?':
       case '+':
       case '*':
-         sprintf (Error_Text, "%c follows nothing", *(Reg_Parse - 1));
-         REG_FAIL (Error_Text);
+         sprintf (cs->error_text, "%c follows nothing", *(cs->reg_parse - 1));
+         REG_FAIL (cs->error_text);
 
       case '{':
          if (Enable_Counting_Quantifier) {
             REG_FAIL ("{m,n} follows nothing");
          } else {
-            ret_val = emit_node (EXACTLY); /* Treat braces as literals. */
-            emit_byte ('{');
-            emit_byte ('\0');
+            ret_val = emit_node (cs, EXACTLY); /* Treat braces as literals. */
+            emit_byte (cs, '{');
+            emit_byte (cs, '\0');
 	    range_param->lower = 1;
 	    range_param->upper = 1;
          }
@@ -1649,39 +2160,39 @@ static unsigned char * atom (int *flag_param, len_range *range_param) {
 
             /* Handle characters that can only occur at the start of a class. */
 
-            if (*Reg_Parse == '^') { /* Complement of range. */
-               ret_val = emit_node (ANY_BUT);
-               Reg_Parse++;
+            if (*cs->reg_parse == '^') { /* Complement of range. */
+               ret_val = emit_node (cs, ANY_BUT);
+               cs->reg_parse++;
 
                /* All negated classes include newline unless escaped with
                   a "(?n)" switch. */
 
-               if (!Match_Newline) emit_byte ('\n');
+               if (!cs->match_newline) emit_byte (cs, '\n');
             } else {
-               ret_val = emit_node (ANY_OF);
+               ret_val = emit_node (cs, ANY_OF);
             }
 
-            if (*Reg_Parse == ']' || *Reg_Parse == '-') {
+            if (*cs->reg_parse == ']' || *cs->reg_parse == '-') {
                /* If '-' or ']' is the first character in a class,
                   it is a literal character in the class. */
 
-               last_emit = *Reg_Parse;
-               emit_byte (*Reg_Parse);
-               Reg_Parse++;
+               last_emit = *cs->reg_parse;
+               emit_byte (cs, *cs->reg_parse);
+               cs->reg_parse++;
             }
 
             /* Handle the rest of the class characters. */
 
-            while (*Reg_Parse != '\0' && *Reg_Parse != ']') {
-               if (*Reg_Parse == '-') { /* Process a range, e.g [a-z]. */
-                  Reg_Parse++;
+            while (*cs->reg_parse != '\0' && *cs->reg_parse != ']') {
+               if (*cs->reg_parse == '-') { /* Process a range, e.g [a-z]. */
+                  cs->reg_parse++;
 
-                  if (*Reg_Parse == ']' || *Reg_Parse == '\0') {
+                  if (*cs->reg_parse == ']' || *cs->reg_parse == '\0') {
                      /* If '-' is the last character in a class it is a literal
-                        character.  If `Reg_Parse' points to the end of the
+                        character.  If `cs->reg_parse' points to the end of the
                         regex string, an error will be generated later. */
 
-                     emit_byte ('-');
+                     emit_byte (cs, '-');
                      last_emit = '-';
                   } else {
                      /* We must get the range starting character value from the
@@ -1695,7 +2206,7 @@ static unsigned char * atom (int *flag_param, len_range *range_param) {
 
                      second_value = ((unsigned int) last_emit) + 1;
 
-                     if (*Reg_Parse == '\\') {
+                     if (*cs->reg_parse == '\\') {
                         /* Handle escaped characters within a class range.
                            Specifically disallow shortcut escapes as the end of
                            a class range.  To allow this would be ambiguous
@@ -1703,33 +2214,33 @@ static unsigned char * atom (int *flag_param, len_range *range_param) {
                            and it would not be clear which character of the
                            class should be treated as the "last" character. */
 
-                        Reg_Parse++;
+                        cs->reg_parse++;
 
-                        if ((test = numeric_escape (*Reg_Parse, &Reg_Parse))) {
+                        if ((test = numeric_escape (cs->error_text, *cs->reg_parse, &cs->reg_parse))) {
                            last_value = (unsigned int) test;
-                        } else if ((test = literal_escape (*Reg_Parse))) {
+                        } else if ((test = literal_escape (*cs->reg_parse))) {
                            last_value = (unsigned int) test;
-                        } else if (shortcut_escape (*Reg_Parse,
+                        } else if (shortcut_escape (cs, *cs->reg_parse,
                                                     NULL,
                                                     CHECK_CLASS_ESCAPE)) {
-                           sprintf (Error_Text,
+                           sprintf (cs->error_text,
                                     "\\%c is not allowed as range operand",
-                                    *Reg_Parse);
+                                    *cs->reg_parse);
 
-                           REG_FAIL (Error_Text);
+                           REG_FAIL (cs->error_text);
                         } else {
                            sprintf (
-                              Error_Text,
+                              cs->error_text,
                               "\\%c is an invalid char class escape sequence",
-                              *Reg_Parse);
+                              *cs->reg_parse);
 
-                           REG_FAIL (Error_Text);
+                           REG_FAIL (cs->error_text);
                         }
                      } else {
-                        last_value = U_CHAR_AT (Reg_Parse);
+                        last_value = U_CHAR_AT (cs->reg_parse);
                      }
 
-                     if (Is_Case_Insensitive) {
+                     if (cs->is_case_insensitive) {
                         second_value =
                            (unsigned int) tolower ((int) second_value);
                         last_value =
@@ -1749,65 +2260,65 @@ static unsigned char * atom (int *flag_param, len_range *range_param) {
                         was emitted by the previous iteration of while loop. */
 
                      for (; second_value <= last_value; second_value++) {
-                        emit_class_byte (second_value);
+                        emit_class_byte (cs, second_value);
                      }
 
                      last_emit = (unsigned char) last_value;
 
-                     Reg_Parse++;
+                     cs->reg_parse++;
 
                   } /* End class character range code. */
-               } else if (*Reg_Parse == '\\') {
-                  Reg_Parse++;
+               } else if (*cs->reg_parse == '\\') {
+                  cs->reg_parse++;
 
-                  if ((test = numeric_escape (*Reg_Parse, &Reg_Parse)) != '\0') {
-                     emit_class_byte (test);
+                  if ((test = numeric_escape (cs->error_text, *cs->reg_parse, &cs->reg_parse)) != '\0') {
+                     emit_class_byte (cs, test);
 
                      last_emit = test;
-                  } else if ((test = literal_escape (*Reg_Parse)) != '\0') {
-                     emit_byte (test);
+                  } else if ((test = literal_escape (*cs->reg_parse)) != '\0') {
+                     emit_byte (cs, test);
                      last_emit = test;
-                  } else if (shortcut_escape (*Reg_Parse,
+                  } else if (shortcut_escape (cs, *cs->reg_parse,
                                                NULL,
                                                CHECK_CLASS_ESCAPE)) {
 
-                     if (*(Reg_Parse + 1) == '-') {
+                     if (*(cs->reg_parse + 1) == '-') {
                         /* Specifically disallow shortcut escapes as the start
                            of a character class range (see comment above.) */
 
-                        sprintf (Error_Text,
+                        sprintf (cs->error_text,
                                  "\\%c not allowed as range operand",
-                                 *Reg_Parse);
+                                 *cs->reg_parse);
 
-                        REG_FAIL (Error_Text);
+                        REG_FAIL (cs->error_text);
                      } else {
                         /* Emit the bytes that are part of the shortcut
                            escape sequence's range (e.g. \d = 0123456789) */
 
-                        shortcut_escape (*Reg_Parse, NULL, EMIT_CLASS_BYTES);
+                        shortcut_escape (cs, *cs->reg_parse, NULL, EMIT_CLASS_BYTES);
                      }
                   } else {
-                     sprintf (Error_Text,
+                     sprintf (cs->error_text,
                               "\\%c is an invalid char class escape sequence",
-                              *Reg_Parse);
+                              *cs->reg_parse);
 
-                     REG_FAIL (Error_Text);
+                     REG_FAIL (cs->error_text);
                   }
 
-                  Reg_Parse++;
+                  cs->reg_parse++;
 
                   /* End of class escaped sequence code */
                } else {
-                  emit_class_byte (*Reg_Parse); /* Ordinary class character. */
+                  emit_class_byte (cs, *cs->reg_parse); /* Ordinary class character. */
 
-                  last_emit = *Reg_Parse;
-                  Reg_Parse++;
+                  last_emit = *cs->reg_parse;
+                  cs->reg_parse++;
                }
-            } /* End of while (*Reg_Parse != '\0' && *Reg_Parse != ']') */
+            } /* End of while (*cs->reg_parse != '\0' && *cs->reg_parse != ']') */
 
-            if (*Reg_Parse != ']') REG_FAIL ("missing right \']\'");
+            if (*cs->reg_parse != ']') REG_FAIL ("missing right \']\'");
 
-            emit_byte('\0');
+            emit_byte(cs, '\0');
 
             /* NOTE: it is impossible to specify an empty class.  This is
                because [] would be interpreted as "begin character class"
@@ -1815,7 +2326,7 @@ static unsigned char * atom (int *flag_param, len_range *range_param) {
                delimiter (']').  Because of this, it is always safe to assume
                that a class HAS_WIDTH. */
 
-            Reg_Parse++; 
+            cs->reg_parse++; 
 	    *flag_param |= HAS_WIDTH | SIMPLE;
 	    range_param->lower = 1;
 	    range_param->upper = 1;
@@ -1824,32 +2335,32 @@ static unsigned char * atom (int *flag_param, len_range *range_param) {
          break; /* End of character class code. */
 
       case '\\':
-         /* Force Error_Text to have a length of zero.  This way we can tell if
+         /* Force cs->error_text to have a length of zero.  This way we can tell if
             either of the calls to shortcut_escape() or back_ref() fill
-            Error_Text with an error message. */
+            cs->error_text with an error message. */
 
-         Error_Text [0] = '\0';
+         cs->error_text [0] = '\0';
 
-         if ((ret_val = shortcut_escape (*Reg_Parse, flag_param, EMIT_NODE))) {
+         if ((ret_val = shortcut_escape (cs, *cs->reg_parse, flag_param, EMIT_NODE))) {
 
-            Reg_Parse++; 
+            cs->reg_parse++; 
 	    range_param->lower = 1;
 	    range_param->upper = 1;
             break;
 
-         } else if ((ret_val = back_ref (Reg_Parse, flag_param, EMIT_NODE))) {
+         } else if ((ret_val = back_ref (cs, cs->reg_parse, flag_param, EMIT_NODE))) {
             /* Can't make any assumptions about a back-reference as to SIMPLE
                or HAS_WIDTH.  For example (^|<) is neither simple nor has
                width.  So we don't flip bits in flag_param here. */
 
-            Reg_Parse++; 
+            cs->reg_parse++; 
             /* Back-references always have an unknown length */
 	    range_param->lower = -1;
 	    range_param->upper = -1;
 	    break;
          }
 
-         if (strlen (Error_Text) > 0) REG_FAIL (Error_Text);
+         if (strlen (cs->error_text) > 0) REG_FAIL (cs->error_text);
 
          /* At this point it is apparent that the escaped character is not a
             shortcut escape or back-reference.  Back up one character to allow
@@ -1859,75 +2370,75 @@ static unsigned char * atom (int *flag_param, len_range *range_param) {
             escapes. */
 
       default:
-         Reg_Parse--; /* If we fell through from the above code, we are now
+         cs->reg_parse--; /* If we fell through from the above code, we are now
                          pointing at the back slash (\) character. */
          {
             unsigned char *parse_save;
                      int   len = 0;
 
-            if (Is_Case_Insensitive) {
-               ret_val = emit_node (SIMILAR);
+            if (cs->is_case_insensitive) {
+               ret_val = emit_node (cs, SIMILAR);
             } else {
-               ret_val = emit_node (EXACTLY);
+               ret_val = emit_node (cs, EXACTLY);
             }
 
             /* Loop until we find a meta character, shortcut escape, back
                reference, or end of regex string. */
 
-            for (; *Reg_Parse != '\0' &&
-                   !strchr ((char *) Meta_Char, (int) *Reg_Parse);
+            for (; *cs->reg_parse != '\0' &&
+                   !strchr ((char *) cs->meta_char, (int) *cs->reg_parse);
                  len++) {
 
                /* Save where we are in case we have to back
                   this character out. */
 
-               parse_save = Reg_Parse;
+               parse_save = cs->reg_parse;
 
-               if (*Reg_Parse == '\\') {
-                  Reg_Parse++; /* Point to escaped character */
+               if (*cs->reg_parse == '\\') {
+                  cs->reg_parse++; /* Point to escaped character */
 
-                  Error_Text [0] = '\0';  /* See comment above. */
+                  cs->error_text [0] = '\0'; /* See comment above. */
 
-                  if ((test = numeric_escape (*Reg_Parse, &Reg_Parse))) {
-                     if (Is_Case_Insensitive) {
-                        emit_byte (tolower (test));
+                  if ((test = numeric_escape (cs->error_text, *cs->reg_parse, &cs->reg_parse))) {
+                     if (cs->is_case_insensitive) {
+                        emit_byte (cs, tolower (test));
                      } else {
-                        emit_byte (test);
+                        emit_byte (cs, test);
                      }
-                  } else if ((test = literal_escape (*Reg_Parse))) {
-                     emit_byte (test);
-                  } else if (back_ref (Reg_Parse, NULL, CHECK_ESCAPE)) {
+                  } else if ((test = literal_escape (*cs->reg_parse))) {
+                     emit_byte (cs, test);
+                  } else if (back_ref (cs, cs->reg_parse, NULL, CHECK_ESCAPE)) {
                      /* Leave back reference for next `atom' call */
 
-                     Reg_Parse--; break;
-                  } else if (shortcut_escape (*Reg_Parse, NULL, CHECK_ESCAPE)) {
+                     cs->reg_parse--; break;
+                  } else if (shortcut_escape (cs, *cs->reg_parse, NULL, CHECK_ESCAPE)) {
                      /* Leave shortcut escape for next `atom' call */
 
-                     Reg_Parse--; break;
+                     cs->reg_parse--; break;
                   } else {
-                     if (strlen (Error_Text) == 0) {
+                     if (strlen (cs->error_text) == 0) {
                         /* None of the above calls generated an error message
                            so generate our own here. */
 
-                        sprintf (Error_Text,
+                        sprintf (cs->error_text,
                                  "\\%c is an invalid escape sequence",
-                                 *Reg_Parse);
+                                 *cs->reg_parse);
                      }
 
-                     REG_FAIL (Error_Text);
+                     REG_FAIL (cs->error_text);
                   }
 
-                  Reg_Parse++;
+                  cs->reg_parse++;
                } else {
                   /* Ordinary character */
 
-                  if (Is_Case_Insensitive) {
-                     emit_byte (tolower (*Reg_Parse));
+                  if (cs->is_case_insensitive) {
+                     emit_byte (cs, tolower (*cs->reg_parse));
                   } else {
-                     emit_byte (*Reg_Parse);
+                     emit_byte (cs, *cs->reg_parse);
                   }
 
-                  Reg_Parse++;
+                  cs->reg_parse++;
                }
 
                /* If next regex token is a quantifier (?, +. *, or {m,n}) and
@@ -1937,13 +2448,13 @@ static unsigned char * atom (int *flag_param, len_range *range_param) {
                   have an EXACTLY node with an 'abc' operand followed by a STAR
                   node followed by another EXACTLY node with a 'd' operand. */
 
-               if (IS_QUANTIFIER (*Reg_Parse) && len > 0) {
-                  Reg_Parse = parse_save; /* Point to previous regex token. */
+               if (IS_QUANTIFIER (*cs->reg_parse) && len > 0) {
+                  cs->reg_parse = parse_save; /* Point to previous regex token. */
 
-                  if (Code_Emit_Ptr == &Compute_Size) {
-                     Reg_Size--;
+                  if (cs->code_emit_ptr == &Compute_Size) {
+                     cs->reg_size--;
                   } else {
-                     Code_Emit_Ptr--; /* Write over previously emitted byte. */
+                     cs->code_emit_ptr--; /* Write over previously emitted byte. */
                   }
 
                   break;
@@ -1959,9 +2470,9 @@ static unsigned char * atom (int *flag_param, len_range *range_param) {
 	    range_param->lower = len;
 	    range_param->upper = len;
 
-            emit_byte ('\0');
+            emit_byte (cs, '\0');
          }
-      } /* END switch (*Reg_Parse++) */
+      } /* END switch (*cs->reg_parse++) */
 
    return (ret_val);
 }
@@ -1976,22 +2487,22 @@ static unsigned char * atom (int *flag_param, len_range *range_param) {
  * Returns a pointer to the START of the emitted node.
  *----------------------------------------------------------------------*/
 
-static unsigned char * emit_node (int op_code) {
+static unsigned char * emit_node (compile_state *cs, int op_code) {
 
    register unsigned char *ret_val;
    register unsigned char *ptr;
 
-   ret_val = Code_Emit_Ptr; /* Return address of start of node */
+   ret_val = cs->code_emit_ptr; /* Return address of start of node */
 
    if (ret_val == &Compute_Size) {
-      Reg_Size += NODE_SIZE;
+      cs->reg_size += NODE_SIZE;
    } else {
        ptr   = ret_val;
       *ptr++ = (unsigned char) op_code;
       *ptr++ = '\0'; /* Null "NEXT" pointer. */
       *ptr++ = '\0';
 
-      Code_Emit_Ptr = ptr;
+      cs->code_emit_ptr = ptr;
    }
 
    return (ret_val);
@@ -2003,12 +2514,12 @@ static unsigned char * emit_node (int op_code) {
  * Emit (if appropriate) a byte of code (usually part of an operand.)
  *----------------------------------------------------------------------*/
 
-static void emit_byte (unsigned char c) {
+static void emit_byte (compile_state *cs, unsigned char c) {
 
-   if (Code_Emit_Ptr == &Compute_Size) {
-      Reg_Size++;
+   if (cs->code_emit_ptr == &Compute_Size) {
+      cs->reg_size++;
    } else {
-      *Code_Emit_Ptr++ = c;
+      *cs->code_emit_ptr++ = c;
    }
 }
 
@@ -2019,20 +2530,20 @@ static void emit_byte (unsigned char c) {
  * class operand.)
  *----------------------------------------------------------------------*/
 
-static void emit_class_byte (unsigned char c) {
+static void emit_class_byte (compile_state *cs, unsigned char c) {
 
-   if (Code_Emit_Ptr == &Compute_Size) {
-      Reg_Size++;
+   if (cs->code_emit_ptr == &Compute_Size) {
+      cs->reg_size++;
 
-      if (Is_Case_Insensitive && isalpha (c)) Reg_Size++;
-   } else if (Is_Case_Insensitive && isalpha (c)) {
+      if (cs->is_case_insensitive && isalpha (c)) cs->reg_size++;
+   } else if (cs->is_case_insensitive && isalpha (c)) {
       /* For case insensitive character classes, emit both upper and lower case
          versions of alphabetical characters. */
 
-      *Code_Emit_Ptr++ = tolower (c);
-      *Code_Emit_Ptr++ = toupper (c);
+      *cs->code_emit_ptr++ = tolower (c);
+      *cs->code_emit_ptr++ = toupper (c);
    } else {
-      *Code_Emit_Ptr++ = c;
+      *cs->code_emit_ptr++ = c;
    }
 }
 
@@ -2043,6 +2554,7 @@ static void emit_class_byte (unsigned char c) {
  *----------------------------------------------------------------------*/
 
 static unsigned char * emit_special (
+   compile_state *cs,
    unsigned char op_code,
    unsigned long test_val,
             int  index) {
@@ -2050,26 +2562,26 @@ static unsigned char * emit_special (
    register unsigned char *ret_val = &Compute_Size;
    register unsigned char *ptr;
 
-   if (Code_Emit_Ptr == &Compute_Size) {
+   if (cs->code_emit_ptr == &Compute_Size) {
       switch (op_code) {
 	 case POS_BEHIND_OPEN:
 	 case NEG_BEHIND_OPEN:
-	    Reg_Size += LENGTH_SIZE;   /* Length of the look-behind match */
-	    Reg_Size += NODE_SIZE;     /* Make room for the node */
+	    cs->reg_size += LENGTH_SIZE; /* Length of the look-behind match */
+	    cs->reg_size += NODE_SIZE; /* Make room for the node */
 	    break;
 	    
          case TEST_COUNT:
-            Reg_Size += NEXT_PTR_SIZE; /* Make room for a test value. */
+            cs->reg_size += NEXT_PTR_SIZE; /* Make room for a test value. */
 
          case INC_COUNT:
-            Reg_Size += INDEX_SIZE;    /* Make room for an index value. */
+            cs->reg_size += INDEX_SIZE; /* Make room for an index value. */
 
          default:
-            Reg_Size += NODE_SIZE;     /* Make room for the node. */
+            cs->reg_size += NODE_SIZE; /* Make room for the node. */
       }
    } else {
-      ret_val = emit_node (op_code); /* Return the address for start of node. */
-      ptr     = Code_Emit_Ptr;
+      ret_val = emit_node (cs, op_code); /* Return the address for start of node. */
+      ptr     = cs->code_emit_ptr;
 
       if (op_code == INC_COUNT || op_code == TEST_COUNT) {
          *ptr++ = (unsigned char) index;
@@ -2085,7 +2597,7 @@ static unsigned char * emit_special (
          *ptr++ = PUT_OFFSET_R (test_val);
       }
 
-      Code_Emit_Ptr = ptr;
+      cs->code_emit_ptr = ptr;
    }
 
    return (ret_val);
@@ -2095,12 +2607,13 @@ static unsigned char * emit_special (
  * insert
  *
  * Insert a node in front of already emitted node(s).  Means relocating
- * the operand.  Code_Emit_Ptr points one byte past the just emitted
+ * the operand.  cs->code_emit_ptr points one byte past the just emitted
  * node and operand.  The parameter `insert_pos' points to the location
  * where the new node is to be inserted.
  *----------------------------------------------------------------------*/
 
 static unsigned char * insert (
+   compile_state *cs,
    unsigned char  op,
    unsigned char *insert_pos,
    long           min,
@@ -2122,14 +2635,14 @@ static unsigned char * insert (
       insert_size += INDEX_SIZE;
    }
 
-   if (Code_Emit_Ptr == &Compute_Size) {
-      Reg_Size += insert_size;
+   if (cs->code_emit_ptr == &Compute_Size) {
+      cs->reg_size += insert_size;
       return &Compute_Size;
    }
 
-   src            = Code_Emit_Ptr;
-   Code_Emit_Ptr += insert_size;
-   dst            = Code_Emit_Ptr;
+   src            = cs->code_emit_ptr;
+   cs->code_emit_ptr += insert_size;
+   dst            = cs->code_emit_ptr;
 
    /* Relocate the existing emitted code to make room for the new node. */
 
@@ -2258,6 +2771,7 @@ static void branch_tail (unsigned char *ptr, int offset, unsigned char *val) {
  *--------------------------------------------------------------------*/
 
 static unsigned char * shortcut_escape (
+   compile_state *cs,
    unsigned char  c,
    int           *flag_param,
    int            emit) {
@@ -2285,8 +2799,8 @@ static unsigned char * shortcut_escape (
          if (emit == EMIT_CLASS_BYTES) {
             class = ASCII_Digits;
          } else if (emit == EMIT_NODE) {
-            ret_val = (islower (c) ? emit_node (DIGIT)
-                                   : emit_node (NOT_DIGIT));
+            ret_val = (islower (c) ? emit_node (cs, DIGIT)
+                                   : emit_node (cs, NOT_DIGIT));
          }
 
          break;
@@ -2296,8 +2810,8 @@ static unsigned char * shortcut_escape (
          if (emit == EMIT_CLASS_BYTES) {
             class = Letter_Char;
          } else if (emit == EMIT_NODE) {
-            ret_val = (islower (c) ? emit_node (LETTER)
-                                   : emit_node (NOT_LETTER));
+            ret_val = (islower (c) ? emit_node (cs, LETTER)
+                                   : emit_node (cs, NOT_LETTER));
          }
 
          break;
@@ -2305,16 +2819,16 @@ static unsigned char * shortcut_escape (
       case 's':
       case 'S':
          if (emit == EMIT_CLASS_BYTES) {
-            if (Match_Newline) emit_byte ('\n');
+            if (cs->match_newline) emit_byte (cs, '\n');
 
             class = White_Space;
          } else if (emit == EMIT_NODE) {
-            if (Match_Newline) {
-               ret_val = (islower (c) ? emit_node (SPACE_NL)
-                                      : emit_node (NOT_SPACE_NL));
+            if (cs->match_newline) {
+               ret_val = (islower (c) ? emit_node (cs, SPACE_NL)
+                                      : emit_node (cs, NOT_SPACE_NL));
             } else {
-               ret_val = (islower (c) ? emit_node (SPACE)
-                                      : emit_node (NOT_SPACE));
+               ret_val = (islower (c) ? emit_node (cs, SPACE)
+                                      : emit_node (cs, NOT_SPACE));
             }
          }
 
@@ -2325,8 +2839,8 @@ static unsigned char * shortcut_escape (
          if (emit == EMIT_CLASS_BYTES) {
             class = Word_Char;
          } else if (emit == EMIT_NODE) {
-            ret_val = (islower (c) ? emit_node (WORD_CHAR)
-                                   : emit_node (NOT_WORD_CHAR));
+            ret_val = (islower (c) ? emit_node (cs, WORD_CHAR)
+                                   : emit_node (cs, NOT_WORD_CHAR));
          }
 
          break;
@@ -2338,7 +2852,7 @@ static unsigned char * shortcut_escape (
       case 'y':
 
          if (emit == EMIT_NODE) {
-            ret_val = emit_node (IS_DELIM);
+            ret_val = emit_node (cs, IS_DELIM);
          } else {
             REG_FAIL ("internal error #5 `shortcut_escape\'");
          }
@@ -2348,7 +2862,7 @@ static unsigned char * shortcut_escape (
       case 'Y':
 
          if (emit == EMIT_NODE) {
-            ret_val = emit_node (NOT_DELIM);
+            ret_val = emit_node (cs, NOT_DELIM);
          } else {
             REG_FAIL ("internal error #6 `shortcut_escape\'");
          }
@@ -2358,7 +2872,7 @@ static unsigned char * shortcut_escape (
       case 'B':
 
          if (emit == EMIT_NODE) {
-            ret_val = emit_node (NOT_BOUNDARY);
+            ret_val = emit_node (cs, NOT_BOUNDARY);
          } else {
             REG_FAIL ("internal error #7 `shortcut_escape\'");
          }
@@ -2380,7 +2894,7 @@ static unsigned char * shortcut_escape (
       /* Emit bytes within a character class operand. */
 
       while (*class != '\0') {
-         emit_byte (*class++);
+         emit_byte (cs, *class++);
       }
    }
 
@@ -2398,10 +2912,12 @@ static unsigned char * shortcut_escape (
  *
  * Returns the actual character value or NULL if not a valid hex or
  * octal escape.  REG_FAIL is called if \x0, \x00, \0, \00, \000, or
- * \0000 is specified.
+ * \0000 is specified.  The message is built in `error_text' if it is not
+ * NULL.
  *--------------------------------------------------------------------*/
 
 static unsigned char numeric_escape (
+   char            *error_text,
    unsigned char    c,
    unsigned char  **parse) {
 
@@ -2472,10 +2988,12 @@ static unsigned char numeric_escape (
    /* Handle the case of "\0" i.e. trying to specify a NULL character. */
 
    if (value == 0) {
-      if (c == '0') {
-         sprintf (Error_Text, "\\00 is an invalid octal escape");
+      if (error_text == NULL) {
+         /* Nowhere to report it (called from `SubstituteRE'). */
+      } else if (c == '0') {
+         sprintf (error_text, "\\00 is an invalid octal escape");
       } else {
-         sprintf (Error_Text, "\\%c0 is an invalid hexadecimal escape", c);
+         sprintf (error_text, "\\%c0 is an invalid hexadecimal escape", c);
       }
    } else {
       /* Point to the last character of the number on success. */
@@ -2543,6 +3061,7 @@ static unsigned char literal_escape (unsigned char c) {
  *--------------------------------------------------------------------*/
 
 static unsigned char * back_ref (
+   compile_state *cs,
    unsigned char *c,
    int           *flag_param,
    int            emit) {
@@ -2568,32 +3087,32 @@ static unsigned char * back_ref (
 
    /* Make sure parentheses for requested back-reference are complete. */
 
-   if (!is_cross_regex && !TEST_BIT (Closed_Parens, paren_no)) {
-      sprintf (Error_Text, "\\%d is an illegal back reference", paren_no);
+   if (!is_cross_regex && !TEST_BIT (cs->closed_parens, paren_no)) {
+      sprintf (cs->error_text, "\\%d is an illegal back reference", paren_no);
       return NULL;
    }
 
    if (emit == EMIT_NODE) {
       if (is_cross_regex) {
-         Reg_Parse++; /* Skip past the '~' in a cross regex back reference.
+         cs->reg_parse++; /* Skip past the '~' in a cross regex back reference.
                          We only do this if we are emitting code. */
 
-         if (Is_Case_Insensitive) {
-            ret_val = emit_node (X_REGEX_BR_CI);
+         if (cs->is_case_insensitive) {
+            ret_val = emit_node (cs, X_REGEX_BR_CI);
          } else {
-            ret_val = emit_node (X_REGEX_BR);
+            ret_val = emit_node (cs, X_REGEX_BR);
          }
       } else {
-         if (Is_Case_Insensitive) {
-            ret_val = emit_node (BACK_REF_CI);
+         if (cs->is_case_insensitive) {
+            ret_val = emit_node (cs, BACK_REF_CI);
          } else {
-            ret_val = emit_node (BACK_REF);
+            ret_val = emit_node (cs, BACK_REF);
          }
       }
 
-      emit_byte ((unsigned char) paren_no);
+      emit_byte (cs, (unsigned char) paren_no);
 
-      if (is_cross_regex || TEST_BIT (Paren_Has_Width, paren_no)) {
+      if (is_cross_regex || TEST_BIT (cs->paren_has_width, paren_no)) {
          *flag_param |= HAS_WIDTH;
       }
    } else if (emit == CHECK_ESCAPE) {
@@ -2609,25 +3128,8 @@ static unsigned char * back_ref (
  *  Regex execution related code
  *======================================================================*/
 
- /* Global work variables for `ExecRE'. */
-
-static unsigned char  *Reg_Input;           /* String-input pointer.         */
-static unsigned char  *Start_Of_String;     /* Beginning of input, for ^     */
-                                            /* and < checks.                 */
-static unsigned char  *End_Of_String;       /* Logical end of input (if
-   				               supplied, till \0 otherwise)  */
-static unsigned char  *Look_Behind_To;      /* Position till were look behind
-                                               can safely check back         */
-static unsigned char **Start_Ptr_Ptr;       /* Pointer to `startp' array.    */
-static unsigned char **End_Ptr_Ptr;         /* Ditto for `endp'.             */
-static unsigned char  *Extent_Ptr_FW;       /* Forward extent pointer        */
-static unsigned char  *Extent_Ptr_BW;       /* Backward extent pointer       */
-static unsigned char  *Back_Ref_Start [10]; /* Back_Ref_Start [0] and        */
-static unsigned char  *Back_Ref_End   [10]; /* Back_Ref_End [0] are not      */
-                                            /* used. This simplifies         */
-                                            /* indexing.                     */
 /*
- * Measured recursion limits:
+ * Recursion limit for `match'.  Measured recursion limits:
  *    Linux:      +/-  40 000 (up to 110 000)
  *    Solaris:    +/-  85 000
  *    HP-UX 11:   +/- 325 000 
@@ -2635,18 +3137,9 @@ static unsigned char  *Back_Ref_End   [10]; /* Back_Ref_End [0] are not      */
  * So 10 000 ought to be safe.
  */
 #define REGEX_RECURSION_LIMIT 10000
-static int Recursion_Count;          /* Recursion counter */
-static int Recursion_Limit_Exceeded; /* Recursion limit exceeded flag */
 
-#define AT_END_OF_STRING(X) (*(X) == (unsigned char)'\0' ||\
-                             (End_Of_String != NULL && (X) >= End_Of_String))
-
-/* static regexp *Cross_Regex_Backref; */
-
-static int Prev_Is_BOL;
-static int Succ_Is_EOL;
-static int Prev_Is_Delim;
-static int Succ_Is_Delim;
+/* Amount of text looked at at a time by `prefiltered_search' */
+#define PREFILTER_BLOCK 65536
 
 /* Define a pointer to an array to hold general (...){m,n} counts. */
 
@@ -2654,20 +3147,135 @@ typedef struct brace_counts {
     unsigned long count [1]; /* More unwarranted chumminess with compiler. */
 } brace_counts;
 
-static struct brace_counts *Brace;
+/* One way `nfa_search' has of matching the program up to a place in the
+   text, waiting at a node to match the next byte (or at END). */
+
+typedef struct {
+   unsigned char  *node;
+   int             sub;        /* State within the node (see `build_nfa'). */
+   int             top_branch; /* Choice at the top branch, -1 until made. */
+   unsigned char **caps;       /* startp [0], endp [0], startp [1], ...    */
+} nfa_thread;
+
+/* The threads at one place in the text, in the order `match' would try
+   them. */
+
+typedef struct {
+   int         count;
+   nfa_thread *thread;
+} nfa_list;
+
+/* Back tracking is usually the quicker way of matching, but it is given up
+   for `nfa_search' (when the program allows) once it has called `match'
+   more than this many times, plus twice the number of automaton states for
+   each byte the search has moved on, which is about what the automaton
+   would have needed.  (Setting it to 0 when building makes programs the
+   automaton can match go straight to it, for testing.) */
+
+#ifndef NFA_BACKTRACK_STEPS
+#define NFA_BACKTRACK_STEPS 1000
+#endif
+
+/* Work variables for `ExecRE'.  These are kept in a structure on the stack of
+   `ExecRE' and passed down to the routines it calls, rather than in globals,
+   so that different threads can match regular expressions at the same time
+   (each with its own compiled `regexp', which holds the results). */
+
+typedef struct {
+   unsigned char  *reg_input;           /* String-input pointer.         */
+   unsigned char  *start_of_string;     /* Beginning of input, for ^     */
+                                        /* and < checks.                 */
+   unsigned char  *end_of_string;       /* Logical end of input (if
+                                           supplied, till \0 otherwise)  */
+   unsigned char  *look_behind_to;      /* Position till were look behind
+                                           can safely check back         */
+   unsigned char **start_ptr_ptr;       /* Pointer to `startp' array.    */
+   unsigned char **end_ptr_ptr;         /* Ditto for `endp'.             */
+   unsigned char  *extent_ptr_fw;       /* Forward extent pointer        */
+   unsigned char  *extent_ptr_bw;       /* Backward extent pointer       */
+   unsigned char  *back_ref_start [10]; /* back_ref_start [0] and        */
+   unsigned char  *back_ref_end   [10]; /* back_ref_end [0] are not      */
+                                        /* used. This simplifies         */
+                                        /* indexing.                     */
+   int             total_paren;         /* From the compiled program.    */
+   int             num_braces;
+   int             recursion_count;     /* Recursion counter */
+   int             recursion_limit_exceeded; /* Recursion limit exceeded
+                                                flag */
+   int             reverse;             /* Searching backward.           */
+   unsigned long   steps;               /* Calls of `match' so far, and  */
+   unsigned long   step_limit;          /* the most allowed.             */
+   unsigned char  *first_attempt;       /* Where matching was first tried*/
+   unsigned char  *nfa_resume;          /* Forward search to carry on    */
+                                        /* with `nfa_search', or NULL.   */
+   int             nfa_only;            /* Back tracking was given up.   */
+   int             prev_is_bol;
+   int             succ_is_eol;
+   int             prev_is_delim;
+   int             succ_is_delim;
+   brace_counts   *brace;               /* General {m,n} counts.         */
+   unsigned char  *current_delimiters;  /* Current delimiter table       */
+   nfa_list        nfa_lists [2];       /* Work variables for            */
+   unsigned char  *nfa_program;         /* `nfa_search'.                 */
+   unsigned char  *nfa_table;
+   unsigned char  *nfa_top_branch;
+   unsigned char **nfa_caps;            /* Captures of the thread being  */
+   int             nfa_num_caps;        /* added.                        */
+   unsigned int   *nfa_mark;            /* Set to nfa_gen for states in  */
+   unsigned int    nfa_gen;             /* the list being built.         */
+   int             nfa_num_states;
+   void           *nfa_work;            /* Memory holding them, or NULL. */
+   void           *nfa_scratch;         /* Memory for them, kept from    */
+   size_t          nfa_scratch_size;    /* one match to the next by a    */
+                                        /* `regexContext'.               */
+} exec_state;
+
+#define AT_END_OF_STRING(X) (*(X) == (unsigned char)'\0' ||\
+                             (st->end_of_string != NULL &&\
+                              (X) >= st->end_of_string))
 
 /* Default table for determining whether a character is a word delimiter. */
 
 static unsigned char  Default_Delimiters [UCHAR_MAX+1] = {0};
 
-static unsigned char *Current_Delimiters;  /* Current delimiter table */
-
 /* Forward declarations of functions used by `ExecRE' */
 
-static int             attempt            (regexp *, unsigned char *);
-static int             match              (unsigned char *, int *);
-static unsigned long   greedy             (unsigned char *, long);
+static int             attempt            (exec_state *, regexp *,
+                                           unsigned char *);
+static int             match              (exec_state *, unsigned char *,
+                                           int *);
+static unsigned long   greedy             (exec_state *, unsigned char *,
+                                           long);
 static void            adjustcase         (unsigned char *, int, unsigned char);
+static int             prefiltered_search (exec_state *, regexp *,
+                                           unsigned char *, unsigned char *);
+static unsigned char * next_literal       (exec_state *, regexp *,
+                                           unsigned char *);
+static int             at_assertion       (exec_state *, int,
+                                           unsigned char *);
+static int             byte_matches       (exec_state *, unsigned char *,
+                                           unsigned char *);
+static unsigned char * loop_limits        (unsigned char *, unsigned long *,
+                                           unsigned long *);
+static int             nfa_search         (exec_state *, regexp *,
+                                           unsigned char *, unsigned char *,
+                                           int);
+static int             nfa_init           (exec_state *, regexp *);
+static void            nfa_next_gen       (exec_state *);
+static unsigned char * nfa_skip           (exec_state *, regexp *,
+                                           unsigned char *, unsigned char *,
+                                           unsigned char *, unsigned char **);
+static void            nfa_add            (exec_state *, nfa_list *,
+                                           unsigned char *, int,
+                                           unsigned char *, int);
+static void            nfa_push           (exec_state *, nfa_list *,
+                                           unsigned char *, int, int);
+static void            nfa_step           (exec_state *, nfa_list *,
+                                           nfa_thread *, unsigned char *);
+static int             exec_regex         (exec_state *, regexp *,
+                                           const char *, const char *, int,
+                                           char, char, const char *,
+                                           const char *, const char *);
 static unsigned char * makeDelimiterTable (unsigned char *, unsigned char *);
 
 /*
@@ -2699,6 +3307,32 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
         char prev_char, char succ_char, const char* delimiters,
         const char* look_behind_to, const char* match_to)
 {
+   exec_state state;
+   int        ret_val;
+
+   state.nfa_scratch      = NULL;
+   state.nfa_scratch_size = 0;
+
+   ret_val = exec_regex (&state, prog, string, end, reverse, prev_char,
+                         succ_char, delimiters, look_behind_to, match_to);
+
+   free (state.nfa_scratch);
+
+   return (ret_val);
+}
+
+/*----------------------------------------------------------------------*
+ * exec_regex
+ *
+ * Does the work of `ExecRE' and `ExecREContext', using `st' for its work
+ * variables.
+ *----------------------------------------------------------------------*/
+
+static int exec_regex (exec_state *st, regexp *prog, const char *string,
+                       const char *end, int reverse, char prev_char,
+                       char succ_char, const char *delimiters,
+                       const char *look_behind_to, const char *match_to)
+{
 
    register unsigned char  *str;
             unsigned char **s_ptr;
@@ -2707,6 +3341,15 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
             unsigned char   tempDelimitTable [256];
                      int    i;
 
+   st->brace = NULL;
+   st->nfa_work = NULL;
+   st->recursion_limit_exceeded = 0;
+   st->reverse = reverse;
+   st->steps = 0;
+   st->first_attempt = NULL;
+   st->nfa_resume = NULL;
+   st->nfa_only = 0;
+
    /* Check for valid parameters. */
 
    if (prog == NULL || string == NULL) {
@@ -2727,16 +3370,16 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
    /* If caller has supplied delimiters, make a delimiter table */
 
    if (delimiters == NULL) {
-      Current_Delimiters = Default_Delimiters;
+      st->current_delimiters = Default_Delimiters;
    } else {
-      Current_Delimiters = makeDelimiterTable (
+      st->current_delimiters = makeDelimiterTable (
                               (unsigned char *) delimiters,
                               (unsigned char *) tempDelimitTable);
    }
 
    /* Remember the logical end of the string. */
    
-   End_Of_String = (unsigned char *) match_to;
+   st->end_of_string = (unsigned char *) match_to;
    
    if (end == NULL && reverse) {
       for (end = string; !AT_END_OF_STRING((unsigned char*)end); end++) ;
@@ -2751,32 +3394,32 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
 
    /* Remember the beginning of the string for matching BOL */
 
-   Start_Of_String    = (unsigned char *) string;
-   Look_Behind_To     = (unsigned char *) (look_behind_to?look_behind_to:string);
+   st->start_of_string = (unsigned char *) string;
+   st->look_behind_to  = (unsigned char *) (look_behind_to?look_behind_to:string);
 
-   Prev_Is_BOL        = ((prev_char == '\n') || (prev_char == '\0') ? 1 : 0);
-   Succ_Is_EOL        = ((succ_char == '\n') || (succ_char == '\0') ? 1 : 0);
-   Prev_Is_Delim      = (Current_Delimiters [(unsigned char)prev_char] ? 1 : 0);
-   Succ_Is_Delim      = (Current_Delimiters [(unsigned char)succ_char] ? 1 : 0);
+   st->prev_is_bol     = ((prev_char == '\n') || (prev_char == '\0') ? 1 : 0);
+   st->succ_is_eol     = ((succ_char == '\n') || (succ_char == '\0') ? 1 : 0);
+   st->prev_is_delim   = (st->current_delimiters [(unsigned char)prev_char] ? 1 : 0);
+   st->succ_is_delim   = (st->current_delimiters [(unsigned char)succ_char] ? 1 : 0);
 
-   Total_Paren        = (int) (prog->program [1]);
-   Num_Braces         = (int) (prog->program [2]);
+   st->total_paren     = (int) (prog->program [1]);
+   st->num_braces      = (int) (prog->program [2]);
    
    /* Reset the recursion detection flag */
-   Recursion_Limit_Exceeded = 0;
+   st->recursion_limit_exceeded = 0;
 
    /* Allocate memory for {m,n} construct counting variables if need be. */
 
-   if (Num_Braces > 0) {
-      Brace =
-         (brace_counts *) malloc (sizeof (brace_counts) * (size_t) Num_Braces);
+   if (st->num_braces > 0) {
+      st->brace = (brace_counts *) malloc (
+                     sizeof (brace_counts) * (size_t) st->num_braces);
 
-      if (Brace == NULL) {
+      if (st->brace == NULL) {
          reg_error ("out of memory in `ExecRE\'");
          goto SINGLE_RETURN;
       }
    } else {
-      Brace = NULL;
+      st->brace = NULL;
    }
 
    /* Initialize the first nine (9) capturing parentheses start and end
@@ -2794,17 +3437,17 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
       if (prog->anchor) {
          /* Search is anchored at BOL */
 
-         if (attempt (prog, (unsigned char *) string)) {
+         if (attempt (st, prog, (unsigned char *) string)) {
             ret_val = 1;
             goto SINGLE_RETURN;
          }
 
          for (str = (unsigned char *) string;
-             !AT_END_OF_STRING(str) && str != (unsigned char *) end && !Recursion_Limit_Exceeded;
+             !AT_END_OF_STRING(str) && str != (unsigned char *) end && !st->recursion_limit_exceeded;
               str++) {
 
             if (*str == '\n') {
-               if (attempt (prog, str + 1)) {
+               if (attempt (st, prog, str + 1)) {
                   ret_val = 1;
                   break;
                }
@@ -2813,15 +3456,23 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
 
          goto SINGLE_RETURN;
 
+      } else if (prog->literal_len > 0 || prog->use_first_chars) {
+         /* We know something about where a match can be. */
+
+         ret_val = prefiltered_search (st, prog, (unsigned char *) string,
+                                       (unsigned char *) end);
+
+         goto SINGLE_RETURN;
+
       } else if (prog->match_start != '\0') {
          /* We know what char match must start with. */
 
          for (str = (unsigned char *) string;
-             !AT_END_OF_STRING(str) && str != (unsigned char *) end && !Recursion_Limit_Exceeded;
+             !AT_END_OF_STRING(str) && str != (unsigned char *) end && !st->recursion_limit_exceeded;
               str++) {
 
             if (*str == (unsigned char)prog->match_start) {
-               if (attempt (prog, str)) {
+               if (attempt (st, prog, str)) {
                   ret_val = 1;
                   break;
                }
@@ -2833,18 +3484,18 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
          /* General case */
 
          for (str = (unsigned char *) string;
-             !AT_END_OF_STRING(str) && str != (unsigned char *) end && !Recursion_Limit_Exceeded;
+             !AT_END_OF_STRING(str) && str != (unsigned char *) end && !st->recursion_limit_exceeded;
               str++) {
 
-            if (attempt (prog, str)) {
+            if (attempt (st, prog, str)) {
                ret_val = 1;
                break;
             }
          }
          
          /* Beware of a single $ matching \0 */
-         if (!Recursion_Limit_Exceeded && !ret_val && AT_END_OF_STRING(str) && str != (unsigned char *) end) {
-            if (attempt (prog, str)) {
+         if (!st->recursion_limit_exceeded && !ret_val && AT_END_OF_STRING(str) && str != (unsigned char *) end) {
+            if (attempt (st, prog, str)) {
                ret_val = 1;
             }
          }
@@ -2854,26 +3505,26 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
    } else { /* Search reverse, same as forward, but loops run backward */
       
       /* Make sure that we don't start matching beyond the logical end */
-      if (End_Of_String != NULL && (unsigned char*)end > End_Of_String) {
-         end = (const char*)End_Of_String;
+      if (st->end_of_string != NULL && (unsigned char*)end > st->end_of_string) {
+         end = (const char*)st->end_of_string;
       }
 
       if (prog->anchor) {
          /* Search is anchored at BOL */
 
          for (str = (unsigned char *)(end - 1);
-              str >= (unsigned char *) string && !Recursion_Limit_Exceeded;
+              str >= (unsigned char *) string && !st->recursion_limit_exceeded;
               str--) {
 
             if (*str == '\n') {
-               if (attempt (prog, str + 1)) {
+               if (attempt (st, prog, str + 1)) {
                   ret_val = 1;
                   goto SINGLE_RETURN;
                }
             }
          }
 
-         if (!Recursion_Limit_Exceeded && attempt (prog, (unsigned char *) string)) {
+         if (!st->recursion_limit_exceeded && attempt (st, prog, (unsigned char *) string)) {
             ret_val = 1;
             goto SINGLE_RETURN;
          }
@@ -2883,11 +3534,11 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
          /* We know what char match must start with. */
 
          for (str =  (unsigned char *) end;
-              str >= (unsigned char *) string && !Recursion_Limit_Exceeded;
+              str >= (unsigned char *) string && !st->recursion_limit_exceeded;
               str--) {
 
             if (*str == (unsigned char)prog->match_start) {
-               if (attempt (prog, str)) {
+               if (attempt (st, prog, str)) {
                   ret_val = 1;
                   break;
                }
@@ -2899,10 +3550,14 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
          /* General case */
 
          for (str =  (unsigned char *) end;
-              str >= (unsigned char *) string && !Recursion_Limit_Exceeded;
+              str >= (unsigned char *) string && !st->recursion_limit_exceeded;
               str--) {
 
-            if (attempt (prog, str)) {
+            if (prog->use_first_chars && !prog->first_chars.member [*str]) {
+               continue;
+            }
+
+            if (attempt (st, prog, str)) {
                ret_val = 1;
                break;
             }
@@ -2910,108 +3565,945 @@ int ExecRE(regexp *prog, const char* string, const char* end, int reverse,
       }
    }
 
-   SINGLE_RETURN: if (Brace) free (Brace);
+   SINGLE_RETURN:
+
+   if (st->nfa_resume != NULL) {
+      /* Back tracking was given up at `nfa_resume' (see `attempt'), and no
+         match starts before it. */
+
+      st->recursion_limit_exceeded = 0;
+
+      ret_val = nfa_search (st, prog, st->nfa_resume, (unsigned char *) end, 0);
+   }
+
+   if (st->brace) free (st->brace);
 
-   if (Recursion_Limit_Exceeded) return (0);
+   if (st->recursion_limit_exceeded) return (0);
 
    return (ret_val);
 }
 
-/*--------------------------------------------------------------------*
- * init_ansi_classes
- *
- * Generate character class sets using locale aware ANSI C functions.
+/*----------------------------------------------------------------------*
+ * prefiltered_search
  *
- *--------------------------------------------------------------------*/
+ * Forward search for `ExecRE', trying only the starting points which
+ * could lead to a match, according to the literal string every match
+ * contains (see `find_literal') and the characters a match can start
+ * with (see `find_first_chars').  The text is looked at a block at a time
+ * when its length isn't known, so that a nearby match is found without
+ * first finding the end of the text.
+ *----------------------------------------------------------------------*/
 
-static int init_ansi_classes (void) {
+static int prefiltered_search (exec_state *st, regexp *prog,
+                               unsigned char *str, unsigned char *end) {
 
-   static int initialized = 0;
-   static int underscore = (int) '_';
-          int i, word_count, letter_count, space_count;
+   unsigned char *found, *cand, *last = NULL;
+   size_t         want, n;
 
-   if (!initialized) {
-      initialized  = 1; /* Only need to generate character sets once. */
-      word_count   = 0;
-      letter_count = 0;
-      space_count  = 0;
+   while (!st->recursion_limit_exceeded) {
+      /* A match starting after `last' would need a later occurrence of the
+         literal, and one can't start more than literal_max before it. */
 
-      for (i = 1; i < (int)UCHAR_MAX; i++) {
-         if (isalnum (i) || i == underscore) {
-            Word_Char [word_count++] = (unsigned char) i;
-         }
+      if (prog->literal_len > 0 && (last == NULL || str > last)) {
+         found = next_literal (st, prog, str);
 
-         if (isalpha (i)) {
-            Letter_Char [letter_count++] = (unsigned char) i;
-         }
+         if (found == NULL) return (0);
 
-         /* Note: Whether or not newline is considered to be whitespace is
-            handled by switches within the original regex and is thus omitted
-            here. */
+         last = found - prog->literal_min;
 
-         if (isspace (i) && (i != (int) '\n')) {
-            White_Space [space_count++] = (unsigned char) i;
+         if (prog->literal_max >= 0 && found - prog->literal_max > str) {
+            str = found - prog->literal_max;
          }
+      }
+
+      want = PREFILTER_BLOCK;
+
+      if (last != NULL && (size_t) (last + 1 - str) < want) {
+         want = last + 1 - str;
+      }
 
-         /* Make sure arrays are big enough.  ("- 2" because of zero array
-            origin and we need to leave room for the NULL terminator.) */
+      if (end != NULL) {
+         if (end <= str) return (0);
+         if ((size_t) (end - str) < want) want = end - str;
+      }
+
+      if (st->end_of_string != NULL) {
+         if (st->end_of_string <= str) return (0);
+         if ((size_t) (st->end_of_string - str) < want) {
+            want = st->end_of_string - str;
+         }
+      }
 
-         if (word_count   > (ALNUM_CHAR_SIZE  - 2) ||
-             space_count  > (WHITE_SPACE_SIZE - 2) ||
-             letter_count > (ALNUM_CHAR_SIZE  - 2)) {
+      n = strnlen ((char *) str, want);
 
-            reg_error ("internal error #9 `init_ansi_classes\'");
-            return (0);
+      for (cand = str; cand < str + n; cand++) {
+         if (prog->use_first_chars) {
+            cand = (unsigned char *) ScanFindCharSet ((char *) cand,
+                                                      str + n - cand,
+                                                      &prog->first_chars);
+            if (cand == NULL) break;
          }
+
+         if (attempt (st, prog, cand)) return (1);
+
+         if (st->recursion_limit_exceeded) return (0);
       }
 
-      Word_Char   [word_count]  = '\0';
-      Letter_Char [word_count]  = '\0';
-      White_Space [space_count] = '\0';
+      if (n < want) return (0); /* End of the text. */
+
+      str += n;
    }
 
-   return (1);
+   return (0);
 }
 
 /*----------------------------------------------------------------------*
- * attempt - try match at specific point, returns: 0 failure, 1 success
+ * next_literal
+ *
+ * Find the first occurrence of `prog's literal string which a match
+ * starting at or after `str' could contain.
  *----------------------------------------------------------------------*/
 
-static int attempt (regexp *prog, unsigned char *string) {
+static unsigned char * next_literal (exec_state *st, regexp *prog,
+                                     unsigned char *str) {
 
-   register          int    i;
-   register unsigned char **s_ptr;
-   register unsigned char **e_ptr;
-   		     int    branch_index = 0; /* Must be set to zero ! */
+   char          *literal = prog->program + prog->literal;
+   int            len     = prog->literal_len;
+   unsigned char *from, *found;
 
-   Reg_Input      = string;
-   Start_Ptr_Ptr  = (unsigned char **) prog->startp;
-   End_Ptr_Ptr    = (unsigned char **) prog->endp;
-   s_ptr          = (unsigned char **) prog->startp;
-   e_ptr          = (unsigned char **) prog->endp;
+   if (st->end_of_string == NULL) {
+      for (found = (unsigned char *) strstr ((char *) str, literal);
+           found != NULL && found < str + prog->literal_min;
+           found = (unsigned char *) strstr ((char *) found + 1, literal)) ;
 
-   /* Reset the recursion counter. */
-   Recursion_Count = 0;
+      return (found);
+   }
+
+   if (st->end_of_string - str < prog->literal_min + len) return (NULL);
+
+   for (from = str + prog->literal_min;
+        (found = memchr (from, *literal, st->end_of_string - len + 1 - from))
+           != NULL;
+        from = found + 1) {
+
+      if (memcmp (found, literal, len) == 0) return (found);
+   }
+
+   return (NULL);
+}
+
+/*----------------------------------------------------------------------*
+ * nfa_search
+ *
+ * Match a program without back tracking, by following all the ways of
+ * matching it at once, a byte of the text at a time (a Thompson NFA
+ * simulation which keeps captures, as in Pike's VM).  The ways are kept
+ * in the order `match' would try them, and the first of them to reach
+ * the end wins, so the match and its captures are the ones `match'
+ * would find, in time proportional to the length of the text and
+ * without a recursion limit.
+ *
+ * Searches forward from `str' as `exec_regex' does with `attempt', or
+ * if `single' is set, only tries a match starting at `str', for
+ * `attempt'.
+ *----------------------------------------------------------------------*/
+
+static int nfa_search (exec_state *st, regexp *prog, unsigned char *str,
+                       unsigned char *end, int single) {
+
+   register unsigned char *p;
+            unsigned char *last = NULL;
+            nfa_list      *clist, *nlist, *list;
+            nfa_thread    *t;
+            int            i, no, start, done = 0, matched = 0;
+
+   if (!nfa_init (st, prog)) return (0);
+
+   clist = &st->nfa_lists [0];
+   nlist = &st->nfa_lists [1];
+   clist->count = 0;
+   nfa_next_gen (st);
+
+   for (p = str; ; p++) {
+      if (!matched && !done) {
+         if (single) {
+            start = 1;
+            done  = 1;
+         } else {
+            /* Skip to where a match could start if there's nothing to
+               carry on with. */
+
+            if (clist->count == 0) {
+               p = nfa_skip (st, prog, p, end, str, &last);
+
+               if (p == NULL) break;
+
+               nfa_next_gen (st); /* States marked at another place. */
+            }
+
+            done = AT_END_OF_STRING(p) || p == end;
+
+            if (prog->anchor) {
+               start = p == str || *(p - 1) == '\n';
+            } else {
+               start = p != end && (!prog->use_first_chars ||
+                                    prog->first_chars.member [*p]);
+            }
+         }
+
+         /* A match starting here comes after the ones started earlier. */
+
+         if (start) {
+            for (i = 0; i < st->nfa_num_caps; i++) st->nfa_caps [i] = NULL;
+
+            st->nfa_caps [0] = p;
+
+            nfa_add (st, clist, st->nfa_program + REGEX_START_OFFSET, 0, p, -1);
+         }
+      }
+
+      if (clist->count == 0) {
+         if (matched || done) break;
+
+         nfa_next_gen (st);
+         continue;
+      }
+
+      /* Move each thread past the byte at `p'.  A thread at END is a
+         match, which only the threads before it could better. */
+
+      nfa_next_gen (st);
+      nlist->count = 0;
+
+      for (i = 0; i < clist->count; i++) {
+         t = &clist->thread [i];
+
+         if (GET_OP_CODE (t->node) == END) {
+            for (no = 0; no <= st->total_paren; no++) {
+               prog->startp [no] = (char *) t->caps [2 * no];
+               prog->endp   [no] = (char *) t->caps [2 * no + 1];
+            }
+
+            prog->endp [0]   = (char *) p;
+            prog->extentpBW  = (char *) t->caps [0];
+            prog->extentpFW  = (char *) p;
+            prog->top_branch = (t->top_branch < 0) ? 0 : t->top_branch;
+
+            matched = 1;
+            break;
+         }
+
+         if (*p != '\0') nfa_step (st, nlist, t, p);
+      }
+
+      list  = clist;
+      clist = nlist;
+      nlist = list;
+   }
+
+   if (!matched) {
+      for (i = 0; i <= st->total_paren; i++) {
+         prog->startp [i] = NULL;
+         prog->endp   [i] = NULL;
+      }
+   }
+
+   return (matched);
+}
+
+/*----------------------------------------------------------------------*
+ * nfa_init
+ *
+ * Set up the work variables of `nfa_search', if an earlier call in the
+ * same `exec_regex' hasn't.
+ *----------------------------------------------------------------------*/
+
+static int nfa_init (exec_state *st, regexp *prog) {
+
+   unsigned char **caps;
+   nfa_thread     *thread;
+   size_t          states = (size_t) prog->nfa_states;
+   size_t          num_caps, size, i;
+
+   if (st->nfa_work != NULL) return (1);
+
+   num_caps = 2 * (size_t) (st->total_paren + 1);
+   size     = (2 * states + 1) * num_caps * sizeof (unsigned char *) +
+              2 * states * sizeof (nfa_thread) +
+              states * sizeof (unsigned int);
+
+   if (size > st->nfa_scratch_size) {
+      free (st->nfa_scratch);
+      st->nfa_scratch_size = 0;
+
+      if ((st->nfa_scratch = malloc (size)) == NULL) {
+         reg_error ("out of memory in `ExecRE\'");
+         return (0);
+      }
+
+      st->nfa_scratch_size = size;
+   }
+
+   st->nfa_work = st->nfa_scratch;
+
+   caps   = (unsigned char **) st->nfa_work;
+   thread = (nfa_thread *) (caps + (2 * states + 1) * num_caps);
+
+   for (i = 0; i < 2 * states; i++) {
+      thread [i].caps = caps;
+      caps += num_caps;
+   }
+
+   st->nfa_lists [0].thread = thread;
+   st->nfa_lists [1].thread = thread + states;
+   st->nfa_caps             = caps;
+   st->nfa_num_caps         = (int) num_caps;
+   st->nfa_mark             = (unsigned int *) (thread + 2 * states);
+   st->nfa_gen              = 0;
+   st->nfa_num_states       = (int) states;
+   st->nfa_program          = (unsigned char *) prog->program;
+   st->nfa_table            = st->nfa_program + prog->nfa_table;
+   st->nfa_top_branch       = prog->nfa_top_branch ?
+                                 st->nfa_program + prog->nfa_top_branch : NULL;
+
+   memset (st->nfa_mark, 0, states * sizeof (unsigned int));
+
+   return (1);
+}
+
+/*----------------------------------------------------------------------*
+ * nfa_next_gen
+ *
+ * Start building another list of threads.
+ *----------------------------------------------------------------------*/
+
+static void nfa_next_gen (exec_state *st) {
+
+   if (++st->nfa_gen == 0) {
+      memset (st->nfa_mark, 0,
+              sizeof (unsigned int) * (size_t) st->nfa_num_states);
+      st->nfa_gen = 1;
+   }
+}
+
+/*----------------------------------------------------------------------*
+ * nfa_skip
+ *
+ * Find the first place at or after `str' where a match could start,
+ * in the same way as `prefiltered_search', or the place where the
+ * search for a start ends.  Returns NULL if there can be no match.
+ *----------------------------------------------------------------------*/
+
+static unsigned char * nfa_skip (exec_state *st, regexp *prog,
+                                 unsigned char *str, unsigned char *end,
+                                 unsigned char *string, unsigned char **last) {
+
+   unsigned char *found;
+   size_t         want, n;
+
+   for (;;) {
+      if (prog->literal_len > 0 && (*last == NULL || str > *last)) {
+         found = next_literal (st, prog, str);
+
+         if (found == NULL) return (NULL);
+
+         *last = found - prog->literal_min;
+
+         if (prog->literal_max >= 0 && found - prog->literal_max > str) {
+            str = found - prog->literal_max;
+         }
+
+         if (end != NULL && str > end) return (NULL);
+      }
+
+      if (prog->anchor) {
+         for (; !AT_END_OF_STRING(str) && str != end; str++) {
+            if (str == string || *(str - 1) == '\n') break;
+         }
+
+         return (str);
+      }
+
+      if (!prog->use_first_chars) return (str);
+
+      want = PREFILTER_BLOCK;
+
+      if (prog->literal_len > 0 && (size_t) (*last + 1 - str) < want) {
+         want = *last + 1 - str;
+      }
+
+      if (end != NULL) {
+         if (end <= str) return (str);
+         if ((size_t) (end - str) < want) want = end - str;
+      }
+
+      if (st->end_of_string != NULL) {
+         if (st->end_of_string <= str) return (str);
+         if ((size_t) (st->end_of_string - str) < want) {
+            want = st->end_of_string - str;
+         }
+      }
+
+      n     = strnlen ((char *) str, want);
+      found = (unsigned char *) ScanFindCharSet ((char *) str, n,
+                                                 &prog->first_chars);
+
+      if (found != NULL) return (found);
+
+      str += n;
+
+      if (n < want) return (str); /* End of the text. */
+   }
+}
+
+/*----------------------------------------------------------------------*
+ * nfa_add
+ *
+ * Add the thread at `node' (in state `sub' of it) at `input' to `list',
+ * after following the nodes which don't match any text, in the order
+ * `match' would.  The captures so far are in st->nfa_caps.  A state
+ * already in the list was got to by a thread `match' would try first,
+ * which can go on in the same way, so it is left out.
+ *----------------------------------------------------------------------*/
+
+static void nfa_add (exec_state *st, nfa_list *list, unsigned char *node,
+                     int sub, unsigned char *input, int top_branch) {
+
+   unsigned char *alt, *next, *save;
+   unsigned int  *mark;
+   unsigned long  min, max;
+   int            i, no, lazy;
+
+   mark = &st->nfa_mark [NFA_STATE (st->nfa_table, node - st->nfa_program) +
+                         sub];
+
+   if (*mark == st->nfa_gen) return;
+
+   *mark = st->nfa_gen;
+   next  = next_ptr (node);
+
+   switch (GET_OP_CODE (node)) {
+      case BRANCH:
+         if (next == NULL || GET_OP_CODE (next) != BRANCH) { /* No choice. */
+            nfa_add (st, list, OPERAND (node), 0, input, top_branch);
+            break;
+         }
+
+         for (alt = node, i = 0;
+              alt != NULL && GET_OP_CODE (alt) == BRANCH;
+              alt = next_ptr (alt), i++) {
+
+            nfa_add (st, list, OPERAND (alt), 0, input,
+                     (top_branch < 0 && node == st->nfa_top_branch) ?
+                        i : top_branch);
+         }
+
+         break;
+
+      case NOTHING:
+      case BACK:
+         nfa_add (st, list, next, 0, input, top_branch);
+         break;
+
+      case BOL: case EOL: case BOWORD: case EOWORD: case NOT_BOUNDARY:
+         if (at_assertion (st, GET_OP_CODE (node), input)) {
+            nfa_add (st, list, next, 0, input, top_branch);
+         }
+
+         break;
+
+      case STAR:     case LAZY_STAR:
+      case QUESTION: case LAZY_QUESTION:
+      case PLUS:     case LAZY_PLUS:
+      case BRACE:    case LAZY_BRACE:
+         /* `sub' is the number of times round the loop so far. */
+
+         (void) loop_limits (node, &min, &max);
+
+         lazy = GET_OP_CODE (node) == LAZY_STAR     ||
+                GET_OP_CODE (node) == LAZY_QUESTION ||
+                GET_OP_CODE (node) == LAZY_PLUS     ||
+                GET_OP_CODE (node) == LAZY_BRACE;
+
+         if (lazy && (unsigned long) sub >= min) {
+            nfa_add (st, list, next, 0, input, top_branch);
+         }
+
+         if ((unsigned long) sub < max) nfa_push (st, list, node, sub, top_branch);
+
+         if (!lazy && (unsigned long) sub >= min) {
+            nfa_add (st, list, next, 0, input, top_branch);
+         }
+
+         break;
+
+      default:
+         if ((GET_OP_CODE (node) > OPEN) &&
+             (GET_OP_CODE (node) < OPEN + NSUBEXP)) {
+
+            no   = 2 * (GET_OP_CODE (node) - OPEN);
+            save = st->nfa_caps [no];
+
+            st->nfa_caps [no] = input;
+            nfa_add (st, list, next, 0, input, top_branch);
+            st->nfa_caps [no] = save;
+
+         } else if ((GET_OP_CODE (node) > CLOSE) &&
+                    (GET_OP_CODE (node) < CLOSE + NSUBEXP)) {
+
+            no   = 2 * (GET_OP_CODE (node) - CLOSE) + 1;
+            save = st->nfa_caps [no];
+
+            st->nfa_caps [no] = input;
+            nfa_add (st, list, next, 0, input, top_branch);
+            st->nfa_caps [no] = save;
+
+         } else {
+            nfa_push (st, list, node, sub, top_branch); /* END, or a node
+                                                           matching text. */
+         }
+   }
+}
+
+/*----------------------------------------------------------------------*
+ * nfa_push
+ *
+ * Append a thread waiting at `node' to `list'.
+ *----------------------------------------------------------------------*/
+
+static void nfa_push (exec_state *st, nfa_list *list, unsigned char *node,
+                      int sub, int top_branch) {
+
+   nfa_thread *t = &list->thread [list->count++];
+
+   t->node       = node;
+   t->sub        = sub;
+   t->top_branch = top_branch;
+
+   memcpy (t->caps, st->nfa_caps,
+           sizeof (unsigned char *) * (size_t) st->nfa_num_caps);
+}
+
+/*----------------------------------------------------------------------*
+ * nfa_step
+ *
+ * Add what `t' goes on to after matching the byte at `input' to `list'.
+ *----------------------------------------------------------------------*/
+
+static void nfa_step (exec_state *st, nfa_list *list, nfa_thread *t,
+                      unsigned char *input) {
+
+   unsigned char *node = t->node, *operand;
+   unsigned long  min, max, count;
+   int            rest;
+
+   memcpy (st->nfa_caps, t->caps,
+           sizeof (unsigned char *) * (size_t) st->nfa_num_caps);
+
+   switch (GET_OP_CODE (node)) {
+      case EXACTLY:
+      case SIMILAR:
+         operand = OPERAND (node) + t->sub;
+
+         if (AT_END_OF_STRING(input)) return;
+
+         if (GET_OP_CODE (node) == EXACTLY ? *operand != *input
+                                           : *operand != tolower (*input)) {
+            return;
+         }
+
+         if (operand [1] == '\0') {
+            nfa_add (st, list, next_ptr (node), 0, input + 1, t->top_branch);
+         } else {
+            nfa_add (st, list, node, t->sub + 1, input + 1, t->top_branch);
+         }
+
+         break;
+
+      case ANY:
+      case EVERY:
+         /* `sub' is the number of bytes of the character left to skip. */
+
+         if (t->sub > 0) {
+            rest = t->sub - 1;
+         } else if (AT_END_OF_STRING(input) ||
+                    (GET_OP_CODE (node) == ANY && *input == '\n')) {
+            return;
+         } else {
+            rest = Utf8CharLen (input) - 1;
+         }
+
+         if (rest == 0) {
+            nfa_add (st, list, next_ptr (node), 0, input + 1, t->top_branch);
+         } else {
+            nfa_add (st, list, node, rest, input + 1, t->top_branch);
+         }
+
+         break;
+
+      case STAR:     case LAZY_STAR:
+      case QUESTION: case LAZY_QUESTION:
+      case PLUS:     case LAZY_PLUS:
+      case BRACE:    case LAZY_BRACE:
+         /* Like `greedy', a byte at a time. */
+
+         operand = loop_limits (node, &min, &max);
+
+         if (!byte_matches (st, operand, input)) return;
+
+         count = (unsigned long) t->sub + 1;
+
+         if (max == ULONG_MAX && count > min) count = min;
+
+         nfa_add (st, list, node, (int) count, input + 1, t->top_branch);
+         break;
+
+      default:
+         if (byte_matches (st, node, input)) {
+            nfa_add (st, list, next_ptr (node), 0, input + 1, t->top_branch);
+         }
+   }
+}
+
+/*----------------------------------------------------------------------*
+ * loop_limits
+ *
+ * Find the least and greatest number of times round a simple loop
+ * (ULONG_MAX if there is no limit).  Returns the node it repeats.
+ *----------------------------------------------------------------------*/
+
+static unsigned char * loop_limits (unsigned char *node, unsigned long *min,
+                                    unsigned long *max) {
+
+   switch (GET_OP_CODE (node)) {
+      case STAR: case LAZY_STAR:
+         *min = REG_ZERO;
+         *max = ULONG_MAX;
+         break;
+
+      case PLUS: case LAZY_PLUS:
+         *min = REG_ONE;
+         *max = ULONG_MAX;
+         break;
+
+      case QUESTION: case LAZY_QUESTION:
+         *min = REG_ZERO;
+         *max = REG_ONE;
+         break;
+
+      default: /* BRACE, LAZY_BRACE */
+         *min = (unsigned long) GET_OFFSET (node + NEXT_PTR_SIZE);
+         *max = (unsigned long) GET_OFFSET (node + (2 * NEXT_PTR_SIZE));
+
+         if (*max <= REG_INFINITY) *max = ULONG_MAX;
+
+         return (OPERAND (node + (2 * NEXT_PTR_SIZE)));
+   }
+
+   return (OPERAND (node));
+}
+
+/*----------------------------------------------------------------------*
+ * byte_matches
+ *
+ * Whether a node matching a single byte matches the one at `input', as
+ * tested by `greedy'.
+ *----------------------------------------------------------------------*/
+
+static int byte_matches (exec_state *st, unsigned char *node,
+                         unsigned char *input) {
+
+   unsigned char c = *input;
+
+   if (AT_END_OF_STRING(input)) return (0);
+
+   switch (GET_OP_CODE (node)) {
+      case ANY:           return (c != '\n');
+      case EVERY:         return (1);
+      case EXACTLY:       return (*OPERAND (node) == c);
+      case SIMILAR:       return (*OPERAND (node) == tolower (c));
+      case ANY_OF:        return (strchr ((char *) OPERAND (node), c) != NULL);
+      case ANY_BUT:       return (strchr ((char *) OPERAND (node), c) == NULL);
+      case IS_DELIM:      return (st->current_delimiters [c] != 0);
+      case NOT_DELIM:     return (st->current_delimiters [c] == 0);
+      case WORD_CHAR:     return (isalnum ((int) c) || c == '_');
+      case NOT_WORD_CHAR: return (!isalnum ((int) c) && c != '_' && c != '\n');
+      case DIGIT:         return (isdigit ((int) c) != 0);
+      case NOT_DIGIT:     return (!isdigit ((int) c) && c != '\n');
+      case LETTER:        return (isalpha ((int) c) != 0);
+      case NOT_LETTER:    return (!isalpha ((int) c) && c != '\n');
+      case SPACE:         return (isspace ((int) c) && c != '\n');
+      case SPACE_NL:      return (isspace ((int) c) != 0);
+      case NOT_SPACE:     return (!isspace ((int) c));
+      case NOT_SPACE_NL:  return (!isspace ((int) c) || c == '\n');
+      default:            return (0);
+   }
+}
+
+/*----------------------------------------------------------------------*
+ * at_assertion
+ *
+ * Whether the zero width assertion `op' (BOL, EOL, BOWORD, EOWORD or
+ * NOT_BOUNDARY) holds at `input'.
+ *----------------------------------------------------------------------*/
+
+static int at_assertion (exec_state *st, int op, unsigned char *input) {
+
+   int prev_is_delim;
+   int current_is_delim;
+
+   switch (op) {
+      case BOL:
+         if (input == st->start_of_string) return (st->prev_is_bol);
+
+         return (*(input - 1) == '\n');
+
+      case EOL:
+         return (*input == '\n' ||
+                 (AT_END_OF_STRING(input) && st->succ_is_eol));
+   }
+
+   /* Check whether the characters either side are delimiters. */
+
+   if (input == st->start_of_string) {
+      prev_is_delim = st->prev_is_delim;
+   } else {
+      prev_is_delim = st->current_delimiters [ *(input - 1) ];
+   }
+
+   if (AT_END_OF_STRING(input)) {
+      current_is_delim = st->succ_is_delim;
+   } else {
+      current_is_delim = st->current_delimiters [ *input ];
+   }
+
+   switch (op) {
+      case BOWORD: return (prev_is_delim && !current_is_delim);
+      case EOWORD: return (!prev_is_delim && current_is_delim);
+      default:     return (!(prev_is_delim ^ current_is_delim));
+   }
+}
+
+/*----------------------------------------------------------------------*
+ * CreateREContext, FreeREContext
+ *
+ * A context holds the work variables for compiling and matching regular
+ * expressions, which `CompileRE' keeps in a single static area.  Threads
+ * which compile regular expressions at the same time must each use their
+ * own context with `CompileREContext'.  Creating a context also sets up
+ * the character class tables shared by all compiles, so contexts for
+ * worker threads should be created before starting them.
+ *----------------------------------------------------------------------*/
+
+struct regexContext {
+   compile_state compile;
+   exec_state    exec;
+};
+
+regexContext * CreateREContext (void) {
+
+   regexContext *context;
+
+   init_ansi_classes ();
+
+   context = (regexContext *) malloc (sizeof (regexContext));
+
+   if (context != NULL) {
+      context->exec.nfa_scratch      = NULL;
+      context->exec.nfa_scratch_size = 0;
+   }
+
+   return (context);
+}
+
+void FreeREContext (regexContext *context) {
+
+   if (context != NULL) free (context->exec.nfa_scratch);
+
+   free (context);
+}
+
+/*----------------------------------------------------------------------*
+ * CompileREContext
+ *
+ * `CompileRE', with the work variables in `context'.  Error messages
+ * returned in `errorText' last until the context is next used to compile.
+ *----------------------------------------------------------------------*/
+
+regexp * CompileREContext (regexContext *context, const char *exp,
+                           char **errorText, int defaultFlags) {
+
+   return (compile_regex (&context->compile, exp, errorText, defaultFlags));
+}
+
+/*----------------------------------------------------------------------*
+ * ExecREContext
+ *
+ * `ExecRE', with the work variables in `context'.  The results are left
+ * in `prog', so a compiled regular expression can only be used by one
+ * thread at a time.
+ *----------------------------------------------------------------------*/
+
+int ExecREContext (regexContext *context, regexp *prog, const char *string,
+                   const char *end, int reverse, char prev_char,
+                   char succ_char, const char *delimiters,
+                   const char *look_behind_to, const char *match_to) {
+
+   return (exec_regex (&context->exec, prog, string, end, reverse, prev_char,
+                       succ_char, delimiters, look_behind_to, match_to));
+}
+
+/*----------------------------------------------------------------------*
+ * CopyRE
+ *
+ * Make a copy of a compiled regular expression, which can be matched in
+ * another thread at the same time as `prog' (see `ExecREContext').
+ * Free it with free (), like the result of `CompileRE'.
+ *----------------------------------------------------------------------*/
+
+regexp * CopyRE (const regexp *prog) {
+
+   regexp *copy = (regexp *) malloc ((size_t) prog->size);
+
+   if (copy != NULL) memcpy (copy, prog, (size_t) prog->size);
+
+   return (copy);
+}
+
+/*--------------------------------------------------------------------*
+ * init_ansi_classes
+ *
+ * Generate character class sets using locale aware ANSI C functions.
+ * Only done once, by whichever thread compiles or matches first; the
+ * others wait until the sets are complete.
+ *
+ *--------------------------------------------------------------------*/
+
+static pthread_once_t Ansi_Classes_Once = PTHREAD_ONCE_INIT;
+static int            Ansi_Classes_Ok   = 0;
+
+static int init_ansi_classes (void) {
+
+   pthread_once (&Ansi_Classes_Once, make_ansi_classes);
+
+   return (Ansi_Classes_Ok);
+}
+
+static void make_ansi_classes (void) {
+
+   static int underscore = (int) '_';
+          int i, word_count, letter_count, space_count;
+
+   word_count   = 0;
+   letter_count = 0;
+   space_count  = 0;
+
+   for (i = 1; i < (int)UCHAR_MAX; i++) {
+      if (isalnum (i) || i == underscore) {
+         Word_Char [word_count++] = (unsigned char) i;
+      }
+
+      if (isalpha (i)) {
+         Letter_Char [letter_count++] = (unsigned char) i;
+      }
+
+      /* Note: Whether or not newline is considered to be whitespace is
+         handled by switches within the original regex and is thus omitted
+         here. */
+
+      if (isspace (i) && (i != (int) '\n')) {
+         White_Space [space_count++] = (unsigned char) i;
+      }
+
+      /* Make sure arrays are big enough.  ("- 2" because of zero array
+         origin and we need to leave room for the NULL terminator.) */
+
+      if (word_count   > (ALNUM_CHAR_SIZE  - 2) ||
+          space_count  > (WHITE_SPACE_SIZE - 2) ||
+          letter_count > (ALNUM_CHAR_SIZE  - 2)) {
+
+         reg_error ("internal error #9 `init_ansi_classes\'");
+         return;
+      }
+   }
+
+   Word_Char   [word_count]   = '\0';
+   Letter_Char [letter_count] = '\0';
+   White_Space [space_count]  = '\0';
+
+   Ansi_Classes_Ok = 1;
+}
+
+/*----------------------------------------------------------------------*
+ * attempt - try match at specific point, returns: 0 failure, 1 success
+ *----------------------------------------------------------------------*/
+
+static int attempt (exec_state *st, regexp *prog, unsigned char *string) {
+
+   register          int    i;
+   register unsigned char **s_ptr;
+   register unsigned char **e_ptr;
+   		     int    branch_index = 0; /* Must be set to zero ! */
+
+   if (st->nfa_only) return (nfa_search (st, prog, string, NULL, 1));
+
+   st->reg_input      = string;
+   st->start_ptr_ptr  = (unsigned char **) prog->startp;
+   st->end_ptr_ptr    = (unsigned char **) prog->endp;
+   s_ptr          = (unsigned char **) prog->startp;
+   e_ptr          = (unsigned char **) prog->endp;
+
+   /* Reset the recursion counter, and allow back tracking a number of
+      steps in keeping with how far the search has come. */
+   st->recursion_count = 0;
+
+   if (st->first_attempt == NULL) st->first_attempt = string;
+
+   if (prog->nfa_states > 0) {
+      st->step_limit = st->steps + NFA_BACKTRACK_STEPS
+                     + 2 * (unsigned long) prog->nfa_states
+                         * (unsigned long) (st->reverse ?
+                                              st->first_attempt - string :
+                                              string - st->first_attempt);
+   } else {
+      st->step_limit = ULONG_MAX;
+   }
 
    /* Overhead due to capturing parentheses. */
 
-   Extent_Ptr_BW = string;
-   Extent_Ptr_FW = NULL;
+   st->extent_ptr_bw = string;
+   st->extent_ptr_fw = NULL;
 
-   for (i = Total_Paren + 1; i > 0; i--) {
+   for (i = st->total_paren + 1; i > 0; i--) {
       *s_ptr++ = NULL;
       *e_ptr++ = NULL;
    }
 
-   if (match ((unsigned char *) (prog->program + REGEX_START_OFFSET),
+   if (match (st, (unsigned char *) (prog->program + REGEX_START_OFFSET),
 	&branch_index)) {
       prog->startp [0] = (char *) string;
-      prog->endp   [0] = (char *) Reg_Input;     /* <-- One char AFTER  */
-      prog->extentpBW  = (char *) Extent_Ptr_BW; /*     matched string! */
-      prog->extentpFW  = (char *) Extent_Ptr_FW;
+      prog->endp   [0] = (char *) st->reg_input;     /* <-- One char AFTER  */
+      prog->extentpBW  = (char *) st->extent_ptr_bw; /*     matched string! */
+      prog->extentpFW  = (char *) st->extent_ptr_fw;
       prog->top_branch = branch_index;
 
       return (1);
+   } else if (st->recursion_limit_exceeded && prog->nfa_states > 0) {
+      /* Back tracking is going badly, carry on without it.  A forward
+         search is finished by `exec_regex' in one pass, so the flag is left
+         set to stop its loops. */
+
+      st->nfa_only = 1;
+
+      if (!st->reverse) {
+         st->nfa_resume = string;
+
+         return (0);
+      }
+
+      st->recursion_limit_exceeded = 0;
+
+      return (nfa_search (st, prog, string, NULL, 1));
    } else {
       return (0);
    }
@@ -3028,20 +4520,23 @@ static int attempt (regexp *prog, unsigned char *string) {
  * loop instead of by recursion.  Returns 0 failure, 1 success.
  *----------------------------------------------------------------------*/
 #define MATCH_RETURN(X)\
- { --Recursion_Count; return (X); }
+ { --st->recursion_count; return (X); }
 #define CHECK_RECURSION_LIMIT\
- if (Recursion_Limit_Exceeded) MATCH_RETURN (0);
+ if (st->recursion_limit_exceeded) MATCH_RETURN (0);
  
-static int match (unsigned char *prog, int *branch_index_param) {
+static int match (exec_state *st, unsigned char *prog,
+                  int *branch_index_param) {
 
    register unsigned char *scan;  /* Current node. */
             unsigned char *next;  /* Next node. */
    register int next_ptr_offset;  /* Used by the NEXT_PTR () macro */
    
-   if (++Recursion_Count > REGEX_RECURSION_LIMIT) {
-       if (!Recursion_Limit_Exceeded) /* Prevent duplicate errors */
+   if (++st->recursion_count > REGEX_RECURSION_LIMIT ||
+       ++st->steps > st->step_limit) {
+       /* Programs which `nfa_search' can match are not given up on. */
+       if (!st->recursion_limit_exceeded && st->step_limit == ULONG_MAX)
            reg_error("recursion limit exceeded, please respecify expression");
-       Recursion_Limit_Exceeded = 1;
+       st->recursion_limit_exceeded = 1;
        MATCH_RETURN (0);
    }
 	    
@@ -3061,9 +4556,9 @@ static int match (unsigned char *prog, int *branch_index_param) {
                   next = OPERAND (scan);   /* Avoid recursion. */
                } else {
                   do {
-                     save = Reg_Input;
+                     save = st->reg_input;
 
-                     if (match (OPERAND (scan), NULL)) 
+                     if (match (st, OPERAND (scan), NULL)) 
 		     {
 			if (branch_index_param)
 			   *branch_index_param = branch_index_local;
@@ -3074,7 +4569,7 @@ static int match (unsigned char *prog, int *branch_index_param) {
 
 		     ++branch_index_local;
 
-                     Reg_Input = save; /* Backtrack. */
+                     st->reg_input = save; /* Backtrack. */
                      NEXT_PTR (scan, scan);
                   } while (scan != NULL && GET_OP_CODE (scan) == BRANCH);
 
@@ -3093,21 +4588,21 @@ static int match (unsigned char *prog, int *branch_index_param) {
 
                /* Inline the first character, for speed. */
 
-               if (*opnd != *Reg_Input) MATCH_RETURN (0);
+               if (*opnd != *st->reg_input) MATCH_RETURN (0);
 
                len = strlen ((char *) opnd);
                
-               if (End_Of_String != NULL && Reg_Input + len > End_Of_String) {
+               if (st->end_of_string != NULL && st->reg_input + len > st->end_of_string) {
                    MATCH_RETURN (0);
                }
 
                if (len > 1  &&
-                   strncmp ((char *) opnd, (char *) Reg_Input, len) != 0) {
+                   strncmp ((char *) opnd, (char *) st->reg_input, len) != 0) {
 
                    MATCH_RETURN (0);
                }
 
-               Reg_Input += len;
+               st->reg_input += len;
             }
 
             break;
@@ -3123,8 +4618,8 @@ static int match (unsigned char *prog, int *branch_index_param) {
                   regex compile. */
 
                while ((test = *opnd++) != '\0') {
-                  if (AT_END_OF_STRING(Reg_Input) ||
-                      tolower (*Reg_Input++) != test) {
+                  if (AT_END_OF_STRING(st->reg_input) ||
+                      tolower (*st->reg_input++) != test) {
                      
                       MATCH_RETURN (0);
                   }
@@ -3133,203 +4628,132 @@ static int match (unsigned char *prog, int *branch_index_param) {
 
             break;
 
-         case BOL: /* `^' (beginning of line anchor) */
-            if (Reg_Input == Start_Of_String) {
-               if (Prev_Is_BOL) break;
-            } else if (*(Reg_Input - 1) == '\n') {
-               break;
-            }
-
-            MATCH_RETURN (0);
-
-         case EOL: /* `$' anchor matches end of line and end of string */
-            if (*Reg_Input == '\n' || (AT_END_OF_STRING(Reg_Input) && Succ_Is_EOL)) {
-               break;
-            }
-
-            MATCH_RETURN (0);
-
-         case BOWORD: /* `<' (beginning of word anchor) */
-            /* Check to see if the current character is not a delimiter
-               and the preceding character is. */
-            {
-	       int prev_is_delim;
-	       if (Reg_Input == Start_Of_String) {
-		   prev_is_delim = Prev_Is_Delim;
-	       } else {
-		   prev_is_delim = Current_Delimiters [ *(Reg_Input - 1) ];
-	       }
-	       if (prev_is_delim) {
-		   int current_is_delim;
-		   if (AT_END_OF_STRING(Reg_Input)) {
-		      current_is_delim = Succ_Is_Delim;
-		   } else {
-		      current_is_delim = Current_Delimiters [ *Reg_Input ];
-		   }
-		   if (!current_is_delim) break;
-	       }
-	    }
-
-            MATCH_RETURN (0);
-
-         case EOWORD: /* `>' (end of word anchor) */
-            /* Check to see if the current character is a delimiter
-	       and the preceding character is not. */
-            {
-	       int prev_is_delim;
-	       if (Reg_Input == Start_Of_String) {
-		   prev_is_delim = Prev_Is_Delim;
-	       } else {
-		   prev_is_delim = Current_Delimiters [ *(Reg_Input-1) ];
-	       }
-	       if (!prev_is_delim) {
-		   int current_is_delim;
-		   if (AT_END_OF_STRING(Reg_Input)) {
-		      current_is_delim = Succ_Is_Delim;
-		   } else {
-		      current_is_delim = Current_Delimiters [ *Reg_Input ];
-		   }
-		   if (current_is_delim) break;
-	       }
-	    }
-
-            MATCH_RETURN (0);
-
+         case BOL:          /* `^' (beginning of line anchor) */
+         case EOL:          /* `$' anchor matches end of line and end of
+                               string */
+         case BOWORD:       /* `<' (beginning of word anchor) */
+         case EOWORD:       /* `>' (end of word anchor) */
          case NOT_BOUNDARY: /* \B (NOT a word boundary) */
-            {
-	       int prev_is_delim;
-	       int current_is_delim;
-	       if (Reg_Input == Start_Of_String) {
-		   prev_is_delim = Prev_Is_Delim;
-	       } else {
-		   prev_is_delim = Current_Delimiters [ *(Reg_Input-1) ]; 
-	       }
-	       if (AT_END_OF_STRING(Reg_Input)) {
-		  current_is_delim = Succ_Is_Delim;
-	       } else {
-		  current_is_delim = Current_Delimiters [ *Reg_Input ];
-	       }
-	       if (!(prev_is_delim ^ current_is_delim)) break;
-	    }
+            if (at_assertion (st, GET_OP_CODE (scan), st->reg_input)) break;
 
             MATCH_RETURN (0);
 
          case IS_DELIM: /* \y (A word delimiter character.) */
-            if (Current_Delimiters [ *Reg_Input ] && 
-                !AT_END_OF_STRING(Reg_Input)) {
-               Reg_Input++; break;
+            if (st->current_delimiters [ *st->reg_input ] && 
+                !AT_END_OF_STRING(st->reg_input)) {
+               st->reg_input++; break;
             }
 
             MATCH_RETURN (0);
 
          case NOT_DELIM: /* \Y (NOT a word delimiter character.) */
-            if (!Current_Delimiters [ *Reg_Input ] && 
-                !AT_END_OF_STRING(Reg_Input)) {
-               Reg_Input++; break;
+            if (!st->current_delimiters [ *st->reg_input ] && 
+                !AT_END_OF_STRING(st->reg_input)) {
+               st->reg_input++; break;
             }
 
             MATCH_RETURN (0);
 
          case WORD_CHAR: /* \w (word character; alpha-numeric or underscore) */
-            if ((isalnum ((int) *Reg_Input) || *Reg_Input == '_') && 
-                !AT_END_OF_STRING(Reg_Input)) {
-               Reg_Input++; break;
+            if ((isalnum ((int) *st->reg_input) || *st->reg_input == '_') && 
+                !AT_END_OF_STRING(st->reg_input)) {
+               st->reg_input++; break;
             }
 
             MATCH_RETURN (0);
 
          case NOT_WORD_CHAR:/* \W (NOT a word character) */
-            if (isalnum ((int) *Reg_Input) ||
-                *Reg_Input == '_'          ||
-                *Reg_Input == '\n'         ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (isalnum ((int) *st->reg_input) ||
+                *st->reg_input == '_'          ||
+                *st->reg_input == '\n'         ||
+                AT_END_OF_STRING(st->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            st->reg_input++; break;
 
          case ANY: /* `.' (matches any character EXCEPT newline) */
-            if (AT_END_OF_STRING(Reg_Input) || *Reg_Input == '\n') MATCH_RETURN (0);
+            if (AT_END_OF_STRING(st->reg_input) || *st->reg_input == '\n') MATCH_RETURN (0);
 
-            Reg_Input += Utf8CharLen(Reg_Input); break;
+            st->reg_input += Utf8CharLen(st->reg_input); break;
 
          case EVERY: /* `.' (matches any character INCLUDING newline) */
-            if (AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (AT_END_OF_STRING(st->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input += Utf8CharLen(Reg_Input); break;
+            st->reg_input += Utf8CharLen(st->reg_input); break;
 
          case DIGIT: /* \d, same as [0123456789] */
-            if (!isdigit ((int) *Reg_Input) ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (!isdigit ((int) *st->reg_input) ||
+                AT_END_OF_STRING(st->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            st->reg_input++; break;
 
          case NOT_DIGIT: /* \D, same as [^0123456789] */
-            if (isdigit ((int) *Reg_Input) || 
-                *Reg_Input == '\n'         ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (isdigit ((int) *st->reg_input) || 
+                *st->reg_input == '\n'         ||
+                AT_END_OF_STRING(st->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            st->reg_input++; break;
 
          case LETTER: /* \l, same as [a-zA-Z] */
-            if (!isalpha ((int) *Reg_Input) ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (!isalpha ((int) *st->reg_input) ||
+                AT_END_OF_STRING(st->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            st->reg_input++; break;
 
          case NOT_LETTER: /* \L, same as [^0123456789] */
-            if (isalpha ((int) *Reg_Input)  || 
-                *Reg_Input == '\n' ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (isalpha ((int) *st->reg_input)  || 
+                *st->reg_input == '\n' ||
+                AT_END_OF_STRING(st->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            st->reg_input++; break;
 
          case SPACE: /* \s, same as [ \t\r\f\v] */
-            if (!isspace ((int) *Reg_Input) || 
-                *Reg_Input == '\n'          ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (!isspace ((int) *st->reg_input) || 
+                *st->reg_input == '\n'          ||
+                AT_END_OF_STRING(st->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            st->reg_input++; break;
 
          case SPACE_NL: /* \s, same as [\n \t\r\f\v] */
-            if (!isspace ((int) *Reg_Input) ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (!isspace ((int) *st->reg_input) ||
+                AT_END_OF_STRING(st->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            st->reg_input++; break;
 
          case NOT_SPACE: /* \S, same as [^\n \t\r\f\v] */
-            if (isspace ((int) *Reg_Input) || 
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if (isspace ((int) *st->reg_input) || 
+                AT_END_OF_STRING(st->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            st->reg_input++; break;
 
          case NOT_SPACE_NL: /* \S, same as [^ \t\r\f\v] */
-            if ((isspace ((int) *Reg_Input) && *Reg_Input != '\n') ||
-                AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0);
+            if ((isspace ((int) *st->reg_input) && *st->reg_input != '\n') ||
+                AT_END_OF_STRING(st->reg_input)) MATCH_RETURN (0);
 
-            Reg_Input++; break;
+            st->reg_input++; break;
 
          case ANY_OF:  /* [...] character class. */
-            if (AT_END_OF_STRING(Reg_Input)) 
+            if (AT_END_OF_STRING(st->reg_input)) 
                MATCH_RETURN (0); /* Needed because strchr ()
                                     considers \0 as a member
                                     of the character set. */
 
-            if (strchr ((char *) OPERAND (scan), (int) *Reg_Input) == NULL) {
+            if (strchr ((char *) OPERAND (scan), (int) *st->reg_input) == NULL) {
                MATCH_RETURN (0);
             }
 
-            Reg_Input++; break;
+            st->reg_input++; break;
 
          case ANY_BUT: /* [^...] Negated character class-- does NOT normally
                        match newline (\n added usually to operand at compile
                        time.) */
 
-            if (AT_END_OF_STRING(Reg_Input)) MATCH_RETURN (0); /* See comment for ANY_OF. */
+            if (AT_END_OF_STRING(st->reg_input)) MATCH_RETURN (0); /* See comment for ANY_OF. */
 
-            if (strchr ((char *) OPERAND (scan), (int) *Reg_Input) != NULL) {
+            if (strchr ((char *) OPERAND (scan), (int) *st->reg_input) != NULL) {
                MATCH_RETURN (0);
             }
 
-            Reg_Input++; break;
+            st->reg_input++; break;
 
          case NOTHING:
          case BACK:
@@ -3399,17 +4823,17 @@ static int match (unsigned char *prog, int *branch_index_param) {
                      next_op = OPERAND (scan + (2 * NEXT_PTR_SIZE));
                }
 
-               save = Reg_Input;
+               save = st->reg_input;
 
                if (lazy) {
-                  if ( min > REG_ZERO) num_matched = greedy (next_op, min);
+                  if ( min > REG_ZERO) num_matched = greedy (st, next_op, min);
                } else {
-                  num_matched = greedy (next_op, max);
+                  num_matched = greedy (st, next_op, max);
                }
 
                while (min <= num_matched && num_matched <= max) {
-                  if (next_char == '\0' || next_char == *Reg_Input) {
-                     if (match (next, NULL)) MATCH_RETURN (1);
+                  if (next_char == '\0' || next_char == *st->reg_input) {
+                     if (match (st, next, NULL)) MATCH_RETURN (1);
                      
                      CHECK_RECURSION_LIMIT
                   }
@@ -3417,7 +4841,11 @@ static int match (unsigned char *prog, int *branch_index_param) {
                   /* Couldn't or didn't match. */
 
                   if (lazy) {
-                     if (!greedy (next_op, 1)) MATCH_RETURN (0);
+                     /* The failed match may have left reg_input anywhere. */
+
+                     st->reg_input = save + num_matched;
+
+                     if (!greedy (st, next_op, 1)) MATCH_RETURN (0);
 
                      num_matched++; /* Inch forward. */
                   } else if (num_matched > REG_ZERO) {
@@ -3426,7 +4854,7 @@ static int match (unsigned char *prog, int *branch_index_param) {
                      break;
                   }
 
-                  Reg_Input = save + num_matched;
+                  st->reg_input = save + num_matched;
                }
 
                MATCH_RETURN (0);
@@ -3435,8 +4863,8 @@ static int match (unsigned char *prog, int *branch_index_param) {
             break;
 
          case END:
-            if (Extent_Ptr_FW == NULL || (Reg_Input - Extent_Ptr_FW) > 0) {
-               Extent_Ptr_FW = Reg_Input;
+            if (st->extent_ptr_fw == NULL || (st->reg_input - st->extent_ptr_fw) > 0) {
+               st->extent_ptr_fw = st->reg_input;
             }
 
             MATCH_RETURN (1);  /* Success! */
@@ -3444,17 +4872,17 @@ static int match (unsigned char *prog, int *branch_index_param) {
             break;
 
          case INIT_COUNT:
-            Brace->count [*OPERAND (scan)] = REG_ZERO;
+            st->brace->count [*OPERAND (scan)] = REG_ZERO;
 
             break;
 
          case INC_COUNT:
-            Brace->count [*OPERAND (scan)]++;
+            st->brace->count [*OPERAND (scan)]++;
 
             break;
 
          case TEST_COUNT:
-            if (Brace->count [*OPERAND (scan)] <
+            if (st->brace->count [*OPERAND (scan)] <
                (unsigned long) GET_OFFSET (scan + NEXT_PTR_SIZE + INDEX_SIZE)) {
 
                next = scan + NODE_SIZE + INDEX_SIZE + NEXT_PTR_SIZE;
@@ -3483,8 +4911,8 @@ static int match (unsigned char *prog, int *branch_index_param) {
                   finish =
                      (unsigned char *) Cross_Regex_Backref->endp   [paren_no];
                } else { */
-                  captured = Back_Ref_Start [paren_no];
-                  finish   = Back_Ref_End   [paren_no];
+                  captured = st->back_ref_start [paren_no];
+                  finish   = st->back_ref_end   [paren_no];
                /* } */
 
                if ((captured != NULL) && (finish != NULL)) {
@@ -3494,15 +4922,15 @@ static int match (unsigned char *prog, int *branch_index_param) {
                       GET_OP_CODE (scan) == X_REGEX_BR_CI*/ ) {
 
                      while (captured < finish) {
-                        if (AT_END_OF_STRING(Reg_Input) ||
-                            tolower (*captured++) != tolower (*Reg_Input++)) {
+                        if (AT_END_OF_STRING(st->reg_input) ||
+                            tolower (*captured++) != tolower (*st->reg_input++)) {
                            MATCH_RETURN (0);
                         }
                      }
                   } else {
                      while (captured < finish) {
-                        if (AT_END_OF_STRING(Reg_Input) ||
-                            *captured++ != *Reg_Input++) MATCH_RETURN (0);
+                        if (AT_END_OF_STRING(st->reg_input) ||
+                            *captured++ != *st->reg_input++) MATCH_RETURN (0);
                      }
                   }
 
@@ -3519,14 +4947,14 @@ static int match (unsigned char *prog, int *branch_index_param) {
                register unsigned char *saved_end;
                                  int   answer;
 
-               save      = Reg_Input;
+               save      = st->reg_input;
                
                /* Temporarily ignore the logical end of the string, to allow
                   lookahead past the end. */
-               saved_end = End_Of_String;
-               End_Of_String = NULL;
+               saved_end = st->end_of_string;
+               st->end_of_string = NULL;
                
-               answer    = match (next, NULL); /* Does the look-ahead regex match? */
+               answer    = match (st, next, NULL); /* Does the look-ahead regex match? */
 
                CHECK_RECURSION_LIMIT
 
@@ -3539,12 +4967,12 @@ static int match (unsigned char *prog, int *branch_index_param) {
                      may need more text than it matches to accomplish a
                      re-match. */
 
-                  if (Extent_Ptr_FW == NULL || (Reg_Input - Extent_Ptr_FW) > 0) {
-                     Extent_Ptr_FW = Reg_Input;
+                  if (st->extent_ptr_fw == NULL || (st->reg_input - st->extent_ptr_fw) > 0) {
+                     st->extent_ptr_fw = st->reg_input;
                   }
 
-                  Reg_Input = save; /* Backtrack to look-ahead start. */
-                  End_Of_String = saved_end; /* Restore logical end. */
+                  st->reg_input = save; /* Backtrack to look-ahead start. */
+                  st->end_of_string = saved_end; /* Restore logical end. */
 
                   /* Jump to the node just after the (?=...) or (?!...)
                      Construct. */
@@ -3555,8 +4983,8 @@ static int match (unsigned char *prog, int *branch_index_param) {
 		      next = next_ptr (next);
                   next = next_ptr (next); /* Skip the LOOK_AHEAD_CLOSE */
                } else {
-                  Reg_Input = save; /* Backtrack to look-ahead start. */
-                  End_Of_String = saved_end; /* Restore logical end. */
+                  st->reg_input = save; /* Backtrack to look-ahead start. */
+                  st->end_of_string = saved_end; /* Restore logical end. */
 
                   MATCH_RETURN (0);
                }
@@ -3574,13 +5002,13 @@ static int match (unsigned char *prog, int *branch_index_param) {
                                  int   found = 0;
                         unsigned char *saved_end;
 
-               save      = Reg_Input;
-               saved_end = End_Of_String;
+               save      = st->reg_input;
+               saved_end = st->end_of_string;
                
                /* Prevent overshoot (greedy matching could end past the
                   current position) by tightening the matching boundary. 
                   Lookahead inside lookbehind can still cross that boundary. */
-               End_Of_String = Reg_Input;
+               st->end_of_string = st->reg_input;
                
                lower = GET_LOWER (scan);
                upper = GET_UPPER (scan);
@@ -3591,20 +5019,20 @@ static int match (unsigned char *prog, int *branch_index_param) {
                   is not constant: we have to make sure the expression doesn't
                   match for _any_ of the starting positions. */
                for (offset = lower; offset <= upper; ++offset) {
-	          Reg_Input = save - offset;
+	          st->reg_input = save - offset;
 	          
-                  if (Reg_Input < Look_Behind_To) {
+                  if (st->reg_input < st->look_behind_to) {
                      /* No need to look any further */
                      break;
            	  }
                   
-                  answer    = match (next, NULL); /* Does the look-behind regex match? */
+                  answer    = match (st, next, NULL); /* Does the look-behind regex match? */
 
                   CHECK_RECURSION_LIMIT
 
                   /* The match must have ended at the current position;
                      otherwise it is invalid */
-                  if (answer && Reg_Input == save) {
+                  if (answer && st->reg_input == save) {
                      /* It matched, exactly far enough */
                      found = 1;
                      
@@ -3616,9 +5044,9 @@ static int match (unsigned char *prog, int *branch_index_param) {
                         leading look-behind may need more text than it matches
                         to accomplish a re-match. */
 
-                     if (Extent_Ptr_BW == NULL || 
-                         (Extent_Ptr_BW - (save - offset)) > 0) {
-                        Extent_Ptr_BW = save - offset;
+                     if (st->extent_ptr_bw == NULL || 
+                         (st->extent_ptr_bw - (save - offset)) > 0) {
+                        st->extent_ptr_bw = save - offset;
                      }
 
                      break;
@@ -3626,8 +5054,8 @@ static int match (unsigned char *prog, int *branch_index_param) {
                }
                
 	       /* Always restore the position and the logical string end. */
-	       Reg_Input = save;
-               End_Of_String = saved_end;
+	       st->reg_input = save;
+               st->end_of_string = saved_end;
                
                if ((GET_OP_CODE (scan) == POS_BEHIND_OPEN) ? found : !found) {
                   /* The look-behind matches, so we must jump to the next
@@ -3659,18 +5087,18 @@ static int match (unsigned char *prog, int *branch_index_param) {
                register unsigned char *save;
 
                no   = GET_OP_CODE (scan) - OPEN;
-               save = Reg_Input;
+               save = st->reg_input;
 
                if (no < 10) {
-                  Back_Ref_Start [no] = save;
-                  Back_Ref_End   [no] = NULL;
+                  st->back_ref_start [no] = save;
+                  st->back_ref_end   [no] = NULL;
                }
 
-               if (match (next, NULL)) {
-                  /* Do not set `Start_Ptr_Ptr' if some later invocation (think
+               if (match (st, next, NULL)) {
+                  /* Do not set `st->start_ptr_ptr' if some later invocation (think
                      recursion) of the same parentheses already has. */
 
-                  if (Start_Ptr_Ptr [no] == NULL) Start_Ptr_Ptr [no] = save;
+                  if (st->start_ptr_ptr [no] == NULL) st->start_ptr_ptr [no] = save;
 
                   MATCH_RETURN (1);
                } else {
@@ -3683,15 +5111,15 @@ static int match (unsigned char *prog, int *branch_index_param) {
                register unsigned char *save;
 
                no   = GET_OP_CODE (scan) - CLOSE;
-               save = Reg_Input;
+               save = st->reg_input;
 
-               if (no < 10) Back_Ref_End [no] = save;
+               if (no < 10) st->back_ref_end [no] = save;
 
-               if (match (next, NULL)) {
-                  /* Do not set `End_Ptr_Ptr' if some later invocation of the
+               if (match (st, next, NULL)) {
+                  /* Do not set `st->end_ptr_ptr' if some later invocation of the
                      same parentheses already has. */
 
-                  if (End_Ptr_Ptr [no] == NULL) End_Ptr_Ptr [no] = save;
+                  if (st->end_ptr_ptr [no] == NULL) st->end_ptr_ptr [no] = save;
 
                   MATCH_RETURN (1);
                } else {
@@ -3731,14 +5159,14 @@ static int match (unsigned char *prog, int *branch_index_param) {
  * Returns the actual number of matches.
  *----------------------------------------------------------------------*/
 
-static unsigned long greedy (unsigned char *p, long max) {
+static unsigned long greedy (exec_state *st, unsigned char *p, long max) {
 
    register unsigned char *input_str;
    register unsigned char *operand;
    register unsigned long  count = REG_ZERO;
    register unsigned long  max_cmp;
 
-   input_str = Reg_Input;
+   input_str = st->reg_input;
    operand   = OPERAND (p); /* Literal char or start of class characters. */
    max_cmp   = (max > 0) ? (unsigned long) max : ULONG_MAX;
 
@@ -3810,7 +5238,7 @@ static unsigned long greedy (unsigned char *p, long max) {
                          NOTE: '\n' and '\0' are always word delimiters. */
 
          while (count < max_cmp                   && 
-                Current_Delimiters [ *input_str ] &&
+                st->current_delimiters [ *input_str ] &&
                 !AT_END_OF_STRING(input_str)) {
             count++; input_str++;
          }
@@ -3821,7 +5249,7 @@ static unsigned long greedy (unsigned char *p, long max) {
                          NOTE: '\n' and '\0' are always word delimiters. */
 
          while (count < max_cmp                    && 
-                !Current_Delimiters [ *input_str ] &&
+                !st->current_delimiters [ *input_str ] &&
                 !AT_END_OF_STRING(input_str)) {
             count++; input_str++;
          }
@@ -3944,7 +5372,7 @@ static unsigned long greedy (unsigned char *p, long max) {
 
    /* Point to character just after last matched character. */
 
-   Reg_Input = input_str;
+   st->reg_input = input_str;
 
    return (count);
 }
@@ -4039,7 +5467,7 @@ Boolean SubstituteRE(const regexp* prog, const char* source, char* dest,
          } else if ((test = literal_escape (*src)) != '\0') {
             c = test; src++;
 
-         } else if ((test = numeric_escape (*src, &src_alias)) != '\0') {
+         } else if ((test = numeric_escape (NULL, *src, &src_alias)) != '\0') {
             c   = test;
             src = src_alias; src++;
 
@@ -24,6 +24,8 @@
 *                                                                              *
 *******************************************************************************/
 
+#include "textScan.h"
+
 #include <X11/Intrinsic.h>
 
 #ifndef NEDIT_REGULAREXP_H_INCLUDED
@@ -49,6 +51,19 @@ typedef struct regexp {
                                Used by syntax highlighting only. */
    char  match_start;       /* Internal use only. */
    char  anchor;            /* Internal use only. */
+   int   literal;           /* Internal use only: offset into `program' of
+                               a string every match contains, */
+   int   literal_len;       /* its length (0 if there is none), */
+   long  literal_min;       /* and how far from the start of a match */
+   long  literal_max;       /* it can be (-1 if there is no limit). */
+   char  use_first_chars;   /* Internal use only: a match must start with */
+   scanCharSet first_chars; /* one of these characters. */
+   int   nfa_states;        /* Internal use only: number of states of the
+                               automaton matching without back tracking (0
+                               if back tracking is needed), */
+   int   nfa_table;         /* offset into `program' of their numbering, */
+   int   nfa_top_branch;    /* and of the node deciding `top_branch'. */
+   long  size;              /* Internal use only: bytes allocated. */
    char  program [1];       /* Unwarranted chumminess with compiler. */
 } regexp;
 
@@ -86,6 +101,40 @@ int ExecRE (
                                    \0 is assumed to be the boundary if not
                                    set. Lookahead can cross the boundary. */
 
+/* Work variables for compiling and matching regular expressions, for threads
+   which compile at the same time (`CompileRE' uses a single static area). */
+
+typedef struct regexContext regexContext;
+
+regexContext * CreateREContext (void);
+
+void FreeREContext (regexContext *context);
+
+/* `CompileRE' and `ExecRE' with the work variables in `context' */
+
+regexp * CompileREContext (
+   regexContext *context,
+   const char   *exp,
+   char        **errorText,    /* Lasts until `context' is next used to
+                                  compile. */
+   int           defaultFlags);
+
+int ExecREContext (
+   regexContext *context,
+   regexp       *prog,
+   const char   *string,
+   const char   *end,
+   int           reverse,
+   char          prev_char,
+   char          succ_char,
+   const char   *delimiters,
+   const char   *look_behind_to,
+   const char   *match_to);
+
+/* Copy a compiled regex, for matching in another thread. */
+
+regexp * CopyRE (const regexp *prog);
+
 /* Perform substitutions after a `regexp' match. */
 Boolean SubstituteRE(const regexp* prog, const char* source, char* dest,
         int max);
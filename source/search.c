@@ -33,6 +33,7 @@
 #include "search.h"
 #include "regularExp.h"
 #include "textBuf.h"
+#include "litSearch.h"
 #include "text.h"
 #include "nedit.h"
 #include "server.h"
@@ -61,6 +62,7 @@
 #include <wctype.h>
 #include <wchar.h>
 #include <errno.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/param.h>
 #include <Xm/Xm.h>
@@ -78,6 +80,7 @@
 #include <Xm/Text.h>
 #include <Xm/ToggleB.h>
 #include <Xm/List.h>
+#include <Xm/MessageB.h>
 #include <X11/Xatom.h>		/* for getting selection */
 #include <X11/keysym.h>
 #include <X11/X.h>		/* " " */
@@ -86,6 +89,21 @@
 #include "../debug.h"
 #endif
 
+/* Smallest and largest pieces of a string to find the length of at a time
+   when searching forward to its end for a literal string (see findLiteral) */
+#define LITERAL_SEARCH_MIN_CHUNK 256
+#define LITERAL_SEARCH_CHUNK 65536
+
+/* How often (ms) a multi-file Replace All checks on its worker threads, and
+   how many checks before it puts up a progress dialog */
+#define REPLACE_PROGRESS_INTERVAL 100
+#define REPLACE_PROGRESS_DELAY 5
+
+/* Number of compiled regular expressions kept (see getCompiledRE) */
+#define REGEX_CACHE_SIZE 16
+
+/* Replace All works through buffers larger than this a piece at a time */
+#define REPLACE_ALL_CHUNK 1048576
 
 int NHist = 0;
 time_t lastSearchdbModTime = 0;
@@ -113,12 +131,86 @@ typedef struct {
     int cbCount;
 } SearchSelectedCallData;
 
+/* One of the pieces a buffer is split into by searchBuffer */
+typedef struct {
+    const char *text;	    /* null terminated text of the piece */
+    ssize_t offset;	    /* buffer position of the start of text */
+    ssize_t length;	    /* length of text */
+    ssize_t ownStart, ownEnd; /* matches starting within this range of buffer
+    			       positions are found in this piece */
+} searchPiece;
+
+/* One window's share of a multi-file Replace All */
+typedef struct {
+    WindowInfo *window;
+    ssize_t length;		/* length of the buffer when copied */
+    unsigned long modCount;	/* modification count of the buffer when
+    				   copied (see textBuffer) */
+    char *text;			/* copy of the buffer text */
+    char *delimiters;		/* word delimiters of the window */
+    char *result;		/* from ReplaceAllInString */
+    ssize_t copyStart, copyEnd, replacementLen;
+} replaceAllJob;
+
+/* State shared by replaceAllInWindows and its worker threads.  The lock
+   guards the job and thread counts and the cancelled flag */
+typedef struct {
+    pthread_mutex_t lock;
+    replaceAllJob *jobs;
+    int nJobs, nextJob, nDone, nRunning;
+    int cancelled;
+    int finished;
+    const char *searchString, *replaceString;
+    int searchType;
+    WindowInfo *window;		/* window the progress dialog is for */
+    XtAppContext context;
+    Widget dialog;
+    XtIntervalId timeoutID;
+    int nTicks;
+} replaceAllWork;
+
+/* A compiled regular expression (see getCompiledRE) */
+typedef struct {
+    char *pattern;
+    int defaultFlags;
+    regexp *compiledRE;
+} cachedRegex;
+
+/* Most recently used compiled regular expressions, and how often they were
+   found in the cache.  Each thread has its own, since the results of a match
+   are kept in the compiled expression (see getCompiledRE) */
+typedef struct {
+    regexContext *context;
+    cachedRegex entries[REGEX_CACHE_SIZE];
+    int nCached;
+    unsigned long hits, misses;
+} regexCache;
+
+/* A compiled literal search string (see getLiteralPattern) */
+typedef struct {
+    litPattern *pat;
+    char *string;
+    int caseSense;
+    int refCount;
+} literalPattern;
+
+/* Multi-file Replace All job whose result ReplaceAll is to use, rather than
+   searching the buffer (see replaceAllInWindows) */
+static replaceAllJob *PendingReplaceAll = NULL;
+
 /* History mechanism for search and replace strings */
 static char *SearchHistory[MAX_SEARCH_HISTORY];
 static char *ReplaceHistory[MAX_SEARCH_HISTORY];
 static int SearchTypeHistory[MAX_SEARCH_HISTORY];
 static int HistStart = 0;
 
+/* Guards the compiled literal search string kept by getLiteralPattern */
+static pthread_mutex_t literalPatternLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Key for finding the calling thread's regexCache */
+static pthread_key_t RegexCacheKey;
+static pthread_once_t RegexCacheKeyOnce = PTHREAD_ONCE_INIT;
+
 static int textFieldNonEmpty(Widget w);
 static void setTextField(WindowInfo* window, Time time, Widget textField);
 static void getSelectionCB(Widget w, XtPointer selectionInfo, Atom *selection,
@@ -170,6 +262,18 @@ static void replaceMultiFileCB(Widget w, WindowInfo *window,
 static void rMultiFileReplaceCB(Widget w, WindowInfo *window,  
        XmAnyCallbackStruct * callData);
 static void rMultiFileCancelCB(Widget w, WindowInfo *window, caddr_t callData);
+static int replaceAllInWindows(WindowInfo *window, WindowInfo **windows,
+	int nWindows, const char *searchString, const char *replaceString,
+	int searchType, XEvent *event);
+static void *replaceAllWorker(void *data);
+static void replaceAllProgressProc(XtPointer clientData, XtIntervalId *id);
+static void replaceAllCancelCB(Widget w, XtPointer clientData,
+	XtPointer callData);
+static void replaceAllDialogDestroyCB(Widget w, XtPointer clientData,
+	XtPointer callData);
+static int compareJobLengths(const void *job1, const void *job2);
+static ssize_t replaceAllChunked(WindowInfo *window, const char *searchString,
+	const char *replaceString, int searchType);
 static void rMultiFileSelectAllCB(Widget w, WindowInfo *window, 
        XmAnyCallbackStruct *callData);
 static void rMultiFileDeselectAllCB(Widget w, WindowInfo *window, 
@@ -205,30 +309,50 @@ static void iSearchTextValueChangedCB(Widget w, WindowInfo *window,
 static void iSearchTextKeyEH(Widget w, WindowInfo *window,
 	XKeyEvent *event, Boolean *continueDispatch);
 static int searchLiteral(const char *string, const char *searchString, int caseSense, 
-	int direction, int wrap, int beginPos, int *startPos, int *endPos,
-	int *searchExtentBW, int *searchExtentFW);
+	int direction, int wrap, ssize_t beginPos, ssize_t *startPos, ssize_t *endPos,
+	ssize_t *searchExtentBW, ssize_t *searchExtentFW);
 static int searchLiteralWord(const char *string, const char *searchString, int caseSense,
- 	int direction, int wrap, int beginPos, int *startPos, int *endPos, 
+ 	int direction, int wrap, ssize_t beginPos, ssize_t *startPos, ssize_t *endPos, 
         const char * delimiters);
+static int findLiteral(const litPattern *pat, const char *string,
+	int direction, ssize_t from, ssize_t limit, ssize_t *startPos, ssize_t *endPos);
+static literalPattern *getLiteralPattern(const char *searchString,
+	int caseSense);
+static void releaseLiteralPattern(literalPattern *pat);
+static void freeLiteralPattern(literalPattern *pat);
+static regexp *getCompiledRE(const char *searchString, int defaultFlags);
+static regexCache *getRegexCache(void);
+static void createRegexCacheKey(void);
+static void freeRegexCache(void *data);
 static int searchRegex(const char *string, const char *searchString, int direction,
-	int wrap, int beginPos, int *startPos, int *endPos, int *searchExtentBW,
-	int *searchExtentFW, const char *delimiters, int defaultFlags);
+	int wrap, ssize_t beginPos, ssize_t *startPos, ssize_t *endPos, ssize_t *searchExtentBW,
+	ssize_t *searchExtentFW, const char *delimiters, int defaultFlags);
+static int searchBuffer(textBuffer *buf, const char *fileString,
+	const char *searchString, int direction, int searchType, int wrap,
+	ssize_t beginPos, ssize_t *startPos, ssize_t *endPos, ssize_t *searchExtentBW,
+	ssize_t *searchExtentFW, const char *delimiters);
+static int searchPieces(const searchPiece *pieces, const char *searchString,
+	int direction, int searchType, ssize_t from, ssize_t limit, ssize_t *startPos,
+	ssize_t *endPos, ssize_t *searchExtentBW, ssize_t *searchExtentFW,
+	const char *delimiters);
 static int forwardRegexSearch(const char *string, const char *searchString, int wrap,
-	int beginPos, int *startPos, int *endPos, int *searchExtentBW,
-        int *searchExtentFW, const char *delimiters, int defaultFlags);
+	ssize_t beginPos, ssize_t *startPos, ssize_t *endPos, ssize_t *searchExtentBW,
+        ssize_t *searchExtentFW, const char *delimiters, int defaultFlags);
 static int backwardRegexSearch(const char *string, const char *searchString, int wrap,
-	int beginPos, int *startPos, int *endPos, int *searchExtentBW,
-        int *searchExtentFW, const char *delimiters, int defaultFlags);
+	ssize_t beginPos, ssize_t *startPos, ssize_t *endPos, ssize_t *searchExtentBW,
+        ssize_t *searchExtentFW, const char *delimiters, int defaultFlags);
 static void resetFindTabGroup(WindowInfo *window);
+static ssize_t max(ssize_t i1, ssize_t i2);
+static ssize_t min(ssize_t i1, ssize_t i2);
 static void resetReplaceTabGroup(WindowInfo *window);
 static int searchMatchesSelection(WindowInfo *window, const char *searchString,
-	int searchType, int *left, int *right, int *searchExtentBW, 
-	int *searchExtentFW);
+	int searchType, ssize_t *left, ssize_t *right, ssize_t *searchExtentBW, 
+	ssize_t *searchExtentFW);
 static int findMatchingChar(WindowInfo *window, char toMatch,
 	void *toMatchStyle, int charPos, int startLimit, int endLimit, 
 	int *matchPos);
 static Boolean replaceUsingRE(const char* searchStr, const char* replaceStr,
-        const char* sourceStr, int beginPos, char* destStr, int maxDestLen,
+        const char* sourceStr, ssize_t beginPos, char* destStr, int maxDestLen,
         int prevChar, const char* delimiters, int defaultFlags);
 static void enableFindAgainCmds(void);
 static void saveSearchHistory(const char *searchString,
@@ -252,21 +376,21 @@ static void replaceCaseToggleCB(Widget w, XtPointer clientData,
 static void iSearchCaseToggleCB(Widget w, XtPointer clientData, 
 	XtPointer callData);
 static void iSearchTryBeepOnWrap(WindowInfo *window, int direction, 
-      	int beginPos, int startPos); 
+      	ssize_t beginPos, ssize_t startPos); 
 static void iSearchRecordLastBeginPos(WindowInfo *window, int direction, 
-	int initPos); 
+	ssize_t initPos); 
 static Boolean prefOrUserCancelsSubst(const Widget parent,
         const Display* display);
 
-static int translateEscPos(EscSeqArray *array, int pos);
+static ssize_t translateEscPos(EscSeqArray *array, ssize_t pos);
 static void translatePosAndRestoreBuf(
         textBuffer *buf,
         EscSeqArray *array,
         int found,
-        int *begin,
-        int *end,
-        int *extentBW,
-        int *extentFW);
+        ssize_t *begin,
+        ssize_t *end,
+        ssize_t *extentBW,
+        ssize_t *extentFW);
 
 typedef struct _charMatchTable {
     char c;
@@ -413,8 +537,8 @@ static void initToggleButtons(int searchType, Widget regexToggle,
 */
 static int selectionSpansMultipleLines(WindowInfo *window)
 {
-    int selStart, selEnd, isRect, rectStart, rectEnd, lineStartStart,
-        lineStartEnd;
+    ssize_t selStart, selEnd, lineStartStart, lineStartEnd;
+    int isRect, rectStart, rectEnd;
     int lineWidth;
     textDisp *textD;
     
@@ -1919,10 +2043,9 @@ static void rMultiFileReplaceCB(Widget w, WindowInfo *window,
 {
     char 	searchString[SEARCHMAX], replaceString[SEARCHMAX];
     int 	direction, searchType;
-    char 	*params[4];
     int 	nSelected, i;
-    WindowInfo 	*writableWin;
-    Bool 	replaceFailed, noWritableLeft;
+    WindowInfo 	*writableWin, **selected;
+    Bool 	replaceFailed, noWritableLeft, cancelled;
 
     window = WidgetToWindow(w);
     nSelected = 0;
@@ -1963,36 +2086,40 @@ static void rMultiFileReplaceCB(Widget w, WindowInfo *window,
 
     /* Set the initial focus of the dialog back to the search string */
     resetReplaceTabGroup(window);
-    
-    params[0] = searchString;
-    params[1] = replaceString;
-    params[2] = searchTypeArg(searchType);
 
     replaceFailed = True;
     noWritableLeft = True;
-    /* Perform the replacements and mark the selected files (history) */
+    /* Mark the selected files (history), and find those still writable.
+       If the file status has changed or the file was locked in the mean time
+       (possible due to Lesstif modal dialog bug), we just skip the window. */
+    selected = (WindowInfo **)NEditMalloc(sizeof(WindowInfo *) *
+	    window->nWritableWindows);
+    nSelected = 0;
     for (i=0; i<window->nWritableWindows; ++i) {
 	writableWin = window->writableWindows[i];
 	if (XmListPosSelected(window->replaceMultiFileList, i+1)) {
-	/* First check again whether the file is still writable. If the
-	   file status has changed or the file was locked in the mean time
-	   (possible due to Lesstif modal dialog bug), we just skip the 
-	   window. */
 	    if (!IS_ANY_LOCKED(writableWin->lockReasons)) {
 		noWritableLeft = False;
 		writableWin->multiFileReplSelected = True;
-		writableWin->multiFileBusy = True; /* Avoid multi-beep/dialog */
-		writableWin->replaceFailed = False;
-		XtCallActionProc(writableWin->lastFocus, "replace_all",
-		    callData->event, params, 3);
-		writableWin->multiFileBusy = False;
-		if (!writableWin->replaceFailed)
-		    replaceFailed = False;
+		selected[nSelected++] = writableWin;
 	    }
 	} else {
 	    writableWin->multiFileReplSelected = False;
 	}
-    }                          
+    }
+    
+    /* Perform the replacements */
+    cancelled = False;
+    if (nSelected > 0) {
+	cancelled = !replaceAllInWindows(window, selected, nSelected,
+		searchString, replaceString, searchType, callData->event);
+	for (i=0; i<nSelected; i++)
+	    if (IsValidWindow(selected[i]) && !selected[i]->replaceFailed)
+		replaceFailed = False;
+    }
+    NEditFree(selected);
+    if (!IsValidWindow(window))
+    	return;
         
     if (!XmToggleButtonGetState(window->replaceKeepBtn)) {
        /* Pop down both replace dialogs. */
@@ -2004,7 +2131,7 @@ static void rMultiFileReplaceCB(Widget w, WindowInfo *window,
     
     /* We suppressed multiple beeps/dialogs. If there wasn't any file in
        which the replacement succeeded, we should still warn the user */
-    if (replaceFailed) {
+    if (replaceFailed && !cancelled) {
 	if (GetPrefSearchDlogs()) {
 	    if (noWritableLeft) {
 		DialogF(DF_INF, window->shell, 1, "Read-only Files",
@@ -2019,6 +2146,254 @@ static void rMultiFileReplaceCB(Widget w, WindowInfo *window,
     }
 }
 
+/*
+** Do a Replace All in each of "nWindows" "windows" for a multi-file
+** replacement.  The searches, which is where almost all of the time goes,
+** are done on copies of the buffer text by worker threads (one per
+** processor), while this thread keeps the display up to date and, if the
+** work takes a while, puts up a dialog showing progress with a button to
+** cancel it.  The results are applied to the buffers here, through the
+** replace_all action, as a Replace All in each window would be, so that they
+** are recorded for undo and by Learn.  Each worker compiles regular
+** expressions for itself (see getCompiledRE), since a compiled expression
+** holds the results of a match.
+**
+** Sets replaceFailed for each window in which nothing was replaced, and
+** returns False if the user cancelled, in which case no window is changed.
+*/
+static int replaceAllInWindows(WindowInfo *window, WindowInfo **windows,
+	int nWindows, const char *searchString, const char *replaceString,
+	int searchType, XEvent *event)
+{
+    XtAppContext context = XtWidgetToApplicationContext(window->shell);
+    replaceAllWork work;
+    replaceAllJob *job;
+    pthread_t *threads;
+    XEvent xev;
+    const char *delimiters;
+    char *params[3];
+    int i, nThreads, nStarted;
+    
+    saveSearchHistory(searchString, replaceString, searchType, FALSE);
+    
+    /* Copy the text of each window, so that the searches don't depend on
+       the buffers staying put while the workers run.  The largest files
+       go first, to keep the workers evenly loaded to the end */
+    work.jobs = (replaceAllJob *)NEditMalloc(sizeof(replaceAllJob) * nWindows);
+    for (i=0; i<nWindows; i++) {
+    	job = &work.jobs[i];
+	job->window = windows[i];
+	job->length = windows[i]->buffer->length;
+	job->modCount = windows[i]->buffer->modCount;
+	job->text = BufGetAll(windows[i]->buffer);
+	delimiters = GetWindowDelimiters(windows[i]);
+	job->delimiters = delimiters == NULL ? NULL : NEditStrdup(delimiters);
+	job->result = NULL;
+    }
+    qsort(work.jobs, nWindows, sizeof(replaceAllJob), compareJobLengths);
+    pthread_mutex_init(&work.lock, NULL);
+    work.nJobs = nWindows;
+    work.nextJob = 0;
+    work.nDone = 0;
+    work.cancelled = False;
+    work.finished = False;
+    work.searchString = searchString;
+    work.replaceString = replaceString;
+    work.searchType = searchType;
+    work.window = window;
+    work.context = context;
+    work.dialog = NULL;
+    work.nTicks = 0;
+    
+    /* Start the workers.  If none can be started, do the work here */
+    nThreads = min(GetNumProcessors(), nWindows);
+    threads = (pthread_t *)NEditMalloc(sizeof(pthread_t) * nThreads);
+    work.nRunning = nThreads;
+    for (nStarted=0; nStarted<nThreads; nStarted++)
+	if (pthread_create(&threads[nStarted], NULL, replaceAllWorker,
+		&work) != 0)
+	    break;
+    if (nStarted < nThreads) {
+	pthread_mutex_lock(&work.lock);
+	work.nRunning -= nThreads - nStarted;
+	pthread_mutex_unlock(&work.lock);
+    }
+    if (nStarted == 0) {
+	work.nRunning = 1;
+	replaceAllWorker(&work);
+    } else {
+	/* Keep handling events until the workers are done.  X events are
+	   taken one at a time, so the server can see its requests, and
+	   otherwise this waits for the progress timer */
+	work.timeoutID = XtAppAddTimeOut(context, REPLACE_PROGRESS_INTERVAL,
+		replaceAllProgressProc, &work);
+	while (!work.finished) {
+	    if (XtAppPending(context) & XtIMXEvent) {
+		XtAppNextEvent(context, &xev);
+		ServerDispatchEvent(&xev);
+	    } else
+		XtAppProcessEvent(context, XtIMTimer | XtIMAlternateInput);
+	}
+	for (i=0; i<nStarted; i++)
+	    pthread_join(threads[i], NULL);
+    }
+    NEditFree(threads);
+    pthread_mutex_destroy(&work.lock);
+    if (work.dialog != NULL)
+    	XtDestroyWidget(work.dialog);
+    
+    /* Apply the results.  Skip windows which were closed or locked while
+       the workers were running (the dialog is modal, but it's still
+       possible, for example through the server).  Windows changed in the
+       mean time are searched again, by ReplaceAll, in place of using the
+       result of the worker */
+    params[0] = (char *)searchString;
+    params[1] = (char *)replaceString;
+    params[2] = searchTypeArg(searchType);
+    for (i=0; i<nWindows; i++) {
+    	job = &work.jobs[i];
+	if (!IsValidWindow(job->window)) {
+	    NEditFree(job->result);
+	} else if (work.cancelled ||
+		IS_ANY_LOCKED(job->window->lockReasons)) {
+	    job->window->replaceFailed = True;
+	    NEditFree(job->result);
+	} else {
+	    if (job->window->buffer->modCount == job->modCount)
+	    	PendingReplaceAll = job;
+	    job->window->multiFileBusy = True; /* Avoid multi-beep/dialog */
+	    job->window->replaceFailed = False;
+	    XtCallActionProc(job->window->lastFocus, "replace_all", event,
+		    params, 3);
+	    PendingReplaceAll = NULL;
+	    if (IsValidWindow(job->window))
+		job->window->multiFileBusy = False;
+	    NEditFree(job->result);
+	}
+	NEditFree(job->text);
+	NEditFree(job->delimiters);
+    }
+    NEditFree(work.jobs);
+    return !work.cancelled;
+}
+
+/*
+** Worker thread for replaceAllInWindows, takes jobs from "data" (a
+** replaceAllWork structure) until all have been taken, or the user cancels
+*/
+static void *replaceAllWorker(void *data)
+{
+    replaceAllWork *work = (replaceAllWork *)data;
+    replaceAllJob *job;
+    
+    for (;;) {
+	pthread_mutex_lock(&work->lock);
+	if (work->cancelled || work->nextJob == work->nJobs) {
+	    work->nRunning--;
+	    pthread_mutex_unlock(&work->lock);
+	    return NULL;
+	}
+	job = &work->jobs[work->nextJob++];
+	pthread_mutex_unlock(&work->lock);
+	
+	job->result = ReplaceAllInString(job->text, work->searchString,
+		work->replaceString, work->searchType, &job->copyStart,
+		&job->copyEnd, &job->replacementLen, job->delimiters);
+	
+	pthread_mutex_lock(&work->lock);
+	work->nDone++;
+	pthread_mutex_unlock(&work->lock);
+    }
+}
+
+/*
+** Timer procedure for replaceAllInWindows, checks whether the workers are
+** done, and puts up and updates the progress dialog
+*/
+static void replaceAllProgressProc(XtPointer clientData, XtIntervalId *id)
+{
+    replaceAllWork *work = (replaceAllWork *)clientData;
+    Arg args[6];
+    int argcnt, nDone, nRunning;
+    char message[100];
+    XmString st1;
+    
+    pthread_mutex_lock(&work->lock);
+    nDone = work->nDone;
+    nRunning = work->nRunning;
+    pthread_mutex_unlock(&work->lock);
+    if (nRunning == 0) {
+	work->finished = True;
+	return;
+    }
+    
+    if (work->cancelled)
+	snprintf(message, sizeof(message), "Cancelling...");
+    else
+	snprintf(message, sizeof(message), "Replacing in %d of %d files...",
+		nDone + 1 > work->nJobs ? work->nJobs : nDone + 1,
+		work->nJobs);
+    if (work->dialog == NULL && ++work->nTicks >= REPLACE_PROGRESS_DELAY &&
+	    IsValidWindow(work->window)) {
+	argcnt = 0;
+	XtSetArg(args[argcnt], XmNdialogType, XmDIALOG_WORKING); argcnt++;
+	XtSetArg(args[argcnt], XmNdialogStyle,
+		XmDIALOG_FULL_APPLICATION_MODAL); argcnt++;
+	XtSetArg(args[argcnt], XmNtitle, "Multi-File Replacement"); argcnt++;
+	XtSetArg(args[argcnt], XmNmessageString, st1=MKSTRING(message));
+		argcnt++;
+	work->dialog = CreateMessageDialog(work->window->shell,
+		"replaceProgress", args, argcnt);
+	XmStringFree(st1);
+	XtUnmanageChild(XmMessageBoxGetChild(work->dialog,
+		XmDIALOG_OK_BUTTON));
+	XtUnmanageChild(XmMessageBoxGetChild(work->dialog,
+		XmDIALOG_HELP_BUTTON));
+	XtAddCallback(work->dialog, XmNcancelCallback, replaceAllCancelCB,
+		work);
+	XtAddCallback(work->dialog, XmNdestroyCallback,
+		replaceAllDialogDestroyCB, work);
+	ManageDialogCenteredOnPointer(work->dialog);
+    } else if (work->dialog != NULL) {
+	XtVaSetValues(work->dialog, XmNmessageString, st1=MKSTRING(message),
+		NULL);
+	XmStringFree(st1);
+    }
+    work->timeoutID = XtAppAddTimeOut(work->context,
+	    REPLACE_PROGRESS_INTERVAL, replaceAllProgressProc, work);
+}
+
+static void replaceAllCancelCB(Widget w, XtPointer clientData,
+	XtPointer callData)
+{
+    replaceAllWork *work = (replaceAllWork *)clientData;
+    
+    pthread_mutex_lock(&work->lock);
+    work->cancelled = True;
+    pthread_mutex_unlock(&work->lock);
+}
+
+/*
+** The progress dialog is destroyed with the window it belongs to, which may
+** be closed while the workers run
+*/
+static void replaceAllDialogDestroyCB(Widget w, XtPointer clientData,
+	XtPointer callData)
+{
+    ((replaceAllWork *)clientData)->dialog = NULL;
+}
+
+/*
+** Comparison function for sorting replaceAllInWindows jobs, largest first
+*/
+static int compareJobLengths(const void *job1, const void *job2)
+{
+    ssize_t len1 = ((const replaceAllJob *)job1)->length;
+    ssize_t len2 = ((const replaceAllJob *)job2)->length;
+    
+    return len1 < len2 ? 1 : (len1 > len2 ? -1 : 0);
+}
+
 static void rMultiFileCancelCB(Widget w, WindowInfo *window, caddr_t callData) 
 {
     window = WidgetToWindow(w);
@@ -2796,8 +3171,8 @@ int SearchAndSelectSame(WindowInfo *window, int direction, int searchWrap)
 int SearchAndSelect(WindowInfo *window, int direction, const char *searchString,
 	int searchType, int searchWrap)
 {
-    int startPos, endPos;
-    int beginPos, cursorPos, selStart, selEnd;
+    ssize_t startPos, endPos;
+    ssize_t beginPos, cursorPos, selStart, selEnd;
     int movedFwd = 0;
 
     /* Save a copy of searchString in the search history */
@@ -3028,7 +3403,7 @@ void EndISearch(WindowInfo *window)
 ** search begin position for incremental searches.
 */
 static void iSearchRecordLastBeginPos(WindowInfo *window, int direction, 
-	int initPos) 
+	ssize_t initPos) 
 {
     window->iSearchLastBeginPos = initPos;
     if (direction == SEARCH_BACKWARD) 
@@ -3045,7 +3420,7 @@ static void iSearchRecordLastBeginPos(WindowInfo *window, int direction,
 int SearchAndSelectIncremental(WindowInfo *window, int direction,
 	const char *searchString, int searchType, int searchWrap, int continued)
 {
-    int beginPos, startPos, endPos;
+    ssize_t beginPos, startPos, endPos;
 
     /* If there's a search in progress, start the search from the original
        starting position, otherwise search from the cursor position. */
@@ -3060,7 +3435,7 @@ int SearchAndSelectIncremental(WindowInfo *window, int direction,
        clear the selection, set the cursor back to what would be the 
        beginning of the search, and return. */
     if(searchString[0] == 0) {
-     	int beepBeginPos = (direction == SEARCH_BACKWARD) ? beginPos-1:beginPos;
+     	ssize_t beepBeginPos = (direction == SEARCH_BACKWARD) ? beginPos-1:beginPos;
       	iSearchTryBeepOnWrap(window, direction, beepBeginPos, beepBeginPos);
 	iSearchRecordLastBeginPos(window, direction, window->iSearchStartPos);
 	BufUnselect(window->buffer);
@@ -3694,8 +4069,8 @@ int ReplaceFindSame(WindowInfo *window, int direction, int searchWrap)
 int ReplaceAndSearch(WindowInfo *window, int direction, const char *searchString,
                      const char *replaceString, int searchType, int searchWrap)
 {
-    int startPos = 0, endPos = 0, replaceLen = 0;
-    int searchExtentBW, searchExtentFW;
+    ssize_t startPos = 0, endPos = 0, replaceLen = 0;
+    ssize_t searchExtentBW, searchExtentFW;
     int replaced;
 
     /* Save a copy of search and replace strings in the search history */
@@ -3746,9 +4121,9 @@ int ReplaceAndSearch(WindowInfo *window, int direction, const char *searchString
 int SearchAndReplace(WindowInfo *window, int direction, const char *searchString,
 	const char *replaceString, int searchType, int searchWrap)
 {
-    int startPos, endPos, replaceLen, searchExtentBW, searchExtentFW;
+    ssize_t startPos, endPos, replaceLen, searchExtentBW, searchExtentFW;
     int found;
-    int beginPos, cursorPos;
+    ssize_t beginPos, cursorPos;
     
     /* Save a copy of search and replace strings in the search history */
     saveSearchHistory(searchString, replaceString, searchType, FALSE);
@@ -3876,9 +4251,10 @@ static Boolean prefOrUserCancelsSubst(const Widget parent,
 void ReplaceInSelection(const WindowInfo* window, const char* searchString,
         const char* replaceString, int searchType)
 {
-    int selStart, selEnd, beginPos, startPos, endPos, realOffset, replaceLen;
-    int found, isRect, rectStart, rectEnd, lineStart, cursorPos;
-    int extentBW, extentFW;
+    ssize_t selStart, selEnd;
+    ssize_t beginPos, startPos, endPos, realOffset, replaceLen;
+    ssize_t lineStart, cursorPos, extentBW, extentFW;
+    int found, isRect, rectStart, rectEnd;
     char *fileString;
     textBuffer *tempBuf;
     Boolean substSuccess = False;
@@ -4044,8 +4420,10 @@ int ReplaceAll(WindowInfo *window, const char *searchString,
         const char *replaceString, int searchType)
 {
     const char *fileString;
-    char *newFileString;
-    int copyStart, copyEnd, replacementLen;
+    char *newFileString = NULL;
+    ssize_t copyStart, copyEnd, replacementLen;
+    ssize_t nReplaced = 0;
+    int chunked, presearched;
     
     /* reject empty string */
     if (*searchString == '\0')
@@ -4054,14 +4432,33 @@ int ReplaceAll(WindowInfo *window, const char *searchString,
     /* save a copy of search and replace strings in the search history */
     saveSearchHistory(searchString, replaceString, searchType, FALSE);
 
-    /* view the entire text buffer from the text area widget as a string */
-    fileString = BufAsString(window->buffer);
+    /* Large buffers are done a piece at a time, rather than building a
+       substituted copy of the whole text (see replaceAllChunked).  In a
+       multi-file replacement, the substitution may already have been done
+       on a copy of the text (see replaceAllInWindows) */
+    presearched = PendingReplaceAll != NULL &&
+	    PendingReplaceAll->window == window;
+    chunked = !presearched && !isRegexType(searchType) &&
+	    window->buffer->length > REPLACE_ALL_CHUNK;
+    if (presearched) {
+	newFileString = PendingReplaceAll->result;
+	PendingReplaceAll->result = NULL;
+	copyStart = PendingReplaceAll->copyStart;
+	copyEnd = PendingReplaceAll->copyEnd;
+	replacementLen = PendingReplaceAll->replacementLen;
+    } else if (chunked) {
+	nReplaced = replaceAllChunked(window, searchString, replaceString,
+		searchType);
+    } else {
+	/* view the entire text buffer from the text area widget as a string */
+	fileString = BufAsString(window->buffer);
 
-    newFileString = ReplaceAllInString(fileString, searchString, replaceString,
-	    searchType, &copyStart, &copyEnd, &replacementLen,
-	    GetWindowDelimiters(window));
+	newFileString = ReplaceAllInString(fileString, searchString,
+		replaceString, searchType, &copyStart, &copyEnd,
+		&replacementLen, GetWindowDelimiters(window));
+    }
 
-    if (newFileString == NULL) {
+    if (chunked ? nReplaced == 0 : newFileString == NULL) {
         if (window->multiFileBusy) {
             window->replaceFailed = TRUE; /* only needed during multi-file 
                                              replacements */
@@ -4078,6 +4475,8 @@ int ReplaceAll(WindowInfo *window, const char *searchString,
     	    XBell(TheDisplay, 0);
 	return FALSE;
     }
+    if (chunked)
+	return TRUE;
     
     /* replace the contents of the text widget with the substituted text */
     BufReplace(window->buffer, copyStart, copyEnd, newFileString);
@@ -4089,6 +4488,115 @@ int ReplaceAll(WindowInfo *window, const char *searchString,
     return TRUE;	
 }    
 
+/*
+** Replace All for large buffers.  Rather than building a substituted copy of
+** all of the text, which with the buffer itself and the undo information
+** needs around three times the memory of the text, go through the buffer
+** REPLACE_ALL_CHUNK bytes at a time, replacing the matches starting in each
+** chunk before moving on.  The replacements are made as a single batch, to be
+** undone together, and exposures are processed between chunks.
+**
+** Only for literal search types, where the length of a match is limited, and
+** the only text around a match which matters is the character on either
+** side.  Enough text past the end of each chunk is fetched to hold any match
+** starting in it, along with the character before the chunk as it was
+** before being replaced.  Returns the number of replacements made.
+*/
+static ssize_t replaceAllChunked(WindowInfo *window, const char *searchString,
+	const char *replaceString, int searchType)
+{
+    textBuffer *buf = window->buffer;
+    const char *delimiters = GetWindowDelimiters(window);
+    char *text, *outString, *fillPtr;
+    char leftContext = '\0';
+    ssize_t *matches = NULL;
+    ssize_t i, nFound, maxFound = 0, nReplaced = 0;
+    ssize_t margin, replaceLen;
+    int found;
+    ssize_t beginPos, startPos, endPos, limit, removeLen, newLen;
+    ssize_t chunkStart, textStart, textEnd, nextStart, cursorPos = -1;
+    
+    margin = 4 * strlen(searchString) + 1;
+    replaceLen = strlen(replaceString);
+    for (chunkStart = 0; chunkStart < buf->length; chunkStart = nextStart) {
+	AllWindowsBusy("Replacing...");
+	textStart = chunkStart > 0 ? chunkStart - 1 : 0;
+	nextStart = min(chunkStart + REPLACE_ALL_CHUNK, buf->length);
+	textEnd = min(nextStart + margin, buf->length);
+	text = BufGetRange(buf, textStart, textEnd);
+	if (chunkStart > 0)
+	    text[0] = leftContext;
+	
+	/* Find the matches starting in the chunk */
+	limit = nextStart - textStart;
+	beginPos = chunkStart - textStart;
+	nFound = 0;
+	removeLen = 0;
+	for (;;) {
+	    found = SearchString(text, searchString, SEARCH_FORWARD,
+		    searchType, FALSE, beginPos, &startPos, &endPos, NULL, NULL,
+		    delimiters);
+	    if (!found || startPos >= limit)
+		break;
+	    if (nFound == maxFound) {
+		maxFound = maxFound == 0 ? 256 : maxFound * 2;
+		matches = (ssize_t *)NEditRealloc(matches,
+			sizeof(ssize_t) * 2 * maxFound);
+	    }
+	    matches[2*nFound] = startPos;
+	    matches[2*nFound+1] = endPos;
+	    nFound++;
+	    removeLen += endPos - startPos;
+	    beginPos = endPos;
+	}
+	if (nFound == 0) {
+	    leftContext = text[nextStart - 1 - textStart];
+	    NEditFree(text);
+	    continue;
+	}
+	
+	/* Substitute the text between the first and last match */
+	startPos = matches[0];
+	endPos = matches[2*nFound-1];
+	newLen = endPos - startPos - removeLen + nFound * replaceLen;
+	outString = (char *)NEditMalloc(newLen + 1);
+	fillPtr = outString;
+	for (i=0; i<nFound; i++) {
+	    if (i > 0) {
+		memcpy(fillPtr, &text[matches[2*i-1]],
+			matches[2*i] - matches[2*i-1]);
+		fillPtr += matches[2*i] - matches[2*i-1];
+	    }
+	    memcpy(fillPtr, replaceString, replaceLen);
+	    fillPtr += replaceLen;
+	}
+	*fillPtr = '\0';
+	
+	/* The next chunk starts after the last match, if that runs past the
+	   end of this one, and moves with the replaced text */
+	if (textStart + endPos > nextStart)
+	    nextStart = textStart + endPos;
+	leftContext = text[nextStart - 1 - textStart];
+	NEditFree(text);
+	if (nReplaced == 0) {
+	    BufBeginModifyBatch(buf);
+	    window->undo_batch_single_cursor = True;
+	}
+	BufReplace(buf, textStart + startPos, textStart + endPos, outString);
+	NEditFree(outString);
+	nextStart += newLen - (endPos - startPos);
+	cursorPos = textStart + startPos + newLen;
+	nReplaced += nFound;
+    }
+    NEditFree(matches);
+    if (nReplaced > 0) {
+	BufEndModifyBatch(buf);
+	TextSetCursorPos(window->lastFocus, cursorPos);
+    }
+    AllWindowsUnbusy();
+    return nReplaced;
+}
+
 /*
 ** Replace all occurences of "searchString" in "inString" with "replaceString"
 ** and return an allocated string covering the range between the start of the
@@ -4096,13 +4604,14 @@ int ReplaceAll(WindowInfo *window, const char *searchString,
 ** replacement (returned in "copyEnd")
 */
 char *ReplaceAllInString(const char *inString, const char *searchString,
-	const char *replaceString, int searchType, int *copyStart,
-	int *copyEnd, int *replacementLength, const char *delimiters)
+	const char *replaceString, int searchType, ssize_t *copyStart,
+	ssize_t *copyEnd, ssize_t *replacementLength, const char *delimiters)
 {
-    int beginPos, startPos, endPos, lastEndPos;
-    int found, nFound, removeLen, replaceLen, copyLen, addLen;
+    ssize_t beginPos, startPos, endPos, lastEndPos;
+    ssize_t removeLen, replaceLen, copyLen, addLen, nFound;
+    int found;
     char *outString, *fillPtr;
-    int searchExtentBW, searchExtentFW;
+    ssize_t searchExtentBW, searchExtentFW;
     
     /* reject empty string */
     if (*searchString == '\0')
@@ -4197,7 +4706,7 @@ char *ReplaceAllInString(const char *inString, const char *searchString,
 ** the last startPos of the current incremental search.
 */
 static void iSearchTryBeepOnWrap(WindowInfo *window, int direction, 
-	int beginPos, int startPos) 
+	ssize_t beginPos, ssize_t startPos) 
 {
     if (GetPrefBeepOnSearchWrap()) {
         if (direction == SEARCH_FORWARD) {
@@ -4222,19 +4731,24 @@ static void iSearchTryBeepOnWrap(WindowInfo *window, int direction,
 ** Search the text in "window", attempting to match "searchString"
 */
 int SearchWindow(WindowInfo *window, int direction, const char *searchString,
-	int searchType, int searchWrap, int beginPos, int *startPos, 
-        int *endPos, int *extentBW, int *extentFW)
+	int searchType, int searchWrap, ssize_t beginPos, ssize_t *startPos, 
+        ssize_t *endPos, ssize_t *extentBW, ssize_t *extentFW)
 {
     const char *fileString;
-    int found, resp, fileEnd = window->buffer->length - 1, outsideBounds;
+    ssize_t fileEnd = window->buffer->length - 1;
+    int found, resp, outsideBounds;
     
     /* reject empty string */
     if (*searchString == '\0')
     	return FALSE;
 
-    /* get the entire text buffer from the text area widget */
-    EscSeqArray *esc;
-    fileString = BufAsStringCleaned(window->buffer, &esc);
+    /* Buffers with ANSI escape sequences are searched as a single string
+       with the sequences removed, others are searched in place (see
+       searchBuffer) */
+    EscSeqArray *esc = NULL;
+    fileString = NULL;
+    if (window->buffer->num_ansi_escpos != 0)
+        fileString = BufAsStringCleaned(window->buffer, &esc);
 
     /* If we're already outside the boundaries, we must consider wrapping
        immediately (Note: fileEnd+1 is a valid starting position. Consider
@@ -4253,9 +4767,9 @@ int SearchWindow(WindowInfo *window, int direction, const char *searchString,
        an incremental search is in progress.  A parameter would be better. */
     if (window->iSearchStartPos == -1) { /* normal search */
     	found = !outsideBounds &&
-		SearchString(fileString, searchString, direction, searchType,
-    	    	FALSE, beginPos, startPos, endPos, extentBW, extentFW,
-		GetWindowDelimiters(window));
+		searchBuffer(window->buffer, fileString, searchString,
+		direction, searchType, FALSE, beginPos, startPos, endPos,
+		extentBW, extentFW, GetWindowDelimiters(window));
     	/* Avoid Motif 1.1 bug by putting away search dialog before DialogF */
     	if (window->findDlog && XtIsManaged(window->findDlog) &&
     	    	!XmToggleButtonGetState(window->findKeepBtn))
@@ -4277,9 +4791,10 @@ int SearchWindow(WindowInfo *window, int direction, const char *searchString,
 			    return False;
 			}
 		    }
-		    found = SearchString(fileString, searchString, direction,
-			searchType, FALSE, 0, startPos, endPos, extentBW,
-			extentFW, GetWindowDelimiters(window));
+		    found = searchBuffer(window->buffer, fileString,
+			searchString, direction, searchType, FALSE, 0,
+			startPos, endPos, extentBW, extentFW,
+			GetWindowDelimiters(window));
 		} else if (direction == SEARCH_BACKWARD && beginPos != fileEnd) {
 		    if(GetPrefBeepOnSearchWrap()) {
 			XBell(TheDisplay, 0);
@@ -4292,9 +4807,10 @@ int SearchWindow(WindowInfo *window, int direction, const char *searchString,
 			    return False;
 			}
 		    }
-                    found = SearchString(fileString, searchString, direction,
-			searchType, FALSE, fileEnd + 1, startPos, endPos, extentBW,
-			extentFW, GetWindowDelimiters(window));
+                    found = searchBuffer(window->buffer, fileString,
+			searchString, direction, searchType, FALSE,
+			fileEnd + 1, startPos, endPos, extentBW, extentFW,
+			GetWindowDelimiters(window));
 		}
 	    }
             translatePosAndRestoreBuf(window->buffer, esc, found, startPos, endPos, extentBW, extentFW);
@@ -4315,8 +4831,8 @@ int SearchWindow(WindowInfo *window, int direction, const char *searchString,
             outsideBounds = FALSE;
         }
 	found = !outsideBounds &&
-            SearchString(fileString, searchString, direction,
-	    searchType, searchWrap, beginPos, startPos, endPos,
+            searchBuffer(window->buffer, fileString, searchString,
+	    direction, searchType, searchWrap, beginPos, startPos, endPos,
 	    extentBW, extentFW, GetWindowDelimiters(window));
 	if (found) {
 	    iSearchTryBeepOnWrap(window, direction, beginPos, *startPos);
@@ -4339,8 +4855,8 @@ int SearchWindow(WindowInfo *window, int direction, const char *searchString,
 ** characters, or simply passed as null for the default delimiter set.
 */
 int SearchString(const char *string, const char *searchString, int direction,
-       int searchType, int wrap, int beginPos, int *startPos, int *endPos,
-       int *searchExtentBW, int *searchExtentFW, const char *delimiters)
+       int searchType, int wrap, ssize_t beginPos, ssize_t *startPos, ssize_t *endPos,
+       ssize_t *searchExtentBW, ssize_t *searchExtentFW, const char *delimiters)
 {
     switch (searchType) {
       case SEARCH_CASE_SENSE_WORD:
@@ -4368,6 +4884,150 @@ int SearchString(const char *string, const char *searchString, int direction,
     return FALSE; /* never reached, just makes compilers happy */
 }
 
+/*
+** Search the text of "buf" like SearchString, but without moving the buffer
+** gap to make the text contiguous, which on a large file can mean copying
+** most of it.  If "fileString" is not NULL, it is the (already fetched)
+** buffer text, and is searched directly instead.
+**
+** Literal searches are done in three pieces: the text before the gap, the
+** text after it, and a copy of the text around the gap big enough to hold
+** any match spanning it.  Each piece "owns" the matches starting in its own
+** part of the buffer, and owned matches are always far enough from the
+** edges of the piece that the characters around them (which word searches
+** look at) are real text.  Regular expression matches can be of any
+** length, so those still need the contiguous string.  BufAsString moves the
+** gap to the nearer end of the buffer, so only the first regular expression
+** search after an edit pays for it.
+*/
+static int searchBuffer(textBuffer *buf, const char *fileString,
+	const char *searchString, int direction, int searchType, int wrap,
+	ssize_t beginPos, ssize_t *startPos, ssize_t *endPos, ssize_t *searchExtentBW,
+	ssize_t *searchExtentFW, const char *delimiters)
+{
+    const char *before, *after;
+    char *seamText;
+    searchPiece pieces[3];
+    ssize_t margin, seamStart, seamEnd, seamTextStart, seamTextEnd;
+    ssize_t length = buf->length, gap = buf->gapStart;
+    int found;
+    
+    if (fileString != NULL)
+    	return SearchString(fileString, searchString, direction, searchType,
+		wrap, beginPos, startPos, endPos, searchExtentBW,
+		searchExtentFW, delimiters);
+    if (searchType == SEARCH_REGEX || searchType == SEARCH_REGEX_NOCASE ||
+    	    gap == 0 || gap == length ||
+	    !BufGetGapSegments(buf, &before, &after))
+    	return SearchString(BufAsString(buf), searchString, direction,
+		searchType, wrap, beginPos, startPos, endPos, searchExtentBW,
+		searchExtentFW, delimiters);
+    
+    /* a case insensitive match may differ in length from the search string
+       where upper and lower case UTF-8 sequences have different lengths */
+    margin = 2 * strlen(searchString) + 16;
+    seamStart = max(0, gap - margin);
+    seamEnd = min(length, gap + 1);
+    seamTextStart = max(0, seamStart - 1);
+    seamTextEnd = min(length, gap + margin + 1);
+    seamText = BufGetRange(buf, seamTextStart, seamTextEnd);
+    
+    pieces[0].text = before;
+    pieces[0].offset = 0;
+    pieces[0].length = gap;
+    pieces[0].ownStart = 0;
+    pieces[0].ownEnd = seamStart;
+    pieces[1].text = seamText;
+    pieces[1].offset = seamTextStart;
+    pieces[1].length = seamTextEnd - seamTextStart;
+    pieces[1].ownStart = seamStart;
+    pieces[1].ownEnd = seamEnd;
+    pieces[2].text = after;
+    pieces[2].offset = gap;
+    pieces[2].length = length - gap;
+    pieces[2].ownStart = seamEnd;
+    pieces[2].ownEnd = length;
+    
+    /* search the same ranges as the single string routines: forward from
+       beginPos to the end, then (wrapping) from the start up to beginPos,
+       or backwards from beginPos to the start, then from the end down to
+       beginPos */
+    if (direction == SEARCH_FORWARD) {
+    	found = searchPieces(pieces, searchString, direction, searchType,
+		beginPos, length, startPos, endPos, searchExtentBW,
+		searchExtentFW, delimiters);
+	if (!found && wrap)
+    	    found = searchPieces(pieces, searchString, direction, searchType,
+		    0, beginPos, startPos, endPos, searchExtentBW,
+		    searchExtentFW, delimiters);
+    } else {
+    	found = beginPos >= 0 && searchPieces(pieces, searchString, direction,
+		searchType, beginPos, 0, startPos, endPos, searchExtentBW,
+		searchExtentFW, delimiters);
+	if (!found && wrap)
+    	    found = searchPieces(pieces, searchString, direction, searchType,
+		    length, beginPos, startPos, endPos, searchExtentBW,
+		    searchExtentFW, delimiters);
+    }
+    NEditFree(seamText);
+    return found;
+}
+
+/*
+** Find the first (searching forward) or last (searching backward) match
+** owned by one of the three pieces of searchBuffer, starting at or after
+** (forward), or at or before (backward) "from", and no further than "limit".
+*/
+static int searchPieces(const searchPiece *pieces, const char *searchString,
+	int direction, int searchType, ssize_t from, ssize_t limit, ssize_t *startPos,
+	ssize_t *endPos, ssize_t *searchExtentBW, ssize_t *searchExtentFW,
+	const char *delimiters)
+{
+    const searchPiece *piece;
+    ssize_t begin, start, end, extentBW, extentFW;
+    int i;
+    
+    for (i=0; i<3; i++) {
+    	piece = &pieces[direction == SEARCH_FORWARD ? i : 2 - i];
+	if (piece->ownStart >= piece->ownEnd)
+	    continue;
+	if (direction == SEARCH_FORWARD) {
+	    if (piece->ownEnd <= from)
+	    	continue;
+	    begin = max(from, piece->ownStart);
+	    if (begin > limit)
+	    	return FALSE;
+	} else {
+	    if (piece->ownStart > from)
+	    	continue;
+	    begin = min(from, piece->ownEnd - 1);
+	    if (begin < limit)
+	    	return FALSE;
+	}
+	
+	/* word searches don't report their extents */
+	extentBW = extentFW = -1;
+	if (!SearchString(piece->text, searchString, direction, searchType,
+		FALSE, begin - piece->offset, &start, &end, &extentBW,
+		&extentFW, delimiters))
+	    continue;
+	start += piece->offset;
+	if (start < piece->ownStart || start >= piece->ownEnd)
+	    continue;
+	if (direction == SEARCH_FORWARD ? start > limit : start < limit)
+	    return FALSE;
+	*startPos = start;
+	*endPos = end + piece->offset;
+	if (searchExtentBW != NULL)
+	    *searchExtentBW = extentBW == -1 ? start : extentBW + piece->offset;
+	if (searchExtentFW != NULL)
+	    *searchExtentFW = extentFW == -1 ? *endPos :
+	    	    extentFW + piece->offset;
+	return TRUE;
+    }
+    return FALSE;
+}
+
 /* 
 ** Parses a search type description string. If the string contains a valid 
 ** search type description, returns TRUE and writes the corresponding 
@@ -4404,56 +5064,16 @@ int StringToSearchType(const char * string, int *searchType)
 **  
 */
 static int searchLiteralWord(const char *string, const char *searchString, int caseSense, 
-	int direction, int wrap, int beginPos, int *startPos, int *endPos, 
+	int direction, int wrap, ssize_t beginPos, ssize_t *startPos, ssize_t *endPos, 
         const char * delimiters)
 {
-/* This is critical code for the speed of searches.			    */
-/* For efficiency, we define the macro DOSEARCH with the guts of the search */
-/* routine and repeat it, changing the parameters of the outer loop for the */
-/* searching, forwards, backwards, and before and after the begin point	    */
-#define DOSEARCHWORD() \
-    if (*filePtr == *ucString || *filePtr == *lcString) { \
-	/* matched first character */ \
-	ucPtr = ucString; \
-	lcPtr = lcString; \
-	tempPtr = filePtr; \
-	while (*tempPtr == *ucPtr || *tempPtr == *lcPtr || (*ucPtr == 0 && *lcPtr != 0)) { \
-            if(*ucPtr == 0 && ucMatch) ucSkipped++; \
-            ucMatch = *tempPtr == *ucPtr; \
-            lcMatch = *tempPtr == *lcPtr; \
-            tempPtr++; ucPtr++; lcPtr++; \
-	    if (   *ucPtr == 0 && *lcPtr == 0 /* matched whole string */ \
-		&& (cignore_R ||\
-		    isspace((unsigned char)*tempPtr) ||\
-		    strchr(delimiters, *tempPtr) ) \
-		    /* next char right delimits word ? */ \
-		&& (cignore_L ||\
-                    filePtr==string || /* border case */ \
-                    isspace((unsigned char)filePtr[-1]) ||\
-                    strchr(delimiters,filePtr[-1]) ))\
-                    /* next char left delimits word ? */ { \
-		*startPos = filePtr - string; \
-		*endPos = tempPtr - string; \
-		return TRUE; \
-	    } \
-	} \
-    }
-
-    register const char *filePtr, *tempPtr, *ucPtr, *lcPtr;
-    char lcString[SEARCHMAX], ucString[SEARCHMAX];
-    int ucSkipped = 0;
-    int lcMatch = 0;
-    int ucMatch = 0;
-						
-    int cignore_L=0, cignore_R=0;
-		
-    /* SEARCHMAX was fine in the original NEdit, but it should be done away 
-       with now that searching can be done from macros without limits. 
-       Returning search failure here is cheating users.  This limit is not 
-       documented. */
+    literalPattern *pat;
+    int cignore_L=0, cignore_R=0, pass, found = FALSE;
+    ssize_t from, limit, start, end;
     size_t searchStringLen = strlen(searchString);
-    if (searchStringLen >= SEARCHMAX)
-	return FALSE;
+    
+    if (searchStringLen == 0)
+    	return FALSE;
     
     /* If there is no language mode, we use the default list of delimiters */
     if (delimiters==NULL) delimiters = GetPrefDelimiters();
@@ -4462,232 +5082,193 @@ static int searchLiteralWord(const char *string, const char *searchString, int c
 	|| strchr(delimiters, *searchString))
 	cignore_L=1;
 
-    if (   isspace((unsigned char)searchString[strlen(searchString)-1])
-	|| strchr(delimiters, searchString[strlen(searchString)-1]) )
+    if (   isspace((unsigned char)searchString[searchStringLen-1])
+	|| strchr(delimiters, searchString[searchStringLen-1]) )
 	cignore_R=1;
-   
-    if (caseSense) {
-        memcpy(ucString, searchString, searchStringLen+1);
-        memcpy(lcString, searchString, searchStringLen+1);
-    } else {
-    	UpCaseString(ucString, searchString, True);
-    	DownCaseString(lcString, searchString, True);
-    }
-
-    if (direction == SEARCH_FORWARD) {
-	/* search from beginPos to end of string */
-	for (filePtr=string+beginPos; *filePtr!=0; filePtr++) {
-      	    DOSEARCHWORD() 
-	}
-	if (!wrap)
-	    return FALSE;
-
-	/* search from start of file to beginPos */
-	for (filePtr=string; filePtr<=string+beginPos; filePtr++) {
-      	    DOSEARCHWORD() 
-	}
-	return FALSE;
-    } else {
-	/* SEARCH_BACKWARD */
-	/* search from beginPos to start of file. A negative begin pos */
-	/* says begin searching from the far end of the file */
-	if (beginPos >= 0) {
-	    for (filePtr=string+beginPos; filePtr>=string; filePtr--) {
-	    	DOSEARCHWORD() 
-	    }
+    
+    /* Find each literal match in turn, over the same ranges as searchLiteral,
+       until one is delimited as a whole word */
+    pat = getLiteralPattern(searchString, caseSense);
+    for (pass=0; pass<2 && !found; pass++) {
+    	if (pass == 1 && !wrap)
+	    break;
+	if (direction == SEARCH_FORWARD) {
+	    from = pass == 0 ? beginPos : 0;
+	    limit = pass == 0 ? -1 : beginPos;
+	} else {
+	    if (pass == 0 && beginPos < 0)
+	    	continue;
+	    from = pass == 0 ? beginPos : strlen(string);
+	    limit = pass == 0 ? 0 : max(beginPos, 0);
 	}
-	if (!wrap)
-	    return FALSE;
-	/* search from end of file to beginPos */
-	/*... this strlen call is extreme inefficiency, but it's not obvious */
-	/* how to get the text string length from the text widget (under 1.1)*/
-	for (filePtr=string+strlen(string); filePtr>=string+beginPos; filePtr--) {
-      	    DOSEARCHWORD() 
+	while (findLiteral(pat->pat, string, direction, from, limit, &start,
+		&end)) {
+	    found = (cignore_R ||
+		    isspace((unsigned char)string[end]) ||
+		    strchr(delimiters, string[end])) &&
+		    /* next char right delimits word ? */
+		    (cignore_L ||
+		    start == 0 || /* border case */
+		    isspace((unsigned char)string[start-1]) ||
+		    strchr(delimiters, string[start-1]));
+		    /* next char left delimits word ? */
+	    if (found)
+	    	break;
+	    from = direction == SEARCH_FORWARD ? start+1 : start-1;
 	}
-	return FALSE;
     }
-}
-
-
-#ifdef USE_STRSTR
-
-static int searchLiteral(const char *string, const char *searchString, int caseSense, 
-	int direction, int wrap, int beginPos, int *startPos, int *endPos,
-	int *searchExtentBW, int *searchExtentFW)
-{
-    if(direction == SEARCH_FORWARD) {
-        const char *beginString = string + beginPos;
-        char *s = caseSense ? strstr(beginString, searchString) : strcasestr(beginString, searchString);
-        if(s) {
-            /* search from beginPos to end of string */
-            *startPos = s - string;
-            *endPos = *startPos + strlen(searchString);
-            if (searchExtentBW != NULL) {
-                *searchExtentBW = *startPos;
-            }
-            if (searchExtentFW != NULL) {
-                *searchExtentFW = *endPos;
-            }
-            return True;
-        } else if(wrap && beginPos > 0) {
-            /* search from start of file to beginPos */
-            s = caseSense ? strstr(string, searchString) : strcasestr(string, searchString);
-            int start = s - string;
-            if(start < beginPos) {
-                *startPos = start;
-                *endPos = *startPos + (int)strlen(searchString);
-                if (searchExtentBW != NULL) {
-                    *searchExtentBW = *startPos;
-                }
-                if (searchExtentFW != NULL) {
-                    *searchExtentFW = *endPos;
-                }
-            }
-        }
-    } else {
-        /* SEARCH_BACKWARD */
-	/* search from beginPos to start of file.  A negative begin pos	*/
-	/* says begin searching from the far end of the file            */
-        int begin = beginPos >= 0 ? beginPos : (int)strlen(string);
-        char *result = NULL;
-        char *s = NULL;
-        const char *str = string;
-        while((s = caseSense ? strstr(str, searchString) : strcasestr(str, searchString)) != NULL) {
-            str = s+1;
-            int pos = s - string;
-            if(pos >= begin) {
-                break;
-            }
-            result = s;
-        }
-        if(result) {
-            *startPos = result - string;
-            *endPos = *startPos + (int)strlen(searchString);
-            if (searchExtentBW != NULL) {
-                *searchExtentBW = *startPos;
-            }
-            if (searchExtentFW != NULL) {
-                *searchExtentFW = *endPos;
-            }
-            return True;
-        } else if(wrap && beginPos > 0) {
-            str = string + beginPos;
-            while((s = caseSense ? strstr(str, searchString) : strcasestr(str, searchString)) != NULL) {
-                str = s+1;
-                result = s;
-            }
-            if(result) {
-                *startPos = result - string;
-                *endPos = *startPos + (int)strlen(searchString);
-                if (searchExtentBW != NULL) {
-                    *searchExtentBW = *startPos;
-                }
-                if (searchExtentFW != NULL) {
-                    *searchExtentFW = *endPos;
-                }
-                return True;
-            }
-        }
-        
+    releaseLiteralPattern(pat);
+    if (found) {
+	*startPos = start;
+	*endPos = end;
     }
-    return False;
+    return found;
 }
 
-#else
-
 static int searchLiteral(const char *string, const char *searchString, int caseSense, 
-	int direction, int wrap, int beginPos, int *startPos, int *endPos,
-	int *searchExtentBW, int *searchExtentFW)
-{
-/* This is critical code for the speed of searches.			    */
-/* For efficiency, we define the macro DOSEARCH with the guts of the search */
-/* routine and repeat it, changing the parameters of the outer loop for the */
-/* searching, forwards, backwards, and before and after the begin point	    */
-#define DOSEARCH() \
-    if (*filePtr == *ucString || *filePtr == *lcString) { \
-	/* matched first character */ \
-	ucPtr = ucString; \
-	lcPtr = lcString; \
-	tempPtr = filePtr; \
-        ucSkipped = 0; \
-	while (*tempPtr == *ucPtr || *tempPtr == *lcPtr || (*ucPtr == 0 && *lcPtr != 0)) { \
-            if(*ucPtr == 0 && ucMatch) ucSkipped++; \
-            ucMatch = *tempPtr == *ucPtr; \
-            lcMatch = *tempPtr == *lcPtr; \
-	    tempPtr++; ucPtr++; lcPtr++; \
-	    if (*ucPtr == 0 && *lcPtr == 0) { \
-		/* matched whole string */ \
-		*startPos = filePtr - string; \
-		*endPos = tempPtr - string - ucSkipped; \
-		if (searchExtentBW != NULL) \
-		    *searchExtentBW = *startPos; \
-		if (searchExtentFW != NULL) \
-		    *searchExtentFW = *endPos; \
-		return TRUE; \
-	    } \
-	} \
-    } \
-
-    register const char *filePtr, *tempPtr, *ucPtr, *lcPtr;
-    char lcString[SEARCHMAX], ucString[SEARCHMAX];
-    int ucSkipped = 0;
-    int lcMatch = 0;
-    int ucMatch = 0;
-    size_t searchLen = strlen(searchString);
-
-    /* SEARCHMAX was fine in the original NEdit, but it should be done away with
-       now that searching can be done from macros without limits.  Returning
-       search failure here is cheating users.  This limit is not documented. */
-    if (searchLen >= SEARCHMAX)
-	return FALSE;
+	int direction, int wrap, ssize_t beginPos, ssize_t *startPos, ssize_t *endPos,
+	ssize_t *searchExtentBW, ssize_t *searchExtentFW)
+{
+    literalPattern *pat;
+    int found;
+    
+    if (*searchString == '\0')
+    	return FALSE;
+    pat = getLiteralPattern(searchString, caseSense);
     
-    if (caseSense) {
-        memcpy(ucString, searchString, searchLen+1);
-        memcpy(lcString, searchString, searchLen+1);
+    if (direction == SEARCH_FORWARD) {
+	/* search from beginPos to end of string, then from start of file to
+	   beginPos */
+	found = findLiteral(pat->pat, string, direction, beginPos, -1,
+		startPos, endPos);
+	if (!found && wrap)
+	    found = findLiteral(pat->pat, string, direction, 0, beginPos,
+		    startPos, endPos);
     } else {
-    	UpCaseString(ucString, searchString, True);
-    	DownCaseString(lcString, searchString, False);
+    	/* search from beginPos to start of file.  A negative begin pos	*/
+	/* says begin searching from the far end of the file.  Then search */
+	/* from end of file to beginPos					*/
+	found = beginPos >= 0 && findLiteral(pat->pat, string, direction,
+		beginPos, 0, startPos, endPos);
+	if (!found && wrap)
+	    found = findLiteral(pat->pat, string, direction, strlen(string),
+		    max(beginPos, 0), startPos, endPos);
+    }
+    releaseLiteralPattern(pat);
+    if (found) {
+	if (searchExtentBW != NULL)
+	    *searchExtentBW = *startPos;
+	if (searchExtentFW != NULL)
+	    *searchExtentFW = *endPos;
     }
+    return found;
+}
 
-    if (direction == SEARCH_FORWARD) {
-	/* search from beginPos to end of string */
-	for (filePtr=string+beginPos; *filePtr!=0; filePtr++) {
-	    DOSEARCH()
+/*
+** Find a match for the compiled literal search string "pat" in the null
+** terminated "string", starting at or after (forward) or at or before
+** (backward) "from", and no further than "limit".  A "limit" of -1 searching
+** forward means the end of the string.  Note that matches may extend past
+** "limit" or "from".
+*/
+static int findLiteral(const litPattern *pat, const char *string,
+	int direction, ssize_t from, ssize_t limit, ssize_t *startPos, ssize_t *endPos)
+{
+    const char *text, *end, *match;
+    size_t chunkLen, chunkSize;
+    int matchLen;
+    
+    if (direction == SEARCH_FORWARD && limit < 0) {
+	/* The string length is found a chunk at a time as the search
+	   goes, so that a match near "from" doesn't require scanning to the
+	   end of a (possibly very long) string.  Chunks start small and grow,
+	   since when replacing, most searches end at a nearby match */
+	text = end = string + from;
+	chunkSize = LITERAL_SEARCH_MIN_CHUNK;
+	for (;;) {
+	    chunkLen = strnlen(end, chunkSize);
+	    end += chunkLen;
+	    match = LitFindForward(pat, text, end - text, &matchLen);
+	    if (match != NULL)
+	    	break;
+	    if (chunkLen < chunkSize)
+	    	return FALSE;
+	    if (end - text >= pat->maxMatch)
+	    	text = end - pat->maxMatch + 1;
+	    if (chunkSize < LITERAL_SEARCH_CHUNK)
+		chunkSize *= 2;
 	}
-	if (!wrap)
+    } else if (direction == SEARCH_FORWARD) {
+	if (from > limit)
+	    return FALSE;
+    	text = string + from;
+	end = string + limit + strnlen(string + limit, pat->maxMatch);
+	match = LitFindForward(pat, text, end - text, &matchLen);
+	if (match == NULL || match - string > limit)
 	    return FALSE;
-	/* search from start of file to beginPos	*/
-	for (filePtr=string; filePtr<=string+beginPos; filePtr++) {
-	    DOSEARCH()
-	}
-	return FALSE;
     } else {
-    	/* SEARCH_BACKWARD */
-	/* search from beginPos to start of file.  A negative begin pos	*/
-	/* says begin searching from the far end of the file		*/
-	if (beginPos >= 0) {
-	    for (filePtr=string+beginPos; filePtr>=string; filePtr--) {
-		DOSEARCH()
-	    }
-	}
-	if (!wrap)
+    	if (from < limit)
+	    return FALSE;
+    	text = string + limit;
+	end = string + from + strnlen(string + from, pat->maxMatch);
+	match = LitFindBackward(pat, text, from - limit, end - text,
+		&matchLen);
+	if (match == NULL)
 	    return FALSE;
-	/* search from end of file to beginPos */
-	/*... this strlen call is extreme inefficiency, but it's not obvious */
-	/* how to get the text string length from the text widget (under 1.1)*/
-	for (filePtr=string+strlen(string);
-		filePtr>=string+beginPos; filePtr--) {
-	    DOSEARCH()
-	}
-	return FALSE;
     }
+    *startPos = match - string;
+    *endPos = *startPos + matchLen;
+    return TRUE;
 }
 
-#endif
+/*
+** Return the compiled form of a literal search string, which must be released
+** with releaseLiteralPattern.  The last one compiled is kept, since the same
+** string is usually searched for repeatedly (by Find Again, Replace All, or a
+** macro loop).  Searches may run on worker threads (see replaceAllInWindows),
+** so the kept pattern is reference counted and guarded by a mutex.
+*/
+static literalPattern *getLiteralPattern(const char *searchString,
+	int caseSense)
+{
+    static literalPattern *lastPattern = NULL;
+    literalPattern *pat;
+    
+    pthread_mutex_lock(&literalPatternLock);
+    if (lastPattern == NULL || lastPattern->caseSense != caseSense ||
+    	    strcmp(lastPattern->string, searchString) != 0) {
+	if (lastPattern != NULL && --lastPattern->refCount == 0)
+	    freeLiteralPattern(lastPattern);
+	lastPattern = NEditNew(literalPattern);
+	lastPattern->pat = LitCompile(searchString, caseSense);
+	lastPattern->string = NEditStrdup(searchString);
+	lastPattern->caseSense = caseSense;
+	lastPattern->refCount = 1;
+    }
+    pat = lastPattern;
+    pat->refCount++;
+    pthread_mutex_unlock(&literalPatternLock);
+    return pat;
+}
+
+static void releaseLiteralPattern(literalPattern *pat)
+{
+    pthread_mutex_lock(&literalPatternLock);
+    if (--pat->refCount == 0)
+	freeLiteralPattern(pat);
+    pthread_mutex_unlock(&literalPatternLock);
+}
+
+static void freeLiteralPattern(literalPattern *pat)
+{
+    LitFree(pat->pat);
+    NEditFree(pat->string);
+    NEditFree(pat);
+}
 
 static int searchRegex(const char *string, const char *searchString, int direction,
-	int wrap, int beginPos, int *startPos, int *endPos, int *searchExtentBW,
-	int *searchExtentFW, const char *delimiters, int defaultFlags)
+	int wrap, ssize_t beginPos, ssize_t *startPos, ssize_t *endPos, ssize_t *searchExtentBW,
+	ssize_t *searchExtentFW, const char *delimiters, int defaultFlags)
 {
     if (direction == SEARCH_FORWARD)
 	return forwardRegexSearch(string, searchString, wrap, 
@@ -4700,16 +5281,15 @@ static int searchRegex(const char *string, const char *searchString, int directi
 }
 
 static int forwardRegexSearch(const char *string, const char *searchString, int wrap,
-	int beginPos, int *startPos, int *endPos, int *searchExtentBW,
-        int *searchExtentFW, const char *delimiters, int defaultFlags)
+	ssize_t beginPos, ssize_t *startPos, ssize_t *endPos, ssize_t *searchExtentBW,
+        ssize_t *searchExtentFW, const char *delimiters, int defaultFlags)
 {
     regexp *compiledRE = NULL;
-    char *compileMsg;
     
-    /* compile the search string for searching with ExecRE.  Note that
+    /* get the search string compiled for searching with ExecRE.  Note that
        this does not process errors from compiling the expression.  It
        assumes that the expression was checked earlier. */
-    compiledRE = CompileRE(searchString, &compileMsg, defaultFlags);
+    compiledRE = getCompiledRE(searchString, defaultFlags);
     if (compiledRE == NULL)
 	return FALSE;
 
@@ -4723,13 +5303,11 @@ static int forwardRegexSearch(const char *string, const char *searchString, int
 	    *searchExtentFW = compiledRE->extentpFW - string;
 	if (searchExtentBW != NULL)
            *searchExtentBW = compiledRE->extentpBW - string;
-	NEditFree(compiledRE);
 	return TRUE;
     }
     
     /* if wrap turned off, we're done */
     if (!wrap) {
-    	NEditFree(compiledRE);
 	return FALSE;
     }
     
@@ -4742,24 +5320,20 @@ static int forwardRegexSearch(const char *string, const char *searchString, int
        	    *searchExtentFW = compiledRE->extentpFW - string;
 	if (searchExtentBW != NULL)
 	    *searchExtentBW = compiledRE->extentpBW - string;
-	NEditFree(compiledRE);
 	return TRUE;
     }
-
-    NEditFree(compiledRE);
     return FALSE;
 }
 
 static int backwardRegexSearch(const char *string, const char *searchString, int wrap,
-	int beginPos, int *startPos, int *endPos, int *searchExtentBW,
-	int *searchExtentFW, const char *delimiters, int defaultFlags)
+	ssize_t beginPos, ssize_t *startPos, ssize_t *endPos, ssize_t *searchExtentBW,
+	ssize_t *searchExtentFW, const char *delimiters, int defaultFlags)
 {
     regexp *compiledRE = NULL;
-    char *compileMsg;
-    int length;
+    ssize_t length;
 
-    /* compile the search string for searching with ExecRE */
-    compiledRE = CompileRE(searchString, &compileMsg, defaultFlags);
+    /* get the search string compiled for searching with ExecRE */
+    compiledRE = getCompiledRE(searchString, defaultFlags);
     if (compiledRE == NULL)
 	return FALSE;
 
@@ -4774,14 +5348,12 @@ static int backwardRegexSearch(const char *string, const char *searchString, int
 		*searchExtentFW = compiledRE->extentpFW - string;
 	    if (searchExtentBW != NULL)
 		*searchExtentBW = compiledRE->extentpBW - string;
-	    NEditFree(compiledRE);
 	    return TRUE;
 	}
     }
     
     /* if wrap turned off, we're done */
     if (!wrap) {
-    	NEditFree(compiledRE);
     	return FALSE;
     }
     
@@ -4798,10 +5370,8 @@ static int backwardRegexSearch(const char *string, const char *searchString, int
 	    *searchExtentFW = compiledRE->extentpFW - string;
 	if (searchExtentBW != NULL)
 	    *searchExtentBW = compiledRE->extentpBW - string;
-	NEditFree(compiledRE);
 	return TRUE;
     }
-    NEditFree(compiledRE);
     return FALSE;
 }
 
@@ -4902,13 +5472,14 @@ static void resetReplaceTabGroup(WindowInfo *window)
 ** also return the position of the selection in "left" and "right".
 */
 static int searchMatchesSelection(WindowInfo *window, const char *searchString,
-	int searchType, int *left, int *right, int *searchExtentBW, 
-	int *searchExtentFW)
+	int searchType, ssize_t *left, ssize_t *right, ssize_t *searchExtentBW, 
+	ssize_t *searchExtentFW)
 {
-    int selLen, selStart, selEnd, startPos, endPos, extentBW, extentFW, beginPos;
+    ssize_t selStart, selEnd, lineStart = 0;
+    ssize_t selLen, startPos, endPos, extentBW, extentFW, beginPos;
     int regexLookContext = isRegexType(searchType) ? 1000 : 0;
     char *string;
-    int found, isRect, rectStart, rectEnd, lineStart = 0;
+    int found, isRect, rectStart, rectEnd;
     
     /* find length of selection, give up on no selection or too long */
     if (!BufGetEmptySelectionPos(window->buffer, &selStart, &selEnd, &isRect,
@@ -4927,14 +5498,14 @@ static int searchMatchesSelection(WindowInfo *window, const char *searchString,
     /* get the selected text plus some additional context for regular
        expression lookahead */
     if (isRect) {
-	int stringStart = lineStart + rectStart - regexLookContext;
+	ssize_t stringStart = lineStart + rectStart - regexLookContext;
 	if (stringStart < 0) stringStart = 0;
     	string = BufGetRange(window->buffer, stringStart,
 		lineStart + rectEnd + regexLookContext);
     	selLen = rectEnd - rectStart;
 	beginPos = lineStart + rectStart - stringStart;
     } else {
-	int stringStart = selStart - regexLookContext;
+	ssize_t stringStart = selStart - regexLookContext;
 	if (stringStart < 0) stringStart = 0;
 	string = BufGetRange(window->buffer, stringStart,
 		selEnd + regexLookContext);
@@ -4961,9 +5532,12 @@ static int searchMatchesSelection(WindowInfo *window, const char *searchString,
     	return FALSE;
     
     /* return the start and end of the selection */
-    if (isRect)
-    	GetSimpleSelection(window->buffer, left, right);
-    else {
+    if (isRect) {
+    	int rectLeft, rectRight;
+    	GetSimpleSelection(window->buffer, &rectLeft, &rectRight);
+	*left = rectLeft;
+	*right = rectRight;
+    } else {
     	*left = selStart;
     	*right = selEnd;
     }
@@ -4975,6 +5549,103 @@ static int searchMatchesSelection(WindowInfo *window, const char *searchString,
     return TRUE;
 }
 
+/*
+** Get "searchString" compiled with CompileREContext, from a small cache of
+** the most recently used expressions.  Find Again, replacing one match at a
+** time, and macros calling search() in a loop all use the same few
+** expressions over and over, and compiling them can take longer than the
+** search.  The compiled expression belongs to the calling thread's cache, and
+** is good until the next call.  Returns NULL if the expression doesn't
+** compile.
+*/
+static regexp *getCompiledRE(const char *searchString, int defaultFlags)
+{
+    regexCache *cache = getRegexCache();
+    cachedRegex entry;
+    char *compileMsg;
+    int i;
+    
+    for (i=0; i<cache->nCached; i++)
+	if (cache->entries[i].defaultFlags == defaultFlags &&
+		!strcmp(cache->entries[i].pattern, searchString))
+	    break;
+    if (i < cache->nCached) {
+	cache->hits++;
+	entry = cache->entries[i];
+    } else {
+	cache->misses++;
+	entry.compiledRE = CompileREContext(cache->context, searchString,
+		&compileMsg, defaultFlags);
+	if (entry.compiledRE == NULL)
+	    return NULL;
+	entry.pattern = NEditStrdup(searchString);
+	entry.defaultFlags = defaultFlags;
+	if (cache->nCached < REGEX_CACHE_SIZE)
+	    i = cache->nCached++;
+	else {
+	    i = REGEX_CACHE_SIZE - 1;
+	    NEditFree(cache->entries[i].pattern);
+	    NEditFree(cache->entries[i].compiledRE);
+	}
+    }
+    
+    /* move the entry to the front, the least recently used is at the end */
+    memmove(&cache->entries[1], &cache->entries[0], sizeof(cachedRegex) * i);
+    cache->entries[0] = entry;
+    return entry.compiledRE;
+}
+
+/*
+** Return the calling thread's cache of compiled regular expressions, creating
+** it on first use.  Worker threads' caches are freed when they exit.
+*/
+static regexCache *getRegexCache(void)
+{
+    regexCache *cache;
+    
+    pthread_once(&RegexCacheKeyOnce, createRegexCacheKey);
+    cache = (regexCache *)pthread_getspecific(RegexCacheKey);
+    if (cache == NULL) {
+	cache = NEditNew(regexCache);
+	cache->context = CreateREContext();
+	cache->nCached = 0;
+	cache->hits = cache->misses = 0;
+	pthread_setspecific(RegexCacheKey, cache);
+    }
+    return cache;
+}
+
+static void createRegexCacheKey(void)
+{
+    pthread_key_create(&RegexCacheKey, freeRegexCache);
+}
+
+static void freeRegexCache(void *data)
+{
+    regexCache *cache = (regexCache *)data;
+    int i;
+    
+    for (i=0; i<cache->nCached; i++) {
+	NEditFree(cache->entries[i].pattern);
+	NEditFree(cache->entries[i].compiledRE);
+    }
+    FreeREContext(cache->context);
+    NEditFree(cache);
+}
+
+/*
+** Return the number of times a compiled expression was found in the cache
+** of getCompiledRE, and the number of times one had to be compiled, for the
+** calling thread
+*/
+void GetRegexCacheStats(unsigned long *hits, unsigned long *misses)
+{
+    regexCache *cache = getRegexCache();
+    
+    *hits = cache->hits;
+    *misses = cache->misses;
+}
+
 /*
 ** Substitutes a replace string for a string that was matched using a
 ** regular expression.  This was added later and is rather ineficient
@@ -4986,19 +5657,19 @@ static int searchMatchesSelection(WindowInfo *window, const char *searchString,
 */  
 
 static Boolean replaceUsingRE(const char* searchStr, const char* replaceStr,
-        const char* sourceStr, int beginPos, char* destStr,
+        const char* sourceStr, ssize_t beginPos, char* destStr,
         int maxDestLen, int prevChar, const char* delimiters,
         int defaultFlags)
 {
     regexp *compiledRE;
-    char *compileMsg;
     Boolean substResult = False;
     
-    compiledRE = CompileRE(searchStr, &compileMsg, defaultFlags);
+    compiledRE = getCompiledRE(searchStr, defaultFlags);
+    if (compiledRE == NULL)
+	return False;
     ExecRE(compiledRE, sourceStr+beginPos, NULL, False, prevChar, '\0',
             delimiters, sourceStr, NULL);
     substResult = SubstituteRE(compiledRE, replaceStr, destStr, maxDestLen);
-    NEditFree(compiledRE);
 
     return substResult;
 }
@@ -5483,9 +6154,9 @@ static void iSearchCaseToggleCB(Widget w, XtPointer clientData, XtPointer callDa
 }
 
 
-static int translateEscPos(EscSeqArray *array, int pos)
+static ssize_t translateEscPos(EscSeqArray *array, ssize_t pos)
 {
-    int p = pos;
+    ssize_t p = pos;
     for(size_t i=0;i<array->num_esc;i++) {
         EscSeqStr e = array->esc[i];
         if(e.off_trans < pos)
@@ -5500,10 +6171,10 @@ static void translatePosAndRestoreBuf(
         textBuffer *buf,
         EscSeqArray *array,
         int found,
-        int *begin,
-        int *end,
-        int *extentBW,
-        int *extentFW)
+        ssize_t *begin,
+        ssize_t *end,
+        ssize_t *extentBW,
+        ssize_t *extentFW)
 {
     if(found && array) {
         if(begin) *begin = translateEscPos(array, *begin);
@@ -5513,3 +6184,13 @@ static void translatePosAndRestoreBuf(
     }
     BufReintegrateEscSeq(buf, array);
 }
+
+static ssize_t max(ssize_t i1, ssize_t i2)
+{
+    return i1 >= i2 ? i1 : i2;
+}
+
+static ssize_t min(ssize_t i1, ssize_t i2)
+{
+    return i1 <= i2 ? i1 : i2;
+}
@@ -53,7 +53,7 @@
 
 
 static void shiftRect(WindowInfo *window, int direction, int byTab,
-	int selStart, int selEnd, int rectStart, int rectEnd);
+	ssize_t selStart, ssize_t selEnd, int rectStart, int rectEnd);
 static void changeCase(WindowInfo *window, int makeUpper);
 static char *shiftLineRight(char *line, int lineLen, int tabsAllowed,
 	int tabDist, int nChars);
@@ -68,8 +68,8 @@ static char *makeIndentString(int indent, int tabDist, int allowTabs, int *nChar
 static int atTabStop(int pos, int tabDist);
 static int nextTab(int pos, int tabDist);
 static int countLines(const char *text);
-static int findParagraphStart(textBuffer *buf, int startPos);
-static int findParagraphEnd(textBuffer *buf, int startPos);
+static ssize_t findParagraphStart(textBuffer *buf, ssize_t startPos);
+static ssize_t findParagraphEnd(textBuffer *buf, ssize_t startPos);
 
 /*
 ** Shift the selection left or right by a single character, or by one tab stop
@@ -78,8 +78,9 @@ static int findParagraphEnd(textBuffer *buf, int startPos);
 */
 void ShiftSelection(WindowInfo *window, int direction, int byTab)
 {
-    int selStart, selEnd, isRect, rectStart, rectEnd;
-    int shiftedLen, newEndPos, cursorPos, origLength, emTabDist, shiftDist;
+    ssize_t selStart, selEnd, newEndPos, cursorPos, origLength;
+    int isRect, rectStart, rectEnd;
+    int shiftedLen, emTabDist, shiftDist;
     char *text, *shiftedText;
     textBuffer *buf = window->buffer;
 
@@ -130,7 +131,7 @@ void ShiftSelection(WindowInfo *window, int direction, int byTab)
 }
 
 static void shiftRect(WindowInfo *window, int direction, int byTab,
-	int selStart, int selEnd, int rectStart, int rectEnd)
+	ssize_t selStart, ssize_t selEnd, int rectStart, int rectEnd)
 {
     int offset, emTabDist;
     textBuffer *tempBuf, *buf = window->buffer;
@@ -191,7 +192,8 @@ static void changeCase(WindowInfo *window, int makeUpper)
 {
     textBuffer *buf = window->buffer;
     char *text, *c;
-    int cursorPos, start, end, isRect, rectStart, rectEnd;
+    ssize_t cursorPos, start, end;
+    int isRect, rectStart, rectEnd;
     
     char *bak_locale = NULL;
     if(!XNEditDefaultCharsetIsUTF8()) {
@@ -208,7 +210,7 @@ static void changeCase(WindowInfo *window, int makeUpper)
     	    return;
 	}
         
-        int leftPos = BufLeftPos(buf, cursorPos);
+        ssize_t leftPos = BufLeftPos(buf, cursorPos);
         
         wchar_t w = BufGetCharacterW(buf, leftPos);
         wchar_t wc = makeUpper ? towupper(w) : towlower(w);
@@ -292,9 +294,9 @@ void FillSelection(WindowInfo *window)
 {
     textBuffer *buf = window->buffer;
     char *text, *filledText;
-    int left, right, nCols, len, isRect, rectStart, rectEnd;
+    ssize_t left, right, insertPos = TextGetCursorPos(window->lastFocus);
+    int nCols, len, isRect, rectStart, rectEnd;
     int rightMargin, wrapMargin;
-    int insertPos = TextGetCursorPos(window->lastFocus);
     int hasSelection = window->buffer->primary.selected;
     
     /* Find the range of characters and get the text to fill.  If there is a
@@ -785,10 +787,10 @@ static char *makeIndentString(int indent, int tabDist, int allowTabs, int *nChar
 /*
 ** Find the boundaries of the paragraph containing pos
 */
-static int findParagraphEnd(textBuffer *buf, int startPos)
+static ssize_t findParagraphEnd(textBuffer *buf, ssize_t startPos)
 {
     char c;
-    int pos;
+    ssize_t pos;
     static char whiteChars[] = " \t";
 
     pos = BufEndOfLine(buf, startPos)+1;
@@ -803,10 +805,10 @@ static int findParagraphEnd(textBuffer *buf, int startPos)
     }
     return pos < buf->length ? pos : buf->length;
 }
-static int findParagraphStart(textBuffer *buf, int startPos)
+static ssize_t findParagraphStart(textBuffer *buf, ssize_t startPos)
 {
     char c;
-    int pos, parStart;
+    ssize_t pos, parStart;
     static char whiteChars[] = " \t";
 
     if (startPos == 0)
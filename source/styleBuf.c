@@ -0,0 +1,605 @@
+/*******************************************************************************
+*                                                                              *
+* styleBuf.c -- Nirvana Editor Style Buffer                                    *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* software; if not, write to the Free Software Foundation, Inc., 59 Temple     *
+* Place, Suite 330, Boston, MA  02111-1307 USA                                 *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Style buffer for syntax highlighting.  This holds a style code for every
+** character of a text buffer, the same information as a second textBuffer
+** the length of the text would, but stored as runs of characters having the
+** same style.  Highlighting patterns style whole tokens, comments and strings
+** at a time, so there are typically tens of characters per run, and a run
+** takes three bytes.
+**
+** Runs are kept in blocks of up to STYLE_BLOCK_RUNS, and the number of
+** characters covered by each block is kept in a Fenwick (binary indexed)
+** tree, as in the line index of textBuf.c, so the block holding a position
+** can be found in logarithmic time.  An edit re-packs only the blocks it
+** touches, and updates the tree in logarithmic time unless blocks had to be
+** split or merged.  Blocks are stored at the size of the runs they hold, so
+** the whole costs a little over three bytes per run.  The run found by the
+** last lookup is remembered, since the display and the parsing code mostly
+** ask for the styles of nearby characters in turn.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include "styleBuf.h"
+#include "../util/nedit_malloc.h"
+
+#include <string.h>
+
+#include <Xm/Xm.h>
+
+#ifdef HAVE_DEBUG_H
+#include "../debug.h"
+#endif
+
+#define STYLE_BLOCK_RUNS 256	/* maximum number of runs in a block */
+#define STYLE_RUN_MAX 65535	/* longer runs are held as several runs */
+
+/* A block of runs.  Blocks are built at full size, then copied to storage
+   of just the size needed, following the struct */
+struct _styleBlock {
+    int nRuns;
+    unsigned short *len;    	/* characters in each run */
+    char *style;    	    	/* and their style */
+};
+
+/* Blocks of runs under construction, to replace a range of blocks */
+typedef struct {
+    styleBlock **blocks;
+    ssize_t *len;
+    ssize_t nBlocks;
+    ssize_t nAlloc;
+} runPacker;
+
+static void replaceRuns(styleBuffer *sbuf, ssize_t start, ssize_t end,
+	const char *styles, char fill, ssize_t length);
+static void packRun(runPacker *p, char style, ssize_t length);
+static void packBlockRuns(runPacker *p, const styleBlock *b, ssize_t from,
+	ssize_t to);
+static void balanceLastBlocks(runPacker *p);
+static styleBlock *allocBlock(int nRuns);
+static void findRun(styleBuffer *sbuf, ssize_t pos);
+static ssize_t treeFind(const ssize_t *tree, ssize_t nBlocks, ssize_t target,
+	ssize_t *remainder);
+static void buildTree(styleBuffer *sbuf);
+static void growBlocks(styleBuffer *sbuf, ssize_t nBlocks);
+static void updateSelection(selection *sel, ssize_t pos, ssize_t nDeleted,
+	ssize_t nInserted);
+
+#ifndef min
+#define min(a,b) ((a)<(b)?(a):(b))
+#endif
+#ifndef max
+#define max(a,b) ((a)>(b)?(a):(b))
+#endif
+
+/*
+** Create an empty style buffer
+*/
+styleBuffer *StyleBufCreate(void)
+{
+    styleBuffer *sbuf = (styleBuffer *)NEditMalloc(sizeof(styleBuffer));
+
+    sbuf->length = 0;
+    sbuf->primary.selected = False;
+    sbuf->primary.rectangular = False;
+    sbuf->primary.zeroWidth = False;
+    sbuf->primary.start = sbuf->primary.end = 0;
+    sbuf->primary.rectStart = sbuf->primary.rectEnd = 0;
+    sbuf->nBlocks = 0;
+    sbuf->nAlloc = 0;
+    sbuf->blocks = NULL;
+    sbuf->len = sbuf->lenTree = NULL;
+    sbuf->cursorBlock = -1;
+    sbuf->generation = 0;
+    return sbuf;
+}
+
+void StyleBufFree(styleBuffer *sbuf)
+{
+    ssize_t i;
+
+    for (i=0; i<sbuf->nBlocks; i++)
+    	NEditFree(sbuf->blocks[i]);
+    NEditFree(sbuf->blocks);
+    NEditFree(sbuf->len);
+    NEditFree(sbuf->lenTree);
+    NEditFree(sbuf);
+}
+
+/*
+** Return the style of the character at "pos", or '\0' if "pos" is outside
+** of the buffer
+*/
+char StyleBufGetCharacter(styleBuffer *sbuf, ssize_t pos)
+{
+    styleBlock *b;
+
+    if (pos < 0 || pos >= sbuf->length)
+    	return '\0';
+    if (sbuf->cursorBlock >= 0) {
+    	b = sbuf->blocks[sbuf->cursorBlock];
+	if (pos >= sbuf->cursorRunStart &&
+	    	pos < sbuf->cursorRunStart + b->len[sbuf->cursorRun])
+	    return b->style[sbuf->cursorRun];
+    }
+    findRun(sbuf, pos);
+    return sbuf->blocks[sbuf->cursorBlock]->style[sbuf->cursorRun];
+}
+
+/*
+** Return the styles of the characters from "start" to "end" as a
+** null-terminated string, which the caller must free.  As with BufGetRange,
+** a bad start gives an empty string, and a bad end is adjusted.
+*/
+char *StyleBufGetRange(styleBuffer *sbuf, ssize_t start, ssize_t end)
+{
+    styleBlock *b;
+    char *styles;
+    ssize_t pos, runEnd;
+
+    if (start < 0 || start > sbuf->length) {
+    	styles = (char *)NEditMalloc(1);
+	styles[0] = '\0';
+	return styles;
+    }
+    if (end < start) {
+    	pos = start;
+	start = end;
+	end = pos;
+    }
+    if (end > sbuf->length)
+    	end = sbuf->length;
+    styles = (char *)NEditMalloc(end - start + 1);
+    for (pos=start; pos<end; pos=runEnd) {
+    	findRun(sbuf, pos);
+	b = sbuf->blocks[sbuf->cursorBlock];
+	runEnd = min(end, sbuf->cursorRunStart + b->len[sbuf->cursorRun]);
+	memset(&styles[pos - start], b->style[sbuf->cursorRun], runEnd - pos);
+    }
+    styles[end - start] = '\0';
+    return styles;
+}
+
+char *StyleBufGetAll(styleBuffer *sbuf)
+{
+    return StyleBufGetRange(sbuf, 0, sbuf->length);
+}
+
+/*
+** Replace the entire contents of the style buffer with "styles"
+*/
+void StyleBufSetAll(styleBuffer *sbuf, const char *styles)
+{
+    StyleBufSetAllLen(sbuf, styles, strlen(styles));
+}
+
+void StyleBufSetAllLen(styleBuffer *sbuf, const char *styles, ssize_t length)
+{
+    updateSelection(&sbuf->primary, 0, sbuf->length, 0);
+    replaceRuns(sbuf, 0, sbuf->length, styles, '\0', length);
+}
+
+/*
+** Replace the styles from "start" to "end" with the null-terminated string
+** "styles"
+*/
+void StyleBufReplace(styleBuffer *sbuf, ssize_t start, ssize_t end,
+        const char *styles)
+{
+    ssize_t length = strlen(styles);
+
+    updateSelection(&sbuf->primary, start, end - start, 0);
+    replaceRuns(sbuf, start, end, styles, '\0', length);
+    updateSelection(&sbuf->primary, start, 0, length);
+}
+
+/*
+** Replace the styles from "start" to "end" with "length" characters of
+** style "style", without needing a string of that length
+*/
+void StyleBufFill(styleBuffer *sbuf, ssize_t start, ssize_t end, char style,
+        ssize_t length)
+{
+    updateSelection(&sbuf->primary, start, end - start, 0);
+    replaceRuns(sbuf, start, end, NULL, style, length);
+    updateSelection(&sbuf->primary, start, 0, length);
+}
+
+void StyleBufRemove(styleBuffer *sbuf, ssize_t start, ssize_t end)
+{
+    ssize_t temp;
+
+    if (start > end) {
+    	temp = start;
+	start = end;
+	end = temp;
+    }
+    start = max(0, min(start, sbuf->length));
+    end = max(0, min(end, sbuf->length));
+    StyleBufFill(sbuf, start, end, '\0', 0);
+}
+
+/*
+** Mark the range from "start" to "end" as changed (see
+** extendRangeForStyleMods in textDisp.c), the style buffer equivalent of
+** BufSelect and BufUnselect
+*/
+void StyleBufSelect(styleBuffer *sbuf, ssize_t start, ssize_t end)
+{
+    sbuf->primary.selected = start != end;
+    sbuf->primary.zeroWidth = start == end;
+    sbuf->primary.rectangular = False;
+    sbuf->primary.start = min(start, end);
+    sbuf->primary.end = max(start, end);
+}
+
+void StyleBufUnselect(styleBuffer *sbuf)
+{
+    sbuf->primary.selected = False;
+    sbuf->primary.zeroWidth = False;
+}
+
+/*
+** Return the lowest position whose style may have changed since the style
+** buffer's generation was "generation", so that information derived from the
+** styles before that position can be kept.  Returns -1 if nothing changed,
+** and 0 if the changes are too many to tell.
+*/
+ssize_t StyleBufChangedSince(const styleBuffer *sbuf, unsigned long generation)
+{
+    ssize_t pos = -1;
+    unsigned long g;
+
+    if (sbuf->generation - generation > STYLE_CHANGE_LOG_SIZE)
+    	return 0;
+    for (g = generation + 1; g != sbuf->generation + 1; g++)
+    	if (pos == -1 || sbuf->changeLog[g % STYLE_CHANGE_LOG_SIZE] < pos)
+    	    pos = sbuf->changeLog[g % STYLE_CHANGE_LOG_SIZE];
+    return pos;
+}
+
+/*
+** Replace the styles from "start" to "end" with "length" characters, taken
+** from "styles", or if "styles" is NULL, all of style "fill"
+*/
+static void replaceRuns(styleBuffer *sbuf, ssize_t start, ssize_t end,
+	const char *styles, char fill, ssize_t length)
+{
+    runPacker p;
+    styleBlock *b;
+    ssize_t i, j, first, last, nOld, startOffset, endOffset;
+
+    if (start == end && length == 0)
+    	return;
+    sbuf->changeLog[++sbuf->generation % STYLE_CHANGE_LOG_SIZE] = start;
+
+    /* Find the blocks holding the first and last characters to replace, or
+       the one to insert into */
+    first = 0;
+    last = -1;
+    startOffset = endOffset = 0;
+    if (sbuf->nBlocks > 0) {
+    	first = treeFind(sbuf->lenTree, sbuf->nBlocks, start, &startOffset);
+	if (first == sbuf->nBlocks) {
+	    first--;
+	    startOffset = sbuf->len[first];
+	}
+	if (end > start) {
+	    last = treeFind(sbuf->lenTree, sbuf->nBlocks, end - 1, &endOffset);
+	    endOffset++;
+	} else {
+	    last = first;
+	    endOffset = startOffset;
+	}
+    }
+
+    /* Re-pack the runs in those blocks before start, the new runs, and the
+       runs after end.  A block left with few runs takes in the next one. */
+    p.blocks = NULL;
+    p.len = NULL;
+    p.nBlocks = p.nAlloc = 0;
+    if (sbuf->nBlocks > 0)
+    	packBlockRuns(&p, sbuf->blocks[first], 0, startOffset);
+    if (styles == NULL)
+    	packRun(&p, fill, length);
+    else {
+    	for (i=0; i<length; i=j) {
+	    for (j=i+1; j<length && styles[j]==styles[i]; j++);
+	    packRun(&p, styles[i], j-i);
+	}
+    }
+    if (sbuf->nBlocks > 0) {
+    	packBlockRuns(&p, sbuf->blocks[last], endOffset, sbuf->len[last]);
+    	if (last + 1 < sbuf->nBlocks && p.nBlocks > 0 &&
+	    	p.blocks[p.nBlocks-1]->nRuns < STYLE_BLOCK_RUNS/4) {
+	    last++;
+	    packBlockRuns(&p, sbuf->blocks[last], 0, sbuf->len[last]);
+	}
+    }
+    balanceLastBlocks(&p);
+    for (i=0; i<p.nBlocks; i++) {
+    	b = allocBlock(p.blocks[i]->nRuns);
+	b->nRuns = p.blocks[i]->nRuns;
+	memcpy(b->len, p.blocks[i]->len, b->nRuns * sizeof(unsigned short));
+	memcpy(b->style, p.blocks[i]->style, b->nRuns);
+	NEditFree(p.blocks[i]);
+	p.blocks[i] = b;
+    }
+
+    /* Replace the old blocks with the new ones.  Only when the number of
+       blocks changes does the tree need rebuilding. */
+    nOld = last - first + 1;
+    for (i=first; i<=last; i++)
+    	NEditFree(sbuf->blocks[i]);
+    if (p.nBlocks == nOld) {
+    	for (i=0; i<nOld; i++) {
+	    sbuf->blocks[first + i] = p.blocks[i];
+	    for (j=first+i+1; j<=sbuf->nBlocks; j += j & -j)
+	    	sbuf->lenTree[j] += p.len[i] - sbuf->len[first + i];
+	    sbuf->len[first + i] = p.len[i];
+	}
+    } else {
+    	growBlocks(sbuf, sbuf->nBlocks - nOld + p.nBlocks);
+	memmove(&sbuf->blocks[first + p.nBlocks], &sbuf->blocks[last + 1],
+	    	(sbuf->nBlocks - last - 1) * sizeof(styleBlock *));
+	memmove(&sbuf->len[first + p.nBlocks], &sbuf->len[last + 1],
+	    	(sbuf->nBlocks - last - 1) * sizeof(ssize_t));
+	for (i=0; i<p.nBlocks; i++) {
+	    sbuf->blocks[first + i] = p.blocks[i];
+	    sbuf->len[first + i] = p.len[i];
+	}
+	sbuf->nBlocks += p.nBlocks - nOld;
+	buildTree(sbuf);
+    }
+    NEditFree(p.blocks);
+    NEditFree(p.len);
+
+    sbuf->length += length - (end - start);
+    sbuf->cursorBlock = -1;
+}
+
+/*
+** Add "length" characters of style "style" to the runs being packed,
+** extending the last run if it has the same style
+*/
+static void packRun(runPacker *p, char style, ssize_t length)
+{
+    styleBlock *b = p->nBlocks == 0 ? NULL : p->blocks[p->nBlocks-1];
+    ssize_t n;
+
+    while (length > 0) {
+    	if (b != NULL && b->nRuns > 0 && b->style[b->nRuns-1] == style &&
+	    	b->len[b->nRuns-1] < STYLE_RUN_MAX) {
+	    n = min(length, STYLE_RUN_MAX - b->len[b->nRuns-1]);
+	    b->len[b->nRuns-1] += n;
+	} else {
+	    if (b == NULL || b->nRuns == STYLE_BLOCK_RUNS) {
+	    	if (p->nBlocks == p->nAlloc) {
+		    p->nAlloc = max(4, p->nAlloc * 2);
+		    p->blocks = (styleBlock **)NEditRealloc(p->blocks,
+		    	    p->nAlloc * sizeof(styleBlock *));
+		    p->len = (ssize_t *)NEditRealloc(p->len,
+		    	    p->nAlloc * sizeof(ssize_t));
+		}
+		b = allocBlock(STYLE_BLOCK_RUNS);
+		p->blocks[p->nBlocks] = b;
+		p->len[p->nBlocks++] = 0;
+	    }
+	    n = min(length, STYLE_RUN_MAX);
+	    b->style[b->nRuns] = style;
+	    b->len[b->nRuns++] = n;
+	}
+	p->len[p->nBlocks-1] += n;
+	length -= n;
+    }
+}
+
+/*
+** Add the runs covering characters "from" to "to" of block "b" (counting
+** from the start of the block) to the runs being packed
+*/
+static void packBlockRuns(runPacker *p, const styleBlock *b, ssize_t from,
+	ssize_t to)
+{
+    ssize_t runStart = 0, s, e;
+    int i;
+
+    for (i=0; i<b->nRuns && runStart<to; runStart += b->len[i++]) {
+    	s = max(from, runStart);
+	e = min(to, runStart + b->len[i]);
+	if (s < e)
+	    packRun(p, b->style[i], e - s);
+    }
+}
+
+/*
+** Blocks are packed full, so even out the runs of the last two if the last
+** is less than half full, rather than leave a small block behind every edit
+*/
+static void balanceLastBlocks(runPacker *p)
+{
+    styleBlock *a, *b;
+    int i, nMove;
+    ssize_t moved = 0;
+
+    if (p->nBlocks < 2)
+    	return;
+    a = p->blocks[p->nBlocks-2];
+    b = p->blocks[p->nBlocks-1];
+    nMove = (a->nRuns - b->nRuns) / 2;
+    if (b->nRuns >= STYLE_BLOCK_RUNS/2 || nMove <= 0)
+    	return;
+    memmove(&b->len[nMove], b->len, b->nRuns * sizeof(unsigned short));
+    memmove(&b->style[nMove], b->style, b->nRuns);
+    for (i=0; i<nMove; i++) {
+    	b->len[i] = a->len[a->nRuns - nMove + i];
+	b->style[i] = a->style[a->nRuns - nMove + i];
+	moved += b->len[i];
+    }
+    a->nRuns -= nMove;
+    b->nRuns += nMove;
+    p->len[p->nBlocks-2] -= moved;
+    p->len[p->nBlocks-1] += moved;
+}
+
+/*
+** Allocate a block with room for "nRuns" runs
+*/
+static styleBlock *allocBlock(int nRuns)
+{
+    styleBlock *b = (styleBlock *)NEditMalloc(sizeof(styleBlock) +
+    	    nRuns * (sizeof(unsigned short) + 1));
+
+    b->nRuns = 0;
+    b->len = (unsigned short *)(b + 1);
+    b->style = (char *)(b->len + nRuns);
+    return b;
+}
+
+/*
+** Find the run holding "pos" (which must be inside the buffer), and leave
+** it in the lookup cursor.  Positions in or next to the block of the last
+** lookup are found by stepping from the run found then.
+*/
+static void findRun(styleBuffer *sbuf, ssize_t pos)
+{
+    ssize_t block = sbuf->cursorBlock, blockStart, runStart, offset;
+    styleBlock *b;
+    int run;
+
+    if (block >= 0 && pos >= sbuf->cursorBlockStart &&
+    	    pos < sbuf->cursorBlockStart + sbuf->len[block]) {
+    	run = sbuf->cursorRun;
+	runStart = sbuf->cursorRunStart;
+    } else if (block >= 0 && block+1 < sbuf->nBlocks &&
+    	    pos >= sbuf->cursorBlockStart + sbuf->len[block] &&
+    	    pos < sbuf->cursorBlockStart + sbuf->len[block] +
+	    sbuf->len[block+1]) {
+	runStart = sbuf->cursorBlockStart += sbuf->len[block];
+	sbuf->cursorBlock = block + 1;
+	run = 0;
+    } else if (block > 0 && pos < sbuf->cursorBlockStart &&
+    	    pos >= sbuf->cursorBlockStart - sbuf->len[block-1]) {
+	blockStart = sbuf->cursorBlockStart -= sbuf->len[block-1];
+	sbuf->cursorBlock = block - 1;
+	b = sbuf->blocks[block-1];
+	run = b->nRuns - 1;
+	runStart = blockStart + sbuf->len[block-1] - b->len[run];
+    } else {
+    	block = treeFind(sbuf->lenTree, sbuf->nBlocks, pos, &offset);
+	sbuf->cursorBlock = block;
+	runStart = sbuf->cursorBlockStart = pos - offset;
+	run = 0;
+    }
+
+    b = sbuf->blocks[sbuf->cursorBlock];
+    while (pos >= runStart + b->len[run])
+    	runStart += b->len[run++];
+    while (pos < runStart)
+    	runStart -= b->len[--run];
+    sbuf->cursorRun = run;
+    sbuf->cursorRunStart = runStart;
+}
+
+/*
+** Find the block in which the running sum of the Fenwick tree "tree" first
+** exceeds "target".  Returns the block number (nBlocks if the total doesn't
+** exceed target), and in "remainder", the part of target falling inside it.
+*/
+static ssize_t treeFind(const ssize_t *tree, ssize_t nBlocks, ssize_t target,
+	ssize_t *remainder)
+{
+    ssize_t block = 0, step = 1;
+
+    while (step*2 <= nBlocks)
+    	step *= 2;
+    for (; step>0; step /= 2) {
+    	if (block + step <= nBlocks && tree[block + step] <= target) {
+    	    block += step;
+    	    target -= tree[block];
+	}
+    }
+    *remainder = target;
+    return block;
+}
+
+/*
+** Rebuild the Fenwick tree of block lengths
+*/
+static void buildTree(styleBuffer *sbuf)
+{
+    ssize_t i, parent;
+
+    for (i=1; i<=sbuf->nBlocks; i++)
+    	sbuf->lenTree[i] = sbuf->len[i-1];
+    for (i=1; i<=sbuf->nBlocks; i++) {
+    	parent = i + (i & -i);
+	if (parent <= sbuf->nBlocks)
+    	    sbuf->lenTree[parent] += sbuf->lenTree[i];
+    }
+}
+
+/*
+** Make room for at least "nBlocks" blocks
+*/
+static void growBlocks(styleBuffer *sbuf, ssize_t nBlocks)
+{
+    if (nBlocks <= sbuf->nAlloc)
+    	return;
+    sbuf->nAlloc = max(nBlocks, sbuf->nAlloc + sbuf->nAlloc/2);
+    sbuf->blocks = (styleBlock **)NEditRealloc(sbuf->blocks,
+    	    sbuf->nAlloc * sizeof(styleBlock *));
+    sbuf->len = (ssize_t *)NEditRealloc(sbuf->len,
+    	    sbuf->nAlloc * sizeof(ssize_t));
+    sbuf->lenTree = (ssize_t *)NEditRealloc(sbuf->lenTree,
+    	    (sbuf->nAlloc + 1) * sizeof(ssize_t));
+}
+
+/*
+** Move the changed range marker for an insertion or deletion, in the same
+** way as a text buffer moves its selections
+*/
+static void updateSelection(selection *sel, ssize_t pos, ssize_t nDeleted,
+	ssize_t nInserted)
+{
+    if ((!sel->selected && !sel->zeroWidth) || pos > sel->end)
+    	return;
+    if (pos+nDeleted <= sel->start) {
+    	sel->start += nInserted - nDeleted;
+	sel->end += nInserted - nDeleted;
+    } else if (pos <= sel->start && pos+nDeleted >= sel->end) {
+    	sel->start = pos;
+    	sel->end = pos;
+    	sel->selected = False;
+        sel->zeroWidth = False;
+    } else if (pos <= sel->start && pos+nDeleted < sel->end) {
+    	sel->start = pos;
+    	sel->end = nInserted + sel->end - nDeleted;
+    } else if (pos < sel->end) {
+    	sel->end += nInserted - nDeleted;
+	if (sel->end <= sel->start)
+	    sel->selected = False;
+    }
+}
@@ -0,0 +1,72 @@
+/*******************************************************************************
+*                                                                              *
+* styleBuf.h -- Nirvana Editor Style Buffer Header File                        *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* software; if not, write to the Free Software Foundation, Inc., 59 Temple     *
+* Place, Suite 330, Boston, MA  02111-1307 USA                                 *
+*                                                                              *
+*******************************************************************************/
+
+#ifndef NEDIT_STYLEBUF_H_INCLUDED
+#define NEDIT_STYLEBUF_H_INCLUDED
+
+#include "textBuf.h"
+
+#include <sys/types.h>
+
+typedef struct _styleBlock styleBlock;
+
+/* Number of recent changes whose positions StyleBufChangedSince can report */
+#define STYLE_CHANGE_LOG_SIZE 16
+
+/* Style codes for each character of a text buffer, held as runs of
+   characters with the same style (see styleBuf.c) */
+typedef struct _styleBuffer {
+    ssize_t length; 	        /* number of characters covered */
+    selection primary;	        /* range whose styles have changed since the
+                                   display last looked (see
+                                   extendRangeForStyleMods in textDisp.c) */
+    ssize_t nBlocks;		/* number of blocks of runs in use */
+    ssize_t nAlloc;		/* allocated length of the arrays below */
+    styleBlock **blocks;
+    ssize_t *len;		/* characters covered by each block */
+    ssize_t *lenTree;		/* Fenwick tree (1-based) over len */
+    ssize_t cursorBlock;	/* run found by the last lookup, to make */
+    int cursorRun;		/*   lookups of nearby positions fast, */
+    ssize_t cursorBlockStart;	/*   or -1 for none */
+    ssize_t cursorRunStart;
+    unsigned long generation;	/* incremented on every change of styles */
+    ssize_t changeLog[STYLE_CHANGE_LOG_SIZE]; /* where the changes making the
+    				   last few generations started, indexed by
+    				   generation modulo STYLE_CHANGE_LOG_SIZE */
+} styleBuffer;
+
+styleBuffer *StyleBufCreate(void);
+void StyleBufFree(styleBuffer *sbuf);
+char StyleBufGetCharacter(styleBuffer *sbuf, ssize_t pos);
+char *StyleBufGetRange(styleBuffer *sbuf, ssize_t start, ssize_t end);
+char *StyleBufGetAll(styleBuffer *sbuf);
+void StyleBufSetAll(styleBuffer *sbuf, const char *styles);
+void StyleBufSetAllLen(styleBuffer *sbuf, const char *styles, ssize_t length);
+void StyleBufReplace(styleBuffer *sbuf, ssize_t start, ssize_t end,
+        const char *styles);
+void StyleBufFill(styleBuffer *sbuf, ssize_t start, ssize_t end, char style,
+        ssize_t length);
+void StyleBufRemove(styleBuffer *sbuf, ssize_t start, ssize_t end);
+void StyleBufSelect(styleBuffer *sbuf, ssize_t start, ssize_t end);
+void StyleBufUnselect(styleBuffer *sbuf);
+ssize_t StyleBufChangedSince(const styleBuffer *sbuf, unsigned long generation);
+
+#endif /* NEDIT_STYLEBUF_H_INCLUDED */
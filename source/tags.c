@@ -103,7 +103,7 @@ static void setTag(tag *t, const char *name, const char *file,
                    int language, const char *searchString, int posInf, 
                    const char * tag);
 static int fakeRegExSearch(WindowInfo *window, char *buffer, 
-                        const char *searchString, int *startPos, int *endPos);
+                        const char *searchString, ssize_t *startPos, ssize_t *endPos);
 static void updateMenuItems(void);
 static int addTag(const char *name, const char *file, int lang, 
                     const char *search, int posInf,  const  char *path, 
@@ -1010,9 +1010,10 @@ static void setTag(tag *t, const char *name, const char *file,
 ** caller is responsible for freeing it.
 */
 static int fakeRegExSearch(WindowInfo *window, char *in_buffer, 
-        const char *searchString, int *startPos, int *endPos)
+        const char *searchString, ssize_t *startPos, ssize_t *endPos)
 {
-    int found, searchStartPos, dir, ctagsMode;
+    int found, dir, ctagsMode;
+    ssize_t searchStartPos;
     char searchSubs[3*MAXLINE+3], *outPtr;
     const char *fileString, *inPtr;
     
@@ -1293,7 +1294,7 @@ static void findAllCloseCB(Widget parent, XtPointer client_data,
  * string is reached before n lines, return the number of lines advanced,
  * else normally return -1.
  */
-static int moveAheadNLines( char *str, int *pos, int n ) {
+static int moveAheadNLines( char *str, ssize_t *pos, int n ) {
     int i=n;
     while (str[*pos] != '\0' && n>0) {
         if (str[*pos] == '\n')
@@ -1313,8 +1314,7 @@ static int moveAheadNLines( char *str, int *pos, int n ) {
 */ 
 static void showMatchingCalltip( Widget parent, int i )
 {
-    int startPos=0, fileLen, readLen, tipLen;
-    int endPos=0;
+    ssize_t startPos=0, endPos=0, fileLen, readLen, tipLen;
     char *fileString;
     FILE *fp;
     struct stat statbuf;
@@ -1388,7 +1388,8 @@ static void showMatchingCalltip( Widget parent, int i )
     }
     
     if (searchMode == TIP) {
-        int dummy, found;
+        ssize_t dummy;
+        int found;
                 
         /* 4. Find the end of the calltip (delimited by an empty line) */
         endPos = startPos;
@@ -1435,7 +1436,8 @@ static void editTaggedLocation( Widget parent, int i )
 {
     /* Globals: tagSearch, tagPosInf, tagFiles, tagName, textNrows,
             WindowList */
-    int startPos, endPos, lineNum, rows;
+    ssize_t startPos, endPos;
+    int lineNum, rows;
     char filename[MAXPATHLEN], pathname[MAXPATHLEN];
     WindowInfo *windowToSearch;
     WindowInfo *parentWindow = WidgetToWindow(parent);
@@ -1530,7 +1532,7 @@ enum tftoken_types { TF_EOF, TF_BLOCK, TF_VERSION, TF_INCLUDE, TF_LANGUAGE,
 
 /* A wrapper for SearchString */
 static int searchLine(char *line, const char *regex) {
-    int dummy1, dummy2;
+    ssize_t dummy1, dummy2;
     return SearchString(line, regex, SEARCH_FORWARD, SEARCH_REGEX,
                              False, 0, &dummy1, &dummy2, NULL, NULL, NULL);
 }
@@ -1547,7 +1549,7 @@ static Boolean lineEmpty(const char *line) {
 
 /* Remove trailing whitespace from a line */
 static void rstrip( char *dst, const char *src ) {
-    int wsStart, dummy2;
+    ssize_t wsStart, dummy2;
     /* Strip trailing whitespace */
     if(SearchString(src, "\\s*\\n", SEARCH_FORWARD, SEARCH_REGEX,
                          False, 0, &wsStart, &dummy2, NULL, NULL, NULL)) {
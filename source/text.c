@@ -237,13 +237,13 @@ static int pendingSelection(Widget w);
 static int deletePendingSelection(Widget w, XEvent *event);
 static int deleteEmulatedTab(Widget w, XEvent *event);
 static void selectWord(Widget w, int pointerX);
-static int spanForward(textBuffer *buf, int startPos, char *searchChars,
-	int ignoreSpace, int *foundPos);
-static int spanBackward(textBuffer *buf, int startPos, char *searchChars, int
-    	ignoreSpace, int *foundPos);
+static int spanForward(textBuffer *buf, ssize_t startPos, char *searchChars,
+	int ignoreSpace, ssize_t *foundPos);
+static int spanBackward(textBuffer *buf, ssize_t startPos, char *searchChars,
+    	int ignoreSpace, ssize_t *foundPos);
 static void selectLine(Widget w);
-static int startOfWord(TextWidget w, int pos);
-static int endOfWord(TextWidget w, int pos);
+static ssize_t startOfWord(TextWidget w, ssize_t pos);
+static ssize_t endOfWord(TextWidget w, ssize_t pos);
 static void checkAutoScroll(TextWidget w, int x, int y);
 static void endDrag(Widget w);
 static void cancelDrag(Widget w);
@@ -1154,7 +1154,7 @@ static void redisplay(TextWidget w, XEvent *event, Region region)
 {
     XExposeEvent *e = &event->xexpose;
     
-    TextDRedisplayRect(w->text.textD, e->x, e->y, e->width, e->height);
+    TextDExposeRect(w->text.textD, e->x, e->y, e->width, e->height);
 }
 
 static Bool findGraphicsExposeOrNoExposeEvent(Display *theDisplay, XEvent *event, XPointer arg)
@@ -1792,12 +1792,13 @@ void TextInsertAtCursor(Widget w, char *chars, XEvent *event,
 ** Fetch text from the widget's buffer, adding wrapping newlines to emulate
 ** effect acheived by wrapping in the text display in continuous wrap mode.
 */
-char *TextGetWrapped(Widget w, int startPos, int endPos, int *outLen)
+char *TextGetWrapped(Widget w, ssize_t startPos, ssize_t endPos,
+        ssize_t *outLen)
 {
     textDisp *textD = ((TextWidget)w)->text.textD;
     textBuffer *buf = textD->buffer;
     textBuffer *outBuf;
-    int fromPos, toPos, outPos;
+    ssize_t fromPos, toPos, outPos;
     char c, *outString;
     
     if (!((TextWidget)w)->text.continuousWrap || startPos == endPos) {
@@ -1837,6 +1838,20 @@ char *TextGetWrapped(Widget w, int startPos, int endPos, int *outLen)
     return outString;
 }
 
+/*
+** Return a report of the work done to draw the text (see
+** TextDRenderStatsReport), which must be freed with NEditFree
+*/
+char *TextGetRenderStats(Widget w)
+{
+    return TextDRenderStatsReport(((TextWidget)w)->text.textD);
+}
+
+void TextResetRenderStats(Widget w)
+{
+    TextDResetRenderStats(((TextWidget)w)->text.textD);
+}
+
 /*
 ** Return the (statically allocated) action table for menu item actions.
 **
@@ -1994,7 +2009,7 @@ static void extendStartAP(Widget w, XEvent *event, String *args,
     	    	    (sel->end + sel->start) / 2 ? sel->end : sel->start);
     	    anchor = BufCountForwardDispChars(buf, anchorLineStart, rectAnchor);
     	} else {
-    	    if (abs(newPos - sel->start) < abs(newPos - sel->end))
+    	    if (labs(newPos - sel->start) < labs(newPos - sel->end))
     		anchor = sel->end;
     	    else
     		anchor = sel->start;
@@ -2068,7 +2083,7 @@ static void secondaryStartAP(Widget w, XEvent *event, String *args,
     /* Find the new anchor point and make the new selection */
     pos = TextDXYToPosition(textD, e->x, e->y);
     if (sel->selected) {
-    	if (abs(pos - sel->start) < abs(pos - sel->end))
+    	if (labs(pos - sel->start) < labs(pos - sel->end))
     	    anchor = sel->end;
     	else
     	    anchor = sel->start;
@@ -2729,6 +2744,42 @@ static void deleteSelectionAP(Widget w, XEvent *event, String *args,
     deletePendingSelection(w, event);
 }
 
+/*
+** Delete the character before ("forward" False) or after each cursor of a
+** multi-cursor text widget, all in a single buffer modification
+*/
+static void deleteAtCursors(Widget w, textDisp *textD, int silent,
+        int forward)
+{
+    textBuffer *buf = textD->buffer;
+    size_t mcursorSize = textD->mcursorSize;
+    bufEdit *edits = NEditMalloc(mcursorSize * sizeof(bufEdit));
+    Bool ring = False;
+    
+    for(int i=0;i<mcursorSize;i++) {
+        ssize_t pos = textD->multicursor[i].cursorPos;
+        edits[i].pos = pos;
+        edits[i].nDeleted = 0;
+        edits[i].text = "";
+        if(forward ? pos == buf->length : pos == 0) {
+            ring = True;
+        } else if(forward) {
+            edits[i].nDeleted = BufRightPos(buf, pos) - pos;
+        } else {
+            edits[i].pos = BufLeftPos(buf, pos);
+            edits[i].nDeleted = pos - edits[i].pos;
+        }
+    }
+    
+    BufBeginModifyBatch(buf);
+    TextDApplyCursorEdits(textD, edits);
+    BufEndModifyBatch(buf);
+    NEditFree(edits);
+    if(ring) {
+        ringIfNecessary(silent, w);
+    }
+}
+
 static int deletePreviousCharacter(Widget w, XEvent *event, textDisp *textD, int silent, int insertPos) {
     char c;
     
@@ -2770,6 +2821,14 @@ static void deletePreviousCharacterAP(Widget w, XEvent *event, String *args,
     	return;
     
     size_t mcursorSize = textD->mcursorSize;
+    if(mcursorSize > 1 && !((TextWidget)w)->text.overstrike &&
+            (((TextWidget)w)->text.emulateTabs <= 0 ||
+             ((TextWidget)w)->text.emTabsBeforeCursor <= 0)) {
+        deleteAtCursors(w, textD, silent, False);
+        checkAutoShowInsertPos(w);
+        return;
+    }
+    
     Bool batch = False;
     if(mcursorSize > 1) {
         BufBeginModifyBatch(textD->buffer);
@@ -2822,34 +2881,13 @@ static void deleteNextCharacterAP(Widget w, XEvent *event, String *args,
     if (deletePendingSelection(w, event))
     	return;
       
-    int diff = 0;
-    int prevPos = -1;
-    size_t mcursorSize = textD->mcursorSize;
-    Bool batch = False;
-    if(mcursorSize > 1) {
-        BufBeginModifyBatch(textD->buffer);
-        batch = True;
-    }
-    
-    for(int i=0;i<mcursorSize;i++) {
-        textD->multicursor[i].cursorPos += diff;
-        textD->cursor = textD->multicursor + i;
-        diff += deleteNextCharacter(w, textD, silent, textD->cursor->cursorPos);
-        if(textD->cursor->cursorPos == prevPos) {
-            TextDRemoveCursor(textD, i);
-            mcursorSize--;
-            i--;
-        } else {
-            prevPos = textD->cursor->cursorPos;
-        }
-        callCursorMovementCBs(w, event);
+    if(textD->mcursorSize > 1) {
+        deleteAtCursors(w, textD, silent, True);
+    } else {
+        deleteNextCharacter(w, textD, silent, TextDGetInsertPosition(textD));
     }
-    
+    callCursorMovementCBs(w, event);
     checkAutoShowInsertPos(w);
-    
-    if(batch) {
-        BufEndModifyBatch(textD->buffer);
-    }
 }
 
 static void deletePreviousWordAP(Widget w, XEvent *event, String *args,
@@ -3697,9 +3735,9 @@ static void nextPageAP(Widget w, XEvent *event, String *args, Cardinal *nArgs)
     int lastTopLine = max(1, 
             textD->nBufferLines - (textD->nVisibleLines - 2) + 
             ((TextWidget)w)->text.cursorVPadding );
-    int insertPos = TextDGetInsertPosition(textD);
-    int column = 0, visLineNum, lineStartPos;
-    int pos, targetLine;
+    ssize_t insertPos = TextDGetInsertPosition(textD);
+    ssize_t lineStartPos, pos;
+    int column = 0, visLineNum, targetLine;
     int pageForwardCount = max(1, textD->nVisibleLines - 1);
     int maintainColumn = 0;
     int silent = hasKey("nobell", args, nArgs);
@@ -3791,9 +3829,9 @@ static void previousPageAP(Widget w, XEvent *event, String *args,
 	Cardinal *nArgs)
 {
     textDisp *textD = ((TextWidget)w)->text.textD;
-    int insertPos = TextDGetInsertPosition(textD);
-    int column = 0, visLineNum, lineStartPos;
-    int pos, targetLine;
+    ssize_t insertPos = TextDGetInsertPosition(textD);
+    ssize_t lineStartPos, pos;
+    int column = 0, visLineNum, targetLine;
     int pageBackwardCount = max(1, textD->nVisibleLines - 1);
     int maintainColumn = 0;
     int silent = hasKey("nobell", args, nArgs);
@@ -4216,7 +4254,7 @@ static void keyMoveExtendSelection(Widget w, XEvent *event, int origPos,
 	BufRectSelect(buf, startPos, endPos, startCol, endCol);
     } else if (sel->selected && rectangular) { /* plain -> rect */
         newCol = BufCountDispChars(buf, BufStartOfLine(buf, newPos), newPos);
-        if (abs(newPos - sel->start) < abs(newPos - sel->end))
+        if (labs(newPos - sel->start) < labs(newPos - sel->end))
             anchor = sel->end;
         else
             anchor = sel->start;
@@ -4238,7 +4276,7 @@ static void keyMoveExtendSelection(Widget w, XEvent *event, int origPos,
     	    anchor = startPos;
     	BufSelect(buf, anchor, newPos);
     } else if (sel->selected) { /* plain -> plain */
-        if (abs(origPos - sel->start) < abs(origPos - sel->end))
+        if (labs(origPos - sel->start) < labs(origPos - sel->end))
     	    anchor = sel->end;
     	else
     	    anchor = sel->start;
@@ -4311,6 +4349,19 @@ static void simpleInsertAtCursor(Widget w, char *chars, XEvent *event,
     } else {
         if(textD->mcursorSize == 1) {
             simpleInsertAtCursorPos(w, textD, chars);
+        } else if(!((TextWidget)w)->text.overstrike) {
+            // insert at all cursors in a single buffer modification
+            size_t mcursorSize = textD->mcursorSize;
+            bufEdit *edits = NEditMalloc(mcursorSize * sizeof(bufEdit));
+            for(int i=0;i<mcursorSize;i++) {
+                edits[i].pos = textD->multicursor[i].cursorPos;
+                edits[i].nDeleted = 0;
+                edits[i].text = chars;
+            }
+            BufBeginModifyBatch(buf);
+            TextDApplyCursorEdits(textD, edits);
+            BufEndModifyBatch(buf);
+            NEditFree(edits);
         } else {
             BufBeginModifyBatch(buf);
             TextDBlankCursor(textD);
@@ -4466,9 +4517,9 @@ static void selectWord(Widget w, int pointerX)
     BufSelect(buf, startOfWord(tw, insertPos), endOfWord(tw, insertPos));
 }
 
-static int startOfWord(TextWidget w, int pos)
+static ssize_t startOfWord(TextWidget w, ssize_t pos)
 {
-    int startPos;
+    ssize_t startPos;
     textBuffer *buf = w->text.textD->buffer;
     char *delimiters=w->text.delimiters;
     char c = BufGetCharacter(buf, pos);
@@ -4487,9 +4538,9 @@ static int startOfWord(TextWidget w, int pos)
                 
 }
 
-static int endOfWord(TextWidget w, int pos)
+static ssize_t endOfWord(TextWidget w, ssize_t pos)
 {
-    int endPos;
+    ssize_t endPos;
     textBuffer *buf = w->text.textD->buffer;
     char *delimiters=w->text.delimiters;
     char c = BufGetCharacter(buf, pos);
@@ -4513,10 +4564,10 @@ static int endOfWord(TextWidget w, int pos)
 ** result in "foundPos" returns True if found, False if not. If ignoreSpace
 ** is set, then Space, Tab, and Newlines are ignored in searchChars.
 */
-static int spanForward(textBuffer *buf, int startPos, char *searchChars,
-	int ignoreSpace, int *foundPos)
+static int spanForward(textBuffer *buf, ssize_t startPos, char *searchChars,
+	int ignoreSpace, ssize_t *foundPos)
 {
-    int pos;
+    ssize_t pos;
     char *c;
     
     pos = startPos;
@@ -4541,10 +4592,10 @@ static int spanForward(textBuffer *buf, int startPos, char *searchChars,
 ** result in "foundPos" returns True if found, False if not. If ignoreSpace is
 ** set, then Space, Tab, and Newlines are ignored in searchChars. 
 */
-static int spanBackward(textBuffer *buf, int startPos, char *searchChars, int
-    	ignoreSpace, int *foundPos)
+static int spanBackward(textBuffer *buf, ssize_t startPos, char *searchChars,
+    	int ignoreSpace, ssize_t *foundPos)
 {
-    int pos;
+    ssize_t pos;
     char *c;
     
     if (startPos == 0) {
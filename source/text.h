@@ -193,7 +193,10 @@ void TextInsertAtCursor(Widget w, char *chars, XEvent *event,
     	int allowPendingDelete, int allowWrap);
 int TextFirstVisiblePos(Widget w);
 int TextLastVisiblePos(Widget w);
-char *TextGetWrapped(Widget w, int startPos, int endPos, int *length);
+char *TextGetWrapped(Widget w, ssize_t startPos, ssize_t endPos,
+        ssize_t *length);
+char *TextGetRenderStats(Widget w);
+void TextResetRenderStats(Widget w);
 XtActionsRec *TextGetActions(int *nActions);
 void ShowHidePointer(TextWidget w, Boolean hidePointer);
 void ResetCursorBlink(TextWidget textWidget, Boolean startsBlanked);
@@ -32,6 +32,7 @@
 
 #include "textBuf.h"
 #include "rangeset.h"
+#include "textScan.h"
 #include "../util/nedit_malloc.h"
 
 #include <stdio.h>
@@ -48,21 +49,50 @@
 #define PREFERRED_GAP_SIZE 80	/* Initial size for the buffer gap (empty space
                                    in the buffer where text might be inserted
                                    if the user is typing sequential chars) */
+#define GAP_GROWTH_DIVISOR 64	/* when the gap has to grow, it gets at least
+				   this fraction of the text length, so that
+				   a series of growing edits (such as a
+				   chunked replace all) doesn't copy the whole
+				   buffer each time */
 
 #define ANSI_ESC_BLOCKSZ 32
 
-static void histogramCharacters(const char *string, int length, char hist[256],
+#define LINE_INDEX_BLOCK 16384	/* nominal number of characters covered by
+				   each block of the line index */
+#define LINE_INDEX_MAX_BLOCK (4*LINE_INDEX_BLOCK) /* blocks growing past this
+				   size are split */
+#define LINE_INDEX_MIN_SPAN 65536 /* line counts over shorter distances than
+				   this are done by scanning the text */
+#define LINE_INDEX_MIN_LINES 256 /* ...as are moves of fewer lines than this */
+
+/* Line index.  The buffer is divided into blocks of roughly LINE_INDEX_BLOCK
+   characters, and the length and newline count of each block is kept in a
+   pair of Fenwick (binary indexed) trees, so the line number of a position,
+   and the position of a line, can be found in logarithmic time.  Block
+   boundaries move with the text, so an edit only changes the counts of the
+   blocks it touches. */
+struct _lineIndex {
+    ssize_t nBlocks;		/* number of blocks in use */
+    ssize_t nAlloc;		/* allocated length of the arrays below */
+    ssize_t *len;		/* length of each block */
+    ssize_t *nl;		/* number of newlines in each block */
+    ssize_t *lenTree;		/* Fenwick trees (1-based) over len and nl */
+    ssize_t *nlTree;
+};
+
+static void histogramCharacters(const char *string, ssize_t length, char hist[256],
 	int init);
-static void subsChars(char *string, int length, char fromChar, char toChar);
+static void subsChars(char *string, ssize_t length, char fromChar, char toChar);
 static char chooseNullSubsChar(char hist[256]);
-static int insert(textBuffer *buf, int pos, const char *text);
-static void delete(textBuffer *buf, int start, int end);
-static void deleteRect(textBuffer *buf, int start, int end, int rectStart,
-	int rectEnd, int *replaceLen, int *endPos);
-static void insertCol(textBuffer *buf, int column, int startPos, const char *insText,
-	int *nDeleted, int *nInserted, int *endPos);
-static void overlayRect(textBuffer *buf, int startPos, int rectStart,
-    	int rectEnd, const char *insText, int *nDeleted, int *nInserted, int *endPos);
+static ssize_t insert(textBuffer *buf, ssize_t pos, const char *text);
+static void delete(textBuffer *buf, ssize_t start, ssize_t end);
+static void deleteRect(textBuffer *buf, ssize_t start, ssize_t end, int rectStart,
+	int rectEnd, ssize_t *replaceLen, ssize_t *endPos);
+static void insertCol(textBuffer *buf, int column, ssize_t startPos, const char *insText,
+	ssize_t *nDeleted, ssize_t *nInserted, ssize_t *endPos);
+static void overlayRect(textBuffer *buf, ssize_t startPos, int rectStart,
+    	int rectEnd, const char *insText, ssize_t *nDeleted, ssize_t *nInserted,
+	ssize_t *endPos);
 static void insertColInLine(const char *line, const char *insLine, int column, int insWidth,
 	int tabDist, int useTabs, char nullSubsChar, char *outStr, int *outLen,
 	int *endOffset);
@@ -72,46 +102,68 @@ static void deleteRectFromLine(const char *line, int rectStart, int rectEnd,
 static void overlayRectInLine(const char *line, const char *insLine, int rectStart,
     	int rectEnd, int tabDist, int useTabs, char nullSubsChar, char *outStr,
     	int *outLen, int *endOffset);
-static void callPreDeleteCBs(textBuffer *buf, int pos, int nDeleted);
-static void callModifyCBs(textBuffer *buf, int pos, int nDeleted,
-	int nInserted, int nRestyled, const char *deletedText);
+static void callPreDeleteCBs(textBuffer *buf, ssize_t pos, ssize_t nDeleted);
+static void replaceAll(textBuffer *buf, char *newBuf, ssize_t length,
+	ssize_t gapStart);
+static void callModifyCBs(textBuffer *buf, ssize_t pos, ssize_t nDeleted,
+	ssize_t nInserted, ssize_t nRestyled, const char *deletedText);
+static void callModifyCBsForEdits(textBuffer *buf, ssize_t pos,
+	ssize_t nDeleted, ssize_t nInserted, ssize_t nRestyled,
+	const char *deletedText, const bufModification *mods, int nMods);
 static void callBeginModifyCBs(textBuffer *buf);
 static void callEndModifyCBs(textBuffer *buf);
 static void redisplaySelection(textBuffer *buf, selection *oldSelection,
 	selection *newSelection);
-static void moveGap(textBuffer *buf, int pos);
-static void reallocateBuf(textBuffer *buf, int newGapStart, int newGapLen);
-static void setSelection(selection *sel, int start, int end);
-static void setRectSelect(selection *sel, int start, int end,
+static void moveGap(textBuffer *buf, ssize_t pos);
+static void reallocateBuf(textBuffer *buf, ssize_t newGapStart,
+	ssize_t newGapLen);
+static void setSelection(selection *sel, ssize_t start, ssize_t end);
+static void setRectSelect(selection *sel, ssize_t start, ssize_t end,
 	int rectStart, int rectEnd);
-static void updateSelections(textBuffer *buf, int pos, int nDeleted,
-	int nInserted);
-static void updateSelection(selection *sel, int pos, int nDeleted,
-	int nInserted);
-static int getSelectionPos(selection *sel, int *start, int *end,
+static void updateSelections(textBuffer *buf, ssize_t pos, ssize_t nDeleted,
+	ssize_t nInserted);
+static void updateSelection(selection *sel, ssize_t pos, ssize_t nDeleted,
+	ssize_t nInserted);
+static int getSelectionPos(selection *sel, ssize_t *start, ssize_t *end,
         int *isRect, int *rectStart, int *rectEnd);
 static char *getSelectionText(textBuffer *buf, selection *sel);
 static void removeSelected(textBuffer *buf, selection *sel);
 static void replaceSelected(textBuffer *buf, selection *sel, const char *text);
 static void addPadding(char *string, int startIndent, int toIndent,
 	int tabDist, int useTabs, char nullSubsChar, int *charsAdded);
-static int searchForward(textBuffer *buf, int startPos, char searchChar,
-	int *foundPos);
-static int searchBackward(textBuffer *buf, int startPos, char searchChar,
-	int *foundPos);
+static int searchForward(textBuffer *buf, ssize_t startPos, char searchChar,
+	ssize_t *foundPos);
+static int searchBackward(textBuffer *buf, ssize_t startPos, char searchChar,
+	ssize_t *foundPos);
+static int findCharSet(const textBuffer *buf, ssize_t startPos,
+	const scanCharSet *set, ssize_t *foundPos);
+static int findCharSetBackward(const textBuffer *buf, ssize_t startPos,
+	const scanCharSet *set, ssize_t *foundPos);
 static char *copyLine(const char *text, int *lineLen);
 static int countLines(const char *string);
 static int textWidth(const char *text, int tabDist, char nullSubsChar);
-static void findRectSelBoundariesForCopy(textBuffer *buf, int lineStartPos,
-	int rectStart, int rectEnd, int *selStart, int *selEnd);
+static void findRectSelBoundariesForCopy(textBuffer *buf, ssize_t lineStartPos,
+	int rectStart, int rectEnd, ssize_t *selStart, ssize_t *selEnd);
 static char *realignTabs(const char *text, int origIndent, int newIndent,
 	int tabDist, int useTabs, char nullSubsChar, int *newLength);
 static char *expandTabs(const char *text, int startIndent, int tabDist,
 	char nullSubsChar, int *newLen);
 static char *unexpandTabs(const char *text, int startIndent, int tabDist,
 	char nullSubsChar, int *newLen);
-static int max(int i1, int i2);
-static int min(int i1, int i2);
+static ssize_t countNewlines(const textBuffer *buf, ssize_t startPos,
+	ssize_t endPos);
+static ssize_t countForwardNLines(const textBuffer *buf, ssize_t startPos,
+	ssize_t nLines);
+static ssize_t countBackwardNLines(const textBuffer *buf, ssize_t startPos,
+	int nLines);
+static lineIndex *getLineIndex(textBuffer *buf);
+static void freeLineIndex(textBuffer *buf);
+static void lineIndexInserted(textBuffer *buf, ssize_t pos, ssize_t nInserted);
+static void lineIndexDeleting(textBuffer *buf, ssize_t start, ssize_t end);
+static ssize_t lineIndexPosToLine(textBuffer *buf, ssize_t pos);
+static ssize_t lineIndexLineToPos(textBuffer *buf, ssize_t line);
+static ssize_t max(ssize_t i1, ssize_t i2);
+static ssize_t min(ssize_t i1, ssize_t i2);
 
 #ifdef __MVS__
 static const char *ControlCodeTable[64] = {
@@ -145,7 +197,7 @@ textBuffer *BufCreate(void)
 ** avoid unnecessary re-allocation if you know exactly how much the buffer
 ** will need to hold
 */
-textBuffer *BufCreatePreallocated(int requestedSize)
+textBuffer *BufCreatePreallocated(ssize_t requestedSize)
 {
     textBuffer *buf;
     
@@ -183,12 +235,16 @@ textBuffer *BufCreatePreallocated(int requestedSize)
     buf->endModifyCbArgs = NULL;
     buf->nullSubsChar = '\0';
 #ifdef PURIFY
-    {int i; for (i=buf->gapStart; i<buf->gapEnd; i++) buf->buf[i] = '.';}
+    {ssize_t i; for (i=buf->gapStart; i<buf->gapEnd; i++) buf->buf[i] = '.';}
 #endif
     buf->rangesetTable = NULL;
     buf->ansi_escpos = NULL;
     buf->alloc_ansi_escpos = 0;
     buf->num_ansi_escpos = 0;
+    buf->lineIdx = NULL;
+    buf->modifications = NULL;
+    buf->nModifications = 0;
+    buf->modCount = 0;
     return buf;
 }
 
@@ -208,6 +264,7 @@ void BufFree(textBuffer *buf)
     	NEditFree(buf->preDeleteProcs);
     	NEditFree(buf->preDeleteCbArgs);
     }
+    freeLineIndex(buf);
     NEditFree(buf);
 }
 
@@ -239,9 +296,9 @@ char *BufGetAll(textBuffer *buf)
 const char *BufAsString(textBuffer *buf)
 {
     char *text;
-    int bufLen = buf->length;
-    int leftLen = buf->gapStart;
-    int rightLen = bufLen - leftLen;
+    ssize_t bufLen = buf->length;
+    ssize_t leftLen = buf->gapStart;
+    ssize_t rightLen = bufLen - leftLen;
 
     /* find where best to put the gap to minimise memory movement */
     if (leftLen != 0 && rightLen != 0) {
@@ -256,6 +313,25 @@ const char *BufAsString(textBuffer *buf)
     return text;
 }
 
+/*
+** Give read-only access to the buffer text without moving the gap.
+** "before" and "after" return the text on either side of the gap as two
+** null-terminated strings (the terminator of the first is written into the
+** gap).  Returns False if the gap is empty, so the first piece can't be
+** terminated.  The strings are only valid until the buffer is modified.
+*/
+int BufGetGapSegments(textBuffer *buf, const char **before,
+	const char **after)
+{
+    if (buf->gapStart == buf->gapEnd)
+    	return False;
+    buf->buf[buf->gapStart] = '\0';
+    buf->buf[buf->gapEnd + buf->length - buf->gapStart] = '\0';
+    *before = buf->buf;
+    *after = &buf->buf[buf->gapEnd];
+    return True;
+}
+
 static int escCharLen(char *esc)
 {
     if(esc[1] != '[') return 1;
@@ -343,7 +419,7 @@ void BufReintegrateEscSeq(textBuffer *buf, EscSeqArray *escseq)
     
     size_t num_esc = escseq->num_esc;
     size_t prev_off_trans = 0;
-    for(int i=num_esc-1;i>=0;i--) {
+    for(ssize_t i=num_esc-1;i>=0;i--) {
         EscSeqStr e = escseq->esc[i];
         size_t len = i==num_esc-1 ? buf->length - e.off_orig : prev_off_trans - e.off_trans;
         char *from = text + e.off_trans;
@@ -362,35 +438,44 @@ void BufReintegrateEscSeq(textBuffer *buf, EscSeqArray *escseq)
 */
 void BufSetAll(textBuffer *buf, const char *text)
 {
-    int length, deletedLength;
-    char *deletedText;
-    length = strlen(text);
+    BufSetAllLen(buf, text, strlen(text));
+}
+
+/*
+** Like BufSetAll, but takes the length of "text" explicitly, so "text" does
+** not need to be null-terminated.
+*/
+void BufSetAllLen(textBuffer *buf, const char *text, ssize_t length)
+{
+    char *newBuf;
+    ssize_t gapStart = length/2;
 
-    callPreDeleteCBs(buf, 0, buf->length);
-    
-    /* Save information for redisplay, and get rid of the old buffer */
-    deletedText = BufGetAll(buf);
-    deletedLength = buf->length;
-    NEditFree(buf->buf);
-    
     /* Start a new buffer with a gap of PREFERRED_GAP_SIZE in the center */
-    buf->buf = (char*)NEditMalloc(length + PREFERRED_GAP_SIZE + 1);
-    buf->buf[length + PREFERRED_GAP_SIZE] = '\0';
-    buf->length = length;
-    buf->gapStart = length/2;
-    buf->gapEnd = buf->gapStart + PREFERRED_GAP_SIZE;
-    memcpy(buf->buf, text, buf->gapStart);
-    memcpy(&buf->buf[buf->gapEnd], &text[buf->gapStart], length-buf->gapStart);
-#ifdef PURIFY
-    {int i; for (i=buf->gapStart; i<buf->gapEnd; i++) buf->buf[i] = '.';}
-#endif
-    
-    /* Zero all of the existing selections */
-    updateSelections(buf, 0, deletedLength, 0);
-    
-    /* Call the saved display routine(s) to update the screen */
-    callModifyCBs(buf, 0, deletedLength, length, 0, deletedText);
-    NEditFree(deletedText);
+    newBuf = (char*)NEditMalloc(length + PREFERRED_GAP_SIZE + 1);
+    memcpy(newBuf, text, gapStart);
+    memcpy(&newBuf[gapStart + PREFERRED_GAP_SIZE], &text[gapStart],
+    	    length-gapStart);
+    replaceAll(buf, newBuf, length, gapStart);
+}
+
+/*
+** Allocate memory for "length" characters of text, with room after them for
+** the gap of a text buffer.  Once the text is written to it, BufTakeAll can
+** make it the contents of a buffer without copying it again.
+*/
+char *BufAllocText(ssize_t length)
+{
+    return (char*)NEditMalloc(length + PREFERRED_GAP_SIZE + 1);
+}
+
+/*
+** Replace the entire contents of the text buffer with the "length"
+** characters at the start of "text", which must have been allocated by
+** BufAllocText, and now belongs to the buffer.
+*/
+void BufTakeAll(textBuffer *buf, char *text, ssize_t length)
+{
+    replaceAll(buf, text, length, length);
 }
 
 /*
@@ -398,10 +483,10 @@ void BufSetAll(textBuffer *buf, const char *text)
 ** from text buffer "buf".  Positions start at 0, and the range does not
 ** include the character pointed to by "end"
 */
-char* BufGetRange(const textBuffer* buf, int start, int end)
+char* BufGetRange(const textBuffer* buf, ssize_t start, ssize_t end)
 {
     char *text;
-    int length, part1Length;
+    ssize_t length, part1Length;
     
     /* Make sure start and end are ok, and allocate memory for returned string.
        If start is bad, return "", if end is bad, adjust it. */
@@ -411,7 +496,7 @@ char* BufGetRange(const textBuffer* buf, int start, int end)
         return text;
     }
     if (end < start) {
-    	int temp = start;
+    	ssize_t temp = start;
     	start = end;
     	end = temp;
     }
@@ -444,7 +529,7 @@ char* BufGetRange(const textBuffer* buf, int start, int end)
 const char* BufGetRange2(const textBuffer* buf, ssize_t start, ssize_t end, char **free_str)
 {
     char *text;
-    int length, part1Length;
+    ssize_t length, part1Length;
     
     *free_str = NULL;
     
@@ -454,7 +539,7 @@ const char* BufGetRange2(const textBuffer* buf, ssize_t start, ssize_t end, char
     	return "";
     }
     if (end < start) {
-    	int temp = start;
+    	ssize_t temp = start;
     	start = end;
     	end = temp;
     }
@@ -483,7 +568,7 @@ const char* BufGetRange2(const textBuffer* buf, ssize_t start, ssize_t end, char
 /*
 ** Return the character at buffer position "pos".  Positions start at 0.
 */
-char BufGetCharacter(const textBuffer* buf, int pos)
+char BufGetCharacter(const textBuffer* buf, ssize_t pos)
 {
     if (pos < 0 || pos >= buf->length)
         return '\0';
@@ -493,7 +578,7 @@ char BufGetCharacter(const textBuffer* buf, int pos)
     	return buf->buf[pos + buf->gapEnd-buf->gapStart];
 }
 
-static int BufGetCharacterBytes(const textBuffer *buf, int pos, char *buffer)
+static int BufGetCharacterBytes(const textBuffer *buf, ssize_t pos, char *buffer)
 {
     char c = BufGetCharacter(buf, pos);
     int len = Utf8CharLen((unsigned char*)&c);
@@ -513,7 +598,7 @@ static int BufGetCharacterBytes(const textBuffer *buf, int pos, char *buffer)
     return len;
 }
 
-wchar_t BufGetCharacterW(const textBuffer *buf, int pos)
+wchar_t BufGetCharacterW(const textBuffer *buf, ssize_t pos)
 {
     char utf8[4];
     int len = BufGetCharacterBytes(buf, pos, utf8);
@@ -529,7 +614,7 @@ wchar_t BufGetCharacterW(const textBuffer *buf, int pos)
 /*
  * Return the UCS-4 character at buffer position "pos". Positions start at 0.
  */
-FcChar32 BufGetCharacter32(const textBuffer* buf, int pos, int *charlen)
+FcChar32 BufGetCharacter32(const textBuffer* buf, ssize_t pos, int *charlen)
 {
     FcChar32 result = 0;
     char c = BufGetCharacter(buf, pos);
@@ -566,9 +651,9 @@ void BufEndModifyBatch(textBuffer *buf) {
 /*
 ** Insert null-terminated string "text" at position "pos" in "buf"
 */
-void BufInsert(textBuffer *buf, int pos, const char *text)
+void BufInsert(textBuffer *buf, ssize_t pos, const char *text)
 {
-    int nInserted;
+    ssize_t nInserted;
     
     /* if pos is not contiguous to existing text, make it */
     if (pos > buf->length) pos = buf->length;
@@ -587,10 +672,10 @@ void BufInsert(textBuffer *buf, int pos, const char *text)
 ** Delete the characters between "start" and "end", and insert the
 ** null-terminated string "text" in their place in in "buf"
 */
-void BufReplace(textBuffer *buf, int start, int end, const char *text)
+void BufReplace(textBuffer *buf, ssize_t start, ssize_t end, const char *text)
 {
     char *deletedText;
-    int nInserted = strlen(text);
+    ssize_t nInserted = strlen(text);
     
     callPreDeleteCBs(buf, start, end-start);
     deletedText = BufGetRange(buf, start, end);
@@ -601,13 +686,13 @@ void BufReplace(textBuffer *buf, int start, int end, const char *text)
     NEditFree(deletedText);
 }
 
-void BufRemove(textBuffer *buf, int start, int end)
+void BufRemove(textBuffer *buf, ssize_t start, ssize_t end)
 {
     char *deletedText;
     
     /* Make sure the arguments make sense */
     if (start > end) {
-    	int temp = start;
+    	ssize_t temp = start;
 	start = end;
 	end = temp;
     }
@@ -625,11 +710,126 @@ void BufRemove(textBuffer *buf, int start, int end)
     NEditFree(deletedText);
 }
 
-void BufCopyFromBuf(textBuffer *fromBuf, textBuffer *toBuf, int fromStart,
-    	int fromEnd, int toPos)
+/*
+** Make "nEdits" edits to "buf" at once, each replacing "nDeleted" characters
+** at "pos" with the null-terminated string "text".  The edits must be in
+** order of position, with positions in the text as it was before any of
+** them.  (Parts of edits which overlap earlier ones are ignored.)  Making
+** many edits this way is much faster than making them one at a time: the
+** text moves through the buffer only once, and the modify callbacks are
+** called only once, for the whole range from the start of the first edit
+** to the end of the last.  Callbacks which need the individual edits, for
+** example to record them for undo, can get them with BufGetModifications.
+*/
+void BufApplyEdits(textBuffer *buf, const bufEdit *edits, int nEdits)
 {
-    int length = fromEnd - fromStart;
-    int part1Length;
+    bufModification *mods;
+    selection primary, secondary, highlight;
+    const char **texts;
+    char *deletedText, *newText, *modText, *outPtr, *modPtr;
+    ssize_t start, end, pos, editEnd, prevEnd, shift;
+    int i, nMods;
+
+    if (nEdits <= 0)
+    	return;
+    
+    /* Clamp the edits to the buffer and to each other, and drop the ones
+       which would change nothing */
+    mods = (bufModification *)NEditMalloc(sizeof(bufModification) * nEdits);
+    texts = (const char **)NEditMalloc(sizeof(const char *) * nEdits);
+    for (i=0, nMods=0, prevEnd=0, shift=0; i<nEdits; i++) {
+    	pos = max(edits[i].pos, prevEnd);
+	if (pos > buf->length)
+	    pos = buf->length;
+	editEnd = pos + max(edits[i].nDeleted, 0);
+	if (editEnd > buf->length)
+	    editEnd = buf->length;
+	mods[nMods].pos = pos;
+	mods[nMods].nDeleted = editEnd - pos;
+	mods[nMods].nInserted = strlen(edits[i].text);
+	if (mods[nMods].nDeleted == 0 && mods[nMods].nInserted == 0)
+	    continue;
+	texts[nMods++] = edits[i].text;
+	prevEnd = editEnd;
+    }
+    if (nMods == 0) {
+    	NEditFree(mods);
+	NEditFree(texts);
+	return;
+    }
+    start = mods[0].pos;
+    end = mods[nMods-1].pos + mods[nMods-1].nDeleted;
+    for (i=0, shift=0; i<nMods; i++)
+    	shift += mods[i].nInserted - mods[i].nDeleted;
+    
+    /* Put together the new text for the range, and null-terminated copies
+       of the text deleted by each edit.  From here on, the positions in
+       mods are as if the edits had been made one at a time */
+    deletedText = BufGetRange(buf, start, end);
+    newText = (char *)NEditMalloc(end - start + shift + 1);
+    modText = (char *)NEditMalloc(end - start + nMods);
+    outPtr = newText;
+    modPtr = modText;
+    for (i=0, prevEnd=start, shift=0; i<nMods; i++) {
+    	memcpy(outPtr, deletedText + (prevEnd - start), mods[i].pos - prevEnd);
+	outPtr += mods[i].pos - prevEnd;
+	memcpy(outPtr, texts[i], mods[i].nInserted);
+	outPtr += mods[i].nInserted;
+	memcpy(modPtr, deletedText + (mods[i].pos - start), mods[i].nDeleted);
+	modPtr[mods[i].nDeleted] = '\0';
+	mods[i].deletedText = modPtr;
+	modPtr += mods[i].nDeleted + 1;
+	prevEnd = mods[i].pos + mods[i].nDeleted;
+	mods[i].pos += shift;
+	shift += mods[i].nInserted - mods[i].nDeleted;
+    }
+    *outPtr = '\0';
+    
+    /* Replace the range in one step, but update the selections for each
+       edit, the way delete and insert would have for the edits made one
+       at a time */
+    callPreDeleteCBs(buf, start, end - start);
+    primary = buf->primary;
+    secondary = buf->secondary;
+    highlight = buf->highlight;
+    delete(buf, start, end);
+    insert(buf, start, newText);
+    buf->primary = primary;
+    buf->secondary = secondary;
+    buf->highlight = highlight;
+    for (i=0; i<nMods; i++) {
+    	updateSelections(buf, mods[i].pos, mods[i].nDeleted, 0);
+    	updateSelections(buf, mods[i].pos, 0, mods[i].nInserted);
+    }
+    buf->cursorPosHint = mods[nMods-1].pos + mods[nMods-1].nInserted;
+    
+    callModifyCBsForEdits(buf, start, end - start, outPtr - newText, 0,
+    	    deletedText, mods, nMods);
+    NEditFree(deletedText);
+    NEditFree(newText);
+    NEditFree(modText);
+    NEditFree(texts);
+    NEditFree(mods);
+}
+
+/*
+** While the modify callbacks of "buf" are being called for a modification
+** made by BufApplyEdits, get the edits it was made of, in order, with the
+** positions and deleted text they would have had if made one at a time.
+** Returns the number of edits, or 0 if the modification being reported was
+** made any other way.
+*/
+int BufGetModifications(const textBuffer *buf, const bufModification **mods)
+{
+    *mods = buf->modifications;
+    return buf->nModifications;
+}
+
+void BufCopyFromBuf(textBuffer *fromBuf, textBuffer *toBuf, ssize_t fromStart,
+    	ssize_t fromEnd, ssize_t toPos)
+{
+    ssize_t length = fromEnd - fromStart;
+    ssize_t part1Length;
 
     /* Prepare the buffer to receive the new text.  If the new text fits in
        the current buffer, just move the gap (if necessary) to where
@@ -656,6 +856,7 @@ void BufCopyFromBuf(textBuffer *fromBuf, textBuffer *toBuf, int fromStart,
     }
     toBuf->gapStart += length;
     toBuf->length += length;
+    lineIndexInserted(toBuf, toPos, length);
     updateSelections(toBuf, toPos, 0, length);
 } 
 
@@ -667,10 +868,11 @@ void BufCopyFromBuf(textBuffer *fromBuf, textBuffer *toBuf, int fromStart,
 ** number of characters inserted and deleted in the operation (beginning
 ** at startPos) are returned in these arguments
 */
-void BufInsertCol(textBuffer *buf, int column, int startPos, const char *text,
-    	int *charsInserted, int *charsDeleted)
+void BufInsertCol(textBuffer *buf, int column, ssize_t startPos,
+	const char *text, ssize_t *charsInserted, ssize_t *charsDeleted)
 {
-    int nLines, lineStartPos, nDeleted, insertDeleted, nInserted;
+    int nLines;
+    ssize_t lineStartPos, nDeleted, insertDeleted, nInserted;
     char *deletedText;
     
     nLines = countLines(text);
@@ -698,10 +900,12 @@ void BufInsertCol(textBuffer *buf, int column, int startPos, const char *text,
 ** in the operation (beginning at startPos) are returned in these arguments.
 ** If rectEnd equals -1, the width of the inserted text is measured first.
 */
-void BufOverlayRect(textBuffer *buf, int startPos, int rectStart,
-    	int rectEnd, const char *text, int *charsInserted, int *charsDeleted)
+void BufOverlayRect(textBuffer *buf, ssize_t startPos, int rectStart,
+    	int rectEnd, const char *text, ssize_t *charsInserted,
+	ssize_t *charsDeleted)
 {
-    int nLines, lineStartPos, nDeleted, insertDeleted, nInserted;
+    int nLines;
+    ssize_t lineStartPos, nDeleted, insertDeleted, nInserted;
     char *deletedText;
     
     nLines = countLines(text);
@@ -730,13 +934,14 @@ void BufOverlayRect(textBuffer *buf, int startPos, int rectStart,
 ** and "rectEnd", with "text".  If "text" is vertically longer than the
 ** rectangle, add extra lines to make room for it.
 */
-void BufReplaceRect(textBuffer *buf, int start, int end, int rectStart,
+void BufReplaceRect(textBuffer *buf, ssize_t start, ssize_t end, int rectStart,
 	int rectEnd, const char *text)
 {
     char *deletedText;
     char *insText=NULL;
-    int i, nInsertedLines, nDeletedLines, insLen, hint;
-    int insertDeleted, insertInserted, deleteInserted;
+    int i, nInsertedLines, nDeletedLines;
+    ssize_t insLen, hint;
+    ssize_t insertDeleted, insertInserted, deleteInserted;
     int linesPadded = 0;
     
     /* Make sure start and end refer to complete lines, since the
@@ -796,11 +1001,11 @@ void BufReplaceRect(textBuffer *buf, int start, int end, int rectStart,
 ** Remove a rectangular swath of characters between character positions start
 ** and end and horizontal displayed-character offsets rectStart and rectEnd.
 */
-void BufRemoveRect(textBuffer *buf, int start, int end, int rectStart,
+void BufRemoveRect(textBuffer *buf, ssize_t start, ssize_t end, int rectStart,
 	int rectEnd)
 {
     char *deletedText;
-    int nInserted;
+    ssize_t nInserted;
     
     start = BufStartOfLine(buf, start);
     end = BufEndOfLine(buf, end);
@@ -817,7 +1022,7 @@ void BufRemoveRect(textBuffer *buf, int start, int end, int rectStart,
 ** start and end and horizontal displayed-character offsets rectStart and
 ** rectEnd.
 */
-void BufClearRect(textBuffer *buf, int start, int end, int rectStart,
+void BufClearRect(textBuffer *buf, ssize_t start, ssize_t end, int rectStart,
 	int rectEnd)
 {
     int i, nLines;
@@ -833,10 +1038,11 @@ void BufClearRect(textBuffer *buf, int start, int end, int rectStart,
     NEditFree(newlineString);
 }
 
-char *BufGetTextInRect(textBuffer *buf, int start, int end,
+char *BufGetTextInRect(textBuffer *buf, ssize_t start, ssize_t end,
 	int rectStart, int rectEnd)
 {
-    int lineStart, selLeft, selRight, len;
+    ssize_t lineStart, selLeft, selRight;
+    int len;
     char *textOut, *textIn, *outPtr, *retabbedStr;
    
     start = BufStartOfLine(buf, start);
@@ -896,13 +1102,13 @@ void BufSetTabDistance(textBuffer *buf, int tabDist)
     callModifyCBs(buf, 0, buf->length, buf->length, 0, deletedText);
 }
 
-void BufCheckDisplay(textBuffer *buf, int start, int end)
+void BufCheckDisplay(textBuffer *buf, ssize_t start, ssize_t end)
 {
     /* just to make sure colors in the selected region are up to date */
     callModifyCBs(buf, start, 0, 0, end-start, NULL);
 }
 
-void BufSelect(textBuffer *buf, int start, int end)
+void BufSelect(textBuffer *buf, ssize_t start, ssize_t end)
 {
     selection oldSelection = buf->primary;
 
@@ -919,7 +1125,7 @@ void BufUnselect(textBuffer *buf)
     redisplaySelection(buf, &oldSelection, &buf->primary);
 }
 
-void BufRectSelect(textBuffer *buf, int start, int end, int rectStart,
+void BufRectSelect(textBuffer *buf, ssize_t start, ssize_t end, int rectStart,
         int rectEnd)
 {
     selection oldSelection = buf->primary;
@@ -928,7 +1134,7 @@ void BufRectSelect(textBuffer *buf, int start, int end, int rectStart,
     redisplaySelection(buf, &oldSelection, &buf->primary);
 }
 
-int BufGetSelectionPos(textBuffer *buf, int *start, int *end,
+int BufGetSelectionPos(textBuffer *buf, ssize_t *start, ssize_t *end,
         int *isRect, int *rectStart, int *rectEnd)
 {
     return getSelectionPos(&buf->primary, start, end, isRect, rectStart,
@@ -936,7 +1142,7 @@ int BufGetSelectionPos(textBuffer *buf, int *start, int *end,
 }
 
 /* Same as above, but also returns TRUE for empty selections */
-int BufGetEmptySelectionPos(textBuffer *buf, int *start, int *end,
+int BufGetEmptySelectionPos(textBuffer *buf, ssize_t *start, ssize_t *end,
         int *isRect, int *rectStart, int *rectEnd)
 {
     return getSelectionPos(&buf->primary, start, end, isRect, rectStart,
@@ -958,7 +1164,7 @@ void BufReplaceSelected(textBuffer *buf, const char *text)
     replaceSelected(buf, &buf->primary, text);
 }
 
-void BufSecondarySelect(textBuffer *buf, int start, int end)
+void BufSecondarySelect(textBuffer *buf, ssize_t start, ssize_t end)
 {
     selection oldSelection = buf->secondary;
 
@@ -975,7 +1181,7 @@ void BufSecondaryUnselect(textBuffer *buf)
     redisplaySelection(buf, &oldSelection, &buf->secondary);
 }
 
-void BufSecRectSelect(textBuffer *buf, int start, int end,
+void BufSecRectSelect(textBuffer *buf, ssize_t start, ssize_t end,
         int rectStart, int rectEnd)
 {
     selection oldSelection = buf->secondary;
@@ -984,7 +1190,7 @@ void BufSecRectSelect(textBuffer *buf, int start, int end,
     redisplaySelection(buf, &oldSelection, &buf->secondary);
 }
 
-int BufGetSecSelectPos(textBuffer *buf, int *start, int *end,
+int BufGetSecSelectPos(textBuffer *buf, ssize_t *start, ssize_t *end,
         int *isRect, int *rectStart, int *rectEnd)
 {
     return getSelectionPos(&buf->secondary, start, end, isRect, rectStart,
@@ -1006,7 +1212,7 @@ void BufReplaceSecSelect(textBuffer *buf, const char *text)
     replaceSelected(buf, &buf->secondary, text);
 }
 
-void BufHighlight(textBuffer *buf, int start, int end)
+void BufHighlight(textBuffer *buf, ssize_t start, ssize_t end)
 {
     selection oldSelection = buf->highlight;
 
@@ -1023,7 +1229,7 @@ void BufUnhighlight(textBuffer *buf)
     redisplaySelection(buf, &oldSelection, &buf->highlight);
 }
 
-void BufRectHighlight(textBuffer *buf, int start, int end,
+void BufRectHighlight(textBuffer *buf, ssize_t start, ssize_t end,
         int rectStart, int rectEnd)
 {
     selection oldSelection = buf->highlight;
@@ -1032,7 +1238,7 @@ void BufRectHighlight(textBuffer *buf, int start, int end,
     redisplaySelection(buf, &oldSelection, &buf->highlight);
 }
 
-int BufGetHighlightPos(textBuffer *buf, int *start, int *end,
+int BufGetHighlightPos(textBuffer *buf, ssize_t *start, ssize_t *end,
         int *isRect, int *rectStart, int *rectEnd)
 {
     return getSelectionPos(&buf->highlight, start, end, isRect, rectStart,
@@ -1376,9 +1582,9 @@ void BufRemoveEndModifyCB(textBuffer *buf, bufEndModifyCallbackProc
 /*
 ** Find the position of the start of the line containing position "pos"
 */
-int BufStartOfLine(textBuffer *buf, int pos)
+ssize_t BufStartOfLine(textBuffer *buf, ssize_t pos)
 {
-    int startPos;
+    ssize_t startPos;
     
     if (!searchBackward(buf, pos, '\n', &startPos))
     	return 0;
@@ -1391,9 +1597,9 @@ int BufStartOfLine(textBuffer *buf, int pos)
 ** (which is either a pointer to the newline character ending the line,
 ** or a pointer to one character beyond the end of the buffer)
 */
-int BufEndOfLine(textBuffer *buf, int pos)
+ssize_t BufEndOfLine(textBuffer *buf, ssize_t pos)
 {
-    int endPos;
+    ssize_t endPos;
     
     if (!searchForward(buf, pos, '\n', &endPos))
     	endPos = buf->length;
@@ -1408,7 +1614,7 @@ int BufEndOfLine(textBuffer *buf, int pos)
 ** for figuring tabs.  Output string is guranteed to be shorter or
 ** equal in length to MAX_EXP_CHAR_LEN
 */
-int BufGetExpandedChar(const textBuffer* buf, int pos, int indent,
+int BufGetExpandedChar(const textBuffer* buf, ssize_t pos, int indent,
         char* outStr)
 {
     char utf8[4];
@@ -1574,10 +1780,11 @@ int BufCharWidth(char c, int indent, int tabDist, char nullSubsChar)
 ** shown on the screen to represent characters in the buffer, where tabs and
 ** control characters are expanded)
 */
-int BufCountDispChars(const textBuffer* buf, int lineStartPos,
-        int targetPos)
+int BufCountDispChars(const textBuffer* buf, ssize_t lineStartPos,
+        ssize_t targetPos)
 {
-    int pos, len, ulen, charCount = 0;
+    ssize_t pos;
+    int len, ulen, charCount = 0;
     char expandedChar[MAX_EXP_CHAR_LEN];
     
     pos = lineStartPos;
@@ -1600,9 +1807,11 @@ int BufCountDispChars(const textBuffer* buf, int lineStartPos,
 ** (displayed characters are the characters shown on the screen to represent
 ** characters in the buffer, where tabs and control characters are expanded)
 */
-int BufCountForwardDispChars(textBuffer *buf, int lineStartPos, int nChars)
+ssize_t BufCountForwardDispChars(textBuffer *buf, ssize_t lineStartPos,
+	int nChars)
 {
-    int pos, len, charCount = 0;
+    ssize_t pos;
+    int len, charCount = 0;
     char c;
     
     pos = lineStartPos;
@@ -1621,56 +1830,35 @@ int BufCountForwardDispChars(textBuffer *buf, int lineStartPos, int nChars)
 ** Count the number of newlines between startPos and endPos in buffer "buf".
 ** The character at position "endPos" is not counted.
 */
-int BufCountLines(textBuffer *buf, int startPos, int endPos)
+int BufCountLines(textBuffer *buf, ssize_t startPos, ssize_t endPos)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
-    int lineCount = 0;
+    /* an end before the start, or past the end of the buffer, counts to
+       the end of the buffer */
+    if (endPos < startPos || endPos > buf->length)
+    	endPos = buf->length;
     
-    pos = startPos;
-    while (pos < buf->gapStart) {
-        if (pos == endPos)
-            return lineCount;
-        if (buf->buf[pos++] == '\n')
-            lineCount++;
-    }
-    while (pos < buf->length) {
-        if (pos == endPos)
-            return lineCount;
-    	if (buf->buf[pos++ + gapLen] == '\n')
-            lineCount++;
-    }
-    return lineCount;
+    if (endPos - startPos < LINE_INDEX_MIN_SPAN)
+    	return countNewlines(buf, startPos, endPos);
+    return lineIndexPosToLine(buf, endPos) - lineIndexPosToLine(buf, startPos);
 }
 
 /*
 ** Find the first character of the line "nLines" forward from "startPos"
 ** in "buf" and return its position
 */
-int BufCountForwardNLines(const textBuffer* buf, int startPos,
+ssize_t BufCountForwardNLines(const textBuffer* buf, ssize_t startPos,
         unsigned nLines)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
-    int lineCount = 0;
+    textBuffer *idxBuf;
     
-    if (nLines == 0)
-    	return startPos;
+    if (nLines < LINE_INDEX_MIN_LINES ||
+    	    buf->length - startPos < LINE_INDEX_MIN_SPAN)
+    	return countForwardNLines(buf, startPos, nLines);
     
-    pos = startPos;
-    while (pos < buf->gapStart) {
-        if (buf->buf[pos++] == '\n') {
-            lineCount++;
-            if (lineCount == nLines)
-            	return pos;
-        }
-    }
-    while (pos < buf->length) {
-    	if (buf->buf[pos++ + gapLen] == '\n') {
-            lineCount++;
-            if (lineCount >= nLines)
-            	return pos;
-        }
-    }
-    return pos;
+    /* the line index is built on demand, so we cast away constness */
+    idxBuf = (textBuffer *)buf;
+    return lineIndexLineToPos(idxBuf,
+    	    lineIndexPosToLine(idxBuf, startPos) + nLines);
 }
 
 /*
@@ -1679,30 +1867,68 @@ int BufCountForwardNLines(const textBuffer* buf, int startPos,
 ** that is a newline) in "buf".  nLines == 0 means find the beginning of
 ** the line
 */
-int BufCountBackwardNLines(textBuffer *buf, int startPos, int nLines)
+ssize_t BufCountBackwardNLines(textBuffer *buf, ssize_t startPos, int nLines)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
-    int lineCount = -1;
+    ssize_t line;
     
-    pos = startPos - 1;
-    if (pos <= 0)
-    	return 0;
+    if (nLines < LINE_INDEX_MIN_LINES || startPos < LINE_INDEX_MIN_SPAN)
+    	return countBackwardNLines(buf, startPos, nLines);
     
-    while (pos >= buf->gapStart) {
-    	if (buf->buf[pos + gapLen] == '\n') {
-            if (++lineCount >= nLines)
-            	return pos + 1;
-        }
-        pos--;
+    line = lineIndexPosToLine(buf, startPos) - nLines;
+    return line > 0 ? lineIndexLineToPos(buf, line) : 0;
+}
+
+/*
+** Scanning version of BufCountForwardNLines, for short distances
+*/
+static ssize_t countForwardNLines(const textBuffer *buf, ssize_t startPos,
+	ssize_t nLines)
+{
+    ssize_t pos = startPos, gapLen = buf->gapEnd - buf->gapStart;
+    size_t n = nLines;
+    const char *found;
+    
+    if (nLines <= 0)
+    	return startPos;
+    
+    if (pos < buf->gapStart) {
+    	found = ScanFindNthNewline(&buf->buf[pos], buf->gapStart - pos, &n);
+	if (found != NULL)
+	    return found - buf->buf + 1;
+	pos = buf->gapStart;
     }
-    while (pos >= 0) {
-        if (buf->buf[pos] == '\n') {
-            if (++lineCount >= nLines)
-            	return pos + 1;
-        }
-        pos--;
+    if (pos < buf->length) {
+    	found = ScanFindNthNewline(&buf->buf[pos + gapLen], buf->length - pos,
+	    	&n);
+	if (found != NULL)
+	    return found - buf->buf - gapLen + 1;
     }
-    return 0;
+    return max(startPos, buf->length);
+}
+
+/*
+** Scanning version of BufCountBackwardNLines, for short distances
+*/
+static ssize_t countBackwardNLines(const textBuffer *buf, ssize_t startPos,
+	int nLines)
+{
+    ssize_t end = startPos, gapLen = buf->gapEnd - buf->gapStart;
+    size_t n = nLines < 0 ? 1 : (size_t)nLines + 1;
+    const char *found;
+    
+    if (startPos - 1 <= 0)
+    	return 0;
+    
+    /* find the newline ending the line before the one wanted */
+    if (end > buf->gapStart) {
+    	found = ScanFindNthNewlineBackward(&buf->buf[buf->gapEnd],
+	    	end - buf->gapStart, &n);
+	if (found != NULL)
+	    return found - buf->buf - gapLen + 1;
+	end = buf->gapStart;
+    }
+    found = ScanFindNthNewlineBackward(buf->buf, end, &n);
+    return found != NULL ? found - buf->buf + 1 : 0;
 }
 
 /*
@@ -1710,33 +1936,13 @@ int BufCountBackwardNLines(textBuffer *buf, int startPos, int nLines)
 ** with the character "startPos", and returning the result in "foundPos"
 ** returns True if found, False if not.
 */
-int BufSearchForward(textBuffer *buf, int startPos, const char *searchChars,
-	int *foundPos)
+int BufSearchForward(textBuffer *buf, ssize_t startPos, const char *searchChars,
+	ssize_t *foundPos)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
-    const char *c;
+    scanCharSet set;
     
-    pos = startPos;
-    while (pos < buf->gapStart) {
-        for (c=searchChars; *c!='\0'; c++) {
-	    if (buf->buf[pos] == *c) {
-        	*foundPos = pos;
-        	return True;
-            }
-        }
-        pos++;
-    }
-    while (pos < buf->length) {
-    	for (c=searchChars; *c!='\0'; c++) {
-    	    if (buf->buf[pos + gapLen] == *c) {
-        	*foundPos = pos;
-        	return True;
-            }
-        }
-        pos++;
-    }
-    *foundPos = buf->length;
-    return False;
+    ScanInitCharSet(&set, searchChars);
+    return findCharSet(buf, startPos, &set, foundPos);
 }
 
 /*
@@ -1744,37 +1950,13 @@ int BufSearchForward(textBuffer *buf, int startPos, const char *searchChars,
 ** with the character BEFORE "startPos", returning the result in "foundPos"
 ** returns True if found, False if not.
 */
-int BufSearchBackward(textBuffer *buf, int startPos, const char *searchChars,
-	int *foundPos)
+int BufSearchBackward(textBuffer *buf, ssize_t startPos, const char *searchChars,
+	ssize_t *foundPos)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
-    const char *c;
+    scanCharSet set;
     
-    if (startPos == 0) {
-    	*foundPos = 0;
-    	return False;
-    }
-    pos = startPos == 0 ? 0 : startPos - 1;
-    while (pos >= buf->gapStart) {
-    	for (c=searchChars; *c!='\0'; c++) {
-    	    if (buf->buf[pos + gapLen] == *c) {
-        	*foundPos = pos;
-        	return True;
-            }
-        }
-        pos--;
-    }
-    while (pos >= 0) {
-    	for (c=searchChars; *c!='\0'; c++) {
-            if (buf->buf[pos] == *c) {
-        	*foundPos = pos;
-        	return True;
-            }
-        }
-        pos--;
-    }
-    *foundPos = 0;
-    return False;
+    ScanInitCharSet(&set, searchChars);
+    return findCharSetBackward(buf, startPos, &set, foundPos);
 }
 
 /*
@@ -1797,7 +1979,7 @@ int BufSearchBackward(textBuffer *buf, int startPos, const char *searchChars,
 ** substitution.  Returns False, if substitution is no longer possible
 ** because all non-printable characters are already in use.
 */
-int BufSubstituteNullChars(char *string, int length, textBuffer *buf)
+int BufSubstituteNullChars(char *string, ssize_t length, textBuffer *buf)
 {
     char histogram[256];
 
@@ -1853,10 +2035,10 @@ void BufUnsubstituteNullChars(char *string, textBuffer *buf)
 ** != 0 otherwise.
 **
 */
-int BufCmp(textBuffer * buf, int pos, int len, const char *cmpText)
+int BufCmp(textBuffer * buf, ssize_t pos, ssize_t len, const char *cmpText)
 {
-    int     posEnd;
-    int     part1Length;
+    ssize_t posEnd;
+    ssize_t part1Length;
     int     result;
 
     posEnd = pos + len;
@@ -1889,7 +2071,7 @@ int BufCmp(textBuffer * buf, int pos, int len, const char *cmpText)
 ** with a 1).  If init is true, initialize the histogram before acumulating.
 ** if not, add the new data to an existing histogram.
 */
-static void histogramCharacters(const char *string, int length, char hist[256],
+static void histogramCharacters(const char *string, ssize_t length, char hist[256],
 	int init)
 {
     int i;
@@ -1905,7 +2087,7 @@ static void histogramCharacters(const char *string, int length, char hist[256],
 /*
 ** Substitute fromChar with toChar in string.
 */
-static void subsChars(char *string, int length, char fromChar, char toChar)
+static void subsChars(char *string, ssize_t length, char fromChar, char toChar)
 {
     char *c;
     
@@ -1938,17 +2120,18 @@ static char chooseNullSubsChar(char hist[256])
 ** on to call redisplay).  pos must be contiguous with the existing text in
 ** the buffer (i.e. not past the end).
 */
-static int insert(textBuffer *buf, int pos, const char *text)
+static ssize_t insert(textBuffer *buf, ssize_t pos, const char *text)
 {
-    int length = strlen(text);
+    ssize_t length = strlen(text);
 
     /* Prepare the buffer to receive the new text.  If the new text fits in
        the current buffer, just move the gap (if necessary) to where
        the text should be inserted.  If the new text is too large, reallocate
        the buffer with a gap large enough to accomodate the new text and a
-       gap of PREFERRED_GAP_SIZE */
+       gap of PREFERRED_GAP_SIZE, or more in large buffers */
     if (length > buf->gapEnd - buf->gapStart)
-    	reallocateBuf(buf, pos, length + PREFERRED_GAP_SIZE);
+    	reallocateBuf(buf, pos, length + max(PREFERRED_GAP_SIZE,
+		buf->length / GAP_GROWTH_DIVISOR));
     else if (pos != buf->gapStart)
 	moveGap(buf, pos);
     
@@ -1956,6 +2139,7 @@ static int insert(textBuffer *buf, int pos, const char *text)
     memcpy(&buf->buf[pos], text, length);
     buf->gapStart += length;
     buf->length += length;
+    lineIndexInserted(buf, pos, length);
     updateSelections(buf, pos, 0, length);
     
     return length;
@@ -1966,8 +2150,11 @@ static int insert(textBuffer *buf, int pos, const char *text)
 ** of the buffer between start and end (and moves the gap to the site of
 ** the delete).
 */
-static void delete(textBuffer *buf, int start, int end)
+static void delete(textBuffer *buf, ssize_t start, ssize_t end)
 {
+    /* the line index needs to see the text before it goes */
+    lineIndexDeleting(buf, start, end);
+
     /* if the gap is not contiguous to the area to remove, move it there */
     if (start > buf->gapStart)
     	moveGap(buf, start);
@@ -1994,10 +2181,12 @@ static void delete(textBuffer *buf, int start, int end)
 ** position of the lower left edge of the inserted column (as a hint for
 ** routines which need to set a cursor position).
 */
-static void insertCol(textBuffer *buf, int column, int startPos,
-        const char *insText, int *nDeleted, int *nInserted, int *endPos)
+static void insertCol(textBuffer *buf, int column, ssize_t startPos,
+        const char *insText, ssize_t *nDeleted, ssize_t *nInserted,
+	ssize_t *endPos)
 {
-    int nLines, start, end, insWidth, lineStart, lineEnd;
+    int nLines, insWidth;
+    ssize_t start, end, lineStart, lineEnd;
     int expReplLen, expInsLen, len, endOffset;
     char *outStr, *outPtr, *line, *replText, *expText, *insLine;
     const char *insPtr;
@@ -2082,10 +2271,11 @@ static void insertCol(textBuffer *buf, int column, int startPos,
 ** of the point in the last line where the text was removed (as a hint for
 ** routines which need to position the cursor after a delete operation)
 */
-static void deleteRect(textBuffer *buf, int start, int end, int rectStart,
-	int rectEnd, int *replaceLen, int *endPos)
+static void deleteRect(textBuffer *buf, ssize_t start, ssize_t end, int rectStart,
+	int rectEnd, ssize_t *replaceLen, ssize_t *endPos)
 {
-    int nLines, lineStart, lineEnd, len, endOffset;
+    int nLines, len, endOffset;
+    ssize_t lineStart, lineEnd;
     char *outStr, *outPtr, *line, *text, *expText;
     
     /* allocate a buffer for the replacement string large enough to hold 
@@ -2134,11 +2324,12 @@ static void deleteRect(textBuffer *buf, int start, int end, int rectStart,
 ** "endPos" returns buffer position of the lower left edge of the inserted
 ** column (as a hint for routines which need to set a cursor position).
 */
-static void overlayRect(textBuffer *buf, int startPos, int rectStart,
+static void overlayRect(textBuffer *buf, ssize_t startPos, int rectStart,
     	int rectEnd, const char *insText,
-	int *nDeleted, int *nInserted, int *endPos)
+	ssize_t *nDeleted, ssize_t *nInserted, ssize_t *endPos)
 {
-    int nLines, start, end, lineStart, lineEnd;
+    int nLines;
+    ssize_t start, end, lineStart, lineEnd;
     int expInsLen, len, endOffset;
     char *c, *outStr, *outPtr, *line, *expText, *insLine;
     const char *insPtr;
@@ -2465,7 +2656,7 @@ static void overlayRectInLine(const char *line, const char *insLine,
     *outLen = (outPtr - outStr) + strlen(linePtr);
 }
 
-static void setSelection(selection *sel, int start, int end)
+static void setSelection(selection *sel, ssize_t start, ssize_t end)
 {
     sel->selected = start != end;
     sel->zeroWidth = (start == end) ? 1 : 0;
@@ -2474,7 +2665,7 @@ static void setSelection(selection *sel, int start, int end)
     sel->end = max(start, end);
 }
 
-static void setRectSelect(selection *sel, int start, int end,
+static void setRectSelect(selection *sel, ssize_t start, ssize_t end,
 	int rectStart, int rectEnd)
 {
     sel->selected = rectStart < rectEnd;
@@ -2486,7 +2677,7 @@ static void setRectSelect(selection *sel, int start, int end,
     sel->rectEnd = rectEnd;
 }
 
-static int getSelectionPos(selection *sel, int *start, int *end,
+static int getSelectionPos(selection *sel, ssize_t *start, ssize_t *end,
         int *isRect, int *rectStart, int *rectEnd)
 {
     /* Always fill in the parameters (zero-width can be requested too). */
@@ -2502,7 +2693,8 @@ static int getSelectionPos(selection *sel, int *start, int *end,
 
 static char *getSelectionText(textBuffer *buf, selection *sel)
 {
-    int start, end, isRect, rectStart, rectEnd;
+    ssize_t start, end;
+    int isRect, rectStart, rectEnd;
     char *text;
     
     /* If there's no selection, return an allocated empty string */
@@ -2521,7 +2713,7 @@ static char *getSelectionText(textBuffer *buf, selection *sel)
 
 static void removeSelected(textBuffer *buf, selection *sel)
 {
-    int start, end;
+    ssize_t start, end;
     int isRect, rectStart, rectEnd;
     
     if (!getSelectionPos(sel, &start, &end, &isRect, &rectStart, &rectEnd))
@@ -2534,7 +2726,8 @@ static void removeSelected(textBuffer *buf, selection *sel)
 
 static void replaceSelected(textBuffer *buf, selection *sel, const char *text)
 {
-    int start, end, isRect, rectStart, rectEnd;
+    ssize_t start, end;
+    int isRect, rectStart, rectEnd;
     selection oldSelection = *sel;
     
     /* If there's no selection, return */
@@ -2585,22 +2778,43 @@ static void addPadding(char *string, int startIndent, int toIndent,
 ** Call the stored modify callback procedure(s) for this buffer to update the
 ** changed area(s) on the screen and any other listeners.
 */
-static void callModifyCBs(textBuffer *buf, int pos, int nDeleted,
-	int nInserted, int nRestyled, const char *deletedText)
+static void callModifyCBs(textBuffer *buf, ssize_t pos, ssize_t nDeleted,
+	ssize_t nInserted, ssize_t nRestyled, const char *deletedText)
 {
-    int i;
+    callModifyCBsForEdits(buf, pos, nDeleted, nInserted, nRestyled,
+    	    deletedText, NULL, 0);
+}
+
+/*
+** Call the modify callbacks for a modification made up of the "nMods" edits
+** in "mods" (see BufApplyEdits), making them available to BufGetModifications
+** for the duration.  Modifications made by the callbacks themselves are
+** reported with the edits of this one hidden.
+*/
+static void callModifyCBsForEdits(textBuffer *buf, ssize_t pos,
+	ssize_t nDeleted, ssize_t nInserted, ssize_t nRestyled,
+	const char *deletedText, const bufModification *mods, int nMods)
+{
+    const bufModification *oldMods = buf->modifications;
+    int i, nOldMods = buf->nModifications;
     
+    if (nInserted != 0 || nDeleted != 0)
+    	buf->modCount++;
     for (i=0; i<buf->nModifyProcs; i++) {
+    	buf->modifications = mods;
+	buf->nModifications = nMods;
     	(*buf->modifyProcs[i])(pos, nInserted, nDeleted, nRestyled,
     		deletedText, buf->cbArgs[i]);
     }
+    buf->modifications = oldMods;
+    buf->nModifications = nOldMods;
 }
 
 static void callBeginModifyCBs(textBuffer *buf) {
     int i;
     
     for (i=0; i<buf->nBeginModifyProcs; i++) {
-    	(*buf->beginModifyProcs[i])(buf->cbArgs[i]);
+    	(*buf->beginModifyProcs[i])(buf->beginModifyCbArgs[i]);
     }
 }
 
@@ -2608,15 +2822,52 @@ static void callEndModifyCBs(textBuffer *buf) {
     int i;
     
     for (i=0; i<buf->nEndModifyProcs; i++) {
-    	(*buf->endModifyProcs[i])(buf->cbArgs[i]);
+    	(*buf->endModifyProcs[i])(buf->endModifyCbArgs[i]);
     }
 }
 
+/*
+** Replace the contents of "buf" with "newBuf", the text of which is laid out
+** around a gap of PREFERRED_GAP_SIZE starting at "gapStart"
+*/
+static void replaceAll(textBuffer *buf, char *newBuf, ssize_t length,
+	ssize_t gapStart)
+{
+    ssize_t deletedLength;
+    char *deletedText;
+
+    callPreDeleteCBs(buf, 0, buf->length);
+    
+    /* Save information for redisplay, and get rid of the old buffer */
+    deletedText = BufGetAll(buf);
+    deletedLength = buf->length;
+    NEditFree(buf->buf);
+    
+    buf->buf = newBuf;
+    buf->buf[length + PREFERRED_GAP_SIZE] = '\0';
+    buf->length = length;
+    buf->gapStart = gapStart;
+    buf->gapEnd = buf->gapStart + PREFERRED_GAP_SIZE;
+#ifdef PURIFY
+    {ssize_t i; for (i=buf->gapStart; i<buf->gapEnd; i++) buf->buf[i] = '.';}
+#endif
+    
+    /* The line index is rebuilt from scratch when next needed */
+    freeLineIndex(buf);
+    
+    /* Zero all of the existing selections */
+    updateSelections(buf, 0, deletedLength, 0);
+    
+    /* Call the saved display routine(s) to update the screen */
+    callModifyCBs(buf, 0, deletedLength, length, 0, deletedText);
+    NEditFree(deletedText);
+}
+
 /*
 ** Call the stored pre-delete callback procedure(s) for this buffer to update 
 ** the changed area(s) on the screen and any other listeners.
 */
-static void callPreDeleteCBs(textBuffer *buf, int pos, int nDeleted)
+static void callPreDeleteCBs(textBuffer *buf, ssize_t pos, ssize_t nDeleted)
 {
     int i;
     
@@ -2631,7 +2882,7 @@ static void callPreDeleteCBs(textBuffer *buf, int pos, int nDeleted)
 static void redisplaySelection(textBuffer *buf, selection *oldSelection,
 	selection *newSelection)
 {
-    int oldStart, oldEnd, newStart, newEnd, ch1Start, ch1End, ch2Start, ch2End;
+    ssize_t oldStart, oldEnd, newStart, newEnd, ch1Start, ch1End, ch2Start, ch2End;
     
     /* If either selection is rectangular, add an additional character to
        the end of the selection to request the redraw routines to wipe out
@@ -2691,9 +2942,9 @@ static void redisplaySelection(textBuffer *buf, selection *oldSelection,
     	callModifyCBs(buf, ch2Start, 0, 0, ch2End-ch2Start, NULL);
 }
 
-static void moveGap(textBuffer *buf, int pos)
+static void moveGap(textBuffer *buf, ssize_t pos)
 {
-    int gapLen = buf->gapEnd - buf->gapStart;
+    ssize_t gapLen = buf->gapEnd - buf->gapStart;
     
     if (pos > buf->gapStart)
     	memmove(&buf->buf[buf->gapStart], &buf->buf[buf->gapEnd],
@@ -2708,10 +2959,11 @@ static void moveGap(textBuffer *buf, int pos)
 ** reallocate the text storage in "buf" to have a gap starting at "newGapStart"
 ** and a gap size of "newGapLen", preserving the buffer's current contents.
 */
-static void reallocateBuf(textBuffer *buf, int newGapStart, int newGapLen)
+static void reallocateBuf(textBuffer *buf, ssize_t newGapStart,
+	ssize_t newGapLen)
 {
     char *newBuf;
-    int newGapEnd;
+    ssize_t newGapEnd;
 
     newBuf = (char*)NEditMalloc(buf->length + newGapLen + 1);
     newBuf[buf->length + PREFERRED_GAP_SIZE] = '\0';
@@ -2735,15 +2987,15 @@ static void reallocateBuf(textBuffer *buf, int newGapStart, int newGapLen)
     buf->gapStart = newGapStart;
     buf->gapEnd = newGapEnd;
 #ifdef PURIFY
-    {int i; for (i=buf->gapStart; i<buf->gapEnd; i++) buf->buf[i] = '.';}
+    {ssize_t i; for (i=buf->gapStart; i<buf->gapEnd; i++) buf->buf[i] = '.';}
 #endif
 }
 
 /*
 ** Update all of the selections in "buf" for changes in the buffer's text
 */
-static void updateSelections(textBuffer *buf, int pos, int nDeleted,
-	int nInserted)
+static void updateSelections(textBuffer *buf, ssize_t pos, ssize_t nDeleted,
+	ssize_t nInserted)
 {
     updateSelection(&buf->primary, pos, nDeleted, nInserted);
     updateSelection(&buf->secondary, pos, nDeleted, nInserted);
@@ -2753,8 +3005,8 @@ static void updateSelections(textBuffer *buf, int pos, int nDeleted,
 /*
 ** Update an individual selection for changes in the corresponding text
 */
-static void updateSelection(selection *sel, int pos, int nDeleted,
-	int nInserted)
+static void updateSelection(selection *sel, ssize_t pos, ssize_t nDeleted,
+	ssize_t nInserted)
 {
     if ((!sel->selected && !sel->zeroWidth) || pos > sel->end)
     	return;
@@ -2784,25 +3036,26 @@ static void updateSelection(selection *sel, int pos, int nDeleted,
 ** overall performance of the text widget is dependent on its ability to
 ** count lines quickly, hence searching for a single character: newline)
 */
-static int searchForward(textBuffer *buf, int startPos, char searchChar,
-	int *foundPos)
+static int searchForward(textBuffer *buf, ssize_t startPos, char searchChar,
+	ssize_t *foundPos)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
+    ssize_t pos = startPos, gapLen = buf->gapEnd - buf->gapStart;
+    const char *found;
     
-    pos = startPos;
-    while (pos < buf->gapStart) {
-        if (buf->buf[pos] == searchChar) {
-            *foundPos = pos;
-            return True;
-        }
-        pos++;
+    if (pos < buf->gapStart) {
+    	found = memchr(&buf->buf[pos], searchChar, buf->gapStart - pos);
+	if (found != NULL) {
+	    *foundPos = found - buf->buf;
+	    return True;
+	}
+	pos = buf->gapStart;
     }
-    while (pos < buf->length) {
-    	if (buf->buf[pos + gapLen] == searchChar) {
-            *foundPos = pos;
-            return True;
-        }
-        pos++;
+    if (pos < buf->length) {
+    	found = memchr(&buf->buf[pos + gapLen], searchChar, buf->length - pos);
+	if (found != NULL) {
+	    *foundPos = found - buf->buf - gapLen;
+	    return True;
+	}
     }
     *foundPos = buf->length;
     return False;
@@ -2816,34 +3069,96 @@ static int searchForward(textBuffer *buf, int startPos, char searchChar,
 ** overall performance of the text widget is dependent on its ability to
 ** count lines quickly, hence searching for a single character: newline)
 */
-static int searchBackward(textBuffer *buf, int startPos, char searchChar,
-	int *foundPos)
+static int searchBackward(textBuffer *buf, ssize_t startPos, char searchChar,
+	ssize_t *foundPos)
+{
+    ssize_t end = startPos, gapLen = buf->gapEnd - buf->gapStart;
+    const char *found;
+    size_t n;
+    scanCharSet set;
+    char chars[2];
+    
+    /* newlines (the common case) have their own kernel, which doesn't need
+       a character set to be built */
+    if (searchChar != '\n') {
+    	chars[0] = searchChar;
+	chars[1] = '\0';
+	ScanInitCharSet(&set, chars);
+	return findCharSetBackward(buf, startPos, &set, foundPos);
+    }
+    
+    if (end > buf->gapStart) {
+    	n = 1;
+    	found = ScanFindNthNewlineBackward(&buf->buf[buf->gapEnd],
+	    	end - buf->gapStart, &n);
+	if (found != NULL) {
+	    *foundPos = found - buf->buf - gapLen;
+	    return True;
+	}
+	end = buf->gapStart;
+    }
+    n = 1;
+    found = end > 0 ? ScanFindNthNewlineBackward(buf->buf, end, &n) : NULL;
+    *foundPos = found != NULL ? found - buf->buf : 0;
+    return found != NULL;
+}
+
+/*
+** Search forwards in buffer "buf" for a character belonging to "set",
+** starting with the character "startPos", and returning the result in
+** "foundPos".  Returns True if found, False if not.
+*/
+static int findCharSet(const textBuffer *buf, ssize_t startPos,
+	const scanCharSet *set, ssize_t *foundPos)
 {
-    int pos, gapLen = buf->gapEnd - buf->gapStart;
+    ssize_t pos = startPos, gapLen = buf->gapEnd - buf->gapStart;
+    const char *found;
     
-    if (startPos == 0) {
-    	*foundPos = 0;
-    	return False;
-    }
-    pos = startPos == 0 ? 0 : startPos - 1;
-    while (pos >= buf->gapStart) {
-    	if (buf->buf[pos + gapLen] == searchChar) {
-            *foundPos = pos;
-            return True;
-        }
-        pos--;
-    }
-    while (pos >= 0) {
-        if (buf->buf[pos] == searchChar) {
-            *foundPos = pos;
-            return True;
-        }
-        pos--;
+    if (pos < buf->gapStart) {
+    	found = ScanFindCharSet(&buf->buf[pos], buf->gapStart - pos, set);
+	if (found != NULL) {
+	    *foundPos = found - buf->buf;
+	    return True;
+	}
+	pos = buf->gapStart;
+    }
+    if (pos < buf->length) {
+    	found = ScanFindCharSet(&buf->buf[pos + gapLen], buf->length - pos,
+	    	set);
+	if (found != NULL) {
+	    *foundPos = found - buf->buf - gapLen;
+	    return True;
+	}
     }
-    *foundPos = 0;
+    *foundPos = buf->length;
     return False;
 }
 
+/*
+** Search backwards in buffer "buf" for a character belonging to "set",
+** starting with the character BEFORE "startPos", and returning the result
+** in "foundPos".  Returns True if found, False if not.
+*/
+static int findCharSetBackward(const textBuffer *buf, ssize_t startPos,
+	const scanCharSet *set, ssize_t *foundPos)
+{
+    ssize_t end = startPos, gapLen = buf->gapEnd - buf->gapStart;
+    const char *found;
+    
+    if (end > buf->gapStart) {
+    	found = ScanFindCharSetBackward(&buf->buf[buf->gapEnd],
+	    	end - buf->gapStart, set);
+	if (found != NULL) {
+	    *foundPos = found - buf->buf - gapLen;
+	    return True;
+	}
+	end = buf->gapStart;
+    }
+    found = end > 0 ? ScanFindCharSetBackward(buf->buf, end, set) : NULL;
+    *foundPos = found != NULL ? found - buf->buf : 0;
+    return found != NULL;
+}
+
 /*
 ** Copy from "text" to end up to but not including newline (or end of "text")
 ** and return the copy as the function value, and the length of the line in
@@ -2877,6 +3192,288 @@ static int countLines(const char *string)
     return lineCount;
 }
 
+/*
+** Count the newlines in buffer "buf" between "startPos" and "endPos" (not
+** including the character at "endPos")
+*/
+static ssize_t countNewlines(const textBuffer *buf, ssize_t startPos,
+	ssize_t endPos)
+{
+    ssize_t gapLen = buf->gapEnd - buf->gapStart, segEnd, lineCount = 0;
+    
+    if (startPos < buf->gapStart) {
+    	segEnd = min(endPos, buf->gapStart);
+	lineCount = ScanCountNewlines(&buf->buf[startPos], segEnd - startPos);
+    	startPos = segEnd;
+    }
+    if (startPos < endPos)
+    	lineCount += ScanCountNewlines(&buf->buf[startPos + gapLen],
+	    	endPos - startPos);
+    return lineCount;
+}
+
+/*
+** Sum of the first "nBlocks" entries of a line index Fenwick tree
+*/
+static ssize_t treePrefix(const ssize_t *tree, ssize_t nBlocks)
+{
+    ssize_t i, sum = 0;
+    
+    for (i=nBlocks; i>0; i -= i & -i)
+    	sum += tree[i];
+    return sum;
+}
+
+/*
+** Find the block of a line index Fenwick tree in which the running sum first
+** exceeds "target".  Returns the block number (nBlocks if the total doesn't
+** exceed target), and in "remainder", the part of target falling inside it.
+*/
+static ssize_t treeFind(const ssize_t *tree, ssize_t nBlocks, ssize_t target,
+	ssize_t *remainder)
+{
+    ssize_t block = 0, step = 1;
+    
+    while (step*2 <= nBlocks)
+    	step *= 2;
+    for (; step>0; step /= 2) {
+    	if (block + step <= nBlocks && tree[block + step] <= target) {
+    	    block += step;
+    	    target -= tree[block];
+	}
+    }
+    *remainder = target;
+    return block;
+}
+
+/*
+** Rebuild the Fenwick trees of a line index from its per-block counts
+*/
+static void buildLineIndexTrees(lineIndex *idx)
+{
+    ssize_t i, parent;
+    
+    for (i=1; i<=idx->nBlocks; i++) {
+    	idx->lenTree[i] = idx->len[i-1];
+    	idx->nlTree[i] = idx->nl[i-1];
+    }
+    for (i=1; i<=idx->nBlocks; i++) {
+    	parent = i + (i & -i);
+	if (parent <= idx->nBlocks) {
+    	    idx->lenTree[parent] += idx->lenTree[i];
+    	    idx->nlTree[parent] += idx->nlTree[i];
+	}
+    }
+}
+
+/*
+** Make room for at least "nBlocks" blocks in a line index
+*/
+static void growLineIndex(lineIndex *idx, ssize_t nBlocks)
+{
+    if (nBlocks <= idx->nAlloc)
+    	return;
+    idx->nAlloc = max(nBlocks, idx->nAlloc + idx->nAlloc/2);
+    idx->len = (ssize_t *)NEditRealloc(idx->len, idx->nAlloc * sizeof(ssize_t));
+    idx->nl = (ssize_t *)NEditRealloc(idx->nl, idx->nAlloc * sizeof(ssize_t));
+    idx->lenTree = (ssize_t *)NEditRealloc(idx->lenTree,
+    	    (idx->nAlloc + 1) * sizeof(ssize_t));
+    idx->nlTree = (ssize_t *)NEditRealloc(idx->nlTree,
+    	    (idx->nAlloc + 1) * sizeof(ssize_t));
+}
+
+/*
+** Return the line index of "buf", building it if it doesn't exist yet
+*/
+static lineIndex *getLineIndex(textBuffer *buf)
+{
+    lineIndex *idx = buf->lineIdx;
+    ssize_t i, start, end;
+    
+    if (idx != NULL)
+    	return idx;
+    
+    idx = (lineIndex *)NEditMalloc(sizeof(lineIndex));
+    idx->nBlocks = max(1, (buf->length + LINE_INDEX_BLOCK - 1) /
+    	    LINE_INDEX_BLOCK);
+    idx->nAlloc = 0;
+    idx->len = idx->nl = idx->lenTree = idx->nlTree = NULL;
+    growLineIndex(idx, idx->nBlocks);
+    for (i=0; i<idx->nBlocks; i++) {
+    	start = i * LINE_INDEX_BLOCK;
+	end = min(start + LINE_INDEX_BLOCK, buf->length);
+    	idx->len[i] = end - start;
+	idx->nl[i] = countNewlines(buf, start, end);
+    }
+    buildLineIndexTrees(idx);
+    buf->lineIdx = idx;
+    return idx;
+}
+
+static void freeLineIndex(textBuffer *buf)
+{
+    lineIndex *idx = buf->lineIdx;
+    
+    if (idx == NULL)
+    	return;
+    NEditFree(idx->len);
+    NEditFree(idx->nl);
+    NEditFree(idx->lenTree);
+    NEditFree(idx->nlTree);
+    NEditFree(idx);
+    buf->lineIdx = NULL;
+}
+
+/*
+** Adjust the length and newline count of one block of a line index
+*/
+static void lineIndexAdjust(lineIndex *idx, ssize_t block, ssize_t lenDiff,
+	ssize_t nlDiff)
+{
+    ssize_t i;
+    
+    idx->len[block] += lenDiff;
+    idx->nl[block] += nlDiff;
+    for (i=block+1; i<=idx->nBlocks; i += i & -i) {
+    	idx->lenTree[i] += lenDiff;
+    	idx->nlTree[i] += nlDiff;
+    }
+}
+
+/*
+** Split line index block "block", starting at buffer position "blockStart",
+** into blocks of LINE_INDEX_BLOCK characters
+*/
+static void splitLineIndexBlock(textBuffer *buf, ssize_t block,
+	ssize_t blockStart)
+{
+    lineIndex *idx = buf->lineIdx;
+    ssize_t i, nNew, remaining = idx->len[block];
+    
+    nNew = (remaining + LINE_INDEX_BLOCK - 1) / LINE_INDEX_BLOCK;
+    growLineIndex(idx, idx->nBlocks + nNew - 1);
+    memmove(&idx->len[block + nNew], &idx->len[block + 1],
+    	    (idx->nBlocks - block - 1) * sizeof(ssize_t));
+    memmove(&idx->nl[block + nNew], &idx->nl[block + 1],
+    	    (idx->nBlocks - block - 1) * sizeof(ssize_t));
+    idx->nBlocks += nNew - 1;
+    for (i=block; i<block+nNew; i++) {
+    	idx->len[i] = min(remaining, LINE_INDEX_BLOCK);
+	idx->nl[i] = countNewlines(buf, blockStart, blockStart + idx->len[i]);
+	blockStart += idx->len[i];
+	remaining -= idx->len[i];
+    }
+    buildLineIndexTrees(idx);
+}
+
+/*
+** Update the line index of "buf" (if it has one) for "nInserted" characters
+** just inserted at "pos"
+*/
+static void lineIndexInserted(textBuffer *buf, ssize_t pos, ssize_t nInserted)
+{
+    lineIndex *idx = buf->lineIdx;
+    ssize_t block, offset;
+    
+    if (idx == NULL || nInserted == 0)
+    	return;
+    
+    /* find the block holding pos (the tree doesn't yet know about the
+       inserted text), or the last block if inserting at the end */
+    block = treeFind(idx->lenTree, idx->nBlocks, pos, &offset);
+    if (block == idx->nBlocks) {
+    	block--;
+	offset = idx->len[block];
+    }
+    lineIndexAdjust(idx, block, nInserted,
+    	    countNewlines(buf, pos, pos + nInserted));
+    if (idx->len[block] > LINE_INDEX_MAX_BLOCK)
+    	splitLineIndexBlock(buf, block, pos - offset);
+}
+
+/*
+** Update the line index of "buf" (if it has one) for the text between
+** "start" and "end" which is about to be deleted
+*/
+static void lineIndexDeleting(textBuffer *buf, ssize_t start, ssize_t end)
+{
+    lineIndex *idx = buf->lineIdx;
+    ssize_t i, j, block, offset, blockStart, blockEnd, segEnd;
+    int emptied = False;
+    
+    if (idx == NULL || start >= end)
+    	return;
+    
+    block = treeFind(idx->lenTree, idx->nBlocks, start, &offset);
+    blockStart = start - offset;
+    for (; start < end && block < idx->nBlocks; block++) {
+    	blockEnd = blockStart + idx->len[block];
+	segEnd = min(end, blockEnd);
+	if (segEnd > start) {
+	    lineIndexAdjust(idx, block, start - segEnd,
+	    	    -countNewlines(buf, start, segEnd));
+	    if (idx->len[block] == 0)
+	    	emptied = True;
+	    start = segEnd;
+	}
+	blockStart = blockEnd;
+    }
+    
+    /* squeeze out blocks which are now empty, keeping at least one */
+    if (emptied) {
+    	for (i=0, j=0; i<idx->nBlocks; i++) {
+	    if (idx->len[i] != 0) {
+	    	idx->len[j] = idx->len[i];
+		idx->nl[j++] = idx->nl[i];
+	    }
+	}
+	if (j == 0) {
+	    idx->len[j] = 0;
+	    idx->nl[j] = 0;
+	    j++;
+	}
+	idx->nBlocks = j;
+	buildLineIndexTrees(idx);
+    }
+}
+
+/*
+** Return the number of newlines in "buf" before position "pos", using
+** the line index
+*/
+static ssize_t lineIndexPosToLine(textBuffer *buf, ssize_t pos)
+{
+    lineIndex *idx = getLineIndex(buf);
+    ssize_t block, offset;
+    
+    block = treeFind(idx->lenTree, idx->nBlocks, pos, &offset);
+    if (block == idx->nBlocks)
+    	return treePrefix(idx->nlTree, idx->nBlocks);
+    return treePrefix(idx->nlTree, block) +
+    	    countNewlines(buf, pos - offset, pos);
+}
+
+/*
+** Return the position of the first character of line "line" (counting from
+** 0) in "buf", using the line index.  Returns the buffer length if the
+** buffer has fewer lines.
+*/
+static ssize_t lineIndexLineToPos(textBuffer *buf, ssize_t line)
+{
+    lineIndex *idx = getLineIndex(buf);
+    ssize_t block, nlBefore;
+    
+    if (line <= 0)
+    	return 0;
+    
+    /* find the block holding the newline which ends line - 1 */
+    block = treeFind(idx->nlTree, idx->nBlocks, line - 1, &nlBefore);
+    if (block == idx->nBlocks)
+    	return buf->length;
+    return countForwardNLines(buf, treePrefix(idx->lenTree, block),
+    	    nlBefore + 1);
+}
+
 /*
 ** Measure the width in displayed characters of string "text"
 */
@@ -2914,10 +3511,11 @@ static int textWidth(const char *text, int tabDist, char nullSubsChar)
 ** that there are other characters in the selection to establish the right
 ** margin for subsequent columnar pastes of this data.
 */
-static void findRectSelBoundariesForCopy(textBuffer *buf, int lineStartPos,
-	int rectStart, int rectEnd, int *selStart, int *selEnd)
+static void findRectSelBoundariesForCopy(textBuffer *buf, ssize_t lineStartPos,
+	int rectStart, int rectEnd, ssize_t *selStart, ssize_t *selEnd)
 {
-    int pos, width, indent = 0;
+    ssize_t pos;
+    int width, indent = 0;
     int inc;
     char c;
     
@@ -3222,7 +3820,7 @@ void BufParseEscSeq(textBuffer *buf, size_t pos, size_t nInserted, size_t nDelet
     }
     
     // check if the inserted text contains escape sequences
-    int set_offset = 0;        // abs position of last added esc seq
+    size_t set_offset = 0;     // abs position of last added esc seq
     if(nInserted) {
         char *range = BufGetRange(buf, pos, pos+nInserted); // inserted text
         size_t prevEsc = startValue; // abs position of previous esc seq
@@ -3254,10 +3852,10 @@ void BufParseEscSeq(textBuffer *buf, size_t pos, size_t nInserted, size_t nDelet
     } 
 }
 
-static int bufEscCharLen(const textBuffer *buf, int pos)
+static int bufEscCharLen(const textBuffer *buf, ssize_t pos)
 {
     if(BufGetCharacter(buf, pos+1) != '[') return 1;
-    int i;
+    ssize_t i;
     for(i=pos+2;;i++) {
         char c = BufGetCharacter(buf, i);
         if(c < '0' || (c > '9' && c != ';')) break;
@@ -3266,7 +3864,7 @@ static int bufEscCharLen(const textBuffer *buf, int pos)
     return i;
 }
 
-int BufCharLen(const textBuffer *buf, int pos)
+int BufCharLen(const textBuffer *buf, ssize_t pos)
 {
     char utf8[4];
     utf8[0] = BufGetCharacter(buf, pos);
@@ -3275,13 +3873,13 @@ int BufCharLen(const textBuffer *buf, int pos)
     return Utf8CharLen((unsigned char*)utf8);
 }
 
-int BufLeftPos(textBuffer *buf, int pos)
+ssize_t BufLeftPos(textBuffer *buf, ssize_t pos)
 {
-    int cur = BufStartOfLine(buf, pos);
+    ssize_t cur = BufStartOfLine(buf, pos);
     if(cur == pos) {
         return pos-1;
     }
-    int left = cur;
+    ssize_t left = cur;
     while(cur < pos) {
         left = cur;
         cur += BufCharLen(buf, cur);
@@ -3289,17 +3887,17 @@ int BufLeftPos(textBuffer *buf, int pos)
     return left;
 }
 
-int BufRightPos(textBuffer *buf, int pos)
+ssize_t BufRightPos(textBuffer *buf, ssize_t pos)
 {
     return pos + BufCharLen(buf, pos);
 }
 
-static int max(int i1, int i2)
+static ssize_t max(ssize_t i1, ssize_t i2)
 {
     return i1 >= i2 ? i1 : i2;
 }
 
-static int min(int i1, int i2)
+static ssize_t min(ssize_t i1, ssize_t i2)
 {
     return i1 <= i2 ? i1 : i2;
 }
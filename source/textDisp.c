@@ -44,6 +44,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <time.h>
 #include <ctype.h>
 #ifndef __MVS__
 #include <sys/param.h>
@@ -103,19 +104,85 @@
 #define TEXT_OF_TEXTD(t)    (((TextWidget)((t)->w))->text)
 
 #define MCURSOR_ALLOC 8
-#define MCURSOR_MAX 1024
+#define MCURSOR_MAX 100000
 #define MCURSOR_ALLOC_RESET 32
 
+/* Lines longer than LAYOUT_CHECKPOINT_INTERVAL bytes get checkpoints of
+   redisplayLine's scan for the first character to draw, one every
+   LAYOUT_CHECKPOINT_INTERVAL bytes, kept for up to LAYOUT_CACHE_SIZE lines.
+   Drawing part of a long line (the cursor, a change of selection, or typing
+   near its end) can then start from the nearest checkpoint, rather than
+   measuring every character from the start of the line */
+#define LAYOUT_CHECKPOINT_INTERVAL 256
+#define LAYOUT_CACHE_SIZE 32
+
+/* In continuous wrap mode, the lines of the buffer are counted in blocks of
+   about WRAP_BLOCK_SIZE characters, for up to WRAP_COUNT_TIME seconds at a
+   time, so that turning on wrapping or resizing the window doesn't hold up
+   the application while a large buffer is counted (see startWrapCount) */
+#define WRAP_BLOCK_SIZE 65536
+#define WRAP_COUNT_TIME 0.02
+
+/* Longest ANSI escape sequence read by parseEscapeSequence: "\e[" and up to
+   ANSI_ESC_MAX_PARAM (16) parameters of ANSI_ESC_MAX_PARAM_LEN (4) digits,
+   each followed by a separator */
+#define ANSI_ESC_MAX_LEN (2 + 16 * 5)
+
+/* The state of the scan on reaching character "charIndex" of a line */
+typedef struct {
+    int charIndex, outIndex;
+    int x;				/* relative to the start of the line */
+    FcChar32 uc;
+    NFont *styleFL;
+    int ansiS, rbCharIndex, rbEnd;
+    ansiStyle ansi, newAnsiStyle;
+} layoutCheckpoint;
+
+/* Checkpoints for the line starting at "lineStart".  The state at a character
+   depends only on the text and styles before it (and on the fonts and display
+   options), so a change to the text or styles removes just the checkpoints
+   beyond it (see invalidateLayouts) */
+struct _lineLayout {
+    ssize_t lineStart;			/* -1 if unused */
+    int nCheckpoints, nAlloc;
+    layoutCheckpoint *checkpoints;
+};
+
+/* The fonts, glyphs and widths of characters of the Basic Multilingual Plane
+   are cached in a table of pages of GLYPH_PAGE_SIZE characters, allocated as
+   they are first used, and those of other characters in a hash table */
+#define GLYPH_PAGE_BITS 8
+#define GLYPH_PAGE_SIZE (1 << GLYPH_PAGE_BITS)
+#define GLYPH_BMP_SIZE 0x10000
+
+typedef struct {
+    XftFont *font;			/* NULL if not looked up yet */
+    int advance;			/* -1 if not measured yet */
+    FT_UInt index;			/* glyph of the character in font, */
+    Boolean hasIndex;			/*   if looked up yet */
+} glyphEntry;
+
+typedef struct {
+    FcChar32 c;				/* 0 for an empty slot */
+    glyphEntry glyph;
+} glyphHashEntry;
+
+struct NGlyphCache {
+    glyphEntry *pages[GLYPH_BMP_SIZE / GLYPH_PAGE_SIZE];
+    glyphHashEntry *hash;		/* open addressing, linear probing */
+    int hashSize, hashCount;
+};
+
 enum positionTypes {CURSOR_POS, CHARACTER_POS};
 
-static void updateLineStarts(textDisp *textD, int pos, int charsInserted,
-        int charsDeleted, int linesInserted, int linesDeleted, int *scrolled);
+static void updateLineStarts(textDisp *textD, ssize_t pos, ssize_t charsInserted,
+        ssize_t charsDeleted, int linesInserted, int linesDeleted, int *scrolled);
 static void offsetLineStarts(textDisp *textD, int newTopLineNum);
 static void calcLineStarts(textDisp *textD, int startLine, int endLine);
 static void calcLastChar(textDisp *textD);
-static int posToVisibleLineNum(textDisp *textD, int pos, int *lineNum);
+static int posToVisibleLineNum(textDisp *textD, ssize_t pos, int *lineNum);
 static int getCharWidth(textDisp *textD, const char *src_orig, FcChar32 *dst, int len);
-static FcChar32 getCharacter32(const textDisp *textD, const textBuffer* buf, int pos, int *charlen);
+static FcChar32 getCharacter32(const textDisp *textD, const textBuffer* buf, ssize_t pos, int *charlen);
 static void redisplayLine(textDisp *textD, int visLineNum, int leftClip,
         int rightClip, int leftCharIndex, int rightCharIndex);
 static void drawString(textDisp *textD, int style, int rbIndex, int x, int y, int fromX,
@@ -123,19 +190,52 @@ static void drawString(textDisp *textD, int style, int rbIndex, int x, int y, in
 static void clearRect(textDisp *textD, XftColor *color, int x, int y, 
         int width, int height);
 static void drawCursor(textDisp *textD, int x, int y);
-static int styleOfPos(textDisp *textD, int lineStartPos,
+static lineLayout *findLineLayout(textDisp *textD, ssize_t lineStart,
+        int lineLen);
+static const layoutCheckpoint *findCheckpoint(const lineLayout *layout,
+        int maxCharIndex, int maxX);
+static void addCheckpoint(lineLayout *layout, const layoutCheckpoint *cp);
+static void invalidateLayouts(textDisp *textD, ssize_t pos);
+static void freeLayoutCache(textDisp *textD);
+static double renderClock(void);
+static void countFrame(textDisp *textD, double elapsed);
+static Boolean endFrameWorkProc(XtPointer clientData);
+static void endFrame(textDisp *textD);
+static void startWrapCount(textDisp *textD);
+static void freeWrapCount(textDisp *textD);
+static void splitWrapBlock(textDisp *textD, int block);
+static Boolean wrapCountWorkProc(XtPointer clientData);
+static int findWrapBlock(const textDisp *textD, ssize_t pos);
+static int wrapBlockLines(const textDisp *textD, int block, double ratio);
+static double wrapLinesPerChar(const textDisp *textD);
+static void syncWrapTotals(textDisp *textD);
+static void updateWrapCount(textDisp *textD, ssize_t pos, ssize_t nInserted,
+        ssize_t nDeleted, ssize_t modStart, ssize_t modEnd, int lineDelta);
+static ssize_t wrapCountLineStart(textDisp *textD, int lineNum);
+static glyphEntry *lookupGlyph(NFont *f, FcChar32 c);
+static void freeGlyphCache(NGlyphCache *cache);
+static XftFont *findFontUncached(NFont *f, FcChar32 c);
+static FT_UInt fontGlyphIndex(NFont *f, XftFont *font, FcChar32 c);
+static int resizeBackBuffer(textDisp *textD);
+static void fillBackground(textDisp *textD, int x, int y, int width,
+        int height);
+static void presentRect(textDisp *textD, int x, int y, int width, int height);
+static int styleOfPos(textDisp *textD, ssize_t lineStartPos,
         int lineLen, int lineIndex, int dispIndex, int thisChar);
 static int charWidth4(const textDisp* textD, const FcChar32* string,
         int length, NFont *font);
 static NFont* styleFontList(const textDisp* textD, int style);
-static int inSelection(selection *sel, int pos, int lineStartPos,
+static int inSelection(selection *sel, ssize_t pos, ssize_t lineStartPos,
         int dispIndex);
-static int xyToPos(textDisp *textD, int x, int y, int posType);
+static ssize_t xyToPos(textDisp *textD, int x, int y, int posType);
 static void xyToUnconstrainedPos(textDisp *textD, int x, int y, int *row,
         int *column, int posType);
-static void bufPreDeleteCB(int pos, int nDeleted, void *cbArg);
-static void bufModifiedCB(int pos, int nInserted, int nDeleted,
-        int nRestyled, const char *deletedText, void *cbArg);
+static void bufPreDeleteCB(ssize_t pos, ssize_t nDeleted, void *cbArg);
+static void moveCursorsForEdits(textDisp *textD, const bufModification *mods,
+        int nMods);
+static int compareCursorPos(const void *a, const void *b);
+static void bufModifiedCB(ssize_t pos, ssize_t nInserted, ssize_t nDeleted,
+        ssize_t nRestyled, const char *deletedText, void *cbArg);
 static void setScroll(textDisp *textD, int topLineNum, int horizOffset,
         int updateVScrollBar, int updateHScrollBar);
 static void hScrollCB(Widget w, XtPointer clientData, XtPointer callData);
@@ -145,8 +245,8 @@ static void visibilityEH(Widget w, XtPointer data, XEvent *event,
 static void redrawLineNumbers(textDisp *textD, int top, int height, int clearAll);
 static void updateVScrollBarRange(textDisp *textD);
 static int updateHScrollBarRange(textDisp *textD);
-static int max(int i1, int i2);
-static int min(int i1, int i2);
+static ssize_t max(ssize_t i1, ssize_t i2);
+static ssize_t min(ssize_t i1, ssize_t i2);
 static int countLines(const char *string);
 static int measureVisLine(textDisp *textD, int visLineNum);
 static int emptyLinesVisible(textDisp *textD);
@@ -159,30 +259,30 @@ static GC allocateGC(Widget w, unsigned long valueMask,
 static void releaseGC(Widget w, GC gc);
 static void resetClipRectangles(textDisp *textD);
 static int visLineLength(textDisp *textD, int visLineNum);
-static void measureDeletedLines(textDisp *textD, int pos, int nDeleted);
-static int  findWrapRange(textDisp *textD, const char *deletedText, int pos,
-        int nInserted, int nDeleted, int *modRangeStart, int *modRangeEnd,
-        int *linesInserted, int *linesDeleted);
+static void measureDeletedLines(textDisp *textD, ssize_t pos, ssize_t nDeleted);
+static int  findWrapRange(textDisp *textD, const char *deletedText, ssize_t pos,
+        ssize_t nInserted, ssize_t nDeleted, ssize_t *modRangeStart,
+        ssize_t *modRangeEnd, int *linesInserted, int *linesDeleted);
 static void wrappedLineCounter(const textDisp* textD, const textBuffer* buf,
-        int startPos, int maxPos, int maxLines,
-        Boolean startPosIsLineStart, int styleBufOffset,
-        int* retPos, int* retLines, int* retLineStart, int* retLineEnd,
-        Boolean *retWrap);
-static void findLineEnd(textDisp *textD, int startPos, int startPosIsLineStart,
-        int *lineEnd, int *nextLineStart);
-static int wrapUsesCharacter(textDisp *textD, int lineEndPos);
+        ssize_t startPos, ssize_t maxPos, int maxLines,
+        Boolean startPosIsLineStart, ssize_t styleBufOffset,
+        ssize_t* retPos, int* retLines, ssize_t* retLineStart,
+        ssize_t* retLineEnd, Boolean *retWrap);
+static void findLineEnd(textDisp *textD, ssize_t startPos, int startPosIsLineStart,
+        ssize_t *lineEnd, ssize_t *nextLineStart);
+static int wrapUsesCharacter(textDisp *textD, ssize_t lineEndPos);
 static void hideOrShowHScrollBar(textDisp *textD);
-static int rangeTouchesRectSel(selection *sel, int rangeStart, int rangeEnd);
-static void extendRangeForStyleMods(textDisp *textD, int *start, int *end);
+static int rangeTouchesRectSel(selection *sel, ssize_t rangeStart, ssize_t rangeEnd);
+static void extendRangeForStyleMods(textDisp *textD, ssize_t *start, ssize_t *end);
 static int getAbsTopLineNum(textDisp *textD);
-static void offsetAbsLineNum(textDisp *textD, int oldFirstChar);
+static void offsetAbsLineNum(textDisp *textD, ssize_t oldFirstChar);
 static int maintainingAbsTopLineNum(textDisp *textD);
 static void resetAbsLineNum(textDisp *textD);
 static int measurePropChar(const textDisp* textD, FcChar32 c,
-        int colNum, int pos);
+        int colNum, ssize_t pos);
 static XftColor allocBGColor(Widget w, char *colorName, int *ok);
 static XftColor* getRangesetColor(textDisp *textD, int ind, XftColor *bground);
-static void textDRedisplayRange(textDisp *textD, int start, int end);
+static void textDRedisplayRange(textDisp *textD, ssize_t start, ssize_t end);
 static void findActiveAnsiStyle(textDisp *textD, ssize_t pos, ansiStyle *style);
 static int parseEscapeSequence(textBuffer *buf, size_t pos, ansiStyle *style);
 static void extendAnsiStyle(ansiStyle *style, ansiStyle *ext);
@@ -207,6 +307,15 @@ textDisp *TextDCreate(Widget widget, Widget hScrollBar, Widget vScrollBar,
     textD = (textDisp *)NEditMalloc(sizeof(textDisp));
     textD->w = widget;
     textD->d = NULL;
+    textD->backBuffer = None;
+    textD->backBufferWidth = textD->backBufferHeight = 0;
+    textD->backBufferGC = NULL;
+    textD->holdPresent = 0;
+    textD->layoutCache = NULL;
+    textD->layoutStyleGeneration = 0;
+    memset(&textD->stats, 0, sizeof(renderStats));
+    textD->frameOpen = False;
+    textD->frameProc = 0;
     textD->top = top;
     textD->left = left;
     textD->width = width;
@@ -256,7 +365,7 @@ textDisp *TextDCreate(Widget widget, Widget hScrollBar, Widget vScrollBar,
     textD->nVisibleLines = (height - 1) / (textD->ascent + textD->descent) + 1;
     gcValues.foreground = colorProfile->cursorFgColor.pixel;
     textD->cursorFGGC = XtGetGC(widget, GCForeground, &gcValues);
-    textD->lineStarts = (int *)NEditMalloc(sizeof(int) * textD->nVisibleLines);
+    textD->lineStarts = (ssize_t *)NEditMalloc(sizeof(ssize_t) * textD->nVisibleLines);
     textD->lineStarts[0] = 0;
     textD->calltipW = NULL;
     textD->calltipShell = NULL;
@@ -302,6 +411,10 @@ textDisp *TextDCreate(Widget widget, Widget hScrollBar, Widget vScrollBar,
     
     textD->cacheNoWrappingWidth = 0;
     textD->cacheNoWrapping = False;
+    textD->wrapBlocks = NULL;
+    textD->nWrapBlocks = textD->wrapBlocksAlloc = 0;
+    textD->wrapCountProc = 0;
+    textD->wrapCountWrapped = False;
     
     TextDSetAnsiColors(textD, ansiColors);
     
@@ -345,11 +458,13 @@ textDisp *TextDCreate(Widget widget, Widget hScrollBar, Widget vScrollBar,
 }
 
 /*
- * Initialize the XftDraw object. This should be called after the widget
- * is realized.
+ * Initialize the XftDraw object and the back buffer it draws to, and render
+ * the initial contents of the display into it. This should be called after
+ * the widget is realized.
  */
 void TextDInitXft(textDisp *textD) {   
     XWindowAttributes attributes;
+    XGCValues gcValues;
     XGetWindowAttributes(XtDisplay(textD->w), XtWindow(textD->w), &attributes); 
     
     Screen *screen = textD->w->core.screen;
@@ -363,12 +478,22 @@ void TextDInitXft(textDisp *textD) {
     }
     
     Display *dp = XtDisplay(textD->w);
+    gcValues.graphics_exposures = False;
+    textD->backBufferGC = XCreateGC(dp, XtWindow(textD->w),
+            GCGraphicsExposures, &gcValues);
+    resizeBackBuffer(textD);
     textD->d = XftDrawCreate(
             dp,
-            XtWindow(textD->w),
+            textD->backBuffer,
             visual,
             textD->w->core.colormap);
     
+    /* Expose events are served from the back buffer, so it must hold the
+       whole display before the window first appears */
+    textD->holdPresent++;
+    TextDRedisplayRect(textD, 0, textD->top, textD->left + textD->width,
+            textD->height);
+    textD->holdPresent--;
 }
 
 /*
@@ -388,6 +513,16 @@ void TextDFree(textDisp *textD)
     BufRemoveModifyCB(textD->buffer, bufModifiedCB, textD);
     BufRemovePreDeleteCB(textD->buffer, bufPreDeleteCB, textD);
     releaseGC(textD->w, textD->gc);
+    if (textD->d)
+        XftDrawDestroy(textD->d);
+    if (textD->backBuffer != None)
+        XFreePixmap(XtDisplay(textD->w), textD->backBuffer);
+    if (textD->backBufferGC)
+        XFreeGC(XtDisplay(textD->w), textD->backBufferGC);
+    freeLayoutCache(textD);
+    freeWrapCount(textD);
+    if (textD->frameProc != 0)
+        XtRemoveWorkProc(textD->frameProc);
     NEditFree(textD->lineStarts);
     while (TextDPopGraphicExposeQueueEntry(textD)) {
     }
@@ -432,11 +567,11 @@ void TextDSetBuffer(textDisp *textD, textBuffer *buffer)
 **
 ** Style buffers, tables and their associated memory are managed by the caller.
 */
-void TextDAttachHighlightData(textDisp *textD, textBuffer *styleBuffer,
+void TextDAttachHighlightData(textDisp *textD, styleBuffer *styleBuf,
     	styleTableEntry *styleTable, int nStyles, char unfinishedStyle,
     	unfinishedStyleCBProc unfinishedHighlightCB, void *cbArg)
 {
-    textD->styleBuffer = styleBuffer;
+    textD->styleBuffer = styleBuf;
     textD->styleTable = styleTable;
     textD->nStyles = nStyles;
     textD->unfinishedStyle = unfinishedStyle;
@@ -463,10 +598,15 @@ void TextDSetColorProfile(textDisp *textD, ColorProfile *profile)
     values.foreground = profile->cursorFgColor.pixel;
     XChangeGC( d, textD->cursorFGGC, GCForeground, &values );
     
-    /* Redisplay */
+    /* Redisplay, including the margins, which take the new background */
+    textD->holdPresent++;
+    fillBackground(textD, 0, 0, textD->backBufferWidth,
+            textD->backBufferHeight);
     TextDRedisplayRect(textD, textD->left, textD->top, textD->width,
                        textD->height);
     redrawLineNumbers(textD, textD->top, textD->height, True);
+    textD->holdPresent--;
+    presentRect(textD, 0, 0, textD->backBufferWidth, textD->backBufferHeight);
 }
 
 /*
@@ -480,6 +620,11 @@ void TextDSetFont(textDisp *textD, NFont *font)
     XftFont *styleFont;
     NFont *styleFontList;
     
+    /* Fonts, or the style table or style buffer, may have changed */
+    invalidateLayouts(textD, 0);
+    textD->layoutStyleGeneration = textD->styleBuffer ?
+            textD->styleBuffer->generation : 0;
+    
     /* If font size changes, cursor will be redrawn in a new position */
     if(!textD->disableRedisplay) {
         blankCursorProtrusions(textD);
@@ -527,6 +672,9 @@ void TextDSetFont(textDisp *textD, NFont *font)
     clearRect(textD, &textD->colorProfile->textBgColor, textD->left, 
 	    textD->top + textD->height - maxAscent - maxDescent, 
 	    textD->width, maxAscent + maxDescent);
+    presentRect(textD, textD->left, 
+	    textD->top + textD->height - maxAscent - maxDescent, 
+	    textD->width, maxAscent + maxDescent);
 
     /* Redisplay */
     TextDRedisplayRect(textD, textD->left, textD->top, textD->width,
@@ -603,11 +751,19 @@ void TextDResize(textDisp *textD, int width, int height)
     int redrawAll = False;
     int oldWidth = textD->width;
     int exactHeight = height - height % (textD->ascent + textD->descent);
+    int newBackBuffer = canRedraw && resizeBackBuffer(textD);
     
     if(width > oldWidth) {
         textD->fixLeftClipAfterResize = True;
     }
     
+    /* A new back buffer starts out blank, so everything must be drawn, and
+       then copied to the window at once, margins included */
+    if (newBackBuffer) {
+        redrawAll = True;
+        textD->holdPresent++;
+    }
+    
     textD->width = width;
     textD->height = height;
     
@@ -619,24 +775,10 @@ void TextDResize(textDisp *textD, int width, int height)
        lines in the buffer, and can leave the top line number incorrect, and
        the top character no longer pointing at a valid line start */
     if (textD->continuousWrap && textD->wrapMargin==0 && width!=oldWidth && !textD->cacheNoWrapping) {
-        Boolean wrap0 = False;
-        Boolean wrap1 = False;
-        
-        int oldFirstChar = textD->firstChar;
+        ssize_t oldFirstChar = textD->firstChar;
         
         textD->firstChar = TextDStartOfLine(textD, textD->firstChar);
-        int toplinenum = TextDCountLinesW(textD, 0, textD->firstChar, True, &wrap0);  
-        int count = TextDCountLinesW(textD, textD->firstChar, textD->buffer->length, True, &wrap1);
-
-        
-        textD->nBufferLines = toplinenum + count;
-        
-        if(!(wrap0 || wrap1)) {
-            textD->cacheNoWrapping = True;
-            textD->cacheNoWrappingWidth = width;
-        }
-        
-        textD->topLineNum = toplinenum+1;
+        startWrapCount(textD);
         redrawAll = True;
         offsetAbsLineNum(textD, oldFirstChar);     
     }
@@ -646,7 +788,7 @@ void TextDResize(textDisp *textD, int width, int height)
        when the width changes, even without a change in height) */
     if (oldVisibleLines < newVisibleLines) {
         NEditFree(textD->lineStarts);
-        textD->lineStarts = (int *)NEditMalloc(sizeof(int) * newVisibleLines);
+        textD->lineStarts = (ssize_t *)NEditMalloc(sizeof(ssize_t) * newVisibleLines);
     }
     textD->nVisibleLines = newVisibleLines;
     calcLineStarts(textD, 0, newVisibleLines);
@@ -654,10 +796,12 @@ void TextDResize(textDisp *textD, int width, int height)
     
     /* if the window became shorter, there may be partially drawn
        text left at the bottom edge, which must be cleaned up */
-    if (canRedraw && oldVisibleLines>newVisibleLines && exactHeight!=height)
-        XClearArea(XtDisplay(textD->w), XtWindow(textD->w), textD->left,
-                textD->top + exactHeight,  textD->width,
-                height - exactHeight, False);
+    if (canRedraw && oldVisibleLines>newVisibleLines && exactHeight!=height) {
+        fillBackground(textD, textD->left, textD->top + exactHeight,
+                textD->width, height - exactHeight);
+        presentRect(textD, textD->left, textD->top + exactHeight,
+                textD->width, height - exactHeight);
+    }
     
     /* if the window became taller, there may be an opportunity to display
        more text by scrolling down */
@@ -686,10 +830,26 @@ void TextDResize(textDisp *textD, int width, int height)
        erase extras */
     redrawLineNumbers(textD, textD->top, textD->height, True);
     
+    if (newBackBuffer) {
+        textD->holdPresent--;
+        presentRect(textD, 0, 0, textD->backBufferWidth,
+                textD->backBufferHeight);
+    }
+    
     /* Redraw the calltip */
     TextDRedrawCalltip(textD, 0);
 }
 
+/*
+** Restore a rectangle of the window which has been exposed, by copying it
+** from the back buffer, which always holds the current state of the display
+*/
+void TextDExposeRect(textDisp *textD, int left, int top, int width,
+	int height)
+{
+    presentRect(textD, left, top, width, height);
+}
+
 /*
 ** Refresh a rectangle of the text display.  left and top are in coordinates of
 ** the text drawing window
@@ -731,6 +891,15 @@ void TextDRedisplayRect(textDisp *textD, int left, int top, int width,
     }
 }
 
+/*
+** Refresh the text between buffer positions "start" and "end", for changes
+** which are not buffer modifications, such as restyling by the highlighter
+*/
+void TextDRedisplayRange(textDisp *textD, ssize_t start, ssize_t end)
+{
+    textDRedisplayRange(textD, start, end);
+}
+
 /*
 ** Refresh all of the text between buffer positions "start" and "end"
 ** not including the character at the position "end".
@@ -738,7 +907,7 @@ void TextDRedisplayRect(textDisp *textD, int left, int top, int width,
 ** after pos, including blank lines which are not technically part of
 ** any range of characters.
 */
-static void textDRedisplayRange(textDisp *textD, int start, int end)
+static void textDRedisplayRange(textDisp *textD, ssize_t start, ssize_t end)
 {
     int i, startLine, lastLine, startIndex, endIndex;
     
@@ -853,9 +1022,9 @@ void TextDGetScroll(textDisp *textD, int *topLineNum, int *horizOffset)
 /*
 ** Set the position of the text insertion cursor for text display "textD"
 */
-void TextDSetInsertPosition(textDisp *textD, int newPos)
+void TextDSetInsertPosition(textDisp *textD, ssize_t newPos)
 {
-    int oldLineStart, newLineStart, oldLineEnd, newLineEnd;
+    ssize_t oldLineStart, newLineStart, oldLineEnd, newLineEnd;
     Boolean hiline = False;
     if(textD->highlightCursorLine) {
         oldLineStart = BufStartOfLine(textD->buffer, textD->cursor->cursorPos);
@@ -897,7 +1066,7 @@ void TextDSetInsertPosition(textDisp *textD, int newPos)
         return;
     }
     
-    int left, right;
+    ssize_t left, right;
     TextDCursorLR(textD, &left, &right);
     textDRedisplayRange(textD, left, right);
     
@@ -937,7 +1106,7 @@ void TextDSetInsertPosition(textDisp *textD, int newPos)
 /*
  * Add diff to all cursors >= startPos
  */
-void TextDChangeCursors(textDisp *textD, int startPos, int diff) {
+void TextDChangeCursors(textDisp *textD, ssize_t startPos, ssize_t diff) {
     //int prevPos = -2;
     size_t newMCursorSize = textD->mcursorSize;
     for(int i=textD->mcursorSize-1;i>=0;i--) {
@@ -959,7 +1128,7 @@ void TextDChangeCursors(textDisp *textD, int startPos, int diff) {
     }
 }
 
-int TextDAddCursor(textDisp *textD, int newMultiCursorPos) {
+int TextDAddCursor(textDisp *textD, ssize_t newMultiCursorPos) {
     int mcInsertPos = 0;
     
     // make sure, there is not already a cursor for the new position
@@ -1038,11 +1207,42 @@ void TextDRemoveCursor(textDisp *textD, int cursorIndex) {
 }
 
 void TextDSetCursors(textDisp *textD, size_t *cursors, size_t ncursors) {
-    TextDBlankCursor(textD);    
-    textD->mcursorSize = 0;
-    for(int i=0;i<ncursors;i++) {
-        TextDAddCursor(textD, (int)cursors[i]);
+    if(ncursors == 0) {
+        return;
+    }
+    TextDBlankCursor(textD);
+    
+    // sort the positions and drop duplicates, instead of adding the cursors
+    // one by one, which is quadratic in the number of cursors
+    size_t *sorted = NEditMalloc(ncursors * sizeof(size_t));
+    memcpy(sorted, cursors, ncursors * sizeof(size_t));
+    qsort(sorted, ncursors, sizeof(size_t), compareCursorPos);
+    size_t n = 1;
+    for(size_t i=1;i<ncursors && n<MCURSOR_MAX;i++) {
+        if(sorted[i] != sorted[n-1]) {
+            sorted[n++] = sorted[i];
+        }
+    }
+    
+    if(n > textD->mcursorAlloc) {
+        textD->mcursorAlloc = n;
+        textD->multicursor = NEditRealloc(textD->multicursor, n * sizeof(textCursor));
+    }
+    for(size_t i=0;i<n;i++) {
+        textD->multicursor[i] = TextDPos2Cursor(textD, (ssize_t)sorted[i]);
+    }
+    NEditFree(sorted);
+    
+    textD->mcursorSize = n;
+    textD->mcursorSizeReal = n;
+    textD->mcursorOn = n > 1;
+    textD->cursor = textD->multicursor;
+    textD->newcursor = textD->multicursor;
+    
+    if(textD->highlightCursorLine) {
+        TextDRedisplayRect(textD, 0, textD->top, textD->width + textD->left, textD->height);
     }
+    TextDUnblankCursor(textD);
 }
 
 int TextDClearMultiCursor(textDisp *textD) {
@@ -1064,14 +1264,19 @@ int TextDClearMultiCursor(textDisp *textD) {
 }
 
 void TextDCheckCursorDuplicates(textDisp *textD) {
-    size_t mcursorSize = textD->mcursorSize;
+    // remove the duplicates in one pass (a duplicate is on the same line as
+    // the cursor which is kept, so there is nothing extra to redraw)
+    size_t n = 1;
     for(size_t i=1;i<textD->mcursorSize;i++) {
-        if(textD->multicursor[i].cursorPos == textD->multicursor[i-1].cursorPos) {
-            TextDRemoveCursor(textD, i);
-            mcursorSize--;
-            i--;
+        if(textD->multicursor[i].cursorPos != textD->multicursor[n-1].cursorPos) {
+            textD->multicursor[n++] = textD->multicursor[i];
         }
     }
+    textD->mcursorSize = n;
+    textD->mcursorSizeReal = n;
+    if(n == 1) {
+        textD->mcursorOn = FALSE;
+    }
     textD->cursor = textD->multicursor;
     textD->newcursor = textD->multicursor;
     
@@ -1089,7 +1294,7 @@ void TextDCheckCursorDuplicates(textDisp *textD) {
 static void textDBlankCursorPos(textDisp *textD) {
     blankSingleCursorProtrusions(textD);
     textD->cursorOn = False;
-    int left, right;
+    ssize_t left, right;
     TextDCursorLR(textD, &left, &right);
     textDRedisplayRange(textD, left, right);
 }
@@ -1112,7 +1317,7 @@ void TextDBlankCursor(textDisp *textD)
 }
 
 void textDUnblankCursorPos(textDisp *textD) {
-    int left, right;
+    ssize_t left, right;
     TextDCursorLR(textD, &left, &right);
     textDRedisplayRange(textD, left, right);
 }
@@ -1139,7 +1344,7 @@ void TextDSetCursorStyle(textDisp *textD, int style)
     textD->cursorStyle = style;
     blankCursorProtrusions(textD);
     if (textD->cursorOn) {
-        int left, right;
+        ssize_t left, right;
         if(textD->mcursorSize == 1) {
             TextDCursorLR(textD, &left, &right);
             textDRedisplayRange(textD, left, right);
@@ -1155,13 +1360,13 @@ void TextDSetCursorStyle(textDisp *textD, int style)
     }
 }
 
-Boolean TextDPosHasCursor(textDisp *textD, int pos, int *index) {
+Boolean TextDPosHasCursor(textDisp *textD, ssize_t pos, int *index) {
     *index = -1;
     if(textD->mcursorSizeReal == 1) {
         return pos == textD->cursor->cursorPos;
     } else {
         for(int i=0;i<textD->mcursorSizeReal;i++) {
-            int cursor = textD->multicursor[i].cursorPos;
+            ssize_t cursor = textD->multicursor[i].cursorPos;
             if(pos == cursor) {
                 *index = i;
                 return True;
@@ -1171,13 +1376,13 @@ Boolean TextDPosHasCursor(textDisp *textD, int pos, int *index) {
     }
 }
 
-Boolean TextDRangeHasCursor(textDisp *textD, int start, int end) {
+Boolean TextDRangeHasCursor(textDisp *textD, ssize_t start, ssize_t end) {
     if(textD->mcursorSizeReal == 1) {
-        int cursor = textD->cursor->cursorPos;
+        ssize_t cursor = textD->cursor->cursorPos;
         return cursor >= start && cursor <= end;
     } else {
         for(int i=0;i<textD->mcursorSizeReal;i++) {
-            int cursor = textD->multicursor[i].cursorPos;
+            ssize_t cursor = textD->multicursor[i].cursorPos;
             if(cursor >= start && cursor <= end) {
                 return True;
             }
@@ -1192,20 +1397,22 @@ void TextDSetWrapMode(textDisp *textD, int wrap, int wrapMargin)
     textD->continuousWrap = wrap;
     textD->cacheNoWrapping = False;
     
-    /* wrapping can change change the total number of lines, re-count */
-    Boolean retWrap;
-    textD->nBufferLines = TextDCountLinesW(textD, 0, textD->buffer->length,
-                                           True, &retWrap);
-    if(!retWrap) {
-        textD->cacheNoWrappingWidth = textD->width;
-        textD->cacheNoWrapping = True;
-    }
-    
     /* changing wrap margins wrap or changing from wrapped mode to non-wrapped
        can leave the character at the top no longer at a line start, and/or
-       change the line number */
+       change the line number.  Wrapping can change the total number of lines,
+       re-count (in wrap mode, partly in the background) */
     textD->firstChar = TextDStartOfLine(textD, textD->firstChar);
-    textD->topLineNum = TextDCountLines(textD, 0, textD->firstChar, True) + 1;
+    if (wrap) {
+        startWrapCount(textD);
+    } else {
+        freeWrapCount(textD);
+        textD->cacheNoWrappingWidth = textD->width;
+        textD->cacheNoWrapping = True;
+        textD->nBufferLines = BufCountLines(textD->buffer, 0,
+                textD->buffer->length);
+        textD->topLineNum = BufCountLines(textD->buffer, 0,
+                textD->firstChar) + 1;
+    }
     resetAbsLineNum(textD);
         
     /* update the line starts array */
@@ -1225,7 +1432,7 @@ void TextDSetWrapMode(textDisp *textD, int wrap, int wrapMargin)
 	    textD->height);
 }
 
-int TextDGetInsertPosition(textDisp *textD)
+ssize_t TextDGetInsertPosition(textDisp *textD)
 {
     return textD->cursor->cursorPos;
 }
@@ -1238,24 +1445,53 @@ int TextDGetInsertPosition(textDisp *textD)
 */
 void TextDInsert(textDisp *textD, char *text)
 {
-    int pos = textD->cursor->cursorPos;
+    ssize_t pos = textD->cursor->cursorPos;
     
     textD->cursorToHint = pos + strlen(text);
     BufInsert(textD->buffer, pos, text);
     textD->cursorToHint = NO_HINT;
 }
 
+/*
+** Make one edit at each cursor of a multi-cursor display, all in a single
+** buffer modification (see BufApplyEdits), and leave each cursor after the
+** text inserted by its edit.  "edits" holds an edit for every cursor, in the
+** same order, with positions in the text as it was before the edits.
+*/
+void TextDApplyCursorEdits(textDisp *textD, const bufEdit *edits)
+{
+    int i, nCursors = textD->mcursorSize;
+    ssize_t len, shift = 0;
+    
+    TextDBlankCursor(textD);
+    
+    /* bufModifiedCB repaints everything for scrolling only when it sees
+       the last cursor */
+    textD->cursor = textD->multicursor + nCursors - 1;
+    BufApplyEdits(textD->buffer, edits, nCursors);
+    
+    for (i=0; i<nCursors; i++) {
+        len = strlen(edits[i].text);
+        textD->multicursor[i].cursorPos = edits[i].pos + shift + len;
+        textD->multicursor[i].cursorPreferredCol = -1;
+        shift += len - edits[i].nDeleted;
+    }
+    TextDCheckCursorDuplicates(textD);
+    TextDUnblankCursor(textD);
+}
+
 /*
 ** Insert "text" (which must not contain newlines), overstriking the current
 ** cursor location.
 */
 void TextDOverstrike(textDisp *textD, char *text)
 {
-    int startPos = textD->cursor->cursorPos;
+    ssize_t startPos = textD->cursor->cursorPos;
     textBuffer *buf = textD->buffer;
-    int lineStart = BufStartOfLine(buf, startPos);
+    ssize_t lineStart = BufStartOfLine(buf, startPos);
     int textLen = strlen(text);
-    int i, p, endPos, indent, startIndent, endIndent, inc;
+    ssize_t p, endPos;
+    int i, indent, startIndent, endIndent, inc;
     char *c, ch, *paddedText = NULL;
     
     /* determine how many displayed character positions are covered */
@@ -1337,7 +1573,7 @@ XftColor RGBToColor(short r, short g, short b)
 /*
 ** Translate window coordinates to the nearest text cursor position.
 */
-int TextDXYToPosition(textDisp *textD, int x, int y)
+ssize_t TextDXYToPosition(textDisp *textD, int x, int y)
 {
     return xyToPos(textD, x, y, CURSOR_POS);
 }
@@ -1345,7 +1581,7 @@ int TextDXYToPosition(textDisp *textD, int x, int y)
 /*
 ** Translate window coordinates to the nearest character cell.
 */
-int TextDXYToCharPos(textDisp *textD, int x, int y)
+ssize_t TextDXYToCharPos(textDisp *textD, int x, int y)
 {
     return xyToPos(textD, x, y, CHARACTER_POS);
 }
@@ -1366,10 +1602,10 @@ void TextDXYToUnconstrainedPosition(textDisp *textD, int x, int y, int *row,
 ** positioning the cursor.  This, of course, makes no sense when the font
 ** is proportional, since there are no absolute columns.
 */
-int TextDLineAndColToPos(textDisp *textD, int lineNum, int column)
+ssize_t TextDLineAndColToPos(textDisp *textD, int lineNum, int column)
 {
-    int i, lineEnd, charIndex, outIndex, isMB;
-    int lineStart=0, charLen=0;
+    ssize_t i, lineEnd, lineStart=0;
+    int charIndex, outIndex, isMB, charLen=0;
     char expandedChar[MAX_EXP_CHAR_LEN];
 
     /* Count lines */
@@ -1426,9 +1662,10 @@ int TextDLineAndColToPos(textDisp *textD, int lineNum, int column)
 ** of view.  If the position is horizontally out of view, returns the
 ** x coordinate where the position would be if it were visible.
 */
-int TextDPositionToXY(textDisp *textD, int pos, int *x, int *y)
+int TextDPositionToXY(textDisp *textD, ssize_t pos, int *x, int *y)
 {
-    int charIndex, lineStartPos, fontHeight, lineLen;
+    ssize_t lineStartPos;
+    int charIndex, fontHeight, lineLen;
     int visLineNum, charLen, outIndex, xStep, charStyle, inc;
     FcChar32 expandedChar[MAX_EXP_CHAR_LEN];
     FcChar32 uc;
@@ -1492,7 +1729,7 @@ int TextDPositionToXY(textDisp *textD, int pos, int *x, int *y)
 ** WORKS FOR DISPLAYED LINES AND, IN CONTINUOUS WRAP MODE, ONLY WHEN THE
 ** ABSOLUTE LINE NUMBER IS BEING MAINTAINED.  Otherwise, it returns False.
 */
-int TextDPosToLineAndCol(textDisp *textD, int pos, int *lineNum, int *column)
+int TextDPosToLineAndCol(textDisp *textD, ssize_t pos, int *lineNum, int *column)
 {
     textBuffer *buf = textD->buffer;
     
@@ -1522,7 +1759,8 @@ int TextDPosToLineAndCol(textDisp *textD, int pos, int *lineNum, int *column)
 */
 int TextDInSelection(textDisp *textD, int x, int y)
 {
-    int row, column, pos = xyToPos(textD, x, y, CHARACTER_POS);
+    int row, column;
+    ssize_t pos = xyToPos(textD, x, y, CHARACTER_POS);
     textBuffer *buf = textD->buffer;
     
     xyToUnconstrainedPos(textD, x, y, &row, &column, CHARACTER_POS);
@@ -1543,7 +1781,7 @@ int TextDInSelection(textDisp *textD, int x, int y)
 */
 int TextDOffsetWrappedColumn(textDisp *textD, int row, int column)
 {
-    int lineStart, dispLineStart;
+    ssize_t lineStart, dispLineStart;
     
     if (!textD->continuousWrap || row < 0 || row > textD->nVisibleLines)
     	return column;
@@ -1580,7 +1818,7 @@ int TextDOffsetWrappedRow(textDisp *textD, int row)
 void TextDMakeInsertPosVisible(textDisp *textD)
 {
     int hOffset, topLine, x, y;
-    int cursorPos = textD->cursor->cursorPos;
+    ssize_t cursorPos = textD->cursor->cursorPos;
     int linesFromTop = 0, do_padding = 1; 
     int cursorVPadding = (int)TEXT_OF_TEXTD(textD).cursorVPadding;
     
@@ -1651,7 +1889,7 @@ void TextDMakeInsertPosVisible(textDisp *textD)
 ** visible line index (-1 if not visible) and the lineStartPos
 ** of the current insert position.
 */
-int TextDPreferredColumn(textDisp *textD, int *visLineNum, int *lineStartPos)
+int TextDPreferredColumn(textDisp *textD, int *visLineNum, ssize_t *lineStartPos)
 {
     int column;
 
@@ -1676,9 +1914,9 @@ int TextDPreferredColumn(textDisp *textD, int *visLineNum, int *lineStartPos)
 ** Return the insert position of the requested column given
 ** the lineStartPos.
 */
-int TextDPosOfPreferredCol(textDisp *textD, int column, int lineStartPos)
+ssize_t TextDPosOfPreferredCol(textDisp *textD, int column, ssize_t lineStartPos)
 {
-    int newPos;
+    ssize_t newPos;
 
     newPos = BufCountForwardDispChars(textD->buffer, lineStartPos, column);
     if (textD->continuousWrap) {
@@ -1712,7 +1950,8 @@ int TextDMoveLeft(textDisp *textD)
 
 int TextDMoveUp(textDisp *textD, int absolute)
 {
-    int lineStartPos, column, prevLineStartPos, newPos, visLineNum;
+    ssize_t lineStartPos, prevLineStartPos, newPos;
+    int column, visLineNum;
     
     /* Find the position of the start of the line.  Use the line starts array
        if possible, to avoid unbounded line-counting in continuous wrap mode */
@@ -1757,7 +1996,8 @@ int TextDMoveUp(textDisp *textD, int absolute)
 
 int TextDMoveDown(textDisp *textD, int absolute)
 {
-    int lineStartPos, column, nextLineStartPos, newPos, visLineNum;
+    ssize_t lineStartPos, nextLineStartPos, newPos;
+    int column, visLineNum;
 
     if (textD->cursor->cursorPos == textD->buffer->length) {
         return False;
@@ -1794,7 +2034,7 @@ int TextDMoveDown(textDisp *textD, int absolute)
     return True;
 }
 
-textCursor TextDPos2Cursor(textDisp *textD, int pos) {
+textCursor TextDPos2Cursor(textDisp *textD, ssize_t pos) {
     textBuffer *buf = textD->buffer;
     textCursor c;
     c.cursorPos = pos;
@@ -1817,7 +2057,7 @@ textCursor TextDPos2Cursor(textDisp *textD, int pos) {
     return c;
 }
 
-void TextDCursorLR(textDisp *textD, int *left, int *right)
+void TextDCursorLR(textDisp *textD, ssize_t *left, ssize_t *right)
 {
     if(textD->cursor->cursorPos != textD->cursor->cursorPosCache) {
         textCursor c = TextDPos2Cursor(textD, textD->cursor->cursorPos);
@@ -1833,6 +2073,7 @@ void TextDCursorLR(textDisp *textD, int *left, int *right)
 void TextDSetAnsiColors(textDisp *textD, Boolean ansiColors)
 {
     textD->ansiColors = ansiColors;
+    invalidateLayouts(textD, 0);
     if(ansiColors) {
         BufEnableAnsiEsc(textD->buffer);
         textD->cursor->cursorPosCache = -1;
@@ -1847,7 +2088,7 @@ void TextDSetAnsiColors(textDisp *textD, Boolean ansiColors)
 ** can pass "startPosIsLineStart" as True to make the call more efficient
 ** by avoiding the additional step of scanning back to the last newline.
 */
-int TextDCountLines(textDisp *textD, int startPos, int endPos,
+int TextDCountLines(textDisp *textD, ssize_t startPos, ssize_t endPos,
     	int startPosIsLineStart)
 {
     Boolean retWrap;
@@ -1858,10 +2099,11 @@ int TextDCountLines(textDisp *textD, int startPos, int endPos,
     return retLines;
 }
 
-int TextDCountLinesW(textDisp *textD, int startPos, int endPos,
+int TextDCountLinesW(textDisp *textD, ssize_t startPos, ssize_t endPos,
     	int startPosIsLineStart, Boolean *retWrapped)
 {
-    int retLines, retPos, retLineStart, retLineEnd;
+    int retLines;
+    ssize_t retPos, retLineStart, retLineEnd;
     
     /* If we're not wrapping use simple (and more efficient) BufCountLines */
     if (!textD->continuousWrap) {
@@ -1884,10 +2126,11 @@ int TextDCountLinesW(textDisp *textD, int startPos, int endPos,
 ** it can pass "startPosIsLineStart" as True to make the call more efficient
 ** by avoiding the additional step of scanning back to the last newline.
 */
-int TextDCountForwardNLines(const textDisp* textD, int startPos,
+ssize_t TextDCountForwardNLines(const textDisp* textD, ssize_t startPos,
         unsigned nLines, Boolean startPosIsLineStart)
 {
-    int retLines, retPos, retLineStart, retLineEnd;
+    int retLines;
+    ssize_t retPos, retLineStart, retLineEnd;
     
     /* if we're not wrapping use more efficient BufCountForwardNLines */
     if (!textD->continuousWrap)
@@ -1920,10 +2163,11 @@ int TextDCountForwardNLines(const textDisp* textD, int startPos,
 ** the start of the next line.  This is also consistent with the model used by
 ** visLineLength.
 */
-int TextDEndOfLine(const textDisp* textD, int pos,
+ssize_t TextDEndOfLine(const textDisp* textD, ssize_t pos,
         Boolean startPosIsLineStart)
 {
-    int retLines, retPos, retLineStart, retLineEnd;
+    int retLines;
+    ssize_t retPos, retLineStart, retLineEnd;
     
     /* If we're not wrapping use more efficient BufEndOfLine */
     if (!textD->continuousWrap)
@@ -1941,9 +2185,10 @@ int TextDEndOfLine(const textDisp* textD, int pos,
 ** Same as BufStartOfLine, but returns the character after last wrap point
 ** rather than the last newline.
 */
-int TextDStartOfLine(const textDisp* textD, int pos)
+ssize_t TextDStartOfLine(const textDisp* textD, ssize_t pos)
 {
-    int retLines, retPos, retLineStart, retLineEnd;
+    int retLines;
+    ssize_t retPos, retLineStart, retLineEnd;
     
     /* If we're not wrapping, use the more efficient BufStartOfLine */
     if (!textD->continuousWrap)
@@ -1959,10 +2204,11 @@ int TextDStartOfLine(const textDisp* textD, int pos)
 ** Same as BufCountBackwardNLines, but takes in to account line breaks when
 ** wrapping is turned on.
 */
-int TextDCountBackwardNLines(textDisp *textD, int startPos, int nLines)
+ssize_t TextDCountBackwardNLines(textDisp *textD, ssize_t startPos, int nLines)
 {
     textBuffer *buf = textD->buffer;
-    int pos, lineStart, retLines, retPos, retLineStart, retLineEnd;
+    int retLines;
+    ssize_t pos, lineStart, retPos, retLineStart, retLineEnd;
     
     /* If we're not wrapping, use the more efficient BufCountBackwardNLines */
     if (!textD->continuousWrap)
@@ -1985,11 +2231,50 @@ int TextDCountBackwardNLines(textDisp *textD, int startPos, int nLines)
     }
 }
 
+/*
+** Move the cursors of "textD" for a modification made up of several edits at
+** once (see BufApplyEdits), as they would have moved with the edits made one
+** at a time.  The cursors and the edits are both in order of position, so
+** this takes a single pass.
+*/
+static void moveCursorsForEdits(textDisp *textD, const bufModification *mods,
+        int nMods)
+{
+    ssize_t pos, shift = 0;
+    int i, j = 0;
+    
+    for (i=0; i<textD->mcursorSize; i++) {
+        pos = textD->multicursor[i].cursorPos;
+        
+        /* edits entirely before the cursor move it by the change in length
+           (mods[j].pos - shift is where edit j started before the edits) */
+        while (j < nMods && mods[j].pos - shift < pos &&
+                mods[j].pos - shift + mods[j].nDeleted <= pos) {
+            shift += mods[j].nInserted - mods[j].nDeleted;
+            j++;
+        }
+        
+        /* an edit deleting the text around the cursor leaves it at the start */
+        if (j < nMods && mods[j].pos - shift < pos)
+            textD->multicursor[i].cursorPos = mods[j].pos;
+        else
+            textD->multicursor[i].cursorPos = pos + shift;
+        textD->multicursor[i].cursorPreferredCol = -1;
+    }
+}
+
+static int compareCursorPos(const void *a, const void *b)
+{
+    size_t posA = *(const size_t *)a, posB = *(const size_t *)b;
+    
+    return posA < posB ? -1 : (posA > posB ? 1 : 0);
+}
+
 /*
 ** Callback attached to the text buffer to receive delete information before
 ** the modifications are actually made.
 */
-static void bufPreDeleteCB(int pos, int nDeleted, void *cbArg)
+static void bufPreDeleteCB(ssize_t pos, ssize_t nDeleted, void *cbArg)
 {
     textDisp *textD = (textDisp *)cbArg;
     if (textD->continuousWrap && 
@@ -2010,28 +2295,38 @@ static void bufPreDeleteCB(int pos, int nDeleted, void *cbArg)
 /*
 ** Callback attached to the text buffer to receive modification information
 */
-static void bufModifiedCB(int pos, int nInserted, int nDeleted,
-	int nRestyled, const char *deletedText, void *cbArg)
+static void bufModifiedCB(ssize_t pos, ssize_t nInserted, ssize_t nDeleted,
+	ssize_t nRestyled, const char *deletedText, void *cbArg)
 {
-    int linesInserted, linesDeleted, startDispPos, endDispPos;
+    int linesInserted, linesDeleted;
+    ssize_t startDispPos, endDispPos;
     textDisp *textD = (textDisp *)cbArg;
     textBuffer *buf = textD->buffer;
-    int oldFirstChar = textD->firstChar;
-    int scrolled, origCursorPos = textD->cursor->cursorPos;
-    int wrapModStart, wrapModEnd;
+    ssize_t oldFirstChar = textD->firstChar;
+    ssize_t origCursorPos = textD->cursor->cursorPos;
+    int scrolled;
+    ssize_t wrapModStart, wrapModEnd;
     int redrawLN = False;
+    const bufModification *mods;
+    int nMods = BufGetModifications(buf, &mods);
     
-    /* buffer modification cancels vertical cursor motion column */
-    if (nInserted != 0 || nDeleted != 0)
+    /* buffer modification cancels vertical cursor motion column, and
+       measurements of the text beyond it */
+    if (nInserted != 0 || nDeleted != 0) {
     	textD->cursor->cursorPreferredCol = -1;
+        invalidateLayouts(textD, pos);
+    }
     
     /* Count the number of lines inserted and deleted, and in the case
        of continuous wrap mode, how much has changed */
     if (textD->continuousWrap) {
     	redrawLN = findWrapRange(textD, deletedText, pos, nInserted, nDeleted,
     	    	&wrapModStart, &wrapModEnd, &linesInserted, &linesDeleted);
+        if (nInserted != 0 || nDeleted != 0)
+            updateWrapCount(textD, pos, nInserted, nDeleted, wrapModStart,
+                    wrapModEnd, linesInserted - linesDeleted);
         if(!redrawLN && nDeleted > 0) {
-            for(int i=0;i<nDeleted;i++) {
+            for(ssize_t i=0;i<nDeleted;i++) {
                 if(deletedText[i] == '\n') {
                     redrawLN = 1;
                     break;
@@ -2083,6 +2378,8 @@ static void bufModifiedCB(int pos, int nInserted, int nDeleted,
     if (textD->cursorToHint != NO_HINT) {
     	textD->cursor->cursorPos = textD->cursorToHint;
     	textD->cursorToHint = NO_HINT;
+    } else if (nMods > 0) {
+        moveCursorsForEdits(textD, mods, nMods);
     } else if (textD->cursor->cursorPos > pos) {
         if(textD->mcursorSize > 1) {
             // multi cursor update
@@ -2114,7 +2411,7 @@ static void bufModifiedCB(int pos, int nInserted, int nDeleted,
        old cursor gets erased, and erase the bits of the cursor which extend
        beyond the left and right edges of the text. */
     startDispPos = textD->continuousWrap ? wrapModStart : pos;
-    int cpos = origCursorPos;
+    ssize_t cpos = origCursorPos;
     if (textD->highlightCursorLine) {
         cpos = BufStartOfLine(buf, origCursorPos);
     }
@@ -2192,7 +2489,7 @@ static int getAbsTopLineNum(textDisp *textD)
 /*
 ** Re-calculate absolute top line number for a change in scroll position.
 */
-static void offsetAbsLineNum(textDisp *textD, int oldFirstChar)
+static void offsetAbsLineNum(textDisp *textD, ssize_t oldFirstChar)
 {
     if (maintainingAbsTopLineNum(textD)) {
 	if (textD->firstChar < oldFirstChar)
@@ -2229,7 +2526,7 @@ static void resetAbsLineNum(textDisp *textD)
 ** Find the line number of position "pos" relative to the first line of
 ** displayed text. Returns False if the line is not displayed.
 */
-static int posToVisibleLineNum(textDisp *textD, int pos, int *lineNum)
+static int posToVisibleLineNum(textDisp *textD, ssize_t pos, int *lineNum)
 {
     int i;
     
@@ -2289,12 +2586,12 @@ static int getCharWidth(textDisp *textD, const char *src_orig, FcChar32 *dst, in
     }
 }
 
-static FcChar32 getCharacter32(const textDisp *textD, const textBuffer* buf, int pos, int *charlen)
+static FcChar32 getCharacter32(const textDisp *textD, const textBuffer* buf, ssize_t pos, int *charlen)
 {
     if(textD->ansiColors) {
         if(BufGetCharacter(buf, pos) == '\e') {
             if(BufGetCharacter(buf, pos+1) == '[') {
-                int start = pos;
+                ssize_t start = pos;
                 pos += 2;
                 char c;
                 while((c = BufGetCharacter(buf, pos)) != '\0') {
@@ -2331,12 +2628,13 @@ static void redisplayLine(textDisp *textD, int visLineNum, int leftClip,
 	int rightClip, int leftCharIndex, int rightCharIndex)
 {
     textBuffer *buf = textD->buffer;
-    int x, y, startX, charIndex, lineStartPos, lineLen, fontHeight, inc;
+    int x, y, startX, charIndex, lineLen, fontHeight, inc;
     int stdCharWidth, charWidth, startIndex, charStyle, style;
     int charLen, outStartIndex, outIndex, hasCursor = False;
     int dispIndexOffset, y_orig;
-    int startOfLine = INT_MAX;
-    int endOfLine = 0;
+    ssize_t lineStartPos;
+    ssize_t startOfLine = INT_MAX;
+    ssize_t endOfLine = 0;
     int cursorLine = False;
     FcChar32 expandedChar[MAX_EXP_CHAR_LEN];
     FcChar32 outStr[MAX_DISP_LINE_LEN];
@@ -2353,11 +2651,12 @@ static void redisplayLine(textDisp *textD, int visLineNum, int leftClip,
             TEXT_OF_TEXTD(textD).emulateTabs : buf->tabDist;
     Boolean indentRainbow = textD->indentRainbow;
     
-    textCursorX singleCursor = { textD->cursor->cursorPos, 0 };
-    textCursorX *cursorX = textD->mcursorSizeReal == 1 ? &singleCursor : NEditCalloc(textD->mcursorSizeReal, sizeof(textCursorX));
-    int cursorNum = 0;
-    int cursorIndex;
-     
+    lineLayout *layout;
+    const layoutCheckpoint *checkpoint;
+    layoutCheckpoint newCheckpoint;
+    int nextCheckpoint;
+    double startTime = renderClock();
+    
     /* If line is not displayed, skip it */
     if (visLineNum < 0 || visLineNum >= textD->nVisibleLines)
     	return;
@@ -2369,6 +2668,11 @@ static void redisplayLine(textDisp *textD, int visLineNum, int leftClip,
     if (leftClip > rightClip) {
         return;
     }
+    
+    textCursorX singleCursor = { textD->cursor->cursorPos, 0 };
+    textCursorX *cursorX = textD->mcursorSizeReal == 1 ? &singleCursor : NEditCalloc(textD->mcursorSizeReal, sizeof(textCursorX));
+    int cursorNum = 0;
+    int cursorIndex;
 
     /* Calculate y coordinate of the string to draw */
     fontHeight = textD->ascent + textD->descent;
@@ -2436,8 +2740,52 @@ static void redisplayLine(textDisp *textD, int visLineNum, int leftClip,
     int rbCharIndex = 0;
     int rbPixelIndex = 0;
     
+    /* In a long line, the scan can pick up from the last checkpoint before
+       the first character to draw */
+    charIndex = 0;
+    nextCheckpoint = LAYOUT_CHECKPOINT_INTERVAL;
+    textD->stats.lines++;
+    layout = findLineLayout(textD, lineStartPos, lineLen);
+    if (layout) {
+        textD->stats.longLines++;
+        checkpoint = findCheckpoint(layout, min(leftCharIndex, lineLen - 1),
+                leftClip - x);
+        if (checkpoint) {
+            textD->stats.layoutHits++;
+            charIndex = checkpoint->charIndex;
+            outIndex = checkpoint->outIndex;
+            x += checkpoint->x;
+            uc = checkpoint->uc;
+            styleFL = checkpoint->styleFL;
+            ansiS = checkpoint->ansiS;
+            rbCharIndex = checkpoint->rbCharIndex;
+            rbEnd = checkpoint->rbEnd;
+            ansi = checkpoint->ansi;
+            newAnsiStyle = checkpoint->newAnsiStyle;
+        }
+        if (layout->nCheckpoints > 0)
+            nextCheckpoint = layout->checkpoints[layout->nCheckpoints-1].charIndex
+                    + LAYOUT_CHECKPOINT_INTERVAL;
+    }
+    
     inc = 1;
-    for (charIndex = 0; ; charIndex+=inc) { 
+    for ( ; ; charIndex+=inc) { 
+        if (layout && charIndex >= nextCheckpoint && charIndex < lineLen &&
+                layout->lineStart == lineStartPos) {
+            newCheckpoint.charIndex = charIndex;
+            newCheckpoint.outIndex = outIndex;
+            newCheckpoint.x = x - (textD->left - textD->horizOffset);
+            newCheckpoint.uc = uc;
+            newCheckpoint.styleFL = styleFL;
+            newCheckpoint.ansiS = ansiS;
+            newCheckpoint.rbCharIndex = rbCharIndex;
+            newCheckpoint.rbEnd = rbEnd;
+            newCheckpoint.ansi = ansi;
+            newCheckpoint.newAnsiStyle = newAnsiStyle;
+            addCheckpoint(layout, &newCheckpoint);
+            nextCheckpoint = charIndex + LAYOUT_CHECKPOINT_INTERVAL;
+        }
+        textD->stats.charsScanned++;
         if(charIndex >= lineLen) {
             baseChar = '\0';   
             charLen = 1;
@@ -2694,6 +3042,13 @@ static void redisplayLine(textDisp *textD, int visLineNum, int leftClip,
         }
     }
     
+    countFrame(textD, renderClock() - startTime);
+    
+    /* Show the line, with any part of the cursor protruding beyond the
+       clipping range */
+    presentRect(textD, leftClip - textD->font->maxWidth - 1, y,
+            rightClip - leftClip + 2 * (textD->font->maxWidth + 1), fontHeight);
+    
     // set the position where the input method might pop up
     if(hasCursor && textD->mcursorSizeReal == 1) {
         int cx = cursorX[0].cursorX;
@@ -2869,8 +3224,16 @@ static void drawString(textDisp *textD, int style, int rbIndex, int x, int y, in
     
     
 
-    /* Draw the string using color and font set above */  
-    XftDrawString32(textD->d, &color, font, x, y + textD->ascent, string, nChars);
+    /* Draw the glyphs of the string, cached with the font of the style,
+       in the color set above */
+    FT_UInt glyphs[MAX_DISP_LINE_LEN];
+    if(nChars > MAX_DISP_LINE_LEN) {
+        nChars = MAX_DISP_LINE_LEN;
+    }
+    for(int i=0;i<nChars;i++) {
+        glyphs[i] = fontGlyphIndex(fontList, font, string[i]);
+    }
+    XftDrawGlyphs(textD->d, &color, font, x, y + textD->ascent, glyphs, nChars);
         
     /* Underline if style is secondary selection */
     if (style & SECONDARY_MASK || underlineStyle)
@@ -2893,8 +3256,7 @@ static void clearRect(textDisp *textD, XftColor *color, int x, int y,
     	return;
     
     if (color == &textD->colorProfile->textBgColor) {
-        XClearArea(XtDisplay(textD->w), XtWindow(textD->w), x, y,
-                width, height, False);
+        fillBackground(textD, x, y, width, height);
     }
     else {
         XftDrawRect(textD->d, color, x, y, width, height);
@@ -2964,7 +3326,7 @@ static void drawCursor(textDisp *textD, int x, int y)
 	segs[3].x1 = x; segs[3].y1 = bot; segs[3].x2 = x; segs[3].y2 = y;
 	nSegs = 4;
     }
-    XDrawSegments(XtDisplay(textD->w), XtWindow(textD->w),
+    XDrawSegments(XtDisplay(textD->w), textD->backBuffer,
     	    textD->cursorFGGC, segs, nSegs);
     
     /* Save the last position drawn */
@@ -2972,6 +3334,270 @@ static void drawCursor(textDisp *textD, int x, int y)
     textD->cursor->y = y;
 }
 
+/*
+** Make the back buffer match the size of the widget window.  Returns True if
+** a new (blank) one was created, which the caller must fill by redrawing.
+*/
+static int resizeBackBuffer(textDisp *textD)
+{
+    Display *display = XtDisplay(textD->w);
+    int width = max(1, textD->w->core.width);
+    int height = max(1, textD->w->core.height);
+    
+    if (textD->backBuffer != None && width == textD->backBufferWidth &&
+            height == textD->backBufferHeight)
+        return False;
+    
+    if (textD->backBuffer != None)
+        XFreePixmap(display, textD->backBuffer);
+    textD->backBuffer = XCreatePixmap(display, XtWindow(textD->w), width,
+            height, textD->w->core.depth);
+    textD->backBufferWidth = width;
+    textD->backBufferHeight = height;
+    if (textD->d)
+        XftDrawChange(textD->d, textD->backBuffer);
+    fillBackground(textD, 0, 0, width, height);
+    return True;
+}
+
+/*
+** Fill a rectangle of the back buffer with the text background color.  Unlike
+** clearRect with other colors, this ignores the clipping set for drawing text.
+*/
+static void fillBackground(textDisp *textD, int x, int y, int width,
+        int height)
+{
+    if (textD->backBuffer == None || width <= 0 || height <= 0)
+        return;
+    XSetForeground(XtDisplay(textD->w), textD->backBufferGC,
+            textD->colorProfile->textBgColor.pixel);
+    XFillRectangle(XtDisplay(textD->w), textD->backBuffer, textD->backBufferGC,
+            x, y, width, height);
+}
+
+/*
+** Copy a rectangle of the back buffer to the window, unless holdPresent says
+** that the caller will copy a larger area when it's done drawing
+*/
+static void presentRect(textDisp *textD, int x, int y, int width, int height)
+{
+    if (textD->backBuffer == None || textD->holdPresent > 0)
+        return;
+    if (x < 0) {
+        width += x;
+        x = 0;
+    }
+    if (y < 0) {
+        height += y;
+        y = 0;
+    }
+    if (width > textD->backBufferWidth - x)
+        width = textD->backBufferWidth - x;
+    if (height > textD->backBufferHeight - y)
+        height = textD->backBufferHeight - y;
+    if (width <= 0 || height <= 0)
+        return;
+    XCopyArea(XtDisplay(textD->w), textD->backBuffer, XtWindow(textD->w),
+            textD->backBufferGC, x, y, width, height, x, y);
+}
+
+/*
+** Return the checkpoints for the line starting at "lineStart", which may be
+** none yet, or NULL if the line is too short to need them.  Changes to the
+** styles since the last call are taken into account first.
+*/
+static lineLayout *findLineLayout(textDisp *textD, ssize_t lineStart,
+        int lineLen)
+{
+    styleBuffer *styleBuf = textD->styleBuffer;
+    lineLayout *layout;
+    int i;
+    
+    if (lineStart == -1 || lineLen <= LAYOUT_CHECKPOINT_INTERVAL)
+        return NULL;
+    
+    if (textD->layoutCache == NULL) {
+        textD->layoutCache = (lineLayout *)NEditCalloc(LAYOUT_CACHE_SIZE,
+                sizeof(lineLayout));
+        for (i=0; i<LAYOUT_CACHE_SIZE; i++)
+            textD->layoutCache[i].lineStart = -1;
+    }
+    if (styleBuf && styleBuf->generation != textD->layoutStyleGeneration) {
+        invalidateLayouts(textD, StyleBufChangedSince(styleBuf,
+                textD->layoutStyleGeneration));
+        textD->layoutStyleGeneration = styleBuf->generation;
+    }
+    
+    layout = &textD->layoutCache[lineStart % LAYOUT_CACHE_SIZE];
+    if (layout->lineStart != lineStart) {
+        layout->lineStart = lineStart;
+        layout->nCheckpoints = 0;
+    }
+    return layout;
+}
+
+/*
+** Find the last checkpoint in "layout" at or before character "maxCharIndex"
+** and left of x position "maxX" (relative to the start of the line), or
+** return NULL if there is none
+*/
+static const layoutCheckpoint *findCheckpoint(const lineLayout *layout,
+        int maxCharIndex, int maxX)
+{
+    const layoutCheckpoint *cp;
+    int lo = 0, hi = layout->nCheckpoints, mid;
+    
+    /* Both charIndex and x increase along the line */
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        cp = &layout->checkpoints[mid];
+        if (cp->charIndex <= maxCharIndex && cp->x < maxX)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo == 0 ? NULL : &layout->checkpoints[lo - 1];
+}
+
+static void addCheckpoint(lineLayout *layout, const layoutCheckpoint *cp)
+{
+    if (layout->nCheckpoints == layout->nAlloc) {
+        layout->nAlloc = layout->nAlloc == 0 ? 16 : layout->nAlloc * 2;
+        layout->checkpoints = (layoutCheckpoint *)NEditRealloc(
+                layout->checkpoints, sizeof(layoutCheckpoint) * layout->nAlloc);
+    }
+    layout->checkpoints[layout->nCheckpoints++] = *cp;
+}
+
+/*
+** Discard the checkpoints which may have been changed by a change to the text
+** or its styles at "pos" and beyond.  The state of the scan on reaching a
+** character depends only on what comes before it, with the exception of an
+** ANSI escape sequence, which is parsed from its first character.  A "pos" of
+** -1 means nothing has changed.
+*/
+static void invalidateLayouts(textDisp *textD, ssize_t pos)
+{
+    lineLayout *layout;
+    int i;
+    
+    if (textD->layoutCache == NULL || pos < 0)
+        return;
+    if (textD->ansiColors)
+        pos = max(0, pos - ANSI_ESC_MAX_LEN);
+    
+    for (i=0; i<LAYOUT_CACHE_SIZE; i++) {
+        layout = &textD->layoutCache[i];
+        if (layout->lineStart == -1)
+            continue;
+        if (layout->lineStart >= pos) {
+            layout->lineStart = -1;
+            continue;
+        }
+        while (layout->nCheckpoints > 0 &&
+                layout->checkpoints[layout->nCheckpoints - 1].charIndex >
+                pos - layout->lineStart)
+            layout->nCheckpoints--;
+    }
+}
+
+static void freeLayoutCache(textDisp *textD)
+{
+    int i;
+    
+    if (textD->layoutCache == NULL)
+        return;
+    for (i=0; i<LAYOUT_CACHE_SIZE; i++)
+        NEditFree(textD->layoutCache[i].checkpoints);
+    NEditFree(textD->layoutCache);
+    textD->layoutCache = NULL;
+}
+
+static double renderClock(void)
+{
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/*
+** Add "elapsed" seconds spent drawing a line to the current frame.  A frame
+** is all of the drawing done in response to one batch of events: it starts
+** with the first line drawn, and ends when the application is next idle.
+*/
+static void countFrame(textDisp *textD, double elapsed)
+{
+    textD->stats.renderTime += elapsed;
+    textD->stats.frameTime += elapsed;
+    if (!textD->frameOpen) {
+        textD->frameOpen = True;
+        textD->stats.frames++;
+    }
+    if (textD->frameProc == 0)
+        textD->frameProc = XtAppAddWorkProc(
+                XtWidgetToApplicationContext(textD->w), endFrameWorkProc,
+                textD);
+}
+
+static Boolean endFrameWorkProc(XtPointer clientData)
+{
+    textDisp *textD = (textDisp *)clientData;
+    
+    textD->frameProc = 0;
+    endFrame(textD);
+    return True;
+}
+
+static void endFrame(textDisp *textD)
+{
+    if (!textD->frameOpen)
+        return;
+    if (textD->stats.frameTime > textD->stats.maxFrameTime)
+        textD->stats.maxFrameTime = textD->stats.frameTime;
+    textD->stats.frameTime = 0.0;
+    textD->frameOpen = False;
+}
+
+/*
+** Return a report of the work done to draw the text since the display was
+** created, or since the last call to TextDResetRenderStats.  A frame is the
+** drawing done for one batch of events (see countFrame).  The returned
+** string must be freed with NEditFree.
+*/
+char *TextDRenderStatsReport(textDisp *textD)
+{
+    renderStats *s = &textD->stats;
+    char *report = (char *)NEditMalloc(768);
+    int i, blocksLeft = 0;
+
+    endFrame(textD);
+    for (i=0; i<textD->nWrapBlocks; i++)
+        if (textD->wrapBlocks[i].lines == -1)
+            blocksLeft++;
+    sprintf(report,
+            "Lines drawn:          %12lu\n"
+            "Long lines:           %12lu (%lu started from a checkpoint)\n"
+            "Characters measured:  %12lu (%.1f per line)\n"
+            "Frames:               %12lu\n"
+            "Render time (ms):     %12.3f (%.3f per frame, longest %.3f)\n"
+            "Wrap blocks counted:  %12lu (%d left)\n"
+            "Wrap count time (ms): %12.3f (longest at once %.3f)\n",
+            s->lines, s->longLines, s->layoutHits, s->charsScanned,
+            s->lines == 0 ? 0.0 : (double)s->charsScanned / s->lines,
+            s->frames, s->renderTime * 1000.0,
+            s->frames == 0 ? 0.0 : s->renderTime * 1000.0 / s->frames,
+            s->maxFrameTime * 1000.0, s->wrapBlocks, blocksLeft,
+            s->wrapCountTime * 1000.0, s->maxWrapCountTime * 1000.0);
+    return report;
+}
+
+void TextDResetRenderStats(textDisp *textD)
+{
+    memset(&textD->stats, 0, sizeof(renderStats));
+    textD->frameOpen = False;
+}
+
 /*
 ** Determine the drawing method to use to draw a specific character from "buf".
 ** "lineStartPos" gives the character index where the line begins, "lineIndex",
@@ -2988,12 +3614,13 @@ static void drawCursor(textDisp *textD, int x, int y)
 ** Note that style is a somewhat incorrect name, drawing method would
 ** be more appropriate.
 */
-static int styleOfPos(textDisp *textD, int lineStartPos,
+static int styleOfPos(textDisp *textD, ssize_t lineStartPos,
     	int lineLen, int lineIndex, int dispIndex, int thisChar)
 {
     textBuffer *buf = textD->buffer;
-    textBuffer *styleBuf = textD->styleBuffer;
-    int pos, style = 0;
+    styleBuffer *styleBuf = textD->styleBuffer;
+    ssize_t pos;
+    int style = 0;
     
     if (lineStartPos == -1 || buf == NULL)
     	return FILL_MASK;
@@ -3003,11 +3630,11 @@ static int styleOfPos(textDisp *textD, int lineStartPos,
     if (lineIndex >= lineLen)
    	style = FILL_MASK;
     else if (styleBuf != NULL) {
-    	style = (unsigned char)BufGetCharacter(styleBuf, pos);
+    	style = (unsigned char)StyleBufGetCharacter(styleBuf, pos);
     	if (style == textD->unfinishedStyle) {
     	    /* encountered "unfinished" style, trigger parsing */
     	    (textD->unfinishedHighlightCB)(textD, pos, textD->highlightCBArg);
-    	    style = (unsigned char)BufGetCharacter(styleBuf, pos);
+    	    style = (unsigned char)StyleBufGetCharacter(styleBuf, pos);
     	}
     }
     if (inSelection(&buf->primary, pos, lineStartPos, dispIndex))
@@ -3042,6 +3669,12 @@ static int charWidth4(const textDisp* textD, const FcChar32* string,
     int strWidth = 0;
     if(fontList->minWidth == fontList->maxWidth && string[0] < 128) {
         strWidth += fontList->minWidth * length;
+    } else if(length == 1 || string[0] < 128) {
+        /* the expansion of an ASCII character is all ASCII, and the width
+         * of a string is the sum of the widths of its characters */
+        for(int i=0;i<length;i++) {
+            strWidth += FontCharWidth(fontList, string[i]);
+        }
     } else {
         // main font is not a monospace font or character is not ascii
         XftFont *font = FindFont(fontList, string[0]);
@@ -3067,7 +3700,7 @@ static NFont* styleFontList(const textDisp* textD, int style)
 ** Return true if position "pos" with indentation "dispIndex" is in
 ** selection "sel"
 */
-static int inSelection(selection *sel, int pos, int lineStartPos, int dispIndex)
+static int inSelection(selection *sel, ssize_t pos, ssize_t lineStartPos, int dispIndex)
 {
     return sel->selected &&
     	 ((!sel->rectangular &&
@@ -3084,9 +3717,10 @@ static int inSelection(selection *sel, int pos, int lineStartPos, int dispIndex)
 ** position, and CHARACTER_POS means return the position of the character
 ** closest to (x, y).
 */
-static int xyToPos(textDisp *textD, int x, int y, int posType)
+static ssize_t xyToPos(textDisp *textD, int x, int y, int posType)
 {
-    int charIndex, lineStart, lineLen, fontHeight;
+    ssize_t lineStart;
+    int charIndex, lineLen, fontHeight;
     int charWidth, charLen, charStyle, visLineNum, xStep, outIndex, inc;
     FcChar32 expandedChar[MAX_EXP_CHAR_LEN];
     FcChar32 uc = 0;
@@ -3181,10 +3815,10 @@ static void xyToUnconstrainedPos(textDisp *textD, int x, int y, int *row,
 static void offsetLineStarts(textDisp *textD, int newTopLineNum)
 {
     int oldTopLineNum = textD->topLineNum;
-    int oldFirstChar = textD->firstChar;
+    ssize_t oldFirstChar = textD->firstChar;
     int lineDelta = newTopLineNum - oldTopLineNum;
     int nVisLines = textD->nVisibleLines;
-    int *lineStarts = textD->lineStarts;
+    ssize_t *lineStarts = textD->lineStarts;
     int i, lastLineNum;
     textBuffer *buf = textD->buffer;
     
@@ -3204,8 +3838,9 @@ static void offsetLineStarts(textDisp *textD, int newTopLineNum)
        lineStarts array) */
     lastLineNum = oldTopLineNum + nVisLines - 1;
     if (newTopLineNum < oldTopLineNum && newTopLineNum < -lineDelta) {
-    	textD->firstChar = TextDCountForwardNLines(textD, 0, newTopLineNum-1,
-    	    	True);
+    	textD->firstChar = textD->wrapBlocks != NULL ?
+                wrapCountLineStart(textD, newTopLineNum) :
+                TextDCountForwardNLines(textD, 0, newTopLineNum-1, True);
     	/* printf("counting forward %d lines from start\n", newTopLineNum-1);*/
     } else if (newTopLineNum < oldTopLineNum) {
     	textD->firstChar = TextDCountBackwardNLines(textD, textD->firstChar,
@@ -3220,6 +3855,8 @@ static void offsetLineStarts(textDisp *textD, int newTopLineNum)
                 lineStarts[nVisLines-1], newTopLineNum - lastLineNum, True);
     	/* printf("counting forward %d lines from start of last line\n",
     		newTopLineNum - lastLineNum); */
+    } else if (textD->wrapBlocks != NULL) {
+    	textD->firstChar = wrapCountLineStart(textD, newTopLineNum);
     } else {
     	textD->firstChar = TextDCountBackwardNLines(textD, buf->length,
 		textD->nBufferLines - newTopLineNum + 1);
@@ -3260,12 +3897,12 @@ static void offsetLineStarts(textDisp *textD, int newTopLineNum)
 ** position where the change began "pos", and the nmubers of characters
 ** and lines inserted and deleted.
 */
-static void updateLineStarts(textDisp *textD, int pos, int charsInserted,
-	int charsDeleted, int linesInserted, int linesDeleted, int *scrolled)
+static void updateLineStarts(textDisp *textD, ssize_t pos, ssize_t charsInserted,
+	ssize_t charsDeleted, int linesInserted, int linesDeleted, int *scrolled)
 {
-    int *lineStarts = textD->lineStarts;
+    ssize_t *lineStarts = textD->lineStarts;
     int i, lineOfPos, lineOfEnd, nVisLines = textD->nVisibleLines;
-    int charDelta = charsInserted - charsDeleted;
+    ssize_t charDelta = charsInserted - charsDeleted;
     int lineDelta = linesInserted - linesDeleted;
 
     /* {   int i;
@@ -3307,7 +3944,10 @@ static void updateLineStarts(textDisp *textD, int pos, int charsInserted,
     	    if (textD->topLineNum > textD->nBufferLines + lineDelta) {
     	    	textD->topLineNum = 1;
     	    	textD->firstChar = 0;
-    	    } else
+    	    } else if (textD->wrapBlocks != NULL)
+    		textD->firstChar = wrapCountLineStart(textD,
+                        textD->topLineNum);
+    	    else
     		textD->firstChar = TextDCountForwardNLines(textD, 0,
     	    		textD->topLineNum - 1, True);
     	}
@@ -3394,9 +4034,10 @@ static void updateLineStarts(textDisp *textD, int pos, int charsInserted,
 */
 static void calcLineStarts(textDisp *textD, int startLine, int endLine)
 {
-    int startPos, bufLen = textD->buffer->length;
-    int line, lineEnd, nextLineStart, nVis = textD->nVisibleLines;
-    int *lineStarts = textD->lineStarts;
+    ssize_t startPos, bufLen = textD->buffer->length;
+    ssize_t lineEnd, nextLineStart;
+    int line, nVis = textD->nVisibleLines;
+    ssize_t *lineStarts = textD->lineStarts;
     
     /* Clean up (possibly) messy input parameters */
     if (nVis == 0) return;
@@ -3513,11 +4154,13 @@ static void setScroll(textDisp *textD, int topLineNum, int horizOffset,
         int updateVScrollBar, int updateHScrollBar)
 {
     int fontHeight = textD->ascent + textD->descent;
+    int charWidth = textD->font->maxWidth;
     int origHOffset = textD->horizOffset;
     int lineDelta = textD->topLineNum - topLineNum;
     int xOffset, yOffset, srcX, srcY, dstX, dstY, width, height;
     int exactHeight = textD->height - textD->height %
             (textD->ascent + textD->descent);
+    ssize_t left, right;
     
     /* Do nothing if scroll position hasn't actually changed or there's no
        window to draw in yet */
@@ -3525,6 +4168,10 @@ static void setScroll(textDisp *textD, int topLineNum, int horizOffset,
             textD->topLineNum == topLineNum))
         return;
     
+    /* Draw only into the back buffer, and copy the result to the window
+       in one piece at the end */
+    textD->holdPresent++;
+    
     /* If part of the cursor is protruding beyond the text clipping region,
        clear it off */
     blankCursorProtrusions(textD);
@@ -3546,33 +4193,26 @@ static void setScroll(textDisp *textD, int topLineNum, int horizOffset,
         updateHScrollBarRange(textD);
     }
     
-    /* Redisplay everything if the window is partially obscured (since
-       it's too hard to tell what displayed areas are salvageable) or
-       if there's nothing to recover because the scroll distance is large */
+    /* Redisplay everything if there's nothing to recover because the
+       scroll distance is large */
     xOffset = origHOffset - textD->horizOffset;
     yOffset = lineDelta * fontHeight;
-    //if (textD->visibility != VisibilityUnobscured ||
-    //        abs(xOffset) > textD->width || abs(yOffset) > exactHeight) {
-    if(1) {
-        // WORKAROUND for hscroll bug with new xft rendering
-        // the code with XCopyArea doesn't work, so we always redisplay
-        TextDTranlateGraphicExposeQueue(textD, xOffset, yOffset, False);
+    TextDTranlateGraphicExposeQueue(textD, xOffset, yOffset, False);
+    if (abs(xOffset) >= textD->width || abs(yOffset) >= exactHeight) {
         TextDRedisplayRect(textD, textD->left, textD->top, textD->width,
                 textD->height);
     } else {
-        /* If the window is not obscured, paint most of the window using XCopyArea
-           from existing displayed text, and redraw only what's necessary */
-        /* Recover the useable window areas by moving to the proper location */
+        /* Move the text which is still visible to its new location in the
+           back buffer.  Unlike copying within the window, this works the
+           same whether or not the window is obscured */
         srcX = textD->left + (xOffset >= 0 ? 0 : -xOffset);
         dstX = textD->left + (xOffset >= 0 ? xOffset : 0);
         width = textD->width - abs(xOffset);
         srcY = textD->top + (yOffset >= 0 ? 0 : -yOffset);
         dstY = textD->top + (yOffset >= 0 ? yOffset : 0);
         height = exactHeight - abs(yOffset);
-        resetClipRectangles(textD);
-        TextDTranlateGraphicExposeQueue(textD, xOffset, yOffset, True);
-        XCopyArea(XtDisplay(textD->w), XtWindow(textD->w), XtWindow(textD->w),
-                textD->gc, srcX, srcY, width, height, dstX, dstY);
+        XCopyArea(XtDisplay(textD->w), textD->backBuffer, textD->backBuffer,
+                textD->backBufferGC, srcX, srcY, width, height, dstX, dstY);
         /* redraw the un-recoverable parts */
         if (yOffset > 0) {
             TextDRedisplayRect(textD, textD->left, textD->top,
@@ -3580,26 +4220,34 @@ static void setScroll(textDisp *textD, int topLineNum, int horizOffset,
         }
         else if (yOffset < 0) {
             TextDRedisplayRect(textD, textD->left, textD->top +
-                    textD->height + yOffset, textD->width, -yOffset);
+                    exactHeight + yOffset, textD->width, -yOffset);
         }
+        /* A character can straddle the edge of the newly exposed columns,
+           so redraw one character further into the moved text, as for
+           fixLeftClipAfterResize */
         if (xOffset > 0) {
             TextDRedisplayRect(textD, textD->left, textD->top,
-                    xOffset, textD->height);
+                    xOffset + charWidth, exactHeight);
         }
         else if (xOffset < 0) {
-            TextDRedisplayRect(textD, textD->left + textD->width + xOffset,
-                    textD->top, -xOffset, textD->height);
+            TextDRedisplayRect(textD, textD->left + textD->width + xOffset -
+                    charWidth, textD->top, charWidth - xOffset, exactHeight);
         }
         /* Restore protruding parts of the cursor */
-        int left, right;
         TextDCursorLR(textD, &left, &right);
         textDRedisplayRange(textD, left, right);
     }
     
-    /* Refresh line number/calltip display if its up and we've scrolled 
+    /* Refresh line number display if its up and we've scrolled 
         vertically */
     if (lineDelta != 0) {
         redrawLineNumbers(textD, textD->top, textD->height, True);
+    }
+    
+    textD->holdPresent--;
+    presentRect(textD, 0, 0, textD->backBufferWidth, textD->backBufferHeight);
+    
+    if (lineDelta != 0) {
         TextDRedrawCalltip(textD, 0);
     }
 
@@ -3686,10 +4334,14 @@ void TextDSetLineNumberArea(textDisp *textD, int lineNumLeft, int lineNumWidth,
     textD->lineNumLeft = lineNumLeft;
     textD->lineNumWidth = lineNumWidth;
     textD->left = textLeft;
-    XClearWindow(XtDisplay(textD->w), XtWindow(textD->w));
+    textD->holdPresent++;
+    fillBackground(textD, 0, 0, textD->backBufferWidth,
+            textD->backBufferHeight);
     resetAbsLineNum(textD);
     TextDResize(textD, newWidth, textD->height);
     TextDRedisplayRect(textD, 0, textD->top, INT_MAX, textD->height);
+    textD->holdPresent--;
+    presentRect(textD, 0, 0, textD->backBufferWidth, textD->backBufferHeight);
 }
 
 /*
@@ -3700,7 +4352,8 @@ void TextDSetLineNumberArea(textDisp *textD, int lineNumLeft, int lineNumWidth,
 */
 static void redrawLineNumbers(textDisp *textD, int top, int height, int clearAll)
 {
-    int y, line, visLine, nCols, lineStart;
+    int y, line, visLine, nCols;
+    ssize_t lineStart;
     char lineNumString[12];
     int lineHeight = textD->ascent + textD->descent;
     int charWidth = textD->font->maxWidth;
@@ -3766,6 +4419,8 @@ static void redrawLineNumbers(textDisp *textD, int top, int height, int clearAll
         }
         y += lineHeight;
     }
+    presentRect(textD, 0, 0, textD->lineNumLeft + textD->lineNumWidth,
+            2*top + height);
 }
 
 /*
@@ -3800,12 +4455,12 @@ static void visibilityEH(Widget w, XtPointer data, XEvent *event,
     ((textDisp *)data)->visibility = ((XVisibilityEvent *)event)->state;
 }
 
-static int max(int i1, int i2)
+static ssize_t max(ssize_t i1, ssize_t i2)
 {
     return i1 >= i2 ? i1 : i2;
 }
 
-static int min(int i1, int i2)
+static ssize_t min(ssize_t i1, ssize_t i2)
 {
     return i1 <= i2 ? i1 : i2;
 }
@@ -3832,7 +4487,7 @@ static int measureVisLine(textDisp *textD, int visLineNum)
 {
     textBuffer *buf = textD->buffer;
     int i, width = 0, style, lineLen = visLineLength(textD, visLineNum);
-    int lineStartPos = textD->lineStarts[visLineNum];
+    ssize_t lineStartPos = textD->lineStarts[visLineNum];
     char *free_lineStr;
     const char *lineStr = BufGetRange2(buf, lineStartPos, lineStartPos + lineLen, &free_lineStr);
     FcChar32 expandedChar[MAX_EXP_CHAR_LEN];
@@ -3857,7 +4512,7 @@ static int measureVisLine(textDisp *textD, int visLineNum)
         }
         
         if (textD->styleBuffer) {
-            style = (unsigned char)BufGetCharacter(textD->styleBuffer,
+            style = (unsigned char)StyleBufGetCharacter(textD->styleBuffer,
 		    lineStartPos+i) - ASCII_A;
             font = textD->styleTable[style].font;
         } else {
@@ -3902,8 +4557,8 @@ static void blankSingleCursorProtrusions(textDisp *textD)
     } else
         return;
     
-    XClearArea(XtDisplay(textD->w), XtWindow(textD->w), x, cursorY,
-            width, fontHeight, False);
+    fillBackground(textD, x, cursorY, width, fontHeight);
+    presentRect(textD, x, cursorY, width, fontHeight);
 }
 
 static void blankCursorProtrusions(textDisp *textD) {
@@ -4001,7 +4656,7 @@ static void resetClipRectangles(textDisp *textD)
 */
 static int visLineLength(textDisp *textD, int visLineNum)
 {
-    int nextLineStart, lineStartPos = textD->lineStarts[visLineNum];
+    ssize_t nextLineStart, lineStartPos = textD->lineStarts[visLineNum];
     
     if (lineStartPos == -1)
     	return 0;
@@ -4024,15 +4679,17 @@ static int visLineLength(textDisp *textD, int visLineNum)
 ** both for delimiting where the line starts need to be recalculated, and
 ** for deciding what part of the text to redisplay.
 */
-static int findWrapRange(textDisp *textD, const char *deletedText, int pos,
-    	int nInserted, int nDeleted, int *modRangeStart, int *modRangeEnd,
-    	int *linesInserted, int *linesDeleted)
+static int findWrapRange(textDisp *textD, const char *deletedText, ssize_t pos,
+    	ssize_t nInserted, ssize_t nDeleted, ssize_t *modRangeStart,
+    	ssize_t *modRangeEnd, int *linesInserted, int *linesDeleted)
 {
-    int length, retPos, retLines, retLineStart, retLineEnd;
+    ssize_t length, retPos, retLineStart, retLineEnd;
+    int retLines;
     textBuffer *deletedTextBuf, *buf = textD->buffer;
     int nVisLines = textD->nVisibleLines;
-    int *lineStarts = textD->lineStarts;
-    int countFrom, countTo, lineStart, adjLineStart, i;
+    ssize_t *lineStarts = textD->lineStarts;
+    ssize_t countFrom, countTo, lineStart, adjLineStart;
+    int i;
     int visLineNum = 0, nLines = 0;
     int nl = 0;
     
@@ -4188,13 +4845,14 @@ static int findWrapRange(textDisp *textD, const char *deletedText, int pos,
 ** can still perform the calculation afterwards (possibly even more
 ** efficiently).
 */
-static void measureDeletedLines(textDisp *textD, int pos, int nDeleted)
+static void measureDeletedLines(textDisp *textD, ssize_t pos, ssize_t nDeleted)
 {
-    int retPos, retLines, retLineStart, retLineEnd;
+    ssize_t retPos, retLineStart, retLineEnd;
+    int retLines;
     textBuffer *buf = textD->buffer;
     int nVisLines = textD->nVisibleLines;
-    int *lineStarts = textD->lineStarts;
-    int countFrom, lineStart;
+    ssize_t *lineStarts = textD->lineStarts;
+    ssize_t countFrom, lineStart;
     int nLines = 0, i;
     /*
     ** Determine where to begin searching: either the previous newline, or
@@ -4252,6 +4910,275 @@ static void measureDeletedLines(textDisp *textD, int pos, int nDeleted)
     textD->suppressResync = 1;
 }
 
+/*
+** In continuous wrap mode, re-count the lines of the whole buffer, which
+** change with the width of the window, the wrap margin and the fonts.  The
+** buffer is divided into blocks at line starts about WRAP_BLOCK_SIZE
+** characters apart, and since wrapping starts over at each line start, the
+** number of lines of the buffer is the sum of those of the blocks.  Blocks are
+** counted now for up to WRAP_COUNT_TIME seconds, and the rest when the
+** application is idle.  Until then, topLineNum and nBufferLines (and so the
+** scroll bar) use an estimate for each block not yet counted, from the number
+** of lines per character of the blocks that have been.  Later changes to the
+** text adjust the counts of just the blocks they touch (see updateWrapCount).
+*/
+static void startWrapCount(textDisp *textD)
+{
+    if (textD->wrapCountProc != 0)
+        XtRemoveWorkProc(textD->wrapCountProc);
+    textD->wrapCountProc = 0;
+    textD->wrapCountWrapped = False;
+    
+    if (textD->wrapBlocksAlloc == 0) {
+        textD->wrapBlocksAlloc = 1;
+        textD->wrapBlocks = (wrapBlock *)NEditMalloc(sizeof(wrapBlock));
+    }
+    textD->nWrapBlocks = 1;
+    textD->wrapBlocks[0].start = 0;
+    textD->wrapBlocks[0].lines = -1;
+    splitWrapBlock(textD, 0);
+    
+    if (!wrapCountWorkProc(textD))
+        textD->wrapCountProc = XtAppAddWorkProc(
+                XtWidgetToApplicationContext(textD->w), wrapCountWorkProc,
+                textD);
+}
+
+static void freeWrapCount(textDisp *textD)
+{
+    if (textD->wrapCountProc != 0)
+        XtRemoveWorkProc(textD->wrapCountProc);
+    textD->wrapCountProc = 0;
+    NEditFree(textD->wrapBlocks);
+    textD->wrapBlocks = NULL;
+    textD->nWrapBlocks = textD->wrapBlocksAlloc = 0;
+}
+
+/*
+** Divide block "block", which has not been counted yet, into blocks of about
+** WRAP_BLOCK_SIZE characters.  Blocks merged by changes to the text can be
+** much larger.
+*/
+static void splitWrapBlock(textDisp *textD, int block)
+{
+    ssize_t pos, end, *starts = NULL;
+    int i, nStarts = 0, nAlloc = 0;
+    
+    end = block+1 < textD->nWrapBlocks ? textD->wrapBlocks[block+1].start :
+            textD->buffer->length;
+    for (pos = textD->wrapBlocks[block].start;
+            pos + WRAP_BLOCK_SIZE < end; nStarts++) {
+        pos = BufEndOfLine(textD->buffer, pos + WRAP_BLOCK_SIZE) + 1;
+        if (pos >= end)
+            break;
+        if (nStarts == nAlloc) {
+            nAlloc = nAlloc == 0 ? 64 : nAlloc * 2;
+            starts = (ssize_t *)NEditRealloc(starts, sizeof(ssize_t) * nAlloc);
+        }
+        starts[nStarts] = pos;
+    }
+    if (nStarts == 0)
+        return;
+    
+    if (textD->nWrapBlocks + nStarts > textD->wrapBlocksAlloc) {
+        textD->wrapBlocksAlloc = max(textD->wrapBlocksAlloc * 2,
+                textD->nWrapBlocks + nStarts);
+        textD->wrapBlocks = (wrapBlock *)NEditRealloc(textD->wrapBlocks,
+                sizeof(wrapBlock) * textD->wrapBlocksAlloc);
+    }
+    memmove(&textD->wrapBlocks[block+1+nStarts], &textD->wrapBlocks[block+1],
+            sizeof(wrapBlock) * (textD->nWrapBlocks - block - 1));
+    for (i=0; i<nStarts; i++) {
+        textD->wrapBlocks[block+1+i].start = starts[i];
+        textD->wrapBlocks[block+1+i].lines = -1;
+    }
+    textD->nWrapBlocks += nStarts;
+    NEditFree(starts);
+}
+
+/*
+** Count blocks of lines for startWrapCount, for up to WRAP_COUNT_TIME
+** seconds, and update the display's line counts.  Returns True when all of
+** the blocks have been counted.
+*/
+static Boolean wrapCountWorkProc(XtPointer clientData)
+{
+    textDisp *textD = (textDisp *)clientData;
+    wrapBlock *block;
+    ssize_t end, retPos, retLineStart, retLineEnd;
+    double countTime, startTime = renderClock();
+    Boolean wrapped, done = True;
+    int i;
+    
+    for (i=0; i<textD->nWrapBlocks; i++) {
+        block = &textD->wrapBlocks[i];
+        if (block->lines != -1)
+            continue;
+        if (renderClock() - startTime > WRAP_COUNT_TIME) {
+            done = False;
+            break;
+        }
+        splitWrapBlock(textD, i);
+        block = &textD->wrapBlocks[i];
+        end = i+1 < textD->nWrapBlocks ? block[1].start :
+                textD->buffer->length;
+        wrappedLineCounter(textD, textD->buffer, block->start, end, INT_MAX,
+                True, 0, &retPos, &block->lines, &retLineStart, &retLineEnd,
+                &wrapped);
+        textD->wrapCountWrapped |= wrapped;
+        textD->stats.wrapBlocks++;
+    }
+    
+    countTime = renderClock() - startTime;
+    textD->stats.wrapCountTime += countTime;
+    textD->stats.maxWrapCountTime = max(textD->stats.maxWrapCountTime,
+            countTime);
+    syncWrapTotals(textD);
+    if (!done)
+        return False;
+    
+    /* Growing the window can't make lines wrap that didn't wrap before */
+    if (!textD->wrapCountWrapped) {
+        textD->cacheNoWrapping = True;
+        textD->cacheNoWrappingWidth = textD->width;
+    }
+    textD->wrapCountProc = 0;
+    return True;
+}
+
+/*
+** Return the index of the block of lines containing position "pos"
+*/
+static int findWrapBlock(const textDisp *textD, ssize_t pos)
+{
+    int lo = 0, hi = textD->nWrapBlocks - 1, mid;
+    
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if (textD->wrapBlocks[mid].start <= pos)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+/*
+** Return the number of lines of block "block", or if it hasn't been counted
+** yet, an estimate from "ratio" lines per character
+*/
+static int wrapBlockLines(const textDisp *textD, int block, double ratio)
+{
+    ssize_t end;
+    
+    if (textD->wrapBlocks[block].lines != -1)
+        return textD->wrapBlocks[block].lines;
+    end = block+1 < textD->nWrapBlocks ? textD->wrapBlocks[block+1].start :
+            textD->buffer->length;
+    return (int)((end - textD->wrapBlocks[block].start) * ratio + 0.5);
+}
+
+/*
+** Return the number of lines per character of the blocks counted so far
+*/
+static double wrapLinesPerChar(const textDisp *textD)
+{
+    ssize_t chars = 0, end;
+    double lines = 0;
+    int i;
+    
+    for (i=0; i<textD->nWrapBlocks; i++) {
+        if (textD->wrapBlocks[i].lines == -1)
+            continue;
+        end = i+1 < textD->nWrapBlocks ? textD->wrapBlocks[i+1].start :
+                textD->buffer->length;
+        chars += end - textD->wrapBlocks[i].start;
+        lines += textD->wrapBlocks[i].lines;
+    }
+    return chars == 0 ? 0.0 : lines / chars;
+}
+
+/*
+** Set topLineNum and nBufferLines from the counts of the blocks, and update
+** the vertical scroll bar to match
+*/
+static void syncWrapTotals(textDisp *textD)
+{
+    double ratio = wrapLinesPerChar(textD);
+    int i, lines = 0, topBlock = findWrapBlock(textD, textD->firstChar);
+    
+    for (i=0; i<topBlock; i++)
+        lines += wrapBlockLines(textD, i, ratio);
+    textD->topLineNum = lines + TextDCountLinesW(textD,
+            textD->wrapBlocks[topBlock].start, textD->firstChar, True,
+            NULL) + 1;
+    for (; i<textD->nWrapBlocks; i++)
+        lines += wrapBlockLines(textD, i, ratio);
+    textD->nBufferLines = lines;
+    updateVScrollBarRange(textD);
+}
+
+/*
+** Update the line counts of the blocks after a change to the text.  "pos",
+** "nInserted" and "nDeleted" describe the change, and "modStart", "modEnd"
+** and "lineDelta" the range over which wrapping was affected (in the new
+** text) and the resulting change in the number of lines, as found by
+** findWrapRange.  The blocks overlapping the range are merged, because the
+** line start at which a block begins may have gone; their count stays exact
+** if they had all been counted.
+*/
+static void updateWrapCount(textDisp *textD, ssize_t pos, ssize_t nInserted,
+        ssize_t nDeleted, ssize_t modStart, ssize_t modEnd, int lineDelta)
+{
+    wrapBlock *blocks = textD->wrapBlocks;
+    ssize_t oldModEnd = modEnd - nInserted + nDeleted;
+    int i, first, last, lines;
+    
+    if (blocks == NULL)
+        return;
+    
+    /* A block can stay separate if the line start where it begins, and the
+       newline before it, are beyond both the change and its effect on
+       wrapping */
+    first = findWrapBlock(textD, modStart);
+    lines = blocks[first].lines;
+    for (last=first+1; last<textD->nWrapBlocks; last++) {
+        if (blocks[last].start > pos + nDeleted &&
+                blocks[last].start >= oldModEnd)
+            break;
+        lines = lines == -1 || blocks[last].lines == -1 ? -1 :
+                lines + blocks[last].lines;
+    }
+    blocks[first].lines = lines == -1 ? -1 : max(0, lines + lineDelta);
+    
+    memmove(&blocks[first+1], &blocks[last],
+            sizeof(wrapBlock) * (textD->nWrapBlocks - last));
+    textD->nWrapBlocks -= last - first - 1;
+    for (i=first+1; i<textD->nWrapBlocks; i++)
+        blocks[i].start += nInserted - nDeleted;
+}
+
+/*
+** Find the start of line "lineNum" (the first line being 1), starting from
+** the nearest block of lines.  If blocks before it have not been counted yet,
+** this is the line whose number is estimated to be "lineNum", consistent
+** with topLineNum.
+*/
+static ssize_t wrapCountLineStart(textDisp *textD, int lineNum)
+{
+    double ratio = wrapLinesPerChar(textD);
+    int i, lines, toSkip = lineNum - 1;
+    
+    for (i=0; i<textD->nWrapBlocks-1; i++) {
+        lines = wrapBlockLines(textD, i, ratio);
+        if (toSkip < lines)
+            break;
+        toSkip -= lines;
+    }
+    return TextDCountForwardNLines(textD, textD->wrapBlocks[i].start,
+            max(0, toSkip), True);
+}
+
 /*
 ** Count forward from startPos to either maxPos or maxLines (whichever is
 ** reached first), and return all relevant positions and line count.
@@ -4271,13 +5198,14 @@ static void measureDeletedLines(textDisp *textD, int pos, int nDeleted)
 **   retWrap        Was any line wrapped
 */
 static void wrappedLineCounter(const textDisp* textD, const textBuffer* buf,
-        int startPos, int maxPos, int maxLines,
-        Boolean startPosIsLineStart, int styleBufOffset,
-        int* retPos, int* retLines, int* retLineStart, int* retLineEnd,
-        Boolean *retWrap)
+        ssize_t startPos, ssize_t maxPos, int maxLines,
+        Boolean startPosIsLineStart, ssize_t styleBufOffset,
+        ssize_t* retPos, int* retLines, ssize_t* retLineStart,
+        ssize_t* retLineEnd, Boolean *retWrap)
 {
-    int lineStart, newLineStart = 0, b, p, colNum, wrapMargin;
-    int maxWidth, width, countPixels, i, foundBreak;
+    ssize_t lineStart, newLineStart = 0, b, p, i;
+    int colNum, wrapMargin;
+    int maxWidth, width, countPixels, foundBreak;
     int nLines = 0, tabDist = textD->buffer->tabDist;
     FcChar32 c;
     char nullSubsChar = textD->buffer->nullSubsChar;
@@ -4424,18 +5352,18 @@ static void wrappedLineCounter(const textDisp* textD, const textBuffer* buf,
 ** should now be solid because they are now used for online help display.
 */
 static int measurePropChar(const textDisp* textD, FcChar32 c,
-    int colNum, int pos)
+    int colNum, ssize_t pos)
 {
     int style;
-    textBuffer *styleBuf = textD->styleBuffer;
+    styleBuffer *styleBuf = textD->styleBuffer;
     
     NFont *font = NULL;
     if (styleBuf) {
-	style = (unsigned char)BufGetCharacter(styleBuf, pos);
+	style = (unsigned char)StyleBufGetCharacter(styleBuf, pos);
 	if (style == textD->unfinishedStyle) {
     	    /* encountered "unfinished" style, trigger parsing */
     	    (textD->unfinishedHighlightCB)(textD, pos, textD->highlightCBArg);
-    	    style = (unsigned char)BufGetCharacter(styleBuf, pos);
+    	    style = (unsigned char)StyleBufGetCharacter(styleBuf, pos);
 	}
         if (style & STYLE_LOOKUP_MASK) {
             font = textD->styleTable[(style & STYLE_LOOKUP_MASK) - ASCII_A].font;
@@ -4454,9 +5382,11 @@ static int measurePropChar(const textDisp* textD, FcChar32 c,
         if(font->minWidth == font->maxWidth) {
             return font->minWidth;
         } else {
-            XGlyphInfo extents;
-            XftTextExtents32(XtDisplay(textD->w), font->fonts->font, expChar, charLen, &extents);
-            return extents.xOff;
+            int width = 0;
+            for(int i=0;i<charLen;i++) {
+                width += FontCharWidth(font, expChar[i]);
+            }
+            return width;
         }
     } else {
         charLen = 1;
@@ -4476,10 +5406,11 @@ static int measurePropChar(const textDisp* textD, FcChar32 c,
 ** normal character, and to find that out would otherwise require counting all
 ** the way back to the beginning of the line.
 */
-static void findLineEnd(textDisp *textD, int startPos, int startPosIsLineStart,
-    	int *lineEnd, int *nextLineStart)
+static void findLineEnd(textDisp *textD, ssize_t startPos, int startPosIsLineStart,
+    	ssize_t *lineEnd, ssize_t *nextLineStart)
 {
-    int retLines, retLineStart;
+    int retLines;
+    ssize_t retLineStart;
     
     /* if we're not wrapping use more efficient BufEndOfLine */
     if (!textD->continuousWrap) {
@@ -4511,7 +5442,7 @@ static void findLineEnd(textDisp *textD, int startPos, int startPosIsLineStart,
 ** used as a wrap point, and just guesses that it wasn't.  So if an exact
 ** accounting is necessary, don't use this function.
 */ 
-static int wrapUsesCharacter(textDisp *textD, int lineEndPos)
+static int wrapUsesCharacter(textDisp *textD, ssize_t lineEndPos)
 {
     char c;
     
@@ -4544,7 +5475,7 @@ static void hideOrShowHScrollBar(textDisp *textD)
 ** Return true if the selection "sel" is rectangular, and touches a
 ** buffer position withing "rangeStart" to "rangeEnd"
 */
-static int rangeTouchesRectSel(selection *sel, int rangeStart, int rangeEnd)
+static int rangeTouchesRectSel(selection *sel, ssize_t rangeStart, ssize_t rangeEnd)
 {
     return sel->selected && sel->rectangular && sel->end >= rangeStart &&
     	    sel->start <= rangeEnd;
@@ -4555,7 +5486,7 @@ static int rangeTouchesRectSel(selection *sel, int rangeStart, int rangeEnd)
 ** redraw requests resulting from changes to the attached style buffer (which
 ** contains auxiliary information for coloring or styling text).
 */
-static void extendRangeForStyleMods(textDisp *textD, int *start, int *end)
+static void extendRangeForStyleMods(textDisp *textD, ssize_t *start, ssize_t *end)
 {
     selection *sel = &textD->styleBuffer->primary;
     int extended = False;
@@ -4756,6 +5687,7 @@ void TextDSetHighlightCursorLine(textDisp *textD, Boolean state)
 void TextDSetIndentRainbow(textDisp *textD, Boolean indentRainbow)
 {
     textD->indentRainbow = indentRainbow;
+    invalidateLayouts(textD, 0);
 }
 
 
@@ -5004,6 +5936,7 @@ NFont *FontCreate(Display *dp, FcPattern *pattern)
     font->fail = NULL;
     font->size = sz;
     font->ref = 1;
+    font->glyphs = NULL;
 
     NFontList *list = NEditMalloc(sizeof(NFontList));
     list->font = defaultFont;
@@ -5092,12 +6025,137 @@ XftFont *FontListAddFontForChar(NFont *f, FcChar32 c)
     return newFont;
 }
 
+/*
+** Return the cache entry for character "c" of font "f", adding an empty entry
+** if there is none.  The pointer is only good until the next lookup.
+*/
+static glyphEntry *lookupGlyph(NFont *f, FcChar32 c)
+{
+    NGlyphCache *cache = f->glyphs;
+    glyphEntry **page;
+    glyphHashEntry *hash;
+    int i, oldSize;
+    
+    if(!cache) {
+        cache = f->glyphs = NEditCalloc(1, sizeof(NGlyphCache));
+    }
+    
+    if(c < GLYPH_BMP_SIZE) {
+        page = &cache->pages[c >> GLYPH_PAGE_BITS];
+        if(!*page) {
+            *page = NEditMalloc(GLYPH_PAGE_SIZE * sizeof(glyphEntry));
+            for(i=0;i<GLYPH_PAGE_SIZE;i++) {
+                (*page)[i].font = NULL;
+                (*page)[i].advance = -1;
+                (*page)[i].hasIndex = False;
+            }
+        }
+        return &(*page)[c & (GLYPH_PAGE_SIZE - 1)];
+    }
+    
+    /* grow the hash table when it is half full */
+    if(cache->hashCount >= cache->hashSize / 2) {
+        hash = cache->hash;
+        oldSize = cache->hashSize;
+        cache->hashSize = oldSize == 0 ? 64 : oldSize * 2;
+        cache->hash = NEditCalloc(cache->hashSize, sizeof(glyphHashEntry));
+        cache->hashCount = 0;
+        for(i=0;i<oldSize;i++) {
+            if(hash[i].c != 0) {
+                *lookupGlyph(f, hash[i].c) = hash[i].glyph;
+            }
+        }
+        NEditFree(hash);
+    }
+    
+    i = (c * 2654435761u) & (cache->hashSize - 1);
+    while(cache->hash[i].c != c) {
+        if(cache->hash[i].c == 0) {
+            cache->hash[i].c = c;
+            cache->hash[i].glyph.font = NULL;
+            cache->hash[i].glyph.advance = -1;
+            cache->hash[i].glyph.hasIndex = False;
+            cache->hashCount++;
+            break;
+        }
+        i = (i + 1) & (cache->hashSize - 1);
+    }
+    return &cache->hash[i].glyph;
+}
+
+static void freeGlyphCache(NGlyphCache *cache)
+{
+    if(!cache) {
+        return;
+    }
+    for(int i=0;i<GLYPH_BMP_SIZE/GLYPH_PAGE_SIZE;i++) {
+        NEditFree(cache->pages[i]);
+    }
+    NEditFree(cache->hash);
+    NEditFree(cache);
+}
+
 XftFont *FindFont(NFont *f, FcChar32 c)
 {
     if(c < 128) {
         return f->fonts->font;
     }
     
+    /* The font found for a character never changes: fonts are only ever
+     * added to the end of the list, and characters with no font stay in
+     * the fail list */
+    glyphEntry *glyph = lookupGlyph(f, c);
+    if(!glyph->font) {
+        glyph->font = findFontUncached(f, c);
+    }
+    return glyph->font;
+}
+
+/*
+** Return the width of character "c" in font "f", with the fallback font
+** FindFont chooses for it
+*/
+int FontCharWidth(NFont *f, FcChar32 c)
+{
+    XGlyphInfo extents;
+    
+    if(c < 128 && f->minWidth == f->maxWidth) {
+        return f->minWidth;
+    }
+    
+    glyphEntry *glyph = lookupGlyph(f, c);
+    if(glyph->advance < 0) {
+        if(!glyph->font) {
+            glyph->font = c < 128 ? f->fonts->font : findFontUncached(f, c);
+        }
+        XftTextExtents32(f->display, glyph->font, &c, 1, &extents);
+        glyph->advance = extents.xOff;
+    }
+    return glyph->advance;
+}
+
+/*
+** Return the glyph of character "c" in "font".  Normally "font" is the font
+** FindFont chooses for "c" from "f", and the glyph is cached along with it.
+*/
+static FT_UInt fontGlyphIndex(NFont *f, XftFont *font, FcChar32 c)
+{
+    glyphEntry *glyph = lookupGlyph(f, c);
+    if(!glyph->font) {
+        glyph->font = c < 128 ? f->fonts->font : findFontUncached(f, c);
+    }
+    if(glyph->font != font) {
+        return XftCharIndex(f->display, font, c);
+    }
+    if(!glyph->hasIndex) {
+        glyph->index = XftCharIndex(f->display, font, c);
+        glyph->hasIndex = True;
+    }
+    return glyph->index;
+}
+
+static XftFont *findFontUncached(NFont *f, FcChar32 c)
+{
     /* make sure the char is not in the fail list, because we don't
      * want to retry font lookups */
     NCharSetList *fail = f->fail;
@@ -5147,6 +6205,8 @@ void FontAddFail(NFont *f, FcCharSet *c)
 
 void FontDestroy(NFont *f)
 {
+    freeGlyphCache(f->glyphs);
+    
     NCharSetList *c = f->fail;
     NCharSetList *nc;
     while(c) {
@@ -28,6 +28,7 @@
 #define NEDIT_TEXTDISP_H_INCLUDED
 
 #include "textBuf.h"
+#include "styleBuf.h"
 
 #include <X11/Intrinsic.h>
 #include <X11/Xlib.h>
@@ -47,6 +48,7 @@ typedef struct _textDisp textDisp;
 typedef struct NFont NFont;
 typedef struct NFontList NFontList;
 typedef struct NCharSetList NCharSetList;
+typedef struct NGlyphCache NGlyphCache;
 struct NFontList {
     XftFont *font;
     NFontList *next;
@@ -66,6 +68,8 @@ struct NFont {
     int minWidth;
     int maxWidth;
     unsigned int ref;
+    NGlyphCache *glyphs;    /* font and width of each character looked up so
+                               far (see FindFont and FontCharWidth) */
 };
 
 typedef struct {
@@ -100,23 +104,50 @@ typedef struct ansiStyle {
     short bg_b;
 } ansiStyle;
 
-typedef void (*unfinishedStyleCBProc)(const textDisp *textD, int pos, const void *highlightCBArg);
+typedef void (*unfinishedStyleCBProc)(const textDisp *textD, ssize_t pos, const void *highlightCBArg);
 
 typedef struct _calltipStruct {
     int ID;                 /* ID of displayed calltip.  Equals
                               zero if none is displayed. */
     Boolean anchored;       /* Is it anchored to a position */
-    int pos;                /* Position tip is anchored to */
+    ssize_t pos;            /* Position tip is anchored to */
     int hAlign;             /* horizontal alignment */
     int vAlign;             /* vertical alignment */
     int alignMode;          /* Strict or sloppy alignment */
 } calltipStruct;
 
+/* Where to start drawing the visible part of long lines (see textDisp.c) */
+typedef struct _lineLayout lineLayout;
+
+/* Count of the wrapped lines of a block of the buffer (see textDisp.c) */
+typedef struct _wrapBlock {
+    ssize_t start;			/* first character, which starts a line */
+    int lines;				/* line breaks in the block, or -1 if not
+    					   counted yet */
+} wrapBlock;
+
+/* Counts of the work done to draw the text (see TextDRenderStatsReport) */
+typedef struct _renderStats {
+    unsigned long lines;		/* lines drawn, whole or in part */
+    unsigned long longLines;		/* lines long enough to use layoutCache */
+    unsigned long layoutHits;		/* long lines started from a checkpoint */
+    unsigned long charsScanned;		/* characters measured to find the
+    					   first one to draw */
+    unsigned long frames;		/* batches of events that drew lines */
+    double renderTime;			/* seconds spent drawing lines */
+    double frameTime;			/* drawing time of the current frame */
+    double maxFrameTime;		/* longest drawing time of any frame */
+    unsigned long wrapBlocks;		/* blocks of lines counted for
+    					   continuous wrap (startWrapCount) */
+    double wrapCountTime;		/* seconds spent counting them */
+    double maxWrapCountTime;		/* longest time counting at once */
+} renderStats;
+
 typedef struct _textCursor {
-    int cursorPos;
-    int cursorPosCache;
-    int cursorPosCacheLeft;
-    int cursorPosCacheRight;
+    ssize_t cursorPos;
+    ssize_t cursorPosCache;
+    ssize_t cursorPosCacheLeft;
+    ssize_t cursorPosCacheRight;
     int cursorPreferredCol;
     int x;                 /* X, Y pos. of last drawn cursor 
                               Note: these are used for *drawing*
@@ -128,7 +159,15 @@ typedef struct _textCursor {
 
 struct _textDisp {
     Widget w;
-    XftDraw *d;
+    XftDraw *d;				/* draws to backBuffer */
+    Pixmap backBuffer;			/* off-screen copy of the window, which
+    					   all drawing goes to before being
+    					   copied to the window */
+    int backBufferWidth, backBufferHeight;
+    GC backBufferGC;			/* unshared GC for filling and copying
+    					   the back buffer */
+    int holdPresent;			/* Don't copy the back buffer to the
+    					   window until this drops to zero */
     int top, left, width, height, lineNumLeft, lineNumWidth;
     textCursor *cursor;
     textCursor *newcursor;
@@ -137,7 +176,7 @@ struct _textDisp {
     size_t mcursorSize;
     size_t mcursorSizeReal;
     int cursorOn;
-    int cursorToHint;			/* Tells the buffer modified callback
+    ssize_t cursorToHint;		/* Tells the buffer modified callback
     					   where to move the cursor, to reduce
     					   the number of redraw calls */
     int cursorStyle;			/* One of enum cursorStyles above */
@@ -148,16 +187,16 @@ struct _textDisp {
     int nVisibleLines;			/* # of visible (displayed) lines */
     int nBufferLines;			/* # of newlines in the buffer */
     textBuffer *buffer;     	    	/* Contains text to be displayed */
-    textBuffer *styleBuffer;   	    	/* Optional parallel buffer containing
+    styleBuffer *styleBuffer;   	/* Optional parallel buffer containing
     	    	    	    	    	   color and font information */
-    int firstChar, lastChar;		/* Buffer positions of first and last
+    ssize_t firstChar, lastChar;	/* Buffer positions of first and last
     					   displayed character (lastChar points
     					   either to a newline or one character
     					   beyond the end of the buffer) */
     int continuousWrap;     	    	/* Wrap long lines when displaying */
     int wrapMargin; 	    	    	/* Margin in # of char positions for
     	    	    	    	    	   wrapping in continuousWrap mode */
-    int *lineStarts;
+    ssize_t *lineStarts;
     int topLineNum;			/* Line number of top displayed line
     					   of file (first line of file is 1) */
     int absTopLineNum;			/* In continuous wrap mode, the line
@@ -230,6 +269,23 @@ struct _textDisp {
     
     size_t cacheNoWrappingWidth;        /* Min width with no line wrapping */
     Boolean cacheNoWrapping;            /* Currently no line wrapping */
+    
+    wrapBlock *wrapBlocks;              /* in continuous wrap mode, counts of
+                                           the lines of the whole buffer in
+                                           blocks, or NULL */
+    int nWrapBlocks, wrapBlocksAlloc;
+    XtWorkProcId wrapCountProc;         /* counts the blocks not counted yet
+                                           when the application is idle */
+    Boolean wrapCountWrapped;           /* any of the blocks wrapped */
+    
+    lineLayout *layoutCache;            /* checkpoints for drawing long
+                                           lines, or NULL */
+    unsigned long layoutStyleGeneration; /* style buffer generation when
+                                           layoutCache was last updated */
+    renderStats stats;
+    Boolean frameOpen;                  /* lines have been drawn since the
+                                           application was last idle */
+    XtWorkProcId frameProc;             /* ends the frame when idle */
 };
 
 textDisp *TextDCreate(Widget widget, Widget hScrollBar, Widget vScrollBar,
@@ -242,8 +298,10 @@ textDisp *TextDCreate(Widget widget, Widget hScrollBar, Widget vScrollBar,
         Boolean highlightCursorLine, Boolean ansiColors);
 void TextDInitXft(textDisp *textD);
 void TextDFree(textDisp *textD);
+char *TextDRenderStatsReport(textDisp *textD);
+void TextDResetRenderStats(textDisp *textD);
 void TextDSetBuffer(textDisp *textD, textBuffer *buffer);
-void TextDAttachHighlightData(textDisp *textD, textBuffer *styleBuffer,
+void TextDAttachHighlightData(textDisp *textD, styleBuffer *styleBuf,
     	styleTableEntry *styleTable, int nStyles, char unfinishedStyle,
     	unfinishedStyleCBProc unfinishedHighlightCB, void *cbArg);
 void TextDSetColorProfile(textDisp *textD, ColorProfile *profile);
@@ -254,29 +312,33 @@ void TextDSetBoldItalicFont(textDisp *textD, NFont *boldFont);
 int TextDMinFontWidth(textDisp *textD, Boolean considerStyles);
 int TextDMaxFontWidth(textDisp *textD, Boolean considerStyles);
 void TextDResize(textDisp *textD, int width, int height);
+void TextDExposeRect(textDisp *textD, int left, int top, int width,
+	int height);
 void TextDRedisplayRect(textDisp *textD, int left, int top, int width,
 	int height);
+void TextDRedisplayRange(textDisp *textD, ssize_t start, ssize_t end);
 void TextDSetScroll(textDisp *textD, int topLineNum, int horizOffset);
 void TextDGetScroll(textDisp *textD, int *topLineNum, int *horizOffset);
 void TextDInsert(textDisp *textD, char *text);
 void TextDOverstrike(textDisp *textD, char *text);
-void TextDSetInsertPosition(textDisp *textD, int newPos);
-void TextDChangeCursors(textDisp *textD, int startPos, int diff);
-int  TextDAddCursor(textDisp *textD, int newMultiCursorPos);
+void TextDApplyCursorEdits(textDisp *textD, const bufEdit *edits);
+void TextDSetInsertPosition(textDisp *textD, ssize_t newPos);
+void TextDChangeCursors(textDisp *textD, ssize_t startPos, ssize_t diff);
+int  TextDAddCursor(textDisp *textD, ssize_t newMultiCursorPos);
 void TextDRemoveCursor(textDisp *textD, int cursorIndex);
 void TextDSetCursors(textDisp *textD, size_t *cursors, size_t ncursors);
 int  TextDClearMultiCursor(textDisp *textD);
 void TextDCheckCursorDuplicates(textDisp *textD);
-int TextDGetInsertPosition(textDisp *textD);
-int TextDXYToPosition(textDisp *textD, int x, int y);
-int TextDXYToCharPos(textDisp *textD, int x, int y);
+ssize_t TextDGetInsertPosition(textDisp *textD);
+ssize_t TextDXYToPosition(textDisp *textD, int x, int y);
+ssize_t TextDXYToCharPos(textDisp *textD, int x, int y);
 void TextDXYToUnconstrainedPosition(textDisp *textD, int x, int y, int *row,
 	int *column);
-int TextDLineAndColToPos(textDisp *textD, int lineNum, int column);
+ssize_t TextDLineAndColToPos(textDisp *textD, int lineNum, int column);
 int TextDOffsetWrappedColumn(textDisp *textD, int row, int column);
 int TextDOffsetWrappedRow(textDisp *textD, int row);
-int TextDPositionToXY(textDisp *textD, int pos, int *x, int *y);
-int TextDPosToLineAndCol(textDisp *textD, int pos, int *lineNum, int *column);
+int TextDPositionToXY(textDisp *textD, ssize_t pos, int *x, int *y);
+int TextDPosToLineAndCol(textDisp *textD, ssize_t pos, int *lineNum, int *column);
 int TextDInSelection(textDisp *textD, int x, int y);
 void TextDMakeInsertPosVisible(textDisp *textD);
 int TextDMoveRight(textDisp *textD);
@@ -286,30 +348,30 @@ int TextDMoveDown(textDisp *textD, int absolute);
 void TextDBlankCursor(textDisp *textD);
 void TextDUnblankCursor(textDisp *textD);
 void TextDSetCursorStyle(textDisp *textD, int style);
-Boolean TextDPosHasCursor(textDisp *textD, int pos, int *index);
-Boolean TextDRangeHasCursor(textDisp *textD, int start, int end);
+Boolean TextDPosHasCursor(textDisp *textD, ssize_t pos, int *index);
+Boolean TextDRangeHasCursor(textDisp *textD, ssize_t start, ssize_t end);
 void TextDSetWrapMode(textDisp *textD, int wrap, int wrapMargin);
-int TextDEndOfLine(const textDisp* textD, int pos,
+ssize_t TextDEndOfLine(const textDisp* textD, ssize_t pos,
     Boolean startPosIsLineStart);
-int TextDStartOfLine(const textDisp* textD, int pos);
-int TextDCountForwardNLines(const textDisp* textD, int startPos,
+ssize_t TextDStartOfLine(const textDisp* textD, ssize_t pos);
+ssize_t TextDCountForwardNLines(const textDisp* textD, ssize_t startPos,
         unsigned nLines, Boolean startPosIsLineStart);
-int TextDCountBackwardNLines(textDisp *textD, int startPos, int nLines);
-int TextDCountLines(textDisp *textD, int startPos, int endPos,
+ssize_t TextDCountBackwardNLines(textDisp *textD, ssize_t startPos, int nLines);
+int TextDCountLines(textDisp *textD, ssize_t startPos, ssize_t endPos,
     	int startPosIsLineStart);
-int TextDCountLinesW(textDisp *textD, int startPos, int endPos,
+int TextDCountLinesW(textDisp *textD, ssize_t startPos, ssize_t endPos,
     	int startPosIsLineStart, Boolean *retWrapped);
 void TextDSetupBGClasses(Widget w, XmString str, XftColor **pp_bgClassPixel,
 	unsigned char **pp_bgClass, XftColor bgPixelDefault);
 void TextDSetLineNumberArea(textDisp *textD, int lineNumLeft, int lineNumWidth,
 	int textLeft);
 void TextDMaintainAbsLineNum(textDisp *textD, int state);
-int TextDPosOfPreferredCol(textDisp *textD, int column, int lineStartPos);
-int TextDPreferredColumn(textDisp *textD, int *visLineNum, int *lineStartPos);
+ssize_t TextDPosOfPreferredCol(textDisp *textD, int column, ssize_t lineStartPos);
+int TextDPreferredColumn(textDisp *textD, int *visLineNum, ssize_t *lineStartPos);
 void TextDSetHighlightCursorLine(textDisp *textD, Boolean state);
 void TextDSetIndentRainbow(textDisp *textD, Boolean indentRainbow);
-void TextDCursorLR(textDisp *textD, int *left, int *right);
-textCursor TextDPos2Cursor(textDisp *textD, int pos);
+void TextDCursorLR(textDisp *textD, ssize_t *left, ssize_t *right);
+textCursor TextDPos2Cursor(textDisp *textD, ssize_t pos);
 void TextDSetAnsiColors(textDisp *textD, Boolean ansiColors);
 
 NFont *FontCreate(Display *dp, FcPattern *pattern);
@@ -318,6 +380,7 @@ XftFont *FontListAddFontForChar(NFont *f, FcChar32 c);
 XftFont *FontDefault(NFont *f);
 void FontAddFail(NFont *f, FcCharSet *c);
 XftFont *FindFont(NFont *f, FcChar32 c);
+int FontCharWidth(NFont *f, FcChar32 c);
 void FontDestroy(NFont *f);
 NFont *FontRef(NFont *font);
 void FontUnref(NFont *font);
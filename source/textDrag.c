@@ -50,8 +50,9 @@
 #include "../debug.h"
 #endif
 
-static void trackModifyRange(int *rangeStart, int *modRangeEnd,
-    	int *unmodRangeEnd, int modPos, int nInserted, int nDeleted);
+static void trackModifyRange(ssize_t *rangeStart, ssize_t *modRangeEnd,
+    	ssize_t *unmodRangeEnd, ssize_t modPos, ssize_t nInserted,
+        ssize_t nDeleted);
 static void findTextMargins(textBuffer *buf, int start, int end, int *leftMargin,
     	int *rightMargin);
 static int findRelativeLineStart(textBuffer *buf, int referencePos,
@@ -179,13 +180,14 @@ void BlockDragSelection(TextWidget tw, int x, int y, int dragType)
     int rectangular = origSel->rectangular;
     int overlay, oldDragType = tw->text.dragType;
     int nLines = tw->text.dragNLines;
-    int insLineNum, insLineStart, insRectStart, insRectEnd, insStart;
+    int insLineNum, insRectStart, insRectEnd, referenceLine, row, column;
     char *repText, *text, *insText;
-    int modRangeStart = -1, tempModRangeEnd = -1, bufModRangeEnd = -1;
-    int referenceLine, referencePos, tempStart, tempEnd, origSelLen;
-    int insertInserted, insertDeleted, row, column;
-    int origSelLineStart, origSelLineEnd;
-    int sourceInserted, sourceDeleted, sourceDeletePos;
+    ssize_t insLineStart, insStart;
+    ssize_t modRangeStart = -1, tempModRangeEnd = -1, bufModRangeEnd = -1;
+    ssize_t referencePos, tempStart, tempEnd, origSelLen;
+    ssize_t insertInserted, insertDeleted;
+    ssize_t origSelLineStart, origSelLineEnd;
+    ssize_t sourceInserted, sourceDeleted, sourceDeletePos;
     
     if (tw->text.dragState != PRIMARY_BLOCK_DRAG)
     	return;
@@ -402,7 +404,7 @@ void BlockDragSelection(TextWidget tw, int x, int y, int dragType)
 void FinishBlockDrag(TextWidget tw)
 {
     dragEndCBStruct endStruct;
-    int modRangeStart = -1, origModRangeEnd, bufModRangeEnd;
+    ssize_t modRangeStart = -1, origModRangeEnd, bufModRangeEnd;
     char *deletedText;
     
     /* Find the changed region of the buffer, covering both the deletion
@@ -442,7 +444,7 @@ void CancelBlockDrag(TextWidget tw)
     textBuffer *buf = tw->text.textD->buffer;
     textBuffer *origBuf = tw->text.dragOrigBuf;
     selection *origSel = &origBuf->primary;
-    int modRangeStart = -1, origModRangeEnd, bufModRangeEnd;
+    ssize_t modRangeStart = -1, origModRangeEnd, bufModRangeEnd;
     char *repText;
     dragEndCBStruct endStruct;
 
@@ -501,8 +503,9 @@ void CancelBlockDrag(TextWidget tw)
 ** being modified.  A value of -1 in rangeStart indicates that there
 ** have been no modifications so far.
 */
-static void trackModifyRange(int *rangeStart, int *modRangeEnd,
-    	int *unmodRangeEnd, int modPos, int nInserted, int nDeleted)
+static void trackModifyRange(ssize_t *rangeStart, ssize_t *modRangeEnd,
+    	ssize_t *unmodRangeEnd, ssize_t modPos, ssize_t nInserted,
+        ssize_t nDeleted)
 {
     if (*rangeStart == -1) {
     	*rangeStart = modPos;
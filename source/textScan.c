@@ -0,0 +1,493 @@
+/*******************************************************************************
+*                                                                              *
+* textScan.c -- Nirvana Editor Text Scanning Kernels                           *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* software; if not, write to the Free Software Foundation, Inc., 59 Temple     *
+* Place, Suite 330, Boston, MA  02111-1307 USA                                 *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Byte scanning loops used by the text buffer for counting lines and
+** searching for characters.  Each kernel works on one contiguous piece of
+** text (callers deal with the buffer gap).  On x86 the kernels compare 16
+** (SSE2) or 32 (AVX2, if the processor has it) bytes at a time, anywhere
+** else they fall back to plain C.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include "textScan.h"
+
+#include <string.h>
+#include <pthread.h>
+
+#ifdef HAVE_DEBUG_H
+#include "../debug.h"
+#endif
+
+#if defined(__GNUC__) && defined(__SSE2__) && \
+        (defined(__x86_64__) || defined(__i386__))
+#define SCAN_USE_SSE2
+#include <emmintrin.h>
+#if __GNUC__ >= 5 || defined(__clang__)
+#define SCAN_USE_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+typedef struct {
+    size_t (*countNewlines)(const char *text, size_t length);
+    const char *(*findNthNewline)(const char *text, size_t length, size_t *n);
+    const char *(*findNthNewlineBackward)(const char *text, size_t length,
+            size_t *n);
+    const char *(*findCharSet)(const char *text, size_t length,
+            const scanCharSet *set);
+    const char *(*findCharSetBackward)(const char *text, size_t length,
+            const scanCharSet *set);
+    const char *(*findCharSetPair)(const char *text, size_t length,
+            const scanCharSet *first, const scanCharSet *second,
+            size_t distance);
+    const char *(*findCharSetPairBackward)(const char *text, size_t length,
+            const scanCharSet *first, const scanCharSet *second,
+            size_t distance);
+} scanKernels;
+
+static const scanKernels *getKernels(void);
+static void chooseKernels(void);
+
+/* The kernels for this processor, chosen the first time they are needed,
+   possibly by several threads at once */
+static const scanKernels *Kernels = NULL;
+static pthread_once_t KernelsOnce = PTHREAD_ONCE_INIT;
+
+/*
+** Returns non-zero if the kernels examine several bytes at a time, rather than
+** looping over the text a byte at a time
+*/
+int ScanIsVectorized(void)
+{
+#ifdef SCAN_USE_SSE2
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/*
+** Prepare a character set for ScanFindCharSet from the null-terminated
+** string "chars"
+*/
+void ScanInitCharSet(scanCharSet *set, const char *chars)
+{
+    const unsigned char *c;
+
+    memset(set->member, 0, sizeof(set->member));
+    set->nChars = 0;
+    for (c = (const unsigned char *)chars; *c != '\0'; c++) {
+        if (set->member[*c])
+            continue;
+        set->member[*c] = 1;
+        if (set->nChars < SCAN_MAX_VECTOR_SET)
+            set->chars[set->nChars] = *c;
+        set->nChars++;
+    }
+}
+
+/*
+** Count the newlines in "length" bytes of "text"
+*/
+size_t ScanCountNewlines(const char *text, size_t length)
+{
+    return getKernels()->countNewlines(text, length);
+}
+
+/*
+** Find the "*n"th newline (counting from 1) in "length" bytes of "text".
+** Returns NULL if there are fewer, in which case the number of newlines
+** which were found is subtracted from *n.
+*/
+const char *ScanFindNthNewline(const char *text, size_t length, size_t *n)
+{
+    return getKernels()->findNthNewline(text, length, n);
+}
+
+/*
+** Like ScanFindNthNewline, but counting backwards from the end of the text
+*/
+const char *ScanFindNthNewlineBackward(const char *text, size_t length,
+        size_t *n)
+{
+    return getKernels()->findNthNewlineBackward(text, length, n);
+}
+
+/*
+** Return the first byte in "length" bytes of "text" which belongs to "set",
+** or NULL if there is none
+*/
+const char *ScanFindCharSet(const char *text, size_t length,
+        const scanCharSet *set)
+{
+    return getKernels()->findCharSet(text, length, set);
+}
+
+/*
+** Return the last byte in "length" bytes of "text" which belongs to "set",
+** or NULL if there is none
+*/
+const char *ScanFindCharSetBackward(const char *text, size_t length,
+        const scanCharSet *set)
+{
+    return getKernels()->findCharSetBackward(text, length, set);
+}
+
+/*
+** Return the first byte in "length" bytes of "text" which belongs to "first"
+** and is followed "distance" bytes later by one belonging to "second", or
+** NULL if there is none.  Both bytes must lie within the text.
+*/
+const char *ScanFindCharSetPair(const char *text, size_t length,
+        const scanCharSet *first, const scanCharSet *second, size_t distance)
+{
+    return getKernels()->findCharSetPair(text, length, first, second,
+            distance);
+}
+
+/*
+** Like ScanFindCharSetPair, but returning the last such byte
+*/
+const char *ScanFindCharSetPairBackward(const char *text, size_t length,
+        const scanCharSet *first, const scanCharSet *second, size_t distance)
+{
+    return getKernels()->findCharSetPairBackward(text, length, first, second,
+            distance);
+}
+
+/*
+** Portable kernels, also used for the tails of the vector ones
+*/
+static size_t countNewlinesScalar(const char *text, size_t length)
+{
+    const char *end = text + length;
+    size_t count = 0;
+
+    while ((text = memchr(text, '\n', end - text)) != NULL) {
+        count++;
+        text++;
+    }
+    return count;
+}
+
+static const char *findNthNewlineScalar(const char *text, size_t length,
+        size_t *n)
+{
+    const char *end = text + length;
+
+    while ((text = memchr(text, '\n', end - text)) != NULL) {
+        if (--*n == 0)
+            return text;
+        text++;
+    }
+    return NULL;
+}
+
+static const char *findNthNewlineBackwardScalar(const char *text,
+        size_t length, size_t *n)
+{
+    const char *c;
+
+    for (c = text + length; c-- != text; ) {
+        if (*c == '\n' && --*n == 0)
+            return c;
+    }
+    return NULL;
+}
+
+static const char *findCharSetScalar(const char *text, size_t length,
+        const scanCharSet *set)
+{
+    const char *end = text + length;
+
+    if (set->nChars == 1)
+        return memchr(text, set->chars[0], length);
+    for (; text != end; text++)
+        if (set->member[(unsigned char)*text])
+            return text;
+    return NULL;
+}
+
+static const char *findCharSetBackwardScalar(const char *text, size_t length,
+        const scanCharSet *set)
+{
+    const char *c;
+
+    for (c = text + length; c-- != text; )
+        if (set->member[(unsigned char)*c])
+            return c;
+    return NULL;
+}
+
+static const char *findCharSetPairScalar(const char *text, size_t length,
+        const scanCharSet *first, const scanCharSet *second, size_t distance)
+{
+    const char *c;
+
+    if (length <= distance)
+        return NULL;
+    for (c = text; c != text + length - distance; c++)
+        if (first->member[(unsigned char)*c] &&
+                second->member[(unsigned char)c[distance]])
+            return c;
+    return NULL;
+}
+
+static const char *findCharSetPairBackwardScalar(const char *text,
+        size_t length, const scanCharSet *first, const scanCharSet *second,
+        size_t distance)
+{
+    const char *c;
+
+    if (length <= distance)
+        return NULL;
+    for (c = text + length - distance; c-- != text; )
+        if (first->member[(unsigned char)*c] &&
+                second->member[(unsigned char)c[distance]])
+            return c;
+    return NULL;
+}
+
+#ifndef SCAN_USE_SSE2
+static const scanKernels scalarKernels = {
+    countNewlinesScalar,
+    findNthNewlineScalar,
+    findNthNewlineBackwardScalar,
+    findCharSetScalar,
+    findCharSetBackwardScalar,
+    findCharSetPairScalar,
+    findCharSetPairBackwardScalar
+};
+#endif
+
+#ifdef SCAN_USE_SSE2
+
+/* Index of the highest set bit in a non-zero compare mask */
+#define HIGHEST_BIT(m) (31 - __builtin_clz(m))
+
+/*
+** Generate the vector kernels for a vector width of "width" bytes.
+** "maskNL(p)" and "maskSet(p, set)" return a bit mask of the bytes at p
+** which are newlines, and which belong to set.  Sets too large to test
+** with vector compares go to the scalar table lookup.
+*/
+#define SCAN_KERNELS(sfx, width, attr, maskNL, maskSet) \
+attr static size_t countNewlines##sfx(const char *text, size_t length) \
+{ \
+    size_t count = 0; \
+ \
+    for (; length >= width; text += width, length -= width) \
+        count += __builtin_popcount(maskNL(text)); \
+    return count + countNewlinesScalar(text, length); \
+} \
+ \
+attr static const char *findNthNewline##sfx(const char *text, size_t length, \
+        size_t *n) \
+{ \
+    unsigned m, found; \
+ \
+    for (; length >= width; text += width, length -= width) { \
+        m = maskNL(text); \
+        found = __builtin_popcount(m); \
+        if (found >= *n) { \
+            while (--*n != 0) \
+                m &= m - 1; \
+            return text + __builtin_ctz(m); \
+        } \
+        *n -= found; \
+    } \
+    return findNthNewlineScalar(text, length, n); \
+} \
+ \
+attr static const char *findNthNewlineBackward##sfx(const char *text, \
+        size_t length, size_t *n) \
+{ \
+    const char *block = text + length; \
+    unsigned m, found; \
+ \
+    for (; length >= width; length -= width) { \
+        block -= width; \
+        m = maskNL(block); \
+        found = __builtin_popcount(m); \
+        if (found >= *n) { \
+            while (--*n != 0) \
+                m &= ~(1u << HIGHEST_BIT(m)); \
+            return block + HIGHEST_BIT(m); \
+        } \
+        *n -= found; \
+    } \
+    return findNthNewlineBackwardScalar(text, length, n); \
+} \
+ \
+attr static const char *findCharSet##sfx(const char *text, size_t length, \
+        const scanCharSet *set) \
+{ \
+    unsigned m; \
+ \
+    if (set->nChars > SCAN_MAX_VECTOR_SET) \
+        return findCharSetScalar(text, length, set); \
+    for (; length >= width; text += width, length -= width) { \
+        m = maskSet(text, set); \
+        if (m != 0) \
+            return text + __builtin_ctz(m); \
+    } \
+    return findCharSetScalar(text, length, set); \
+} \
+ \
+attr static const char *findCharSetBackward##sfx(const char *text, \
+        size_t length, const scanCharSet *set) \
+{ \
+    const char *block = text + length; \
+    unsigned m; \
+ \
+    if (set->nChars > SCAN_MAX_VECTOR_SET) \
+        return findCharSetBackwardScalar(text, length, set); \
+    for (; length >= width; length -= width) { \
+        block -= width; \
+        m = maskSet(block, set); \
+        if (m != 0) \
+            return block + HIGHEST_BIT(m); \
+    } \
+    return findCharSetBackwardScalar(text, length, set); \
+} \
+ \
+attr static const char *findCharSetPair##sfx(const char *text, size_t length, \
+        const scanCharSet *first, const scanCharSet *second, size_t distance) \
+{ \
+    unsigned m; \
+ \
+    if (first->nChars > SCAN_MAX_VECTOR_SET || \
+            second->nChars > SCAN_MAX_VECTOR_SET) \
+        return findCharSetPairScalar(text, length, first, second, distance); \
+    for (; length >= width + distance; text += width, length -= width) { \
+        m = maskSet(text, first) & maskSet(text + distance, second); \
+        if (m != 0) \
+            return text + __builtin_ctz(m); \
+    } \
+    return findCharSetPairScalar(text, length, first, second, distance); \
+} \
+ \
+attr static const char *findCharSetPairBackward##sfx(const char *text, \
+        size_t length, const scanCharSet *first, const scanCharSet *second, \
+        size_t distance) \
+{ \
+    const char *block; \
+    unsigned m; \
+ \
+    if (first->nChars > SCAN_MAX_VECTOR_SET || \
+            second->nChars > SCAN_MAX_VECTOR_SET || length <= distance) \
+        return findCharSetPairBackwardScalar(text, length, first, second, \
+                distance); \
+    for (block = text + length - distance; block - text >= width; ) { \
+        block -= width; \
+        m = maskSet(block, first) & maskSet(block + distance, second); \
+        if (m != 0) \
+            return block + HIGHEST_BIT(m); \
+    } \
+    return findCharSetPairBackwardScalar(text, block - text + distance, \
+            first, second, distance); \
+} \
+ \
+static const scanKernels sfx##Kernels = { \
+    countNewlines##sfx, \
+    findNthNewline##sfx, \
+    findNthNewlineBackward##sfx, \
+    findCharSet##sfx, \
+    findCharSetBackward##sfx, \
+    findCharSetPair##sfx, \
+    findCharSetPairBackward##sfx \
+};
+
+static inline unsigned maskNewlineSSE2(const char *p)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+}
+
+static inline unsigned maskSetSSE2(const char *p, const scanCharSet *set)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i hits = _mm_setzero_si128();
+    int i;
+
+    for (i=0; i<set->nChars; i++)
+        hits = _mm_or_si128(hits,
+                _mm_cmpeq_epi8(v, _mm_set1_epi8((char)set->chars[i])));
+    return _mm_movemask_epi8(hits);
+}
+
+SCAN_KERNELS(SSE2, 16, , maskNewlineSSE2, maskSetSSE2)
+
+#ifdef SCAN_USE_AVX2
+
+__attribute__((target("avx2")))
+static inline unsigned maskNewlineAVX2(const char *p)
+{
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+}
+
+__attribute__((target("avx2")))
+static inline unsigned maskSetAVX2(const char *p, const scanCharSet *set)
+{
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    __m256i hits = _mm256_setzero_si256();
+    int i;
+
+    for (i=0; i<set->nChars; i++)
+        hits = _mm256_or_si256(hits,
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)set->chars[i])));
+    return _mm256_movemask_epi8(hits);
+}
+
+SCAN_KERNELS(AVX2, 32, __attribute__((target("avx2"))), maskNewlineAVX2,
+        maskSetAVX2)
+
+#endif /* SCAN_USE_AVX2 */
+#endif /* SCAN_USE_SSE2 */
+
+static const scanKernels *getKernels(void)
+{
+    pthread_once(&KernelsOnce, chooseKernels);
+    return Kernels;
+}
+
+/*
+** Pick the fastest set of kernels the processor supports
+*/
+static void chooseKernels(void)
+{
+#ifdef SCAN_USE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        Kernels = &AVX2Kernels;
+    else
+#endif
+#ifdef SCAN_USE_SSE2
+    Kernels = &SSE2Kernels;
+#else
+    Kernels = &scalarKernels;
+#endif
+}
@@ -0,0 +1,52 @@
+/*******************************************************************************
+*                                                                              *
+* textScan.h -- Nirvana Editor Text Scanning Kernels Header File               *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* software; if not, write to the Free Software Foundation, Inc., 59 Temple     *
+* Place, Suite 330, Boston, MA  02111-1307 USA                                 *
+*                                                                              *
+*******************************************************************************/
+
+#ifndef NEDIT_TEXTSCAN_H_INCLUDED
+#define NEDIT_TEXTSCAN_H_INCLUDED
+
+#include <stddef.h>
+
+/* Character sets with more members than this are searched with a lookup
+   table rather than with vector compares */
+#define SCAN_MAX_VECTOR_SET 8
+
+typedef struct {
+    int nChars;                     /* number of characters in the set */
+    unsigned char chars[SCAN_MAX_VECTOR_SET];
+    unsigned char member[256];      /* non-zero for characters in the set */
+} scanCharSet;
+
+int ScanIsVectorized(void);
+void ScanInitCharSet(scanCharSet *set, const char *chars);
+size_t ScanCountNewlines(const char *text, size_t length);
+const char *ScanFindNthNewline(const char *text, size_t length, size_t *n);
+const char *ScanFindNthNewlineBackward(const char *text, size_t length,
+        size_t *n);
+const char *ScanFindCharSet(const char *text, size_t length,
+        const scanCharSet *set);
+const char *ScanFindCharSetBackward(const char *text, size_t length,
+        const scanCharSet *set);
+const char *ScanFindCharSetPair(const char *text, size_t length,
+        const scanCharSet *first, const scanCharSet *second, size_t distance);
+const char *ScanFindCharSetPairBackward(const char *text, size_t length,
+        const scanCharSet *first, const scanCharSet *second, size_t distance);
+
+#endif /* NEDIT_TEXTSCAN_H_INCLUDED */
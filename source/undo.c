@@ -60,20 +60,35 @@ static void addRedoItem(WindowInfo *window, UndoInfo *redo);
 static void removeUndoItem(WindowInfo *window);
 static void removeRedoItem(WindowInfo *window);
 static void appendDeletedText(WindowInfo *window, const char *deletedText,
-	int deletedLen, int direction);
+	ssize_t deletedLen, int direction);
 static void trimUndoList(WindowInfo *window, int maxLength);
-static int determineUndoType(int nInserted, int nDeleted);
+static void trimUndoListToLimits(WindowInfo *window);
+static int replayBatch(WindowInfo *window, int isRedo, int numOp,
+        size_t *cursors);
+static void replayEdits(WindowInfo *window, int isRedo, size_t *cursor);
+static int getBatchEdits(const UndoEdit *recs, int numOp, bufEdit *edits,
+        int *order);
+static int determineUndoType(ssize_t nInserted, ssize_t nDeleted);
 static void freeUndoRecord(UndoInfo *undo);
+static void storeUndoRecord(WindowInfo *window, UndoInfo *undo, int isUndo);
+static void setBatchCursors(WindowInfo *window, size_t *cursors, int numOp,
+        int singleCursor);
 
 static void doUndo(WindowInfo *window, int isBatch, size_t *cursors, int cursorIndex)
 {
     UndoInfo *undo = window->undo;
-    int restoredTextLength;
+    ssize_t restoredTextLength;
      
     /* return if nothing to undo */
     if (undo == NULL)
     	return;
     
+    /* edits made at once are undone at once */
+    if (undo->nEdits > 0) {
+        replayEdits(window, False, isBatch ? cursors + cursorIndex : NULL);
+        return;
+    }
+    
     /* BufReplace will eventually call SaveUndoInformation.  This is mostly
        good because it makes accumulating redo operations easier, however
        SaveUndoInformation needs to know that it is being called in the context
@@ -86,7 +101,7 @@ static void doUndo(WindowInfo *window, int isBatch, size_t *cursors, int cursorI
     	    (undo->oldText != NULL ? undo->oldText : ""));
     
     restoredTextLength = undo->oldText != NULL ? strlen(undo->oldText) : 0;
-    int diff = restoredTextLength;
+    ssize_t diff = restoredTextLength;
     if(diff == 0) {
         diff = undo->startPos - undo->endPos;
     }
@@ -130,6 +145,7 @@ static void doUndo(WindowInfo *window, int isBatch, size_t *cursors, int cursorI
 
 void Undo(WindowInfo *window) {
     int numOp = window->undo->numOp;
+    int singleCursor = window->undo->singleCursor;
     int undoCount = 1;
     int isBatch = 0;
     if(numOp > 0) {
@@ -140,19 +156,26 @@ void Undo(WindowInfo *window) {
     size_t *cursors = NULL;
     int cursorIndex = 0;
     TextChangeCursors(window->lastFocus, 0, 0);
-    if(!isBatch) {
+    if(!isBatch || singleCursor) {
         TextClearMultiCursors(window->lastFocus);
-    } else {
+    }
+    if(isBatch) {
         cursors = NEditCalloc(sizeof(size_t), numOp);
     }
     
     window->undo_op_batch_size = numOp;
-    for(int i=0;i<undoCount;i++) {
-        doUndo(window, isBatch, cursors, cursorIndex++);
+    window->undo_batch_single_cursor = singleCursor;
+    if(!isBatch || !replayBatch(window, False, numOp, cursors)) {
+        for(int i=0;i<undoCount;i++) {
+            doUndo(window, isBatch, cursors, cursorIndex++);
+        }
     }
+    window->undo_op_batch_size = 0;
+    window->undo_batch_single_cursor = False;
+    window->undoOpCount--;
     
     if(cursors) {
-        TextSetCursors(window->lastFocus, cursors, numOp);
+        setBatchCursors(window, cursors, numOp, singleCursor);
         NEditFree(cursors);
     }
 }
@@ -160,12 +183,17 @@ void Undo(WindowInfo *window) {
 static void doRedo(WindowInfo *window, int isBatch, size_t *cursors, int cursorIndex)
 {
     UndoInfo *redo = window->redo;
-    int restoredTextLength;
+    ssize_t restoredTextLength;
     
     // not really necessary, but in case of redo-bugs, this prevents a crash
     if (window->redo == NULL) {
         return;
     }
+    
+    if (redo->nEdits > 0) {
+        replayEdits(window, True, isBatch ? cursors + cursorIndex : NULL);
+        return;
+    }
         
     // BufReplace will eventually call SaveUndoInformation.  To indicate
     // to SaveUndoInformation that this is the context of a redo operation,
@@ -180,7 +208,7 @@ static void doRedo(WindowInfo *window, int isBatch, size_t *cursors, int cursorI
     if (!window->buffer->primary.selected || GetPrefUndoModifiesSelection()) {
 	// position the cursor in the focus pane after the changed text
         // to show the user where the undo was done
-        int newpos = redo->startPos + restoredTextLength;
+        ssize_t newpos = redo->startPos + restoredTextLength;
         if(!isBatch) {
             TextSetCursorPos(window->lastFocus, newpos);
         } else {
@@ -220,6 +248,7 @@ void Redo(WindowInfo *window)
     	return;
     
     int numOp = redo->numOp;
+    int singleCursor = redo->singleCursor;
     int redoCount = 1;
     int isBatch = 0;
     size_t *cursors = NULL;
@@ -232,16 +261,203 @@ void Redo(WindowInfo *window)
     
     TextChangeCursors(window->lastFocus, 0, 0);
     window->undo_op_batch_size = numOp;
-    for(int i=0;i<redoCount;i++) {
-        doRedo(window, isBatch, cursors, cursorIndex++);
+    window->undo_batch_single_cursor = singleCursor;
+    if(!isBatch || !replayBatch(window, True, numOp, cursors)) {
+        for(int i=0;i<redoCount;i++) {
+            doRedo(window, isBatch, cursors, cursorIndex++);
+        }
+    }
+    window->undo_op_batch_size = 0;
+    window->undo_batch_single_cursor = False;
+    
+    // the records of a redone batch are counted together, like the batch
+    if(isBatch) {
+        FinishUndoBatch(window);
     }
     
     if(cursors) {
-        TextSetCursors(window->lastFocus, cursors, numOp);
+        setBatchCursors(window, cursors, numOp, singleCursor);
         NEditFree(cursors);
     }
 }
 
+/*
+** Undo (or redo) the "numOp" records of a batch operation at the front of
+** the undo (redo) list in one buffer modification, rather than replacing
+** the text of each record in turn, which is slow for batches of thousands
+** of records.  Fills in "cursors" like doUndo/doRedo.  Returns False,
+** having changed nothing, if the records can't be replayed this way.
+*/
+static int replayBatch(WindowInfo *window, int isRedo, int numOp,
+        size_t *cursors)
+{
+    UndoInfo *u, *rec = isRedo ? window->redo : window->undo;
+    UndoEdit *recs;
+    bufEdit *edits;
+    int i, *order, restoresToSaved = False;
+    ssize_t shift;
+    
+    /* Records of edits made at once are undone on their own (see
+       replayEdits), so a batch holding any is undone one record at a time */
+    recs = (UndoEdit*)NEditMalloc(sizeof(UndoEdit) * numOp);
+    for (i=0, u=rec; i<numOp && u != NULL && u->nEdits == 0; i++, u=u->next) {
+        recs[i].startPos = u->startPos;
+        recs[i].endPos = u->endPos;
+        recs[i].oldText = u->oldText;
+    }
+    edits = (bufEdit*)NEditMalloc(sizeof(bufEdit) * numOp);
+    order = (int*)NEditMalloc(sizeof(int) * numOp);
+    if (i < numOp || !getBatchEdits(recs, numOp, edits, order)) {
+        NEditFree(recs);
+        NEditFree(edits);
+        NEditFree(order);
+        return False;
+    }
+    NEditFree(recs);
+    
+    /* As in doUndo/doRedo, the inUndo flag tells SaveUndoInformation where
+       to put the records it makes of the modification */
+    rec->inUndo = True;
+    BufApplyEdits(window->buffer, edits, numOp);
+    
+    if (!window->buffer->primary.selected || GetPrefUndoModifiesSelection()) {
+        for (i=0, shift=0; i<numOp; i++) {
+            shift += strlen(edits[i].text);
+            cursors[order[i]] = edits[i].pos + shift;
+            shift -= edits[i].nDeleted;
+        }
+    }
+    MakeSelectionVisible(window, window->lastFocus);
+    
+    /* Remove the records.  Replayed one at a time, only the last record
+       restoring the unmodified status would leave the file unmodified */
+    for (i=0; i<numOp; i++) {
+        if (isRedo) {
+            restoresToSaved = window->redo->restoresToSaved;
+            removeRedoItem(window);
+        } else {
+            restoresToSaved = window->undo->restoresToSaved;
+            removeUndoItem(window);
+        }
+    }
+    if (restoresToSaved) {
+    	SetWindowModified(window, False);
+    	RemoveBackupFile(window);
+    }
+    
+    NEditFree(edits);
+    NEditFree(order);
+    return True;
+}
+
+/*
+** Undo (or redo) the record of edits made at once (see SaveUndoEdits) at the
+** front of the undo (redo) list, again in one buffer modification, and put a
+** cursor after the text restored by each edit.  If the record is part of a
+** batch operation, "cursor" is not NULL, and just gets the position of the
+** first cursor, for the caller to place with those of the other records.
+*/
+static void replayEdits(WindowInfo *window, int isRedo, size_t *cursor)
+{
+    UndoInfo *rec = isRedo ? window->redo : window->undo;
+    int i, nEdits = rec->nEdits, singleCursor = rec->singleCursor;
+    int restoresToSaved = rec->restoresToSaved;
+    bufEdit *edits;
+    size_t *cursors;
+    int *order;
+    ssize_t shift;
+    
+    edits = (bufEdit*)NEditMalloc(sizeof(bufEdit) * nEdits);
+    order = (int*)NEditMalloc(sizeof(int) * nEdits);
+    cursors = (size_t*)NEditMalloc(sizeof(size_t) * nEdits);
+    getBatchEdits(rec->edits, nEdits, edits, order);
+    
+    /* As in doUndo/doRedo, the inUndo flag tells SaveUndoEdits where to put
+       the record it makes of the modification */
+    rec->inUndo = True;
+    BufApplyEdits(window->buffer, edits, nEdits);
+    for (i=0, shift=0; i<nEdits; i++) {
+        shift += strlen(edits[i].text);
+        cursors[i] = edits[i].pos + shift;
+        shift -= edits[i].nDeleted;
+    }
+    
+    if (isRedo)
+        removeRedoItem(window);
+    else
+        removeUndoItem(window);
+    if (restoresToSaved) {
+    	SetWindowModified(window, False);
+    	RemoveBackupFile(window);
+    }
+    
+    if (!window->buffer->primary.selected || GetPrefUndoModifiesSelection()) {
+        if (cursor != NULL)
+            *cursor = cursors[0];
+        else if (singleCursor)
+            TextSetCursorPos(window->lastFocus, cursors[0]);
+        else
+            TextSetCursors(window->lastFocus, cursors, nEdits);
+    }
+    MakeSelectionVisible(window, window->lastFocus);
+    
+    NEditFree(edits);
+    NEditFree(order);
+    NEditFree(cursors);
+}
+
+/*
+** Get the edits for replaying the "numOp" records in "recs" with
+** BufApplyEdits, and in "order", the index of the record for each edit.
+** The records have the positions of replacing their text one at a time,
+** which can be turned into edits if each replacement is after the text of
+** the one before (such as at multiple cursors, or by replace all) or, as
+** records made by undoing those are, entirely before it.  Returns False if
+** the records are in neither order.
+*/
+static int getBatchEdits(const UndoEdit *recs, int numOp, bufEdit *edits,
+        int *order)
+{
+    const UndoEdit *u;
+    ssize_t prevStart = 0, prevEnd = 0, shift;
+    int i, forward = True, backward = True;
+    
+    for (i=0, u=recs; i<numOp; i++, u++) {
+        if (i > 0 && u->startPos < prevEnd)
+            forward = False;
+        if (i > 0 && u->endPos > prevStart)
+            backward = False;
+        prevStart = u->startPos;
+        prevEnd = u->startPos + (u->oldText != NULL ? strlen(u->oldText) : 0);
+    }
+    
+    for (i=0, u=recs, shift=0; i<numOp; i++, u++) {
+        int e = forward ? i : numOp - 1 - i;
+        edits[e].text = u->oldText != NULL ? u->oldText : "";
+        edits[e].nDeleted = u->endPos - u->startPos;
+        edits[e].pos = u->startPos - (forward ? shift : 0);
+        order[e] = i;
+        shift += strlen(edits[e].text) - edits[e].nDeleted;
+    }
+    return forward || backward;
+}
+
+/*
+** Place the cursor(s) after undoing or redoing a batch operation: one for each
+** record of a multi-cursor edit, or otherwise just one, after the text
+** changed by the first record.
+*/
+static void setBatchCursors(WindowInfo *window, size_t *cursors, int numOp,
+        int singleCursor)
+{
+    if (!singleCursor) {
+        TextSetCursors(window->lastFocus, cursors, numOp);
+    } else if (!window->buffer->primary.selected ||
+            GetPrefUndoModifiesSelection()) {
+        TextSetCursorPos(window->lastFocus, cursors[0]);
+    }
+}
+
 
 /*
 ** SaveUndoInformation stores away the changes made to the text buffer.  As a
@@ -251,11 +467,11 @@ void Redo(WindowInfo *window)
 ** Note: This routine must be kept efficient.  It is called for every 
 **       character typed.
 */
-void SaveUndoInformation(WindowInfo *window, int pos, int nInserted,
-	int nDeleted, const char *deletedText)
+void SaveUndoInformation(WindowInfo *window, ssize_t pos, ssize_t nInserted,
+	ssize_t nDeleted, const char *deletedText)
 {
     int newType, oldType;
-    UndoInfo *u, *undo = window->undo;
+    UndoInfo *undo = window->undo;
     int isUndo = (undo != NULL && undo->inUndo);
     int isRedo = (window->redo != NULL && window->redo->inUndo);
     int numOp = window->undo_op_batch_size;
@@ -283,7 +499,7 @@ void SaveUndoInformation(WindowInfo *window, int pos, int nInserted,
     ** In multi cursor mode, this doesn't work. Multi-cursor modifications
     ** are indicated by the undo-batch  
     */
-    if (window->fileChanged && !window->undo_batch_begin) {
+    if (window->fileChanged && !window->undo_batch_open) {
     
 	/* normal sequential character insertion */
 	if (  ((oldType == ONE_CHAR_INSERT || oldType == ONE_CHAR_REPLACE)
@@ -326,9 +542,12 @@ void SaveUndoInformation(WindowInfo *window, int pos, int nInserted,
     undo = (UndoInfo *)NEditMalloc(sizeof(UndoInfo));
     undo->oldLen = 0;
     undo->oldText = NULL;
+    undo->nEdits = 0;
+    undo->edits = NULL;
     undo->type = newType;
     undo->inUndo = False;
     undo->numOp = numOp;
+    undo->singleCursor = window->undo_batch_single_cursor;
     undo->restoresToSaved = False;
     undo->startPos = pos;
     undo->endPos = pos + nInserted;
@@ -340,6 +559,70 @@ void SaveUndoInformation(WindowInfo *window, int pos, int nInserted,
 	strcpy(undo->oldText, deletedText);
     }
     
+    storeUndoRecord(window, undo, isUndo);
+}
+
+/*
+** Store away the edits made at once by BufApplyEdits (see
+** BufGetModifications), such as a keystroke at multiple cursors, in one undo
+** record holding all of them, rather than a record for each.
+*/
+void SaveUndoEdits(WindowInfo *window, const bufModification *mods,
+	int nMods)
+{
+    UndoInfo *undo = window->undo;
+    int isUndo = (undo != NULL && undo->inUndo);
+    int isRedo = (window->redo != NULL && window->redo->inUndo);
+    ssize_t textLen;
+    char *textPtr;
+    int i;
+    
+    /* a single edit is no different from one made on its own */
+    if (nMods == 1) {
+    	SaveUndoInformation(window, mods[0].pos, mods[0].nInserted,
+		mods[0].nDeleted, mods[0].deletedText);
+	return;
+    }
+    
+    if (!(isUndo || isRedo) && window->redo != NULL)
+    	ClearRedoList(window);
+    
+    /* The text deleted by each edit is kept null-terminated, all in one
+       block of memory */
+    for (i=0, textLen=0; i<nMods; i++)
+    	textLen += mods[i].nDeleted + 1;
+    undo = (UndoInfo *)NEditMalloc(sizeof(UndoInfo));
+    undo->type = MULTI_EDIT;
+    undo->inUndo = False;
+    undo->numOp = window->undo_op_batch_size;
+    undo->singleCursor = window->undo_batch_single_cursor;
+    undo->restoresToSaved = False;
+    undo->startPos = mods[0].pos;
+    undo->endPos = mods[nMods-1].pos + mods[nMods-1].nInserted;
+    undo->oldLen = textLen + sizeof(UndoEdit) * nMods;
+    undo->oldText = (char*)NEditMalloc(textLen);
+    undo->nEdits = nMods;
+    undo->edits = (UndoEdit*)NEditMalloc(sizeof(UndoEdit) * nMods);
+    for (i=0, textPtr=undo->oldText; i<nMods; i++) {
+    	undo->edits[i].startPos = mods[i].pos;
+	undo->edits[i].endPos = mods[i].pos + mods[i].nInserted;
+	undo->edits[i].oldText = textPtr;
+	memcpy(textPtr, mods[i].deletedText, mods[i].nDeleted);
+	textPtr[mods[i].nDeleted] = '\0';
+	textPtr += mods[i].nDeleted + 1;
+    }
+    
+    storeUndoRecord(window, undo, isUndo);
+}
+
+/*
+** Count a new undo record for the autosave feature, and add it to the undo
+** list, or if it records a modification made by undoing, to the redo list.
+*/
+static void storeUndoRecord(WindowInfo *window, UndoInfo *undo, int isUndo)
+{
+    UndoInfo *u;
+    
     /* increment the operation count for the autosave feature */
     window->autoSaveOpCount++;
 
@@ -372,6 +655,7 @@ void ClearUndoList(WindowInfo *window)
 {
     while (window->undo != NULL)
     	removeUndoItem(window);
+    window->undoOpCount = 0;
 }
 void ClearRedoList(WindowInfo *window)
 {
@@ -397,11 +681,28 @@ static void addUndoItem(WindowInfo *window, UndoInfo *undo)
     undo->next = window->undo;
     window->undo = undo;
     
-    /* Increment the operation and memory counts */
-    window->undoOpCount++;
+    /* Increment the operation and memory counts.  The records of a batch
+       operation count as one operation, which is counted, and the list
+       trimmed, when the batch is complete (see FinishUndoBatch) */
     window->undoMemUsed += undo->oldLen;
-    
-    /* Trim the list if it exceeds any of the limits */
+    if (window->undo_batch_open || window->undo_op_batch_size > 0)
+    	return;
+    window->undoOpCount++;
+    trimUndoListToLimits(window);
+}
+
+/*
+** Count the records of a batch operation just added to the undo list as one
+** operation, and trim the list if it exceeds any of the limits.
+*/
+void FinishUndoBatch(WindowInfo *window)
+{
+    window->undoOpCount++;
+    trimUndoListToLimits(window);
+}
+
+static void trimUndoListToLimits(WindowInfo *window)
+{
     if (window->undoOpCount > GetPrefUndoOpLimit())
     	trimUndoList(window, GetPrefUndoOpTrimTo());
     if (window->undoMemUsed > GetPrefUndoWorryLimit())
@@ -436,8 +737,8 @@ static void removeUndoItem(WindowInfo *window)
     if (undo == NULL)
     	return;
     
-    /* Decrement the operation and memory counts */
-    window->undoOpCount--;
+    /* Decrement the memory count (the caller counts operations, which can
+       be made of more than one record) */
     window->undoMemUsed -= undo->oldLen;
     
     /* Remove and free the item */
@@ -476,7 +777,7 @@ static void removeRedoItem(WindowInfo *window)
 ** work with more than one character.
 */
 static void appendDeletedText(WindowInfo *window, const char *deletedText,
-	int deletedLen, int direction)
+	ssize_t deletedLen, int direction)
 {
     UndoInfo *undo = window->undo;
     char *comboText;
@@ -504,33 +805,38 @@ static void appendDeletedText(WindowInfo *window, const char *deletedText,
 
 /*
 ** Trim records off of the END of the undo list to reduce it to length
-** maxLength
+** maxLength.  The records of a batch operation count as one, and are kept
+** or removed together.
 */
 static void trimUndoList(WindowInfo *window, int maxLength)
 {
-    int i;
+    int i, n;
     UndoInfo *u, *lastRec;
     
     if (window->undo == NULL)
     	return;
 
-    /* Find last item on the list to leave intact */
-    for (i=1, u=window->undo; i<maxLength && u!=NULL; i++, u=u->next);
-    if (u == NULL)
-    	return;
+    /* Find last item on the list to leave intact.  The first record of a
+       batch holds the number of records in it */
+    for (i=1, u=window->undo; ; i++, u=u->next) {
+	for (n = u->numOp; n > 1 && u->next != NULL; n--)
+	    u = u->next;
+	if (i >= maxLength || u->next == NULL)
+	    break;
+    }
+    window->undoOpCount = i;
     
     /* Trim off all subsequent entries */
     lastRec = u;
     while (lastRec->next != NULL) {
 	u = lastRec->next;
 	lastRec->next = u->next;
-    	window->undoOpCount--;
     	window->undoMemUsed -= u->oldLen;
     	freeUndoRecord(u);
     }
 }
   
-static int determineUndoType(int nInserted, int nDeleted)
+static int determineUndoType(ssize_t nInserted, ssize_t nDeleted)
 {
     int textDeleted, textInserted;
     
@@ -567,5 +873,6 @@ static void freeUndoRecord(UndoInfo *undo)
     	return;
     	
     NEditFree(undo->oldText);
+    NEditFree(undo->edits);
     NEditFree(undo);
 }
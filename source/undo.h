@@ -30,12 +30,15 @@
 #include "nedit.h"
 
 enum undoTypes {UNDO_NOOP, ONE_CHAR_INSERT, ONE_CHAR_REPLACE, ONE_CHAR_DELETE,
-		BLOCK_INSERT, BLOCK_REPLACE, BLOCK_DELETE};
+		BLOCK_INSERT, BLOCK_REPLACE, BLOCK_DELETE, MULTI_EDIT};
 
 void Undo(WindowInfo *window);
 void Redo(WindowInfo *window);
-void SaveUndoInformation(WindowInfo *window, int pos, int nInserted,
-	int nDeleted, const char *deletedText);
+void SaveUndoInformation(WindowInfo *window, ssize_t pos, ssize_t nInserted,
+	ssize_t nDeleted, const char *deletedText);
+void SaveUndoEdits(WindowInfo *window, const bufModification *mods,
+	int nMods);
+void FinishUndoBatch(WindowInfo *window);
 void ClearUndoList(WindowInfo *window);
 void ClearRedoList(WindowInfo *window);
 
@@ -232,8 +232,8 @@ static void showStatsForm(WindowInfo *window);
 static void addToWindowList(WindowInfo *window);
 static void removeFromWindowList(WindowInfo *window);
 static void focusCB(Widget w, WindowInfo *window, XtPointer callData);
-static void modifiedCB(int pos, int nInserted, int nDeleted, int nRestyled,
-        const char *deletedText, void *cbArg);
+static void modifiedCB(ssize_t pos, ssize_t nInserted, ssize_t nDeleted,
+        ssize_t nRestyled, const char *deletedText, void *cbArg);
 static void beginModifyCB(void *cbArg);
 static void endModifyCB(void *cbArg);
 static void movedCB(Widget w, WindowInfo *window, XtPointer callData);
@@ -420,6 +420,8 @@ WindowInfo *CreateWindow(const char *name, char *geometry, int iconic)
     window->redo = NULL;
     window->undo_batch_begin = NULL;
     window->undo_batch_count = 0;
+    window->undo_batch_open = False;
+    window->undo_batch_single_cursor = False;
     window->undo_op_batch_size = 0;
     window->nPanes = 0;
     window->autoSaveCharCount = 0;
@@ -910,6 +912,8 @@ WindowInfo *CreateWindow(const char *name, char *geometry, int iconic)
        the text display's callback is called upon to display a modification */
     window->buffer = BufCreate();
     BufAddModifyCB(window->buffer, SyntaxHighlightModifyCB, window);
+    BufAddBeginModifyCB(window->buffer, SyntaxHighlightBeginModifyCB, window);
+    BufAddEndModifyCB(window->buffer, SyntaxHighlightEndModifyCB, window);
     
     /* Attach the buffer to the text widget, and add callbacks for modify */
     TextSetBuffer(text, window->buffer);
@@ -1454,6 +1458,9 @@ void CloseWindow(WindowInfo *window)
        deallocated when the last text widget is destroyed */
     BufRemoveModifyCB(window->buffer, modifiedCB, window);
     BufRemoveModifyCB(window->buffer, SyntaxHighlightModifyCB, window);
+    BufRemoveBeginModifyCB(window->buffer, SyntaxHighlightBeginModifyCB,
+            window);
+    BufRemoveEndModifyCB(window->buffer, SyntaxHighlightEndModifyCB, window);
 
 #ifdef ROWCOLPATCH
     patchRowCol(window->menuBar);
@@ -2771,7 +2778,8 @@ void UpdateWindowReadOnly(WindowInfo *window)
 */
 int GetSimpleSelection(textBuffer *buf, int *left, int *right)
 {
-    int selStart, selEnd, isRect, rectStart, rectEnd, lineStart;
+    ssize_t selStart, selEnd, lineStart;
+    int isRect, rectStart, rectEnd;
 
     /* get the character to match and its position from the selection, or
        the character before the insert point if nothing is selected.
@@ -2798,7 +2806,8 @@ int GetSimpleSelection(textBuffer *buf, int *left, int *right)
 */
 void MakeSelectionVisible(WindowInfo *window, Widget textPane)
 {
-    int left, right, isRect, rectStart, rectEnd, horizOffset;
+    ssize_t left, right;
+    int isRect, rectStart, rectEnd, horizOffset;
     int scrollOffset, leftX, rightX, y, rows, margin;
     int topLineNum, lastLineNum, rightLineNum, leftLineNum, linesToScroll;
     textDisp *textD = ((TextWidget)textPane)->text.textD;
@@ -2988,15 +2997,23 @@ static void movedCB(Widget w, WindowInfo *window, XtPointer callData)
     }
 }
 
-static void modifiedCB(int pos, int nInserted, int nDeleted, int nRestyled,
-        const char *deletedText, void *cbArg) 
+static void modifiedCB(ssize_t pos, ssize_t nInserted, ssize_t nDeleted,
+        ssize_t nRestyled, const char *deletedText, void *cbArg) 
 {
     WindowInfo *window = (WindowInfo *)cbArg;
     int selected = window->buffer->primary.selected;
+    const bufModification *mods;
+    int i, nMods = BufGetModifications(window->buffer, &mods);
     
     /* update the table of bookmarks */
     if (!window->ignoreModify) {
-        UpdateMarkTable(window, pos, nInserted, nDeleted);
+        if (nMods > 0) {
+            for (i=0; i<nMods; i++)
+                UpdateMarkTable(window, mods[i].pos, mods[i].nInserted,
+                        mods[i].nDeleted);
+        } else {
+            UpdateMarkTable(window, pos, nInserted, nDeleted);
+        }
     }
     
     /* Check and dim/undim selection related menu items */
@@ -3035,8 +3052,14 @@ static void modifiedCB(int pos, int nInserted, int nDeleted, int nRestyled,
     updateLineNumDisp(window);
 
     /* Save information for undoing this operation (this call also counts
-       characters and editing operations for triggering autosave */
-    SaveUndoInformation(window, pos, nInserted, nDeleted, deletedText);
+       characters and editing operations for triggering autosave.  Several
+       edits made at once are saved in one record, which is undone at once
+       and leaves a cursor at each */
+    if (nMods > 0) {
+        SaveUndoEdits(window, mods, nMods);
+    } else {
+        SaveUndoInformation(window, pos, nInserted, nDeleted, deletedText);
+    }
     
     /* Trigger automatic backup if operation or character limits reached */
     if (window->autoSave &&
@@ -3051,7 +3074,7 @@ static void modifiedCB(int pos, int nInserted, int nDeleted, int nRestyled,
     SetWindowModified(window, TRUE);
 
     /* Update # of bytes, and line and col statistics */
-    if(!window->undo_batch_begin) {
+    if(!window->undo_batch_open) {
         UpdateStatsLine(window);
     }
     
@@ -3067,15 +3090,24 @@ static void beginModifyCB(void *cbArg) {
     WindowInfo *window = cbArg;
     window->undo_batch_begin = window->undo;
     window->undo_batch_count = 0;
+    window->undo_batch_open = True;
 }
 
 static void endModifyCB(void *cbArg) {
     WindowInfo *window = cbArg;
-    if(window->undo_batch_begin && window->undo_batch_count > 1) {
+    int batchSaved = window->undo_batch_open &&
+            window->undo != window->undo_batch_begin;
+    if(window->undo_batch_open && window->undo_batch_count > 1) {
         window->undo->numOp = window->undo_batch_count;
     }
     window->undo_batch_begin = NULL;
     window->undo_batch_count = 0;
+    window->undo_batch_open = False;
+    window->undo_batch_single_cursor = False;
+    if(batchSaved) {
+        // count the batch as one undo operation, now that it is complete
+        FinishUndoBatch(window);
+    }
     UpdateStatsLine(window);
 }
 
@@ -3417,7 +3449,7 @@ void UpdateStatsLine(WindowInfo *window)
             (window->fileFormat == MAC_FILE_FORMAT ? " Mac" : "");
     int nCursors = TextNumCursors(window->lastFocus);
     if (!TextPosToLineAndCol(window->lastFocus, pos, &line, &colNum)) {
-        sprintf(string, "%s%s%s %d bytes", window->path, window->filename,
+        sprintf(string, "%s%s%s %zd bytes", window->path, window->filename,
                 format, window->buffer->length);
         if(nCursors == 1) {
             snprintf(slinecol, 42, "S: --- L: ---  C: ---");
@@ -3453,11 +3485,11 @@ void UpdateStatsLine(WindowInfo *window)
             snprintf(slinecol, 42, "%d cursors", nCursors);
         }
         if (window->showLineNumbers)
-            sprintf(string, "%s%s%s byte %d of %d", window->path,
+            sprintf(string, "%s%s%s byte %d of %zd", window->path,
                     window->filename, format, pos, 
                     window->buffer->length);
         else
-            sprintf(string, "%s%s%s %d bytes", window->path,
+            sprintf(string, "%s%s%s %zd bytes", window->path,
                     window->filename, format, window->buffer->length);
     }
     
@@ -4213,6 +4245,8 @@ WindowInfo* CreateDocument(WindowInfo* shellWindow, const char* name)
        the text display's callback is called upon to display a modification */
     window->buffer = BufCreate();
     BufAddModifyCB(window->buffer, SyntaxHighlightModifyCB, window);
+    BufAddBeginModifyCB(window->buffer, SyntaxHighlightBeginModifyCB, window);
+    BufAddEndModifyCB(window->buffer, SyntaxHighlightEndModifyCB, window);
     
     /* Attach the buffer to the text widget, and add callbacks for modify */
     TextSetBuffer(text, window->buffer);
@@ -0,0 +1,184 @@
+/*******************************************************************************
+*                                                                              *
+* bufCallbacks.c -- Text buffer callbacks get their own arguments              *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Registers modify, pre-delete, begin and end modify callbacks on a text
+** buffer, each with an argument of its own, in the order the editor does
+** (including a high priority modify callback, as rangesets add), and
+** checks that every call made by edits, batches of edits, and
+** BufApplyEdits passes each callback the argument it was registered with.
+** Callbacks are then removed, and the rest must still get their own.
+**
+** Usage: bufCallbacks
+*/
+
+#include "../source/textBuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The arguments of the callbacks: the address of each is given as the
+   argument of one callback, which counts its calls in it */
+typedef struct {
+    const char *name;
+    int calls;
+} callbackArg;
+
+static callbackArg HighModify = {"high priority modify"},
+        Modify1 = {"first modify"}, Modify2 = {"second modify"},
+        PreDelete = {"pre-delete"},
+        Begin1 = {"first begin modify"}, Begin2 = {"second begin modify"},
+        End1 = {"first end modify"}, End2 = {"second end modify"};
+
+static int NErrors;
+
+static void check(void *cbArg, callbackArg *expected)
+{
+    if (cbArg != expected) {
+        if (NErrors++ < 10)
+            fprintf(stderr, "bufCallbacks: the %s callback got the argument "
+                    "of the %s callback\n", expected->name,
+                    cbArg == NULL ? "(none)" : ((callbackArg *)cbArg)->name);
+        return;
+    }
+    expected->calls++;
+}
+
+static void highModifyCB(ssize_t pos, ssize_t nInserted, ssize_t nDeleted,
+        ssize_t nRestyled, const char *deletedText, void *cbArg)
+{
+    check(cbArg, &HighModify);
+}
+
+static void modify1CB(ssize_t pos, ssize_t nInserted, ssize_t nDeleted,
+        ssize_t nRestyled, const char *deletedText, void *cbArg)
+{
+    check(cbArg, &Modify1);
+}
+
+static void modify2CB(ssize_t pos, ssize_t nInserted, ssize_t nDeleted,
+        ssize_t nRestyled, const char *deletedText, void *cbArg)
+{
+    check(cbArg, &Modify2);
+}
+
+static void preDeleteCB(ssize_t pos, ssize_t nDeleted, void *cbArg)
+{
+    check(cbArg, &PreDelete);
+}
+
+static void begin1CB(void *cbArg)
+{
+    check(cbArg, &Begin1);
+}
+
+static void begin2CB(void *cbArg)
+{
+    check(cbArg, &Begin2);
+}
+
+static void end1CB(void *cbArg)
+{
+    check(cbArg, &End1);
+}
+
+static void end2CB(void *cbArg)
+{
+    check(cbArg, &End2);
+}
+
+/* Make some edits of every kind, in and out of batches */
+static void edit(textBuffer *buf)
+{
+    bufEdit edits[3];
+    
+    BufInsert(buf, 0, "the quick brown fox\n");
+    BufRemove(buf, 4, 10);
+    BufBeginModifyBatch(buf);
+    BufInsert(buf, 0, "jumps ");
+    BufReplace(buf, 0, 2, "JU");
+    BufEndModifyBatch(buf);
+    edits[0].pos = 0;
+    edits[0].nDeleted = 1;
+    edits[0].text = "j";
+    edits[1].pos = 3;
+    edits[1].nDeleted = 0;
+    edits[1].text = "xx";
+    edits[2].pos = 8;
+    edits[2].nDeleted = 2;
+    edits[2].text = "";
+    BufBeginModifyBatch(buf);
+    BufApplyEdits(buf, edits, 3);
+    BufEndModifyBatch(buf);
+}
+
+/* Check that the callbacks in "args" were all called, and clear the
+   counts */
+static void checkCalled(callbackArg **args, int nArgs)
+{
+    int i;
+    
+    for (i=0; i<nArgs; i++) {
+        if (args[i]->calls == 0) {
+            fprintf(stderr, "bufCallbacks: the %s callback was not called\n",
+                    args[i]->name);
+            NErrors++;
+        }
+        args[i]->calls = 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    textBuffer *buf = BufCreate();
+    callbackArg *all[] = {&HighModify, &Modify1, &Modify2, &PreDelete,
+            &Begin1, &Begin2, &End1, &End2};
+    callbackArg *remaining[] = {&HighModify, &Modify2, &PreDelete, &Begin2,
+            &End1};
+    
+    /* The order of window.c and highlight.c: the display, then syntax
+       highlighting and the window, with rangesets in front */
+    BufAddModifyCB(buf, modify1CB, &Modify1);
+    BufAddPreDeleteCB(buf, preDeleteCB, &PreDelete);
+    BufAddBeginModifyCB(buf, begin1CB, &Begin1);
+    BufAddEndModifyCB(buf, end1CB, &End1);
+    BufAddModifyCB(buf, modify2CB, &Modify2);
+    BufAddBeginModifyCB(buf, begin2CB, &Begin2);
+    BufAddEndModifyCB(buf, end2CB, &End2);
+    BufAddHighPriorityModifyCB(buf, highModifyCB, &HighModify);
+    edit(buf);
+    checkCalled(all, sizeof(all) / sizeof(all[0]));
+    
+    BufRemoveModifyCB(buf, modify1CB, &Modify1);
+    BufRemoveBeginModifyCB(buf, begin1CB, &Begin1);
+    BufRemoveEndModifyCB(buf, end2CB, &End2);
+    edit(buf);
+    if (Modify1.calls != 0 || Begin1.calls != 0 || End2.calls != 0) {
+        fprintf(stderr, "bufCallbacks: a removed callback was called\n");
+        NErrors++;
+    }
+    checkCalled(remaining, sizeof(remaining) / sizeof(remaining[0]));
+    
+    BufFree(buf);
+    if (NErrors != 0) {
+        fprintf(stderr, "bufCallbacks: %d errors\n", NErrors);
+        return 1;
+    }
+    printf("bufCallbacks: ok\n");
+    return 0;
+}
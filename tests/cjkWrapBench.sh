@@ -0,0 +1,80 @@
+#!/bin/sh
+#
+# Time taken to show continuously wrapped Chinese text, whose characters
+# are measured one by one to find where lines wrap, and with a proportional
+# font come from a fallback font (see FindFont and FontCharWidth in
+# textDisp.c).  The text is MB megabytes of paragraphs of fifty to three
+# thousand characters, mostly Chinese with a few Latin words.  Each case
+# turns on continuous wrap and pages down STEPS times, jumping to another
+# part of the file every tenth step, with the default font and with an
+# anti-aliased proportional font.  A case is run with no steps and with
+# STEPS steps, and the difference in time is the time of the steps, while
+# render_stats() shows the part of it spent drawing.  Needs a display.
+#
+# Usage: cjkWrapBench.sh [MB [STEPS [xnedit]]]
+#
+
+MB=${1:-100}
+STEPS=${2:-500}
+XNEDIT=${3:-../source/xnedit}
+TEXT=${TMPDIR:-/tmp}/cjkWrapBench.$$.txt
+PROPFONT="Sans-12:antialias=true"
+
+trap 'rm -f "$TEXT" "$TEXT.1" "$TEXT.out"' 0 1 2 15
+
+# A paragraph of 1 to 60 times the sentences on each line
+awk 'BEGIN {
+    s = "敏捷的棕色狐狸跳过了懒狗，XNEdit 在长行中自动换行。" \
+        "中文文本没有空格，所以每个字符之间都可以换行。"
+    for (i = 0; i < 1000; i++) {
+        p = s
+        for (n = i * 7 % 60; n > 0; n--)
+            p = p s
+        print p
+    }
+}' > "$TEXT.1"
+: > "$TEXT"
+while [ `wc -c < "$TEXT"` -lt `expr $MB \* 1048576` ]; do
+    cat "$TEXT.1" >> "$TEXT"
+done
+
+now() {
+    date +%s%N
+}
+
+# Run case "$1", with the macro "$2" setting up the font
+runCase() {
+    for n in 0 $STEPS; do
+        start=`now`
+        "$XNEDIT" -geometry 100x50 -do "
+            $2
+            set_wrap_text(\"continuous\")
+            render_stats(\"reset\")
+            for (i = 0; i < $n; i++) {
+                if (i % 10 == 9)
+                    set_cursor_pos(\$text_length / $n * i)
+                else
+                    scroll_down(1, \"page\")
+                render_stats()
+            }
+            if ($n > 0)
+                t_print(render_stats())
+            exit()" "$TEXT" > "$TEXT.out"
+        end=`now`
+        if [ $n = 0 ]; then
+            base=`expr $end - $start`
+        else
+            steps=`expr $end - $start - $base`
+        fi
+    done
+    awk -v name="$1" -v n=$STEPS -v ns=$steps 'BEGIN {
+        printf "%s: %d steps in %.3f s, %.2f ms per step\n", name, n,
+                ns / 1e9, ns / 1e6 / n }'
+    cat "$TEXT.out"
+    echo
+}
+
+echo "Continuous wrap in $MB MB of Chinese text:"
+runCase "Default font" ""
+runCase "$PROPFONT" \
+    "set_fonts(\"$PROPFONT\", \"$PROPFONT:bold\", \"$PROPFONT:italic\", \"$PROPFONT:bold:italic\")"
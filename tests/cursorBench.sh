@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+# Time taken by typing with many cursors, with syntax highlighting on and
+# off, for each number of cursors in CURSORS (10000, 50000 and 100000 by
+# default).  The cursors are put on consecutive lines of some of XNEdit's
+# own C sources, then KEYS characters are typed, each inserted at every
+# cursor as a single batch of edits.  Each case is run with no keys typed and with
+# KEYS, and the difference is the time of the typing, including the X
+# server's work.  Needs a display.
+#
+# Usage: cursorBench.sh ["CURSORS..." [KEYS [xnedit]]]
+#
+
+CURSORS=${1:-10000 50000 100000}
+KEYS=${2:-20}
+XNEDIT=${3:-../source/xnedit}
+TEXT=${TMPDIR:-/tmp}/cursorBench.$$.c
+
+trap 'rm -f "$TEXT"' 0 1 2 15
+
+: > "$TEXT"
+MAXCURSORS=`echo $CURSORS | tr ' ' '\n' | sort -n | tail -1`
+while [ `wc -l < "$TEXT"` -le $MAXCURSORS ]; do
+    cat ../source/*.c >> "$TEXT"
+done
+
+now() {
+    date +%s%N
+}
+
+# Type at "$3" cursors with highlighting "$2" (0 or 1), described as "$1"
+runCase() {
+    for n in 0 $KEYS; do
+        start=`now`
+        "$XNEDIT" -do "
+            set_highlight_syntax($2)
+            for (i = 1; i < $3; i++)
+                add_cursor_down()
+            for (i = 0; i < $n; i++)
+                insert_string(\"x\")
+            close(\"nosave\")
+            exit()" "$TEXT"
+        end=`now`
+        if [ $n = 0 ]; then
+            base=`expr $end - $start`
+        else
+            keys=`expr $end - $start - $base`
+        fi
+    done
+    awk -v name="$1" -v c=$3 -v n=$KEYS -v ns=$keys 'BEGIN {
+        printf "%s, %d cursors: %d keys in %.3f s, %.2f ms per key\n", name,
+                c, n, ns / 1e9, ns / 1e6 / n }'
+}
+
+for c in $CURSORS; do
+    runCase "Highlighting off" 0 $c
+    runCase "Highlighting on" 1 $c
+done
@@ -0,0 +1,226 @@
+/*******************************************************************************
+*                                                                              *
+* cursorEditBench.c -- Typing at many cursors, one at a time or at once        *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Types KEYS characters at each of 10000, 50000 and 100000 cursors (or the
+** numbers given), one line apart, two ways: inserting at every cursor in
+** turn, as the editor once did, and at all of them at once with
+** BufApplyEdits.  A modify callback stands in for the editor's undo list,
+** keeping a record of each modification like undo.c does, with all of the
+** edits of one made by BufApplyEdits in a single record (SaveUndoEdits).
+** Prints the time per key, and the records and memory kept; the text must
+** come out the same both ways.
+**
+** Usage: cursorEditBench [cursors...]
+*/
+
+#include "../source/textBuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define KEYS 20
+#define LINE "    x = y + z;\n"
+
+/* The parts of an undo record (UndoInfo in nedit.h) which take memory */
+typedef struct {
+    ssize_t startPos;
+    ssize_t endPos;
+    char *oldText;
+} undoEdit;
+
+typedef struct _undoRecord {
+    struct _undoRecord *next;
+    ssize_t startPos;
+    ssize_t endPos;
+    char *oldText;
+    int nEdits;
+    undoEdit *edits;
+} undoRecord;
+
+typedef struct {
+    textBuffer *buf;
+    undoRecord *records;
+    long nRecords;
+    long memUsed;
+} undoList;
+
+static double now(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void modifiedCB(ssize_t pos, ssize_t nInserted, ssize_t nDeleted,
+	ssize_t nRestyled, const char *deletedText, void *cbArg)
+{
+    undoList *list = cbArg;
+    const bufModification *mods;
+    int i, nMods = BufGetModifications(list->buf, &mods);
+    undoRecord *rec = calloc(1, sizeof(undoRecord));
+    char *text;
+    
+    rec->startPos = pos;
+    rec->endPos = pos + nInserted;
+    if (nMods > 1) {
+        size_t textLen = 0;
+        for (i=0; i<nMods; i++)
+            textLen += mods[i].nDeleted + 1;
+        rec->oldText = text = malloc(textLen);
+        rec->nEdits = nMods;
+        rec->edits = malloc(sizeof(undoEdit) * nMods);
+        for (i=0; i<nMods; i++) {
+            rec->edits[i].startPos = mods[i].pos;
+            rec->edits[i].endPos = mods[i].pos + mods[i].nInserted;
+            rec->edits[i].oldText = text;
+            memcpy(text, mods[i].deletedText, mods[i].nDeleted);
+            text[mods[i].nDeleted] = '\0';
+            text += mods[i].nDeleted + 1;
+        }
+        list->memUsed += textLen + sizeof(undoEdit) * nMods;
+    } else if (nDeleted > 0) {
+        rec->oldText = strdup(deletedText);
+        list->memUsed += nDeleted + 1;
+    }
+    rec->next = list->records;
+    list->records = rec;
+    list->nRecords++;
+    list->memUsed += sizeof(undoRecord);
+}
+
+static void freeUndoList(undoList *list)
+{
+    undoRecord *rec;
+    
+    while ((rec = list->records) != NULL) {
+        list->records = rec->next;
+        free(rec->oldText);
+        free(rec->edits);
+        free(rec);
+    }
+}
+
+/* A buffer of "nCursors" lines, with an undo list, and the positions of
+   the starts of the lines in "cursors" */
+static textBuffer *makeBuffer(int nCursors, undoList *list, ssize_t *cursors)
+{
+    size_t lineLen = strlen(LINE);
+    char *text = malloc(lineLen * nCursors + 1);
+    textBuffer *buf;
+    int i;
+    
+    for (i=0; i<nCursors; i++) {
+        memcpy(text + lineLen * i, LINE, lineLen);
+        cursors[i] = lineLen * i;
+    }
+    text[lineLen * nCursors] = '\0';
+    buf = BufCreate();
+    BufSetAll(buf, text);
+    free(text);
+    memset(list, 0, sizeof(undoList));
+    list->buf = buf;
+    BufAddModifyCB(buf, modifiedCB, list);
+    return buf;
+}
+
+static void report(const char *how, int nCursors, double time,
+        const undoList *list)
+{
+    printf("  %-12s %8.2f ms per key, %7ld undo records, %7.1f MB\n", how,
+            time * 1e3 / KEYS, list->nRecords, list->memUsed / 1048576.0);
+}
+
+/* Type at "nCursors" cursors both ways, and return 1 if the text differs */
+static int runCase(int nCursors)
+{
+    ssize_t *cursors = malloc(sizeof(ssize_t) * nCursors);
+    bufEdit *edits = malloc(sizeof(bufEdit) * nCursors);
+    undoList list;
+    textBuffer *buf;
+    char *oneAtATime, *atOnce;
+    double start;
+    int i, k, differs;
+    
+    printf("%d cursors, %d keys:\n", nCursors, KEYS);
+    
+    /* Insert at each cursor in turn, at its position moved by the inserts
+       before it */
+    buf = makeBuffer(nCursors, &list, cursors);
+    start = now();
+    for (k=0; k<KEYS; k++) {
+        BufBeginModifyBatch(buf);
+        for (i=0; i<nCursors; i++) {
+            cursors[i] += i;
+            BufInsert(buf, cursors[i], "x");
+            cursors[i]++;
+        }
+        BufEndModifyBatch(buf);
+    }
+    report("one at a time", nCursors, now() - start, &list);
+    oneAtATime = BufGetAll(buf);
+    freeUndoList(&list);
+    BufFree(buf);
+    
+    /* Insert at all of the cursors in one modification */
+    buf = makeBuffer(nCursors, &list, cursors);
+    start = now();
+    for (k=0; k<KEYS; k++) {
+        BufBeginModifyBatch(buf);
+        for (i=0; i<nCursors; i++) {
+            edits[i].pos = cursors[i];
+            edits[i].nDeleted = 0;
+            edits[i].text = "x";
+        }
+        BufApplyEdits(buf, edits, nCursors);
+        for (i=0; i<nCursors; i++)
+            cursors[i] += i + 1;
+        BufEndModifyBatch(buf);
+    }
+    report("at once", nCursors, now() - start, &list);
+    atOnce = BufGetAll(buf);
+    freeUndoList(&list);
+    BufFree(buf);
+    
+    differs = strcmp(oneAtATime, atOnce) != 0;
+    if (differs)
+        printf("cursorEditBench: the text differs with %d cursors\n",
+                nCursors);
+    free(oneAtATime);
+    free(atOnce);
+    free(cursors);
+    free(edits);
+    return differs;
+}
+
+int main(int argc, char **argv)
+{
+    static const int defaultCursors[] = {10000, 50000, 100000};
+    int i, errors = 0;
+    
+    if (argc > 1) {
+        for (i=1; i<argc; i++)
+            errors += runCase(atoi(argv[i]));
+    } else {
+        for (i=0; i<3; i++)
+            errors += runCase(defaultCursors[i]);
+    }
+    return errors != 0;
+}
@@ -0,0 +1,80 @@
+#!/bin/sh
+#
+# Time taken to open files which have to be converted to UTF-8, for a
+# corpus made with iconv: UTF-16LE, UTF-16BE and GB18030 (each with a byte
+# order mark), and ISO-8859-1 and ISO-8859-5 (with the charset extended
+# attribute, if setfattr is there).  Each file holds about MB megabytes of
+# text when converted.  xnedit writes out the text it loaded, which must
+# be the same as the UTF-8 original, and the time of opening an empty file
+# is taken off the time of each.  Needs a display.
+#
+# Usage: encodingBench.sh [MB [xnedit]]
+#
+
+MB=${1:-64}
+XNEDIT=${2:-../source/xnedit}
+DIR=${TMPDIR:-/tmp}/encodingBench.$$
+
+trap 'rm -rf "$DIR"' 0 1 2 15
+
+mkdir "$DIR" || exit 2
+
+# "$2" repeated to about MB megabytes in "$DIR/$1.utf8"
+makeText() {
+    printf '%s\n' "$2" > "$DIR/$1.utf8"
+    while [ `wc -c < "$DIR/$1.utf8"` -lt `expr $MB \* 1048576` ]; do
+        cat "$DIR/$1.utf8" "$DIR/$1.utf8" > "$DIR/$1.tmp"
+        mv "$DIR/$1.tmp" "$DIR/$1.utf8"
+    done
+}
+makeText mixed "Grüße, Привет, 你好, γειά σου: the quick brown fox"
+makeText chinese "敏捷的棕色狐狸跳过了懒狗。中文文本的编码测试。"
+makeText latin1 "Größe, Straße, Ærø, café, naïve, señor, þorn"
+makeText cyrillic "Съешь же ещё этих мягких французских булок, да выпей чаю"
+
+# Convert "$1.utf8" to "$2", optionally after the byte order mark "$3"
+makeFile() {
+    printf "$3" > "$DIR/$1.$2"
+    iconv -f UTF-8 -t $2 "$DIR/$1.utf8" >> "$DIR/$1.$2" || exit 2
+}
+makeFile mixed UTF-16LE '\377\376'
+makeFile mixed UTF-16BE '\376\377'
+makeFile chinese GB18030 '\204\061\225\063'
+makeFile latin1 ISO-8859-1
+makeFile cyrillic ISO-8859-5
+if command -v setfattr > /dev/null; then
+    setfattr -n user.charset -v ISO-8859-1 "$DIR/latin1.ISO-8859-1"
+    setfattr -n user.charset -v ISO-8859-5 "$DIR/cyrillic.ISO-8859-5"
+fi
+: > "$DIR/empty"
+
+now() {
+    date +%s%N
+}
+
+# Open "$1" and write out its text to "$DIR/out", and print the time taken
+openTime() {
+    start=`now`
+    "$XNEDIT" -do "
+        write_file(get_range(0, \$text_length), \"$DIR/out\")
+        exit()" "$1"
+    end=`now`
+    expr $end - $start
+}
+
+base=`openTime "$DIR/empty"`
+echo "Opening about $MB MB of converted text:"
+for f in mixed.UTF-16LE mixed.UTF-16BE chinese.GB18030 latin1.ISO-8859-1 \
+        cyrillic.ISO-8859-5; do
+    ns=`openTime "$DIR/$f"`
+    if cmp -s "$DIR/out" "$DIR/${f%%.*}.utf8"; then
+        result=""
+    else
+        result=", WRONG TEXT"
+    fi
+    awk -v name="${f#*.}" -v bytes=`wc -c < "$DIR/$f"` -v ns=$ns \
+            -v base=$base -v result="$result" 'BEGIN {
+        printf "  %-12s %4d MB in %.3f s, %6.1f MB/s%s\n", name,
+                bytes / 1048576, (ns - base) / 1e9,
+                bytes / 1048576 / ((ns - base) / 1e9), result }'
+done
@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# Speed of export_highlighting, in MB/s as a whole and per thread, for 1, 2,
+# 4, ... threads up to the number of processors.  The text is some of
+# XNEdit's own C sources, repeated to about SIZE_MB megabytes.  Needs a
+# display, as xnedit is run to do the exporting.
+#
+# Usage: exportBench.sh [SIZE_MB [xnedit]]
+#
+
+SIZE_MB=${1:-32}
+XNEDIT=${2:-../source/xnedit}
+TEXT=${TMPDIR:-/tmp}/exportBench.$$.c
+NPROC=`getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1`
+
+trap 'rm -f "$TEXT"' 0 1 2 15
+
+: > "$TEXT"
+while [ `wc -c < "$TEXT"` -lt `expr $SIZE_MB \* 1048576` ]; do
+    cat ../source/*.c >> "$TEXT"
+done
+
+"$XNEDIT" -do "
+    for (n = 1; n <= $NPROC; n = n * 2) {
+        if (!export_highlighting(\"/dev/null\", \"html\", n)) {
+            t_print(\"export failed\\n\")
+            break
+        }
+        t_print(highlight_profile(\"export\") \"\\n\")
+    }
+    exit()" "$TEXT"
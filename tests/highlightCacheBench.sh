@@ -0,0 +1,75 @@
+#!/bin/sh
+#
+# Start up time and memory of opening many C files at once, which share one
+# compiled copy of the C highlighting patterns.  For each number of files
+# in NFILES, that many of XNEdit's own C sources are opened in tabs of one
+# window, each tab is brought to the front (which turns on its deferred
+# highlighting), and the editor's resident memory and the highlight pattern
+# cache hits and misses are printed.  The same files opened as plain text
+# give the time and memory taken by everything but highlighting, which are
+# taken off, leaving what highlighting adds per file.  Needs a display.
+#
+# Usage: highlightCacheBench.sh ["NFILES" [xnedit]]
+#
+
+NFILES=${1:-"1 100 400"}
+XNEDIT=${2:-../source/xnedit}
+DIR=${TMPDIR:-/tmp}/highlightCacheBench.$$
+
+trap 'rm -rf "$DIR"' 0 1 2 15
+
+mkdir "$DIR" || exit 2
+
+# The resident memory of the xnedit running this, in kB
+cat > "$DIR/rss" << 'EOF'
+pid=$$
+while [ $pid -gt 1 -a "`cat /proc/$pid/comm`" != xnedit ]; do
+    pid=`awk '/^PPid:/ { print $2 }' /proc/$pid/status`
+done
+awk '/^VmRSS:/ { print $2 }' /proc/$pid/status
+EOF
+
+now() {
+    date +%s%N
+}
+
+# Open "$1" files with extension "$2", and print the time taken, the memory
+# used and the highlight cache hits and misses
+openFiles() {
+    files=""
+    i=0
+    while [ $i -lt $1 ]; do
+        for f in ../source/*.c; do
+            [ $i -ge $1 ] && break
+            i=`expr $i + 1`
+            cp "$f" "$DIR/file$i.$2"
+            files="$files $DIR/file$i.$2"
+        done
+    done
+    last=${files##* }
+    macro="
+        for (i = 0; i < $1; i++)
+            next_document()
+        kb = shell_command(\"sh $DIR/rss\", \"\")
+        kb = substring(kb, 0, length(kb) - 1)
+        t_print(kb \" \" \$highlight_cache_hits \" \" \$highlight_cache_misses)
+        exit()"
+    start=`now`
+    result=`"$XNEDIT" -tabbed ${files% *} -do "$macro" "$last"`
+    end=`now`
+    rm -f $files
+    echo `expr $end - $start` $result
+}
+
+echo "Opening C files, what highlighting adds:"
+for n in $NFILES; do
+    set -- `openFiles $n txt`
+    plainNs=$1 plainKb=$2
+    set -- `openFiles $n c`
+    awk -v n=$n -v ns=$1 -v kb=$2 -v hits=$3 -v misses=$4 \
+            -v plainNs=$plainNs -v plainKb=$plainKb 'BEGIN {
+        printf "  %4d files: %7.1f ms, %7.1f MB, %6.2f ms and %6.1f kB " \
+                "per file, %d cache hits, %d misses\n", n,
+                (ns - plainNs) / 1e6, (kb - plainKb) / 1024,
+                (ns - plainNs) / 1e6 / n, (kb - plainKb) / n, hits, misses }'
+done
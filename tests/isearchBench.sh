@@ -0,0 +1,68 @@
+#!/bin/sh
+#
+# Time taken by incremental searches in a large file just after an edit in
+# its middle, which leaves the buffer gap there.  Literal searches look at
+# the text on both sides of the gap in place, while regular expression
+# searches first move the gap out of the way (see searchBuffer in
+# search.c).  Each round inserts a character in the middle of MB megabytes
+# of XNEdit's own sources, and then types a word found only at the end of
+# the file into the incremental search, a character at a time.  Each case
+# is run with no searches and with ROUNDS rounds of them, and the difference
+# is the time of the searches.  Needs a display.
+#
+# Usage: isearchBench.sh [MB [ROUNDS [xnedit]]]
+#
+
+MB=${1:-256}
+ROUNDS=${2:-20}
+XNEDIT=${3:-../source/xnedit}
+TEXT=${TMPDIR:-/tmp}/isearchBench.$$.c
+WORD=zyzzyva
+
+trap 'rm -f "$TEXT"' 0 1 2 15
+
+: > "$TEXT"
+while [ `wc -c < "$TEXT"` -lt `expr $MB \* 1048576` ]; do
+    cat ../source/*.c >> "$TEXT"
+done
+echo "$WORD" >> "$TEXT"
+
+now() {
+    date +%s%N
+}
+
+# Search with type "$2", described as "$1"
+runCase() {
+    for search in 0 1; do
+        start=`now`
+        "$XNEDIT" -do "
+            middle = \$text_length / 2
+            for (r = 0; r < $ROUNDS; r++) {
+                set_cursor_pos(middle)
+                insert_string(\"x\")
+                for (i = 1; $search && i <= length(\"$WORD\"); i++) {
+                    if (i == 1)
+                        find_incremental(\"z\", \"$2\")
+                    else
+                        find_incremental(substring(\"$WORD\", 0, i), \"$2\",
+                                \"continued\")
+                }
+            }
+            close(\"nosave\")
+            exit()" "$TEXT"
+        end=`now`
+        if [ $search = 0 ]; then
+            base=`expr $end - $start`
+        else
+            searches=`expr $end - $start - $base`
+        fi
+    done
+    awk -v name="$1" -v r=$ROUNDS -v n=${#WORD} -v ns=$searches 'BEGIN {
+        printf "%s: %d searches in %.3f s, %.2f ms per search\n", name,
+                r * n, ns / 1e9, ns / 1e6 / (r * n) }'
+}
+
+echo "Incremental search in $MB MB, after an edit in the middle:"
+runCase "Literal" literal
+runCase "Case sensitive" case
+runCase "Regular expression" regex
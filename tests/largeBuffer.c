@@ -0,0 +1,259 @@
+/*******************************************************************************
+*                                                                              *
+* largeBuffer.c -- Text buffer test with buffers larger than 2 GB              *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Loads a synthetic file of the given size (6 GB by default) into a text
+** buffer, edits and searches it at positions beyond 2 and 4 GB, saves it,
+** and checks that the saved file matches the buffer.  The searches run the
+** literal and regular expression matchers behind SearchString over the
+** whole text, and a Replace All replaces what they find.  The file is loaded
+** the way the editor opens large files, by mapping it and copying it into
+** the buffer once, so the test needs a little more memory than the file size.
+**
+** Usage: largeBuffer [size in MB [directory]]
+*/
+
+#include "../source/textBuf.h"
+#include "../source/litSearch.h"
+#include "../source/regularExp.h"
+#include "../util/nedit_malloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LINE_LEN 64
+#define CHUNK_SIZE (1 << 20)
+
+static int failures = 0;
+
+#define CHECK(cond) check(cond, #cond, __LINE__)
+
+static void check(int cond, const char *what, int line)
+{
+    if (!cond) {
+        fprintf(stderr, "largeBuffer.c:%d: check failed: %s\n", line, what);
+        failures++;
+    }
+}
+
+/* Line number "n" of the synthetic file, LINE_LEN bytes with the newline */
+static void makeLine(char *out, long n)
+{
+    char text[LINE_LEN + 16];
+    
+    snprintf(text, sizeof(text),
+            "%012ld the quick brown fox jumps over the lazy dog %06ld\n",
+            n, n % 999983);
+    memcpy(out, text, LINE_LEN);
+}
+
+static int writeSyntheticFile(const char *path, ssize_t size)
+{
+    char *chunk = malloc(CHUNK_SIZE);
+    FILE *fp = fopen(path, "wb");
+    ssize_t written = 0;
+    long line = 0;
+    
+    if (fp == NULL || chunk == NULL)
+        return 0;
+    while (written < size) {
+        ssize_t n = 0;
+        while (n + LINE_LEN <= CHUNK_SIZE)
+            makeLine(chunk + n, line++), n += LINE_LEN;
+        if (n > size - written)
+            n = size - written;
+        if (fwrite(chunk, 1, n, fp) != (size_t)n)
+            return 0;
+        written += n;
+    }
+    free(chunk);
+    return fclose(fp) == 0;
+}
+
+static textBuffer *loadFile(const char *path)
+{
+    struct stat st;
+    textBuffer *buf;
+    char *map, *text;
+    int fd = open(path, O_RDONLY);
+    
+    if (fd < 0 || fstat(fd, &st) != 0)
+        return NULL;
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+    text = BufAllocText(st.st_size);
+    memcpy(text, map, st.st_size);
+    munmap(map, st.st_size);
+    buf = BufCreate();
+    BufTakeAll(buf, text, st.st_size);
+    return buf;
+}
+
+/* Write the buffer the way the gap buffer holds it, in two segments */
+static int saveFile(textBuffer *buf, const char *path)
+{
+    const char *before, *after;
+    ssize_t beforeLen = buf->gapStart;
+    FILE *fp = fopen(path, "wb");
+    
+    if (fp == NULL)
+        return 0;
+    if (!BufGetGapSegments(buf, &before, &after)) {
+        before = BufAsString(buf);
+        beforeLen = buf->length;
+        after = "";
+    }
+    if (fwrite(before, 1, beforeLen, fp) != (size_t)beforeLen ||
+            fwrite(after, 1, buf->length - beforeLen, fp) !=
+            (size_t)(buf->length - beforeLen))
+        return 0;
+    return fclose(fp) == 0;
+}
+
+static int fileMatchesBuffer(textBuffer *buf, const char *path)
+{
+    char *chunk = malloc(CHUNK_SIZE + 1);
+    FILE *fp = fopen(path, "rb");
+    ssize_t pos = 0;
+    size_t n;
+    int same = 1;
+    
+    if (fp == NULL || chunk == NULL)
+        return 0;
+    while (same && (n = fread(chunk, 1, CHUNK_SIZE, fp)) > 0) {
+        chunk[n] = '\0';
+        same = pos + (ssize_t)n <= buf->length &&
+                BufCmp(buf, pos, n, chunk) == 0;
+        pos += n;
+    }
+    fclose(fp);
+    free(chunk);
+    return same && pos == buf->length;
+}
+
+int main(int argc, char **argv)
+{
+    ssize_t size = (ssize_t)(argc > 1 ? atol(argv[1]) : 6144) << 20;
+    const char *dir = argc > 2 ? argv[2] : getenv("TMPDIR");
+    char inPath[PATH_MAX], outPath[PATH_MAX], line[LINE_LEN + 1];
+    ssize_t pos, found, far, selStart, selEnd;
+    int isRect, rectStart, rectEnd, nLines, matchLen, nReplaced;
+    const char *text, *match;
+    char *reError;
+    litPattern *pat;
+    regexp *re;
+    textBuffer *buf;
+    
+    snprintf(inPath, sizeof(inPath), "%s/xnedit-large-in.txt", dir ? dir : "/tmp");
+    snprintf(outPath, sizeof(outPath), "%s/xnedit-large-out.txt", dir ? dir : "/tmp");
+    size -= size % LINE_LEN;
+    
+    if (!writeSyntheticFile(inPath, size) || (buf = loadFile(inPath)) == NULL) {
+        perror("largeBuffer");
+        return 2;
+    }
+    CHECK(buf->length == size);
+    nLines = BufCountLines(buf, 0, buf->length);
+    CHECK(nLines == size / LINE_LEN);
+    
+    /* Positions past 4 GB, or past 2 GB, when the buffer is that big */
+    if (size > 0x100000000L + 4 * LINE_LEN)
+        far = 0x100000000L + 100;
+    else if (size > (ssize_t)INT_MAX + 4 * LINE_LEN)
+        far = (ssize_t)INT_MAX + 100;
+    else
+        far = size / 2;
+    far -= far % LINE_LEN;
+    makeLine(line, far / LINE_LEN);
+    line[LINE_LEN] = '\0';
+    CHECK(BufCmp(buf, far, LINE_LEN, line) == 0);
+    CHECK(BufStartOfLine(buf, far + 10) == far);
+    CHECK(BufEndOfLine(buf, far) == far + LINE_LEN - 1);
+    
+    /* Edit: insert a marker, replace a word and remove a line */
+    BufInsert(buf, far, "@marker@\n");
+    CHECK(buf->length == size + 9);
+    BufReplace(buf, far + 9 + 17, far + 9 + 22, "QUICK");
+    BufRemove(buf, far + 9 + LINE_LEN, far + 9 + 2 * LINE_LEN);
+    CHECK(buf->length == size + 9 - LINE_LEN);
+    CHECK(BufCountLines(buf, 0, buf->length) == nLines);
+    
+    /* Search for the marker from both ends */
+    CHECK(BufSearchForward(buf, 0, "@", &found) && found == far);
+    CHECK(BufSearchBackward(buf, buf->length - 1, "@", &found) &&
+            found == far + 7);
+    pos = BufCountForwardNLines(buf, 0, far / LINE_LEN);
+    CHECK(pos == far);
+    
+    /* Literal and regular expression searches over the whole text */
+    text = BufAsString(buf);
+    pat = LitCompile("@MARKER@", 0);
+    match = LitFindForward(pat, text, buf->length, &matchLen);
+    CHECK(match != NULL && match - text == far && matchLen == 8);
+    match = LitFindBackward(pat, text, buf->length - 1, buf->length,
+            &matchLen);
+    CHECK(match != NULL && match - text == far);
+    LitFree(pat);
+    re = CompileRE("@m[a-z]+@\\n", &reError, REDFLT_STANDARD);
+    CHECK(re != NULL);
+    CHECK(ExecRE(re, text, text + buf->length, 0, '\0', '\0', NULL, NULL,
+            NULL) && re->startp[0] - text == far &&
+            re->endp[0] - text == far + 9);
+    CHECK(ExecRE(re, text, text + buf->length, 1, '\0', '\0', NULL, NULL,
+            NULL) && re->startp[0] - text == far);
+    NEditFree(re);
+    
+    /* Replace All, with the matches collected first like ReplaceAll does */
+    pat = LitCompile("QUICK", 1);
+    nReplaced = 0;
+    for (pos = 0; (match = LitFindForward(pat, text + pos, buf->length - pos,
+            &matchLen)) != NULL; pos = match - text + matchLen)
+        found = match - text, nReplaced++;
+    LitFree(pat);
+    CHECK(nReplaced == 1 && found == far + 9 + 17);
+    BufReplace(buf, found, found + 5, "slow");
+    CHECK(BufCmp(buf, far + 9 + 13, 14, "the slow brown") == 0);
+    CHECK(buf->length == size + 8 - LINE_LEN);
+    BufReplace(buf, found, found + 4, "QUICK");
+    
+    /* Selections past 2 GB */
+    BufSelect(buf, far, far + 9);
+    CHECK(BufGetSelectionPos(buf, &selStart, &selEnd, &isRect, &rectStart,
+            &rectEnd) && selStart == far && selEnd == far + 9);
+    
+    /* Save, and compare the file with the buffer */
+    if (!saveFile(buf, outPath)) {
+        perror("largeBuffer");
+        return 2;
+    }
+    CHECK(fileMatchesBuffer(buf, outPath));
+    
+    BufFree(buf);
+    unlink(inPath);
+    unlink(outPath);
+    printf("largeBuffer: %ld MB, %s\n", (long)(size >> 20),
+            failures ? "FAILED" : "ok");
+    return failures != 0;
+}
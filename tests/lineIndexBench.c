@@ -0,0 +1,177 @@
+/*******************************************************************************
+*                                                                              *
+* lineIndexBench.c -- Goto line and scrollbar drags in a file of many lines    *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Times the line lookups of textBuf.c in a buffer of 10 million lines (or
+** the number given) of varying length:  going to line 9,000,000 as "Goto
+** Line" does, the first time (which builds the line index) and after that,
+** and dragging the scrollbar, that is finding the start of a line for each
+** of DRAG_STEPS thumb positions from the top to the bottom of the file and
+** the line number of each, with and without an edit (a line inserted in the
+** middle of the file, where the gap stays) between the steps.  A byte at a time scan of the flat text,
+** the way line counting was done before the index, does the same lookups for
+** comparison, and must find the same positions.
+**
+** Usage: lineIndexBench [lines]
+*/
+
+#include "../source/textBuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GOTO_LINE 9000000
+#define DRAG_STEPS 1000
+#define SCAN_STEPS 10
+#define LINE_TEXT "the quick brown fox jumps over the lazy dog 0123456789"
+
+static double now(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* The position of the start of line "line" (counting from 0) in "text" */
+static ssize_t scanLineToPos(const char *text, ssize_t length, ssize_t line)
+{
+    ssize_t pos;
+    
+    for (pos=0; pos<length && line>0; pos++)
+        if (text[pos] == '\n')
+            line--;
+    return pos;
+}
+
+/* The line number (counting from 0) of position "pos" in "text" */
+static ssize_t scanPosToLine(const char *text, ssize_t pos)
+{
+    ssize_t i, line = 0;
+    
+    for (i=0; i<pos; i++)
+        if (text[i] == '\n')
+            line++;
+    return line;
+}
+
+/* The line of step "step" of a drag of the thumb down "nLines" lines */
+static ssize_t dragLine(int step, ssize_t nLines)
+{
+    return (nLines - 1) * step / (DRAG_STEPS - 1);
+}
+
+int main(int argc, char **argv)
+{
+    ssize_t nLines = argc > 1 ? atol(argv[1]) : 10000000;
+    ssize_t i, gotoLine, pos, middle, length, expected, sink = 0;
+    size_t textLen = strlen(LINE_TEXT);
+    textBuffer *buf;
+    char *text, *p;
+    double start, first, later, indexed, scanned;
+    int step, failed = 0;
+    
+    gotoLine = nLines > GOTO_LINE ? GOTO_LINE : nLines * 9 / 10;
+    
+    /* lines of 1 to 55 characters, newline included */
+    srand(1);
+    text = p = malloc(nLines * (textLen + 1) + 1);
+    for (i=0; i<nLines; i++) {
+        size_t len = rand() % (textLen + 1);
+        memcpy(p, LINE_TEXT, len);
+        p += len;
+        *p++ = '\n';
+    }
+    *p = '\0';
+    length = p - text;
+    buf = BufCreate();
+    BufSetAll(buf, text);
+    printf("%ld lines, %.0f MB:\n", (long)nLines, length / 1048576.0);
+    
+    /* Goto Line */
+    start = now();
+    pos = BufCountForwardNLines(buf, 0, gotoLine);
+    first = now() - start;
+    start = now();
+    for (step=0; step<DRAG_STEPS; step++)
+        sink += BufCountForwardNLines(buf, 0, gotoLine);
+    later = (now() - start) / DRAG_STEPS;
+    start = now();
+    expected = scanLineToPos(text, length, gotoLine);
+    scanned = now() - start;
+    if (pos != expected) {
+        printf("  goto line %ld is at %ld, not %ld\n", (long)gotoLine,
+                (long)pos, (long)expected);
+        failed = 1;
+    }
+    printf("  goto line %ld:  %9.1f us first, %7.1f us after, "
+            "%9.1f us scanning\n", (long)gotoLine, first * 1e6, later * 1e6,
+            scanned * 1e6);
+    
+    /* Scrollbar drag, the start of each line and its line number as the
+       line number gutter shows it */
+    start = now();
+    for (step=0; step<DRAG_STEPS; step++) {
+        pos = BufCountForwardNLines(buf, 0, dragLine(step, nLines));
+        sink += BufCountLines(buf, 0, pos);
+    }
+    indexed = (now() - start) / DRAG_STEPS;
+    start = now();
+    for (step=0; step<SCAN_STEPS; step++) {
+        pos = scanLineToPos(text, length,
+                dragLine(step * DRAG_STEPS / SCAN_STEPS, nLines));
+        sink += scanPosToLine(text, pos);
+    }
+    scanned = (now() - start) / SCAN_STEPS;
+    printf("  scrollbar drag:   %9.1f us per step, %16.1f us scanning\n",
+            indexed * 1e6, scanned * 1e6);
+    
+    /* The same, with a line inserted between steps */
+    middle = BufCountForwardNLines(buf, 0, nLines / 2);
+    BufInsert(buf, middle, "inserted\n");
+    start = now();
+    for (step=0; step<DRAG_STEPS; step++) {
+        BufInsert(buf, middle, "inserted\n");
+        pos = BufCountForwardNLines(buf, 0, dragLine(step, nLines));
+        sink += BufCountLines(buf, 0, pos);
+    }
+    indexed = (now() - start) / DRAG_STEPS;
+    printf("  drag with edits:  %9.1f us per step\n", indexed * 1e6);
+    
+    /* Check the index against the text after the edits */
+    free(text);
+    text = BufGetAll(buf);
+    length = buf->length;
+    for (step=0; step<SCAN_STEPS; step++) {
+        ssize_t line = dragLine(step * DRAG_STEPS / SCAN_STEPS,
+                nLines + DRAG_STEPS + 1);
+        pos = BufCountForwardNLines(buf, 0, line);
+        expected = scanLineToPos(text, length, line);
+        if (pos != expected || BufCountLines(buf, 0, pos) !=
+                scanPosToLine(text, pos)) {
+            printf("  after edits line %ld is at %ld, not %ld\n", (long)line,
+                    (long)pos, (long)expected);
+            failed = 1;
+        }
+    }
+    
+    free(text);
+    BufFree(buf);
+    return failed || sink == -1;
+}
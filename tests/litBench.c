@@ -0,0 +1,130 @@
+/*******************************************************************************
+*                                                                              *
+* litBench.c -- Literal search speed, compared with the old search loop        *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Searches a synthetic text of the given size (1 GB by default) for a word
+** found only at its far end, forward and backward, case sensitive and not,
+** with the literal search engine (litSearch.c) and with the byte by byte
+** loop searchLiteral in search.c used before it.  Both must find the same
+** match.  Prints the time of each search and the speed in GB/s.
+**
+** Usage: litBench [size in MB]
+*/
+
+#include "../source/litSearch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#define LINE "the quick brown fox jumps over the lazy dog 0123456789\n"
+#define WORD "Zyzzyva"
+
+static double now(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* The loop of the old searchLiteral, for ASCII search strings, from "from"
+   to the end of "string" (forward) or to its start (backward) */
+static const char *oldSearch(const char *string, const char *searchString,
+        int caseSense, int backward, size_t from)
+{
+    const char *filePtr, *tempPtr, *ucPtr, *lcPtr;
+    char ucString[64], lcString[64];
+    size_t i, searchLen = strlen(searchString);
+    
+    for (i = 0; i <= searchLen; i++) {
+        ucString[i] = caseSense ? searchString[i] :
+                toupper((unsigned char)searchString[i]);
+        lcString[i] = caseSense ? searchString[i] :
+                tolower((unsigned char)searchString[i]);
+    }
+    for (filePtr = string + from; backward ? filePtr >= string : *filePtr != 0;
+            backward ? filePtr-- : filePtr++) {
+        if (*filePtr == *ucString || *filePtr == *lcString) {
+            ucPtr = ucString;
+            lcPtr = lcString;
+            tempPtr = filePtr;
+            while (*tempPtr == *ucPtr || *tempPtr == *lcPtr) {
+                tempPtr++; ucPtr++; lcPtr++;
+                if (*ucPtr == 0 && *lcPtr == 0)
+                    return filePtr;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void runCase(const char *name, const char *text, size_t length,
+        const char *word, int caseSense, int backward)
+{
+    litPattern *pat;
+    const char *oldFound, *newFound;
+    double start, oldTime, newTime;
+    int matchLen;
+    
+    start = now();
+    oldFound = oldSearch(text, word, caseSense, backward,
+            backward ? length - 1 : 0);
+    oldTime = now() - start;
+    start = now();
+    pat = LitCompile(word, caseSense);
+    newFound = backward ?
+            LitFindBackward(pat, text, length - 1, length, &matchLen) :
+            LitFindForward(pat, text, length, &matchLen);
+    LitFree(pat);
+    newTime = now() - start;
+    printf("  %-28s old %7.3f s (%5.2f GB/s), new %7.3f s (%5.2f GB/s)%s\n",
+            name, oldTime, length / oldTime / 1e9, newTime,
+            length / newTime / 1e9, oldFound == newFound ? "" :
+            ", DIFFERENT MATCHES");
+}
+
+int main(int argc, char **argv)
+{
+    size_t size = (size_t)(argc > 1 ? atol(argv[1]) : 1024) << 20;
+    size_t n, lineLen = strlen(LINE), wordLen = strlen(WORD);
+    char *text = malloc(size + 1);
+    
+    if (text == NULL) {
+        fprintf(stderr, "litBench: out of memory\n");
+        return 2;
+    }
+    for (n = 0; n + lineLen <= size; n += lineLen)
+        memcpy(text + n, LINE, lineLen);
+    memset(text + n, '\n', size - n);
+    text[size] = '\0';
+    
+    /* The word at the end for forward searches, and at the start for
+       backward ones, all in lower case */
+    printf("Searching %ld MB:\n", (long)(size >> 20));
+    memcpy(text + size - wordLen - 1, "zyzzyva", wordLen);
+    runCase("forward, case sensitive", text, size, "zyzzyva", 1, 0);
+    runCase("forward, ignoring case", text, size, WORD, 0, 0);
+    memcpy(text + size - wordLen - 1, LINE, wordLen);
+    memcpy(text, "zyzzyva", wordLen);
+    runCase("backward, case sensitive", text, size, "zyzzyva", 1, 1);
+    runCase("backward, ignoring case", text, size, WORD, 0, 1);
+    free(text);
+    return 0;
+}
@@ -0,0 +1,88 @@
+/*******************************************************************************
+*                                                                              *
+* litCase.c -- Case insensitive literal search of UTF-8 text                   *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Checks that a case insensitive literal search matches each character of
+** the search string in its upper or its lower case form, and never in a
+** mix of the bytes of the two, which can be a different character ("Ѐ" is
+** the first byte of "Р" and the second of "р").  Each search is done forward
+** and backward, finding candidates both with the scanning kernels and with
+** the skip tables.
+**
+** Usage: litCase
+*/
+
+#include "../source/litSearch.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <locale.h>
+
+static int failures = 0;
+
+/* Search for "string" in "text", and check whether it's found at "expect"
+   (-1 for no match) */
+static void check(const char *string, const char *text, int expect)
+{
+    litPattern *pat = LitCompile(string, 0);
+    size_t length = strlen(text);
+    const char *found;
+    int horspool, backward, matchLen, pos;
+    
+    for (horspool = 0; horspool < 2; horspool++) {
+        pat->horspool = horspool;
+        for (backward = 0; backward < 2; backward++) {
+            found = backward ?
+                    LitFindBackward(pat, text, length, length, &matchLen) :
+                    LitFindForward(pat, text, length, &matchLen);
+            pos = found == NULL ? -1 : found - text;
+            if (pos != expect) {
+                fprintf(stderr, "litCase: \"%s\" in \"%s\" (%s, %s): found "
+                        "at %d, expected %d\n", string, text,
+                        backward ? "backward" : "forward",
+                        horspool ? "skip tables" : "scanning", pos, expect);
+                failures++;
+            }
+        }
+    }
+    LitFree(pat);
+}
+
+int main(int argc, char **argv)
+{
+    if (setlocale(LC_CTYPE, "C.UTF-8") == NULL &&
+            setlocale(LC_CTYPE, "en_US.UTF-8") == NULL) {
+        printf("litCase: no UTF-8 locale, skipped\n");
+        return 0;
+    }
+    
+    check("р", "Р", 0);
+    check("р", "xр", 1);
+    check("р", "ЀѠ", -1);
+    check("Р", "ЀѠ", -1);
+    check("σ", "ϣ", -1);
+    check("σ", "ϣΣ", 2);
+    check("привет", "ПРИВЕТ", 0);
+    check("привет", "..ПрИвЕт", 2);
+    check("привет", "ПЀИВЕТ", -1);
+    check("привет", "прИвеѢ", -1);
+    check("aрb", "AЀB aѠb AРb", 10);
+    check("straße", "STRAßE", 0);
+    
+    printf("litCase: %s\n", failures ? "FAILED" : "ok");
+    return failures != 0;
+}
@@ -0,0 +1,156 @@
+/*******************************************************************************
+*                                                                              *
+* openBench.c -- Time and memory taken to load a large file                    *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Loads a synthetic file of the given size (1 GB by default) into a text
+** buffer the way the editor opens large files without conversion, by
+** mapping it and copying it out (see mapFileContent in file.c), two ways:
+** copying all of it into memory of its own and then into the buffer with
+** BufSetAllLen, as the editor once did, and copying it a piece at a time,
+** unmapping each piece, straight into memory the buffer takes over with
+** BufTakeAll.  Each way runs in a process of its own, and prints the wall
+** time and the peak resident memory (which counts the mapped pages of the
+** file), which the second way should keep near the file size.
+**
+** Usage: openBench [size in MB [directory]]
+*/
+
+#include "../source/textBuf.h"
+#include "../util/nedit_malloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define LINE "the quick brown fox jumps over the lazy dog 0123456789\n"
+#define CHUNK_SIZE (1 << 20)
+#define MMAP_COPY_CHUNK 0x4000000 /* as in file.c */
+
+static double now(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int writeSyntheticFile(const char *path, ssize_t size)
+{
+    char *chunk = malloc(CHUNK_SIZE);
+    FILE *fp = fopen(path, "wb");
+    size_t lineLen = strlen(LINE);
+    ssize_t n, written = 0;
+    
+    if (fp == NULL || chunk == NULL)
+        return 0;
+    for (n = 0; n + lineLen <= CHUNK_SIZE; n += lineLen)
+        memcpy(chunk + n, LINE, lineLen);
+    while (written < size) {
+        if (n > size - written)
+            n = size - written;
+        if (fwrite(chunk, 1, n, fp) != (size_t)n)
+            return 0;
+        written += n;
+    }
+    free(chunk);
+    return fclose(fp) == 0;
+}
+
+/* Load "path" into a buffer, with a single copy if "once" is set, and
+   return the length of the buffer, or -1 if the file couldn't be mapped */
+static ssize_t loadFile(const char *path, int once)
+{
+    struct stat st;
+    textBuffer *buf;
+    char *map, *text;
+    ssize_t done, n;
+    int fd = open(path, O_RDONLY);
+    
+    if (fd < 0 || fstat(fd, &st) != 0)
+        return -1;
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    buf = BufCreate();
+    if (once) {
+        text = BufAllocText(st.st_size);
+        for (done = 0; done < st.st_size; done += MMAP_COPY_CHUNK) {
+            n = st.st_size - done < MMAP_COPY_CHUNK ?
+                    st.st_size - done : MMAP_COPY_CHUNK;
+            memcpy(text + done, map + done, n);
+            munmap(map + done, n);
+        }
+        BufTakeAll(buf, text, st.st_size);
+    } else {
+        text = NEditMalloc(st.st_size + 1);
+        memcpy(text, map, st.st_size);
+        text[st.st_size] = '\0';
+        munmap(map, st.st_size);
+        BufSetAllLen(buf, text, st.st_size);
+        NEditFree(text);
+    }
+    return buf->length;
+}
+
+/* Load the file in a child process, so the peak memory is its own */
+static int runCase(const char *name, const char *path, int once)
+{
+    struct rusage usage;
+    double start = now();
+    int status;
+    pid_t pid = fork();
+    
+    if (pid == 0)
+        _exit(loadFile(path, once) < 0);
+    if (pid < 0 || wait4(pid, &status, 0, &usage) != pid ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "openBench: %s: loading %s failed\n", name, path);
+        return 1;
+    }
+    printf("  %-28s %7.3f s, peak memory %6ld MB\n", name, now() - start,
+            usage.ru_maxrss / 1024);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    ssize_t size = (ssize_t)(argc > 1 ? atol(argv[1]) : 1024) << 20;
+    const char *dir = argc > 2 ? argv[2] : getenv("TMPDIR");
+    char path[PATH_MAX];
+    int errors = 0;
+    
+    snprintf(path, sizeof(path), "%s/xnedit-open-bench.txt",
+            dir ? dir : "/tmp");
+    if (!writeSyntheticFile(path, size)) {
+        fprintf(stderr, "openBench: can't write %s\n", path);
+        return 2;
+    }
+    printf("Loading %ld MB:\n", (long)(size >> 20));
+    errors += runCase("copy, then BufSetAllLen", path, 0);
+    errors += runCase("copy pieces, BufTakeAll", path, 1);
+    unlink(path);
+    return errors != 0;
+}
@@ -0,0 +1,288 @@
+/*******************************************************************************
+*                                                                              *
+* regexBench.c -- Regular expression speed on the syntax highlighting patterns *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Reads the built-in syntax highlighting pattern sets out of highlightData.c,
+** and finds every match of each start, end and error expression in a text
+** (by default, some of XNEdit's own sources), the way highlighting searches
+** for them.  Each expression is run twice: as compiled, and with the
+** prefilter (the literal every match must contain, and the characters a
+** match can start with) switched off, which is how every expression ran
+** before it.  Prints the time for each language, and the speed up; the
+** number of matches must be the same both ways.
+**
+** Usage: regexBench [highlightData.c [text files...]]
+*/
+
+#include "../source/regularExp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_PATTERN_SETS 100
+
+typedef struct {
+    char *name;
+    int nExprs;
+    regexp **exprs;
+} patternSet;
+
+static char *readFile(const char *path, long *length)
+{
+    FILE *fp = fopen(path, "rb");
+    char *text;
+    long len;
+    
+    if (fp == NULL) {
+        perror(path);
+        exit(2);
+    }
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    rewind(fp);
+    text = malloc(len + 1);
+    len = fread(text, 1, len, fp);
+    text[len] = '\0';
+    fclose(fp);
+    if (length != NULL)
+        *length = len;
+    return text;
+}
+
+/* Decode the C string literal starting at "*ptr" (after the quote), and
+   append it to "out" */
+static void readLiteral(const char **ptr, char *out)
+{
+    const char *c = *ptr;
+    char *o = out + strlen(out);
+    
+    for (; *c != '"' && *c != '\0'; c++) {
+        if (*c != '\\') {
+            *o++ = *c;
+            continue;
+        }
+        switch (*++c) {
+            case '\n': break;
+            case 'n': *o++ = '\n'; break;
+            case 't': *o++ = '\t'; break;
+            default: *o++ = *c; break;
+        }
+    }
+    *o = '\0';
+    *ptr = *c == '"' ? c + 1 : c;
+}
+
+/* Read one field of a pattern definition, either quoted (with "" standing
+   for a quote) or running to the next ':' */
+static char *readField(const char **ptr)
+{
+    const char *c = *ptr;
+    char *field = malloc(strlen(c) + 1), *o = field;
+    
+    if (*c == '"') {
+        for (c++; *c != '\0'; c++) {
+            if (*c == '"' && c[1] == '"')
+                *o++ = *c++;
+            else if (*c == '"')
+                break;
+            else
+                *o++ = *c;
+        }
+        if (*c == '"')
+            c++;
+    } else {
+        while (*c != ':' && *c != '\n' && *c != '}' && *c != '\0')
+            *o++ = *c++;
+    }
+    *o = '\0';
+    if (*c == ':')
+        c++;
+    *ptr = c;
+    return field;
+}
+
+static void addExpr(patternSet *set, const char *expr, int *nBad)
+{
+    char *err;
+    regexp *re;
+    
+    if (*expr == '\0')
+        return;
+    if ((re = CompileRE(expr, &err, REDFLT_STANDARD)) == NULL) {
+        (*nBad)++;
+        return;
+    }
+    set->exprs = realloc(set->exprs, sizeof(regexp *) * (set->nExprs + 1));
+    set->exprs[set->nExprs++] = re;
+}
+
+/* Parse one pattern set definition, "name:1:0{ patterns... }" */
+static void parsePatternSet(const char *def, patternSet *set, int *nBad)
+{
+    const char *c = strchr(def, '{');
+    char *fields[7];
+    int i;
+    
+    set->name = strndup(def, strcspn(def, ":"));
+    set->nExprs = 0;
+    set->exprs = NULL;
+    if (c == NULL)
+        return;
+    for (c++; *c != '}' && *c != '\0'; ) {
+        while (*c == '\n' || *c == '\t' || *c == ' ')
+            c++;
+        if (*c == '}' || *c == '\0')
+            break;
+        for (i=0; i<7; i++)
+            fields[i] = readField(&c);
+        /* Sub-patterns which only color parts of their parent's match are
+           not searched for */
+        if (strchr(fields[6], 'C') == NULL) {
+            addExpr(set, fields[1], nBad);
+            addExpr(set, fields[2], nBad);
+            addExpr(set, fields[3], nBad);
+        }
+        for (i=0; i<7; i++)
+            free(fields[i]);
+        while (*c != '\n' && *c != '}' && *c != '\0')
+            c++;
+    }
+}
+
+static int readPatternSets(const char *path, patternSet *sets, int *nBad)
+{
+    char *source = readFile(path, NULL), *def;
+    const char *c = strstr(source, "DefaultPatternSets[] = {");
+    const char *end;
+    int nSets = 0;
+    
+    if (c == NULL) {
+        fprintf(stderr, "regexBench: no pattern sets in %s\n", path);
+        exit(2);
+    }
+    end = strstr(c, "\n};");
+    def = malloc(strlen(source) + 1);
+    for (c = strchr(c, '{') + 1; c < end && nSets < MAX_PATTERN_SETS; ) {
+        /* Each set is a string literal, possibly split into several */
+        def[0] = '\0';
+        while (c < end && *c != ',') {
+            if (*c == '"') {
+                c++;
+                readLiteral(&c, def);
+            } else
+                c++;
+        }
+        c++;
+        if (def[0] != '\0')
+            parsePatternSet(def, &sets[nSets++], nBad);
+    }
+    free(def);
+    free(source);
+    return nSets;
+}
+
+/* Find all of the matches of "re" in "text", as highlighting would search
+   for them one after another.  Returns the number found */
+static long findAll(regexp *re, const char *text)
+{
+    const char *pos = text;
+    long n = 0;
+    
+    while (*pos != '\0' && ExecRE(re, pos, NULL, 0,
+            pos == text ? '\n' : pos[-1], '\0', NULL, text, NULL)) {
+        n++;
+        pos = re->endp[0] > pos ? re->endp[0] : pos + 1;
+    }
+    return n;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *defaultTexts[] = {
+        "../source/textDisp.c", "../source/search.c", "../README.md"
+    };
+    const char **textFiles = argc > 2 ? (const char **)argv + 2 : defaultTexts;
+    int nTexts = argc > 2 ? argc - 2 : 3;
+    patternSet sets[MAX_PATTERN_SETS];
+    char *text;
+    long textLen = 0, len, n1, n2;
+    double t, time1, time2, total1 = 0, total2 = 0;
+    int i, j, nSets, nBad = 0, nExprs = 0, mismatches = 0;
+    regexp *plain;
+    
+    nSets = readPatternSets(argc > 1 ? argv[1] : "../source/highlightData.c",
+            sets, &nBad);
+    
+    /* The text files, one after another */
+    text = malloc(1);
+    text[0] = '\0';
+    for (i=0; i<nTexts; i++) {
+        char *file = readFile(textFiles[i], &len);
+        text = realloc(text, textLen + len + 1);
+        memcpy(text + textLen, file, len + 1);
+        textLen += len;
+        free(file);
+    }
+    
+    printf("%-20s %6s %9s %10s %10s %7s\n", "language", "exprs", "matches",
+            "prefilter", "without", "speedup");
+    for (i=0; i<nSets; i++) {
+        time1 = time2 = 0;
+        n1 = n2 = 0;
+        for (j=0; j<sets[i].nExprs; j++) {
+            plain = CopyRE(sets[i].exprs[j]);
+            plain->literal_len = 0;
+            plain->use_first_chars = 0;
+            
+            t = now();
+            len = findAll(sets[i].exprs[j], text);
+            time1 += now() - t;
+            n1 += len;
+            t = now();
+            if (findAll(plain, text) != len)
+                mismatches++;
+            time2 += now() - t;
+            free(plain);
+        }
+        nExprs += sets[i].nExprs;
+        total1 += time1;
+        total2 += time2;
+        printf("%-20s %6d %9ld %9.3fs %9.3fs %6.1fx\n", sets[i].name,
+                sets[i].nExprs, n1, time1, time2,
+                time1 > 0 ? time2 / time1 : 0);
+    }
+    printf("%d pattern sets, %d expressions (%d not compiled), %ld bytes of "
+            "text\n", nSets, nExprs, nBad, textLen);
+    printf("total %.3fs (%.1f MB/s per expression), without prefilter %.3fs, "
+            "speedup %.1fx\n", total1,
+            total1 > 0 ? nExprs * textLen / total1 / 1e6 : 0, total2,
+            total1 > 0 ? total2 / total1 : 0);
+    if (mismatches)
+        printf("%d expressions found different matches without the "
+                "prefilter\n", mismatches);
+    return mismatches != 0;
+}
@@ -0,0 +1,219 @@
+/*******************************************************************************
+*                                                                              *
+* regexFuzz.c -- Back tracking and automaton regex matching, compared          *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Generates random expressions and subjects, and matches each expression the
+** automaton can handle both ways: by back tracking alone, and by the
+** automaton alone (regularExp.c is built for this test with
+** NFA_BACKTRACK_STEPS set to 0, so the automaton takes over at once).  The
+** matches, captures and the top branch reported must be the same.
+** Back tracking can take exponential time on some expressions (which is
+** why the automaton exists), so matches taking it too long are skipped.
+**
+** Usage: regexFuzz [cases [seed]]
+*/
+
+#include "../source/regularExp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#define MAX_PATTERN 200
+#define MAX_SUBJECT 40
+
+static const char *Atoms[] = {
+    "a", "b", "c", "ab", "ba", " ", ".", "\\w", "\\W", "\\s", "\\S", "\\d",
+    "\\D", "\\l", "[ab]", "[^a]", "[a-c1]", "\\y", "\\Y", "\\n", "x", "1"
+};
+#define N_ATOMS ((int)(sizeof(Atoms) / sizeof(Atoms[0])))
+
+static const char *Quantifiers[] = {
+    "*", "+", "?", "*?", "+?", "??", "{2}", "{1,3}", "{0,2}", "{2,}", "{,2}",
+    "{1,2}?"
+};
+#define N_QUANTIFIERS ((int)(sizeof(Quantifiers) / sizeof(Quantifiers[0])))
+
+static const char *Assertions[] = { "^", "$", "<", ">", "\\B", "\\b" };
+#define N_ASSERTIONS ((int)(sizeof(Assertions) / sizeof(Assertions[0])))
+
+static const char SubjectChars[] = "aabbc  1x_\n";
+
+#define BACKTRACK_TIME_LIMIT 100000 /* microseconds */
+
+static unsigned long Seed;
+static sigjmp_buf TimedOut;
+static long NSkipped;
+
+static int rnd(int n)
+{
+    Seed = Seed * 6364136223846793005UL + 1442695040888963407UL;
+    return (int)((Seed >> 33) % (unsigned long)n);
+}
+
+static void addPiece(char *out, int depth);
+
+static void addBranch(char *out, int depth)
+{
+    int i, n = 1 + rnd(3);
+    
+    for (i=0; i<n && strlen(out) < MAX_PATTERN - 40; i++)
+        addPiece(out, depth);
+}
+
+static void addPiece(char *out, int depth)
+{
+    int kind = rnd(10);
+    
+    if (kind < 2 && depth < 3) {
+        strcat(out, rnd(3) ? "(" : "(?:");
+        addBranch(out, depth + 1);
+        while (rnd(3) == 0) {
+            strcat(out, "|");
+            addBranch(out, depth + 1);
+        }
+        strcat(out, ")");
+    } else if (kind == 2) {
+        strcat(out, Assertions[rnd(N_ASSERTIONS)]);
+        return;
+    } else {
+        strcat(out, Atoms[rnd(N_ATOMS)]);
+    }
+    if (rnd(2))
+        strcat(out, Quantifiers[rnd(N_QUANTIFIERS)]);
+}
+
+static void randomPattern(char *out)
+{
+    out[0] = '\0';
+    if (rnd(6) == 0)
+        strcat(out, "(?i)");
+    addBranch(out, 0);
+    while (rnd(4) == 0) {
+        strcat(out, "|");
+        addBranch(out, 0);
+    }
+}
+
+static void randomSubject(char *out)
+{
+    int i, n = rnd(MAX_SUBJECT);
+    
+    for (i=0; i<n; i++)
+        out[i] = SubjectChars[rnd(sizeof(SubjectChars) - 1)];
+    out[n] = '\0';
+}
+
+static void timeLimitHandler(int sig)
+{
+    siglongjmp(TimedOut, 1);
+}
+
+static void setTimeLimit(long usec)
+{
+    struct itimerval limit;
+    
+    memset(&limit, 0, sizeof(limit));
+    limit.it_value.tv_usec = usec;
+    setitimer(ITIMER_REAL, &limit, NULL);
+}
+
+/* Match "re" and check it against the same match by "other", which only
+   back tracks; reports and returns False if they differ */
+static int compare(regexp *re, regexp *other, const char *pattern,
+        const char *subject, int reverse)
+{
+    const char *end = reverse ? subject + strlen(subject) : NULL;
+    int found1, found2, i, nCaps = 1 + (unsigned char)re->program[1];
+    
+    found1 = ExecRE(re, subject, end, reverse, '\n', '\n', NULL, NULL, NULL);
+    if (sigsetjmp(TimedOut, 1)) {
+        NSkipped++;
+        return 1;
+    }
+    setTimeLimit(BACKTRACK_TIME_LIMIT);
+    found2 = ExecRE(other, subject, end, reverse, '\n', '\n', NULL, NULL,
+            NULL);
+    setTimeLimit(0);
+    if (found1 != found2)
+        goto differ;
+    if (!found1)
+        return 1;
+    for (i=0; i<nCaps && i<NSUBEXP; i++) {
+        if (re->startp[i] != other->startp[i] || re->endp[i] != other->endp[i])
+            goto differ;
+    }
+    if (re->top_branch != other->top_branch)
+        goto differ;
+    return 1;
+
+differ:
+    fprintf(stderr, "regexFuzz: /%s/ on \"", pattern);
+    for (i=0; subject[i]; i++)
+        fputs(subject[i] == '\n' ? "\\n" : (char[]){subject[i], 0}, stderr);
+    fprintf(stderr, "\"%s: back tracking %s", reverse ? " (reverse)" : "",
+            found2 ? "matches" : "fails");
+    if (found2)
+        fprintf(stderr, " %ld-%ld", (long)(other->startp[0] - subject),
+                (long)(other->endp[0] - subject));
+    fprintf(stderr, ", automaton %s", found1 ? "matches" : "fails");
+    if (found1)
+        fprintf(stderr, " %ld-%ld", (long)(re->startp[0] - subject),
+                (long)(re->endp[0] - subject));
+    fprintf(stderr, "\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    long nCases = argc > 1 ? atol(argv[1]) : 20000;
+    char pattern[MAX_PATTERN + 50], subject[MAX_SUBJECT + 1];
+    long i, nCompared = 0, nFailed = 0;
+    regexp *re, *backtrack;
+    char *err;
+    int j;
+    
+    Seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+    signal(SIGALRM, timeLimitHandler);
+    for (i=0; i<nCases && nFailed < 10; i++) {
+        randomPattern(pattern);
+        re = CompileRE(pattern, &err, REDFLT_STANDARD);
+        if (re == NULL || re->nfa_states == 0) {
+            free(re);
+            continue;
+        }
+        
+        /* A copy without the automaton states can only back track */
+        backtrack = CopyRE(re);
+        backtrack->nfa_states = 0;
+        
+        for (j=0; j<8; j++) {
+            randomSubject(subject);
+            if (!compare(re, backtrack, pattern, subject, j % 2))
+                nFailed++;
+            nCompared++;
+        }
+        free(backtrack);
+        free(re);
+    }
+    printf("regexFuzz: %ld matches compared (%ld skipped), %s\n",
+            nCompared - NSkipped, NSkipped, nFailed ? "FAILED" : "ok");
+    return nFailed != 0;
+}
@@ -0,0 +1,214 @@
+/*******************************************************************************
+*                                                                              *
+* regexThreads.c -- Compiling and matching regular expressions in threads      *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** A pool of threads, each with its own regexContext, compiles a set of
+** expressions at the same moment (the first use of the regex code, which
+** sets up its character classes) and then runs thousands of matches at
+** once.  The results must be the same as matching one at a time in a
+** single thread.
+**
+** Usage: regexThreads [threads [rounds]]
+*/
+
+#include "../source/regularExp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define N_SUBJECTS 300
+#define N_GROUPS 3
+
+static const char *Patterns[] = {
+    "\\w+",
+    "\\<\\w+ing\\>",
+    "\\s+\\d+",
+    "[[:alpha:]]+\\s*=\\s*\\d+",
+    "(\\w+)\\s+\\1",
+    "(?i)fox|dog",
+    "^\\s*#\\s*(\\w+)",
+    "\\d{2,4}-\\d{2}",
+    "(a|b)*c",
+    "(?=\\w*o)\\w+",
+    "(?<=\\s)[A-Z]\\w*",
+    "\\bquick\\b.*\\blazy\\b",
+    "[^a-z ]+",
+    "\"([^\"\\\\]|\\\\.)*\"",
+    "/\\*.*?\\*/",
+    "\\S+@\\S+\\.\\w{2,3}",
+    "(\\d+)\\.(\\d+)",
+    "\\l\\d\\l",
+    "\\y+",
+    "x{0,3}y?z+",
+    "(?n.)+?;",
+    "(?i)[a-f0-9]{4,}",
+    "<(\\w+)>.*</\\1>",
+    "\\W\\W",
+};
+#define N_PATTERNS ((int)(sizeof(Patterns) / sizeof(Patterns[0])))
+
+static const char *Words[] = {
+    "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "x = 12",
+    "running", "#define", "FOO", "1999-12", "3.14", "\"a \\\" b\"", "/* c */",
+    "me@example.org", "aabbc", "xxyz", "<b>bold</b>", "deadBEEF", "  ", ";",
+    "Capital", "the the", "\t", "\n", "42", "singing", "abab", "zz"
+};
+#define N_WORDS ((int)(sizeof(Words) / sizeof(Words[0])))
+
+/* Result of one match: whether it matched, and where the match and the
+   first few groups are (-1 where unset) */
+typedef struct {
+    int found;
+    long start[N_GROUPS + 1], end[N_GROUPS + 1];
+} matchResult;
+
+static char *Subjects[N_SUBJECTS];
+static matchResult Expected[N_PATTERNS][N_SUBJECTS][2];
+
+static pthread_barrier_t StartBarrier;
+static pthread_mutex_t NextLock = PTHREAD_MUTEX_INITIALIZER;
+static long NextTask, NTasks, NMismatches;
+
+static void makeSubjects(void)
+{
+    unsigned seed = 12345;
+    int i, j, n;
+    char line[512];
+    
+    for (i=0; i<N_SUBJECTS; i++) {
+        line[0] = '\0';
+        n = 1 + (seed = seed * 1103515245 + 12345) % 12;
+        for (j=0; j<n; j++) {
+            seed = seed * 1103515245 + 12345;
+            strcat(line, Words[(seed >> 16) % N_WORDS]);
+            strcat(line, (seed >> 8) % 3 ? " " : "");
+        }
+        Subjects[i] = strdup(line);
+    }
+}
+
+static void match(regexContext *context, regexp *re, const char *subject,
+        int reverse, matchResult *result)
+{
+    int i;
+    
+    memset(result, 0, sizeof(*result));
+    result->found = ExecREContext(context, re, subject, NULL, reverse, '\n',
+            '\0', NULL, NULL, NULL);
+    for (i=0; i<=N_GROUPS; i++) {
+        result->start[i] = result->found && re->startp[i] != NULL ?
+                re->startp[i] - subject : -1;
+        result->end[i] = result->found && re->endp[i] != NULL ?
+                re->endp[i] - subject : -1;
+    }
+}
+
+static regexp **compileAll(regexContext *context)
+{
+    regexp **res = malloc(sizeof(regexp *) * N_PATTERNS);
+    char *err;
+    int i;
+    
+    for (i=0; i<N_PATTERNS; i++) {
+        res[i] = CompileREContext(context, Patterns[i], &err, REDFLT_STANDARD);
+        if (res[i] == NULL) {
+            fprintf(stderr, "regexThreads: %s: %s\n", Patterns[i], err);
+            exit(2);
+        }
+    }
+    return res;
+}
+
+static void *worker(void *arg)
+{
+    regexContext *context = CreateREContext();
+    regexp **res;
+    matchResult result;
+    long task, mismatches = 0;
+    int p, s, reverse, i;
+    
+    /* Start compiling together, the first use of the regex code */
+    pthread_barrier_wait(&StartBarrier);
+    res = compileAll(context);
+    pthread_barrier_wait(&StartBarrier);
+    
+    for (;;) {
+        pthread_mutex_lock(&NextLock);
+        task = NextTask++;
+        pthread_mutex_unlock(&NextLock);
+        if (task >= NTasks)
+            break;
+        p = task % N_PATTERNS;
+        s = (task / N_PATTERNS) % N_SUBJECTS;
+        reverse = (task / (N_PATTERNS * N_SUBJECTS)) % 2;
+        match(context, res[p], Subjects[s], reverse, &result);
+        if (memcmp(&result, &Expected[p][s][reverse], sizeof(result)) != 0) {
+            if (mismatches++ == 0)
+                fprintf(stderr, "regexThreads: /%s/ on \"%s\"%s differs\n",
+                        Patterns[p], Subjects[s], reverse ? " (reverse)" : "");
+        }
+    }
+    
+    pthread_mutex_lock(&NextLock);
+    NMismatches += mismatches;
+    pthread_mutex_unlock(&NextLock);
+    for (i=0; i<N_PATTERNS; i++)
+        free(res[i]);
+    free(res);
+    FreeREContext(context);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int nThreads = argc > 1 ? atoi(argv[1]) : 8;
+    int nRounds = argc > 2 ? atoi(argv[2]) : 4;
+    pthread_t *threads = malloc(sizeof(pthread_t) * nThreads);
+    regexContext *context;
+    regexp **res;
+    int i, p, s;
+    
+    makeSubjects();
+    NTasks = (long)N_PATTERNS * N_SUBJECTS * 2 * nRounds;
+    pthread_barrier_init(&StartBarrier, NULL, nThreads + 1);
+    for (i=0; i<nThreads; i++)
+        pthread_create(&threads[i], NULL, worker, NULL);
+    
+    /* Let the workers compile (first), then get the expected results one
+       match at a time, before letting them go on */
+    pthread_barrier_wait(&StartBarrier);
+    context = CreateREContext();
+    res = compileAll(context);
+    for (p=0; p<N_PATTERNS; p++) {
+        for (s=0; s<N_SUBJECTS; s++) {
+            match(context, res[p], Subjects[s], 0, &Expected[p][s][0]);
+            match(context, res[p], Subjects[s], 1, &Expected[p][s][1]);
+        }
+        free(res[p]);
+    }
+    free(res);
+    FreeREContext(context);
+    pthread_barrier_wait(&StartBarrier);
+    
+    for (i=0; i<nThreads; i++)
+        pthread_join(threads[i], NULL);
+    printf("regexThreads: %ld matches in %d threads, %s\n", NTasks, nThreads,
+            NMismatches ? "FAILED" : "ok");
+    return NMismatches != 0;
+}
@@ -0,0 +1,93 @@
+#!/bin/sh
+#
+# Edits a window and closes another through the server while a multi-file
+# Replace All is running, that is while replaceAllInWindows is handling
+# events and its workers search copies of the text.  FILES files of MB
+# megabytes each are opened in an xnedit server, and a Replace All of "int"
+# with "INT_" in all of them is started from the Replace dialog (driven with
+# xdotool).  Meanwhile the second file gets a line inserted and the third is
+# closed.  Then the editor must still be running, the edited file must have
+# the new line and its replacements (it is searched again, as it changed),
+# the other open files their replacements, and the closed file must be left
+# alone.  Needs a display, xdotool and a built xnedit and xnc.
+#
+# Usage: replaceAllRace.sh [FILES [MB [xnedit [xnc]]]]
+#
+
+FILES=${1:-4}
+MB=${2:-128}
+XNEDIT=${3:-../source/xnedit}
+XNC=${4:-../source/xnc}
+DIR=${TMPDIR:-/tmp}/replaceAllRace.$$
+SERVER=replaceAllRace$$
+LINE="inserted during Replace All"
+
+trap 'rm -rf "$DIR"' 0 1 2 15
+
+mkdir "$DIR" || exit 2
+cat ../source/*.c > "$DIR/sources"
+i=1
+while [ $i -le $FILES ]; do
+    : > "$DIR/file$i.c"
+    while [ `wc -c < "$DIR/file$i.c"` -lt `expr $MB \* 1048576` ]; do
+        cat "$DIR/sources" >> "$DIR/file$i.c"
+    done
+    FILELIST="$FILELIST $DIR/file$i.c"
+    i=`expr $i + 1`
+done
+rm "$DIR/sources"
+
+"$XNEDIT" -server -svrname $SERVER $FILELIST &
+PID=$!
+xdotool search --sync --name "file$FILES.c" > /dev/null
+
+# Start the Replace All from the dialog of the first window
+"$XNC" -svrname $SERVER -do 'replace_dialog()' "$DIR/file1.c"
+xdotool search --sync --name "Replace/Find" windowactivate --sync
+xdotool key alt+t Home shift+End BackSpace type "int"
+xdotool key alt+w Home shift+End BackSpace type "INT_"
+xdotool key alt+m
+xdotool search --sync --name "Replace All in Multiple Documents" \
+        windowactivate --sync
+xdotool key alt+s alt+r
+
+# Edit and close windows while the workers run
+"$XNC" -svrname $SERVER -do "beginning_of_file()
+        insert_string(\"$LINE\\n\")" "$DIR/file2.c"
+"$XNC" -svrname $SERVER -do 'close("nosave")' "$DIR/file3.c"
+
+# Save what is still open, once the Replace All is done.  Requests are
+# served while it runs, so the first file is saved until it has no "int"
+# left, after which all the results are in
+"$XNC" -svrname $SERVER -do 'save()' "$DIR/file1.c"
+while grep -q "int" "$DIR/file1.c" && kill -0 $PID 2> /dev/null; do
+    sleep 1
+    "$XNC" -svrname $SERVER -do 'save()' "$DIR/file1.c"
+done
+i=2
+while [ $i -le $FILES ]; do
+    [ $i != 3 ] && "$XNC" -svrname $SERVER -do 'save()' "$DIR/file$i.c"
+    i=`expr $i + 1`
+done
+
+failed=0
+fail() {
+    echo "replaceAllRace: $1"
+    failed=1
+}
+kill -0 $PID 2> /dev/null || fail "xnedit is not running"
+i=1
+while [ $i -le $FILES ]; do
+    if [ $i = 3 ]; then
+        grep -q "INT_" "$DIR/file3.c" && fail "closed file3.c was changed"
+    else
+        grep -q "int" "$DIR/file$i.c" && fail "file$i.c still has \"int\""
+    fi
+    i=`expr $i + 1`
+done
+[ "`head -1 "$DIR/file2.c"`" = "$LINE" ] || fail "the edit of file2.c is lost"
+
+"$XNC" -svrname $SERVER -do 'exit()'
+wait $PID
+[ $failed = 0 ] && echo "replaceAllRace: $FILES files of $MB MB, ok"
+exit $failed
@@ -0,0 +1,219 @@
+/*******************************************************************************
+*                                                                              *
+* replaceBench.c -- Time and memory taken by Replace All in a large buffer     *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Replaces every "fox" with "wolf" in a text buffer of the given size
+** (512 MB by default) the two ways ReplaceAll in search.c does it: by
+** building a substituted copy of the text between the first and the last
+** match and replacing that in one go, as for small buffers, and a chunk at a
+** time, as replaceAllChunked does for literal searches in large buffers.
+** The replaced text is kept, as the undo list would keep it.  Each way runs
+** in a process of its own, and prints the wall time and the peak resident
+** memory, which includes the buffer itself.
+**
+** Usage: replaceBench [size in MB]
+*/
+
+#include "../source/textBuf.h"
+#include "../source/litSearch.h"
+#include "../util/nedit_malloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define LINE "the quick brown fox jumps over the lazy dog 0123456789\n"
+#define SEARCH "fox"
+#define REPLACE "wolf"
+#define REPLACE_ALL_CHUNK 1048576 /* as in search.c */
+
+/* Text removed from the buffer, as the undo list would keep it */
+static char **Removed = NULL;
+static int NRemoved = 0;
+
+static double now(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void keepRemovedCB(ssize_t pos, ssize_t nInserted, ssize_t nDeleted,
+        ssize_t nRestyled, const char *deletedText, void *cbArg)
+{
+    if (nDeleted == 0)
+        return;
+    Removed = NEditRealloc(Removed, sizeof(char *) * (NRemoved + 1));
+    Removed[NRemoved] = NEditMalloc(nDeleted + 1);
+    memcpy(Removed[NRemoved++], deletedText, nDeleted + 1);
+}
+
+static textBuffer *makeBuffer(ssize_t size)
+{
+    textBuffer *buf = BufCreate();
+    size_t lineLen = strlen(LINE);
+    char *text = BufAllocText(size);
+    ssize_t n;
+    
+    for (n = 0; n < size; n += lineLen)
+        memcpy(text + n, LINE, lineLen);
+    BufTakeAll(buf, text, size);
+    return buf;
+}
+
+/* Substitute the matches in "text" at "matches" (start and end of each) */
+static char *substitute(const char *text, const ssize_t *matches,
+        ssize_t nFound, ssize_t *newLen)
+{
+    ssize_t i, replaceLen = strlen(REPLACE), len = 0;
+    char *outString, *fillPtr;
+    
+    for (i = 0; i < nFound; i++)
+        len += replaceLen + (i > 0 ? matches[2*i] - matches[2*i-1] : 0);
+    fillPtr = outString = NEditMalloc(len + 1);
+    for (i = 0; i < nFound; i++) {
+        if (i > 0) {
+            memcpy(fillPtr, &text[matches[2*i-1]],
+                    matches[2*i] - matches[2*i-1]);
+            fillPtr += matches[2*i] - matches[2*i-1];
+        }
+        memcpy(fillPtr, REPLACE, replaceLen);
+        fillPtr += replaceLen;
+    }
+    *fillPtr = '\0';
+    *newLen = len;
+    return outString;
+}
+
+/* Find the matches in "text" starting before "limit" */
+static ssize_t findMatches(const litPattern *pat, const char *text,
+        ssize_t length, ssize_t limit, ssize_t **matches, ssize_t *maxFound)
+{
+    const char *match;
+    ssize_t pos = 0, nFound = 0;
+    int matchLen;
+    
+    while ((match = LitFindForward(pat, text + pos, length - pos,
+            &matchLen)) != NULL && match - text < limit) {
+        if (nFound == *maxFound) {
+            *maxFound = *maxFound == 0 ? 256 : *maxFound * 2;
+            *matches = NEditRealloc(*matches, sizeof(ssize_t) * 2 * *maxFound);
+        }
+        (*matches)[2*nFound] = match - text;
+        (*matches)[2*nFound+1] = pos = match - text + matchLen;
+        nFound++;
+    }
+    return nFound;
+}
+
+static void replaceWhole(textBuffer *buf, const litPattern *pat)
+{
+    ssize_t *matches = NULL, maxFound = 0, nFound, newLen;
+    const char *text = BufAsString(buf);
+    char *outString;
+    
+    nFound = findMatches(pat, text, buf->length, buf->length, &matches,
+            &maxFound);
+    outString = substitute(text, matches, nFound, &newLen);
+    BufReplace(buf, matches[0], matches[2*nFound-1], outString);
+    NEditFree(outString);
+    NEditFree(matches);
+}
+
+/* The chunks of replaceAllChunked, without the context around them, which
+   only word searches look at */
+static void replaceChunked(textBuffer *buf, const litPattern *pat)
+{
+    ssize_t *matches = NULL, maxFound = 0, nFound, newLen, margin;
+    ssize_t chunkStart, nextStart, textEnd, startPos, endPos;
+    char *text, *outString;
+    
+    margin = 4 * strlen(SEARCH) + 1;
+    BufBeginModifyBatch(buf);
+    for (chunkStart = 0; chunkStart < buf->length; chunkStart = nextStart) {
+        nextStart = chunkStart + REPLACE_ALL_CHUNK < buf->length ?
+                chunkStart + REPLACE_ALL_CHUNK : buf->length;
+        textEnd = nextStart + margin < buf->length ?
+                nextStart + margin : buf->length;
+        text = BufGetRange(buf, chunkStart, textEnd);
+        nFound = findMatches(pat, text, textEnd - chunkStart,
+                nextStart - chunkStart, &matches, &maxFound);
+        if (nFound == 0) {
+            NEditFree(text);
+            continue;
+        }
+        outString = substitute(text, matches, nFound, &newLen);
+        NEditFree(text);
+        startPos = chunkStart + matches[0];
+        endPos = chunkStart + matches[2*nFound-1];
+        if (endPos > nextStart)
+            nextStart = endPos;
+        BufReplace(buf, startPos, endPos, outString);
+        NEditFree(outString);
+        nextStart += newLen - (endPos - startPos);
+    }
+    BufEndModifyBatch(buf);
+    NEditFree(matches);
+}
+
+/* Replace in a child process, so the peak memory is its own */
+static int runCase(const char *name, ssize_t size, int chunked)
+{
+    struct rusage usage;
+    double start = now();
+    int status;
+    pid_t pid = fork();
+    
+    if (pid == 0) {
+        textBuffer *buf = makeBuffer(size);
+        litPattern *pat = LitCompile(SEARCH, 1);
+        ssize_t nLines = size / strlen(LINE);
+        
+        BufAddModifyCB(buf, keepRemovedCB, NULL);
+        if (chunked)
+            replaceChunked(buf, pat);
+        else
+            replaceWhole(buf, pat);
+        _exit(buf->length != size + nLines * (strlen(REPLACE) -
+                strlen(SEARCH)));
+    }
+    if (pid < 0 || wait4(pid, &status, 0, &usage) != pid ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "replaceBench: %s failed\n", name);
+        return 1;
+    }
+    printf("  %-28s %7.3f s, peak memory %6ld MB\n", name, now() - start,
+            usage.ru_maxrss / 1024);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    ssize_t size = (ssize_t)(argc > 1 ? atol(argv[1]) : 512) << 20;
+    int errors = 0;
+    
+    size -= size % strlen(LINE);
+    printf("Replace All in %ld MB:\n", (long)(size >> 20));
+    errors += runCase("whole text", size, 0);
+    errors += runCase("chunks", size, 1);
+    return errors != 0;
+}
@@ -0,0 +1,175 @@
+/*******************************************************************************
+*                                                                              *
+* scanBench.c -- Speed of the byte scanning kernels                            *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** Runs each of the byte scanning functions of textScan.c over a synthetic
+** text of the given size (256 MB by default), with nothing for it to find
+** before the end, and prints the best of a few runs in GB/s, beside that of
+** a plain byte at a time loop doing the same work.
+**
+** Usage: scanBench [size in MB]
+*/
+
+#include "../source/textScan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LINE "the quick brown fox jumps over the lazy dog 0123456789\n"
+#define RUNS 5
+
+static const char *Text;
+static size_t Length;
+static scanCharSet Set, First, Last;
+static volatile size_t Sink;
+
+static double now(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void countNewlines(void)
+{
+    Sink = ScanCountNewlines(Text, Length);
+}
+
+static void countNewlinesLoop(void)
+{
+    size_t i, n = 0;
+    
+    for (i = 0; i < Length; i++)
+        n += Text[i] == '\n';
+    Sink = n;
+}
+
+static void findNthNewline(void)
+{
+    size_t n = Length;
+    
+    Sink = (size_t)ScanFindNthNewline(Text, Length, &n);
+}
+
+static void findNthNewlineBackward(void)
+{
+    size_t n = Length;
+    
+    Sink = (size_t)ScanFindNthNewlineBackward(Text, Length, &n);
+}
+
+static void findCharSet(void)
+{
+    Sink = (size_t)ScanFindCharSet(Text, Length, &Set);
+}
+
+static void findCharSetBackward(void)
+{
+    Sink = (size_t)ScanFindCharSetBackward(Text, Length, &Set);
+}
+
+static void findCharSetLoop(void)
+{
+    size_t i;
+    
+    for (i = 0; i < Length; i++)
+        if (Set.member[(unsigned char)Text[i]])
+            break;
+    Sink = i;
+}
+
+static void findCharSetPair(void)
+{
+    Sink = (size_t)ScanFindCharSetPair(Text, Length, &First, &Last, 6);
+}
+
+static void findCharSetPairBackward(void)
+{
+    Sink = (size_t)ScanFindCharSetPairBackward(Text, Length, &First, &Last,
+            6);
+}
+
+static void findCharSetPairLoop(void)
+{
+    size_t i;
+    
+    for (i = 0; i + 6 < Length; i++)
+        if (First.member[(unsigned char)Text[i]] &&
+                Last.member[(unsigned char)Text[i + 6]])
+            break;
+    Sink = i;
+}
+
+/* Best speed of "run" in GB/s */
+static double speed(void (*run)(void))
+{
+    double start, best = 0;
+    int i;
+    
+    for (i = 0; i < RUNS; i++) {
+        start = now();
+        run();
+        if (best == 0 || now() - start < best)
+            best = now() - start;
+    }
+    return Length / best / 1e9;
+}
+
+static void runCase(const char *name, void (*scan)(void), void (*loop)(void))
+{
+    printf("  %-28s %6.2f GB/s, byte loop %6.2f GB/s\n", name, speed(scan),
+            speed(loop));
+}
+
+int main(int argc, char **argv)
+{
+    size_t size = (size_t)(argc > 1 ? atol(argv[1]) : 256) << 20;
+    size_t n, lineLen = strlen(LINE);
+    char *text = malloc(size);
+    
+    if (text == NULL) {
+        fprintf(stderr, "scanBench: out of memory\n");
+        return 2;
+    }
+    for (n = 0; n + lineLen <= size; n += lineLen)
+        memcpy(text + n, LINE, lineLen);
+    memset(text + n, ' ', size - n);
+    Text = text;
+    Length = size;
+    
+    /* Sets not found in the text, the pair as in a search for "Zyzzyva" */
+    ScanInitCharSet(&Set, "XQ#");
+    ScanInitCharSet(&First, "Zz");
+    ScanInitCharSet(&Last, "Aa");
+    
+    printf("Scanning %ld MB (%s):\n", (long)(size >> 20),
+            ScanIsVectorized() ? "vector kernels" : "plain C kernels");
+    runCase("ScanCountNewlines", countNewlines, countNewlinesLoop);
+    runCase("ScanFindNthNewline", findNthNewline, countNewlinesLoop);
+    runCase("ScanFindNthNewlineBackward", findNthNewlineBackward,
+            countNewlinesLoop);
+    runCase("ScanFindCharSet", findCharSet, findCharSetLoop);
+    runCase("ScanFindCharSetBackward", findCharSetBackward, findCharSetLoop);
+    runCase("ScanFindCharSetPair", findCharSetPair, findCharSetPairLoop);
+    runCase("ScanFindCharSetPairBackward", findCharSetPairBackward,
+            findCharSetPairLoop);
+    free(text);
+    return 0;
+}
@@ -0,0 +1,87 @@
+#!/bin/sh
+#
+# Frames per second of scrolling a text pane, which is drawn through its
+# back buffer and scrolled by copying within it (see setScroll in
+# textDisp.c).  Each case scrolls STEPS times, back and forth: vertically by
+# lines and by pages, horizontally with the default font and with an
+# anti-aliased proportional font, and vertically in the second pane of a
+# split window.  A case is run with no steps and with STEPS steps, and the
+# difference in time is the time of the steps, including the X server's
+# work, as xnedit waits for the server when it exits.  render_stats() shows
+# the part of it spent drawing text.  Needs a display.
+#
+# Scrolling in obscured and partly exposed windows can't be scripted, and
+# has to be checked by hand.
+#
+# Usage: scrollBench.sh [STEPS [xnedit]]
+#
+
+STEPS=${1:-500}
+XNEDIT=${2:-../source/xnedit}
+TEXT=${TMPDIR:-/tmp}/scrollBench.$$.c
+PROPFONT="Sans-12:antialias=true"
+
+trap 'rm -f "$TEXT"' 0 1 2 15
+
+# Some of XNEdit's own sources, with every tenth line made long enough to
+# scroll across
+for f in ../source/*.c; do
+    awk '{ if (NR % 10 == 0) { s = $0; while (length(s) < 2000) s = s " " $0;
+           print s } else print }' "$f"
+done > "$TEXT"
+
+now() {
+    date +%s%N
+}
+
+# Run case "$1": the macro "$2" set up, and "$3" scrolling, with $i counting
+# the steps
+runCase() {
+    for n in 0 $STEPS; do
+        start=`now`
+        "$XNEDIT" -geometry 100x50 -do "
+            $2
+            render_stats(\"reset\")
+            for (i = 0; i < $n; i++) {
+                $3
+                render_stats()
+            }
+            if ($n > 0)
+                t_print(render_stats())
+            exit()" "$TEXT" > "$TEXT.out"
+        end=`now`
+        if [ $n = 0 ]; then
+            base=`expr $end - $start`
+        else
+            steps=`expr $end - $start - $base`
+        fi
+    done
+    awk -v name="$1" -v n=$STEPS -v ns=$steps 'BEGIN {
+        printf "%s: %d steps in %.3f s, %.1f frames/s\n", name, n, ns / 1e9,
+                (ns > 0 ? n * 1e9 / ns : 0) }'
+    cat "$TEXT.out"
+    rm -f "$TEXT.out"
+    echo
+}
+
+BYLINE='if (i % 200 < 100)
+                    scroll_down(1)
+                else
+                    scroll_up(1)'
+BYPAGE='if (i % 40 < 20)
+                    scroll_down(1, "page")
+                else
+                    scroll_up(1, "page")'
+ACROSS='if (i % 200 < 100)
+                    scroll_right(8)
+                else
+                    scroll_left(8)'
+
+runCase "Vertical, by line" "" "$BYLINE"
+runCase "Vertical, by page" "" "$BYPAGE"
+runCase "Horizontal, default font" "" "$ACROSS"
+runCase "Horizontal, $PROPFONT" \
+    "set_fonts(\"$PROPFONT\", \"$PROPFONT:bold\", \"$PROPFONT:italic\", \"$PROPFONT:bold:italic\")" \
+    "$ACROSS"
+runCase "Vertical, second of split panes" "split_pane()
+            focus_pane(2)" "$BYLINE"
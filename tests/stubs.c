@@ -0,0 +1,67 @@
+/*******************************************************************************
+*                                                                              *
+* stubs.c -- Stand-ins for editor functions the tested modules reference       *
+*                                                                              *
+* This is free software; you can redistribute it and/or modify it under the    *
+* terms of the GNU General Public License as published by the Free Software    *
+* Foundation; either version 2 of the License, or (at your option) any later   *
+* version. In addition, you may distribute versions of this program linked to  *
+* Motif or Open Motif. See README for details.                                 *
+*                                                                              *
+* This software is distributed in the hope that it will be useful, but WITHOUT *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for    *
+* more details.                                                                *
+*                                                                              *
+*******************************************************************************/
+
+/*
+** The tests link textBuf.o without rangeset.o, which needs the text widget
+** headers.  The test buffers never have rangesets.  litSearch.o takes its
+** case conversion from search.c, which needs Motif, so ChangeCase is a copy
+** of the one there.
+*/
+
+#include "../source/textBuf.h"
+#include "../source/rangeset.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include <wctype.h>
+
+RangesetTable *RangesetTableFree(RangesetTable *table)
+{
+    return NULL;
+}
+
+static int check_len(const char *in, int len) {
+    for(int i=0;i<len;i++) {
+        if(in[i] == 0) return i;
+    }
+    return len;
+}
+
+void ChangeCase(const char *in, char *out, int makeUpper, int *in_len, int *out_len) {
+    mbstate_t state;
+    memset(&state, 0, sizeof(mbstate_t));
+    wchar_t w = 0;
+    
+    int len = Utf8CharLen((const unsigned char*)in);
+    len = check_len(in, len);
+    *in_len = len;
+    
+    mbrtowc(&w, in, len, &state);
+    wchar_t wc = makeUpper ? towupper(w) : towlower(w);
+    if(wc == 0) wc = w;
+    char bufChar[8];
+    const char *src_buf = bufChar;
+    int clen = wctomb(bufChar, wc);
+    if(clen > len) {
+        clen = len;
+        src_buf = in;
+    }
+    *out_len = clen;
+    
+    memcpy(out, src_buf, clen);
+}
@@ -0,0 +1,99 @@
+#!/bin/sh
+#
+# Time taken to count the lines of a large file for continuous wrap, and
+# how long the editor is held up by it.  The lines are counted in blocks,
+# some at once and the rest while the editor is idle (see startWrapCount in
+# textDisp.c).  MB megabytes of XNEdit's own sources are opened in an
+# xnedit server, and continuous wrap is turned on, and later the window is
+# resized (with xdotool), which counts the lines again.  Meanwhile the
+# server is asked for render_stats() every POLL_MS milliseconds until blocks
+# have been counted and none are left.  Printed for each case are the time
+# until the server had done what it was asked, the time until all of the
+# lines were counted, and the longest a request had to wait for an answer
+# meanwhile, less the time of a request to an idle server.  The server
+# answers a request when it reads it, so the time until it had done what it
+# was asked is that until it answered a second request.  Needs a display,
+# xdotool and a built xnedit and xnc.
+#
+# Usage: wrapCountBench.sh [MB [POLL_MS [xnedit [xnc]]]]
+#
+
+MB=${1:-512}
+POLL_MS=${2:-50}
+XNEDIT=${3:-../source/xnedit}
+XNC=${4:-../source/xnc}
+DIR=${TMPDIR:-/tmp}/wrapCountBench.$$
+SERVER=wrapCountBench$$
+TEXT=$DIR/text$$.c
+
+trap 'rm -rf "$DIR"' 0 1 2 15
+
+mkdir "$DIR" || exit 2
+: > "$TEXT"
+while [ `wc -c < "$TEXT"` -lt `expr $MB \* 1048576` ]; do
+    cat ../source/*.c >> "$TEXT"
+done
+
+now() {
+    date +%s%N
+}
+
+# Run the macro "$1" in the server, and print the time taken
+request() {
+    requestStart=`now`
+    "$XNC" -svrname $SERVER -do "$1" "$TEXT"
+    requestEnd=`now`
+    expr $requestEnd - $requestStart
+}
+
+# Poll the server until the lines are counted, from time "$1", and print
+# the time taken and the longest wait for an answer.  Leaves the last
+# render_stats() report in "$DIR/stats"
+waitForCount() {
+    longest=0
+    rm -f "$DIR/stats"
+    while :; do
+        ns=`request "write_file(render_stats(), \"$DIR/stats\")"`
+        [ $ns -gt $longest ] && longest=$ns
+        grep -q "counted: *[1-9][0-9]* (0 left)" "$DIR/stats" 2> /dev/null &&
+                break
+        sleep `awk -v ms=$POLL_MS 'BEGIN { print ms / 1000 }'`
+    done
+    end=`now`
+    echo `expr $end - $1` $longest
+}
+
+# Print the results of case "$1", given the times of the request, of the
+# count and of the longest wait
+report() {
+    awk -v name="$1" -v req=$2 -v count=$3 -v wait=$4 -v idle=$IDLE 'BEGIN {
+        printf "%s: %.1f ms to answer, %.1f ms until counted, " \
+                "longest wait %.1f ms\n", name, (req - idle) / 1e6,
+                count / 1e6, (wait - idle) / 1e6 }'
+    grep "^Wrap" "$DIR/stats"
+    echo
+}
+
+"$XNEDIT" -server -svrname $SERVER -geometry 100x50 "$TEXT" &
+PID=$!
+xdotool search --sync --name "text$$.c" > /dev/null
+IDLE=`request "x = 0"`
+
+echo "Counting the wrapped lines of $MB MB:"
+request "render_stats(\"reset\")" > /dev/null
+start=`now`
+request "set_wrap_text(\"continuous\")" > /dev/null
+request "x = 0" > /dev/null
+end=`now`
+report "Turning on continuous wrap" `expr $end - $start` `waitForCount $start`
+
+request "render_stats(\"reset\")" > /dev/null
+start=`now`
+xdotool search --name "text$$.c" windowsize 1000 700
+request "x = 0" > /dev/null
+end=`now`
+report "Resizing the window" `expr $end - $start` `waitForCount $start`
+
+"$XNC" -svrname $SERVER -do 'close("nosave")
+        exit()' "$TEXT"
+wait $PID
@@ -548,7 +548,7 @@ int FormatOfFile(const char *fileString)
 ** It's the caller's responsability to make sure that the pending character, 
 ** if present, is inserted at the beginning of the next block to convert.
 */
-void ConvertFromDosFileString(char *fileString, int *length, 
+void ConvertFromDosFileString(char *fileString, ssize_t *length, 
     char* pendingCR)
 {
     char *outPtr = fileString;
@@ -571,7 +571,7 @@ void ConvertFromDosFileString(char *fileString, int *length,
     *outPtr = '\0';
     *length = outPtr - fileString;
 }
-void ConvertFromMacFileString(char *fileString, int length)
+void ConvertFromMacFileString(char *fileString, ssize_t length)
 {
     char *inPtr = fileString;
     while (inPtr < fileString + length) {
@@ -592,12 +592,12 @@ void ConvertFromMacFileString(char *fileString, int length)
 ** anyone cares about the performance or the potential for running out of
 ** memory on a save, it should probably be redone.
 */
-int ConvertToDosFileString(char **fileString, int *length)
+int ConvertToDosFileString(char **fileString, ssize_t *length)
 {
     char *outPtr, *outString;
     char *inPtr = *fileString;
-    int inLength = *length;
-    int outLength = 0;
+    ssize_t inLength = *length;
+    ssize_t outLength = 0;
 
     /* How long a string will we need? */
     while (inPtr < *fileString + inLength) {
@@ -631,7 +631,7 @@ int ConvertToDosFileString(char **fileString, int *length)
 ** Converts a string (which may represent the entire contents of the file)
 ** from Unix to Macintosh format.
 */
-void ConvertToMacFileString(char *fileString, int length)
+void ConvertToMacFileString(char *fileString, ssize_t length)
 {
     char *inPtr = fileString;
     
@@ -652,7 +652,7 @@ char *ReadAnyTextFile(const char *fileName, int forceNL)
 {
     struct stat statbuf;
     FILE *fp;
-    int fileLen, readLen;
+    ssize_t fileLen, readLen;
     char *fileString;
     int format;
             
@@ -27,6 +27,8 @@
 #ifndef NEDIT_FILEUTILS_H_INCLUDED
 #define NEDIT_FILEUTILS_H_INCLUDED
 
+#include <sys/types.h>
+
 enum fileFormats {UNIX_FILE_FORMAT, DOS_FILE_FORMAT, MAC_FILE_FORMAT};
 
 int ParseFilename(const char *fullname, char *filename, char *pathname);
@@ -38,11 +40,11 @@ int CompressPathname(char *pathname);
 int ResolvePath(const char * pathIn, char * pathResolved); 
 
 int FormatOfFile(const char *fileString);
-void ConvertFromDosFileString(char *inString, int *length, 
+void ConvertFromDosFileString(char *inString, ssize_t *length, 
      char* pendingCR);
-void ConvertFromMacFileString(char *fileString, int length);
-int ConvertToDosFileString(char **fileString, int *length);
-void ConvertToMacFileString(char *fileString, int length);
+void ConvertFromMacFileString(char *fileString, ssize_t length);
+int ConvertToDosFileString(char **fileString, ssize_t *length);
+void ConvertToMacFileString(char *fileString, ssize_t length);
 char *ReadAnyTextFile(const char *fileName, int forceNL);
 
 #endif /* NEDIT_FILEUTILS_H_INCLUDED */
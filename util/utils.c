@@ -217,6 +217,23 @@ int Min(int i1, int i2)
     return i1 <= i2 ? i1 : i2;
 }
 
+/*
+**  Returns the number of processors available for worker threads (at least 1)
+*/
+int GetNumProcessors(void)
+{
+    static int nProcessors = 0;
+
+    if (nProcessors == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+        nProcessors = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+        if (nProcessors < 1)
+            nProcessors = 1;
+    }
+    return nProcessors;
+}
+
 /*
 **  Returns a pointer to the name of an rc file of the requested type.
 **
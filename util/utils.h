@@ -42,6 +42,7 @@ char *PrependHome(const char *filename, char *buf, size_t buflen);
 const char *GetUserName(void);
 const char *GetNameOfHost(void);
 int Min(int i1, int i2);
+int GetNumProcessors(void);
 const char* GetRCFileName(int type);
 
 /*